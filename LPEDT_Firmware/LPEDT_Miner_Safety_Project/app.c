@@ -45,6 +45,9 @@
 #include "src/ble.h"
 #include "src/Si7021.h"
 #include "src/SPI.h"
+#include "src/alarm.h"
+#include "src/battery.h"
+#include "src/energy.h"
 
 // Include logging specifically for this .c file
 #define INCLUDE_LOG_DEBUG 1
@@ -71,14 +74,9 @@
 //   up the MCU from the call to sl_power_manager_sleep() in the main while (1)
 //   loop.
 //
-// Students: We'll need to modify this for A2 onward so that compile time we
-//           control what the lowest EM (energy mode) the MCU sleeps to. So
-//           think "#if (expression)".
-#if (LOWEST_ENERGY_MODE == 0)
-#define APP_IS_OK_TO_SLEEP      (false)
-#else
-#define APP_IS_OK_TO_SLEEP      (true)
-#endif
+// energy_prepare_sleep() picks EM2 or EM3 for each wait and always allows it,
+// peripherals keep the MCU in EM1 or EM2 through their energy_need_t.
+#define APP_IS_OK_TO_SLEEP      (energy_prepare_sleep())
 
 // Return values for app_sleep_on_isr_exit():
 //   SL_POWER_MANAGER_IGNORE; // The module did not trigger an ISR and it doesn't want to contribute to the decision
@@ -135,7 +133,10 @@ SL_WEAK void app_init(void)
   gpioInit();
 
   // Enable the LETIMER0 module and Si7021 temperature sensor over I2C
-  LETIMER0_Enable(LOWEST_ENERGY_MODE);
+  LETIMER0_Enable();
+
+  // Energy mode of each wait, see energy.c
+  energy_init();
 
 #if BUILD_INCLUDES_BLE_SERVER == 1
 //  I2C_Init_Si7021();
@@ -147,18 +148,13 @@ SL_WEAK void app_init(void)
 
   SPI_Init();
 
-#endif
+  // Buzzer and the fast alarm path, see alarm.c
+  alarm_init();
 
-  // Set the required parameters as per the desired energy mode
-  switch(LOWEST_ENERGY_MODE){
-    case EM0: break;
-    case EM1: sl_power_manager_add_em_requirement(SL_POWER_MANAGER_EM1);
-            break;
-    case EM2: sl_power_manager_add_em_requirement(SL_POWER_MANAGER_EM2);
-            break;
-    case EM3: break;
-    default:break;
-  }
+  // Battery on the LETIMER0 underflow, see battery.c
+  battery_init();
+
+#endif
 } // app_init()
 
 /**************************************************************************//**
@@ -48,11 +48,7 @@
 #ifndef APP_H
 #define APP_H
 
-// 0 = highest energy mode, 3 = lowest energy mode
-//#define LOWEST_ENERGY_MODE 0
-//#define LOWEST_ENERGY_MODE 1
-#define LOWEST_ENERGY_MODE 2
-//#define LOWEST_ENERGY_MODE 3
+// The energy mode of every wait is picked at run time, see src/energy.h
 
 /**************************************************************************//**
  * Application Init.
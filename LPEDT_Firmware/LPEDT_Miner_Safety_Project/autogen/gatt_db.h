@@ -21,7 +21,13 @@ extern const sli_bt_gattdb_t gattdb;
 #define gattdb_measurement_interval           29
 #define gattdb_valid_range                    30
 #define gattdb_button_state                   33
-#define gattdb_ota_control                    37
+#define gattdb_bulk_telemetry                 37
+#define gattdb_stream_data                    40
+#define gattdb_stream_control                 43
+#define gattdb_alarm_latency                  45
+#define gattdb_fw_update_control              48
+#define gattdb_fw_update_data                 50
+#define gattdb_ota_control                    53
 
 
 #endif // __GATT_DB_H
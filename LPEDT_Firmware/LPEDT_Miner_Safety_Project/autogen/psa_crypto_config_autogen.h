@@ -3,6 +3,7 @@
 #ifndef PSA_CRYPTO_CONFIG_AUTOGEN_H
 #define PSA_CRYPTO_CONFIG_AUTOGEN_H
 
+#define PSA_WANT_ALG_CCM
 #define PSA_WANT_ALG_SHA_224
 #define PSA_WANT_ALG_SHA_256
 #define PSA_WANT_ALG_CMAC
@@ -22,6 +22,7 @@ static const sl_bt_configuration_t config = SL_BT_CONFIG_DEFAULT;
 static const struct sli_bgapi_class * const bt_class_table[] =
 {
   SL_BT_BGAPI_CLASS(system),
+  SL_BT_BGAPI_CLASS(nvm),
   SL_BT_BGAPI_CLASS(advertiser),
   SL_BT_BGAPI_CLASS(scanner),
   SL_BT_BGAPI_CLASS(connection),
@@ -45,7 +45,7 @@
 // <2=> EM2
 // <3=> EM3
 // <i> Default: 2
-#define SL_POWER_MANAGER_LOWEST_EM_ALLOWED   2
+#define SL_POWER_MANAGER_LOWEST_EM_ALLOWED   3
 
 // <q SL_POWER_MANAGER_CONFIG_VOLTAGE_SCALING_FAST_WAKEUP> Enable fast wakeup (disable voltage scaling in EM2/3 mode)
 // <i> Enable or disable voltage scaling in EM2/3 modes (when available). This decreases wakeup time by about 30 us.
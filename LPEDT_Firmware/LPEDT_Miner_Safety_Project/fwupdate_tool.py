@@ -0,0 +1,460 @@
+#!/usr/bin/env python3
+"""Host side of the fast firmware update, see src/fwupdate.h.
+
+Checks a GBL file from create_bl_files.sh and cuts it into the packets the
+Miner Firmware Update service expects. Everything here works on bytes only,
+so it runs offline without a radio; a BLE host replays the packet list.
+
+  fwupdate_tool.py check  output_gbl/application.gbl
+  fwupdate_tool.py chunk  output_gbl/application.gbl --mtu 250 -o packets.txt
+  fwupdate_tool.py verify output_gbl/application.gbl --mtu 250
+  fwupdate_tool.py delta  output_gbl/application.gbl --base old.bin -o update.delta
+  fwupdate_tool.py verify update.delta --base old.bin
+
+chunk writes one packet per line as "<characteristic> <hex>", control lines
+are acknowledged writes, data lines are write commands. verify replays the
+packets through a model of the device, dropping some on the way, and checks
+that the resume logic rebuilds the image byte for byte.
+
+delta builds a delta from the firmware running on the helmets (old.bin, the
+flash image from 0, "arm-none-eabi-objcopy -O binary old.axf old.bin") to
+the new GBL, see src/delta.h. chunk and verify take a delta like a GBL; the
+packets then start with BEGIN_DELTA and verify runs the delta through a
+model of src/delta.c as well. A delta only helps with an unencrypted GBL.
+"""
+
+import argparse
+import struct
+import sys
+import zlib
+
+# GBL tags, see the Gecko Bootloader user's guide
+GBL_TAG_HEADER = 0x03A617EB
+GBL_TAG_END = 0xFC0404FC
+
+# CRC-32 over a block that ends with its own CRC, little endian
+CRC32_RESIDUE = 0x2144DF1C
+
+# src/fwupdate.h
+DATA_HEADER_SIZE = 4
+OP_BEGIN = 0x01
+OP_COMMIT = 0x02
+OP_ABORT = 0x03
+OP_BEGIN_DELTA = 0x04
+
+# src/delta.h
+DELTA_MAGIC = 0x3144534D
+DELTA_HEADER_SIZE = 20
+DELTA_OP_LITERAL_MAX = 0x7F
+DELTA_OP_COPY = 0x80
+DELTA_STAGE_SIZE = 256
+
+# delta generator: bytes hashed to find copies, shortest copy worth sending
+DELTA_KEY = 8
+DELTA_MIN_COPY = 8
+DELTA_MAX_CANDIDATES = 8
+
+ATT_HEADER_LENGTH = 3
+ATT_MAX_MTU = 250     # src/ble.h
+FLASH_SIZE = 0x80000
+
+
+class GblError(Exception):
+    pass
+
+
+def parse_gbl(image):
+    """Walks the tags of a GBL image and checks the end tag CRC.
+
+    Returns a list of (tag, length) pairs. Raises GblError on a bad image.
+    """
+    tags = []
+    pos = 0
+    while True:
+        if pos + 8 > len(image):
+            raise GblError("truncated at offset %d" % pos)
+        tag, length = struct.unpack_from("<II", image, pos)
+        if not tags and tag != GBL_TAG_HEADER:
+            raise GblError("no GBL header tag")
+        if pos + 8 + length > len(image):
+            raise GblError("tag 0x%08X runs past the end" % tag)
+        tags.append((tag, length))
+        pos += 8 + length
+        if tag == GBL_TAG_END:
+            break
+    if pos != len(image):
+        raise GblError("%d bytes after the end tag" % (len(image) - pos))
+    if zlib.crc32(image) != CRC32_RESIDUE:
+        raise GblError("end tag CRC does not match")
+    return tags
+
+
+def chunk_size(mtu):
+    """Image bytes per data packet, a multiple of 4."""
+    mtu = min(mtu, ATT_MAX_MTU)
+    size = (mtu - ATT_HEADER_LENGTH - DATA_HEADER_SIZE) & ~3
+    if size <= 0:
+        raise ValueError("ATT_MTU %d is too small" % mtu)
+    return size
+
+
+def is_delta(payload):
+    return len(payload) >= 4 and struct.unpack_from("<I", payload)[0] == DELTA_MAGIC
+
+
+def begin_payload(image):
+    op = OP_BEGIN_DELTA if is_delta(image) else OP_BEGIN
+    return struct.pack("<BII", op, len(image), zlib.crc32(image))
+
+
+def commit_payload():
+    return bytes([OP_COMMIT])
+
+
+def data_packets(image, mtu, start=0):
+    """Yields the data packets from offset start to the end of the image."""
+    size = chunk_size(mtu)
+    for offset in range(start, len(image), size):
+        yield struct.pack("<I", offset) + image[offset:offset + size]
+
+
+def _varint(value):
+    out = bytearray()
+    while True:
+        b = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(b | 0x80)
+        else:
+            out.append(b)
+            return bytes(out)
+
+
+def _zigzag(value):
+    return (value << 1) if value >= 0 else ((-value << 1) - 1)
+
+
+def _match_length(a, ai, b, bi):
+    n = 0
+    limit = min(len(a) - ai, len(b) - bi)
+    while n < limit:
+        step = min(64, limit - n)
+        if a[ai + n:ai + n + step] == b[bi + n:bi + n + step]:
+            n += step
+            continue
+        while a[ai + n] == b[bi + n]:
+            n += 1
+        break
+    return n
+
+
+def make_delta(source, target):
+    """Greedy delta of target against source, see src/delta.h."""
+    index = {}
+    for j in range(len(source) - DELTA_KEY + 1):
+        positions = index.setdefault(source[j:j + DELTA_KEY], [])
+        if len(positions) < DELTA_MAX_CANDIDATES:
+            positions.append(j)
+
+    ops = bytearray()
+    literal_start = 0
+    copy_end = 0
+    i = 0
+
+    def flush_literal(end):
+        for k in range(literal_start, end, DELTA_OP_LITERAL_MAX + 1):
+            run = target[k:min(end, k + DELTA_OP_LITERAL_MAX + 1)]
+            ops.append(len(run) - 1)
+            ops.extend(run)
+
+    while i < len(target):
+        best_len = 0
+        best_pos = 0
+        # carrying on where the last copy ended costs the least
+        expected = copy_end + (i - literal_start)
+        candidates = list(index.get(target[i:i + DELTA_KEY], ()))
+        if expected < len(source):
+            candidates.insert(0, expected)
+        for pos in candidates:
+            n = _match_length(source, pos, target, i)
+            if n > best_len:
+                best_len, best_pos = n, pos
+        if best_len < DELTA_MIN_COPY:
+            i += 1
+            continue
+        flush_literal(i)
+        ops.append(DELTA_OP_COPY)
+        ops.extend(_varint(best_len))
+        ops.extend(_varint(_zigzag(best_pos - copy_end)))
+        copy_end = best_pos + best_len
+        i += best_len
+        literal_start = i
+    flush_literal(len(target))
+
+    header = struct.pack("<IIIII", DELTA_MAGIC, len(source), zlib.crc32(source),
+                         len(target), zlib.crc32(target))
+    return header + bytes(ops)
+
+
+class DeltaModel:
+    """Mirrors src/delta.c, byte by byte, with the same stage and padding."""
+
+    def __init__(self, source, slot_length=FLASH_SIZE):
+        self.source = source
+        self.slot_length = slot_length
+        self.header = bytearray()
+        self.state = "header"
+        self.ops = None
+        self.storage = bytearray()
+        self.stage = bytearray()
+        self.produced = 0
+        self.target_size = 0
+        self.target_crc = 0
+        self.copy_end = 0
+        self.remaining = 0
+        self.varint = 0
+        self.shift = 0
+        self.copy_length = 0
+
+    def _emit(self, data):
+        if len(data) > self.target_size - self.produced:
+            return 0x87
+        for b in data:
+            self.stage.append(b)
+            self.produced += 1
+            if len(self.stage) == DELTA_STAGE_SIZE or self.produced == self.target_size:
+                self.storage += self.stage + b"\xff" * (-len(self.stage) % 4)
+                self.stage = bytearray()
+        if self.produced == self.target_size:
+            self.state = "done"
+        return 0
+
+    def feed(self, data):
+        for b in data:
+            if self.state == "header":
+                self.header.append(b)
+                if len(self.header) == DELTA_HEADER_SIZE:
+                    magic, size, crc, self.target_size, self.target_crc = \
+                        struct.unpack("<IIIII", self.header)
+                    if magic != DELTA_MAGIC:
+                        return 0x87
+                    if size > len(self.source) or zlib.crc32(self.source[:size]) != crc:
+                        return 0x86
+                    if self.target_size == 0 or self.target_size > self.slot_length:
+                        return 0x81
+                    self.state = "op"
+            elif self.state == "op":
+                if b <= DELTA_OP_LITERAL_MAX:
+                    self.remaining = b + 1
+                    self.state = "literal"
+                elif b == DELTA_OP_COPY:
+                    self.varint, self.shift = 0, 0
+                    self.state = "length"
+                else:
+                    return 0x87
+            elif self.state == "literal":
+                err = self._emit(bytes([b]))
+                if err:
+                    return err
+                self.remaining -= 1
+                if self.remaining == 0 and self.state != "done":
+                    self.state = "op"
+            elif self.state in ("length", "offset"):
+                if self.shift > 28:
+                    return 0x87
+                self.varint |= (b & 0x7F) << self.shift
+                self.shift += 7
+                if b & 0x80:
+                    continue
+                if self.state == "length":
+                    self.copy_length = self.varint
+                    self.varint, self.shift = 0, 0
+                    self.state = "offset"
+                    continue
+                offset = (self.varint >> 1) ^ -(self.varint & 1)
+                self.copy_end += offset
+                if self.copy_end < 0 or self.copy_end + self.copy_length > len(self.source):
+                    return 0x87
+                self.state = "op"
+                err = self._emit(self.source[self.copy_end:self.copy_end + self.copy_length])
+                if err:
+                    return err
+                self.copy_end += self.copy_length
+            else:
+                return 0x87
+        return 0
+
+    def finish(self):
+        if self.state != "done":
+            return 0x82
+        if zlib.crc32(bytes(self.storage[:self.target_size])) != self.target_crc:
+            return 0x83
+        return 0
+
+
+class DeviceModel:
+    """Mirrors the receive path of src/fwupdate.c."""
+
+    def __init__(self, source=None):
+        self.source = source
+        self.size = 0
+        self.crc = 0
+        self.received = 0
+        self.storage = bytearray()
+        self.delta = None
+        self.receiving = False
+        self.last_error = 0
+
+    def control(self, value):
+        if value[0] in (OP_BEGIN, OP_BEGIN_DELTA):
+            _, self.size, self.crc = struct.unpack("<BII", value[:9])
+            self.received = 0
+            self.storage = bytearray()
+            self.delta = DeltaModel(self.source) if value[0] == OP_BEGIN_DELTA else None
+            self.receiving = True
+            return 0
+        if value[0] == OP_COMMIT:
+            if not self.receiving:
+                return 0x80
+            if self.received != self.size:
+                return 0x82
+            if self.delta:
+                return self.delta.finish()
+            if zlib.crc32(bytes(self.storage[:self.size])) != self.crc:
+                return 0x83
+            return 0
+        if value[0] == OP_ABORT:
+            self.receiving = False
+            return 0
+        return 0x80
+
+    def data(self, value):
+        if not self.receiving or len(value) <= DATA_HEADER_SIZE:
+            return
+        offset = struct.unpack_from("<I", value)[0]
+        payload = value[DATA_HEADER_SIZE:]
+        if offset != self.received or len(payload) > self.size - self.received:
+            return
+        if self.delta:
+            self.last_error = self.delta.feed(payload)
+            if self.last_error:
+                self.receiving = False
+                return
+            self.storage = self.delta.storage
+        else:
+            if len(payload) % 4 and self.received + len(payload) != self.size:
+                return
+            self.storage += payload + b"\xff" * (-len(payload) % 4)
+        self.received += len(payload)
+
+
+def transfer(image, mtu, device, drop_every=0, burst=32):
+    """Sends an image to a device model, resuming after dropped packets.
+
+    The host sends burst write commands, then reads the bytes received from
+    the control characteristic and carries on from there.
+    Returns the number of data packets sent.
+    """
+    if device.control(begin_payload(image)) != 0:
+        raise GblError("BEGIN refused")
+    sent = 0
+    while device.received < len(image):
+        if not device.receiving:
+            raise GblError("transfer dropped, error 0x%02X" % device.last_error)
+        for i, packet in enumerate(data_packets(image, mtu, device.received)):
+            if i == burst:
+                break
+            sent += 1
+            if drop_every and sent % drop_every == 0:
+                continue
+            device.data(packet)
+    err = device.control(commit_payload())
+    if err != 0:
+        raise GblError("COMMIT refused, error 0x%02X" % err)
+    return sent
+
+
+def plan(image, mtu, interval_ms=15.0, packets_per_event=6):
+    packets = -(-len(image) // chunk_size(mtu))
+    seconds = packets / packets_per_event * interval_ms / 1000.0
+    return packets, seconds
+
+
+def load(path):
+    with open(path, "rb") as f:
+        image = f.read()
+    if not is_delta(image):
+        parse_gbl(image)
+    return image
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("command", choices=["check", "chunk", "verify", "delta"])
+    parser.add_argument("gbl", help="GBL file, or a delta for chunk and verify")
+    parser.add_argument("--mtu", type=int, default=ATT_MAX_MTU)
+    parser.add_argument("--base", help="flash image of the running firmware")
+    parser.add_argument("-o", "--output")
+    args = parser.parse_args(argv)
+
+    try:
+        image = load(args.gbl)
+        base = None
+        if args.base:
+            with open(args.base, "rb") as f:
+                base = f.read()
+    except (OSError, GblError) as e:
+        print("%s: %s" % (args.gbl, e), file=sys.stderr)
+        return 1
+
+    if (args.command == "delta" or is_delta(image)) and args.command != "chunk" and base is None:
+        print("%s needs --base" % args.command, file=sys.stderr)
+        return 1
+
+    if args.command == "delta":
+        delta = make_delta(base, image)
+        model = DeltaModel(base)
+        if model.feed(delta) or model.finish() or bytes(model.storage[:len(image)]) != image:
+            print("delta does not rebuild %s" % args.gbl, file=sys.stderr)
+            return 1
+        print("%s: %d bytes, delta %d bytes, %.1f %% of the GBL"
+              % (args.gbl, len(image), len(delta), 100.0 * len(delta) / len(image)))
+        if args.output:
+            with open(args.output, "wb") as f:
+                f.write(delta)
+        return 0
+
+    packets, seconds = plan(image, args.mtu)
+    print("%s: %d bytes, CRC-32 0x%08X, %d packets of %d bytes, about %.1f s at 15 ms"
+          % (args.gbl, len(image), zlib.crc32(image), packets, chunk_size(args.mtu), seconds))
+
+    if args.command == "chunk":
+        out = open(args.output, "w") if args.output else sys.stdout
+        out.write("fw_update_control %s\n" % begin_payload(image).hex())
+        for packet in data_packets(image, args.mtu):
+            out.write("fw_update_data %s\n" % packet.hex())
+        out.write("fw_update_control %s\n" % commit_payload().hex())
+        if args.output:
+            out.close()
+
+    if args.command == "verify":
+        for drop_every in (0, 50):
+            device = DeviceModel(base)
+            try:
+                sent = transfer(image, args.mtu, device, drop_every)
+            except GblError as e:
+                print("replay failed: %s" % e, file=sys.stderr)
+                return 1
+            if not is_delta(image) and bytes(device.storage[:len(image)]) != image:
+                print("replay with every %dth packet dropped differs" % drop_every, file=sys.stderr)
+                return 1
+            if drop_every:
+                print("replay ok, %d packets sent, every %dth dropped" % (sent, drop_every))
+            else:
+                print("replay ok, %d packets sent" % sent)
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
@@ -6,8 +6,8 @@
  */
 
 #include <em_core.h>
-#include <sl_power_manager.h>
 #include "src/scheduler.h"
+#include "src/energy.h"
 #include "src/gpio.h"
 #include "src/timers.h"
 #include "i2c.h"
@@ -66,7 +66,7 @@ void temperature_state_machine(uint32_t event){
              * temperature data from the Si7021 chip and go to next state.
              */
               if (event == EVENT_LETIMER_COMP1) {
-                  sl_power_manager_add_em_requirement(SL_POWER_MANAGER_EM1); // Setting sleep to EM1
+                  ENERGY_REQUIRE(ENERGY_NEED_I2C); // Setting sleep to EM1
                   I2C_Write_Data_itr(SI7021_DEVICE_ADDR, SI7021_CMD_MEASURE_TEMP_NO_HOLD);
                   nextState = waitForI2CWriteTransfer;
               }
@@ -80,7 +80,7 @@ void temperature_state_machine(uint32_t event){
              */
               if (event == EVENT_I2C_TRANSFER_COMPLETE) {
                   NVIC_DisableIRQ(I2C0_IRQn);
-                  sl_power_manager_remove_em_requirement(SL_POWER_MANAGER_EM1); // Setting sleep to EM3
+                  ENERGY_RELEASE(ENERGY_NEED_I2C); // Sleep as deep as the rest allows
                   timerWaitUs_irq(SI7021_14B_CONVERSION_TIME_US);
                   nextState = waitForSi7021Conversion;
               }
@@ -94,7 +94,7 @@ void temperature_state_machine(uint32_t event){
             * state.
             */
               if (event == EVENT_LETIMER_COMP1) {
-                  sl_power_manager_add_em_requirement(SL_POWER_MANAGER_EM1); // Setting sleep to EM1
+                  ENERGY_REQUIRE(ENERGY_NEED_I2C); // Setting sleep to EM1
                   I2C_Read_Data_irq(SI7021_DEVICE_ADDR);
                   nextState = waitForI2CReadTransfer;
               }
@@ -110,7 +110,7 @@ void temperature_state_machine(uint32_t event){
               if (event == EVENT_I2C_TRANSFER_COMPLETE) {
                   NVIC_DisableIRQ(I2C0_IRQn);
                   si7021TurnOff();
-                  sl_power_manager_remove_em_requirement(SL_POWER_MANAGER_EM1); // Setting sleep to EM3
+                  ENERGY_RELEASE(ENERGY_NEED_I2C); // Sleep as deep as the rest allows
                   Si7021_data = I2C_Get_Data();
 
                   // Converting the data received from the sensor into temperature in Celsius
@@ -0,0 +1,332 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    alarm.c
+ * @brief   Fast path of safety alarms with a latency histogram per stage
+ *
+ *          The interrupt that detects an alarm starts the buzzer itself and
+ *          raises ALARM_BIT_POS on the BLE loop, which handles it before
+ *          anything else in the same external signal. Nothing goes through
+ *          the scheduler events or a soft timer. The alarm indication takes
+ *          the alarm lane of the indication queue and the reliable stream
+ *          holds its notifications until the indication is confirmed, so
+ *          no bulk data sits in the link layer ahead of it.
+ *
+ *          Every stage is stamped with the sleeptimer tick count, which
+ *          keeps running in EM2, relative to the tick the interrupt saw.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include "em_core.h"
+#include "sl_sleeptimer.h"
+#include "gatt_db.h"
+#include "alarm.h"
+#include "buzzer.h"
+#include "ble.h"
+#include "connparams.h"
+#include "ble_device_type.h"
+
+// Include logging for this file
+#define INCLUDE_LOG_DEBUG 1
+#include "log.h"
+
+#if BUILD_INCLUDES_BLE_SERVER == 1
+
+// Button State values, see ble.c
+#define SOS_ON                 (0x01)
+#define SOS_OFF                (0x00)
+
+typedef struct {
+  uint32_t worstUs;
+  uint16_t overBudget;
+  uint16_t buckets[ALARM_LATENCY_BUCKETS];
+} alarm_stage_stats_t;
+
+static const uint16_t budgetMs[ALARM_NUMBER_OF_STAGES] = {
+  [ALARM_STAGE_BUZZER]     = ALARM_BUDGET_BUZZER_MS,
+  [ALARM_STAGE_DISPATCH]   = ALARM_BUDGET_DISPATCH_MS,
+  [ALARM_STAGE_BEACON]     = ALARM_BUDGET_BEACON_MS,
+  [ALARM_STAGE_INDICATION] = ALARM_BUDGET_INDICATION_MS,
+  [ALARM_STAGE_CONFIRMED]  = ALARM_BUDGET_CONFIRMED_MS,
+};
+
+static alarm_stage_stats_t stages[ALARM_NUMBER_OF_STAGES];
+
+static bool              ready = false;
+static volatile uint8_t  activeAlarms = 0;     // written by interrupts
+static volatile uint32_t raisedTick = 0;
+static volatile uint8_t  stamped = 0;          // stages stamped for the last raise
+static uint8_t           dispatchedAlarms = 0; // as last applied by the BLE loop
+static uint8_t           raised = 0;
+static bool              indicationPending = false;
+
+/**
+ * @brief   Returns the buzzer pattern of an alarm
+ * @param   alarm   source, see beacon_alarm_t
+ * @return  pattern
+ */
+static buzzer_pattern_t pattern_of(beacon_alarm_t alarm) {
+  switch(alarm){
+    case BEACON_ALARM_GAS:         return BUZZER_PATTERN_GAS;
+    case BEACON_ALARM_FALL:        return BUZZER_PATTERN_FALL;
+    case BEACON_ALARM_LOW_BATTERY: return BUZZER_PATTERN_LOW_BATTERY;
+    case BEACON_ALARM_SOS:
+    default:                       return BUZZER_PATTERN_SOS;
+  }
+}
+
+/**
+ * @brief   Returns the histogram bucket of a latency
+ * @param   ms      latency
+ * @return  bucket index
+ */
+static uint32_t bucket_of(uint32_t ms) {
+  uint32_t b = 0;
+
+  while((ms != 0) && (b < ALARM_LATENCY_BUCKETS - 1)){
+    ms >>= 1;
+    b++;
+  }
+
+  return b;
+}
+
+/**
+ * @brief   Writes a little endian u16
+ * @param   p       first byte
+ * @param   v       value
+ * @return  none
+ */
+static void put_u16(uint8_t *p, uint16_t v) {
+  p[0] = (uint8_t) v;
+  p[1] = (uint8_t) (v >> 8);
+}
+
+/**
+ * @brief   Writes a little endian u32
+ * @param   p       first byte
+ * @param   v       value
+ * @return  none
+ */
+static void put_u32(uint8_t *p, uint32_t v) {
+  put_u16(&p[0], (uint16_t) v);
+  put_u16(&p[2], (uint16_t) (v >> 16));
+}
+
+/**
+ * @brief   Sets up the buzzer and clears the histogram, call once at boot
+ * @return  none
+ */
+void alarm_init(void) {
+  uint32_t i;
+  uint32_t b;
+
+  buzzer_init();
+
+  for(i = 0; i < ALARM_NUMBER_OF_STAGES; i++){
+    stages[i].worstUs = 0;
+    stages[i].overBudget = 0;
+    for(b = 0; b < ALARM_LATENCY_BUCKETS; b++)
+      stages[i].buckets[b] = 0;
+  }
+
+  activeAlarms = 0;
+  dispatchedAlarms = 0;
+  stamped = (1 << ALARM_NUMBER_OF_STAGES) - 1;
+  raised = 0;
+  indicationPending = false;
+  ready = true;
+
+} // alarm_init()
+
+/**
+ * @brief   Raises or clears an alarm from an interrupt handler
+ * @param   alarm   source, see beacon_alarm_t
+ * @param   active  true to raise it
+ * @return  none
+ */
+void alarm_from_isr(beacon_alarm_t alarm, bool active) {
+  CORE_DECLARE_IRQ_STATE;
+  uint8_t previous;
+
+  if(ready == false)
+    return;
+
+  CORE_ENTER_CRITICAL();
+  previous = activeAlarms;
+  if(active)
+    activeAlarms = previous | alarm;
+  else
+    activeAlarms = previous & ~alarm;
+
+  if((activeAlarms & ~previous) != 0){
+    raisedTick = sl_sleeptimer_get_tick_count();
+    stamped = 0;
+    if(raised < UINT8_MAX)
+      raised++;
+  }
+  CORE_EXIT_CRITICAL();
+
+  buzzer_request(pattern_of(alarm), active);
+  if(activeAlarms != 0)
+    alarm_stamp(ALARM_STAGE_BUZZER);
+
+  sl_bt_external_signal(1 << ALARM_BIT_POS);
+
+} // alarm_from_isr()
+
+/**
+ * @brief   Handles the ALARM_BIT_POS external signal in the BLE loop
+ * @return  none
+ */
+void alarm_dispatch(void) {
+  ble_data_struct_t *ble_data = get_ble_data_ptr();
+  uint8_t            active = activeAlarms;
+  uint8_t            changed = active ^ dispatchedAlarms;
+  uint8_t            sos;
+  uint32_t           bit;
+
+  alarm_stamp(ALARM_STAGE_DISPATCH);
+  if(changed == 0)
+    return;
+  dispatchedAlarms = active;
+
+  // Payload and interval first, the advertiser needs no connection
+  for(bit = 1; bit <= 0x80; bit <<= 1){
+    if(changed & bit)
+      beacon_set_alarm((beacon_alarm_t) bit, (active & bit) != 0);
+  }
+  if(BEACON_MODE_ENABLE == 1)
+    alarm_stamp(ALARM_STAGE_BEACON);
+
+  connparams_set_demand(CONN_DEMAND_ALARM, (active != 0));
+
+  // SOS is the alarm with a characteristic, the others are broadcast only
+  if((changed & BEACON_ALARM_SOS) &&
+     (ble_data->connection_open == true) &&
+     (ble_data->ok_to_send_button_indications == true) &&
+     (ble_data->bondingStatus == true)){
+    sos = (active & BEACON_ALARM_SOS) ? SOS_ON : SOS_OFF;
+    indicationPending = ((send_indication(QUEUE_LANE_ALARM, gattdb_button_state, 1, &sos) == false) &&
+                         (sos == SOS_ON));
+  }
+
+} // alarm_dispatch()
+
+/**
+ * @brief   Stamps a stage of the alarm last raised
+ * @param   stage   stage reached
+ * @return  none
+ */
+void alarm_stamp(alarm_stage_t stage) {
+  CORE_DECLARE_IRQ_STATE;
+  alarm_stage_stats_t *s = &stages[stage];
+  uint32_t             ticks;
+  uint32_t             us;
+  uint32_t             b;
+  bool                 over;
+
+  CORE_ENTER_CRITICAL();
+  if((stamped & (1 << stage)) != 0){
+    CORE_EXIT_CRITICAL();
+    return;
+  }
+  stamped |= (1 << stage);
+  ticks = sl_sleeptimer_get_tick_count() - raisedTick;
+
+  us = (uint32_t) (((uint64_t) ticks * 1000000) / sl_sleeptimer_get_timer_frequency());
+  if(us > s->worstUs)
+    s->worstUs = us;
+  b = bucket_of(us / 1000);
+  if(s->buckets[b] < UINT16_MAX)
+    s->buckets[b]++;
+  over = (us > (uint32_t) budgetMs[stage] * 1000);
+  if(over && (s->overBudget < UINT16_MAX))
+    s->overBudget++;
+  CORE_EXIT_CRITICAL();
+
+  if(stage == ALARM_STAGE_CONFIRMED)
+    indicationPending = false;
+
+  // Never from the interrupt, the buzzer stage is stamped in the same breath
+  if(over && (stage != ALARM_STAGE_BUZZER)){
+      LOG_WARN("alarm: stage %u took %u us, budget %u ms\r\n",
+               (unsigned int) stage, (unsigned int) us, (unsigned int) budgetMs[stage]);
+  }
+
+} // alarm_stamp()
+
+/**
+ * @brief   Returns whether the alarm indication waits for its confirmation
+ * @return  true while the link is reserved for the alarm
+ */
+bool alarm_link_reserved(void) {
+  uint32_t ticks;
+
+  if(indicationPending == false)
+    return false;
+
+  // A client that never confirms does not hold the stream forever
+  ticks = sl_sleeptimer_get_tick_count() - raisedTick;
+  if(ticks > sl_sleeptimer_ms_to_tick(ALARM_BUDGET_CONFIRMED_MS)){
+    indicationPending = false;
+    return false;
+  }
+
+  return true;
+
+} // alarm_link_reserved()
+
+/**
+ * @brief   Answers a read of the Alarm Latency characteristic
+ * @param   connection  connection handle
+ * @param   offset      offset of a long read
+ * @return  none
+ */
+void alarm_read_latency(uint8_t connection, uint16_t offset) {
+  sl_status_t sc;
+  uint8_t     value[ALARM_LATENCY_SIZE];
+  uint8_t    *p = &value[ALARM_LATENCY_HEADER_SIZE];
+  uint8_t     err = 0;
+  uint16_t    sent;
+  uint32_t    i;
+  uint32_t    b;
+
+  value[0] = ALARM_LATENCY_FORMAT_VERSION;
+  value[1] = ALARM_NUMBER_OF_STAGES;
+  value[2] = ALARM_LATENCY_BUCKETS;
+  value[3] = raised;
+
+  for(i = 0; i < ALARM_NUMBER_OF_STAGES; i++){
+    put_u32(&p[0], stages[i].worstUs);
+    put_u16(&p[4], stages[i].overBudget);
+    for(b = 0; b < ALARM_LATENCY_BUCKETS; b++)
+      put_u16(&p[6 + (2 * b)], stages[i].buckets[b]);
+    p += ALARM_STAGE_RECORD_SIZE;
+  }
+
+  if(offset > sizeof(value)){
+    err = 0x07;   // Invalid Offset
+    offset = sizeof(value);
+  }
+
+  // The stack sends what fits in the ATT_MTU, the client reads on with blobs
+  sc = sl_bt_gatt_server_send_user_read_response(connection, gattdb_alarm_latency, err,
+                                                 sizeof(value) - offset, &value[offset], &sent);
+  if(sc != SL_STATUS_OK){
+      LOG_ERROR("sl_bt_gatt_server_send_user_read_response() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+  }
+
+} // alarm_read_latency()
+
+#endif
@@ -0,0 +1,127 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    alarm.h
+ * @brief   Header file for alarm.c. Fast path of safety alarms from the
+ *          interrupt that detects them to the buzzer and the radio, with a
+ *          latency histogram per stage
+ *
+ *          Latency budget, from the interrupt, with the default constants:
+ *            ALARM_STAGE_BUZZER      buzzer sounding             1 ms
+ *            ALARM_STAGE_DISPATCH    picked up by the BLE loop   5 ms
+ *            ALARM_STAGE_BEACON      alarm payload and 100 ms    5 ms
+ *                                    interval handed to the advertiser,
+ *                                    on air one interval later
+ *            ALARM_STAGE_INDICATION  alarm indication handed     5 ms
+ *                                    to the stack, link free
+ *            ALARM_STAGE_CONFIRMED   client confirmed it         1000 ms
+ *                                    two idle connection intervals and
+ *                                    margin, see connparams.c
+ *          An indication already in flight adds up to its own round trip
+ *          to the last two stages. Every stamp over its budget is logged and
+ *          counted.
+ *
+ *          Alarm Latency characteristic, read only, little endian:
+ *            [0]      ALARM_LATENCY_FORMAT_VERSION
+ *            [1]      ALARM_NUMBER_OF_STAGES
+ *            [2]      ALARM_LATENCY_BUCKETS
+ *            [3]      alarms raised, saturates at 255
+ *            then per stage, ALARM_STAGE_RECORD_SIZE bytes:
+ *              [0..3]   worst latency, us
+ *              [4..5]   stamps over budget
+ *              [6..]    uint16 count per bucket, bucket 0 below 1 ms,
+ *                       bucket n below 2^n ms, the last one all above
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#ifndef SRC_ALARM_H_
+#define SRC_ALARM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "beacon.h"
+
+#define ALARM_LATENCY_FORMAT_VERSION (1)
+#define ALARM_LATENCY_BUCKETS        (12)
+#define ALARM_STAGE_RECORD_SIZE      (6 + (2 * ALARM_LATENCY_BUCKETS))
+#define ALARM_LATENCY_HEADER_SIZE    (4)
+
+// External signal bit of the BLE loop, next to PB0_BIT_POS and PB1_BIT_POS
+#define ALARM_BIT_POS                (6)
+
+// Budget per stage, ms from the interrupt
+#define ALARM_BUDGET_BUZZER_MS       (1)
+#define ALARM_BUDGET_DISPATCH_MS     (5)
+#define ALARM_BUDGET_BEACON_MS       (5)
+#define ALARM_BUDGET_INDICATION_MS   (5)
+#define ALARM_BUDGET_CONFIRMED_MS    (1000)
+
+typedef enum {
+  ALARM_STAGE_BUZZER,
+  ALARM_STAGE_DISPATCH,
+  ALARM_STAGE_BEACON,
+  ALARM_STAGE_INDICATION,
+  ALARM_STAGE_CONFIRMED,
+  ALARM_NUMBER_OF_STAGES
+} alarm_stage_t;
+
+#define ALARM_LATENCY_SIZE           (ALARM_LATENCY_HEADER_SIZE + (ALARM_NUMBER_OF_STAGES * ALARM_STAGE_RECORD_SIZE))
+
+/**
+ * @brief   Sets up the buzzer and clears the histogram, call once at boot
+ * @return  none
+ */
+void alarm_init(void);
+
+/**
+ * @brief   Raises or clears an alarm from an interrupt handler. The buzzer
+ *          follows at once, the BLE loop is signalled for the rest.
+ * @param   alarm   source, see beacon_alarm_t
+ * @param   active  true to raise it
+ * @return  none
+ */
+void alarm_from_isr(beacon_alarm_t alarm, bool active);
+
+/**
+ * @brief   Handles the ALARM_BIT_POS external signal in the BLE loop: the
+ *          beacon goes to the alarm payload and interval, the connection
+ *          to the active profile, and the state is indicated ahead of any
+ *          routine traffic
+ * @return  none
+ */
+void alarm_dispatch(void);
+
+/**
+ * @brief   Stamps a stage of the alarm last raised, only the first stamp of
+ *          each stage counts
+ * @param   stage   stage reached
+ * @return  none
+ */
+void alarm_stamp(alarm_stage_t stage);
+
+/**
+ * @brief   Returns whether the alarm indication waits for its confirmation,
+ *          bulk traffic holds back meanwhile
+ * @return  true while the link is reserved for the alarm
+ */
+bool alarm_link_reserved(void);
+
+/**
+ * @brief   Answers a read of the Alarm Latency characteristic
+ * @param   connection  connection handle
+ * @param   offset      offset of a long read
+ * @return  none
+ */
+void alarm_read_latency(uint8_t connection, uint16_t offset);
+
+#endif /* SRC_ALARM_H_ */
@@ -0,0 +1,243 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    allowlist.c
+ * @brief   Set of enrolled helmets the gateway scanner accepts
+ *
+ *          Most scan reports at a mine site come from devices that are not
+ *          helmets, so rejecting them is the common case. The address is
+ *          hashed once; two bits of the hash index a bloom filter, which turns
+ *          away nearly every non-member without touching the table. The rest
+ *          probe an open addressing table (linear probing, at most 75 % full)
+ *          indexed by the top bits of the same hash. Each entry keeps the
+ *          time of its last accepted report, so repeats within
+ *          ALLOWLIST_DEDUP_WINDOW_MS are dropped before any further work.
+ *
+ *          The helmets of ALLOWLIST_ENROLLED are enrolled at boot by
+ *          gateway_init().
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include <string.h>
+
+#include "allowlist.h"
+#include "ble_device_type.h"
+
+// Include logging for this file
+#define INCLUDE_LOG_DEBUG 1
+#include "log.h"
+
+#if BUILD_INCLUDES_BLE_CLIENT == 1
+
+typedef struct {
+  bd_addr  address;
+  uint16_t shortId;       // 0 -> empty
+  uint32_t lastAcceptMs;
+} allowlist_entry_t;
+
+typedef struct {
+  bd_addr  address;
+  uint16_t shortId;
+} allowlist_enrolment_t;
+
+static const allowlist_enrolment_t enrolledAtBoot[] = ALLOWLIST_ENROLLED;
+
+static allowlist_entry_t table[ALLOWLIST_CAPACITY];
+static uint32_t          bloom[ALLOWLIST_BLOOM_BITS / 32];
+static uint32_t          enrolled = 0;
+static allowlist_stats_t stats;
+
+/**
+ * @brief   Fibonacci hash of the 48 bit address
+ * @param   address   device address
+ * @return  32 bit hash
+ */
+static inline uint32_t hash_address(const bd_addr *address) {
+  uint64_t key = ((uint64_t) address->addr[0])       | ((uint64_t) address->addr[1] << 8)  |
+                 ((uint64_t) address->addr[2] << 16) | ((uint64_t) address->addr[3] << 24) |
+                 ((uint64_t) address->addr[4] << 32) | ((uint64_t) address->addr[5] << 40);
+
+  return (uint32_t) ((key * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+// the two bloom filter bits, from the low half of the hash
+#define BLOOM_BIT_A(h)   ((h) & (ALLOWLIST_BLOOM_BITS - 1))
+#define BLOOM_BIT_B(h)   (((h) >> 12) & (ALLOWLIST_BLOOM_BITS - 1))
+
+// first table index, from the high bits of the hash
+#define TABLE_INDEX(h)   (((h) >> 22) & (ALLOWLIST_CAPACITY - 1))
+
+/**
+ * @brief   Finds the entry of an address
+ * @param   address   device address
+ * @param   h         hash_address() of address
+ * @return  the entry, NULL if not enrolled
+ */
+static allowlist_entry_t *find_entry(const bd_addr *address, uint32_t h) {
+  uint32_t i = TABLE_INDEX(h);
+
+  // the table is never full, an empty entry ends every probe sequence
+  while(table[i].shortId != 0){
+    if(memcmp(&table[i].address, address, sizeof(bd_addr)) == 0)
+      return &table[i];
+    i = (i + 1) & (ALLOWLIST_CAPACITY - 1);
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief   Enrolls the helmets of ALLOWLIST_ENROLLED, call once at boot
+ * @return  none
+ */
+void allowlist_init(void) {
+  uint32_t i;
+
+  allowlist_clear();
+
+  for(i = 0; i < sizeof(enrolledAtBoot) / sizeof(enrolledAtBoot[0]); i++){
+    if(allowlist_add(&enrolledAtBoot[i].address, enrolledAtBoot[i].shortId))
+      break;
+  }
+
+  LOG_INFO("allowlist: %u helmets enrolled\r\n", (unsigned int) enrolled);
+
+} // allowlist_init()
+
+/**
+ * @brief   Removes every enrolled helmet
+ * @return  none
+ */
+void allowlist_clear(void) {
+
+  memset(&table[0], 0, sizeof(table));
+  memset(&bloom[0], 0, sizeof(bloom));
+  memset(&stats, 0, sizeof(stats));
+  enrolled = 0;
+
+} // allowlist_clear()
+
+/**
+ * @brief   Enrolls a helmet
+ * @param   address   helmet address
+ * @param   shortId   crew facing helmet number, not 0
+ * @return  false if successful, true if the table is full
+ */
+bool allowlist_add(const bd_addr *address, uint16_t shortId) {
+  uint32_t           h = hash_address(address);
+  uint32_t           i;
+  allowlist_entry_t *entry;
+
+  if(shortId == 0)
+    return true;
+
+  entry = find_entry(address, h);
+  if(entry != NULL){
+    entry->shortId = shortId;
+    return false;
+  }
+
+  if(enrolled >= ALLOWLIST_MAX_ENROLLED){
+    LOG_ERROR("allowlist: full, %u helmets enrolled\r\n", (unsigned int) enrolled);
+    return true;
+  }
+
+  i = TABLE_INDEX(h);
+  while(table[i].shortId != 0)
+    i = (i + 1) & (ALLOWLIST_CAPACITY - 1);
+
+  table[i].address = *address;
+  table[i].shortId = shortId;
+  table[i].lastAcceptMs = 0;
+
+  bloom[BLOOM_BIT_A(h) / 32] |= (1UL << (BLOOM_BIT_A(h) % 32));
+  bloom[BLOOM_BIT_B(h) / 32] |= (1UL << (BLOOM_BIT_B(h) % 32));
+  enrolled++;
+
+  return false;
+
+} // allowlist_add()
+
+/**
+ * @brief   Returns the number of enrolled helmets
+ * @return  enrolled helmets
+ */
+uint32_t allowlist_count(void) {
+
+  return enrolled;
+
+} // allowlist_count()
+
+/**
+ * @brief   Scan report fast path, checks an advertiser against the enrolled
+ *          helmets
+ * @param   address   advertiser address
+ * @param   nowMs     ms since boot
+ * @return  see allowlist_result_t
+ */
+allowlist_result_t allowlist_check(const bd_addr *address, uint32_t nowMs) {
+  uint32_t           h = hash_address(address);
+  allowlist_entry_t *entry;
+
+  stats.reports++;
+
+  if(((bloom[BLOOM_BIT_A(h) / 32] & (1UL << (BLOOM_BIT_A(h) % 32))) == 0) ||
+     ((bloom[BLOOM_BIT_B(h) / 32] & (1UL << (BLOOM_BIT_B(h) % 32))) == 0)){
+    stats.bloomRejects++;
+    stats.rejects++;
+    return ALLOWLIST_REJECT;
+  }
+
+  entry = find_entry(address, h);
+  if(entry == NULL){
+    stats.rejects++;
+    return ALLOWLIST_REJECT;
+  }
+
+  if((entry->lastAcceptMs != 0) && (nowMs - entry->lastAcceptMs < ALLOWLIST_DEDUP_WINDOW_MS)){
+    stats.duplicates++;
+    return ALLOWLIST_DUPLICATE;
+  }
+
+  entry->lastAcceptMs = nowMs;
+  stats.accepts++;
+
+  return ALLOWLIST_ACCEPT;
+
+} // allowlist_check()
+
+/**
+ * @brief   Returns the short ID of a helmet
+ * @param   address   helmet address
+ * @return  short ID, 0 if the helmet is not enrolled
+ */
+uint16_t allowlist_short_id(const bd_addr *address) {
+  allowlist_entry_t *entry = find_entry(address, hash_address(address));
+
+  return ((entry != NULL) ? entry->shortId : 0);
+
+} // allowlist_short_id()
+
+/**
+ * @brief   Copies the counters and clears them
+ * @param   out     filled in
+ * @return  none
+ */
+void allowlist_take_stats(allowlist_stats_t *out) {
+
+  *out = stats;
+  memset(&stats, 0, sizeof(stats));
+
+} // allowlist_take_stats()
+
+#endif
@@ -0,0 +1,114 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    allowlist.h
+ * @brief   Header file for allowlist.c. Set of enrolled helmets the gateway
+ *          scanner accepts, with a bloom filter in front for fast rejection
+ *          and per helmet de-duplication of scan reports
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#ifndef SRC_ALLOWLIST_H_
+#define SRC_ALLOWLIST_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sl_bt_api.h"
+
+// 1 -> once helmets are enrolled, only they are accepted
+// 0 -> every helmet advertising the Health Thermometer service is accepted
+#define ALLOWLIST_ENABLE             1
+
+// Open addressing table, must be a power of 2. Enrolment stops at 75 % load
+// to keep the probe sequences short.
+#define ALLOWLIST_CAPACITY           (256)
+#define ALLOWLIST_MAX_ENROLLED       ((ALLOWLIST_CAPACITY * 3) / 4)
+
+// Bloom filter bits, must be a power of 2. Two bits per helmet, about 3 % of
+// non-members get past it with the table full.
+#define ALLOWLIST_BLOOM_BITS         (2048)
+
+// Reports of one helmet closer together than this are duplicates
+#define ALLOWLIST_DEDUP_WINDOW_MS    (1000)
+
+// Helmets enrolled at boot, { address, short ID } per helmet, the address
+// written as SERVER_BT_ADDRESS in ble_device_type.h. Add the helmets of the
+// crew here, helmet 1 is the server this gateway was paired with.
+#define ALLOWLIST_ENROLLED           { \
+                                       { SERVER_BT_ADDRESS, 1 }, \
+                                     }
+
+typedef enum {
+  ALLOWLIST_REJECT,     /**< not enrolled */
+  ALLOWLIST_DUPLICATE,  /**< enrolled, reported within the dedup window */
+  ALLOWLIST_ACCEPT,     /**< enrolled */
+} allowlist_result_t;
+
+typedef struct {
+  uint32_t reports;         /**< scan reports checked */
+  uint32_t bloomRejects;    /**< rejected by the bloom filter alone */
+  uint32_t rejects;         /**< rejected, bloom filter included */
+  uint32_t duplicates;
+  uint32_t accepts;
+} allowlist_stats_t;
+
+/**
+ * @brief   Enrolls the helmets of ALLOWLIST_ENROLLED, call once at boot
+ * @return  none
+ */
+void allowlist_init(void);
+
+/**
+ * @brief   Removes every enrolled helmet
+ * @return  none
+ */
+void allowlist_clear(void);
+
+/**
+ * @brief   Enrolls a helmet
+ * @param   address   helmet address
+ * @param   shortId   crew facing helmet number, not 0
+ * @return  false if successful, true if the table is full
+ */
+bool allowlist_add(const bd_addr *address, uint16_t shortId);
+
+/**
+ * @brief   Returns the number of enrolled helmets
+ * @return  enrolled helmets
+ */
+uint32_t allowlist_count(void);
+
+/**
+ * @brief   Scan report fast path, checks an advertiser against the enrolled
+ *          helmets
+ * @param   address   advertiser address
+ * @param   nowMs     ms since boot
+ * @return  see allowlist_result_t
+ */
+allowlist_result_t allowlist_check(const bd_addr *address, uint32_t nowMs);
+
+/**
+ * @brief   Returns the short ID of a helmet
+ * @param   address   helmet address
+ * @return  short ID, 0 if the helmet is not enrolled
+ */
+uint16_t allowlist_short_id(const bd_addr *address);
+
+/**
+ * @brief   Copies the counters and clears them
+ * @param   out     filled in
+ * @return  none
+ */
+void allowlist_take_stats(allowlist_stats_t *out);
+
+#endif /* SRC_ALLOWLIST_H_ */
@@ -0,0 +1,405 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    battery.c
+ * @brief   Battery voltage, state of charge and the VBAT_OK output of the
+ *          bq25570 harvester
+ *
+ *          The LETIMER0 underflow pulses PRS channel BATTERY_PRS_CH, which
+ *          starts one ADC0 conversion of V_BAT. ADC0 runs from the AUXHFRCO
+ *          in asynchronous mode and wakes the LDMA for its result, so the
+ *          conversion and the transfer both happen in EM2. The LDMA fills a
+ *          ring of two halves of BATTERY_SAMPLES_PER_HALF results and the CPU
+ *          only wakes when a half is full. The window comparator of ADC0
+ *          checks every conversion against BATTERY_LOW_MV and is the other
+ *          way to wake the CPU.
+ *
+ *          The state of charge comes from an open circuit voltage table of
+ *          the LP552530 at every 10 %. The segment of the last lookup is kept
+ *          and the voltage only moves a little between two halves, so a
+ *          lookup is a compare or two. The average of a half is filtered
+ *          with an EWMA before the lookup and its slope gives the trend the
+ *          harvester leaves on the cell.
+ *
+ *          The registers are written directly, this SDK snapshot does not
+ *          carry em_adc.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include "em_device.h"
+#include "em_cmu.h"
+#include "em_core.h"
+#include "em_gpio.h"
+#include "em_ldma.h"
+#include "em_prs.h"
+#include "dmadrv.h"
+#include "sl_bt_api.h"
+#include "battery.h"
+#include "timers.h"
+#include "alarm.h"
+#include "beacon.h"
+#include "telemetry.h"
+#include "journal.h"
+#include "ble_device_type.h"
+
+// Include logging for this file
+#define INCLUDE_LOG_DEBUG 1
+#include "log.h"
+
+#if BUILD_INCLUDES_BLE_SERVER == 1
+
+#define ADC_REF_MV             (2500)
+#define ADC_FULL_SCALE         (4096)
+#define ADC_MAX_CODE           (ADC_FULL_SCALE - 1)
+#define ADC_CLOCK_HZ           (4000000)
+
+#define MV_TO_CODE(mv)         ((((mv) / BATTERY_DIVIDER) * ADC_FULL_SCALE) / ADC_REF_MV)
+
+#define FILTER_ONE             (16)    // 1 mV in the filter
+
+#define HALF_MS                (BATTERY_SAMPLES_PER_HALF * LETIMER_PERIOD_MS)
+#define MS_PER_HOUR            (3600000)
+
+// Open circuit voltage of the cell at 0 %, 10 %, ... 100 %
+#define OCV_POINTS             (11)
+#define OCV_STEP_PERCENT       (10)
+
+static const uint16_t ocvMv[OCV_POINTS] = {
+  3000, 3600, 3690, 3740, 3770, 3800, 3850, 3910, 3980, 4080, 4190,
+};
+
+static LDMA_Descriptor_t ring[2];
+static uint16_t          samples[2][BATTERY_SAMPLES_PER_HALF];
+
+static bool              ready = false;
+static unsigned int      channel;
+static uint32_t          nextHalf = 0;
+static volatile bool     halfReady = false;
+static volatile uint16_t halfCode = 0;
+static volatile bool     lowAlarm = false;
+
+static bool              haveSample = false;
+static int32_t           mvX16 = 0;
+static int32_t           trendX16 = 0;     // mV per half buffer, 1/16 mV
+static uint32_t          segment = 0;      // OCV segment of the last lookup
+static uint8_t           soc = 0;
+static bool              vbatOk = true;
+static uint16_t          reportedMv = 0;
+static uint8_t           reportedSoc = 0xFF;
+
+/**
+ * @brief   Returns the state of charge of a voltage, starting from the
+ *          segment of the previous lookup
+ * @param   mv      battery voltage
+ * @return  0 to 100 %
+ */
+static uint8_t soc_of(uint32_t mv) {
+  while((segment > 0) && (mv < ocvMv[segment]))
+    segment--;
+  while((segment < OCV_POINTS - 2) && (mv >= ocvMv[segment + 1]))
+    segment++;
+
+  if(mv <= ocvMv[0])
+    return 0;
+  if(mv >= ocvMv[OCV_POINTS - 1])
+    return 100;
+
+  return (uint8_t) ((segment * OCV_STEP_PERCENT) +
+                    (((mv - ocvMv[segment]) * OCV_STEP_PERCENT) / (ocvMv[segment + 1] - ocvMv[segment])));
+}
+
+/**
+ * @brief   Sends a battery value into telemetry, into the journal if nobody
+ *          listens
+ * @param   sensor  TELEMETRY_SENSOR_BATTERY or TELEMETRY_SENSOR_SOC
+ * @param   value   value
+ * @return  none
+ */
+static void report(telemetry_sensor_t sensor, int16_t value) {
+  if(telemetry_add_sample(sensor, value))
+    journal_append(sensor, value);
+}
+
+/**
+ * @brief   Averages a full half of the ring, called by DMADRV from the LDMA
+ *          interrupt
+ * @param   ch          DMA channel
+ * @param   sequenceNo  callbacks so far
+ * @param   userParam   unused
+ * @return  true, the ring keeps going
+ */
+static bool half_done(unsigned int ch, unsigned int sequenceNo, void *userParam) {
+  uint32_t sum = 0;
+  uint32_t i;
+
+  (void) ch;
+  (void) sequenceNo;
+  (void) userParam;
+
+  for(i = 0; i < BATTERY_SAMPLES_PER_HALF; i++)
+    sum += samples[nextHalf][i];
+  nextHalf ^= 1;
+
+  halfCode = (uint16_t) (sum / BATTERY_SAMPLES_PER_HALF);
+  halfReady = true;
+  battery_from_isr();
+
+  return true;
+}
+
+/**
+ * @brief   Loads the factory calibration of the 2.5 V reference
+ * @return  none
+ */
+static void load_calibration(void) {
+  uint32_t cal = DEVINFO->ADC0CAL0;
+  uint32_t reg = ADC0->CAL;
+
+  reg &= ~(_ADC_CAL_SINGLEOFFSET_MASK | _ADC_CAL_SINGLEOFFSETINV_MASK | _ADC_CAL_SINGLEGAIN_MASK);
+  reg |= ((cal & _DEVINFO_ADC0CAL0_OFFSET2V5_MASK) >> _DEVINFO_ADC0CAL0_OFFSET2V5_SHIFT) << _ADC_CAL_SINGLEOFFSET_SHIFT;
+  reg |= ((cal & _DEVINFO_ADC0CAL0_NEGSEOFFSET2V5_MASK) >> _DEVINFO_ADC0CAL0_NEGSEOFFSET2V5_SHIFT) << _ADC_CAL_SINGLEOFFSETINV_SHIFT;
+  reg |= ((cal & _DEVINFO_ADC0CAL0_GAIN2V5_MASK) >> _DEVINFO_ADC0CAL0_GAIN2V5_SHIFT) << _ADC_CAL_SINGLEGAIN_SHIFT;
+  ADC0->CAL = reg;
+}
+
+/**
+ * @brief   Configures ADC0, the PRS channel, the DMA ring and the VBAT_OK
+ *          pin, call once at boot after LETIMER0_Enable()
+ * @return  none
+ */
+void battery_init(void) {
+  LDMA_TransferCfg_t      xfer = LDMA_TRANSFER_CFG_PERIPHERAL(ldmaPeripheralSignal_ADC0_SINGLE);
+  const LDMA_Descriptor_t half = LDMA_DESCRIPTOR_SINGLE_P2M_BYTE(&ADC0->SINGLEDATA, NULL,
+                                                                 BATTERY_SAMPLES_PER_HALF);
+  Ecode_t                 ec;
+  uint32_t                i;
+
+  if(BATTERY_ENABLE == 0)
+    return;
+
+  // VBAT_OK, both edges wake the BLE loop
+  GPIO_PinModeSet(BATTERY_OK_PORT, BATTERY_OK_PIN, gpioModeInputPullFilter, 0);
+  GPIO_ExtIntConfig(BATTERY_OK_PORT, BATTERY_OK_PIN, BATTERY_OK_PIN, true, true, true);
+  vbatOk = (GPIO_PinInGet(BATTERY_OK_PORT, BATTERY_OK_PIN) != 0);
+
+  // ADC0 on the AUXHFRCO, it keeps converting in EM2
+  CMU_ClockEnable(cmuClock_ADC0, true);
+  CMU_AUXHFRCOBandSet(cmuAUXHFRCOFreq_4M0Hz);
+  CMU_ClockSelectSet(cmuClock_ADC0ASYNC, cmuSelect_AUXHFRCO);
+
+  ADC0->CTRL = ADC_CTRL_ADCCLKMODE_ASYNC | ADC_CTRL_ASYNCCLKEN_ASNEEDED | ADC_CTRL_SINGLEDMAWU |
+               ADC_CTRL_WARMUPMODE_NORMAL | (((ADC_CLOCK_HZ / 1000000) - 1) << _ADC_CTRL_TIMEBASE_SHIFT);
+  load_calibration();
+
+  // One conversion per PRS pulse, the divider is high impedance
+  ADC0->SINGLECTRL = ADC_SINGLECTRL_REF_2V5 | ADC_SINGLECTRL_RES_12BIT | BATTERY_ADC_POSSEL |
+                     ADC_SINGLECTRL_NEGSEL_VSS | ADC_SINGLECTRL_AT_256CYCLES |
+                     ADC_SINGLECTRL_PRSEN | ADC_SINGLECTRL_CMPEN;
+  ADC0->SINGLECTRLX = (BATTERY_PRS_CH << _ADC_SINGLECTRLX_PRSSEL_SHIFT) | ADC_SINGLECTRLX_PRSMODE_PULSED |
+                      ADC_SINGLECTRLX_FIFOOFACT_OVERWRITE;
+
+  // ADGT above ADLT: the comparator fires outside the window, below
+  // BATTERY_LOW_MV (a full scale result never happens)
+  ADC0->CMPTHR = (ADC_MAX_CODE << _ADC_CMPTHR_ADGT_SHIFT) |
+                 (MV_TO_CODE(BATTERY_LOW_MV) << _ADC_CMPTHR_ADLT_SHIFT);
+  ADC0->SINGLEFIFOCLEAR = ADC_SINGLEFIFOCLEAR_SINGLEFIFOCLEAR;
+  ADC0->IFC = _ADC_IFC_MASK;
+  ADC0->IEN = ADC_IEN_SINGLECMP;
+  NVIC_ClearPendingIRQ(ADC0_IRQn);
+  NVIC_EnableIRQ(ADC0_IRQn);
+
+  // The LETIMER0 underflow pulse is the trigger
+  CMU_ClockEnable(cmuClock_PRS, true);
+  PRS_SourceAsyncSignalSet(BATTERY_PRS_CH, PRS_CH_CTRL_SOURCESEL_LETIMER0, PRS_CH_CTRL_SIGSEL_LETIMER0CH0);
+
+  // A ring of two halves, each raises the only DMA interrupt
+  for(i = 0; i < 2; i++){
+    ring[i] = half;
+    ring[i].xfer.size = ldmaCtrlSizeHalf;
+    ring[i].xfer.dstAddr = (uint32_t) &samples[i][0];
+    ring[i].xfer.linkMode = ldmaLinkModeAbs;
+    ring[i].xfer.link = 1;
+    ring[i].xfer.linkAddr = ((uint32_t) &ring[i ^ 1]) >> 2;
+  }
+
+  // SPIDRV initialized DMADRV already, this only covers a build without it
+  ec = DMADRV_Init();
+  if((ec != ECODE_EMDRV_DMADRV_OK) && (ec != ECODE_EMDRV_DMADRV_ALREADY_INITIALIZED)){
+      LOG_ERROR("DMADRV_Init() returned != 0 status=0x%08x\r\n", (unsigned int) ec);
+      return;
+  }
+
+  ec = DMADRV_AllocateChannel(&channel, NULL);
+  if(ec != ECODE_EMDRV_DMADRV_OK){
+      LOG_ERROR("DMADRV_AllocateChannel() returned != 0 status=0x%08x\r\n", (unsigned int) ec);
+      return;
+  }
+
+  nextHalf = 0;
+  ec = DMADRV_LdmaStartTransfer((int) channel, &xfer, &ring[0], half_done, NULL);
+  if(ec != ECODE_EMDRV_DMADRV_OK){
+      LOG_ERROR("DMADRV_LdmaStartTransfer() returned != 0 status=0x%08x\r\n", (unsigned int) ec);
+      return;
+  }
+
+  ready = true;
+
+} // battery_init()
+
+/**
+ * @brief   Wakes the BLE loop for a full half buffer or a VBAT_OK edge, safe
+ *          to call from an interrupt handler
+ * @return  none
+ */
+void battery_from_isr(void) {
+
+  if(ready)
+    sl_bt_external_signal(1 << BATTERY_BIT_POS);
+
+} // battery_from_isr()
+
+/**
+ * @brief   Handles the window comparator of ADC0 from its interrupt handler:
+ *          raises the low battery alarm at once
+ * @return  none
+ */
+void battery_low_from_isr(void) {
+
+  // Every conversion would fire again, battery_process() re-arms it
+  ADC0->IEN &= ~ADC_IEN_SINGLECMP;
+
+  lowAlarm = true;
+  alarm_from_isr(BEACON_ALARM_LOW_BATTERY, true);
+
+} // battery_low_from_isr()
+
+/**
+ * @brief   Handles the BATTERY_BIT_POS external signal in the BLE loop
+ * @return  none
+ */
+void battery_process(void) {
+  CORE_DECLARE_IRQ_STATE;
+  bool     fresh;
+  bool     ok;
+  int32_t  sampleX16;
+  int32_t  previousX16;
+  uint32_t mv;
+
+  if(ready == false)
+    return;
+
+  CORE_ENTER_CRITICAL();
+  fresh = halfReady;
+  halfReady = false;
+  sampleX16 = (int32_t) (((uint32_t) halfCode * ADC_REF_MV * BATTERY_DIVIDER * FILTER_ONE) / ADC_FULL_SCALE);
+  CORE_EXIT_CRITICAL();
+
+  ok = (GPIO_PinInGet(BATTERY_OK_PORT, BATTERY_OK_PIN) != 0);
+  if(ok != vbatOk){
+    LOG_INFO("battery: VBAT_OK %u\r\n", (unsigned int) ok);
+    vbatOk = ok;
+  }
+
+  if(fresh){
+    previousX16 = mvX16;
+    if(haveSample == false){
+      mvX16 = sampleX16;
+      haveSample = true;
+    }
+    else {
+      mvX16 += (sampleX16 - mvX16) / (1 << BATTERY_EWMA_SHIFT);
+      trendX16 += ((mvX16 - previousX16) - trendX16) / (1 << BATTERY_EWMA_SHIFT);
+    }
+
+    mv = (uint32_t) (mvX16 / FILTER_ONE);
+    soc = soc_of(mv);
+
+    if((mv >= (uint32_t) reportedMv + BATTERY_REPORT_STEP_MV) ||
+       (mv + BATTERY_REPORT_STEP_MV <= (uint32_t) reportedMv)){
+      reportedMv = (uint16_t) mv;
+      report(TELEMETRY_SENSOR_BATTERY, (int16_t) mv);
+    }
+
+    if((reportedSoc == 0xFF) ||
+       (soc >= reportedSoc + BATTERY_REPORT_STEP_SOC) ||
+       (soc + BATTERY_REPORT_STEP_SOC <= reportedSoc)){
+      reportedSoc = soc;
+      report(TELEMETRY_SENSOR_SOC, soc);
+      beacon_update_battery(soc);
+    }
+  }
+
+  if(haveSample == false)
+    return;
+
+  // VBAT_OK low means the harvester is about to cut the load off
+  mv = (uint32_t) (mvX16 / FILTER_ONE);
+  if((lowAlarm == false) && ((mv < BATTERY_LOW_MV) || (vbatOk == false))){
+    lowAlarm = true;
+    alarm_from_isr(BEACON_ALARM_LOW_BATTERY, true);
+  }
+  // The comparator sees a drop a few halves before the filter does, the
+  // last half has to be above the hysteresis too or the alarm would flap
+  else if((lowAlarm == true) && (mv > BATTERY_LOW_MV + BATTERY_LOW_HYST_MV) &&
+          (sampleX16 > (BATTERY_LOW_MV + BATTERY_LOW_HYST_MV) * FILTER_ONE) && (vbatOk == true)){
+    LOG_INFO("battery: %u mV, low battery cleared\r\n", (unsigned int) mv);
+    lowAlarm = false;
+    alarm_from_isr(BEACON_ALARM_LOW_BATTERY, false);
+    ADC0->IFC = ADC_IFC_SINGLECMP;
+    ADC0->IEN |= ADC_IEN_SINGLECMP;
+  }
+
+} // battery_process()
+
+/**
+ * @brief   Returns the filtered battery voltage
+ * @return  mV, 0 before the first half buffer
+ */
+uint16_t battery_mv(void) {
+
+  return (uint16_t) (mvX16 / FILTER_ONE);
+
+} // battery_mv()
+
+/**
+ * @brief   Returns the state of charge
+ * @return  0 to 100 %
+ */
+uint8_t battery_soc(void) {
+
+  return soc;
+
+} // battery_soc()
+
+/**
+ * @brief   Returns how fast the battery voltage moves, positive while the
+ *          harvester brings in more than the helmet draws
+ * @return  mV per hour
+ */
+int32_t battery_trend_mv_per_hour(void) {
+
+  return (trendX16 * (MS_PER_HOUR / HALF_MS)) / FILTER_ONE;
+
+} // battery_trend_mv_per_hour()
+
+/**
+ * @brief   Returns the VBAT_OK output of the harvester
+ * @return  true while the cell is above the VBAT_OK threshold
+ */
+bool battery_vbat_ok(void) {
+
+  return vbatOk;
+
+} // battery_vbat_ok()
+
+#endif
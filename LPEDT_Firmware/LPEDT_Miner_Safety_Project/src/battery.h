@@ -0,0 +1,121 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    battery.h
+ * @brief   Header file for battery.c. Battery voltage, state of charge and
+ *          the VBAT_OK output of the bq25570 harvester, sampled by ADC0 on
+ *          the LETIMER0 underflow without waking the CPU
+ *
+ *          The LiPo cell is a 350 mAh LP552530, 4.2 V charged and 3.0 V at
+ *          the discharge cut-off. V_BAT reaches the ADC through a divider by
+ *          BATTERY_DIVIDER.
+ *
+ *          The voltage goes into telemetry as TELEMETRY_SENSOR_BATTERY (mV)
+ *          and the state of charge as TELEMETRY_SENSOR_SOC (%), each when it
+ *          moved by at least its step, and the state of charge into the
+ *          beacon.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#ifndef SRC_BATTERY_H_
+#define SRC_BATTERY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// 1 -> the helmet measures its battery
+#define BATTERY_ENABLE               1
+
+// V_BAT divider output, APORT3YCH3 is PD11
+#define BATTERY_ADC_POSSEL           (ADC_SINGLECTRL_POSSEL_APORT3YCH3)
+#define BATTERY_DIVIDER              (2)
+
+// VBAT_OK of the bq25570, high while the cell is above its VBAT_OK threshold
+#define BATTERY_OK_PORT              (gpioPortD)
+#define BATTERY_OK_PIN               (12)
+
+// PRS channel carrying the LETIMER0 underflow to ADC0
+#define BATTERY_PRS_CH               (5)
+
+// External signal bit of the BLE loop, next to ALARM_BIT_POS
+#define BATTERY_BIT_POS              (7)
+
+// Conversions per half of the DMA buffer, one per LETIMER_PERIOD_MS: the
+// CPU wakes once per half, every minute
+#define BATTERY_SAMPLES_PER_HALF     (20)
+
+// The window comparator wakes the CPU at once below this voltage, and the
+// low battery alarm clears BATTERY_LOW_HYST_MV above it
+#define BATTERY_LOW_MV               (3500)
+#define BATTERY_LOW_HYST_MV          (100)
+
+// Telemetry is only sent when the value moved by at least this
+#define BATTERY_REPORT_STEP_MV       (20)
+#define BATTERY_REPORT_STEP_SOC      (1)
+
+// EWMA weight of a new half buffer, 1 / 2^BATTERY_EWMA_SHIFT
+#define BATTERY_EWMA_SHIFT           (2)
+
+/**
+ * @brief   Configures ADC0, the PRS channel, the DMA ring and the VBAT_OK
+ *          pin, call once at boot after LETIMER0_Enable()
+ * @return  none
+ */
+void battery_init(void);
+
+/**
+ * @brief   Wakes the BLE loop for a full half buffer or a VBAT_OK edge, safe
+ *          to call from an interrupt handler
+ * @return  none
+ */
+void battery_from_isr(void);
+
+/**
+ * @brief   Handles the window comparator of ADC0 from its interrupt handler:
+ *          raises the low battery alarm at once
+ * @return  none
+ */
+void battery_low_from_isr(void);
+
+/**
+ * @brief   Handles the BATTERY_BIT_POS external signal in the BLE loop
+ * @return  none
+ */
+void battery_process(void);
+
+/**
+ * @brief   Returns the filtered battery voltage
+ * @return  mV, 0 before the first half buffer
+ */
+uint16_t battery_mv(void);
+
+/**
+ * @brief   Returns the state of charge
+ * @return  0 to 100 %
+ */
+uint8_t battery_soc(void);
+
+/**
+ * @brief   Returns how fast the battery voltage moves, positive while the
+ *          harvester brings in more than the helmet draws
+ * @return  mV per hour
+ */
+int32_t battery_trend_mv_per_hour(void);
+
+/**
+ * @brief   Returns the VBAT_OK output of the harvester
+ * @return  true while the cell is above the VBAT_OK threshold
+ */
+bool battery_vbat_ok(void);
+
+#endif /* SRC_BATTERY_H_ */
@@ -0,0 +1,229 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    beacon.c
+ * @brief   Connectionless sensor summary broadcast in manufacturer specific
+ *          advertising data
+ *
+ *          A second, non-connectable advertising set runs next to the
+ *          connectable one, so that a gateway can collect the summary of every
+ *          helmet in range without connecting. The summary fits a legacy
+ *          advertising PDU. Every update patches the changed field in place
+ *          and hands the packet to the stack with sl_bt_advertiser_set_data(),
+ *          which is used from the next advertising event on.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include "beacon.h"
+#include "ble.h"
+
+// Include logging for this file
+#define INCLUDE_LOG_DEBUG 1
+#include "log.h"
+
+// AD structure types
+#define AD_TYPE_FLAGS                 (0x01)
+#define AD_TYPE_MANUFACTURER_SPECIFIC (0xFF)
+
+// LE General Discoverable, BR/EDR not supported
+#define AD_FLAGS_VALUE                (0x06)
+
+// Offsets into advData[]
+#define BEACON_OFFSET_VERSION         (7)
+#define BEACON_OFFSET_SEQ             (8)
+#define BEACON_OFFSET_ALARMS          (9)
+#define BEACON_OFFSET_TEMPERATURE     (10)
+#define BEACON_OFFSET_GAS             (12)
+#define BEACON_OFFSET_BATTERY         (14)
+#define BEACON_ADV_DATA_LENGTH        (15)
+
+static uint8_t advData[BEACON_ADV_DATA_LENGTH] = {
+  2,  AD_TYPE_FLAGS, AD_FLAGS_VALUE,
+  11, AD_TYPE_MANUFACTURER_SPECIFIC,
+  (uint8_t) BEACON_COMPANY_ID, (uint8_t) (BEACON_COMPANY_ID >> 8),
+  BEACON_FORMAT_VERSION,
+  0,                                                                  // sequence number
+  0,                                                                  // alarm flags
+  0, 0,                                                               // temperature
+  (uint8_t) BEACON_VALUE_NOT_AVAILABLE, (uint8_t) (BEACON_VALUE_NOT_AVAILABLE >> 8), // gas
+  0xFF,                                                               // battery
+};
+
+static uint8_t  beaconHandle;
+static bool     beaconRunning = false;
+static uint16_t normalInterval = BEACON_INTERVAL_NORMAL;
+
+/**
+ * @brief   (Re)starts broadcasting with the interval the alarm state calls for
+ * @return  none
+ */
+static void beacon_start(void) {
+  sl_status_t sc;
+  uint32_t    interval = (advData[BEACON_OFFSET_ALARMS] != 0) ? BEACON_INTERVAL_ALARM : normalInterval;
+
+  if(beaconRunning){
+    sc = sl_bt_advertiser_stop(beaconHandle);
+    if (sc != SL_STATUS_OK) {
+        LOG_ERROR("sl_bt_advertiser_stop() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+    }
+  }
+
+  // Timing only takes effect when advertising is (re)started
+  sc = sl_bt_advertiser_set_timing(
+          beaconHandle, // advertising set handle
+          interval,     // min. adv. interval (milliseconds * 1.6)
+          interval,     // max. adv. interval (milliseconds * 1.6)
+          0,            // adv. duration
+          0);           // max. num. adv. events
+  if (sc != SL_STATUS_OK) {
+      LOG_ERROR("sl_bt_advertiser_set_timing() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+  }
+
+  sc = sl_bt_advertiser_set_data(beaconHandle, 0, BEACON_ADV_DATA_LENGTH, &advData[0]);
+  if (sc != SL_STATUS_OK) {
+      LOG_ERROR("sl_bt_advertiser_set_data() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+  }
+
+  sc = sl_bt_advertiser_start(
+          beaconHandle,
+          sl_bt_advertiser_user_data,
+          sl_bt_advertiser_non_connectable);
+  if (sc != SL_STATUS_OK) {
+      LOG_ERROR("sl_bt_advertiser_start() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+      beaconRunning = false;
+      return;
+  }
+
+  beaconRunning = true;
+}
+
+/**
+ * @brief   Publishes the patched packet with a new sequence number
+ * @return  none
+ */
+static void beacon_publish(void) {
+  sl_status_t sc;
+
+  if(beaconRunning == false)
+    return;
+
+  advData[BEACON_OFFSET_SEQ]++;
+
+  sc = sl_bt_advertiser_set_data(beaconHandle, 0, BEACON_ADV_DATA_LENGTH, &advData[0]);
+  if (sc != SL_STATUS_OK) {
+      LOG_ERROR("sl_bt_advertiser_set_data() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+  }
+}
+
+/**
+ * @brief   Creates the non-connectable advertising set and starts
+ *          broadcasting, call once at boot
+ * @return  none
+ */
+void beacon_init(void) {
+  sl_status_t sc;
+
+  if(BEACON_MODE_ENABLE == 0)
+    return;
+
+  sc = sl_bt_advertiser_create_set(&beaconHandle);
+  if (sc != SL_STATUS_OK) {
+      LOG_ERROR("sl_bt_advertiser_create_set() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+      return;
+  }
+
+  beacon_start();
+
+} // beacon_init()
+
+/**
+ * @brief   Updates the temperature in the broadcast
+ * @param   centiDegC   temperature in 0.01 degC
+ * @return  none
+ */
+void beacon_update_temperature(int16_t centiDegC) {
+
+  advData[BEACON_OFFSET_TEMPERATURE]     = (uint8_t) centiDegC;
+  advData[BEACON_OFFSET_TEMPERATURE + 1] = (uint8_t) (((uint16_t) centiDegC) >> 8);
+  beacon_publish();
+
+} // beacon_update_temperature()
+
+/**
+ * @brief   Updates the gas reading in the broadcast
+ * @param   ppm     gas concentration
+ * @return  none
+ */
+void beacon_update_gas(uint16_t ppm) {
+
+  advData[BEACON_OFFSET_GAS]     = (uint8_t) ppm;
+  advData[BEACON_OFFSET_GAS + 1] = (uint8_t) (ppm >> 8);
+  beacon_publish();
+
+} // beacon_update_gas()
+
+/**
+ * @brief   Updates the battery level in the broadcast
+ * @param   percent   0 to 100
+ * @return  none
+ */
+void beacon_update_battery(uint8_t percent) {
+
+  advData[BEACON_OFFSET_BATTERY] = percent;
+  beacon_publish();
+
+} // beacon_update_battery()
+
+/**
+ * @brief   Sets or clears an alarm flag
+ * @param   alarm   flag, see beacon_alarm_t
+ * @param   active  true to set the flag
+ * @return  none
+ */
+void beacon_set_alarm(beacon_alarm_t alarm, bool active) {
+  uint8_t previous = advData[BEACON_OFFSET_ALARMS];
+
+  if(active)
+    advData[BEACON_OFFSET_ALARMS] |= alarm;
+  else
+    advData[BEACON_OFFSET_ALARMS] &= ~alarm;
+
+  if(advData[BEACON_OFFSET_ALARMS] == previous)
+    return;
+
+  beacon_publish();
+
+  // Entering or leaving the alarm state changes the interval
+  if((previous == 0) != (advData[BEACON_OFFSET_ALARMS] == 0)){
+    if(beaconRunning)
+      beacon_start();
+  }
+
+} // beacon_set_alarm()
+
+/**
+ * @brief   Sets the interval outside alarms, the alarm interval stays
+ *          BEACON_INTERVAL_ALARM
+ * @param   interval    value x 0.625 ms
+ * @return  none
+ */
+void beacon_set_interval(uint16_t interval) {
+
+  if(interval == normalInterval)
+    return;
+  normalInterval = interval;
+
+  if(beaconRunning && (advData[BEACON_OFFSET_ALARMS] == 0))
+    beacon_start();
+
+} // beacon_set_interval()
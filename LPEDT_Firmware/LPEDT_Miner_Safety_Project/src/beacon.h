@@ -0,0 +1,102 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    beacon.h
+ * @brief   Header file for beacon.c. Connectionless sensor summary broadcast
+ *          in manufacturer specific advertising data
+ *
+ *          Manufacturer specific data, after the 2 byte company ID
+ *          (little endian):
+ *            [0]      BEACON_FORMAT_VERSION
+ *            [1]      sequence number, incremented on every update
+ *            [2]      alarm flags, see beacon_alarm_t
+ *            [3..4]   temperature, int16, 0.01 degC
+ *            [5..6]   gas, uint16, ppm, BEACON_VALUE_NOT_AVAILABLE if none
+ *            [7]      battery, %, 0xFF if not available
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#ifndef SRC_BEACON_H_
+#define SRC_BEACON_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// 1 -> broadcast the sensor summary next to the connectable advertiser
+// 0 -> data only flows inside a connection
+#define BEACON_MODE_ENABLE           1
+
+#define BEACON_FORMAT_VERSION        (1)
+
+// 0xFFFF is the Bluetooth SIG company ID reserved for testing
+#define BEACON_COMPANY_ID            (0xFFFF)
+
+#define BEACON_VALUE_NOT_AVAILABLE   (0xFFFF)
+
+// Advertising interval, value x 0.625 ms
+#define BEACON_INTERVAL_NORMAL       (1600)  // 1 s
+#define BEACON_INTERVAL_ALARM        (160)   // 100 ms
+
+typedef enum {
+  BEACON_ALARM_SOS         = 0x01,
+  BEACON_ALARM_GAS         = 0x02,
+  BEACON_ALARM_FALL        = 0x04,
+  BEACON_ALARM_LOW_BATTERY = 0x08,
+} beacon_alarm_t;
+
+/**
+ * @brief   Creates the non-connectable advertising set and starts
+ *          broadcasting, call once at boot
+ * @return  none
+ */
+void beacon_init(void);
+
+/**
+ * @brief   Updates the temperature in the broadcast
+ * @param   centiDegC   temperature in 0.01 degC
+ * @return  none
+ */
+void beacon_update_temperature(int16_t centiDegC);
+
+/**
+ * @brief   Updates the gas reading in the broadcast
+ * @param   ppm     gas concentration
+ * @return  none
+ */
+void beacon_update_gas(uint16_t ppm);
+
+/**
+ * @brief   Updates the battery level in the broadcast
+ * @param   percent   0 to 100
+ * @return  none
+ */
+void beacon_update_battery(uint8_t percent);
+
+/**
+ * @brief   Sets or clears an alarm flag. Broadcasting switches to
+ *          BEACON_INTERVAL_ALARM while any flag is set.
+ * @param   alarm   flag, see beacon_alarm_t
+ * @param   active  true to set the flag
+ * @return  none
+ */
+void beacon_set_alarm(beacon_alarm_t alarm, bool active);
+
+/**
+ * @brief   Sets the interval outside alarms, the alarm interval stays
+ *          BEACON_INTERVAL_ALARM
+ * @param   interval    value x 0.625 ms
+ * @return  none
+ */
+void beacon_set_interval(uint16_t interval);
+
+#endif /* SRC_BEACON_H_ */
@@ -20,7 +20,21 @@
 #include "lcd.h"
 #include "scheduler.h"
 #include "gpio.h"
-#include <math.h>
+#include "ringbuf.h"
+#include "telemetry.h"
+#include "stream.h"
+#include "connparams.h"
+#include "beacon.h"
+#include "gateway.h"
+#include "bonding.h"
+#include "fwupdate.h"
+#include "journal.h"
+#include "zone.h"
+#include "alarm.h"
+#include "battery.h"
+#include "governor.h"
+#include "energy.h"
+#include "ieee11073.h"
 #include <string.h> // for memcpy()
 
 
@@ -34,19 +48,6 @@
 
 #define BUTTON_ON 0x01
 #define BUTTON_OFF 0x00
-/*
- * bit 0-2 : Connectable scannable, undirected advertising-> 000
- * bit 3-4 : Future Use -> 00
- * bit 5-6 : Data Complete -> 00
- * bit 7   : Legacy advertising PDUs used ->0
- */
-#define PACKET_TYPE  0
-
-#if BUILD_INCLUDES_BLE_CLIENT == 1
-bd_addr serverAddress = SERVER_BT_ADDRESS;
-bd_addr scannerAddress;
-#endif
-
 // BLE private data
 ble_data_struct_t ble_data;
 
@@ -74,35 +75,35 @@ typedef enum uint16_t{
 
 #if BUILD_INCLUDES_BLE_SERVER == 1
 
-// Declare memory for the queue/buffer, and our write and read pointers.
-queue_struct_t   my_queue[QUEUE_DEPTH]; // the queue
-uint32_t         wptr = 0;              // write pointer
-uint32_t         rptr = 0;              // read pointer
+// One SPSC ring per priority lane. Every record is the 2 byte characteristic
+// handle followed by the indication payload, so entries only take the space
+// they need and can be as large as the negotiated ATT payload.
+// read_queue() always serves QUEUE_LANE_ALARM before QUEUE_LANE_ROUTINE.
+#define QUEUE_RECORD_HEADER  (2) // charHandle
 
-// Student edit:
-// Decide how will you handle the full condition.
+static uint8_t   queue_storage[QUEUE_NUMBER_OF_LANES][QUEUE_LANE_SIZE];
+ringbuf_t        my_queue[QUEUE_NUMBER_OF_LANES];
 
-bool         queue_full = false;  // flag to denote the queue is full
-bool         queue_empty = true;  // flag to denote the queue is empty
+// true while the SOFT_TIMER_1 fallback drain timer is running
+static bool drain_timer_running = false;
 
 
 
 // ---------------------------------------------------------------------
-// Private function used only by this .c file.
-// Compute the next ptr value. Given a valid ptr value, compute the next valid
-// value of the ptr and return it.
-// Isolation of functionality: This defines "how" a pointer advances.
+// Private function.
+// Returns the highest priority lane that holds a record, NULL if all lanes
+// are empty.
 // ---------------------------------------------------------------------
-static uint32_t nextPtr(uint32_t ptr) {
+static ringbuf_t *next_lane(void) {
+
+  for(uint32_t lane=0; lane<QUEUE_NUMBER_OF_LANES; lane++){
+    if(ringbuf_depth(&my_queue[lane]) > 0)
+      return &my_queue[lane];
+  }
 
-  // Student edit:
-  // Create this function
-  if(ptr+1 == QUEUE_DEPTH)
-    return 0;
-  else
-    return ptr+1;
+  return NULL;
 
-} // nextPtr()
+} // next_lane()
 
 // ---------------------------------------------------------------------
 // Public function.
@@ -110,221 +111,330 @@ static uint32_t nextPtr(uint32_t ptr) {
 // ---------------------------------------------------------------------
 void reset_queue (void) {
 
-  // Student edit:
-  // Create this function
-
-  // Creating an array with value 0 which can be used to overwrite any existing
-  // data in the queue
-  uint8_t reset_buffer[MAX_BUFFER_LENGTH];
-  for(uint32_t i=0; i<MAX_BUFFER_LENGTH; i++){
-    reset_buffer[i] = 0;
+  for(uint32_t lane=0; lane<QUEUE_NUMBER_OF_LANES; lane++){
+    ringbuf_init(&my_queue[lane], &queue_storage[lane][0], QUEUE_LANE_SIZE);
   }
 
-  // Iterate through the queue and reset all variables
-  for(uint32_t i=0; i<QUEUE_DEPTH; i++){
-    my_queue[i].charHandle = 0;
-    my_queue[i].bufLength = 0;
-    memcpy(&my_queue[i].buffer, &reset_buffer, MAX_BUFFER_LENGTH);
-  }
-
-  // reset the read/write pointers and queue flags
-  wptr = 0;
-  rptr = 0;
-  queue_full = false;
-  queue_empty = true;
-
 } // reset_queue()
 
 // ---------------------------------------------------------------------
 // Public function.
-// This function writes an entry to the queue if the the queue is not full.
-// Input parameter "charHandle" should be written to queue_struct_t element "charHandle".
-// Input parameter "bufLength" should be written to queue_struct_t element "bufLength"
-// The bytes pointed at by input parameter "buffer" should be written to queue_struct_t element "buffer"
-// Returns bool false if successful or true if writing to a full fifo.
-// i.e. false means no error, true means an error occurred.
+// Reserves room for an entry in the given priority lane and returns where the
+// bufLength payload bytes have to be written, NULL if the lane is full or the
+// length is out of range. The entry is only queued once commit_queue_lane()
+// is called.
 // ---------------------------------------------------------------------
-bool write_queue (uint16_t charHandle, uint32_t bufLength, uint8_t *buffer) {
+uint8_t *reserve_queue_lane (queue_lane_t lane, uint16_t charHandle, uint32_t bufLength) {
+  uint8_t *p;
 
-  // Student edit:
-  // Create this function
-  // Decide how you want to handle the "full" condition.
+  if(lane >= QUEUE_NUMBER_OF_LANES)
+    return NULL;
 
-  // Don't forget to range check bufLength.
-  // Isolation of functionality:
-  //     Create the logic for "when" a pointer advances.
+  // Check if the given buffer length is within the defined limits, it must
+  // fit in a single indication on the current connection
+  if((bufLength > get_ble_data_ptr()->attPayloadSize) || (bufLength < MIN_BUFFER_LENGTH))
+    return NULL;
 
-  // Check if the queue is full and return error if true
-  if(queue_full)
-    return true;
+  p = ringbuf_reserve(&my_queue[lane], QUEUE_RECORD_HEADER + bufLength);
+  if(p == NULL)
+    return NULL;
 
-  // Check if the given buffer length is within the defined limits
-  if((bufLength > MAX_BUFFER_LENGTH) || (bufLength < MIN_BUFFER_LENGTH))
-    return true;
+  p[0] = (uint8_t) charHandle;
+  p[1] = (uint8_t) (charHandle >> 8);
 
-  // Set the queue full flag if the queue would be full after the current data
-  // insertion
-  if(nextPtr(wptr) == rptr){
-    queue_full = true;
-  }
+  return &p[QUEUE_RECORD_HEADER];
 
-  // Insert the data
-  my_queue[wptr].charHandle = charHandle;
-  my_queue[wptr].bufLength = bufLength;
+} // reserve_queue_lane()
 
-  for(uint32_t i=0; i<bufLength; i++){
-    my_queue[wptr].buffer[i] = buffer[i];
-  }
+// ---------------------------------------------------------------------
+// Public function.
+// Queues the entry opened by reserve_queue_lane().
+// ---------------------------------------------------------------------
+void commit_queue_lane (queue_lane_t lane, uint32_t bufLength) {
+
+  if(lane >= QUEUE_NUMBER_OF_LANES)
+    return;
 
-  if(queue_empty)
-    queue_empty = false;
+  ringbuf_commit(&my_queue[lane], QUEUE_RECORD_HEADER + bufLength);
 
-  // Increment the write pointer if the queue is not full
-  if(!queue_full)
-    wptr = nextPtr(wptr);
+} // commit_queue_lane()
+
+// ---------------------------------------------------------------------
+// Public function.
+// Writes an entry to the given priority lane if that lane is not full.
+// Returns bool false if successful or true if writing to a full fifo or the
+// arguments are out of range.
+// ---------------------------------------------------------------------
+bool write_queue_lane (queue_lane_t lane, uint16_t charHandle, uint32_t bufLength, uint8_t *buffer) {
+  uint8_t *p = reserve_queue_lane(lane, charHandle, bufLength);
+
+  if(p == NULL)
+    return true;
+
+  memcpy(p, buffer, bufLength);
+  commit_queue_lane(lane, bufLength);
 
   return false;
+} // write_queue_lane()
+
+// ---------------------------------------------------------------------
+// Public function.
+// This function writes an entry to the routine lane of the queue if the the
+// queue is not full.
+// Input parameter "charHandle" is stored ahead of the payload.
+// Input parameter "bufLength" is the length of the payload, up to the ATT
+// payload size of the current connection.
+// The bytes pointed at by input parameter "buffer" are the payload.
+// Returns bool false if successful or true if writing to a full fifo.
+// i.e. false means no error, true means an error occurred.
+// ---------------------------------------------------------------------
+bool write_queue (uint16_t charHandle, uint32_t bufLength, uint8_t *buffer) {
+
+  return write_queue_lane(QUEUE_LANE_ROUTINE, charHandle, bufLength, buffer);
+
 } // write_queue()
 
 // ---------------------------------------------------------------------
 // Public function.
 // This function reads an entry from the queue, and returns values to the
-// caller. The values from the queue entry are returned by writing
+// caller. Entries of the alarm lane are always returned before entries of
+// the routine lane. The values from the queue entry are returned by writing
 // the values to variables declared by the caller, where the caller is passing
 // in pointers to charHandle, bufLength and buffer. The caller's code will look like this:
 //
 //   uint16_t     charHandle;
 //   uint32_t     bufLength;
-//   uint8_t      buffer[5];
+//   uint8_t      buffer[MAX_BUFFER_LENGTH];
 //
 //   status = read_queue (&charHandle, &bufLength, &buffer[0]);
 //
-// *** If the code above doesn't make sense to you, you probably lack the
-// necessary prerequisite knowledge to be successful in this course.
-//
-// Write the values of charHandle, bufLength, and buffer from my_queue[rptr] to
-// the memory addresses pointed at by charHandle, bufLength and buffer, like this :
-//      *charHandle = <something>;
-//      *bufLength  = <something_else>;
-//      *buffer     = <something_else_again>; // perhaps memcpy() would be useful?
-//
-// In this implementation, we do it this way because
-// standard C does not provide a mechanism for a C function to return multiple
-// values, as is common in perl or python.
 // Returns bool false if successful or true if reading from an empty fifo.
 // i.e. false means no error, true means an error occurred.
 // ---------------------------------------------------------------------
 bool read_queue (uint16_t *charHandle, uint32_t *bufLength, uint8_t *buffer) {
+  ringbuf_t     *q = next_lane();
+  const uint8_t *p;
+  uint32_t       len;
 
-  // Student edit:
-  // Create this function
-
-  // Isolation of functionality:
-  //     Create the logic for "when" a pointer advances
-
-  // Check if the queue is empty and return error if true
-  if(queue_empty)
+  // Every lane is empty, return error
+  if(q == NULL)
     return true;
 
-  // Set the queue empty flag if the queue shall be empty after the current read
-  // operation
-  if(nextPtr(rptr) == wptr)
-    queue_empty = true;
+  p = ringbuf_peek(q, &len);
+  if(p == NULL)
+    return true;
 
   // Copy the data from queue to the user arguments
-  *charHandle = my_queue[rptr].charHandle;
-  *bufLength = my_queue[rptr].bufLength;
-  memcpy(buffer, &my_queue[rptr].buffer, my_queue[rptr].bufLength);
+  *charHandle = p[0] | (p[1] << 8);
+  *bufLength = len - QUEUE_RECORD_HEADER;
+  memcpy(buffer, &p[QUEUE_RECORD_HEADER], *bufLength);
 
-  // Increment the read pointer and if the queue is full, clear that flag and
-  // increment the write pointer
-  rptr = nextPtr(rptr);
-
-  if(queue_full){
-    queue_full = false;
-    wptr = nextPtr(wptr);
-  }
+  ringbuf_release(q);
 
   return false;
 } // read_queue()
 
 // ---------------------------------------------------------------------
 // Public function.
-// This function returns the wptr, rptr, full and empty values, writing
-// to memory using the pointer values passed in, same rationale as read_queue()
+// This function returns the write and read positions, full and empty values
+// of the routine lane, writing to memory using the pointer values passed in,
+// same rationale as read_queue(). Positions are byte offsets in the lane's ring.
+// Full means not even a MIN_BUFFER_LENGTH entry can be written.
 // The "_" characters are used to disambiguate the global variable names from
 // the input parameter names, such that there is no room for the compiler to make a
 // mistake in interpreting your intentions.
 // ---------------------------------------------------------------------
 void get_queue_status (uint32_t *_wptr, uint32_t *_rptr, bool *_full, bool *_empty) {
+  ringbuf_t *q = &my_queue[QUEUE_LANE_ROUTINE];
 
-  // Student edit:
-  // Create this function
-
-  *_wptr = wptr;
-  *_rptr = rptr;
-  *_full = queue_full;
-  *_empty = queue_empty;
+  *_wptr = q->head & q->mask;
+  *_rptr = q->tail & q->mask;
+  *_full = !ringbuf_fits(q, QUEUE_RECORD_HEADER + MIN_BUFFER_LENGTH);
+  *_empty = (ringbuf_depth(q) == 0);
 
 } // get_queue_status()
 
 // ---------------------------------------------------------------------
 // Public function.
-// Function that computes the number of written entries currently in the queue. If there
-// are 3 entries in the queue, it should return 3. If the queue is empty it should
-// return 0. If the queue is full it should return either QUEUE_DEPTH if
-// USE_ALL_ENTRIES==1 otherwise returns QUEUE_DEPTH-1.
+// Function that returns the number of written entries currently in the queue,
+// summed over all lanes. If there are 3 entries in the queue, it should
+// return 3. If the queue is empty it should return 0. O(1) per lane.
 // ---------------------------------------------------------------------
 uint32_t get_queue_depth() {
+  uint32_t depth = 0;
 
-  // Student edit:
-  // Create this function
-  if(queue_empty)
-    return 0;
-  else if(queue_full)
-    return QUEUE_DEPTH;
-  else{
-    uint32_t queue_depth_ctr = 0, i=rptr;
-    while(i != wptr){
-      queue_depth_ctr++;
-      i = nextPtr(i);
-    }
-    return queue_depth_ctr;
+  for(uint32_t lane=0; lane<QUEUE_NUMBER_OF_LANES; lane++){
+    depth += ringbuf_depth(&my_queue[lane]);
   }
 
+  return depth;
+
 } // get_queue_depth()
 
-#endif
+// ---------------------------------------------------------------------
+// Private function.
+// Starts or stops the SOFT_TIMER_1 fallback drain timer. It only runs while
+// something is waiting in the queue, draining is normally driven by the
+// indication confirmation event.
+// ---------------------------------------------------------------------
+static void set_drain_timer(bool run) {
+  sl_status_t sc;
 
-#if BUILD_INCLUDES_BLE_CLIENT == 1
-// -----------------------------------------------
-// Private function, original from Dan Walkes. I fixed a sign extension bug.
-// We'll need this for Client A7 assignment to convert health thermometer
-// indications back to an integer. Convert IEEE-11073 32-bit float to signed integer.
-// -----------------------------------------------
-static int32_t FLOAT_TO_INT32(const uint8_t *buffer_ptr)
-{
-  uint8_t signByte = 0;
-  int32_t mantissa;
-  // input data format is:
-  // [0] = flags byte, bit[0] = 0 -> Celsius; =1 -> Fahrenheit
-  // [3][2][1] = mantissa (2's complement)
-  // [4] = exponent (2's complement)
-  // BT buffer_ptr[0] has the flags byte
-  int8_t exponent = (int8_t)buffer_ptr[4];
-  // sign extend the mantissa value if the mantissa is negative
-  if (buffer_ptr[3] & 0x80) { // msb of [3] is the sign of the mantissa
-      signByte = 0xFF;
+  if(run == drain_timer_running)
+    return;
+
+  // a timeout of 0 stops the soft timer
+  sc = sl_bt_system_set_soft_timer((run ? SOFT_TIMER_TICK_VALUE_200ms : 0), SOFT_TIMER_1, false);
+  if(sc != SL_STATUS_OK){
+      LOG_ERROR("sl_bt_system_set_soft_timer() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+      return;
   }
-  mantissa = (int32_t) (buffer_ptr[1] << 0) |
-                       (buffer_ptr[2] << 8) |
-                       (buffer_ptr[3] << 16) |
-                       (signByte << 24) ;
 
-  // value = 10^exponent * mantissa, pow() returns a double type
-  return (int32_t) (pow(10, exponent) * mantissa);
+  drain_timer_running = run;
+}
+
+// ---------------------------------------------------------------------
+// Private function.
+// Returns true if the client currently accepts indications on charHandle.
+// ---------------------------------------------------------------------
+static bool indication_enabled(uint16_t charHandle) {
+  ble_data_struct_t *ble_data = get_ble_data_ptr();
+
+  if(charHandle == gattdb_temperature_measurement)
+    return ble_data->ok_to_send_htm_indications;
+
+  if(charHandle == gattdb_button_state)
+    return ble_data->ok_to_send_button_indications;
+
+  return false;
+}
+
+// ---------------------------------------------------------------------
+// Public function.
+// Sends the next queued indication if the link is free. Called whenever the
+// previous indication has been confirmed or timed out, when something new is
+// queued, and from the SOFT_TIMER_1 fallback.
+// Entries for characteristics the client has since unsubscribed from are
+// dropped.
+// ---------------------------------------------------------------------
+void drain_indication_queue(void) {
+  sl_status_t        sc;
+  ble_data_struct_t *ble_data = get_ble_data_ptr();
+  ringbuf_t         *q;
+  const uint8_t     *p;
+  uint32_t           len;
+  uint16_t           charHandle;
+
+  while((ble_data->connection_open == true) &&
+        (ble_data->indication_in_flight == false) &&
+        ((q = next_lane()) != NULL) &&
+        ((p = ringbuf_peek(q, &len)) != NULL)){
+
+    charHandle = p[0] | (p[1] << 8);
+
+    // Indications for characteristics the client unsubscribed from are dropped
+    if(indication_enabled(charHandle)){
+      // Server Sending the Indication, straight out of the ring
+      sc = sl_bt_gatt_server_send_indication(
+            ble_data->connectionHandle,
+            charHandle,
+            len - QUEUE_RECORD_HEADER,
+            &p[QUEUE_RECORD_HEADER]
+           );
+      if (sc != SL_STATUS_OK) {
+          // The record stays at the head of its lane, the SOFT_TIMER_1
+          // fallback retries it once the stack has buffers again
+          LOG_ERROR("sl_bt_gatt_server_send_indication() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+          break;
+      }
+      ble_data->indication_in_flight = true;
+      if((q == &my_queue[QUEUE_LANE_ALARM]) && (charHandle == gattdb_button_state))
+        alarm_stamp(ALARM_STAGE_INDICATION);
+    }
+
+    // Released once sent, or when the client unsubscribed from it
+    ringbuf_release(q);
+  }
+
+  // Keep the fallback timer only while there is a backlog
+  set_drain_timer((ble_data->connection_open == true) && (get_queue_depth() > 0));
+} // drain_indication_queue()
+
+// ---------------------------------------------------------------------
+// Public function.
+// Queues an indication in the given priority lane and sends it straight away
+// if nothing is in flight. Returns bool false if successful or true if the
+// lane is full.
+// ---------------------------------------------------------------------
+bool send_indication(queue_lane_t lane, uint16_t charHandle, uint32_t bufLength, uint8_t *buffer) {
+  bool status;
+
+  status = write_queue_lane(lane, charHandle, bufLength, buffer);
+  if(status){
+      LOG_ERROR("Indication queue lane %d full, dropping handle %d\r\n", (int) lane, (int) charHandle);
+  }
+
+  drain_indication_queue();
+
+  return status;
+} // send_indication()
+
+// ---------------------------------------------------------------------
+// Private function.
+// Applies ble_data->advertisingInterval, timing only takes effect when the
+// advertiser is (re)started.
+// ---------------------------------------------------------------------
+static void set_advertising_timing(void) {
+  sl_status_t sc;
+  ble_data_struct_t *ble_data = get_ble_data_ptr();
+
+  sc = sl_bt_advertiser_set_timing(
+          ble_data->advertisingSetHandle, // advertising set handle
+          ble_data->advertisingInterval, // min. adv. interval (milliseconds * 1.6)
+          ble_data->advertisingInterval, // max. adv. interval (milliseconds * 1.6)
+          0,   // adv. duration
+          0);  // max. num. adv. events
+  if (sc != SL_STATUS_OK) {
+      LOG_ERROR("sl_bt_advertiser_set_timing() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+  }
+} // set_advertising_timing()
+
+// ---------------------------------------------------------------------
+// Public function.
+// Sets the connectable advertising interval and the beacon interval, as the
+// governor profile calls for. The connectable advertiser only runs while no
+// connection is open, otherwise the new interval waits for the restart on
+// disconnect.
+// ---------------------------------------------------------------------
+void ble_set_advertising_intervals(uint16_t advInterval, uint16_t beaconInterval) {
+  sl_status_t sc;
+  ble_data_struct_t *ble_data = get_ble_data_ptr();
+
+  beacon_set_interval(beaconInterval);
+
+  if(advInterval == ble_data->advertisingInterval)
+    return;
+  ble_data->advertisingInterval = advInterval;
+
+  if(ble_data->connection_open == true)
+    return;
+
+  sc = sl_bt_advertiser_stop(ble_data->advertisingSetHandle);
+  if(sc != SL_STATUS_OK){
+      LOG_ERROR("sl_bt_advertiser_stop() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+  }
+
+  set_advertising_timing();
+
+  sc = sl_bt_advertiser_start(
+          ble_data->advertisingSetHandle,
+          sl_bt_advertiser_general_discoverable,
+          sl_bt_advertiser_connectable_scannable);
+  if(sc != SL_STATUS_OK){
+      LOG_ERROR("sl_bt_advertiser_start() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+  }
+} // ble_set_advertising_intervals()
 
-} // FLOAT_TO_INT32
 #endif
 
 /**
@@ -335,10 +445,12 @@ static int32_t FLOAT_TO_INT32(const uint8_t *buffer_ptr)
 void handle_ble_event(sl_bt_msg_t *evt){
   sl_status_t sc; // status code
   ble_data_struct_t *ble_data = get_ble_data_ptr();
-  static bool confirm_flag = false;
+  static uint8_t confirm_connection; // connection waiting for the passkey confirmation
+  uint16_t max_mtu; // ATT_MTU selected by the stack
 
 #if BUILD_INCLUDES_BLE_CLIENT == 1
   int32_t temp_data = 0;
+  gateway_slot_t *slot;
 #endif
 
   switch (SL_BT_MSG_ID(evt->header)) {
@@ -372,16 +484,10 @@ void handle_ble_event(sl_bt_msg_t *evt){
           LOG_ERROR("sl_bt_advertiser_create_set() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
       }
 
-      // Setting the Advertising minimum and maximum to 250mS
-      sc = sl_bt_advertiser_set_timing(
-              ble_data->advertisingSetHandle, // advertising set handle
-              400, // min. adv. interval (milliseconds * 1.6)
-              400, // max. adv. interval (milliseconds * 1.6)
-              0,   // adv. duration
-              0);  // max. num. adv. events
-      if (sc != SL_STATUS_OK) {
-          LOG_ERROR("sl_bt_advertiser_set_timing() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
-      }
+      // Setting the Advertising minimum and maximum to 250mS, the governor
+      // stretches it as the battery runs down
+      ble_data->advertisingInterval = ADVERTISING_INTERVAL_DEFAULT;
+      set_advertising_timing();
 
       // Starting advertiser
       sc = sl_bt_advertiser_start(
@@ -392,11 +498,15 @@ void handle_ble_event(sl_bt_msg_t *evt){
           LOG_ERROR("sl_bt_advertiser_start() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
       }
 
-      sc = sl_bt_system_set_soft_timer(SOFT_TIMER_TICK_VALUE_200ms, SOFT_TIMER_1, false);
+      // Sensor summary for gateways, broadcast next to the connectable set
+      beacon_init();
 
-      if(sc != SL_STATUS_OK){
-          LOG_ERROR("sl_bt_system_set_soft_timer() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
-      }
+      // Passive scan for the anchor beacons of the tunnels, see zone.c
+      zone_init();
+
+      // Indications are queued by priority lane. SOFT_TIMER_1 is only started
+      // as a fallback while there is a backlog, see drain_indication_queue()
+      reset_queue();
 #endif
 #if BUILD_INCLUDES_BLE_CLIENT == 1
 
@@ -447,20 +557,28 @@ void handle_ble_event(sl_bt_msg_t *evt){
           LOG_ERROR("sl_bt_scanner_start() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
       }
 #endif
+      // Allow ATT_MTUs up to ATT_MAX_MTU, the stack then requests the larger
+      // MTU by itself once a connection is open
+      sc = sl_bt_gatt_set_max_mtu(ATT_MAX_MTU, &max_mtu);
+      if(sc != SL_STATUS_OK){
+          LOG_ERROR("sl_bt_gatt_set_max_mtu() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+      }
+
       // Initialization of connection parameters
       ble_data->connection_open = false;
       ble_data->indication_in_flight = false;
+      ble_data->attPayloadSize = ATT_DEFAULT_MTU - ATT_HEADER_LENGTH;
+      ble_data->connectionInterval = 0;
       ble_data->ok_to_send_htm_indications = false;
+      ble_data->ok_to_send_telemetry_notifications = false;
+      ble_data->ok_to_send_stream_notifications = false;
       ble_data->ok_to_send_button_indications = false;
       ble_data->bondingStatus = false;
-      ble_data->ok_to_send_button_read = true;
-
-      // delete all previous bonding
-      sc = sl_bt_sm_delete_bondings();
+      ble_data->passkey_confirm_pending = false;
 
-      if(sc != SL_STATUS_OK){
-          LOG_ERROR("sl_bt_sm_delete_bondings() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
-      }
+#if BUILD_INCLUDES_BLE_CLIENT == 1
+      gateway_init();
+#endif
 
       // Init the bonding parameters
       /** flags configuration:
@@ -489,6 +607,14 @@ void handle_ble_event(sl_bt_msg_t *evt){
           LOG_ERROR("sl_bt_sm_configure() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
       }
 
+      // Bonds are kept across disconnects and boots, see bonding.c
+      bonding_init();
+
+#if BUILD_INCLUDES_BLE_SERVER == 1
+      // Samples no client took while disconnected, kept in flash
+      journal_init();
+#endif
+
       // Initialize the LCD display and display all the informations as required.
       displayInit();
       displayPrintf(DISPLAY_ROW_NAME, BLE_DEVICE_TYPE_STRING); // Display Server/Client
@@ -505,6 +631,15 @@ void handle_ble_event(sl_bt_msg_t *evt){
 #if BUILD_INCLUDES_BLE_SERVER == 1
       displayPrintf(DISPLAY_ROW_CONNECTION, "Advertising");
       displayPrintf(DISPLAY_ROW_9, "Button Released");
+
+      // Energy profile by battery state, see governor.c
+      governor_init();
+
+      // 1 s housekeeping tick, runs whatever drives the LCD EXTCOMIN
+      sc = sl_bt_system_set_soft_timer(SOFT_TIMER_TICK_VALUE_1SEC, SOFT_TIMER_4, false);
+      if(sc != SL_STATUS_OK){
+          LOG_ERROR("sl_bt_system_set_soft_timer() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+      }
 #endif
 #if BUILD_INCLUDES_BLE_CLIENT == 1
       displayPrintf(DISPLAY_ROW_CONNECTION, "Discovering");
@@ -523,7 +658,11 @@ void handle_ble_event(sl_bt_msg_t *evt){
 
       ble_data->connectionHandle = evt->data.evt_connection_opened.connection;
       ble_data->connection_open = true;
-      ble_data->ok_to_send_button_read = true;
+      ble_data->attPayloadSize = ATT_DEFAULT_MTU - ATT_HEADER_LENGTH;
+
+      // A bonded peer gets its link encrypted without a passkey
+      bonding_opened(evt->data.evt_connection_opened.connection,
+                     evt->data.evt_connection_opened.bonding);
 
 #if BUILD_INCLUDES_BLE_SERVER == 1
       // Stopping advertisement
@@ -532,44 +671,45 @@ void handle_ble_event(sl_bt_msg_t *evt){
           LOG_ERROR("sl_bt_advertiser_stop() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
       }
 
-      // Setting Connection Interval minimum and maximum to 75mS
-      // Setting the Slave latency to enable it to be “off the air” for up to 300mS
-      // Setting Set the Supervision timeout to a value greater than (1 + slave latency) *
-      // (connection_interval * 2). See API documentation.
-
-      // Supervision timeout = (1 + 4) * (75 * 2) = 5 * 150 = 750ms.
-      // Hence, setting value of 760ms for supervision timeout
-      sc = sl_bt_connection_set_parameters(
-            ble_data->connectionHandle,   // Connection Handle
-            60,                           // min connection interval. (time in milliseconds / 1.25)
-            60,                           // max connection interval. (time in milliseconds / 1.25)
-            4,                            // num of connection intervals to skip
-            84,                           // Supervision time out. (time in milliseconds / 10)
-            0,                            // min_ce length
-            0                             // max_ce length
-            );
-
-      if(sc != SL_STATUS_OK){
-          LOG_ERROR("parm not set. sl_bt_connection_set_parameters() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+      // Ask for the 2M PHY, bulk telemetry takes half the air time on it.
+      // Any PHY the client asks for is still accepted.
+      sc = sl_bt_connection_set_preferred_phy(ble_data->connectionHandle, sl_bt_gap_2m_phy, 0xff);
+      if (sc != SL_STATUS_OK) {
+          LOG_ERROR("sl_bt_connection_set_preferred_phy() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
       }
+
+      telemetry_reset();
+      stream_reset();
+
+      // Connection parameters follow what needs the link, see connparams.c.
+      // The idle profile is requested once discovery and bonding are done.
+      connparams_reset();
 #endif
 
 #if BUILD_INCLUDES_BLE_CLIENT == 1
-      sc = sl_bt_scanner_stop();
-
-      if(sc != SL_STATUS_OK){
-          LOG_ERROR("sl_bt_scanner_stop() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+      // The scanner keeps running, other helmets may be waiting for a slot
+      slot = gateway_slot_opened(evt->data.evt_connection_opened.connection,
+                                 &evt->data.evt_connection_opened.address);
+      if(slot == NULL){
+          sc = sl_bt_connection_close(evt->data.evt_connection_opened.connection);
+          if(sc != SL_STATUS_OK){
+              LOG_ERROR("sl_bt_connection_close() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+          }
+          break;
       }
       displayPrintf(DISPLAY_ROW_BTADDR2, "%02X:%02X:%02X:%02X:%02X:%02X",
-                      serverAddress.addr[0],
-                      serverAddress.addr[1],
-                      serverAddress.addr[2],
-                      serverAddress.addr[3],
-                      serverAddress.addr[4],
-                      serverAddress.addr[5]);
-#endif
+                      slot->address.addr[0],
+                      slot->address.addr[1],
+                      slot->address.addr[2],
+                      slot->address.addr[3],
+                      slot->address.addr[4],
+                      slot->address.addr[5]);
+      displayPrintf(DISPLAY_ROW_CONNECTION, "Helmets %d/%d",
+                    (int) gateway_open_slots(), GATEWAY_MAX_SLOTS);
+#else
       // update the connection status
       displayPrintf(DISPLAY_ROW_CONNECTION, "Connected");
+#endif
       break;
 
     // This event indicates that the connection between server and client is closed
@@ -581,7 +721,8 @@ void handle_ble_event(sl_bt_msg_t *evt){
       //-----------------------------------------------------------------------
 
 #if BUILD_INCLUDES_BLE_SERVER == 1
-      // Restarting advertisement
+      // Restarting advertisement, with the interval of the governor profile
+      set_advertising_timing();
       sc = sl_bt_advertiser_start(
               ble_data->advertisingSetHandle,
               sl_bt_advertiser_general_discoverable,
@@ -599,33 +740,55 @@ void handle_ble_event(sl_bt_msg_t *evt){
       gpioLed1SetOff();
 #endif
 
-#if BUILD_INCLUDES_BLE_CLIENT == 1
-      // Start scanning
-      sc = sl_bt_scanner_start(sl_bt_gap_1m_phy, sl_bt_scanner_discover_generic);
-
-      if(sc != SL_STATUS_OK){
-          LOG_ERROR("sl_bt_scanner_start() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
-      }
-      displayPrintf(DISPLAY_ROW_BTADDR2, "");
-      displayPrintf(DISPLAY_ROW_TEMPVALUE, "");
-      displayPrintf(DISPLAY_ROW_9, "");
-      displayPrintf(DISPLAY_ROW_CONNECTION, "Discovering");
-#endif
       // Resetting connection parameters
       ble_data->connection_open = false;
       ble_data->indication_in_flight = false;
+      ble_data->attPayloadSize = ATT_DEFAULT_MTU - ATT_HEADER_LENGTH;
+      ble_data->connectionInterval = 0;
       ble_data->ok_to_send_htm_indications = false;
+      ble_data->ok_to_send_telemetry_notifications = false;
+      ble_data->ok_to_send_stream_notifications = false;
       ble_data->ok_to_send_button_indications = false;
       ble_data->bondingStatus = false;
-      ble_data->isIndicationOnButton = false;
-      ble_data->ok_to_send_button_read = true;
+      ble_data->passkey_confirm_pending = false;
 
-      // delete all previous bonding
-      sc = sl_bt_sm_delete_bondings();
+#if BUILD_INCLUDES_BLE_SERVER == 1
+      // Reboots into a committed image, drops an unfinished one
+      fwupdate_closed();
+#endif
 
-      if(sc != SL_STATUS_OK){
-          LOG_ERROR("sl_bt_sm_delete_bondings() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+#if BUILD_INCLUDES_BLE_CLIENT == 1
+      // Frees the slot and lets the next waiting helmet in. The buttons move
+      // on to the most recent of the remaining helmets.
+      gateway_slot_closed(evt->data.evt_connection_closed.connection);
+      slot = gateway_get_focus();
+      if(slot != NULL){
+          ble_data->connectionHandle = slot->connection;
+          ble_data->connection_open = true;
+          displayPrintf(DISPLAY_ROW_CONNECTION, "Helmets %d/%d",
+                        (int) gateway_open_slots(), GATEWAY_MAX_SLOTS);
+      }
+      else {
+          displayPrintf(DISPLAY_ROW_BTADDR2, "");
+          displayPrintf(DISPLAY_ROW_TEMPVALUE, "");
+          displayPrintf(DISPLAY_ROW_9, "");
+          displayPrintf(DISPLAY_ROW_CONNECTION, "Discovering");
       }
+#endif
+
+#if BUILD_INCLUDES_BLE_SERVER == 1
+      // Nothing queued for this connection is of use to the next one, this
+      // also stops the fallback drain timer
+      reset_queue();
+      drain_indication_queue();
+      telemetry_reset();
+      stream_reset();
+      journal_rewind();
+      connparams_reset();
+#endif
+
+      // The bond itself is kept for the next connection
+      bonding_closed(evt->data.evt_connection_closed.connection);
       break;
 
     // This event indicates that some connection parameter has changed.
@@ -633,6 +796,21 @@ void handle_ble_event(sl_bt_msg_t *evt){
     // by printing them out and comment it out for the final submission code
     case sl_bt_evt_connection_parameters_id:
 
+      // kept for the telemetry packets per connection event counter
+      ble_data->connectionInterval = evt->data.evt_connection_parameters.interval;
+
+      // Encryption resumed with a stored bond counts as bonded
+      if(bonding_security_changed(evt->data.evt_connection_parameters.connection,
+                                  evt->data.evt_connection_parameters.security_mode) == true){
+          ble_data->bondingStatus = true;
+      }
+
+#if BUILD_INCLUDES_BLE_SERVER == 1
+      connparams_accepted(evt->data.evt_connection_parameters.interval,
+                          evt->data.evt_connection_parameters.latency,
+                          evt->data.evt_connection_parameters.timeout);
+#endif
+
       // print all connection parameters.
 //      LOG_INFO("event: sl_bt_evt_connection_parameters_id\r\n");
 //      LOG_INFO(" Connection Parameters:\r\n Connection: %d\r\n interval: %d\r\n latency: %d\r\n security_mode: %d\r\n timeout: %d\r\n txsize: %d\r\n",
@@ -645,6 +823,21 @@ void handle_ble_event(sl_bt_msg_t *evt){
 //              );
       break;
 
+    // This event indicates that the PHY update procedure is complete
+    case sl_bt_evt_connection_phy_status_id:
+
+      LOG_INFO("Connection PHY: 0x%02x\r\n", (unsigned int) evt->data.evt_connection_phy_status.phy);
+      break;
+
+    // This event indicates that the ATT_MTU of the connection was negotiated.
+    // Queue entries may be as large as the resulting ATT payload.
+    case sl_bt_evt_gatt_mtu_exchanged_id:
+
+      ble_data->attPayloadSize = evt->data.evt_gatt_mtu_exchanged.mtu - ATT_HEADER_LENGTH;
+      if(ble_data->attPayloadSize > MAX_BUFFER_LENGTH)
+        ble_data->attPayloadSize = MAX_BUFFER_LENGTH;
+      break;
+
       // This event indicates that an soft timer event has occurred
       case sl_bt_evt_system_soft_timer_id:
 
@@ -656,25 +849,29 @@ void handle_ble_event(sl_bt_msg_t *evt){
               break;
 
 #if BUILD_INCLUDES_BLE_SERVER == 1
+          case SOFT_TIMER_4:
+            telemetry_tick();
+            journal_tick();
+            zone_tick();
+            break;
+
           case SOFT_TIMER_1:
-            if(get_queue_depth()>0){
-                queue_struct_t data;
-                read_queue(&data.charHandle, &data.bufLength, &data.buffer[0]);
-                // Server Sending the Indication.
-
-                if(((data.charHandle == gattdb_button_state) && (ble_data->ok_to_send_button_indications == true))||
-                   ((data.charHandle == gattdb_temperature_measurement) && (ble_data->ok_to_send_htm_indications == true))){
-                  sc = sl_bt_gatt_server_send_indication(
-                        ble_data->connectionHandle,
-                        data.charHandle,
-                        data.bufLength,
-                        &data.buffer[0]
-                       );
-                  if (sc != SL_STATUS_OK) {
-                      LOG_ERROR("sl_bt_gatt_server_send_indication() for button state returned != 0 status=0x%04x\r\n", (unsigned int) sc);
-                  }
-                }
-            }
+            // Fallback only, the queue is normally drained as soon as the
+            // previous indication is confirmed
+            drain_indication_queue();
+            break;
+
+          case SOFT_TIMER_2:
+            stream_retransmit_tick();
+            break;
+
+          case SOFT_TIMER_3:
+            connparams_holdoff_expired();
+            break;
+#endif
+#if BUILD_INCLUDES_BLE_CLIENT == 1
+          case GATEWAY_SOFT_TIMER:
+            gateway_tick();
             break;
 #endif
         }
@@ -687,12 +884,30 @@ void handle_ble_event(sl_bt_msg_t *evt){
 
 
 #if BUILD_INCLUDES_BLE_SERVER == 1
+      // Alarms first, the beacon, the link and the indication, see alarm.c
+      if ((evt->data.evt_system_external_signal.extsignals & (1<<ALARM_BIT_POS))){
+          alarm_dispatch();
+      }
+
+      if ((evt->data.evt_system_external_signal.extsignals & (1<<BATTERY_BIT_POS))){
+          battery_process();
+          governor_update();
+      }
+
+      // LCD changes held back by the governor profile go out when it allows
+      if ((evt->data.evt_system_external_signal.extsignals & (1<<LETIMERUF_BIT_POS))){
+          displayFlush();
+
+          // Peripheral needs held past their bound, see energy.c
+          energy_check_holds();
+      }
+
       if ((evt->data.evt_system_external_signal.extsignals & (1<<PB0_BIT_POS))){
           uint8_t button_state_buffer[1];
           if(Get_PB0_State()){
-              if(confirm_flag){
-                sc = sl_bt_sm_passkey_confirm(ble_data->connectionHandle, 1);
-                confirm_flag = false;
+              if(ble_data->passkey_confirm_pending){
+                sc = sl_bt_sm_passkey_confirm(confirm_connection, 1);
+                ble_data->passkey_confirm_pending = false;
                 if(sc != SL_STATUS_OK){
                     LOG_ERROR("sl_bt_scanner_start() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
                 }
@@ -715,28 +930,10 @@ void handle_ble_event(sl_bt_msg_t *evt){
               LOG_ERROR("sl_bt_gatt_server_write_attribute_value() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
           }
 
-          if  ((ble_data->connection_open == true) &&
-               (ble_data->ok_to_send_button_indications == true) &&
-               (ble_data->bondingStatus == true)){
-
-              if(!((ble_data->indication_in_flight == false)||
-                  (get_queue_depth() > 0))){
-                  // Server Sending the Indication.
-                  sc = sl_bt_gatt_server_send_indication(
-                        ble_data->connectionHandle,
-                        gattdb_button_state, // handle from gatt_db.h
-                        1,
-                        &button_state_buffer[0]
-                       );
-                  if (sc != SL_STATUS_OK) {
-                      LOG_ERROR("sl_bt_gatt_server_send_indication() for button state returned != 0 status=0x%04x\r\n", (unsigned int) sc);
-                  }
-                  ble_data->indication_in_flight = true;
-              } // if
-              else{
-                  write_queue(gattdb_button_state, 1, &button_state_buffer[0]);
-              }
-          }// if
+          // The SOS indication, the beacon and the connection interval
+          // were already handled by alarm_dispatch()
+          if(telemetry_add_sample(TELEMETRY_SENSOR_BUTTON, button_state_buffer[0]))
+            journal_append(TELEMETRY_SENSOR_BUTTON, button_state_buffer[0]);
       }
 #endif
 
@@ -746,10 +943,13 @@ void handle_ble_event(sl_bt_msg_t *evt){
           Button_States_t currentState;
           static Button_States_t nextState = Button_State_1;
 
+          // The buttons act on the most recently connected helmet
+          slot = gateway_get_focus();
+
           currentState = nextState;
-          if((confirm_flag == true) && (Get_PB0_State() == true)){
-            sc = sl_bt_sm_passkey_confirm(ble_data->connectionHandle, 1);
-            confirm_flag = false;
+          if((ble_data->passkey_confirm_pending == true) && (Get_PB0_State() == true)){
+            sc = sl_bt_sm_passkey_confirm(confirm_connection, 1);
+            ble_data->passkey_confirm_pending = false;
             if(sc != SL_STATUS_OK){
                 LOG_ERROR("sl_bt_scanner_start() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
             }
@@ -762,10 +962,10 @@ void handle_ble_event(sl_bt_msg_t *evt){
                   nextState = Button_State_2;
                 }
 
-                if(((Get_PB0_State() == false)&&(Get_PB1_State() == true)&&(ble_data->ok_to_send_button_read == true))){
-                  sc = sl_bt_gatt_read_characteristic_value(ble_data->connectionHandle,
-                                                            ble_data->characteristicHandleButton);
-                  ble_data->ok_to_send_button_read = false;
+                if((slot != NULL)&&(Get_PB0_State() == false)&&(Get_PB1_State() == true)&&(slot->ok_to_send_button_read == true)){
+                  sc = sl_bt_gatt_read_characteristic_value(slot->connection,
+                                                            slot->characteristicHandleButton);
+                  slot->ok_to_send_button_read = false;
                   if(sc != SL_STATUS_OK){
                       LOG_ERROR("sl_bt_gatt_read_characteristic_value() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
                   }
@@ -793,18 +993,20 @@ void handle_ble_event(sl_bt_msg_t *evt){
                 nextState = Button_State_4;
                 if((Get_PB0_State() == false)&&(Get_PB1_State() == false)){
                   nextState = Button_State_1;
+                  if(slot == NULL)
+                    break;
                   // toggle the indication cmd and send it
-                  if(ble_data->isIndicationOnButton == true){
-                      sc = sl_bt_gatt_set_characteristic_notification(ble_data->connectionHandle,
-                                                                      ble_data->characteristicHandleButton,
+                  if(slot->isIndicationOnButton == true){
+                      sc = sl_bt_gatt_set_characteristic_notification(slot->connection,
+                                                                      slot->characteristicHandleButton,
                                                                       sl_bt_gatt_disable);
-                      ble_data->isIndicationOnButton = false;
+                      slot->isIndicationOnButton = false;
                   }
                   else{
-                      sc = sl_bt_gatt_set_characteristic_notification(ble_data->connectionHandle,
-                                                                      ble_data->characteristicHandleButton,
+                      sc = sl_bt_gatt_set_characteristic_notification(slot->connection,
+                                                                      slot->characteristicHandleButton,
                                                                       sl_bt_gatt_indication);
-                      ble_data->isIndicationOnButton = true;
+                      slot->isIndicationOnButton = true;
                   }
                   if(sc != SL_STATUS_OK){
                       LOG_ERROR("sl_bt_gatt_read_characteristic_value() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
@@ -817,7 +1019,7 @@ void handle_ble_event(sl_bt_msg_t *evt){
       break;
 
     case sl_bt_evt_sm_confirm_bonding_id:
-      sc = sl_bt_sm_bonding_confirm(ble_data->connectionHandle, 1);
+      sc = sl_bt_sm_bonding_confirm(evt->data.evt_sm_confirm_bonding.connection, 1);
 
       if(sc != SL_STATUS_OK){
           LOG_ERROR("sl_bt_sm_bonding_confirm() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
@@ -828,7 +1030,8 @@ void handle_ble_event(sl_bt_msg_t *evt){
 
       displayPrintf(DISPLAY_ROW_PASSKEY, "Passkey %06d", evt->data.evt_sm_confirm_passkey.passkey);
       displayPrintf(DISPLAY_ROW_ACTION, "Confirm with PB0");
-      confirm_flag = true;
+      ble_data->passkey_confirm_pending = true;
+      confirm_connection = evt->data.evt_sm_confirm_passkey.connection;
       break;
 
     case sl_bt_evt_sm_bonded_id:
@@ -836,17 +1039,21 @@ void handle_ble_event(sl_bt_msg_t *evt){
       displayPrintf(DISPLAY_ROW_ACTION, " ");
       displayPrintf(DISPLAY_ROW_CONNECTION, "Bonded");
       ble_data->bondingStatus = true;
+      bonding_bonded(evt->data.evt_sm_bonded.connection, evt->data.evt_sm_bonded.bonding);
       break;
     case sl_bt_evt_sm_bonding_failed_id:
       displayPrintf(DISPLAY_ROW_PASSKEY, " ");
       displayPrintf(DISPLAY_ROW_ACTION, " ");
       ble_data->bondingStatus = false;
+      ble_data->passkey_confirm_pending = false;
       break;
     /*  ------------------------------------------------------------------------
     *  Server Events:
     *    sl_bt_evt_system_external_signal_id
     *    sl_bt_evt_gatt_server_characteristic_status_id
     *    sl_bt_evt_gatt_server_indication_timeout_id
+    *    sl_bt_evt_gatt_server_user_write_request_id
+    *    sl_bt_evt_gatt_server_user_read_request_id
     *
     *  ------------------------------------------------------------------------
     */
@@ -902,6 +1109,30 @@ void handle_ble_event(sl_bt_msg_t *evt){
           }
       }
 
+      // Check if the event is related to the bulk telemetry characteristic and
+      // if change is done by the GATT client.
+      if (evt->data.evt_gatt_server_characteristic_status.characteristic == gattdb_bulk_telemetry
+          && evt->data.evt_gatt_server_characteristic_status.status_flags == sl_bt_gatt_server_client_config)
+      {
+          ble_data->ok_to_send_telemetry_notifications =
+              (evt->data.evt_gatt_server_characteristic_status.client_config_flags == sl_bt_gatt_server_notification);
+      }
+
+      // Check if the event is related to the reliable stream characteristic and
+      // if change is done by the GATT client. Either way the stream restarts
+      // at sequence number 0.
+      if (evt->data.evt_gatt_server_characteristic_status.characteristic == gattdb_stream_data
+          && evt->data.evt_gatt_server_characteristic_status.status_flags == sl_bt_gatt_server_client_config)
+      {
+          ble_data->ok_to_send_stream_notifications =
+              (evt->data.evt_gatt_server_characteristic_status.client_config_flags == sl_bt_gatt_server_notification);
+          stream_reset();
+
+          // A new subscriber starts a sync from the last acknowledged record
+          journal_rewind();
+          journal_pump();
+      }
+
       // Check if the event is related to the htm or the custom button characteristic and if we
       // received confirmation of reception from GATT client for a previously
       // transmitted indication.
@@ -909,8 +1140,63 @@ void handle_ble_event(sl_bt_msg_t *evt){
           (evt->data.evt_gatt_server_characteristic_status.characteristic == gattdb_button_state))&&
          (evt->data.evt_gatt_server_characteristic_status.status_flags == sl_bt_gatt_server_confirmation)){
          ble_data->indication_in_flight = false; //indication reached
+
+         // The stream held back while the alarm was in flight
+         if(evt->data.evt_gatt_server_characteristic_status.characteristic == gattdb_button_state){
+           alarm_stamp(ALARM_STAGE_CONFIRMED);
+           stream_pump();
+         }
+      }
+
+      // Either the link just became free or the client subscribed to
+      // something, send whatever is waiting
+      drain_indication_queue();
+
+      break;
+
+    // This event indicates that the client wrote a characteristic value
+    case sl_bt_evt_gatt_server_attribute_value_id:
+
+      // Cumulative acknowledgements and window changes of the reliable stream
+      if(evt->data.evt_gatt_server_attribute_value.attribute == gattdb_stream_control){
+        stream_handle_control(evt->data.evt_gatt_server_attribute_value.value.data,
+                              evt->data.evt_gatt_server_attribute_value.value.len);
+
+        // Acknowledged records free stream slots for the next journal batch
+        journal_pump();
+      }
+      break;
+
+    // This event indicates that the client wrote a user type characteristic.
+    // The OTA DFU component answers OTA control writes, we only speed up the
+    // link for the transfer that follows. The Firmware Update service is the
+    // faster path that stays in the application, see fwupdate.c.
+    case sl_bt_evt_gatt_server_user_write_request_id:
+
+      if(evt->data.evt_gatt_server_user_write_request.characteristic == gattdb_ota_control){
+        connparams_set_demand(CONN_DEMAND_OTA, true);
+      }
+      else if(evt->data.evt_gatt_server_user_write_request.characteristic == gattdb_fw_update_data){
+        fwupdate_handle_data(evt->data.evt_gatt_server_user_write_request.value.data,
+                             evt->data.evt_gatt_server_user_write_request.value.len);
+      }
+      else if(evt->data.evt_gatt_server_user_write_request.characteristic == gattdb_fw_update_control){
+        fwupdate_handle_control(evt->data.evt_gatt_server_user_write_request.connection,
+                                evt->data.evt_gatt_server_user_write_request.value.data,
+                                evt->data.evt_gatt_server_user_write_request.value.len);
       }
+      break;
+
+    // This event indicates that the client read a user type characteristic
+    case sl_bt_evt_gatt_server_user_read_request_id:
 
+      if(evt->data.evt_gatt_server_user_read_request.characteristic == gattdb_fw_update_control){
+        fwupdate_read_status(evt->data.evt_gatt_server_user_read_request.connection);
+      }
+      else if(evt->data.evt_gatt_server_user_read_request.characteristic == gattdb_alarm_latency){
+        alarm_read_latency(evt->data.evt_gatt_server_user_read_request.connection,
+                           evt->data.evt_gatt_server_user_read_request.offset);
+      }
       break;
 
     // This event indicates that we never received a confirmation for a
@@ -924,8 +1210,14 @@ void handle_ble_event(sl_bt_msg_t *evt){
       LOG_ERROR("event: sl_bt_evt_gatt_server_indication_timeout_id\r\n Parameters:\r\n Connection: %d\r\n",
                      (int) (evt->data.evt_gatt_server_indication_timeout.connection)
               );
+      drain_indication_queue();
 
       break;
+
+    case sl_bt_evt_scanner_scan_report_id:
+      // Only anchor beacons are of interest to a helmet, see zone.c
+      zone_scan_report(&evt->data.evt_scanner_scan_report);
+      break;
 #endif
 
 #if BUILD_INCLUDES_BLE_CLIENT == 1
@@ -939,48 +1231,31 @@ void handle_ble_event(sl_bt_msg_t *evt){
     *  ------------------------------------------------------------------------
     */
     case sl_bt_evt_scanner_scan_report_id:
-        // Is the bd_addr, packet_type and address_type what we expect for our Server? If yes, call sl_bt_connection_open()
-
-        scannerAddress = evt->data.evt_scanner_scan_report.address;
-        uint32_t addressMatchFlag = 1;
-        for(int i=0; i<6; i++){
-            if (scannerAddress.addr[i] != serverAddress.addr[i]){
-                addressMatchFlag = 0;
-                break;
-            }
-        }
-
-        if ((addressMatchFlag == 1) &&
-            (evt->data.evt_scanner_scan_report.address_type == PUBLIC_ADDRESS)&&
-            (evt->data.evt_scanner_scan_report.packet_type == PACKET_TYPE)){
-            sc = sl_bt_connection_open(evt->data.evt_scanner_scan_report.address,
-                                       evt->data.evt_scanner_scan_report.address_type,
-                                       sl_bt_gap_phy_1m,
-                                       NULL
-                                       );
-
-            if(sc != SL_STATUS_OK){
-                LOG_ERROR("sl_bt_connection_open() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
-            }
-        }
-          break;
+        // Every helmet advertising the HTM service is a candidate for a slot,
+        // see gateway.c
+        gateway_scan_report(&evt->data.evt_scanner_scan_report);
+        break;
 
     case sl_bt_evt_gatt_procedure_completed_id:
       // Save the result field in the ble private data structure which is returned from this event (might be useful later on)
       ble_data->resultGATTProcedue = evt->data.evt_gatt_procedure_completed.result;
       if(ble_data->resultGATTProcedue == SL_STATUS_BT_ATT_INSUFFICIENT_ENCRYPTION){
-          sc = sl_bt_sm_increase_security(ble_data->connectionHandle);
+          sc = sl_bt_sm_increase_security(evt->data.evt_gatt_procedure_completed.connection);
       }
       break;
 
     case sl_bt_evt_gatt_service_id:
       //Save - Service Handle
-      ble_data->serviceHandle = evt->data.evt_gatt_service.service;
+      slot = gateway_get_slot(evt->data.evt_gatt_service.connection);
+      if(slot != NULL)
+        slot->serviceHandle = evt->data.evt_gatt_service.service;
       break;
 
     case sl_bt_evt_gatt_characteristic_id:
       // Save - Characteristic Handle
-      ble_data->characteristicHandle = evt->data.evt_gatt_characteristic.characteristic;
+      slot = gateway_get_slot(evt->data.evt_gatt_characteristic.connection);
+      if(slot != NULL)
+        slot->characteristicHandle = evt->data.evt_gatt_characteristic.characteristic;
       break;
 
     case sl_bt_evt_gatt_characteristic_value_id:
@@ -999,21 +1274,47 @@ void handle_ble_event(sl_bt_msg_t *evt){
        *    if the returned value is 0x01, then display text "Button Pressed"
        *    on row 'DISPLAY_ROW_9' in the LCD..
        */
-      if((evt->data.evt_gatt_characteristic_value.characteristic == ble_data->characteristicHandleHTM)&&
+      slot = gateway_get_slot(evt->data.evt_gatt_characteristic_value.connection);
+      if(slot == NULL)
+        break;
+
+      // Database Hash read by the discovery state machine
+      if((evt->data.evt_gatt_characteristic_value.characteristic == slot->cache.hashHandle)&&
+          (evt->data.evt_gatt_characteristic_value.att_opcode == sl_bt_gatt_read_response)){
+          if(evt->data.evt_gatt_characteristic_value.value.len == DATABASE_HASH_LENGTH){
+              memcpy(&slot->peerHash[0], &evt->data.evt_gatt_characteristic_value.value.data[0], DATABASE_HASH_LENGTH);
+              slot->peerHashValid = true;
+          }
+          break;
+      }
+
+      if((evt->data.evt_gatt_characteristic_value.characteristic == slot->characteristicHandleHTM)&&
           (evt->data.evt_gatt_characteristic_value.att_opcode == sl_bt_gatt_handle_value_indication)){
           sc = sl_bt_gatt_send_characteristic_confirmation(evt->data.evt_gatt_characteristic_value.connection);
 
+          // [0] flags, [1..4] IEEE-11073 FLOAT in degC, kept in whole degC
           uint8_t *GATT_char_value = &(evt->data.evt_gatt_characteristic_value.value.data[0]);
-          temp_data = FLOAT_TO_INT32(GATT_char_value);
-          displayPrintf(DISPLAY_ROW_TEMPVALUE, "Temp=%d", temp_data);
+          uint32_t htm_float = ((uint32_t) GATT_char_value[1]) |
+                               ((uint32_t) GATT_char_value[2] << 8) |
+                               ((uint32_t) GATT_char_value[3] << 16) |
+                               ((uint32_t) GATT_char_value[4] << 24);
+          if(ieee11073_float_decode(htm_float, 0, &temp_data) == IEEE11073_OK){
+              gateway_record_temperature(slot, temp_data);
+              displayPrintf(DISPLAY_ROW_TEMPVALUE, "Temp=%d (%02X%02X)", temp_data,
+                            slot->address.addr[1], slot->address.addr[0]);
+          }
+          else {
+              LOG_ERROR("Temperature is not a number, FLOAT=0x%08x\r\n", (unsigned int) htm_float);
+          }
       }
 
-      if((evt->data.evt_gatt_characteristic_value.characteristic == ble_data->characteristicHandleButton)&&
+      if((evt->data.evt_gatt_characteristic_value.characteristic == slot->characteristicHandleButton)&&
           ((evt->data.evt_gatt_characteristic_value.att_opcode == sl_bt_gatt_handle_value_indication)||
            (evt->data.evt_gatt_characteristic_value.att_opcode == sl_bt_gatt_read_response))){
           sc = sl_bt_gatt_send_characteristic_confirmation(evt->data.evt_gatt_characteristic_value.connection);
-          ble_data->ok_to_send_button_read = true;
+          slot->ok_to_send_button_read = true;
           uint8_t *GATT_char_value = &(evt->data.evt_gatt_characteristic_value.value.data[0]);
+          gateway_record_button(slot, GATT_char_value[0]);
           if(GATT_char_value[0] == BUTTON_OFF){
               displayPrintf(DISPLAY_ROW_9, "Button Released");
           }
@@ -32,7 +32,6 @@
 #define UINT8_TO_BITSTREAM(p, n)  { *(p)++ = (uint8_t)(n); } // use this for the flags byte, which you set = 0
 #define UINT32_TO_BITSTREAM(p, n) { *(p)++ = (uint8_t)(n); *(p)++ = (uint8_t)((n) >> 8); \
                                     *(p)++ = (uint8_t)((n) >> 16); *(p)++ = (uint8_t)((n) >> 24); }
-#define INT32_TO_FLOAT(m, e)      ( (int32_t) (((uint32_t) m) & 0x00FFFFFFU) | (((uint32_t) e) << 24) )
 
 #define SOFT_TIMER_0 0
 #define SOFT_TIMER_TICK_VALUE_1SEC 32768 // Value given in soft_timer API documentation
@@ -40,6 +39,15 @@
 #define SOFT_TIMER_1 1
 #define SOFT_TIMER_TICK_VALUE_200ms 6554 // Value derived from soft_timer API documentation
 
+#define SOFT_TIMER_2 2
+#define SOFT_TIMER_TICK_VALUE_500ms 16384 // Value derived from soft_timer API documentation
+
+#define SOFT_TIMER_3 3
+
+// 1 s housekeeping tick of the server modules. SOFT_TIMER_0 only runs when
+// the LCD EXTCOMIN is toggled in software, see lcd.h
+#define SOFT_TIMER_4 4
+
 // BLE Data Structure
 typedef struct {
   // values that are common to servers and clients
@@ -52,27 +60,21 @@ typedef struct {
 
   // values unique for server
   uint8_t advertisingSetHandle;
+  uint16_t advertisingInterval; // connectable advertising, value x 0.625 ms
 
   bool connection_open; // true when in an open connection
   bool ok_to_send_htm_indications; // true when client enabled indications
   bool ok_to_send_button_indications; // true when client enabled indications for button characteristics
   bool indication_in_flight; // true when an indication is in-flight
+  bool passkey_confirm_pending; // true while PB0 confirms a passkey instead of raising SOS
+  bool ok_to_send_telemetry_notifications; // true when client enabled bulk telemetry notifications
+  bool ok_to_send_stream_notifications; // true when client enabled reliable stream notifications
+  uint16_t attPayloadSize; // largest indication payload, ATT_MTU - 3
+  uint16_t connectionInterval; // connection interval, value x 1.25 ms
 
-  // values unique for client
-  uint32_t serviceHandle;    /**< service handle */
-  uint16_t characteristicHandle; /**< GATT characteristic handle */
-
-  uint32_t serviceHandleHTM;    /**< service handle */
-  uint32_t serviceHandleButton;    /**< service handle */
-
-  uint16_t characteristicHandleHTM;
-  uint16_t characteristicHandleButton;
-
+  // values unique for client, per helmet values live in gateway_slot_t
   uint16_t resultGATTProcedue;
 
-  bool isIndicationOnButton;
-  bool ok_to_send_button_read;
-
 } ble_data_struct_t;
 
 /**
@@ -91,6 +93,8 @@ void handle_ble_event(sl_bt_msg_t *evt);
 
 // This is the number of entries in the queue. Please leave
 // this value set to 16.
+// The queue is now made of byte rings (see ringbuf.h), entries take only the
+// space they need and the number that fits depends on their length.
 #define QUEUE_DEPTH      (16)
 
 // Student edit:
@@ -98,21 +102,40 @@ void handle_ble_event(sl_bt_msg_t *evt);
 //   define this to 0 if your design leaves 1 array entry empty
 #define USE_ALL_ENTRIES  (1)
 
-#define MAX_BUFFER_LENGTH  (5)
+// Bytes of ring storage per priority lane, must be a power of 2
+#define QUEUE_LANE_SIZE  (512)
+
+// Connectable advertising interval until the governor sets one, 250 ms
+#define ADVERTISING_INTERVAL_DEFAULT (400)
+
+// Largest ATT_MTU we accept, an indication carries up to ATT_MTU - 3 bytes
+#define ATT_MAX_MTU        (250)
+#define ATT_DEFAULT_MTU    (23)
+#define ATT_HEADER_LENGTH  (3)
+
+#define MAX_BUFFER_LENGTH  (ATT_MAX_MTU - ATT_HEADER_LENGTH)
 #define MIN_BUFFER_LENGTH  (1)
 
 typedef struct {
 
   uint16_t       charHandle;                 // GATT DB handle from gatt_db.h
-  uint32_t       bufLength;                  // Number of bytes written to field buffer[5]
+  uint32_t       bufLength;                  // Number of bytes written to field buffer[]
   uint8_t        buffer[MAX_BUFFER_LENGTH];  // The actual data buffer for the indication,
                                              //   need 5-bytes for HTM and 1-byte for button_state.
-                                             //   For testing, test lengths 1 through 5,
-                                             //   a length of 0 shall be considered an
-                                             //   error, as well as lengths > 5
+                                             //   A length of 0 shall be considered an
+                                             //   error, as well as lengths larger than the
+                                             //   ATT payload of the connection
 
 } queue_struct_t;
 
+// Priority lanes of the indication queue. Lower value = higher priority,
+// read_queue() empties a lane before looking at the next one.
+typedef enum {
+  QUEUE_LANE_ALARM,    // safety alarms: gas, fall, SOS
+  QUEUE_LANE_ROUTINE,  // periodic data such as temperature
+  QUEUE_NUMBER_OF_LANES
+} queue_lane_t;
+
 // Function prototypes. The autograder (i.e. the testbench) only uses these
 // functions to test your design. Please do not change these definitions or
 // the autograder will fail.
@@ -122,4 +145,60 @@ bool     read_queue       (uint16_t *charHandle, uint32_t *bufLength, uint8_t *b
 void     get_queue_status (uint32_t *wptr, uint32_t *rptr, bool *full, bool *empty);
 uint32_t get_queue_depth  (void);
 
+/**
+ * @brief   Writes an entry to the given priority lane of the indication queue
+ * @param   lane        priority lane, see queue_lane_t
+ * @param   charHandle  GATT DB handle from gatt_db.h
+ * @param   bufLength   number of bytes in buffer, MIN_BUFFER_LENGTH to the ATT payload size
+ * @param   buffer      indication payload
+ * @return  false if successful, true if the lane is full or an argument is invalid
+ */
+bool write_queue_lane(queue_lane_t lane, uint16_t charHandle, uint32_t bufLength, uint8_t *buffer);
+
+/**
+ * @brief   Reserves room for an entry in the given priority lane, the payload
+ *          is written in place and queued by commit_queue_lane()
+ * @param   lane        priority lane, see queue_lane_t
+ * @param   charHandle  GATT DB handle from gatt_db.h
+ * @param   bufLength   payload length, MIN_BUFFER_LENGTH to the ATT payload size
+ * @return  where to write the payload, NULL if the lane is full or the
+ *          length is invalid
+ */
+uint8_t *reserve_queue_lane(queue_lane_t lane, uint16_t charHandle, uint32_t bufLength);
+
+/**
+ * @brief   Queues the entry opened by reserve_queue_lane()
+ * @param   lane        priority lane given to reserve_queue_lane()
+ * @param   bufLength   payload length actually written
+ * @return  none
+ */
+void commit_queue_lane(queue_lane_t lane, uint32_t bufLength);
+
+/**
+ * @brief   Queues an indication and sends it right away if no other indication
+ *          is in flight
+ * @param   lane        priority lane, see queue_lane_t
+ * @param   charHandle  GATT DB handle from gatt_db.h
+ * @param   bufLength   number of bytes in buffer, MIN_BUFFER_LENGTH to the ATT payload size
+ * @param   buffer      indication payload
+ * @return  false if successful, true if the lane is full
+ */
+bool send_indication(queue_lane_t lane, uint16_t charHandle, uint32_t bufLength, uint8_t *buffer);
+
+/**
+ * @brief   Sends the next queued indication, highest priority lane first, if
+ *          the connection is open and nothing is in flight
+ * @return  none
+ */
+void drain_indication_queue(void);
+
+/**
+ * @brief   Sets the connectable advertising interval and the interval of the
+ *          sensor summary beacon, restarts whatever is advertising
+ * @param   advInterval     connectable advertiser, value x 0.625 ms
+ * @param   beaconInterval  beacon outside alarms, value x 0.625 ms
+ * @return  none
+ */
+void ble_set_advertising_intervals(uint16_t advInterval, uint16_t beaconInterval);
+
 #endif /* SRC_BLE_H_ */
@@ -34,8 +34,11 @@
  * Students:
  * Set to 1 to configure this build as a BLE server.
  * Set to 0 to configure as a BLE client
+ * The host tests in test/ pass it on the command line
  */
+#ifndef DEVICE_IS_BLE_SERVER
 #define DEVICE_IS_BLE_SERVER 1
+#endif
 
 // Students:
 // For your Bluetooth Client implementations, starting with A7,
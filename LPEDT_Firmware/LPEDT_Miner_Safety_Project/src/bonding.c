@@ -0,0 +1,208 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    bonding.c
+ * @brief   Persistent bonds with a bounded table and encryption resumed on
+ *          reconnection without user interaction
+ *
+ *          Bonds stay in NVM3 across disconnects and boots. The table holds
+ *          BONDING_MAX_COUNT bonds; when it is full the stack overwrites the
+ *          bond that was used the longest time ago. When a bonded peer
+ *          connects, encryption is requested as soon as the connection opens,
+ *          with the stored keys, so no passkey has to be confirmed and the
+ *          first encrypted GATT access does not have to fail first. The time
+ *          from connection open to an encrypted link is logged for resumed and
+ *          new pairings separately.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include "sl_sleeptimer.h"
+#include "sl_bt_api.h"
+#include "bonding.h"
+
+// Include logging for this file
+#define INCLUDE_LOG_DEBUG 1
+#include "log.h"
+
+typedef struct {
+  bool     inUse;
+  uint8_t  connection;
+  bool     resumed;       // peer was bonded when the connection opened
+  bool     encrypted;
+  uint32_t openedMs;
+} bonding_link_t;
+
+static bonding_link_t links[BONDING_MAX_LINKS];
+
+// open-to-encrypted latency, [0] new pairing, [1] resumed
+static uint32_t latencyCount[2] = { 0, 0 };
+static uint32_t latencySumMs[2] = { 0, 0 };
+
+/**
+ * @brief   Returns the time since boot in ms
+ * @return  ms since boot
+ */
+static uint32_t bonding_now_ms(void) {
+  uint64_t ms = 0;
+
+  sl_sleeptimer_tick64_to_ms(sl_sleeptimer_get_tick_count64(), &ms);
+
+  return (uint32_t) ms;
+}
+
+/**
+ * @brief   Finds the entry of a connection
+ * @param   connection  connection handle
+ * @return  the entry, NULL if the connection is not tracked
+ */
+static bonding_link_t *find_link(uint8_t connection) {
+  uint32_t i;
+
+  for(i = 0; i < BONDING_MAX_LINKS; i++){
+    if((links[i].inUse == true) && (links[i].connection == connection))
+      return &links[i];
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief   Configures the bonding table, call once at boot after
+ *          sl_bt_sm_configure()
+ * @return  none
+ */
+void bonding_init(void) {
+  sl_status_t sc;
+  uint32_t    i;
+
+  for(i = 0; i < BONDING_MAX_LINKS; i++)
+    links[i].inUse = false;
+
+  if(BONDING_CLEAR_ON_BOOT == 1){
+    sc = sl_bt_sm_delete_bondings();
+    if(sc != SL_STATUS_OK){
+        LOG_ERROR("sl_bt_sm_delete_bondings() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+    }
+  }
+
+  sc = sl_bt_sm_store_bonding_configuration(BONDING_MAX_COUNT, BONDING_POLICY);
+  if(sc != SL_STATUS_OK){
+      LOG_ERROR("sl_bt_sm_store_bonding_configuration() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+  }
+
+  sc = sl_bt_sm_set_bondable_mode(1);
+  if(sc != SL_STATUS_OK){
+      LOG_ERROR("sl_bt_sm_set_bondable_mode() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+  }
+
+} // bonding_init()
+
+/**
+ * @brief   Starts timing a new connection and resumes encryption right away
+ *          if the peer is bonded
+ * @param   connection  connection handle
+ * @param   bonding     bonding handle from the opened event
+ * @return  none
+ */
+void bonding_opened(uint8_t connection, uint8_t bonding) {
+  sl_status_t     sc;
+  bonding_link_t *link = NULL;
+  uint32_t        i;
+
+  for(i = 0; i < BONDING_MAX_LINKS; i++){
+    if(links[i].inUse == false){
+      link = &links[i];
+      break;
+    }
+  }
+
+  if(link != NULL){
+    link->inUse = true;
+    link->connection = connection;
+    link->resumed = (bonding != SL_BT_INVALID_BONDING_HANDLE);
+    link->encrypted = false;
+    link->openedMs = bonding_now_ms();
+  }
+
+  if(bonding == SL_BT_INVALID_BONDING_HANDLE)
+    return;
+
+  // Keys are stored, encrypt now instead of waiting for an access to fail
+  sc = sl_bt_sm_increase_security(connection);
+  if(sc != SL_STATUS_OK){
+      LOG_ERROR("sl_bt_sm_increase_security() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+  }
+
+} // bonding_opened()
+
+/**
+ * @brief   Records the security mode reported for a connection
+ * @param   connection    connection handle
+ * @param   securityMode  sl_bt_connection_security_t
+ * @return  true if the link is encrypted with a stored bond
+ */
+bool bonding_security_changed(uint8_t connection, uint8_t securityMode) {
+  bonding_link_t *link = find_link(connection);
+  uint32_t        ms;
+  uint32_t        path;
+
+  if((link == NULL) || (securityMode == sl_bt_connection_mode1_level1))
+    return false;
+
+  if(link->encrypted == false){
+    link->encrypted = true;
+    ms = bonding_now_ms() - link->openedMs;
+    path = (link->resumed ? 1 : 0);
+    latencyCount[path]++;
+    latencySumMs[path] += ms;
+
+    LOG_INFO("bonding: encrypted %u ms after open (%s), average %u ms resumed / %u ms paired\r\n",
+             (unsigned int) ms, (link->resumed ? "resumed" : "paired"),
+             (unsigned int) ((latencyCount[1] != 0) ? (latencySumMs[1] / latencyCount[1]) : 0),
+             (unsigned int) ((latencyCount[0] != 0) ? (latencySumMs[0] / latencyCount[0]) : 0));
+  }
+
+  return link->resumed;
+
+} // bonding_security_changed()
+
+/**
+ * @brief   Records a new bond for a connection
+ * @param   connection  connection handle
+ * @param   bonding     bonding handle, SL_BT_INVALID_BONDING_HANDLE if the
+ *                      keys are not kept
+ * @return  none
+ */
+void bonding_bonded(uint8_t connection, uint8_t bonding) {
+
+  if(bonding == SL_BT_INVALID_BONDING_HANDLE){
+    LOG_INFO("bonding: connection %u paired without a stored bond\r\n", (unsigned int) connection);
+    return;
+  }
+
+  LOG_INFO("bonding: connection %u stored as bond %u\r\n", (unsigned int) connection, (unsigned int) bonding);
+
+} // bonding_bonded()
+
+/**
+ * @brief   Stops tracking a connection
+ * @param   connection  connection handle
+ * @return  none
+ */
+void bonding_closed(uint8_t connection) {
+  bonding_link_t *link = find_link(connection);
+
+  if(link != NULL)
+    link->inUse = false;
+
+} // bonding_closed()
@@ -0,0 +1,81 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    bonding.h
+ * @brief   Header file for bonding.c. Persistent bonds with a bounded table
+ *          and encryption resumed on reconnection without user interaction
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#ifndef SRC_BONDING_H_
+#define SRC_BONDING_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Bonds kept in NVM3, 1 to 32
+#define BONDING_MAX_COUNT            (8)
+
+// Bonding policy for sl_bt_sm_store_bonding_configuration()
+// 0 -> new bondings fail when the table is full
+// 1 -> overwrite the oldest bond
+// 2 -> overwrite the bond used the longest time ago
+#define BONDING_POLICY               (2)
+
+// 1 -> delete all bonds at boot, every connection pairs again with a passkey
+#define BONDING_CLEAR_ON_BOOT        0
+
+// Connections tracked at once, SL_BT_CONFIG_MAX_CONNECTIONS
+#define BONDING_MAX_LINKS            (4)
+
+/**
+ * @brief   Configures the bonding table, call once at boot after
+ *          sl_bt_sm_configure()
+ * @return  none
+ */
+void bonding_init(void);
+
+/**
+ * @brief   Starts timing a new connection and resumes encryption right away
+ *          if the peer is bonded
+ * @param   connection  connection handle
+ * @param   bonding     bonding handle from the opened event
+ * @return  none
+ */
+void bonding_opened(uint8_t connection, uint8_t bonding);
+
+/**
+ * @brief   Records the security mode reported for a connection
+ * @param   connection    connection handle
+ * @param   securityMode  sl_bt_connection_security_t
+ * @return  true if the link is encrypted with a stored bond
+ */
+bool bonding_security_changed(uint8_t connection, uint8_t securityMode);
+
+/**
+ * @brief   Records a new bond for a connection
+ * @param   connection  connection handle
+ * @param   bonding     bonding handle, SL_BT_INVALID_BONDING_HANDLE if the
+ *                      keys are not kept
+ * @return  none
+ */
+void bonding_bonded(uint8_t connection, uint8_t bonding);
+
+/**
+ * @brief   Stops tracking a connection
+ * @param   connection  connection handle
+ * @return  none
+ */
+void bonding_closed(uint8_t connection);
+
+#endif /* SRC_BONDING_H_ */
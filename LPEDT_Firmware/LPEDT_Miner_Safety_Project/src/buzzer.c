@@ -0,0 +1,378 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    buzzer.c
+ * @brief   Piezo buzzer playing alarm patterns from a TIMER1 PWM carrier,
+ *          stepped by TIMER0 and the LDMA
+ *
+ *          TIMER1 counts up to the period of the tone and CC0 toggles the pin
+ *          at half of it. TIMER0 runs from HFPERCLK / 1024 and overflows at
+ *          the end of every step. Each overflow requests the DMA channel,
+ *          which walks a chain of descriptors built when the pattern starts:
+ *          per step, the tone period into TIMER1 TOPB, the duty into CC0
+ *          CCVB (0 for a silent step) and the length of the following step
+ *          into TIMER0 TOPB. The buffered registers take effect on the next
+ *          overflow of their timer, so the steps follow each other without
+ *          a glitch. A repeating pattern links its last step back to the
+ *          first and never wakes the CPU; a one shot pattern ends with a
+ *          descriptor that silences the tone and raises the only interrupt.
+ *
+ *          The registers are written directly, this SDK snapshot does not
+ *          carry em_timer. The DMA channel comes from DMADRV, which SPIDRV
+ *          already brings in and which owns the LDMA interrupt.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include "em_device.h"
+#include "em_cmu.h"
+#include "em_core.h"
+#include "em_gpio.h"
+#include "em_ldma.h"
+#include "dmadrv.h"
+#include "buzzer.h"
+#include "energy.h"
+
+// Include logging for this file
+#define INCLUDE_LOG_DEBUG 1
+#include "log.h"
+
+#define STEP_CLOCK_DIV         (1024)
+
+#define NOT_PLAYING            (BUZZER_NUMBER_OF_PATTERNS)
+
+// Descriptors per step, and the one that ends a one shot pattern
+#define DESCRIPTORS_PER_STEP   (3)
+#define MAX_DESCRIPTORS        ((BUZZER_MAX_STEPS * DESCRIPTORS_PER_STEP) + 1)
+
+typedef struct {
+  uint16_t hz;         // 0 for silence
+  uint16_t ms;
+} buzzer_step_t;
+
+typedef struct {
+  const buzzer_step_t *steps;
+  uint8_t              count;
+  bool                 repeat;
+} buzzer_pattern_def_t;
+
+static const buzzer_step_t lowBatterySteps[] = {
+  { BUZZER_TONE_HZ, 60 }, { 0, 80 }, { BUZZER_TONE_HZ, 60 },
+};
+
+static const buzzer_step_t fallSteps[] = {
+  { 3500, 400 }, { 0, 400 },
+};
+
+static const buzzer_step_t sosSteps[] = {
+  { BUZZER_TONE_HZ, 200 }, { 0, 100 }, { BUZZER_TONE_HZ, 200 }, { 0, 100 },
+  { BUZZER_TONE_HZ, 200 }, { 0, 600 },
+};
+
+// A two tone warble nobody mistakes for the others
+static const buzzer_step_t gasSteps[] = {
+  { BUZZER_TONE_HZ, 150 }, { 3000, 150 },
+};
+
+#define PATTERN(s, r)          { (s), sizeof(s) / sizeof((s)[0]), (r) }
+
+static const buzzer_pattern_def_t patterns[BUZZER_NUMBER_OF_PATTERNS] = {
+  [BUZZER_PATTERN_LOW_BATTERY] = PATTERN(lowBatterySteps, false),
+  [BUZZER_PATTERN_FALL]        = PATTERN(fallSteps, true),
+  [BUZZER_PATTERN_SOS]         = PATTERN(sosSteps, true),
+  [BUZZER_PATTERN_GAS]         = PATTERN(gasSteps, true),
+};
+
+static LDMA_Descriptor_t descriptors[MAX_DESCRIPTORS];
+static uint32_t          stepTop[BUZZER_MAX_STEPS];
+static const uint32_t    silence = 0;
+
+static bool              ready = false;
+static unsigned int      channel;
+static uint32_t          toneClockHz;
+static uint32_t          stepClockHz;
+static volatile uint32_t requested = 0;          // one bit per pattern
+static volatile uint32_t playing = NOT_PLAYING;
+
+static void select_pattern(void);
+
+/**
+ * @brief   Returns the TIMER1 period of a tone
+ * @param   hz      tone, 0 for silence
+ * @return  TOP value
+ */
+static uint32_t tone_top(uint32_t hz) {
+  if(hz == 0)
+    hz = BUZZER_TONE_HZ;
+
+  return (toneClockHz / hz) - 1;
+}
+
+/**
+ * @brief   Returns the TIMER0 period of a step
+ * @param   ms      length of the step
+ * @return  TOP value
+ */
+static uint32_t step_top(uint32_t ms) {
+  if(ms > BUZZER_MAX_STEP_MS)
+    ms = BUZZER_MAX_STEP_MS;
+  if(ms == 0)
+    ms = 1;
+
+  return ((stepClockHz * ms) / 1000) - 1;
+}
+
+/**
+ * @brief   Links a descriptor to another
+ * @param   d       descriptor
+ * @param   next    next descriptor
+ * @return  none
+ */
+static void link_to(LDMA_Descriptor_t *d, LDMA_Descriptor_t *next) {
+  d->xfer.linkMode = ldmaLinkModeAbs;
+  d->xfer.link = 1;
+  d->xfer.linkAddr = ((uint32_t) next) >> 2;
+}
+
+/**
+ * @brief   Builds the descriptors of one step
+ * @param   d       first of the DESCRIPTORS_PER_STEP descriptors
+ * @param   def     pattern
+ * @param   step    step index
+ * @return  none
+ */
+static void build_step(LDMA_Descriptor_t *d, const buzzer_pattern_def_t *def, uint32_t step) {
+  const LDMA_Descriptor_t tone = LDMA_DESCRIPTOR_SINGLE_M2P_BYTE(&stepTop[step], &TIMER1->TOPB, 1);
+  const LDMA_Descriptor_t duty = LDMA_DESCRIPTOR_SINGLE_WRITE(0, &TIMER1->CC[0].CCVB);
+  const LDMA_Descriptor_t next = LDMA_DESCRIPTOR_SINGLE_WRITE(0, &TIMER0->TOPB);
+
+  // The tone waits for the TIMER0 overflow, the two writes follow at once
+  d[0] = tone;
+  d[0].xfer.size = ldmaCtrlSizeWord;
+  d[0].xfer.doneIfs = 0;
+  link_to(&d[0], &d[1]);
+
+  d[1] = duty;
+  d[1].wri.immVal = (def->steps[step].hz == 0) ? 0 : (stepTop[step] + 1) / 2;
+  d[1].wri.doneIfs = 0;
+  link_to(&d[1], &d[2]);
+
+  d[2] = next;
+  d[2].wri.immVal = step_top(def->steps[(step + 1) % def->count].ms);
+  d[2].wri.doneIfs = 0;
+}
+
+/**
+ * @brief   Stops the tone and the step clock
+ * @return  none
+ */
+static void stop(void) {
+  DMADRV_StopTransfer(channel);
+  TIMER0->CMD = TIMER_CMD_STOP;
+  TIMER1->CMD = TIMER_CMD_STOP;
+  TIMER1->ROUTEPEN = 0;
+  GPIO_PinOutClear(BUZZER_PORT, BUZZER_PIN);
+}
+
+/**
+ * @brief   Ends a one shot pattern, called by DMADRV from the LDMA interrupt
+ * @param   ch          DMA channel
+ * @param   sequenceNo  callbacks so far
+ * @param   userParam   unused
+ * @return  false, nothing to continue
+ */
+static bool pattern_done(unsigned int ch, unsigned int sequenceNo, void *userParam) {
+  CORE_DECLARE_IRQ_STATE;
+
+  (void) ch;
+  (void) sequenceNo;
+  (void) userParam;
+
+  CORE_ENTER_CRITICAL();
+  if(playing != NOT_PLAYING)
+    requested &= ~(1UL << playing);
+  select_pattern();
+  CORE_EXIT_CRITICAL();
+
+  return false;
+}
+
+/**
+ * @brief   Starts a pattern from its first step, call in a critical section
+ * @param   pattern pattern
+ * @return  none
+ */
+static void play(uint32_t pattern) {
+  const buzzer_pattern_def_t *def = &patterns[pattern];
+  LDMA_TransferCfg_t          xfer = LDMA_TRANSFER_CFG_PERIPHERAL(ldmaPeripheralSignal_TIMER0_UFOF);
+  LDMA_Descriptor_t          *d = &descriptors[0];
+  const LDMA_Descriptor_t     end = LDMA_DESCRIPTOR_SINGLE_M2P_BYTE(&silence, &TIMER1->CC[0].CCVB, 1);
+  Ecode_t                     ec;
+  uint32_t                    i;
+  uint32_t                    step;
+  uint32_t                    chained = def->count + (def->repeat ? 1u : 0u);
+
+  stop();
+
+  for(i = 0; i < def->count; i++)
+    stepTop[i] = tone_top(def->steps[i].hz);
+
+  // Step 0 is written below, the chain starts with step 1 and a repeating
+  // pattern comes back round through step 0
+  for(i = 1; i < chained; i++){
+    step = i % def->count;
+    build_step(d, def, step);
+    if(i > 1)
+      link_to(&d[-1], d);
+    d += DESCRIPTORS_PER_STEP;
+  }
+
+  if(def->repeat){
+    link_to(&d[-1], &descriptors[0]);
+  }
+  else {
+    // Silence at the end of the last step, the only interrupt of the pattern
+    d[0] = end;
+    d[0].xfer.size = ldmaCtrlSizeWord;
+    if(d != &descriptors[0])
+      link_to(&d[-1], d);
+  }
+
+  // Step 0 straight to the registers, the length of step 1 buffered
+  TIMER1->TOP = stepTop[0];
+  TIMER1->CC[0].CCV = (def->steps[0].hz == 0) ? 0 : (stepTop[0] + 1) / 2;
+  TIMER1->CNT = 0;
+  TIMER0->TOP = step_top(def->steps[0].ms);
+  TIMER0->TOPB = step_top(def->steps[1 % def->count].ms);
+  TIMER0->CNT = 0;
+
+  ec = DMADRV_LdmaStartTransfer((int) channel, &xfer, &descriptors[0], pattern_done, NULL);
+  if(ec != ECODE_EMDRV_DMADRV_OK){
+      LOG_ERROR("DMADRV_LdmaStartTransfer() returned != 0 status=0x%08x\r\n", (unsigned int) ec);
+  }
+
+  TIMER1->ROUTEPEN = TIMER_ROUTEPEN_CC0PEN;
+  TIMER1->CMD = TIMER_CMD_START;
+  TIMER0->CMD = TIMER_CMD_START;
+}
+
+/**
+ * @brief   Plays the highest priority pattern requested, or nothing, call in
+ *          a critical section
+ * @return  none
+ */
+static void select_pattern(void) {
+  uint32_t best = NOT_PLAYING;
+  uint32_t i;
+
+  for(i = 0; i < BUZZER_NUMBER_OF_PATTERNS; i++){
+    if(requested & (1UL << i))
+      best = i;
+  }
+
+  if(best == playing)
+    return;
+
+  // The timers stop in EM2, EM1 is held while anything plays
+  if(playing == NOT_PLAYING)
+    ENERGY_REQUIRE(ENERGY_NEED_BUZZER);
+
+  if(best == NOT_PLAYING){
+    stop();
+    ENERGY_RELEASE(ENERGY_NEED_BUZZER);
+  }
+  else {
+    play(best);
+  }
+
+  playing = best;
+}
+
+/**
+ * @brief   Configures the timers, the pin and a DMA channel, the buzzer stays
+ *          silent
+ * @return  none
+ */
+void buzzer_init(void) {
+  Ecode_t ec;
+
+  CMU_ClockEnable(cmuClock_TIMER0, true);
+  CMU_ClockEnable(cmuClock_TIMER1, true);
+
+  // Low while the timer does not own the pin
+  GPIO_PinModeSet(BUZZER_PORT, BUZZER_PIN, gpioModePushPull, 0);
+
+  toneClockHz = CMU_ClockFreqGet(cmuClock_TIMER1);
+  stepClockHz = CMU_ClockFreqGet(cmuClock_TIMER0) / STEP_CLOCK_DIV;
+
+  // Carrier
+  TIMER1->CMD = TIMER_CMD_STOP;
+  TIMER1->CTRL = TIMER_CTRL_MODE_UP | TIMER_CTRL_CLKSEL_PRESCHFPERCLK | TIMER_CTRL_PRESC_DIV1;
+  TIMER1->TOP = tone_top(BUZZER_TONE_HZ);
+  TIMER1->CC[0].CTRL = TIMER_CC_CTRL_MODE_PWM;
+  TIMER1->CC[0].CCV = 0;
+  TIMER1->ROUTELOC0 = BUZZER_LOCATION << _TIMER_ROUTELOC0_CC0LOC_SHIFT;
+  TIMER1->ROUTEPEN = 0;
+  TIMER1->CNT = 0;
+
+  // Step clock, the DMA request clears as soon as the channel serves it
+  TIMER0->CMD = TIMER_CMD_STOP;
+  TIMER0->CTRL = TIMER_CTRL_MODE_UP | TIMER_CTRL_CLKSEL_PRESCHFPERCLK | TIMER_CTRL_PRESC_DIV1024 |
+                 TIMER_CTRL_DMACLRACT;
+  TIMER0->CNT = 0;
+
+  // SPIDRV initialized DMADRV already, this only covers a build without it
+  ec = DMADRV_Init();
+  if((ec != ECODE_EMDRV_DMADRV_OK) && (ec != ECODE_EMDRV_DMADRV_ALREADY_INITIALIZED)){
+      LOG_ERROR("DMADRV_Init() returned != 0 status=0x%08x\r\n", (unsigned int) ec);
+      return;
+  }
+
+  ec = DMADRV_AllocateChannel(&channel, NULL);
+  if(ec != ECODE_EMDRV_DMADRV_OK){
+      LOG_ERROR("DMADRV_AllocateChannel() returned != 0 status=0x%08x\r\n", (unsigned int) ec);
+      return;
+  }
+
+  requested = 0;
+  playing = NOT_PLAYING;
+  ready = true;
+
+} // buzzer_init()
+
+/**
+ * @brief   Requests or releases a pattern, safe to call from an interrupt
+ *          handler
+ * @param   pattern pattern
+ * @param   on      true to request it
+ * @return  none
+ */
+void buzzer_request(buzzer_pattern_t pattern, bool on) {
+  CORE_DECLARE_IRQ_STATE;
+
+  if((ready == false) || (pattern >= BUZZER_NUMBER_OF_PATTERNS))
+    return;
+
+  CORE_ENTER_CRITICAL();
+  if(on)
+    requested |= (1UL << pattern);
+  else
+    requested &= ~(1UL << pattern);
+
+  // A one shot pattern requested again while it plays starts over
+  if(on && (pattern == playing) && (patterns[pattern].repeat == false))
+    play(pattern);
+  else
+    select_pattern();
+  CORE_EXIT_CRITICAL();
+
+} // buzzer_request()
@@ -0,0 +1,75 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    buzzer.h
+ * @brief   Header file for buzzer.c. Piezo buzzer playing alarm patterns
+ *          from a TIMER1 PWM carrier, stepped by TIMER0 and the LDMA
+ *
+ *          The TDK PS series buzzer has no oscillator of its own, it needs a
+ *          square wave near its resonance.
+ *
+ *          Patterns are requested and released independently, the one with
+ *          the highest priority plays. Releasing it falls back to the next
+ *          one still requested, so a gas alarm covers a low battery chirp and
+ *          the chirp never cuts a gas alarm short.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#ifndef SRC_BUZZER_H_
+#define SRC_BUZZER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Buzzer drive pin, TIMER1 CC0 routed to it
+#define BUZZER_PORT                  (gpioPortD)
+#define BUZZER_PIN                   (10)
+#define BUZZER_LOCATION              (_TIMER_ROUTELOC0_CC0LOC_LOC18)   // PD10
+
+// Resonance of the buzzer
+#define BUZZER_TONE_HZ               (4000)
+
+// Steps of the longest pattern
+#define BUZZER_MAX_STEPS             (8)
+
+// Longest step, TIMER0 is 16 bits wide on HFPERCLK / 1024
+#define BUZZER_MAX_STEP_MS           (1500)
+
+// In rising priority
+typedef enum {
+  BUZZER_PATTERN_LOW_BATTERY,  // one chirp, then silent until requested again
+  BUZZER_PATTERN_FALL,
+  BUZZER_PATTERN_SOS,
+  BUZZER_PATTERN_GAS,
+  BUZZER_NUMBER_OF_PATTERNS
+} buzzer_pattern_t;
+
+/**
+ * @brief   Configures the timers, the pin and a DMA channel, the buzzer stays
+ *          silent
+ * @return  none
+ */
+void buzzer_init(void);
+
+/**
+ * @brief   Requests or releases a pattern, safe to call from an interrupt
+ *          handler. While a pattern plays the device does not go below EM1,
+ *          the timers are not clocked in EM2, but the CPU sleeps: the LDMA
+ *          steps through the pattern on its own.
+ * @param   pattern pattern
+ * @param   on      true to request it
+ * @return  none
+ */
+void buzzer_request(buzzer_pattern_t pattern, bool on);
+
+#endif /* SRC_BUZZER_H_ */
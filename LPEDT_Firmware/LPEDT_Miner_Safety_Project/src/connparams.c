@@ -0,0 +1,237 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    connparams.c
+ * @brief   Picks the connection parameters of the server from what currently
+ *          needs the link
+ *
+ *          While idle the link runs a 400 ms interval and lets the server skip
+ *          4 events, so the radio wakes up every 2 s at most. An alarm, a
+ *          reliable stream transfer or an OTA request switches to 15 ms with
+ *          no latency immediately. Going back to idle waits until no demand
+ *          was seen for CONNPARAMS_IDLE_HOLDOFF_MS, so that bursts do not make
+ *          the link flip back and forth.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include "sl_sleeptimer.h"
+#include "connparams.h"
+#include "ble.h"
+
+// Include logging for this file
+#define INCLUDE_LOG_DEBUG 1
+#include "log.h"
+
+typedef struct {
+  uint16_t interval;  // (time in milliseconds / 1.25)
+  uint16_t latency;   // num of connection intervals to skip
+  uint16_t timeout;   // (time in milliseconds / 10), must exceed (1 + latency) * interval * 2
+} conn_profile_params_t;
+
+static const conn_profile_params_t profiles[CONN_NUMBER_OF_PROFILES] = {
+  [CONN_PROFILE_IDLE]   = { 320, 4, 600 },  // 400 ms, off the air for up to 2 s, 6 s timeout
+  [CONN_PROFILE_ACTIVE] = {  12, 0, 100 },  // 15 ms, 1 s timeout
+};
+
+static uint8_t        demands = 0;
+static conn_profile_t requested = CONN_PROFILE_ACTIVE;
+static bool           holdoffRunning = false;
+
+// parameters in use, as reported by the stack
+static uint16_t       acceptedInterval = 0;
+static uint16_t       acceptedLatency = 0;
+static uint32_t       acceptedSinceMs = 0;
+
+// ms spent with an interval of at most ACTIVE (fast) and above it (slow)
+static uint32_t       fastMs = 0;
+static uint32_t       slowMs = 0;
+
+/**
+ * @brief   Returns the time since boot in ms
+ * @return  ms since boot
+ */
+static uint32_t connparams_now_ms(void) {
+  uint64_t ms = 0;
+
+  sl_sleeptimer_tick64_to_ms(sl_sleeptimer_get_tick_count64(), &ms);
+
+  return (uint32_t) ms;
+}
+
+/**
+ * @brief   Adds the time spent on the accepted interval since it was accepted
+ *          to the fast or slow total
+ * @param   now   ms since boot
+ * @return  none
+ */
+static void connparams_close_segment(uint32_t now) {
+
+  if(acceptedInterval == 0)
+    return;
+
+  if(acceptedInterval <= profiles[CONN_PROFILE_ACTIVE].interval)
+    fastMs += now - acceptedSinceMs;
+  else
+    slowMs += now - acceptedSinceMs;
+}
+
+/**
+ * @brief   Starts or stops the single shot SOFT_TIMER_3 hold-off timer
+ * @param   run   true to start the timer, false to stop it
+ * @return  none
+ */
+static void set_holdoff_timer(bool run) {
+  sl_status_t sc;
+
+  if(run == holdoffRunning)
+    return;
+
+  // a timeout of 0 stops the soft timer
+  sc = sl_bt_system_set_soft_timer((run ? ((CONNPARAMS_IDLE_HOLDOFF_MS * SOFT_TIMER_TICK_VALUE_1SEC) / 1000) : 0),
+                                   SOFT_TIMER_3, true);
+  if(sc != SL_STATUS_OK){
+      LOG_ERROR("sl_bt_system_set_soft_timer() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+      return;
+  }
+
+  holdoffRunning = run;
+}
+
+/**
+ * @brief   Asks the client for the parameters of a profile
+ * @param   profile   profile to switch to
+ * @return  none
+ */
+static void request_profile(conn_profile_t profile) {
+  sl_status_t        sc;
+  ble_data_struct_t *ble_data = get_ble_data_ptr();
+
+  if(ble_data->connection_open == false)
+    return;
+
+  sc = sl_bt_connection_set_parameters(
+        ble_data->connectionHandle,   // Connection Handle
+        profiles[profile].interval,   // min connection interval. (time in milliseconds / 1.25)
+        profiles[profile].interval,   // max connection interval. (time in milliseconds / 1.25)
+        profiles[profile].latency,    // num of connection intervals to skip
+        profiles[profile].timeout,    // Supervision time out. (time in milliseconds / 10)
+        0,                            // min_ce length
+        0                             // max_ce length
+        );
+  if(sc != SL_STATUS_OK){
+      LOG_ERROR("sl_bt_connection_set_parameters() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+      return;
+  }
+
+  requested = profile;
+}
+
+/**
+ * @brief   Moves towards the profile the current demands call for
+ * @return  none
+ */
+static void connparams_evaluate(void) {
+
+  if(demands != 0){
+    set_holdoff_timer(false);
+    if(requested != CONN_PROFILE_ACTIVE)
+      request_profile(CONN_PROFILE_ACTIVE);
+    return;
+  }
+
+  if(requested != CONN_PROFILE_IDLE)
+    set_holdoff_timer(true);
+
+}
+
+/**
+ * @brief   Clears all demands, call on connection open and close
+ * @return  none
+ */
+void connparams_reset(void) {
+
+  if(acceptedInterval != 0){
+    connparams_close_segment(connparams_now_ms());
+    LOG_INFO("connparams: %u s at a fast interval, %u s at a slow interval\r\n",
+             (unsigned int) (fastMs / 1000), (unsigned int) (slowMs / 1000));
+  }
+
+  demands = 0;
+  acceptedInterval = 0;
+  acceptedLatency = 0;
+  acceptedSinceMs = connparams_now_ms();
+  fastMs = 0;
+  slowMs = 0;
+
+  // Assume the short interval clients pick for discovery, so that the idle
+  // profile is only requested after the hold-off
+  requested = CONN_PROFILE_ACTIVE;
+  set_holdoff_timer(false);
+  connparams_evaluate();
+
+} // connparams_reset()
+
+/**
+ * @brief   Sets or clears a demand
+ * @param   demand  reason, see conn_demand_t
+ * @param   active  true while the reason holds
+ * @return  none
+ */
+void connparams_set_demand(conn_demand_t demand, bool active) {
+  uint8_t previous = demands;
+
+  if(active)
+    demands |= demand;
+  else
+    demands &= ~demand;
+
+  if(demands != previous)
+    connparams_evaluate();
+
+} // connparams_set_demand()
+
+/**
+ * @brief   SOFT_TIMER_3 handler, requests the idle profile if no demand came
+ *          back during the hold-off
+ * @return  none
+ */
+void connparams_holdoff_expired(void) {
+
+  holdoffRunning = false;
+
+  if(demands == 0)
+    request_profile(CONN_PROFILE_IDLE);
+
+} // connparams_holdoff_expired()
+
+/**
+ * @brief   Records the parameters in use
+ * @param   interval  connection interval, value x 1.25 ms
+ * @param   latency   peripheral latency, connection events
+ * @param   timeout   supervision timeout, value x 10 ms
+ * @return  none
+ */
+void connparams_accepted(uint16_t interval, uint16_t latency, uint16_t timeout) {
+  uint32_t now = connparams_now_ms();
+
+  connparams_close_segment(now);
+
+  acceptedInterval = interval;
+  acceptedLatency = latency;
+  acceptedSinceMs = now;
+
+  LOG_INFO("connparams: interval %u x 1.25 ms, latency %u, timeout %u x 10 ms (requested %s)\r\n",
+           (unsigned int) interval, (unsigned int) latency, (unsigned int) timeout,
+           (requested == CONN_PROFILE_IDLE) ? "idle" : "active");
+
+} // connparams_accepted()
@@ -0,0 +1,77 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    connparams.h
+ * @brief   Header file for connparams.c. Picks the connection parameters of
+ *          the server from what currently needs the link
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#ifndef SRC_CONNPARAMS_H_
+#define SRC_CONNPARAMS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// How long no demand must be present before falling back to the idle profile
+#define CONNPARAMS_IDLE_HOLDOFF_MS  (10000)
+
+// Reasons for a short connection interval, any combination may be active
+typedef enum {
+  CONN_DEMAND_ALARM = 0x01,  // SOS button held or an alarm indication pending
+  CONN_DEMAND_BULK  = 0x02,  // reliable stream has unacknowledged data
+  CONN_DEMAND_OTA   = 0x04,  // OTA update requested by the client
+} conn_demand_t;
+
+typedef enum {
+  CONN_PROFILE_IDLE,    // long interval, high peripheral latency
+  CONN_PROFILE_ACTIVE,  // short interval, no latency
+  CONN_NUMBER_OF_PROFILES
+} conn_profile_t;
+
+/**
+ * @brief   Clears all demands, call on connection open and close. The link
+ *          starts in whatever the client chose and falls back to the idle
+ *          profile after CONNPARAMS_IDLE_HOLDOFF_MS, giving discovery and
+ *          bonding a fast link.
+ * @return  none
+ */
+void connparams_reset(void);
+
+/**
+ * @brief   Sets or clears a demand. Any demand switches to the active profile
+ *          right away, the idle profile is requested once no demand was
+ *          present for CONNPARAMS_IDLE_HOLDOFF_MS.
+ * @param   demand  reason, see conn_demand_t
+ * @param   active  true while the reason holds
+ * @return  none
+ */
+void connparams_set_demand(conn_demand_t demand, bool active);
+
+/**
+ * @brief   SOFT_TIMER_3 handler, requests the idle profile if no demand came
+ *          back during the hold-off
+ * @return  none
+ */
+void connparams_holdoff_expired(void);
+
+/**
+ * @brief   Records the parameters in use, from sl_bt_evt_connection_parameters_id
+ * @param   interval  connection interval, value x 1.25 ms
+ * @param   latency   peripheral latency, connection events
+ * @param   timeout   supervision timeout, value x 10 ms
+ * @return  none
+ */
+void connparams_accepted(uint16_t interval, uint16_t latency, uint16_t timeout);
+
+#endif /* SRC_CONNPARAMS_H_ */
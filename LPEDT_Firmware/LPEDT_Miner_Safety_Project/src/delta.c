@@ -0,0 +1,324 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    delta.c
+ * @brief   Streaming patch decoder that rebuilds a new GBL from the running
+ *          firmware and a delta
+ *
+ *          Between two builds most of the image is unchanged or only moved,
+ *          so the delta mostly says "copy these bytes of the old image" and
+ *          carries only the bytes that are new. The old image is the
+ *          firmware running from flash, read in place, so copies cost no
+ *          RAM. The decoder takes the delta one byte at a time in whatever
+ *          pieces the link delivers; target bytes collect in a
+ *          DELTA_STAGE_SIZE buffer that is written to the storage slot each
+ *          time it fills.
+ *
+ *          The source CRC-32 in the header is checked as soon as the header
+ *          is in, so a delta built against another firmware is refused
+ *          before anything is written. The target CRC-32 is checked by
+ *          delta_finish(), before the bootloader verifies the GBL.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include <string.h>
+
+#include "em_device.h"
+#include "btl_interface.h"
+#include "delta.h"
+#include "fwupdate.h"
+#include "ble_device_type.h"
+
+// Include logging for this file
+#define INCLUDE_LOG_DEBUG 1
+#include "log.h"
+
+#if BUILD_INCLUDES_BLE_SERVER == 1
+
+typedef enum {
+  DELTA_HEADER,
+  DELTA_OP,
+  DELTA_LITERAL,
+  DELTA_COPY_LENGTH,
+  DELTA_COPY_OFFSET,
+  DELTA_DONE,
+} delta_state_t;
+
+static delta_state_t state = DELTA_HEADER;
+static uint8_t       header[DELTA_HEADER_SIZE];
+static uint32_t      headerLen = 0;
+static uint32_t      slotLen = 0;
+
+static uint32_t      sourceSize = 0;
+static uint32_t      targetSize = 0;
+static uint32_t      targetCrc = 0;
+
+static uint32_t      remaining = 0;     // literal bytes still to come
+static uint32_t      varint = 0;
+static uint32_t      varintShift = 0;
+static uint32_t      copyLength = 0;
+static uint32_t      copyEnd = 0;       // source offset after the previous copy
+
+static uint32_t      produced = 0;      // target bytes decoded
+static uint32_t      flushed = 0;       // target bytes written to the slot
+static uint32_t      runningCrc = 0;
+static uint32_t      stage[DELTA_STAGE_SIZE / 4];
+
+/**
+ * @brief   Reads a little endian u32
+ * @param   p   first byte
+ * @return  value
+ */
+static uint32_t get_u32(const uint8_t *p) {
+  return ((uint32_t) p[0]) | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+/**
+ * @brief   Writes the staged bytes to the storage slot, the last piece of
+ *          the target padded with 0xFF to a multiple of 4
+ * @return  0 if successful, else FWUPDATE_ERR_STORAGE
+ */
+static uint8_t flush_stage(void) {
+  uint32_t len = produced - flushed;
+  uint32_t padded = (len + 3) & ~3UL;
+  int32_t  rc;
+
+  if(len == 0)
+    return 0;
+
+  memset(((uint8_t *) &stage[0]) + len, 0xFF, padded - len);
+
+  // Sequential from offset 0, each page is erased as the writes reach it
+  rc = bootloader_eraseWriteStorage(FWUPDATE_SLOT, flushed, (uint8_t *) &stage[0], padded);
+  if(rc != BOOTLOADER_OK){
+      LOG_ERROR("bootloader_eraseWriteStorage() returned != 0 status=0x%04x\r\n", (unsigned int) rc);
+      return FWUPDATE_ERR_STORAGE;
+  }
+
+  flushed = produced;
+
+  return 0;
+}
+
+/**
+ * @brief   Appends target bytes, writing the stage out whenever it fills
+ * @param   data    target bytes
+ * @param   len     number of bytes
+ * @return  0 if successful, else FWUPDATE_ERR_xxx
+ */
+static uint8_t emit(const uint8_t *data, uint32_t len) {
+  uint32_t n;
+  uint8_t  err;
+
+  if(len > targetSize - produced)
+    return FWUPDATE_ERR_PATCH;
+
+  runningCrc = fwupdate_crc32_update(runningCrc, data, len);
+
+  while(len > 0){
+    n = DELTA_STAGE_SIZE - (produced - flushed);
+    if(n > len)
+      n = len;
+    memcpy(((uint8_t *) &stage[0]) + (produced - flushed), data, n);
+    produced += n;
+    data += n;
+    len -= n;
+
+    if((produced - flushed == DELTA_STAGE_SIZE) || (produced == targetSize)){
+      err = flush_stage();
+      if(err != 0)
+        return err;
+    }
+  }
+
+  if(produced == targetSize)
+    state = DELTA_DONE;
+
+  return 0;
+}
+
+/**
+ * @brief   Checks the header against the running firmware and the slot
+ * @return  0 if successful, else FWUPDATE_ERR_xxx
+ */
+static uint8_t check_header(void) {
+  uint32_t crc;
+
+  if(get_u32(&header[0]) != DELTA_MAGIC)
+    return FWUPDATE_ERR_PATCH;
+
+  sourceSize = get_u32(&header[4]);
+  targetSize = get_u32(&header[12]);
+  targetCrc = get_u32(&header[16]);
+
+  if((sourceSize == 0) || (sourceSize > FLASH_SIZE))
+    return FWUPDATE_ERR_BASE;
+
+  if((targetSize == 0) || (targetSize > slotLen))
+    return FWUPDATE_ERR_SIZE;
+
+  // A delta only applies to the firmware it was built against
+  crc = fwupdate_crc32_update(0xFFFFFFFF, (const uint8_t *) DELTA_SOURCE_BASE, sourceSize) ^ 0xFFFFFFFF;
+  if(crc != get_u32(&header[8])){
+    LOG_ERROR("delta: built for another firmware, source CRC 0x%08x\r\n", (unsigned int) crc);
+    return FWUPDATE_ERR_BASE;
+  }
+
+  LOG_INFO("delta: %u bytes from a %u byte source\r\n", (unsigned int) targetSize, (unsigned int) sourceSize);
+
+  return 0;
+}
+
+/**
+ * @brief   Adds a byte to the varint being read
+ * @param   b   delta byte
+ * @return  true when the varint is complete
+ */
+static bool varint_byte(uint8_t b) {
+
+  varint |= ((uint32_t) (b & 0x7F)) << varintShift;
+  varintShift += 7;
+
+  return ((b & 0x80) == 0);
+}
+
+/**
+ * @brief   Starts decoding a new delta
+ * @param   slotLength  bytes the storage slot holds, the target must fit
+ * @return  none
+ */
+void delta_begin(uint32_t slotLength) {
+
+  state = DELTA_HEADER;
+  headerLen = 0;
+  slotLen = slotLength;
+  sourceSize = 0;
+  targetSize = 0;
+  copyEnd = 0;
+  produced = 0;
+  flushed = 0;
+  runningCrc = 0xFFFFFFFF;
+
+} // delta_begin()
+
+/**
+ * @brief   Decodes the next bytes of the delta and writes the target bytes
+ *          they produce to the storage slot
+ * @param   data    delta bytes, in order
+ * @param   len     number of bytes
+ * @return  0 if successful, else FWUPDATE_ERR_xxx
+ */
+uint8_t delta_feed(const uint8_t *data, uint32_t len) {
+  uint32_t i = 0;
+  uint32_t n;
+  int32_t  offset;
+  uint8_t  err;
+
+  while(i < len){
+    switch(state){
+      case DELTA_HEADER:
+        header[headerLen++] = data[i++];
+        if(headerLen == DELTA_HEADER_SIZE){
+          err = check_header();
+          if(err != 0)
+            return err;
+          state = DELTA_OP;
+        }
+        break;
+
+      case DELTA_OP:
+        if(data[i] <= DELTA_OP_LITERAL_MAX){
+          remaining = (uint32_t) data[i] + 1;
+          state = DELTA_LITERAL;
+        }
+        else if(data[i] == DELTA_OP_COPY){
+          varint = 0;
+          varintShift = 0;
+          state = DELTA_COPY_LENGTH;
+        }
+        else
+          return FWUPDATE_ERR_PATCH;
+        i++;
+        break;
+
+      case DELTA_LITERAL:
+        // Straight from the packet, as much of the run as it holds
+        n = len - i;
+        if(n > remaining)
+          n = remaining;
+        err = emit(&data[i], n);
+        if(err != 0)
+          return err;
+        i += n;
+        remaining -= n;
+        if((remaining == 0) && (state != DELTA_DONE))
+          state = DELTA_OP;
+        break;
+
+      case DELTA_COPY_LENGTH:
+        if(varintShift > 28)
+          return FWUPDATE_ERR_PATCH;
+        if(varint_byte(data[i++])){
+          copyLength = varint;
+          varint = 0;
+          varintShift = 0;
+          state = DELTA_COPY_OFFSET;
+        }
+        break;
+
+      case DELTA_COPY_OFFSET:
+        if(varintShift > 28)
+          return FWUPDATE_ERR_PATCH;
+        if(varint_byte(data[i++])){
+          // zigzag: 0, -1, 1, -2, ... -> 0, 1, 2, 3, ...
+          offset = (int32_t) (varint >> 1) ^ -((int32_t) (varint & 1));
+          copyEnd += (uint32_t) offset;
+          if((copyEnd > sourceSize) || (copyLength > sourceSize - copyEnd))
+            return FWUPDATE_ERR_PATCH;
+          state = DELTA_OP;
+          // The source is read in place from flash
+          err = emit((const uint8_t *) (DELTA_SOURCE_BASE + copyEnd), copyLength);
+          if(err != 0)
+            return err;
+          copyEnd += copyLength;
+        }
+        break;
+
+      case DELTA_DONE:
+      default:
+        // Bytes past the end of the target
+        return FWUPDATE_ERR_PATCH;
+    }
+  }
+
+  return 0;
+
+} // delta_feed()
+
+/**
+ * @brief   Checks that the whole target was written and matches its CRC-32
+ * @return  0 if successful, else FWUPDATE_ERR_xxx
+ */
+uint8_t delta_finish(void) {
+
+  if(state != DELTA_DONE)
+    return FWUPDATE_ERR_INCOMPLETE;
+
+  if((runningCrc ^ 0xFFFFFFFF) != targetCrc)
+    return FWUPDATE_ERR_CRC;
+
+  return 0;
+
+} // delta_finish()
+
+#endif
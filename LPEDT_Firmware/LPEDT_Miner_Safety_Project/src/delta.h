@@ -0,0 +1,76 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    delta.h
+ * @brief   Header file for delta.c. Streaming patch decoder that rebuilds a
+ *          new GBL from the running firmware and a delta
+ *
+ *          Delta layout, multi byte fields little endian:
+ *            [0..3]   DELTA_MAGIC
+ *            [4..7]   source size, bytes of flash from DELTA_SOURCE_BASE
+ *            [8..11]  CRC-32 of the source
+ *            [12..15] target size, the GBL
+ *            [16..19] CRC-32 of the target
+ *            then operations until the target is complete:
+ *            0x00..0x7F  DELTA_OP_LITERAL, (op + 1) target bytes follow
+ *            0x80        DELTA_OP_COPY, [varint length][varint offset]
+ *                        copies length bytes of the source; the offset is
+ *                        zigzag coded, relative to the end of the previous
+ *                        copy
+ *
+ *          Varints are LEB128, 7 bits per byte, low bits first.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#ifndef SRC_DELTA_H_
+#define SRC_DELTA_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define DELTA_MAGIC                  (0x3144534DUL)  // "MSD1"
+#define DELTA_HEADER_SIZE            (20)
+
+#define DELTA_OP_LITERAL_MAX         (0x7F)
+#define DELTA_OP_COPY                (0x80)
+
+// Start of the source, the running firmware image as linked
+#define DELTA_SOURCE_BASE            (FLASH_BASE)
+
+// Target bytes gathered before a storage write, multiple of 4. This and
+// the header are all the RAM a delta needs.
+#define DELTA_STAGE_SIZE             (256)
+
+/**
+ * @brief   Starts decoding a new delta
+ * @param   slotLength  bytes the storage slot holds, the target must fit
+ * @return  none
+ */
+void delta_begin(uint32_t slotLength);
+
+/**
+ * @brief   Decodes the next bytes of the delta and writes the target bytes
+ *          they produce to the storage slot
+ * @param   data    delta bytes, in order
+ * @param   len     number of bytes
+ * @return  0 if successful, else FWUPDATE_ERR_xxx
+ */
+uint8_t delta_feed(const uint8_t *data, uint32_t len);
+
+/**
+ * @brief   Checks that the whole target was written and matches its CRC-32
+ * @return  0 if successful, else FWUPDATE_ERR_xxx
+ */
+uint8_t delta_finish(void);
+
+#endif /* SRC_DELTA_H_ */
@@ -0,0 +1,173 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    discovery_cache.c
+ * @brief   Client side cache of the GATT handles of each helmet
+ *
+ *          A full discovery takes six GATT procedures before the first
+ *          measurement arrives. The handles found are stored in NVM3 together
+ *          with the Database Hash of the helmet, one key per helmet. On the
+ *          next connection only the Database Hash is read; if it is unchanged
+ *          the cached handles are used and the client goes straight to
+ *          enabling indications. The hash changes with any change of the
+ *          helmet's GATT database, which makes the cache safe to use.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include <string.h>
+
+#include "discovery_cache.h"
+#include "ble_device_type.h"
+
+// Include logging for this file
+#define INCLUDE_LOG_DEBUG 1
+#include "log.h"
+
+#if BUILD_INCLUDES_BLE_CLIENT == 1
+
+// entry reused next when the cache is full
+static uint32_t nextVictim = 0;
+
+// reconnect-to-first-data latency, [0] full discovery, [1] cached
+static uint32_t latencyCount[2] = { 0, 0 };
+static uint32_t latencySumMs[2] = { 0, 0 };
+
+/**
+ * @brief   Loads one cache entry
+ * @param   index   entry, 0 to DISCOVERY_CACHE_ENTRIES - 1
+ * @param   entry   filled in when valid
+ * @return  true if the key holds a valid entry
+ */
+static bool load_entry(uint32_t index, discovery_cache_entry_t *entry) {
+  sl_status_t sc;
+  size_t      len = 0;
+
+  sc = sl_bt_nvm_load(DISCOVERY_CACHE_KEY_BASE + index, sizeof(discovery_cache_entry_t), &len, (uint8_t *) entry);
+
+  // a key that was never written is not an error
+  return ((sc == SL_STATUS_OK) && (len == sizeof(discovery_cache_entry_t)));
+}
+
+/**
+ * @brief   Finds the entry of an address
+ * @param   address   peer address
+ * @param   entry     filled in when found
+ * @return  index of the entry, DISCOVERY_CACHE_ENTRIES if not found
+ */
+static uint32_t find_entry(const bd_addr *address, discovery_cache_entry_t *entry) {
+  uint32_t i;
+
+  for(i = 0; i < DISCOVERY_CACHE_ENTRIES; i++){
+    if((load_entry(i, entry) == true) && (memcmp(&entry->address, address, sizeof(bd_addr)) == 0))
+      return i;
+  }
+
+  return DISCOVERY_CACHE_ENTRIES;
+}
+
+/**
+ * @brief   Looks up the cached handles of a helmet
+ * @param   address   peer address
+ * @param   entry     filled in when found
+ * @return  true if the helmet is cached
+ */
+bool discovery_cache_lookup(const bd_addr *address, discovery_cache_entry_t *entry) {
+
+  if(DISCOVERY_CACHE_ENABLE == 0)
+    return false;
+
+  return (find_entry(address, entry) < DISCOVERY_CACHE_ENTRIES);
+
+} // discovery_cache_lookup()
+
+/**
+ * @brief   Stores the handles of a helmet, replacing an older entry for the
+ *          same address. When the cache is full the entries are reused in
+ *          turn.
+ * @param   entry     handles and Database Hash of the helmet
+ * @return  none
+ */
+void discovery_cache_store(const discovery_cache_entry_t *entry) {
+  sl_status_t             sc;
+  discovery_cache_entry_t stored;
+  uint32_t                index;
+
+  if(DISCOVERY_CACHE_ENABLE == 0)
+    return;
+
+  index = find_entry(&entry->address, &stored);
+  if(index < DISCOVERY_CACHE_ENTRIES){
+    // flash wear, nothing to do if it did not change
+    if(memcmp(&stored, entry, sizeof(discovery_cache_entry_t)) == 0)
+      return;
+  }
+  else {
+    for(index = 0; index < DISCOVERY_CACHE_ENTRIES; index++){
+      if(load_entry(index, &stored) == false)
+        break;
+    }
+
+    if(index == DISCOVERY_CACHE_ENTRIES){
+      index = nextVictim;
+      nextVictim = (nextVictim + 1) % DISCOVERY_CACHE_ENTRIES;
+    }
+  }
+
+  sc = sl_bt_nvm_save(DISCOVERY_CACHE_KEY_BASE + index, sizeof(discovery_cache_entry_t), (const uint8_t *) entry);
+  if(sc != SL_STATUS_OK){
+      LOG_ERROR("sl_bt_nvm_save() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+  }
+
+} // discovery_cache_store()
+
+/**
+ * @brief   Drops the cached handles of a helmet
+ * @param   address   peer address
+ * @return  none
+ */
+void discovery_cache_forget(const bd_addr *address) {
+  sl_status_t             sc;
+  discovery_cache_entry_t stored;
+  uint32_t                index;
+
+  index = find_entry(address, &stored);
+  if(index == DISCOVERY_CACHE_ENTRIES)
+    return;
+
+  sc = sl_bt_nvm_erase(DISCOVERY_CACHE_KEY_BASE + index);
+  if(sc != SL_STATUS_OK){
+      LOG_ERROR("sl_bt_nvm_erase() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+  }
+
+} // discovery_cache_forget()
+
+/**
+ * @brief   Records the time from connection open to the first measurement
+ * @param   cached    true if discovery was skipped
+ * @param   ms        latency in ms
+ * @return  none
+ */
+void discovery_cache_record_latency(bool cached, uint32_t ms) {
+  uint32_t path = (cached ? 1 : 0);
+
+  latencyCount[path]++;
+  latencySumMs[path] += ms;
+
+  LOG_INFO("discovery: first data %u ms after open (%s), average %u ms cached / %u ms full\r\n",
+           (unsigned int) ms, (cached ? "cached" : "full discovery"),
+           (unsigned int) ((latencyCount[1] != 0) ? (latencySumMs[1] / latencyCount[1]) : 0),
+           (unsigned int) ((latencyCount[0] != 0) ? (latencySumMs[0] / latencyCount[0]) : 0));
+
+} // discovery_cache_record_latency()
+
+#endif
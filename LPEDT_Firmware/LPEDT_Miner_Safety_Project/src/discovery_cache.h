@@ -0,0 +1,80 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    discovery_cache.h
+ * @brief   Header file for discovery_cache.c. Client side cache of the GATT
+ *          handles of each helmet, kept in NVM3 and validated against the
+ *          Database Hash of the helmet
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#ifndef SRC_DISCOVERY_CACHE_H_
+#define SRC_DISCOVERY_CACHE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sl_bt_api.h"
+
+// 1 -> reconnections skip discovery when the Database Hash is unchanged
+// 0 -> full discovery on every connection
+#define DISCOVERY_CACHE_ENABLE       1
+
+// NVM3 keys DISCOVERY_CACHE_KEY_BASE .. + DISCOVERY_CACHE_ENTRIES - 1, the
+// stack allows 0x4000 to 0x407F for user data
+#define DISCOVERY_CACHE_KEY_BASE     (0x4000)
+#define DISCOVERY_CACHE_ENTRIES      (8)
+
+#define DATABASE_HASH_LENGTH         (16)
+
+// Stored as is, must stay within the 56 bytes of a user NVM key
+typedef struct {
+  bd_addr  address;
+  uint8_t  hash[DATABASE_HASH_LENGTH];
+  uint16_t hashHandle;          /**< Database Hash characteristic */
+  uint16_t htmHandle;           /**< Temperature Measurement characteristic */
+  uint16_t buttonHandle;        /**< Button State characteristic */
+} discovery_cache_entry_t;
+
+/**
+ * @brief   Looks up the cached handles of a helmet
+ * @param   address   peer address
+ * @param   entry     filled in when found
+ * @return  true if the helmet is cached
+ */
+bool discovery_cache_lookup(const bd_addr *address, discovery_cache_entry_t *entry);
+
+/**
+ * @brief   Stores the handles of a helmet, replacing an older entry for the
+ *          same address. When the cache is full the entries are reused in
+ *          turn.
+ * @param   entry     handles and Database Hash of the helmet
+ * @return  none
+ */
+void discovery_cache_store(const discovery_cache_entry_t *entry);
+
+/**
+ * @brief   Drops the cached handles of a helmet
+ * @param   address   peer address
+ * @return  none
+ */
+void discovery_cache_forget(const bd_addr *address);
+
+/**
+ * @brief   Records the time from connection open to the first measurement
+ * @param   cached    true if discovery was skipped
+ * @param   ms        latency in ms
+ * @return  none
+ */
+void discovery_cache_record_latency(bool cached, uint32_t ms);
+
+#endif /* SRC_DISCOVERY_CACHE_H_ */
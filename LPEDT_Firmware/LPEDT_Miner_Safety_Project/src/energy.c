@@ -0,0 +1,392 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    energy.c
+ * @brief   Picks the energy mode of every wait at run time from what the
+ *          peripherals need and from the next deadline
+ *
+ *          The power manager is configured down to EM3, energy.c holds one
+ *          EM2 requirement of its own for every wait that must not go there.
+ *          A wait goes to EM3 when no sleeptimer timer is pending, the RTCC
+ *          behind them stops with the LFXO, and the next temperature sample
+ *          is at least ENERGY_EM3_MIN_IDLE_MS away. Once LETIMER0 runs from
+ *          the ULFRCO, the following waits stay in EM3 without that check,
+ *          the switch is already paid for. Needs are counted apart from the
+ *          wait: any EM1 or EM2 need keeps the power manager out of EM3
+ *          whatever the wait picks.
+ *
+ *          A hold is stamped with the sleeptimer tick count when it is
+ *          taken, a release closes the oldest hold of its need: takes and
+ *          releases of one need pair up in order, whichever sites they come
+ *          from. The tick count keeps running whenever a need is held, no
+ *          need is held in EM3.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include "em_core.h"
+#include "em_cmu.h"
+#include "sl_power_manager.h"
+#include "sl_sleeptimer.h"
+#include "energy.h"
+#include "timers.h"
+
+// Include logging for this file
+#define INCLUDE_LOG_DEBUG 1
+#include "log.h"
+
+static const sl_power_manager_em_t needMode[ENERGY_NUMBER_OF_NEEDS] = {
+  [ENERGY_NEED_I2C]        = SL_POWER_MANAGER_EM1,
+  [ENERGY_NEED_BUZZER]     = SL_POWER_MANAGER_EM1,
+  [ENERGY_NEED_LFXO_TIMER] = SL_POWER_MANAGER_EM2,
+};
+
+static const uint32_t needLimitMs[ENERGY_NUMBER_OF_NEEDS] = {
+  [ENERGY_NEED_I2C]        = ENERGY_HOLD_LIMIT_I2C_MS,
+  [ENERGY_NEED_BUZZER]     = ENERGY_HOLD_LIMIT_BUZZER_MS,
+  [ENERGY_NEED_LFXO_TIMER] = ENERGY_HOLD_LIMIT_LFXO_MS,
+};
+
+typedef struct {
+  bool        used;
+  bool        flagged;   // reported as over its bound
+  uint8_t     need;
+  uint16_t    line;
+  const char *func;
+  uint32_t    sinceTick;
+} energy_hold_t;
+
+typedef struct {
+  uint32_t    holds;
+  uint32_t    untracked;   // taken while every hold slot was in use
+  uint32_t    heldTicks;   // closed holds, summed
+  uint32_t    longestTicks;
+  const char *longestFunc;
+  uint16_t    longestLine;
+  uint16_t    lastReleaseLine;
+  const char *lastReleaseFunc;
+} energy_need_stats_t;
+
+static uint8_t holders[ENERGY_NUMBER_OF_NEEDS];
+static energy_hold_t holds[ENERGY_MAX_HOLDS];
+static energy_need_stats_t stats[ENERGY_NUMBER_OF_NEEDS];
+
+static bool waitHeld = false;    // EM2 requirement of the coming wait
+static bool ulfrco = false;      // LETIMER0 runs from the ULFRCO
+static bool lfxoPending = false; // the LFXO was restarted after EM3
+
+static void on_transition(sl_power_manager_em_t from, sl_power_manager_em_t to);
+
+static sl_power_manager_em_transition_event_handle_t transitionHandle;
+static const sl_power_manager_em_transition_event_info_t transitionInfo = {
+  .event_mask = SL_POWER_MANAGER_EVENT_TRANSITION_ENTERING_EM3
+              | SL_POWER_MANAGER_EVENT_TRANSITION_LEAVING_EM3,
+  .on_event = on_transition,
+};
+
+/**
+ * @brief   Opens a hold of a need for its call site
+ * @param   need    peripheral need
+ * @param   func    function of the call site
+ * @param   line    line of the call site
+ * @param   tick    sleeptimer tick count now
+ * @return  none
+ */
+static void hold_open(energy_need_t need, const char *func, uint16_t line, uint32_t tick) {
+  uint32_t i;
+
+  stats[need].holds++;
+
+  for(i = 0; i < ENERGY_MAX_HOLDS; i++){
+    if(holds[i].used == false){
+      holds[i].used = true;
+      holds[i].flagged = false;
+      holds[i].need = (uint8_t) need;
+      holds[i].func = func;
+      holds[i].line = line;
+      holds[i].sinceTick = tick;
+      return;
+    }
+  }
+
+  stats[need].untracked++;
+}
+
+/**
+ * @brief   Closes the oldest hold of a need into its profile
+ * @param   need    peripheral need
+ * @param   func    function of the release
+ * @param   line    line of the release
+ * @param   tick    sleeptimer tick count now
+ * @return  none
+ */
+static void hold_close(energy_need_t need, const char *func, uint16_t line, uint32_t tick) {
+  energy_need_stats_t *s = &stats[need];
+  energy_hold_t       *oldest = NULL;
+  uint32_t             ticks;
+  uint32_t             i;
+
+  s->lastReleaseFunc = func;
+  s->lastReleaseLine = line;
+
+  for(i = 0; i < ENERGY_MAX_HOLDS; i++){
+    if(holds[i].used && (holds[i].need == need) &&
+       ((oldest == NULL) || ((tick - holds[i].sinceTick) > (tick - oldest->sinceTick))))
+      oldest = &holds[i];
+  }
+
+  // Taken while the slots were full
+  if(oldest == NULL)
+    return;
+
+  ticks = tick - oldest->sinceTick;
+  s->heldTicks += ticks;
+  if(ticks > s->longestTicks){
+    s->longestTicks = ticks;
+    s->longestFunc = oldest->func;
+    s->longestLine = oldest->line;
+  }
+
+  oldest->used = false;
+}
+
+/**
+ * @brief   Moves LETIMER0 to the ULFRCO on the way into EM3 and restarts the
+ *          LFXO on the way out, called by the power manager with the
+ *          interrupts disabled
+ * @param   from    energy mode left
+ * @param   to      energy mode entered
+ * @return  none
+ */
+static void on_transition(sl_power_manager_em_t from, sl_power_manager_em_t to) {
+  if(to == SL_POWER_MANAGER_EM3){
+    LETIMER0_Select_Clock(true);
+    ulfrco = true;
+    lfxoPending = false;
+  }
+  else if((from == SL_POWER_MANAGER_EM3) && ulfrco){
+    // Its start-up takes far too long to wait here, see energy_prepare_sleep()
+    CMU_OscillatorEnable(cmuOsc_LFXO, true, false);
+    lfxoPending = true;
+  }
+}
+
+/**
+ * @brief   Returns whether the coming wait may go to EM3
+ * @return  true for EM3, false for EM2
+ */
+static bool em3_pays_off(void) {
+  uint32_t remaining;
+
+  if(ENERGY_EM3_ENABLE == 0)
+    return false;
+
+  // The sleeptimer RTCC runs from the LFXO, which EM3 stops
+  if(sl_sleeptimer_get_remaining_time_of_first_timer(0, &remaining) == SL_STATUS_OK)
+    return false;
+
+  if(ulfrco && (lfxoPending == false))
+    return true;
+
+  if(LETIMER0_Ms_To_Next_Irq() < ENERGY_EM3_GUARD_MS)
+    return false;
+
+  return (LETIMER0_Ms_To_Next_Sample() >= ENERGY_EM3_MIN_IDLE_MS);
+}
+
+/**
+ * @brief   Takes the EM2 requirement of a wait and subscribes to the EM3
+ *          transitions, call once at boot after LETIMER0_Enable()
+ * @return  none
+ */
+void energy_init(void) {
+  uint32_t i;
+
+  for(i = 0; i < ENERGY_NUMBER_OF_NEEDS; i++){
+    holders[i] = 0;
+    stats[i] = (energy_need_stats_t) { 0 };
+  }
+  for(i = 0; i < ENERGY_MAX_HOLDS; i++)
+    holds[i].used = false;
+
+  ulfrco = false;
+  lfxoPending = false;
+  waitHeld = true;
+  sl_power_manager_add_em_requirement(SL_POWER_MANAGER_EM2);
+
+  sl_power_manager_subscribe_em_transition_event(&transitionHandle, &transitionInfo);
+
+} // energy_init()
+
+/**
+ * @brief   Takes a need, the first holder adds its power manager requirement.
+ *          Use ENERGY_REQUIRE(), which fills in the call site.
+ * @param   need    peripheral need
+ * @param   func    function of the call site
+ * @param   line    line of the call site
+ * @return  none
+ */
+void energy_require(energy_need_t need, const char *func, uint16_t line) {
+  CORE_DECLARE_IRQ_STATE;
+
+  CORE_ENTER_CRITICAL();
+  if(holders[need] < UINT8_MAX){
+    if(holders[need]++ == 0)
+      sl_power_manager_add_em_requirement(needMode[need]);
+    hold_open(need, func, line, sl_sleeptimer_get_tick_count());
+  }
+  CORE_EXIT_CRITICAL();
+
+} // energy_require()
+
+/**
+ * @brief   Releases the oldest hold of a need, the last holder removes its
+ *          power manager requirement. Use ENERGY_RELEASE(), which fills in
+ *          the call site.
+ * @param   need    peripheral need
+ * @param   func    function of the call site
+ * @param   line    line of the call site
+ * @return  none
+ */
+void energy_release(energy_need_t need, const char *func, uint16_t line) {
+  CORE_DECLARE_IRQ_STATE;
+  bool held;
+
+  CORE_ENTER_CRITICAL();
+  held = (holders[need] != 0);
+  if(held){
+    if(--holders[need] == 0)
+      sl_power_manager_remove_em_requirement(needMode[need]);
+    hold_close(need, func, line, sl_sleeptimer_get_tick_count());
+  }
+  CORE_EXIT_CRITICAL();
+
+  if(held == false){
+      LOG_ERROR("energy: need %u released while not held at %s:%u\r\n", (unsigned int) need,
+                func, (unsigned int) line);
+  }
+
+} // energy_release()
+
+/**
+ * @brief   Reports holds that went past the bound of their need, once per
+ *          hold, call from the BLE loop on every LETIMER0 underflow
+ * @return  none
+ */
+void energy_check_holds(void) {
+  CORE_DECLARE_IRQ_STATE;
+  energy_hold_t hold;
+  uint32_t      now = sl_sleeptimer_get_tick_count();
+  uint32_t      limit;
+  uint32_t      i;
+  bool          over;
+  bool          found = false;
+
+  for(i = 0; i < ENERGY_MAX_HOLDS; i++){
+    CORE_ENTER_CRITICAL();
+    hold = holds[i];
+    limit = hold.used ? needLimitMs[hold.need] : 0;
+    over = ((limit != 0) && (hold.flagged == false) &&
+            (sl_sleeptimer_tick_to_ms(now - hold.sinceTick) > limit));
+    if(over)
+      holds[i].flagged = true;
+    CORE_EXIT_CRITICAL();
+
+    // Logged outside of the critical section
+    if(over){
+        found = true;
+        LOG_ERROR("energy: need %u held by %s:%u for %u ms, bound %u ms\r\n",
+                  (unsigned int) hold.need, hold.func, (unsigned int) hold.line,
+                  (unsigned int) sl_sleeptimer_tick_to_ms(now - hold.sinceTick), (unsigned int) limit);
+    }
+  }
+
+  if(found)
+    energy_dump();
+
+} // energy_check_holds()
+
+/**
+ * @brief   Writes the current holders and the blocked-sleep profile of every
+ *          need to VCOM
+ * @return  none
+ */
+void energy_dump(void) {
+  CORE_DECLARE_IRQ_STATE;
+  energy_need_stats_t s;
+  energy_hold_t       hold;
+  uint32_t            now = sl_sleeptimer_get_tick_count();
+  uint32_t            held;
+  uint32_t            i;
+
+  for(i = 0; i < ENERGY_NUMBER_OF_NEEDS; i++){
+    CORE_ENTER_CRITICAL();
+    s = stats[i];
+    held = holders[i];
+    CORE_EXIT_CRITICAL();
+
+    LOG_WARN("energy: need %u EM%u, %u held, %u holds, %u untracked, %u ms blocked\r\n",
+             (unsigned int) i, (unsigned int) needMode[i], (unsigned int) held,
+             (unsigned int) s.holds, (unsigned int) s.untracked,
+             (unsigned int) sl_sleeptimer_tick_to_ms(s.heldTicks));
+    if(s.longestFunc != NULL){
+        LOG_WARN("energy:   longest %u ms from %s:%u, last release at %s:%u\r\n",
+                 (unsigned int) sl_sleeptimer_tick_to_ms(s.longestTicks),
+                 s.longestFunc, (unsigned int) s.longestLine,
+                 s.lastReleaseFunc, (unsigned int) s.lastReleaseLine);
+    }
+  }
+
+  for(i = 0; i < ENERGY_MAX_HOLDS; i++){
+    CORE_ENTER_CRITICAL();
+    hold = holds[i];
+    CORE_EXIT_CRITICAL();
+
+    if(hold.used){
+        LOG_WARN("energy:   holder %s:%u of need %u for %u ms\r\n", hold.func,
+                 (unsigned int) hold.line, (unsigned int) hold.need,
+                 (unsigned int) sl_sleeptimer_tick_to_ms(now - hold.sinceTick));
+    }
+  }
+
+} // energy_dump()
+
+/**
+ * @brief   Picks EM2 or EM3 for the coming wait, call from app_is_ok_to_sleep()
+ *          with the interrupts disabled
+ * @return  true, sleeping is always allowed
+ */
+bool energy_prepare_sleep(void) {
+  bool em3;
+
+  // Back on the LFXO as soon as it is stable again
+  if(lfxoPending && ((CMU->STATUS & CMU_STATUS_LFXORDY) != 0)){
+    LETIMER0_Select_Clock(false);
+    ulfrco = false;
+    lfxoPending = false;
+  }
+
+  em3 = em3_pays_off();
+
+  // Adding it while in EM3 raises the LEAVING_EM3 transition at once
+  if(em3 && waitHeld){
+    sl_power_manager_remove_em_requirement(SL_POWER_MANAGER_EM2);
+    waitHeld = false;
+  }
+  else if((em3 == false) && (waitHeld == false)){
+    sl_power_manager_add_em_requirement(SL_POWER_MANAGER_EM2);
+    waitHeld = true;
+  }
+
+  return true;
+
+} // energy_prepare_sleep()
@@ -0,0 +1,131 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    energy.h
+ * @brief   Header file for energy.c. Picks the energy mode of every wait at
+ *          run time from what the peripherals need and from the next deadline
+ *
+ *          Modules never call sl_power_manager_add_em_requirement() directly,
+ *          they take and release an energy_need_t. A need is reference
+ *          counted and stands for the deepest mode its peripheral survives.
+ *          With no need held, every wait goes to EM3 if the next deadline is
+ *          far enough to pay for the LETIMER0 clock switch, EM2 otherwise.
+ *
+ *          In EM3 the LFXO is stopped, LETIMER0 runs from the ULFRCO for as
+ *          long as the device stays in EM3 and goes back to the LFXO once it
+ *          is ready again. The phase of LETIMER0 is carried across both
+ *          switches, timekeeping loses at most one ULFRCO tick per switch and
+ *          runs with the accuracy of the ULFRCO meanwhile.
+ *
+ *          Every take and release carries its call site, through
+ *          ENERGY_REQUIRE() and ENERGY_RELEASE(). Each hold is tracked with
+ *          the site that took it, a hold longer than the bound of its need
+ *          is reported once on VCOM together with all current holders, and
+ *          the time every need kept the MCU out of EM3 is profiled.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#ifndef SRC_ENERGY_H_
+#define SRC_ENERGY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// 1 -> long idle gaps sleep in EM3, 0 -> EM2 is the lowest mode
+#define ENERGY_EM3_ENABLE            1
+
+// Cost of EM3 over EM2: both LETIMER0 clock switches run at the EM0 current
+// and wait a few ULFRCO cycles each for the LF clock domain to sync
+#define ENERGY_SWITCH_US             (6000)
+#define ENERGY_EM0_UA                (3300)
+
+// Saved in EM3 by the stopped LFXO and LF clock tree
+#define ENERGY_EM3_SAVING_NA         (400)
+
+// Shortest idle gap in which EM3 pays for its switches, ms (us x uA / nA)
+#define ENERGY_EM3_MIN_IDLE_MS       ((ENERGY_SWITCH_US * ENERGY_EM0_UA) / ENERGY_EM3_SAVING_NA)
+
+// LETIMER0 is never rescaled this close to one of its own interrupts
+#define ENERGY_EM3_GUARD_MS          (10)
+
+// Holds tracked with their call site at once, more are only counted
+#define ENERGY_MAX_HOLDS             (8)
+
+// Longest legitimate hold of each need, 0 -> unbounded. A transfer is done
+// in a few ms, a measurement in ~100 ms; an alarm plays until it clears.
+#define ENERGY_HOLD_LIMIT_I2C_MS     (1000)
+#define ENERGY_HOLD_LIMIT_BUZZER_MS  (0)
+#define ENERGY_HOLD_LIMIT_LFXO_MS    (5000)
+
+// In the order of their modes
+typedef enum {
+  ENERGY_NEED_I2C,           // I2C0 master transfer, EM1
+  ENERGY_NEED_BUZZER,        // TIMER0/TIMER1 driving the buzzer, EM1
+  ENERGY_NEED_LFXO_TIMER,    // LETIMER0 timed waits on the LFXO, EM2
+  ENERGY_NUMBER_OF_NEEDS
+} energy_need_t;
+
+// Call site of a take or a release
+#define ENERGY_REQUIRE(need)         energy_require((need), __func__, __LINE__)
+#define ENERGY_RELEASE(need)         energy_release((need), __func__, __LINE__)
+
+/**
+ * @brief   Takes the EM2 requirement of a wait and subscribes to the EM3
+ *          transitions, call once at boot after LETIMER0_Enable()
+ * @return  none
+ */
+void energy_init(void);
+
+/**
+ * @brief   Takes a need, the first holder adds its power manager requirement.
+ *          Use ENERGY_REQUIRE(), which fills in the call site.
+ * @param   need    peripheral need
+ * @param   func    function of the call site
+ * @param   line    line of the call site
+ * @return  none
+ */
+void energy_require(energy_need_t need, const char *func, uint16_t line);
+
+/**
+ * @brief   Releases the oldest hold of a need, the last holder removes its
+ *          power manager requirement. Use ENERGY_RELEASE(), which fills in
+ *          the call site.
+ * @param   need    peripheral need
+ * @param   func    function of the call site
+ * @param   line    line of the call site
+ * @return  none
+ */
+void energy_release(energy_need_t need, const char *func, uint16_t line);
+
+/**
+ * @brief   Reports holds that went past the bound of their need, once per
+ *          hold, call from the BLE loop on every LETIMER0 underflow
+ * @return  none
+ */
+void energy_check_holds(void);
+
+/**
+ * @brief   Writes the current holders and the blocked-sleep profile of every
+ *          need to VCOM
+ * @return  none
+ */
+void energy_dump(void);
+
+/**
+ * @brief   Picks EM2 or EM3 for the coming wait, call from app_is_ok_to_sleep()
+ *          with the interrupts disabled
+ * @return  true, sleeping is always allowed
+ */
+bool energy_prepare_sleep(void);
+
+#endif /* SRC_ENERGY_H_ */
@@ -0,0 +1,412 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    fwupdate.c
+ * @brief   Fast firmware update straight into the bootloader storage slot
+ *
+ *          The OTA DFU component reboots into the AppLoader, which runs at
+ *          default link settings with one acknowledged write per connection
+ *          interval. Here the application stays up: BEGIN raises the OTA
+ *          demand so the link moves to the 15 ms interval (the 2M PHY and the
+ *          largest ATT_MTU are already asked for on every connection), and
+ *          the image then arrives as write commands, several per connection
+ *          event, each written to the storage slot as it comes in. Flash pages
+ *          are erased as the writes cross into them. When the link layer
+ *          buffers fill during an erase the controller stops acknowledging
+ *          and the client is held back, no data is lost.
+ *
+ *          COMMIT compares the CRC-32 given at BEGIN, lets the bootloader
+ *          verify the GBL, marks the slot for install and closes the
+ *          connection; the bootloader installs the image on the reboot that
+ *          follows. A bootloader without a storage slot refuses BEGIN, the
+ *          AppLoader path remains for it.
+ *
+ *          create_bl_files.sh builds the GBL, fwupdate_tool.py checks it and
+ *          cuts it into packets.
+ *
+ *          BEGIN_DELTA sends a delta against the running firmware instead
+ *          (fwupdate_tool.py delta), which delta.c turns back into the GBL on
+ *          its way to the slot. COMMIT then also checks the rebuilt GBL
+ *          against the CRC-32 the delta carries.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include <string.h>
+
+#include "sl_sleeptimer.h"
+#include "sl_bt_api.h"
+#include "btl_interface.h"
+#include "gatt_db.h"
+#include "fwupdate.h"
+#include "delta.h"
+#include "connparams.h"
+#include "ble.h"
+#include "ble_device_type.h"
+
+// Include logging for this file
+#define INCLUDE_LOG_DEBUG 1
+#include "log.h"
+
+#if BUILD_INCLUDES_BLE_SERVER == 1
+
+static fwupdate_state_t state = FWUPDATE_IDLE;
+static bool             deltaMode = false;
+static uint32_t         imageSize = 0;
+static uint32_t         imageCrc = 0;
+static uint32_t         received = 0;
+static uint32_t         runningCrc = 0;
+static uint16_t         lastError = 0;
+static uint32_t         dropped = 0;
+static uint32_t         beginMs = 0;
+
+// word aligned copy of one packet, padded with 0xFF to a multiple of 4
+static uint32_t         chunk[(MAX_BUFFER_LENGTH - FWUPDATE_DATA_HEADER_SIZE + 3) / 4];
+
+/**
+ * @brief   Returns the time since boot in ms
+ * @return  ms since boot
+ */
+static uint32_t fwupdate_now_ms(void) {
+  uint64_t ms = 0;
+
+  sl_sleeptimer_tick64_to_ms(sl_sleeptimer_get_tick_count64(), &ms);
+
+  return (uint32_t) ms;
+}
+
+/**
+ * @brief   Reads a little endian u32
+ * @param   p   first byte
+ * @return  value
+ */
+static uint32_t get_u32(const uint8_t *p) {
+  return ((uint32_t) p[0]) | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+/**
+ * @brief   Continues a CRC-32 (IEEE 802.3, reflected), 4 bits at a time
+ * @param   crc     running value, 0xFFFFFFFF to start
+ * @param   data    bytes
+ * @param   len     number of bytes
+ * @return  running value, invert it to get the CRC
+ */
+uint32_t fwupdate_crc32_update(uint32_t crc, const uint8_t *data, uint32_t len) {
+  static const uint32_t nibble[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+  };
+  uint32_t i;
+
+  for(i = 0; i < len; i++){
+    crc ^= data[i];
+    crc = (crc >> 4) ^ nibble[crc & 0x0F];
+    crc = (crc >> 4) ^ nibble[crc & 0x0F];
+  }
+
+  return crc;
+
+} // fwupdate_crc32_update()
+
+/**
+ * @brief   Returns to idle and releases the fast link
+ * @return  none
+ */
+static void fwupdate_reset(void) {
+
+  state = FWUPDATE_IDLE;
+  received = 0;
+  runningCrc = 0xFFFFFFFF;
+  dropped = 0;
+  connparams_set_demand(CONN_DEMAND_OTA, false);
+}
+
+/**
+ * @brief   Starts a transfer
+ * @param   data    BEGIN payload, after the opcode
+ * @param   len     payload length
+ * @param   delta   true if the data is a delta
+ * @return  0 if successful, else FWUPDATE_ERR_xxx
+ */
+static uint8_t fwupdate_begin(const uint8_t *data, uint32_t len, bool delta) {
+  BootloaderStorageInformation_t info;
+  BootloaderStorageSlot_t        slot;
+  int32_t                        rc;
+
+  if((FWUPDATE_ENABLE == 0) || (len < 8) || (state == FWUPDATE_COMMITTED))
+    return FWUPDATE_ERR_STATE;
+
+  rc = bootloader_init();
+  if(rc != BOOTLOADER_OK){
+      LOG_ERROR("bootloader_init() returned != 0 status=0x%04x\r\n", (unsigned int) rc);
+      return FWUPDATE_ERR_STORAGE;
+  }
+
+  bootloader_getStorageInfo(&info);
+  if(info.numStorageSlots <= FWUPDATE_SLOT)
+    return FWUPDATE_ERR_SIZE;
+
+  rc = bootloader_getStorageSlotInfo(FWUPDATE_SLOT, &slot);
+  if(rc != BOOTLOADER_OK){
+      LOG_ERROR("bootloader_getStorageSlotInfo() returned != 0 status=0x%04x\r\n", (unsigned int) rc);
+      return FWUPDATE_ERR_STORAGE;
+  }
+
+  imageSize = get_u32(&data[0]);
+  imageCrc = get_u32(&data[4]);
+  // A delta is checked against the slot once its header is in
+  if((imageSize == 0) || ((delta == false) && (imageSize > slot.length)))
+    return FWUPDATE_ERR_SIZE;
+
+  fwupdate_reset();
+  state = FWUPDATE_RECEIVING;
+  deltaMode = delta;
+  if(delta)
+    delta_begin(slot.length);
+  beginMs = fwupdate_now_ms();
+
+  // 15 ms interval for the whole transfer
+  connparams_set_demand(CONN_DEMAND_OTA, true);
+
+  LOG_INFO("fwupdate: receiving %u %s bytes into slot %u\r\n", (unsigned int) imageSize,
+           (delta ? "delta" : "image"), (unsigned int) FWUPDATE_SLOT);
+
+  return 0;
+}
+
+/**
+ * @brief   Checks the received image and marks it for install
+ * @return  0 if successful, else FWUPDATE_ERR_xxx
+ */
+static uint8_t fwupdate_commit(void) {
+  int32_t  rc;
+  uint32_t ms;
+  uint8_t  err;
+
+  if(state != FWUPDATE_RECEIVING)
+    return FWUPDATE_ERR_STATE;
+
+  if(received != imageSize)
+    return FWUPDATE_ERR_INCOMPLETE;
+
+  if((runningCrc ^ 0xFFFFFFFF) != imageCrc)
+    return FWUPDATE_ERR_CRC;
+
+  if(deltaMode){
+    err = delta_finish();
+    if(err != 0)
+      return err;
+  }
+
+  rc = bootloader_verifyImage(FWUPDATE_SLOT, NULL);
+  if(rc != BOOTLOADER_OK){
+      LOG_ERROR("bootloader_verifyImage() returned != 0 status=0x%04x\r\n", (unsigned int) rc);
+      return FWUPDATE_ERR_VERIFY;
+  }
+
+  rc = bootloader_setImageToBootload(FWUPDATE_SLOT);
+  if(rc != BOOTLOADER_OK){
+      LOG_ERROR("bootloader_setImageToBootload() returned != 0 status=0x%04x\r\n", (unsigned int) rc);
+      return FWUPDATE_ERR_STORAGE;
+  }
+
+  ms = fwupdate_now_ms() - beginMs;
+  LOG_INFO("fwupdate: %u bytes in %u ms (%u kbit/s), %u packets resent\r\n",
+           (unsigned int) imageSize, (unsigned int) ms,
+           (unsigned int) ((ms != 0) ? ((imageSize * 8) / ms) : 0),
+           (unsigned int) dropped);
+
+  state = FWUPDATE_COMMITTED;
+
+  return 0;
+}
+
+/**
+ * @brief   Handles a write to the Firmware Update Control characteristic and
+ *          sends the write response
+ * @param   connection  connection handle
+ * @param   data        value written by the client
+ * @param   len         number of bytes written
+ * @return  none
+ */
+void fwupdate_handle_control(uint8_t connection, const uint8_t *data, uint32_t len) {
+  sl_status_t sc;
+  uint8_t     err = FWUPDATE_ERR_STATE;
+
+  // The GATT database asks for a bonded link, checked again here so a
+  // database built without it cannot let any device in range flash us
+  if(get_ble_data_ptr()->bondingStatus == false){
+    sc = sl_bt_gatt_server_send_user_write_response(connection, gattdb_fw_update_control,
+                                                    FWUPDATE_ERR_AUTHENTICATION);
+    if(sc != SL_STATUS_OK){
+        LOG_ERROR("sl_bt_gatt_server_send_user_write_response() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+    }
+    return;
+  }
+
+  if(len >= 1){
+    switch(data[0]){
+      case FWUPDATE_OP_BEGIN:
+        err = fwupdate_begin(&data[1], len - 1, false);
+        break;
+
+      case FWUPDATE_OP_BEGIN_DELTA:
+        err = fwupdate_begin(&data[1], len - 1, true);
+        break;
+
+      case FWUPDATE_OP_COMMIT:
+        err = fwupdate_commit();
+        break;
+
+      case FWUPDATE_OP_ABORT:
+        if(state != FWUPDATE_COMMITTED)
+          fwupdate_reset();
+        err = 0;
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  lastError = err;
+
+  sc = sl_bt_gatt_server_send_user_write_response(connection, gattdb_fw_update_control, err);
+  if(sc != SL_STATUS_OK){
+      LOG_ERROR("sl_bt_gatt_server_send_user_write_response() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+  }
+
+  // The bootloader installs the image on the reboot after the close
+  if(state == FWUPDATE_COMMITTED){
+    sc = sl_bt_connection_close(connection);
+    if(sc != SL_STATUS_OK){
+        LOG_ERROR("sl_bt_connection_close() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+    }
+  }
+
+} // fwupdate_handle_control()
+
+/**
+ * @brief   Answers a read of the Firmware Update Control characteristic
+ * @param   connection  connection handle
+ * @return  none
+ */
+void fwupdate_read_status(uint8_t connection) {
+  sl_status_t sc;
+  uint8_t     value[7];
+  uint16_t    sent;
+
+  if(get_ble_data_ptr()->bondingStatus == false){
+    sc = sl_bt_gatt_server_send_user_read_response(connection, gattdb_fw_update_control,
+                                                   FWUPDATE_ERR_AUTHENTICATION, 0, NULL, &sent);
+    if(sc != SL_STATUS_OK){
+        LOG_ERROR("sl_bt_gatt_server_send_user_read_response() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+    }
+    return;
+  }
+
+  value[0] = (uint8_t) state;
+  value[1] = (uint8_t) (received);
+  value[2] = (uint8_t) (received >> 8);
+  value[3] = (uint8_t) (received >> 16);
+  value[4] = (uint8_t) (received >> 24);
+  value[5] = (uint8_t) (lastError);
+  value[6] = (uint8_t) (lastError >> 8);
+
+  sc = sl_bt_gatt_server_send_user_read_response(connection, gattdb_fw_update_control, 0,
+                                                 sizeof(value), &value[0], &sent);
+  if(sc != SL_STATUS_OK){
+      LOG_ERROR("sl_bt_gatt_server_send_user_read_response() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+  }
+
+} // fwupdate_read_status()
+
+/**
+ * @brief   Writes a Firmware Update Data packet to the storage slot
+ * @param   data    value written by the client
+ * @param   len     number of bytes written
+ * @return  none
+ */
+void fwupdate_handle_data(const uint8_t *data, uint32_t len) {
+  uint32_t offset;
+  uint32_t payload;
+  uint32_t padded;
+  int32_t  rc;
+  uint8_t  err;
+
+  // A write without response cannot be refused, only ignored
+  if((get_ble_data_ptr()->bondingStatus == false) ||
+     (state != FWUPDATE_RECEIVING) || (len <= FWUPDATE_DATA_HEADER_SIZE))
+    return;
+
+  offset = get_u32(&data[0]);
+  payload = len - FWUPDATE_DATA_HEADER_SIZE;
+
+  // Out of order or past the end, the client resends from received
+  if((offset != received) || (payload > imageSize - received) || (payload > sizeof(chunk))){
+    dropped++;
+    return;
+  }
+
+  if(deltaMode){
+    err = delta_feed(&data[FWUPDATE_DATA_HEADER_SIZE], payload);
+    if(err != 0){
+      lastError = err;
+      fwupdate_reset();
+      return;
+    }
+  }
+  else {
+    // Only the last packet may leave the storage offset unaligned
+    if(((payload & 3) != 0) && (received + payload != imageSize)){
+      dropped++;
+      return;
+    }
+
+    padded = (payload + 3) & ~3UL;
+    memset(&chunk[0], 0xFF, padded);
+    memcpy(&chunk[0], &data[FWUPDATE_DATA_HEADER_SIZE], payload);
+
+    // Sequential from offset 0, each page is erased as the writes reach it
+    rc = bootloader_eraseWriteStorage(FWUPDATE_SLOT, offset, (uint8_t *) &chunk[0], padded);
+    if(rc != BOOTLOADER_OK){
+        LOG_ERROR("bootloader_eraseWriteStorage() returned != 0 status=0x%04x\r\n", (unsigned int) rc);
+        lastError = FWUPDATE_ERR_STORAGE;
+        fwupdate_reset();
+        return;
+    }
+  }
+
+  runningCrc = fwupdate_crc32_update(runningCrc, &data[FWUPDATE_DATA_HEADER_SIZE], payload);
+  received += payload;
+
+} // fwupdate_handle_data()
+
+/**
+ * @brief   Drops an unfinished transfer, or installs a committed image
+ * @return  none
+ */
+void fwupdate_closed(void) {
+
+  if(state == FWUPDATE_COMMITTED){
+    LOG_INFO("fwupdate: rebooting to install\r\n");
+    bootloader_rebootAndInstall();
+  }
+
+  if(state == FWUPDATE_RECEIVING)
+    LOG_INFO("fwupdate: link lost at %u of %u bytes\r\n", (unsigned int) received, (unsigned int) imageSize);
+
+  fwupdate_reset();
+
+} // fwupdate_closed()
+
+#endif
@@ -0,0 +1,125 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    fwupdate.h
+ * @brief   Header file for fwupdate.c. Fast firmware update straight into
+ *          the bootloader storage slot over pipelined write commands
+ *
+ *          Firmware Update Control writes from the client, acknowledged:
+ *            FWUPDATE_OP_BEGIN  [u32 image size][u32 CRC-32 of the image]
+ *                               starts a transfer at offset 0
+ *            FWUPDATE_OP_COMMIT checks the image and reboots into it after
+ *                               the connection closes
+ *            FWUPDATE_OP_ABORT  drops the transfer
+ *            FWUPDATE_OP_BEGIN_DELTA [u32 delta size][u32 CRC-32 of the delta]
+ *                               same as BEGIN, the data is a delta against
+ *                               the running firmware, see delta.h
+ *
+ *          Firmware Update Control read:
+ *            [0]      fwupdate_state_t
+ *            [1..4]   bytes received, the offset of the next data packet
+ *                     (of the delta in a delta transfer)
+ *            [5..6]   last error, FWUPDATE_ERR_xxx or 0
+ *
+ *          Firmware Update Data write commands, not acknowledged:
+ *            [0..3]   u32 offset into the image
+ *            [4..]    image bytes, a multiple of 4 except for the last packet,
+ *                     or delta bytes of any length
+ *
+ *          Multi byte fields are little endian. Packets that do not start at
+ *          the bytes received are dropped, the client reads the control
+ *          characteristic and resends from there.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#ifndef SRC_FWUPDATE_H_
+#define SRC_FWUPDATE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// 1 -> Firmware Update service accepts transfers
+// 0 -> every BEGIN is refused, only the AppLoader path remains
+#define FWUPDATE_ENABLE              1
+
+// Bootloader storage slot that receives the image
+#define FWUPDATE_SLOT                (0)
+
+#define FWUPDATE_DATA_HEADER_SIZE    (4)
+
+// Control opcodes, first byte of a Firmware Update Control write
+#define FWUPDATE_OP_BEGIN            (0x01)
+#define FWUPDATE_OP_COMMIT           (0x02)
+#define FWUPDATE_OP_ABORT            (0x03)
+#define FWUPDATE_OP_BEGIN_DELTA      (0x04)
+
+// ATT error of a control read or write over a link that is not bonded
+#define FWUPDATE_ERR_AUTHENTICATION  (0x05)  // Insufficient Authentication
+
+// ATT application error codes of a refused control write
+#define FWUPDATE_ERR_STATE           (0x80)  // opcode not valid in this state
+#define FWUPDATE_ERR_SIZE            (0x81)  // no storage slot, or the image does not fit
+#define FWUPDATE_ERR_INCOMPLETE      (0x82)  // COMMIT before every byte arrived
+#define FWUPDATE_ERR_CRC             (0x83)  // CRC-32 of the received bytes differs
+#define FWUPDATE_ERR_VERIFY          (0x84)  // bootloader rejected the image
+#define FWUPDATE_ERR_STORAGE         (0x85)  // bootloader storage write failed
+#define FWUPDATE_ERR_BASE            (0x86)  // delta built against another firmware
+#define FWUPDATE_ERR_PATCH           (0x87)  // malformed delta
+
+typedef enum {
+  FWUPDATE_IDLE,
+  FWUPDATE_RECEIVING,
+  FWUPDATE_COMMITTED,
+} fwupdate_state_t;
+
+/**
+ * @brief   Continues a CRC-32 (IEEE 802.3, reflected)
+ * @param   crc     running value, 0xFFFFFFFF to start
+ * @param   data    bytes
+ * @param   len     number of bytes
+ * @return  running value, invert it to get the CRC
+ */
+uint32_t fwupdate_crc32_update(uint32_t crc, const uint8_t *data, uint32_t len);
+
+/**
+ * @brief   Handles a write to the Firmware Update Control characteristic and
+ *          sends the write response
+ * @param   connection  connection handle
+ * @param   data        value written by the client
+ * @param   len         number of bytes written
+ * @return  none
+ */
+void fwupdate_handle_control(uint8_t connection, const uint8_t *data, uint32_t len);
+
+/**
+ * @brief   Answers a read of the Firmware Update Control characteristic
+ * @param   connection  connection handle
+ * @return  none
+ */
+void fwupdate_read_status(uint8_t connection);
+
+/**
+ * @brief   Writes a Firmware Update Data packet to the storage slot
+ * @param   data    value written by the client
+ * @param   len     number of bytes written
+ * @return  none
+ */
+void fwupdate_handle_data(const uint8_t *data, uint32_t len);
+
+/**
+ * @brief   Drops an unfinished transfer, or installs a committed image
+ * @return  none
+ */
+void fwupdate_closed(void);
+
+#endif /* SRC_FWUPDATE_H_ */
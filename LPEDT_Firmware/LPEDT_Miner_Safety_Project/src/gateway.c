@@ -0,0 +1,581 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    gateway.c
+ * @brief   Client side table of concurrently connected helmets and the slot
+ *          scheduler that shares the connections between all helmets in range
+ *
+ *          Every helmet advertising the Health Thermometer service is kept in
+ *          candidates[] while the scanner runs. Each connection owns a slot
+ *          with its own discovery state and handle table, so the discovery
+ *          state machine runs independently for every helmet. At most one
+ *          connection is being opened at a time; the helmet that went longest
+ *          without a slot goes first. When every slot is taken and helmets
+ *          are waiting, the slot held longest is released once it has had
+ *          GATEWAY_SLOT_DWELL_MS, so that every helmet is read in turn.
+ *
+ *          Once helmets are enrolled in the allow-list, scan reports are
+ *          matched by address only (see allowlist.c). The scan duty cycle
+ *          follows how soon a new helmet is expected: high while slots are
+ *          free, lower while all slots are taken, and lowest when no new
+ *          helmet showed up for GATEWAY_QUIET_AFTER_MS.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include <string.h>
+
+#include "sl_sleeptimer.h"
+#include "gateway.h"
+#include "allowlist.h"
+#include "ble.h"
+#include "ble_device_type.h"
+#include "lcd.h"
+
+// Include logging for this file
+#define INCLUDE_LOG_DEBUG 1
+#include "log.h"
+
+#if BUILD_INCLUDES_BLE_CLIENT == 1
+
+// AD structure types listing 16 bit service UUIDs
+#define AD_TYPE_UUID16_INCOMPLETE   (0x02)
+#define AD_TYPE_UUID16_COMPLETE     (0x03)
+
+// Health Thermometer service
+#define HTM_SERVICE_UUID16          (0x1809)
+
+// Connectable scannable undirected advertising
+#define PACKET_TYPE_CONNECTABLE     (0x00)
+
+#define CONNECTION_NONE             (0xFF)
+
+typedef enum {
+  GATEWAY_SCAN_ARRIVAL,   /**< slots free */
+  GATEWAY_SCAN_BUSY,      /**< slots taken, helmets arriving */
+  GATEWAY_SCAN_QUIET,     /**< slots taken, no arrivals */
+  GATEWAY_NUMBER_OF_SCAN_PROFILES
+} gateway_scan_profile_t;
+
+typedef struct {
+  uint16_t interval;      // (time in milliseconds / 0.625)
+  uint16_t window;        // (time in milliseconds / 0.625)
+} gateway_scan_params_t;
+
+// Helmets advertise every 250 ms
+static const gateway_scan_params_t scanProfiles[GATEWAY_NUMBER_OF_SCAN_PROFILES] = {
+  [GATEWAY_SCAN_ARRIVAL] = {   80, 40 },  // 50 ms / 25 ms, 50 %
+  [GATEWAY_SCAN_BUSY]    = {  400, 40 },  // 250 ms / 25 ms, 10 %
+  [GATEWAY_SCAN_QUIET]   = { 1600, 40 },  // 1 s / 25 ms, 2.5 %
+};
+
+typedef struct {
+  bool     valid;
+  bd_addr  address;
+  uint8_t  addressType;
+  uint32_t lastSeenMs;
+  uint32_t lastServedMs;  // 0 -> never had a slot
+} gateway_candidate_t;
+
+static gateway_slot_t      slots[GATEWAY_MAX_SLOTS];
+static gateway_candidate_t candidates[GATEWAY_MAX_CANDIDATES];
+
+static uint8_t  pendingConnection = CONNECTION_NONE;
+static uint32_t pendingSinceMs = 0;
+static uint8_t  closingConnection = CONNECTION_NONE;
+static uint32_t rotations = 0;
+
+static gateway_scan_profile_t scanProfile = GATEWAY_SCAN_ARRIVAL;
+static uint32_t lastArrivalMs = 0;
+static uint32_t statsTicks = 0;
+
+/**
+ * @brief   Returns the time since boot in ms
+ * @return  ms since boot
+ */
+static uint32_t gateway_now_ms(void) {
+  uint64_t ms = 0;
+
+  sl_sleeptimer_tick64_to_ms(sl_sleeptimer_get_tick_count64(), &ms);
+
+  return (uint32_t) ms;
+}
+
+/**
+ * @brief   Looks for the Health Thermometer service in advertising data
+ * @param   data    advertising data
+ * @param   len     length of data
+ * @return  true if the service is listed
+ */
+static bool advertises_htm(const uint8_t *data, uint32_t len) {
+  uint32_t i = 0;
+  uint32_t j;
+  uint8_t  adLen;
+
+  while(i + 1 < len){
+    adLen = data[i];
+    if((adLen == 0) || (i + 1 + adLen > len))
+      break;
+
+    if((data[i+1] == AD_TYPE_UUID16_INCOMPLETE) || (data[i+1] == AD_TYPE_UUID16_COMPLETE)){
+      for(j = i + 2; j + 1 <= i + adLen; j += 2){
+        if((data[j] | (data[j+1] << 8)) == HTM_SERVICE_UUID16)
+          return true;
+      }
+    }
+
+    i += adLen + 1;
+  }
+
+  return false;
+}
+
+/**
+ * @brief   Returns whether an address has a slot
+ * @param   address   peer address
+ * @return  true if connected
+ */
+static bool is_connected(const bd_addr *address) {
+  uint32_t i;
+
+  for(i = 0; i < GATEWAY_MAX_SLOTS; i++){
+    if((slots[i].inUse == true) && (memcmp(&slots[i].address, address, sizeof(bd_addr)) == 0))
+      return true;
+  }
+
+  return false;
+}
+
+/**
+ * @brief   Finds the candidate entry of an address
+ * @param   address   peer address
+ * @return  the entry, NULL if the address is unknown
+ */
+static gateway_candidate_t *find_candidate(const bd_addr *address) {
+  uint32_t i;
+
+  for(i = 0; i < GATEWAY_MAX_CANDIDATES; i++){
+    if((candidates[i].valid == true) && (memcmp(&candidates[i].address, address, sizeof(bd_addr)) == 0))
+      return &candidates[i];
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief   Returns the helmet in range that went longest without a slot
+ * @param   now   ms since boot
+ * @return  the candidate, NULL if nobody is waiting
+ */
+static gateway_candidate_t *next_waiting(uint32_t now) {
+  gateway_candidate_t *best = NULL;
+  uint32_t             i;
+
+  for(i = 0; i < GATEWAY_MAX_CANDIDATES; i++){
+    if(candidates[i].valid == false)
+      continue;
+    if(now - candidates[i].lastSeenMs > GATEWAY_CANDIDATE_EXPIRY_MS)
+      continue;
+    if(is_connected(&candidates[i].address))
+      continue;
+
+    if((best == NULL) || (candidates[i].lastServedMs < best->lastServedMs))
+      best = &candidates[i];
+  }
+
+  return best;
+}
+
+/**
+ * @brief   Opens a connection to the next waiting helmet if a slot is free
+ *          and no other connection is being opened
+ * @return  none
+ */
+static void gateway_schedule(void) {
+  sl_status_t          sc;
+  gateway_candidate_t *next;
+  uint32_t             now = gateway_now_ms();
+
+  if((pendingConnection != CONNECTION_NONE) || (gateway_open_slots() >= GATEWAY_MAX_SLOTS))
+    return;
+
+  next = next_waiting(now);
+  if(next == NULL)
+    return;
+
+  sc = sl_bt_connection_open(next->address, next->addressType, sl_bt_gap_phy_1m, &pendingConnection);
+  if(sc != SL_STATUS_OK){
+      LOG_ERROR("sl_bt_connection_open() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+      pendingConnection = CONNECTION_NONE;
+      return;
+  }
+
+  pendingSinceMs = now;
+}
+
+/**
+ * @brief   Switches the scanner to the duty cycle the expected arrival of
+ *          new helmets calls for
+ * @param   now   ms since boot
+ * @return  none
+ */
+static void gateway_scan_duty(uint32_t now) {
+  sl_status_t            sc;
+  gateway_scan_profile_t profile;
+
+  if(gateway_open_slots() < GATEWAY_MAX_SLOTS)
+    profile = GATEWAY_SCAN_ARRIVAL;
+  else if((now - lastArrivalMs < GATEWAY_QUIET_AFTER_MS) || (next_waiting(now) != NULL))
+    profile = GATEWAY_SCAN_BUSY;
+  else
+    profile = GATEWAY_SCAN_QUIET;
+
+  if(profile == scanProfile)
+    return;
+
+  // New timing only applies when scanning is started
+  sc = sl_bt_scanner_stop();
+  if(sc != SL_STATUS_OK){
+      LOG_ERROR("sl_bt_scanner_stop() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+  }
+
+  sc = sl_bt_scanner_set_timing(sl_bt_gap_1m_phy,
+                                scanProfiles[profile].interval,
+                                scanProfiles[profile].window);
+  if(sc != SL_STATUS_OK){
+      LOG_ERROR("sl_bt_scanner_set_timing() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+  }
+
+  sc = sl_bt_scanner_start(sl_bt_gap_1m_phy, sl_bt_scanner_discover_generic);
+  if(sc != SL_STATUS_OK){
+      LOG_ERROR("sl_bt_scanner_start() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+      return;
+  }
+
+  scanProfile = profile;
+}
+
+/**
+ * @brief   Logs the scan report statistics of the last period
+ * @return  none
+ */
+static void gateway_log_scan_stats(void) {
+  allowlist_stats_t stats;
+
+  allowlist_take_stats(&stats);
+  if(stats.reports == 0)
+    return;
+
+  LOG_INFO("scan: %u reports/s, %u%% rejected (%u%% by bloom filter), %u duplicates, %u accepted\r\n",
+           (unsigned int) (stats.reports / GATEWAY_STATS_PERIOD_S),
+           (unsigned int) ((stats.rejects * 100) / stats.reports),
+           (unsigned int) ((stats.bloomRejects * 100) / stats.reports),
+           (unsigned int) stats.duplicates, (unsigned int) stats.accepts);
+}
+
+/**
+ * @brief   Clears the tables and starts the slot scheduler, call at boot
+ * @return  none
+ */
+void gateway_init(void) {
+  sl_status_t sc;
+
+  memset(&slots[0], 0, sizeof(slots));
+  memset(&candidates[0], 0, sizeof(candidates));
+  pendingConnection = CONNECTION_NONE;
+  closingConnection = CONNECTION_NONE;
+  rotations = 0;
+  scanProfile = GATEWAY_SCAN_ARRIVAL;
+  lastArrivalMs = 0;
+  statsTicks = 0;
+
+  allowlist_init();
+
+  sc = sl_bt_system_set_soft_timer(SOFT_TIMER_TICK_VALUE_1SEC, GATEWAY_SOFT_TIMER, false);
+  if(sc != SL_STATUS_OK){
+      LOG_ERROR("sl_bt_system_set_soft_timer() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+  }
+
+} // gateway_init()
+
+/**
+ * @brief   Remembers helmets that are enrolled, or advertise the Health
+ *          Thermometer service while nothing is enrolled, and connects to one
+ *          if a slot is free
+ * @param   report  scan report from the stack
+ * @return  none
+ */
+void gateway_scan_report(sl_bt_evt_scanner_scan_report_t *report) {
+  gateway_candidate_t *candidate;
+  uint32_t             now = gateway_now_ms();
+  uint32_t             i;
+
+  if(report->packet_type != PACKET_TYPE_CONNECTABLE)
+    return;
+
+  // Enrolled helmets are recognised by their address alone, everything else
+  // is turned away before the advertising data is looked at
+  if((ALLOWLIST_ENABLE == 1) && (allowlist_count() > 0)){
+    if(allowlist_check(&report->address, now) != ALLOWLIST_ACCEPT)
+      return;
+  }
+  else if(advertises_htm(&report->data.data[0], report->data.len) == false){
+    return;
+  }
+
+  candidate = find_candidate(&report->address);
+  if((candidate == NULL) || (now - candidate->lastSeenMs > GATEWAY_CANDIDATE_EXPIRY_MS))
+    lastArrivalMs = now;
+
+  if(candidate == NULL){
+    // take a free entry, or the one not heard from for the longest time
+    candidate = &candidates[0];
+    for(i = 0; i < GATEWAY_MAX_CANDIDATES; i++){
+      if(candidates[i].valid == false){
+        candidate = &candidates[i];
+        break;
+      }
+      if(candidates[i].lastSeenMs < candidate->lastSeenMs)
+        candidate = &candidates[i];
+    }
+
+    candidate->valid = true;
+    candidate->address = report->address;
+    candidate->lastServedMs = 0;
+  }
+
+  candidate->addressType = report->address_type;
+  candidate->lastSeenMs = now;
+
+  gateway_schedule();
+
+} // gateway_scan_report()
+
+/**
+ * @brief   Takes a slot for a new connection
+ * @param   connection  connection handle
+ * @param   address     peer address
+ * @return  the slot, NULL if none is free
+ */
+gateway_slot_t *gateway_slot_opened(uint8_t connection, bd_addr *address) {
+  gateway_slot_t *slot = NULL;
+  uint32_t        i;
+
+  if(connection == pendingConnection)
+    pendingConnection = CONNECTION_NONE;
+
+  for(i = 0; i < GATEWAY_MAX_SLOTS; i++){
+    if(slots[i].inUse == false){
+      slot = &slots[i];
+      break;
+    }
+  }
+
+  if(slot == NULL){
+    LOG_ERROR("gateway: no free slot for connection %u\r\n", (unsigned int) connection);
+    return NULL;
+  }
+
+  memset(slot, 0, sizeof(gateway_slot_t));
+  slot->inUse = true;
+  slot->connection = connection;
+  slot->address = *address;
+  slot->shortId = allowlist_short_id(address);
+  slot->openedMs = gateway_now_ms();
+  slot->discoveryState = State_1;
+  slot->ok_to_send_button_read = true;
+
+  return slot;
+
+} // gateway_slot_opened()
+
+/**
+ * @brief   Frees the slot of a closed connection
+ * @param   connection  connection handle
+ * @return  none
+ */
+void gateway_slot_closed(uint8_t connection) {
+  gateway_slot_t      *slot = gateway_get_slot(connection);
+  gateway_candidate_t *candidate;
+
+  // an attempt that never completed
+  if(connection == pendingConnection)
+    pendingConnection = CONNECTION_NONE;
+
+  if(connection == closingConnection)
+    closingConnection = CONNECTION_NONE;
+
+  if(slot != NULL){
+    candidate = find_candidate(&slot->address);
+    if(candidate != NULL)
+      candidate->lastServedMs = gateway_now_ms();
+
+    LOG_INFO("gateway: helmet %02X:%02X:%02X:%02X:%02X:%02X left after %u s, %u samples\r\n",
+             slot->address.addr[5], slot->address.addr[4], slot->address.addr[3],
+             slot->address.addr[2], slot->address.addr[1], slot->address.addr[0],
+             (unsigned int) ((gateway_now_ms() - slot->openedMs) / 1000),
+             (unsigned int) slot->samples);
+
+    slot->inUse = false;
+  }
+
+  gateway_schedule();
+
+} // gateway_slot_closed()
+
+/**
+ * @brief   Finds the slot of a connection
+ * @param   connection  connection handle
+ * @return  the slot, NULL if the connection has none
+ */
+gateway_slot_t *gateway_get_slot(uint8_t connection) {
+  uint32_t i;
+
+  for(i = 0; i < GATEWAY_MAX_SLOTS; i++){
+    if((slots[i].inUse == true) && (slots[i].connection == connection))
+      return &slots[i];
+  }
+
+  return NULL;
+
+} // gateway_get_slot()
+
+/**
+ * @brief   Returns the slot the push buttons act on, the most recently
+ *          connected helmet
+ * @return  the slot, NULL if nothing is connected
+ */
+gateway_slot_t *gateway_get_focus(void) {
+  gateway_slot_t *focus = NULL;
+  uint32_t        i;
+
+  for(i = 0; i < GATEWAY_MAX_SLOTS; i++){
+    if(slots[i].inUse == false)
+      continue;
+    if((focus == NULL) || (slots[i].openedMs > focus->openedMs))
+      focus = &slots[i];
+  }
+
+  return focus;
+
+} // gateway_get_focus()
+
+/**
+ * @brief   Returns the number of connected helmets
+ * @return  slots in use
+ */
+uint32_t gateway_open_slots(void) {
+  uint32_t i;
+  uint32_t count = 0;
+
+  for(i = 0; i < GATEWAY_MAX_SLOTS; i++){
+    if(slots[i].inUse == true)
+      count++;
+  }
+
+  return count;
+
+} // gateway_open_slots()
+
+/**
+ * @brief   Slot scheduler, runs every second on GATEWAY_SOFT_TIMER. Times out
+ *          connection attempts and rotates a slot when helmets are waiting.
+ * @return  none
+ */
+void gateway_tick(void) {
+  sl_status_t     sc;
+  gateway_slot_t *oldest = NULL;
+  uint32_t        now = gateway_now_ms();
+  uint32_t        i;
+
+  gateway_scan_duty(now);
+
+  if(++statsTicks >= GATEWAY_STATS_PERIOD_S){
+    statsTicks = 0;
+    gateway_log_scan_stats();
+  }
+
+  // The stack keeps trying to connect until told otherwise
+  if((pendingConnection != CONNECTION_NONE) && (now - pendingSinceMs > GATEWAY_CONNECT_TIMEOUT_MS)){
+    sc = sl_bt_connection_close(pendingConnection);
+    if(sc != SL_STATUS_OK){
+        LOG_ERROR("sl_bt_connection_close() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+    }
+    // the closed event frees it
+    pendingSinceMs = now;
+    return;
+  }
+
+  if((gateway_open_slots() < GATEWAY_MAX_SLOTS) || (closingConnection != CONNECTION_NONE))
+    return;
+
+  if(next_waiting(now) == NULL)
+    return;
+
+  for(i = 0; i < GATEWAY_MAX_SLOTS; i++){
+    if((oldest == NULL) || (slots[i].openedMs < oldest->openedMs))
+      oldest = &slots[i];
+  }
+
+  if(now - oldest->openedMs < GATEWAY_SLOT_DWELL_MS)
+    return;
+
+  sc = sl_bt_connection_close(oldest->connection);
+  if(sc != SL_STATUS_OK){
+      LOG_ERROR("sl_bt_connection_close() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+      return;
+  }
+
+  closingConnection = oldest->connection;
+  rotations++;
+  LOG_INFO("gateway: rotating out connection %u (%u rotations)\r\n",
+           (unsigned int) oldest->connection, (unsigned int) rotations);
+
+} // gateway_tick()
+
+/**
+ * @brief   Records a temperature reading of a helmet
+ * @param   slot        helmet
+ * @param   temperature degC
+ * @return  none
+ */
+void gateway_record_temperature(gateway_slot_t *slot, int32_t temperature) {
+
+  // first measurement since the connection was opened
+  if(slot->samples == 0)
+    discovery_cache_record_latency(slot->cacheHit, gateway_now_ms() - slot->openedMs);
+
+  slot->temperature = temperature;
+  slot->samples++;
+
+  LOG_INFO("gateway: helmet #%u %02X:%02X:%02X:%02X:%02X:%02X temp=%d C\r\n",
+           (unsigned int) slot->shortId,
+           slot->address.addr[5], slot->address.addr[4], slot->address.addr[3],
+           slot->address.addr[2], slot->address.addr[1], slot->address.addr[0],
+           (int) temperature);
+
+} // gateway_record_temperature()
+
+/**
+ * @brief   Records the button state of a helmet
+ * @param   slot        helmet
+ * @param   button      button state
+ * @return  none
+ */
+void gateway_record_button(gateway_slot_t *slot, uint8_t button) {
+
+  slot->button = button;
+  slot->samples++;
+
+} // gateway_record_button()
+
+#endif
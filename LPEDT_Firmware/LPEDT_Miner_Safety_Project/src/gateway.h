@@ -0,0 +1,174 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    gateway.h
+ * @brief   Header file for gateway.c. Client side table of concurrently
+ *          connected helmets and the slot scheduler that shares the
+ *          connections between all helmets in range
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#ifndef SRC_GATEWAY_H_
+#define SRC_GATEWAY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sl_bt_api.h"
+#include "discovery_cache.h"
+
+// Concurrent connections, must not exceed SL_BT_CONFIG_MAX_CONNECTIONS
+#define GATEWAY_MAX_SLOTS            (4)
+
+// Helmets remembered while waiting for a slot
+#define GATEWAY_MAX_CANDIDATES       (16)
+
+// A helmet keeps its slot at least this long when others are waiting
+#define GATEWAY_SLOT_DWELL_MS        (30000)
+
+// A helmet not heard for this long is no longer waiting for a slot
+#define GATEWAY_CANDIDATE_EXPIRY_MS  (10000)
+
+// Give up on a connection attempt after this long
+#define GATEWAY_CONNECT_TIMEOUT_MS   (3000)
+
+// Scan duty cycle drops to the quiet profile when no new helmet showed up
+// for this long while all slots are taken
+#define GATEWAY_QUIET_AFTER_MS       (60000)
+
+// Scan statistics are logged every GATEWAY_STATS_PERIOD_S seconds
+#define GATEWAY_STATS_PERIOD_S       (60)
+
+// SOFT_TIMER_1 is free in client builds
+#define GATEWAY_SOFT_TIMER           (1)
+
+// Discovery and subscription states, one instance per slot
+typedef enum {
+  State_1,
+  State_2,
+  State_3,
+  State_4,
+  State_5,
+  State_6,
+  State_7,
+  State_8,
+  State_9,
+  State_10,
+  State_11,
+  State_12
+} Discovery_States_t;
+
+// One connected helmet
+typedef struct {
+  bool               inUse;
+  uint8_t            connection;
+  bd_addr            address;
+  uint16_t           shortId;               /**< 0 if not enrolled */
+  uint32_t           openedMs;
+
+  Discovery_States_t discoveryState;
+  uint32_t           serviceHandle;         /**< last service found */
+  uint16_t           characteristicHandle;  /**< last characteristic found */
+
+  uint32_t           serviceHandleHTM;
+  uint32_t           serviceHandleButton;
+  uint16_t           characteristicHandleHTM;
+  uint16_t           characteristicHandleButton;
+
+  bool               isIndicationOnButton;
+  bool               ok_to_send_button_read;
+
+  // discovery cache, see discovery_cache.c
+  bool                    cacheHit;     /**< discovery skipped */
+  discovery_cache_entry_t cache;        /**< handles in use and expected hash */
+  uint8_t                 peerHash[DATABASE_HASH_LENGTH];
+  bool                    peerHashValid;
+
+  // aggregated telemetry
+  int32_t            temperature;
+  uint8_t            button;
+  uint32_t           samples;
+} gateway_slot_t;
+
+/**
+ * @brief   Clears the tables and starts the slot scheduler, call at boot
+ * @return  none
+ */
+void gateway_init(void);
+
+/**
+ * @brief   Remembers helmets that advertise the Health Thermometer service
+ *          and connects to one if a slot is free
+ * @param   report  scan report from the stack
+ * @return  none
+ */
+void gateway_scan_report(sl_bt_evt_scanner_scan_report_t *report);
+
+/**
+ * @brief   Takes a slot for a new connection
+ * @param   connection  connection handle
+ * @param   address     peer address
+ * @return  the slot, NULL if none is free
+ */
+gateway_slot_t *gateway_slot_opened(uint8_t connection, bd_addr *address);
+
+/**
+ * @brief   Frees the slot of a closed connection
+ * @param   connection  connection handle
+ * @return  none
+ */
+void gateway_slot_closed(uint8_t connection);
+
+/**
+ * @brief   Finds the slot of a connection
+ * @param   connection  connection handle
+ * @return  the slot, NULL if the connection has none
+ */
+gateway_slot_t *gateway_get_slot(uint8_t connection);
+
+/**
+ * @brief   Returns the slot the push buttons act on, the most recently
+ *          connected helmet
+ * @return  the slot, NULL if nothing is connected
+ */
+gateway_slot_t *gateway_get_focus(void);
+
+/**
+ * @brief   Returns the number of connected helmets
+ * @return  slots in use
+ */
+uint32_t gateway_open_slots(void);
+
+/**
+ * @brief   Slot scheduler, runs every second on GATEWAY_SOFT_TIMER. Times out
+ *          connection attempts and rotates a slot when helmets are waiting.
+ * @return  none
+ */
+void gateway_tick(void);
+
+/**
+ * @brief   Records a temperature reading of a helmet
+ * @param   slot        helmet
+ * @param   temperature degC
+ * @return  none
+ */
+void gateway_record_temperature(gateway_slot_t *slot, int32_t temperature);
+
+/**
+ * @brief   Records the button state of a helmet
+ * @param   slot        helmet
+ * @param   button      button state
+ * @return  none
+ */
+void gateway_record_button(gateway_slot_t *slot, uint8_t button);
+
+#endif /* SRC_GATEWAY_H_ */
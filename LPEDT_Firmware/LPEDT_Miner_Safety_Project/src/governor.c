@@ -0,0 +1,156 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    governor.c
+ * @brief   Duty cycle governor, picks an energy profile from the state of
+ *          charge and the harvest rate
+ *
+ *          The profile is re-evaluated every time battery.c has a new half
+ *          buffer, once a minute. The state of charge picks the profile with
+ *          GOVERNOR_SOC_HYST of hysteresis on the way back up, a harvester
+ *          that visibly charges the cell buys one profile more, and a low
+ *          VBAT_OK forces the critical profile. The profile is pushed into
+ *          timers.c, ble.c, lcd.c and log.c; the temperature state machine
+ *          reads the Si7021 resolution from governor_profile() itself.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include "governor.h"
+#include "battery.h"
+#include "timers.h"
+#include "ble.h"
+#include "lcd.h"
+#include "ble_device_type.h"
+
+// Include logging for this file
+#define INCLUDE_LOG_DEBUG 1
+#include "log.h"
+
+#if BUILD_INCLUDES_BLE_SERVER == 1
+
+static const governor_profile_t profiles[GOVERNOR_NUMBER_OF_PROFILES] = {
+  //                            sample  adv   beacon  display  log              Si7021
+  [GOVERNOR_PROFILE_FULL]     = {  3000,  400, 1600,      0, LOG_LEVEL_INFO,  14 },
+  [GOVERNOR_PROFILE_ECO]      = {  6000,  800, 3200,   3000, LOG_LEVEL_WARN,  13 },
+  [GOVERNOR_PROFILE_SAVER]    = { 15000, 1600, 4800,  10000, LOG_LEVEL_WARN,  12 },
+  [GOVERNOR_PROFILE_CRITICAL] = { 60000, 3200, 8000,  30000, LOG_LEVEL_ERROR, 11 },
+};
+
+static governor_profile_id_t current = GOVERNOR_PROFILE_FULL;
+
+/**
+ * @brief   Returns the profile of a state of charge, thresholds only
+ * @param   soc     state of charge, %
+ * @return  profile ID
+ */
+static governor_profile_id_t profile_of(int32_t soc) {
+  if(soc >= GOVERNOR_SOC_FULL)
+    return GOVERNOR_PROFILE_FULL;
+  if(soc >= GOVERNOR_SOC_ECO)
+    return GOVERNOR_PROFILE_ECO;
+  if(soc >= GOVERNOR_SOC_SAVER)
+    return GOVERNOR_PROFILE_SAVER;
+  return GOVERNOR_PROFILE_CRITICAL;
+}
+
+/**
+ * @brief   Pushes a profile into the modules it covers
+ * @param   id      profile ID
+ * @return  none
+ */
+static void apply(governor_profile_id_t id) {
+  const governor_profile_t *p = &profiles[id];
+
+  current = id;
+
+  LETIMER0_Set_Sample_Period(p->samplePeriodMs);
+  ble_set_advertising_intervals(p->advInterval, p->beaconInterval);
+  displaySetRefreshPeriod(p->displayPeriodMs);
+  loggerSetVerbosity(p->logLevel);
+}
+
+/**
+ * @brief   Applies GOVERNOR_PROFILE_FULL, call once at boot after the
+ *          display is initialized
+ * @return  none
+ */
+void governor_init(void) {
+
+  apply(GOVERNOR_PROFILE_FULL);
+
+} // governor_init()
+
+/**
+ * @brief   Picks the profile for the current battery state and applies it if
+ *          it changed, call after battery_process()
+ * @return  none
+ */
+void governor_update(void) {
+  int32_t               soc = battery_soc();
+  governor_profile_id_t down;
+  governor_profile_id_t up;
+  governor_profile_id_t next = current;
+
+  // Nothing measured yet
+  if((GOVERNOR_ENABLE == 0) || (battery_mv() == 0))
+    return;
+
+  down = profile_of(soc);
+  up = profile_of(soc - GOVERNOR_SOC_HYST);
+
+  if(battery_trend_mv_per_hour() >= GOVERNOR_HARVEST_MV_PER_HOUR){
+    if(down > GOVERNOR_PROFILE_FULL)
+      down--;
+    if(up > GOVERNOR_PROFILE_FULL)
+      up--;
+  }
+
+  // Savings are taken at once, a richer profile needs the hysteresis
+  if(up < current)
+    next = up;
+  else if(down > current)
+    next = down;
+
+  if(battery_vbat_ok() == false)
+    next = GOVERNOR_PROFILE_CRITICAL;
+
+  if(next == current)
+    return;
+
+  LOG_WARN("governor: profile %u -> %u at %u %%, %d mV/h\r\n", (unsigned int) current,
+           (unsigned int) next, (unsigned int) soc, (int) battery_trend_mv_per_hour());
+  apply(next);
+
+} // governor_update()
+
+/**
+ * @brief   Returns the profile in force
+ * @return  profile
+ */
+const governor_profile_t *governor_profile(void) {
+
+  return &profiles[current];
+
+} // governor_profile()
+
+/**
+ * @brief   Returns which profile is in force
+ * @return  profile ID
+ */
+governor_profile_id_t governor_profile_id(void) {
+
+  return current;
+
+} // governor_profile_id()
+
+#endif
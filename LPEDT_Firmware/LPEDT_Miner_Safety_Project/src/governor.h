@@ -0,0 +1,94 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    governor.h
+ * @brief   Header file for governor.c. Duty cycle governor, picks an energy
+ *          profile from the state of charge and the harvest rate
+ *
+ *          A profile sets the temperature sampling period, the advertising
+ *          intervals, how often the LCD is refreshed, the log verbosity and
+ *          the Si7021 resolution. Alarms are outside of it: the buzzer, the
+ *          alarm beacon interval and the alarm indication behave the same in
+ *          every profile.
+ *
+ *          The thresholds and the profile table are mirrored by the governor
+ *          command of telemetry_tool.py, change both together.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#ifndef SRC_GOVERNOR_H_
+#define SRC_GOVERNOR_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// 1 -> the profile follows the battery, 0 -> GOVERNOR_PROFILE_FULL always
+#define GOVERNOR_ENABLE              1
+
+// Lowest state of charge of each profile, %
+#define GOVERNOR_SOC_FULL            (60)
+#define GOVERNOR_SOC_ECO             (30)
+#define GOVERNOR_SOC_SAVER           (15)
+
+// A richer profile is only taken back this far above its threshold
+#define GOVERNOR_SOC_HYST            (3)
+
+// A battery rising at least this fast gets one profile richer than its
+// state of charge alone would give
+#define GOVERNOR_HARVEST_MV_PER_HOUR (10)
+
+// In rising savings
+typedef enum {
+  GOVERNOR_PROFILE_FULL,
+  GOVERNOR_PROFILE_ECO,
+  GOVERNOR_PROFILE_SAVER,
+  GOVERNOR_PROFILE_CRITICAL,
+  GOVERNOR_NUMBER_OF_PROFILES
+} governor_profile_id_t;
+
+typedef struct {
+  uint32_t samplePeriodMs;   // temperature, a multiple of LETIMER_PERIOD_MS
+  uint16_t advInterval;      // connectable advertiser, value x 0.625 ms
+  uint16_t beaconInterval;   // sensor summary outside alarms, value x 0.625 ms
+  uint32_t displayPeriodMs;  // shortest time between LCD refreshes, 0 at once
+  uint8_t  logLevel;         // LOG_LEVEL_*, see log.h
+  uint8_t  temperatureBits;  // Si7021 resolution, 11 to 14
+} governor_profile_t;
+
+/**
+ * @brief   Applies GOVERNOR_PROFILE_FULL, call once at boot after the
+ *          display is initialized
+ * @return  none
+ */
+void governor_init(void);
+
+/**
+ * @brief   Picks the profile for the current battery state and applies it if
+ *          it changed, call after battery_process()
+ * @return  none
+ */
+void governor_update(void);
+
+/**
+ * @brief   Returns the profile in force
+ * @return  profile
+ */
+const governor_profile_t *governor_profile(void);
+
+/**
+ * @brief   Returns which profile is in force
+ * @return  profile ID
+ */
+governor_profile_id_t governor_profile_id(void);
+
+#endif /* SRC_GOVERNOR_H_ */
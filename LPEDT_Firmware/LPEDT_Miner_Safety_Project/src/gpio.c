@@ -28,6 +28,8 @@
 
 #include <stdbool.h>
 #include "em_gpio.h"
+#include "em_prs.h"
+#include "em_cmu.h"
 #include <string.h>
 
 #include "gpio.h"
@@ -51,6 +53,11 @@
 #define LCD_EXTCOMIN_PORT (gpioPortD)
 #define LCD_EXTCOMIN_PIN (13)
 
+// PD13 is available as PRS_CH4 location 4, see the datasheet alternate
+// functionality table
+#define LCD_EXTCOMIN_PRS_CH  (4)
+#define LCD_EXTCOMIN_PRS_LOC (4)
+
 #define PB0_PORT  (gpioPortF)
 #define PB1_PORT  (gpioPortF)
 #define PB0_PIN (6)
@@ -212,7 +219,26 @@ void gpioSetDisplayExtcomin(bool state){
     GPIO_PinOutClear(LCD_EXTCOMIN_PORT, LCD_EXTCOMIN_PIN);
 }
 
-
-
-
-
+/**
+ * @brief   Routes (or un-routes) the PRS channel carrying the EXTCOMIN pulse
+ *          to the EXTCOMIN pin of the LCD
+ * @param   enable true to hand the pin to the PRS, false to give it back to
+ *                 gpioSetDisplayExtcomin()
+ * @return  none
+ */
+void gpioDisplayExtcominPrsEnable(bool enable){
+  CMU_ClockEnable(cmuClock_PRS, true);
+
+  if(enable == true){
+    // CRYOTIMER period output is an asynchronous signal, so the channel keeps
+    // running while we sit in EM2/EM3
+    PRS_SourceAsyncSignalSet(LCD_EXTCOMIN_PRS_CH,
+                             PRS_CH_CTRL_SOURCESEL_CRYOTIMER,
+                             PRS_CH_CTRL_SIGSEL_CRYOTIMERPERIOD);
+    PRS_GpioOutputLocation(LCD_EXTCOMIN_PRS_CH, LCD_EXTCOMIN_PRS_LOC);
+  }
+  else{
+    PRS->ROUTEPEN &= ~(1UL << LCD_EXTCOMIN_PRS_CH);
+    GPIO_PinOutClear(LCD_EXTCOMIN_PORT, LCD_EXTCOMIN_PIN);
+  }
+}
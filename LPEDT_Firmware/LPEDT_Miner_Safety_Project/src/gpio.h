@@ -98,6 +98,15 @@ void si7021TurnOff();
  */
 void gpioSetDisplayExtcomin(bool state);
 
+/**
+ * @brief   Routes (or un-routes) the PRS channel carrying the EXTCOMIN pulse
+ *          to the EXTCOMIN pin of the LCD
+ * @param   enable true to hand the pin to the PRS, false to give it back to
+ *                 gpioSetDisplayExtcomin()
+ * @return  none
+ */
+void gpioDisplayExtcominPrsEnable(bool enable);
+
 void gpioSpiCs(int x);
 
 #endif /* SRC_GPIO_H_ */
@@ -30,6 +30,7 @@
 I2C_TransferReturn_TypeDef transferStatus; // make this global for IRQs in A4
 I2C_TransferSeq_TypeDef transferSequence; // this one can be local
 uint8_t cmd_data; // make this global for IRQs in A4
+uint8_t reg_data[2]  = {0,0}; // register write, global for the IRQ as well
 uint8_t read_data[2]  = {0,0}; // make this global for IRQs in A4
 
 /**
@@ -101,6 +102,33 @@ void I2C_Write_Data_itr(uint8_t device_addr, uint8_t data){
   }
 }
 
+/**
+ * @brief   Writes a register of the addressed device, the register address
+ *          then the value. Function makes use of IRQs.
+ * @param   device_addr I2C device address to write data to
+ * @param   reg         Register address or write command
+ * @param   value       Value to write
+ * @return  none
+ */
+void I2C_Write_Reg_itr(uint8_t device_addr, uint8_t reg, uint8_t value){
+
+  reg_data[0] = reg;
+  reg_data[1] = value;
+
+  transferSequence.addr = device_addr << 1; // shift device address left
+  transferSequence.flags = I2C_FLAG_WRITE;
+  transferSequence.buf[0].data = reg_data; // pointer to data to write
+  transferSequence.buf[0].len = sizeof(reg_data);
+
+  // starting I2C Transfer by enabling IRQ and calling the I2C_TransferInit function
+  NVIC_EnableIRQ(I2C0_IRQn);
+  transferStatus = I2C_TransferInit(I2C0, &transferSequence);
+
+  if(transferStatus < 0 ){
+      LOG_ERROR("I2C_TransferInit() Register write error = %d", transferStatus);
+  }
+}
+
 /**
  * @brief   Received data over the I2C bus from the addressed device.
  *          Function makes use of IRQs.
@@ -25,6 +25,20 @@
 #define SI7021_POR_TIME_US 80000
 #define SI7021_14B_CONVERSION_TIME_US 10800
 #define SI7021_CMD_MEASURE_TEMP_NO_HOLD 0xF3
+#define SI7021_CMD_WRITE_USER_REG 0xE6
+
+// User register 1, RES1 (bit 7) and RES0 (bit 0) select the resolution,
+// the other bits keep their reset value
+#define SI7021_USER_REG_RESET 0x3A
+#define SI7021_USER_REG_T14 0x00  // RH 12 bits, T 14 bits
+#define SI7021_USER_REG_T13 0x80  // RH 10 bits, T 13 bits
+#define SI7021_USER_REG_T12 0x01  // RH 8 bits, T 12 bits
+#define SI7021_USER_REG_T11 0x81  // RH 11 bits, T 11 bits
+
+// Temperature conversion time by resolution, datasheet maximum
+#define SI7021_13B_CONVERSION_TIME_US 6200
+#define SI7021_12B_CONVERSION_TIME_US 3800
+#define SI7021_11B_CONVERSION_TIME_US 2400
 /**
  * @brief   Initialize the I2C peripheral to work with the Si7021 sensor
  * @return  none
@@ -46,6 +60,16 @@ uint32_t I2C_Si7021_Get_Temp();
  */
 void I2C_Write_Data_itr(uint8_t device_addr, uint8_t data);
 
+/**
+ * @brief   Writes a register of the addressed device, the register address
+ *          then the value. Function makes use of IRQs.
+ * @param   device_addr I2C device address to write data to
+ * @param   reg         Register address or write command
+ * @param   value       Value to write
+ * @return  none
+ */
+void I2C_Write_Reg_itr(uint8_t device_addr, uint8_t reg, uint8_t value);
+
 /**
  * @brief   Received data over the I2C bus from the addressed device.
  *          Function makes use of IRQs.
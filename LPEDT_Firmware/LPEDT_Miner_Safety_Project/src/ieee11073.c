@@ -0,0 +1,234 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    ieee11073.c
+ * @brief   Integer only codec for the IEEE-11073 20601 FLOAT and SFLOAT types
+ *
+ *          Both types are decimal, so every scaling is a multiply or divide
+ *          by a power of ten from a table. Nothing here needs floating point
+ *          or libm, the Cortex-M4 of the EFR32BG13 would run pow() and
+ *          double arithmetic in software.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include <stdbool.h>
+
+#include "ieee11073.h"
+
+// Include logging for this file
+#define INCLUDE_LOG_DEBUG 1
+#include "log.h"
+
+#define POW10_COUNT   (10)
+
+typedef struct {
+  uint32_t mantissaMask;
+  uint32_t signBit;
+  int32_t  mantissaMax;
+  int32_t  exponentMin;
+  int32_t  exponentMax;
+  uint32_t exponentShift;
+  uint32_t exponentMask;
+  uint32_t nan;
+  uint32_t nres;
+  uint32_t posInf;
+  uint32_t negInf;
+  uint32_t reserved;
+} ieee11073_format_t;
+
+static const uint32_t powersOfTen[POW10_COUNT] = {
+  1UL, 10UL, 100UL, 1000UL, 10000UL, 100000UL, 1000000UL,
+  10000000UL, 100000000UL, 1000000000UL
+};
+
+static const ieee11073_format_t floatFormat = {
+  0x00FFFFFFUL, 0x00800000UL, IEEE11073_FLOAT_MANTISSA_MAX,
+  IEEE11073_FLOAT_EXPONENT_MIN, IEEE11073_FLOAT_EXPONENT_MAX, 24, 0xFFUL,
+  IEEE11073_FLOAT_NAN, IEEE11073_FLOAT_NRES, IEEE11073_FLOAT_POS_INF,
+  IEEE11073_FLOAT_NEG_INF, IEEE11073_FLOAT_RESERVED
+};
+
+static const ieee11073_format_t sfloatFormat = {
+  0x0FFFUL, 0x0800UL, IEEE11073_SFLOAT_MANTISSA_MAX,
+  IEEE11073_SFLOAT_EXPONENT_MIN, IEEE11073_SFLOAT_EXPONENT_MAX, 12, 0x0FUL,
+  IEEE11073_SFLOAT_NAN, IEEE11073_SFLOAT_NRES, IEEE11073_SFLOAT_POS_INF,
+  IEEE11073_SFLOAT_NEG_INF, IEEE11073_SFLOAT_RESERVED
+};
+
+/**
+ * @brief   Divides by 10^digits, rounding half away from zero
+ * @param   u       magnitude
+ * @param   digits  digits to drop, 0 to POW10_COUNT - 1
+ * @return  rounded quotient
+ */
+static uint32_t drop_digits(uint32_t u, uint32_t digits) {
+  uint32_t p = powersOfTen[digits];
+  uint32_t q = u / p;
+
+  if((u - q * p) * 2 >= p)
+    q++;
+
+  return q;
+}
+
+/**
+ * @brief   Encodes mantissa * 10^exponent in the given format
+ * @param   fmt       FLOAT or SFLOAT
+ * @param   mantissa  value in units of 10^exponent
+ * @param   exponent  decimal exponent of the unit
+ * @return  bits of the format
+ */
+static uint32_t encode(const ieee11073_format_t *fmt, int32_t mantissa, int32_t exponent) {
+  bool     negative = (mantissa < 0);
+  uint32_t u = negative ? (0 - (uint32_t) mantissa) : (uint32_t) mantissa;
+  uint32_t q = u;
+  uint32_t k;
+
+  // As few digits dropped as it takes to fit the mantissa field, 2^31
+  // without 9 digits fits either field
+  for(k = 0; (q > (uint32_t) fmt->mantissaMax) && (k < POW10_COUNT - 1); )
+    q = drop_digits(u, ++k);
+
+  // Below the smallest exponent, the digits that do not reach it are lost
+  // too. Dropped from the original value, rounding twice could be off by one.
+  if(exponent + (int32_t) k < fmt->exponentMin){
+    k = (uint32_t) (fmt->exponentMin - exponent);
+    q = (k < POW10_COUNT) ? drop_digits(u, k) : 0;
+  }
+  exponent += (int32_t) k;
+
+  // Above the largest exponent, trailing zeros move into the mantissa while
+  // they fit
+  while((exponent > fmt->exponentMax) && (q != 0) && (q <= (uint32_t) fmt->mantissaMax / 10)){
+    q *= 10;
+    exponent--;
+  }
+  if(exponent > fmt->exponentMax){
+    if(q != 0)
+      return negative ? fmt->negInf : fmt->posInf;
+    exponent = fmt->exponentMax;
+  }
+
+  if(negative)
+    q = 0 - q;
+
+  return (q & fmt->mantissaMask) |
+         (((uint32_t) exponent & fmt->exponentMask) << fmt->exponentShift);
+}
+
+/**
+ * @brief   Decodes bits of the given format into units of 10^exponent
+ * @param   fmt       FLOAT or SFLOAT
+ * @param   raw       bits of the format
+ * @param   exponent  decimal exponent of the result unit
+ * @param   value     written with the result
+ * @return  IEEE11073_OK or the special value found
+ */
+static ieee11073_status_t decode(const ieee11073_format_t *fmt, uint32_t raw, int32_t exponent, int32_t *value) {
+  uint32_t field = raw & fmt->mantissaMask;
+  uint32_t expBits = (raw >> fmt->exponentShift) & fmt->exponentMask;
+  uint32_t expSign = (fmt->exponentMask + 1) >> 1;
+  int32_t  mantissa;
+  int32_t  shift;
+  int64_t  scaled;
+
+  *value = 0;
+  if(field == fmt->nan)
+    return IEEE11073_NAN;
+  if(field == fmt->nres)
+    return IEEE11073_NRES;
+  if(field == fmt->reserved)
+    return IEEE11073_RESERVED;
+  if(field == fmt->posInf){
+    *value = INT32_MAX;
+    return IEEE11073_POS_INF;
+  }
+  if(field == fmt->negInf){
+    *value = INT32_MIN;
+    return IEEE11073_NEG_INF;
+  }
+
+  // Sign extend both fields
+  mantissa = (int32_t) ((field ^ fmt->signBit) - fmt->signBit);
+  shift = (int32_t) ((expBits ^ expSign) - expSign) - exponent;
+
+  if(mantissa == 0)
+    return IEEE11073_OK;
+
+  if(shift < 0){
+    if(-shift < POW10_COUNT)
+      *value = mantissa / (int32_t) powersOfTen[-shift];
+    return IEEE11073_OK;
+  }
+
+  if(shift < POW10_COUNT){
+    scaled = (int64_t) mantissa * powersOfTen[shift];
+    if((scaled >= INT32_MIN) && (scaled <= INT32_MAX)){
+      *value = (int32_t) scaled;
+      return IEEE11073_OK;
+    }
+  }
+
+  *value = (mantissa < 0) ? INT32_MIN : INT32_MAX;
+  return IEEE11073_OVERFLOW;
+}
+
+/**
+ * @brief   Encodes mantissa * 10^exponent as a FLOAT
+ * @param   mantissa  value in units of 10^exponent
+ * @param   exponent  decimal exponent of the unit
+ * @return  FLOAT bits
+ */
+uint32_t ieee11073_float_encode(int32_t mantissa, int8_t exponent) {
+
+  return encode(&floatFormat, mantissa, exponent);
+
+} // ieee11073_float_encode()
+
+/**
+ * @brief   Encodes mantissa * 10^exponent as an SFLOAT
+ * @param   mantissa  value in units of 10^exponent
+ * @param   exponent  decimal exponent of the unit
+ * @return  SFLOAT bits
+ */
+uint16_t ieee11073_sfloat_encode(int32_t mantissa, int8_t exponent) {
+
+  return (uint16_t) encode(&sfloatFormat, mantissa, exponent);
+
+} // ieee11073_sfloat_encode()
+
+/**
+ * @brief   Decodes a FLOAT into an integer in units of 10^exponent
+ * @param   raw       FLOAT bits
+ * @param   exponent  decimal exponent of the result unit, 0 for whole units
+ * @param   value     written with the result
+ * @return  IEEE11073_OK or the special value found
+ */
+ieee11073_status_t ieee11073_float_decode(uint32_t raw, int8_t exponent, int32_t *value) {
+
+  return decode(&floatFormat, raw, exponent, value);
+
+} // ieee11073_float_decode()
+
+/**
+ * @brief   Decodes an SFLOAT into an integer in units of 10^exponent
+ * @param   raw       SFLOAT bits
+ * @param   exponent  decimal exponent of the result unit
+ * @param   value     written with the result
+ * @return  IEEE11073_OK or the special value found
+ */
+ieee11073_status_t ieee11073_sfloat_decode(uint16_t raw, int8_t exponent, int32_t *value) {
+
+  return decode(&sfloatFormat, raw, exponent, value);
+
+} // ieee11073_sfloat_decode()
@@ -0,0 +1,101 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    ieee11073.h
+ * @brief   Header file for ieee11073.c. Integer only codec for the IEEE-11073
+ *          20601 FLOAT and SFLOAT types used by the Health Thermometer
+ *
+ *          value = mantissa * 10^exponent, both two's complement:
+ *            FLOAT   32 bits, [31..24] exponent, [23..0] mantissa
+ *            SFLOAT  16 bits, [15..12] exponent, [11..0] mantissa
+ *
+ *          The mantissas next to the limits of the field are reserved for
+ *          the special values below, whatever the exponent.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#ifndef SRC_IEEE11073_H_
+#define SRC_IEEE11073_H_
+
+#include <stdint.h>
+
+// FLOAT special values and limits
+#define IEEE11073_FLOAT_NAN          (0x007FFFFFUL)
+#define IEEE11073_FLOAT_NRES         (0x00800000UL)
+#define IEEE11073_FLOAT_POS_INF      (0x007FFFFEUL)
+#define IEEE11073_FLOAT_NEG_INF      (0x00800002UL)
+#define IEEE11073_FLOAT_RESERVED     (0x00800001UL)
+#define IEEE11073_FLOAT_MANTISSA_MAX (0x007FFFFDL)   // 8388605
+#define IEEE11073_FLOAT_EXPONENT_MIN (-128)
+#define IEEE11073_FLOAT_EXPONENT_MAX (127)
+
+// SFLOAT special values and limits
+#define IEEE11073_SFLOAT_NAN         (0x07FF)
+#define IEEE11073_SFLOAT_NRES        (0x0800)
+#define IEEE11073_SFLOAT_POS_INF     (0x07FE)
+#define IEEE11073_SFLOAT_NEG_INF     (0x0802)
+#define IEEE11073_SFLOAT_RESERVED    (0x0801)
+#define IEEE11073_SFLOAT_MANTISSA_MAX (0x07FD)       // 2045
+#define IEEE11073_SFLOAT_EXPONENT_MIN (-8)
+#define IEEE11073_SFLOAT_EXPONENT_MAX (7)
+
+typedef enum {
+  IEEE11073_OK,
+  IEEE11073_NAN,
+  IEEE11073_NRES,              // not at this resolution
+  IEEE11073_POS_INF,
+  IEEE11073_NEG_INF,
+  IEEE11073_RESERVED,
+  IEEE11073_OVERFLOW,          // finite, but too large for an int32_t
+} ieee11073_status_t;
+
+/**
+ * @brief   Encodes mantissa * 10^exponent as a FLOAT. A mantissa too wide
+ *          for the field is rounded to fewer digits, half away from zero,
+ *          a value too large for the type becomes +INF or -INF.
+ * @param   mantissa  value in units of 10^exponent
+ * @param   exponent  decimal exponent of the unit
+ * @return  FLOAT bits
+ */
+uint32_t ieee11073_float_encode(int32_t mantissa, int8_t exponent);
+
+/**
+ * @brief   Encodes mantissa * 10^exponent as an SFLOAT, see
+ *          ieee11073_float_encode()
+ * @param   mantissa  value in units of 10^exponent
+ * @param   exponent  decimal exponent of the unit
+ * @return  SFLOAT bits
+ */
+uint16_t ieee11073_sfloat_encode(int32_t mantissa, int8_t exponent);
+
+/**
+ * @brief   Decodes a FLOAT into an integer in units of 10^exponent, digits
+ *          below the unit are dropped like a C cast does
+ * @param   raw       FLOAT bits
+ * @param   exponent  decimal exponent of the result unit, 0 for whole units
+ * @param   value     written with the result, 0 for NaN and NRes, the
+ *                    int32_t limit of the sign for INF and OVERFLOW
+ * @return  IEEE11073_OK or the special value found
+ */
+ieee11073_status_t ieee11073_float_decode(uint32_t raw, int8_t exponent, int32_t *value);
+
+/**
+ * @brief   Decodes an SFLOAT, see ieee11073_float_decode()
+ * @param   raw       SFLOAT bits
+ * @param   exponent  decimal exponent of the result unit
+ * @param   value     written with the result
+ * @return  IEEE11073_OK or the special value found
+ */
+ieee11073_status_t ieee11073_sfloat_decode(uint16_t raw, int8_t exponent, int32_t *value);
+
+#endif /* SRC_IEEE11073_H_ */
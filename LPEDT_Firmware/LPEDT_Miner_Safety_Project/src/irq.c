@@ -24,6 +24,10 @@
 #include "scheduler.h"
 #include "sl_i2cspm.h"
 #include "timers.h"
+#include "ble_device_type.h"
+#include "alarm.h"
+#include "battery.h"
+#include "ble.h"
 
 #define LETIMER0_COMP1_FLAG 0x2
 #define LETIMER0_UF_FLAG 0x4
@@ -103,9 +107,53 @@ void GPIO_EVEN_IRQHandler(void)
   GPIO_IntClear(flags);
 
   if(flags & (1<<PB0_FLAG_BIT_POS)){
+#if BUILD_INCLUDES_BLE_SERVER == 1
+      // PB0 is the SOS input, the buzzer starts before we leave the handler.
+      // While a passkey waits for its confirmation the press confirms it
+      // instead, that press and its release never reach the alarm.
+      static bool pb0_confirms_passkey = false;
+      bool pressed = Get_PB0_State();
+
+      if(pressed){
+          pb0_confirms_passkey = get_ble_data_ptr()->passkey_confirm_pending;
+      }
+      if(!pb0_confirms_passkey){
+          alarm_from_isr(BEACON_ALARM_SOS, pressed);
+      }
+      if(!pressed){
+          pb0_confirms_passkey = false;
+      }
+#endif
       schedulerSetEventPB0();
   }
+
+#if BUILD_INCLUDES_BLE_SERVER == 1
+  // VBAT_OK of the harvester changed, see battery.c
+  if(flags & (1<<BATTERY_OK_PIN)){
+      battery_from_isr();
+  }
+#endif
+}
+
+#if BUILD_INCLUDES_BLE_SERVER == 1
+/**
+ * @brief IRQ handler for ADC0, the window comparator saw a low battery
+ * @return  none
+ */
+void ADC0_IRQHandler(void)
+{
+  // Get IRQ source
+  uint32_t flags=0;
+  flags = ADC0->IF & ADC0->IEN;
+
+  // Clear interrupt flags
+  ADC0->IFC = flags;
+
+  if(flags & ADC_IF_SINGLECMP){
+      battery_low_from_isr();
+  }
 }
+#endif
 
 /**
  * @brief IRQ handler for GPIO odd-numbered pins
@@ -132,15 +180,15 @@ void GPIO_ODD_IRQHandler(void)
  * @return  Time since system was powered on in milliseconds
  */
 uint32_t letimerMilliseconds(){
-  // Calculate how long each tick is based on the clock frequency
-  // in micro-seconds
-  uint32_t LETIMER_Tick_Time_ms = 1000/CMU_ClockFreqGet(cmuClock_LETIMER0);
+  // A tick is shorter than 1ms on the LFXO, scale the ticks and not the tick
+  // time. The clock changes with the energy mode, see energy.c
+  uint32_t LETIMER_Freq = CMU_ClockFreqGet(cmuClock_LETIMER0);
 
   // Get the current number of ticks passed after LETIMER counter reload
   uint32_t ctr = LETIMER_CompareGet(LETIMER0,0)-LETIMER_CounterGet(LETIMER0);
 
   uint32_t rollover_time_ms = rollover_count*LETIMER_PERIOD_MS;
-  uint32_t curr_time_ms = LETIMER_Tick_Time_ms*ctr;
+  uint32_t curr_time_ms = (ctr*1000)/LETIMER_Freq;
   uint32_t return_time_ms = curr_time_ms + rollover_time_ms;
 
   return (return_time_ms);
@@ -0,0 +1,590 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    journal.c
+ * @brief   Store and forward journal of the samples no client took
+ *
+ *          A miner out of gateway range keeps producing samples. Each one
+ *          that telemetry could not deliver is appended here: records
+ *          collect in RAM and go to flash JOURNAL_RAM_RECORDS at a time as
+ *          whole words with MSC_WriteWord(). The flash region is a ring of
+ *          pages, written strictly in order, each page erased just before it
+ *          is reused, so the oldest records are the ones overwritten.
+ *
+ *          Nothing in flash is ever rewritten, which keeps it safe against
+ *          power loss. A page counts only once its sequence number is
+ *          written, after its header magic, and a record carries a CRC-8,
+ *          so an interrupted erase or write leaves a page or record that is
+ *          skipped, never one that is misread. A new boot starts a new page,
+ *          so every record of a page shares the boot number in its header.
+ *
+ *          When a client subscribes to Stream Data, the records after the
+ *          read cursor go out as batches over the reliable stream. The
+ *          cursor moves, and is saved in NVM3, only once the client has
+ *          acknowledged everything sent. A link lost in the middle of a sync
+ *          sends the unacknowledged records again on the next one.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include <string.h>
+
+#include "em_device.h"
+#include "em_msc.h"
+#include "sl_sleeptimer.h"
+#include "sl_bt_api.h"
+#include "btl_interface.h"
+#include "journal.h"
+#include "tscodec.h"
+#include "seal.h"
+#include "stream.h"
+#include "ble.h"
+#include "ble_device_type.h"
+
+// Include logging for this file
+#define INCLUDE_LOG_DEBUG 1
+#include "log.h"
+
+#if BUILD_INCLUDES_BLE_SERVER == 1
+
+#define PAGE_HEADER_SIZE     (8)
+#define RECORDS_PER_PAGE     ((FLASH_PAGE_SIZE - PAGE_HEADER_SIZE - SEAL_SIZE) / JOURNAL_RECORD_SIZE)
+#define BLANK_WORD           (0xFFFFFFFFUL)
+
+// A position is page sequence number * RECORDS_PER_PAGE + record index
+#define POS_SEQ(pos)         ((pos) / RECORDS_PER_PAGE)
+#define POS_INDEX(pos)       ((pos) % RECORDS_PER_PAGE)
+
+extern uint32_t __etext;
+extern uint32_t __data_start__;
+extern uint32_t __data_end__;
+
+static bool     enabled = false;
+
+// pages from tailSeq to headSeq hold records, headPhys is where headSeq is
+static bool     headValid = false;
+static bool     headOpen = false;   // records may be added to the head page
+static uint32_t headSeq = 0;
+static uint32_t headPhys = JOURNAL_PAGES - 1;
+static uint32_t headUsed = 0;
+static uint32_t tailSeq = 1;
+static uint16_t bootNumber = 0;
+
+// read cursor, acknowledged and sent
+static uint32_t ackPos = 0;
+static uint32_t sendPos = 0;
+static uint32_t lost = 0;
+
+static uint32_t ram[JOURNAL_RAM_RECORDS * 2];
+static uint32_t ramCount = 0;
+static uint32_t ramFirstMs = 0;
+
+static uint8_t  batch[MAX_BUFFER_LENGTH];
+static tscodec_block_t block;
+
+/**
+ * @brief   Returns the time since boot in ms
+ * @return  ms since boot
+ */
+static uint32_t journal_now_ms(void) {
+  uint64_t ms = 0;
+
+  sl_sleeptimer_tick64_to_ms(sl_sleeptimer_get_tick_count64(), &ms);
+
+  return (uint32_t) ms;
+}
+
+/**
+ * @brief   Returns the first word of a page
+ * @param   phys    page index in the region
+ * @return  page address
+ */
+static uint32_t *page_addr(uint32_t phys) {
+  return (uint32_t *) (JOURNAL_BASE + (phys * FLASH_PAGE_SIZE));
+}
+
+/**
+ * @brief   Returns the page index of a sequence number between tailSeq and
+ *          headSeq
+ * @param   seq     page sequence number
+ * @return  page index in the region
+ */
+static uint32_t seq_to_phys(uint32_t seq) {
+  return (headPhys + JOURNAL_PAGES - ((headSeq - seq) % JOURNAL_PAGES)) % JOURNAL_PAGES;
+}
+
+/**
+ * @brief   Returns whether a page header is complete and has this sequence
+ *          number
+ * @param   phys    page index in the region
+ * @param   seq     expected page sequence number
+ * @return  true if the page holds seq
+ */
+static bool page_holds(uint32_t phys, uint32_t seq) {
+  uint32_t *hdr = page_addr(phys);
+
+  return (((hdr[1] & 0xFFFF) == JOURNAL_PAGE_MAGIC) && (hdr[0] == seq));
+}
+
+/**
+ * @brief   CRC-8, polynomial 0x07, over the record bytes other than the CRC
+ * @param   w0      first record word, CRC byte ignored
+ * @param   w1      second record word
+ * @return  CRC-8
+ */
+static uint8_t record_crc(uint32_t w0, uint32_t w1) {
+  uint8_t  bytes[7];
+  uint8_t  crc = 0;
+  uint32_t i;
+  uint32_t b;
+
+  bytes[0] = (uint8_t) w0;
+  bytes[1] = (uint8_t) (w0 >> 16);
+  bytes[2] = (uint8_t) (w0 >> 24);
+  bytes[3] = (uint8_t) w1;
+  bytes[4] = (uint8_t) (w1 >> 8);
+  bytes[5] = (uint8_t) (w1 >> 16);
+  bytes[6] = (uint8_t) (w1 >> 24);
+
+  for(i = 0; i < sizeof(bytes); i++){
+    crc ^= bytes[i];
+    for(b = 0; b < 8; b++)
+      crc = (uint8_t) ((crc & 0x80) ? ((crc << 1) ^ 0x07) : (crc << 1));
+  }
+
+  return crc;
+}
+
+/**
+ * @brief   Returns the position after the last record written
+ * @return  position
+ */
+static uint32_t end_pos(void) {
+  if(headValid == false)
+    return tailSeq * RECORDS_PER_PAGE;
+
+  return (headSeq * RECORDS_PER_PAGE) + headUsed;
+}
+
+/**
+ * @brief   Counts the records no client has taken in a page about to be
+ *          erased
+ * @param   seq     page sequence number
+ * @param   phys    page index in the region
+ * @return  unsent records
+ */
+static uint32_t unsent_in_page(uint32_t seq, uint32_t phys) {
+  uint32_t *rec;
+  uint32_t  i;
+  uint32_t  n = 0;
+
+  if(POS_SEQ(ackPos) > seq)
+    return 0;
+
+  i = (POS_SEQ(ackPos) == seq) ? POS_INDEX(ackPos) : 0;
+  for(; i < RECORDS_PER_PAGE; i++){
+    rec = page_addr(phys) + ((PAGE_HEADER_SIZE + (i * JOURNAL_RECORD_SIZE)) / 4);
+    if((rec[0] != BLANK_WORD) || (rec[1] != BLANK_WORD))
+      n++;
+  }
+
+  return n;
+}
+
+/**
+ * @brief   Seals a page that no more records go to, unless it already is
+ * @param   phys    page index in the region
+ * @param   seq     page sequence number
+ * @param   used    records written to the page
+ * @return  none
+ */
+static void seal_page(uint32_t phys, uint32_t seq, uint32_t used) {
+  uint32_t *addr = page_addr(phys);
+  uint32_t *sealAddr = addr + ((FLASH_PAGE_SIZE - SEAL_SIZE) / 4);
+  uint32_t  seal[SEAL_SIZE / 4];
+  uint8_t   nonce[SEAL_NONCE_SIZE];
+  MSC_Status_TypeDef rc;
+
+  if((seal_ready() == false) || (sealAddr[(SEAL_SIZE / 4) - 1] != BLANK_WORD))
+    return;
+
+  seal_nonce(&nonce[0], seq, (uint16_t) (addr[1] >> 16), (uint16_t) used);
+  if(seal_compute(&nonce[0], (const uint8_t *) addr, PAGE_HEADER_SIZE + (used * JOURNAL_RECORD_SIZE),
+                  (uint8_t *) &seal[0]))
+    return;
+
+  // Tag and count first, the magic last makes the seal count
+  seal[SEAL_TAG_SIZE / 4] = used;
+  seal[(SEAL_TAG_SIZE / 4) + 1] = SEAL_MAGIC;
+  rc = MSC_WriteWord(sealAddr, &seal[0], SEAL_SIZE);
+  if(rc != mscReturnOk){
+      LOG_ERROR("MSC_WriteWord() returned != 0 status=0x%04x\r\n", (unsigned int) rc);
+  }
+}
+
+/**
+ * @brief   Erases the next page of the ring and makes it the head
+ * @return  false if successful, true if the flash could not be written
+ */
+static bool open_page(void) {
+  uint32_t  phys = (headPhys + 1) % JOURNAL_PAGES;
+  uint32_t  seq = headSeq + 1;
+  uint32_t *addr = page_addr(phys);
+  uint32_t  hdr[2];
+  MSC_Status_TypeDef rc;
+
+  // The page before is closed for good, from this boot or an earlier one
+  if(headValid == true)
+    seal_page(headPhys, headSeq, headUsed);
+
+  // The ring is full, the oldest page goes
+  if((headValid == true) && (seq - tailSeq >= JOURNAL_PAGES)){
+    lost += unsent_in_page(tailSeq, phys);
+    tailSeq++;
+    if(ackPos < tailSeq * RECORDS_PER_PAGE)
+      ackPos = tailSeq * RECORDS_PER_PAGE;
+    if(sendPos < ackPos)
+      sendPos = ackPos;
+  }
+
+  rc = MSC_ErasePage(addr);
+  if(rc != mscReturnOk){
+      LOG_ERROR("MSC_ErasePage() returned != 0 status=0x%04x\r\n", (unsigned int) rc);
+      return true;
+  }
+
+  // Magic first, the sequence number last makes the page count
+  hdr[0] = seq;
+  hdr[1] = JOURNAL_PAGE_MAGIC | ((uint32_t) bootNumber << 16);
+  rc = MSC_WriteWord(addr + 1, &hdr[1], 4);
+  if(rc == mscReturnOk)
+    rc = MSC_WriteWord(addr, &hdr[0], 4);
+  if(rc != mscReturnOk){
+      LOG_ERROR("MSC_WriteWord() returned != 0 status=0x%04x\r\n", (unsigned int) rc);
+      return true;
+  }
+
+  if(headValid == false)
+    tailSeq = seq;
+
+  headValid = true;
+  headOpen = true;
+  headSeq = seq;
+  headPhys = phys;
+  headUsed = 0;
+
+  return false;
+}
+
+/**
+ * @brief   Fills the batch buffer with records from sendPos
+ * @param   capacity    largest batch
+ * @return  batch length, 0 if nothing was read
+ */
+static uint32_t build_batch(uint32_t capacity) {
+  uint32_t  end = end_pos();
+  uint32_t  len = 0;
+  uint32_t  seq;
+  uint32_t  phys;
+  uint32_t *rec;
+
+  if(sendPos < tailSeq * RECORDS_PER_PAGE)
+    sendPos = tailSeq * RECORDS_PER_PAGE;
+
+  while((sendPos < end) && (len < capacity)){
+    seq = POS_SEQ(sendPos);
+    phys = seq_to_phys(seq);
+
+    // A page that never got its header, nothing to read in it
+    if(page_holds(phys, seq) == false){
+      sendPos = (seq + 1) * RECORDS_PER_PAGE;
+      break;
+    }
+
+    rec = page_addr(phys) + ((PAGE_HEADER_SIZE + (POS_INDEX(sendPos) * JOURNAL_RECORD_SIZE)) / 4);
+
+    // The rest of an older page was never written, a new boot came first
+    if((rec[0] == BLANK_WORD) && (rec[1] == BLANK_WORD)){
+      sendPos = (seq + 1) * RECORDS_PER_PAGE;
+      break;
+    }
+
+    // Half written, power was lost in the middle
+    if((uint8_t) (rec[0] >> 8) != record_crc(rec[0], rec[1])){
+      sendPos++;
+      continue;
+    }
+
+    if(len == 0){
+      batch[0] = (uint8_t) (page_addr(phys)[1] >> 16);
+      tscodec_begin(&block, &batch[1], capacity - 1, rec[1]);
+    }
+
+    if(tscodec_add(&block, ((uint8_t) rec[0]) | JOURNAL_SENSOR_FLAG, rec[1], (int16_t) (rec[0] >> 16)))
+      break;
+    len = 1 + block.length;
+    sendPos++;
+
+    // one page per batch, the next one may be from another boot
+    if(POS_INDEX(sendPos) == 0)
+      break;
+  }
+
+  return len;
+}
+
+/**
+ * @brief   Finds the newest page and the read cursor, call once at boot
+ * @return  none
+ */
+void journal_init(void) {
+  BootloaderStorageSlot_t slot;
+  uint32_t  imageEnd = (uint32_t) &__etext + ((uint32_t) &__data_end__ - (uint32_t) &__data_start__);
+  uint32_t  regionEnd = JOURNAL_BASE + (JOURNAL_PAGES * FLASH_PAGE_SIZE);
+  uint32_t *hdr;
+  uint32_t *rec;
+  uint32_t  phys;
+  uint32_t  k;
+  uint16_t  maxBoot = 0;
+  size_t    len = 0;
+  sl_status_t sc;
+
+  enabled = false;
+  if(JOURNAL_ENABLE == 0)
+    return;
+
+  if(imageEnd > JOURNAL_BASE){
+    LOG_ERROR("journal: application ends at 0x%08x, inside the journal\r\n", (unsigned int) imageEnd);
+    return;
+  }
+
+  if((bootloader_init() == BOOTLOADER_OK) &&
+     (bootloader_getStorageSlotInfo(0, &slot) == BOOTLOADER_OK) &&
+     (slot.address < regionEnd) && (slot.address + slot.length > JOURNAL_BASE)){
+    LOG_ERROR("journal: bootloader storage slot at 0x%08x overlaps the journal\r\n", (unsigned int) slot.address);
+    return;
+  }
+
+  MSC_Init();
+
+  // Pages are sealed once closed if this helmet has a key
+  seal_init();
+
+  // The newest page has the highest sequence number
+  headValid = false;
+  for(phys = 0; phys < JOURNAL_PAGES; phys++){
+    hdr = page_addr(phys);
+    if(((hdr[1] & 0xFFFF) != JOURNAL_PAGE_MAGIC) || (hdr[0] == BLANK_WORD))
+      continue;
+    if((headValid == false) || (hdr[0] > headSeq)){
+      headSeq = hdr[0];
+      headPhys = phys;
+      headValid = true;
+    }
+    if((uint16_t) (hdr[1] >> 16) > maxBoot)
+      maxBoot = (uint16_t) (hdr[1] >> 16);
+  }
+
+  if(headValid == true){
+    // Older pages follow the head backwards around the ring
+    tailSeq = headSeq;
+    for(k = 1; k < JOURNAL_PAGES; k++){
+      if(page_holds(seq_to_phys(headSeq - k), headSeq - k) == false)
+        break;
+      tailSeq = headSeq - k;
+    }
+
+    headUsed = 0;
+    while(headUsed < RECORDS_PER_PAGE){
+      rec = page_addr(headPhys) + ((PAGE_HEADER_SIZE + (headUsed * JOURNAL_RECORD_SIZE)) / 4);
+      if((rec[0] == BLANK_WORD) && (rec[1] == BLANK_WORD))
+        break;
+      headUsed++;
+    }
+  }
+
+  // Records of this boot go to a fresh page
+  headOpen = false;
+  bootNumber = maxBoot + 1;
+
+  sc = sl_bt_nvm_load(JOURNAL_CURSOR_KEY, sizeof(ackPos), &len, (uint8_t *) &ackPos);
+  if((sc != SL_STATUS_OK) || (len != sizeof(ackPos)) ||
+     (ackPos < tailSeq * RECORDS_PER_PAGE) || (ackPos > end_pos())){
+    ackPos = tailSeq * RECORDS_PER_PAGE;
+  }
+  sendPos = ackPos;
+  ramCount = 0;
+  lost = 0;
+  enabled = true;
+
+  LOG_INFO("journal: boot %u, pages %u to %u, %u records to send\r\n",
+           (unsigned int) bootNumber, (unsigned int) tailSeq, (unsigned int) headSeq,
+           (unsigned int) (end_pos() - ackPos));
+
+} // journal_init()
+
+/**
+ * @brief   Journals a sample that was not delivered live
+ * @param   sensor  source of the sample
+ * @param   value   sample value in the unit of the sensor
+ * @return  none
+ */
+void journal_append(telemetry_sensor_t sensor, int16_t value) {
+
+  journal_append_at(sensor, journal_now_ms(), value);
+
+} // journal_append()
+
+/**
+ * @brief   Journals a sample taken earlier, such as one of a telemetry batch
+ *          the client did not take
+ * @param   sensor  source of the sample
+ * @param   ms      when it was taken, ms since boot
+ * @param   value   sample value in the unit of the sensor
+ * @return  none
+ */
+void journal_append_at(telemetry_sensor_t sensor, uint32_t ms, int16_t value) {
+  uint32_t w0;
+
+  if(enabled == false)
+    return;
+
+  w0 = ((uint32_t) sensor & 0x7F) | ((uint32_t) (uint16_t) value << 16);
+  w0 |= (uint32_t) record_crc(w0, ms) << 8;
+
+  // The RAM age counts from when the record got here, not from when the
+  // sample was taken
+  if(ramCount == 0)
+    ramFirstMs = journal_now_ms();
+
+  ram[(ramCount * 2)] = w0;
+  ram[(ramCount * 2) + 1] = ms;
+  ramCount++;
+
+  if(ramCount == JOURNAL_RAM_RECORDS)
+    journal_flush();
+
+} // journal_append_at()
+
+/**
+ * @brief   Writes the records held in RAM to flash
+ * @return  none
+ */
+void journal_flush(void) {
+  uint32_t  done = 0;
+  uint32_t  n;
+  uint32_t *addr;
+  MSC_Status_TypeDef rc;
+
+  while((enabled == true) && (done < ramCount)){
+    if((headOpen == false) || (headUsed == RECORDS_PER_PAGE)){
+      if(open_page())
+        break;
+    }
+
+    n = RECORDS_PER_PAGE - headUsed;
+    if(n > ramCount - done)
+      n = ramCount - done;
+
+    addr = page_addr(headPhys) + ((PAGE_HEADER_SIZE + (headUsed * JOURNAL_RECORD_SIZE)) / 4);
+    rc = MSC_WriteWord(addr, &ram[done * 2], n * JOURNAL_RECORD_SIZE);
+    if(rc != mscReturnOk){
+        LOG_ERROR("MSC_WriteWord() returned != 0 status=0x%04x\r\n", (unsigned int) rc);
+        break;
+    }
+
+    headUsed += n;
+    done += n;
+  }
+
+  ramCount = 0;
+
+} // journal_flush()
+
+/**
+ * @brief   1 s tick, flushes records that waited JOURNAL_MAX_RAM_AGE_MS and
+ *          keeps a sync going
+ * @return  none
+ */
+void journal_tick(void) {
+
+  if((ramCount != 0) && (journal_now_ms() - ramFirstMs >= JOURNAL_MAX_RAM_AGE_MS))
+    journal_flush();
+
+  journal_pump();
+
+} // journal_tick()
+
+/**
+ * @brief   Sends journaled records while the stream has room and commits
+ *          the read cursor once the client acknowledged everything sent
+ * @return  none
+ */
+void journal_pump(void) {
+  sl_status_t sc;
+  uint32_t    len;
+  uint32_t    before;
+
+  if((enabled == false) || (stream_is_active() == false))
+    return;
+
+  if((stream_all_acked() == true) && (ackPos != sendPos)){
+    ackPos = sendPos;
+    sc = sl_bt_nvm_save(JOURNAL_CURSOR_KEY, sizeof(ackPos), (const uint8_t *) &ackPos);
+    if(sc != SL_STATUS_OK){
+        LOG_ERROR("sl_bt_nvm_save() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+    }
+  }
+
+  // Whatever waits in RAM goes out with the rest
+  if(ramCount != 0)
+    journal_flush();
+
+  while((sendPos < end_pos()) && (stream_free_slots() > 0)){
+    before = sendPos;
+    len = build_batch(get_ble_data_ptr()->attPayloadSize - STREAM_HEADER_SIZE);
+    if((len != 0) && stream_write(&batch[0], len)){
+      sendPos = before;
+      break;
+    }
+    if((len == 0) && (sendPos == before))
+      break;
+  }
+
+} // journal_pump()
+
+/**
+ * @brief   Rewinds to the last acknowledged record, call when the stream
+ *          restarts or the connection closes
+ * @return  none
+ */
+void journal_rewind(void) {
+
+  sendPos = ackPos;
+
+} // journal_rewind()
+
+/**
+ * @brief   Returns the journal counters
+ * @param   out     filled in
+ * @return  none
+ */
+void journal_get_stats(journal_stats_t *out) {
+
+  out->positions = end_pos() - (tailSeq * RECORDS_PER_PAGE);
+  out->unsent = end_pos() - ackPos;
+  out->lost = lost;
+  out->bootNumber = bootNumber;
+
+} // journal_get_stats()
+
+#endif
@@ -0,0 +1,130 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    journal.h
+ * @brief   Header file for journal.c. Store and forward journal of the
+ *          samples no client took, kept in a reserved region of the internal
+ *          flash and sent over the reliable stream when a client subscribes
+ *
+ *          Flash layout, JOURNAL_PAGES pages used as a ring:
+ *            page header, 2 words:
+ *              [u32 page sequence number]
+ *              [u16 JOURNAL_PAGE_MAGIC][u16 boot number]
+ *            then records of 2 words each, until the page is full:
+ *              [u8 sensor][u8 CRC-8 of the other 7 bytes][i16 value]
+ *              [u32 ms since boot]
+ *            and SEAL_SIZE bytes at the end for the seal of the page once
+ *            it is closed, see seal.h
+ *
+ *          Sync batches on Stream Data use the Bulk Telemetry layout, with
+ *          JOURNAL_SENSOR_FLAG set in every sensor ID and the low byte of
+ *          the boot number in place of the batch sequence number.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#ifndef SRC_JOURNAL_H_
+#define SRC_JOURNAL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "telemetry.h"
+
+// 1 -> samples no client takes are journaled in flash
+#define JOURNAL_ENABLE               1
+
+// Reserved flash region, between the end of the application and the
+// bootloader storage slot. journal_init() turns the journal off if either
+// one reaches into it.
+#define JOURNAL_BASE                 (0x0003C000UL)
+#define JOURNAL_PAGES                (16)
+
+#define JOURNAL_PAGE_MAGIC           (0x4A4D)   // "MJ"
+#define JOURNAL_RECORD_SIZE          (8)
+
+// Records kept in RAM before a flash write, and the longest a record waits
+// there. Up to this many samples are lost on a power failure.
+#define JOURNAL_RAM_RECORDS          (16)
+#define JOURNAL_MAX_RAM_AGE_MS       (60000)
+
+// NVM3 key of the read cursor, after the discovery cache keys
+#define JOURNAL_CURSOR_KEY           (0x4010)
+
+#define JOURNAL_SENSOR_FLAG          (0x20)
+
+typedef struct {
+  uint32_t positions;        // record positions in flash, sent or not,
+                             // including the unused end of a page left by a reboot
+  uint32_t unsent;           // positions after the read cursor
+  uint32_t lost;             // unsent records overwritten since boot
+  uint32_t bootNumber;
+} journal_stats_t;
+
+/**
+ * @brief   Finds the newest page and the read cursor, call once at boot
+ * @return  none
+ */
+void journal_init(void);
+
+/**
+ * @brief   Journals a sample that was not delivered live
+ * @param   sensor  source of the sample
+ * @param   value   sample value in the unit of the sensor
+ * @return  none
+ */
+void journal_append(telemetry_sensor_t sensor, int16_t value);
+
+/**
+ * @brief   Journals a sample taken earlier, such as one of a telemetry batch
+ *          the client did not take
+ * @param   sensor  source of the sample
+ * @param   ms      when it was taken, ms since boot
+ * @param   value   sample value in the unit of the sensor
+ * @return  none
+ */
+void journal_append_at(telemetry_sensor_t sensor, uint32_t ms, int16_t value);
+
+/**
+ * @brief   Writes the records held in RAM to flash
+ * @return  none
+ */
+void journal_flush(void);
+
+/**
+ * @brief   1 s tick, flushes records that waited JOURNAL_MAX_RAM_AGE_MS and
+ *          keeps a sync going
+ * @return  none
+ */
+void journal_tick(void);
+
+/**
+ * @brief   Sends journaled records while the stream has room and commits
+ *          the read cursor once the client acknowledged everything sent
+ * @return  none
+ */
+void journal_pump(void);
+
+/**
+ * @brief   Rewinds to the last acknowledged record, call when the stream
+ *          restarts or the connection closes
+ * @return  none
+ */
+void journal_rewind(void);
+
+/**
+ * @brief   Returns the journal counters
+ * @param   out     filled in
+ * @return  none
+ */
+void journal_get_stats(journal_stats_t *out);
+
+#endif /* SRC_JOURNAL_H_ */
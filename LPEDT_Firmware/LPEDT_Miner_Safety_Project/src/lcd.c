@@ -61,10 +61,17 @@
 
 #include "ble_device_type.h"
 #include "gpio.h"
+#include "timers.h"
+#include "oscillators.h"
+#include "app.h"
 
 #include "glib.h" // the low-level graphics driver/library
 #include "dmd.h"  // the dot matrix display driver
 
+#include "sl_memlcd.h"
+#include "sl_memlcd_display.h"
+#include "sl_sleeptimer.h"
+
 
 #include "lcd.h"
 
@@ -77,6 +84,33 @@
 
 
 
+#define LCD_BYTES_PER_LINE   ((SL_MEMLCD_DISPLAY_WIDTH * SL_MEMLCD_DISPLAY_BPP) / 8)
+
+// RAM taken by the framebuffer renderer: dmd_memlcd.c framebuffer + dirty
+// row bitmap, plus the GLIB context we keep below
+#define LCD_FRAMEBUFFER_RAM  ((LCD_BYTES_PER_LINE * SL_MEMLCD_DISPLAY_HEIGHT) + \
+                              (SL_MEMLCD_DISPLAY_HEIGHT / 8) + sizeof(GLIB_Context_t))
+
+#if LCD_RENDERER_ROWSTREAM == 1
+// A band is the group of pixel lines covered by one text row, font height
+// plus line spacing. It is rendered and pushed with one SPI transaction.
+#define LCD_FONT             (GLIB_FontNarrow6x8)
+#define LCD_BAND_LINES       (8 + 2) // fontHeight + lineSpacing of LCD_FONT
+#define LCD_NUMBER_OF_BANDS  ((SL_MEMLCD_DISPLAY_HEIGHT + LCD_BAND_LINES - 1) / LCD_BAND_LINES)
+#endif
+
+/**
+ * An icon entry of the display list
+ */
+struct display_icon {
+  const uint8_t           *bitmap; // NULL when the slot is unused
+  uint8_t                  x;
+  uint8_t                  y;
+  uint8_t                  width;
+  uint8_t                  height;
+};
+
+
 /**
  * A global structure containing information about the data we want to
  * display on a given LCD display
@@ -88,8 +122,34 @@ struct display_data {
   // tracks the state of the extcomin pin for toggling purposes
 	bool                     last_extcomin_state_high;
 
+	// icons currently shown, needed by both renderers to redraw/erase them
+	struct display_icon      icons[DISPLAY_NUMBER_OF_ICONS];
+
+#if LCD_RENDERER_ROWSTREAM == 1
+	// The display list, what is on the screen rather than the screen pixels
+	char                     rowText[DISPLAY_NUMBER_OF_ROWS][DISPLAY_ROW_LEN+1];
+
+	// one bit per band that has to be re-generated and sent to the LCD
+	uint32_t                 dirtyBands;
+
+	// pixel lines of the band being pushed to the LCD
+	uint8_t                  bandBuffer[LCD_BAND_LINES * LCD_BYTES_PER_LINE];
+
+	const sl_memlcd_t        *memlcd;
+#else
 	// GLIB_Context required for use with GLIB_ functions
 	GLIB_Context_t           glibContext;
+#endif
+
+	// sleeptimer ticks taken by the last and the slowest display refresh
+	uint32_t                 refreshTicksLast;
+	uint32_t                 refreshTicksMax;
+
+	// shortest time between two refreshes set by the governor, 0 = at once,
+	// changes in between are held back until displayFlush()
+	uint32_t                 refreshPeriodTicks;
+	uint32_t                 lastRefreshTick;
+	bool                     refreshPending;
 
 };
 
@@ -108,6 +168,151 @@ static struct display_data         *displayGetData() {
 }
 
 
+// private function to record how long a display refresh took
+static void displayRefreshDone(struct display_data *display, uint32_t startTick)
+{
+  display->refreshTicksLast = sl_sleeptimer_get_tick_count() - startTick;
+  if (display->refreshTicksLast > display->refreshTicksMax) {
+      display->refreshTicksMax = display->refreshTicksLast;
+  }
+
+#if LCD_REFRESH_BENCHMARK == 1
+  LOG_INFO("LCD refresh took %uus (max %uus)",
+           (unsigned int) ((display->refreshTicksLast * 1000000ULL) / sl_sleeptimer_get_timer_frequency()),
+           (unsigned int) ((display->refreshTicksMax * 1000000ULL) / sl_sleeptimer_get_timer_frequency()));
+#endif
+}
+
+
+// private function deciding whether a refresh waits for displayFlush()
+static bool displayRefreshDeferred(struct display_data *display)
+{
+  uint32_t now = sl_sleeptimer_get_tick_count();
+
+  if ((display->refreshPeriodTicks != 0) &&
+      ((now - display->lastRefreshTick) < display->refreshPeriodTicks)) {
+      display->refreshPending = true;
+      return true;
+  }
+
+  display->refreshPending  = false;
+  display->lastRefreshTick = now;
+  return false;
+}
+
+
+#if LCD_RENDERER_ROWSTREAM == 1
+
+// private function to mark the bands covered by pixel rows y to y+height-1
+static void displayMarkDirty(struct display_data *display, uint32_t y, uint32_t height)
+{
+  uint32_t band;
+
+  for (band = y / LCD_BAND_LINES; (band * LCD_BAND_LINES) < (y + height); band++) {
+      display->dirtyBands |= (1UL << band);
+  }
+}
+
+
+// private function to generate the pixels of pixel line y into line
+static void displayRenderLine(struct display_data *display, uint32_t y, uint8_t *line)
+{
+  const uint8_t        *pixMap = (const uint8_t *) LCD_FONT.pFontPixMap;
+  uint32_t              row    = y / LCD_BAND_LINES;
+  uint32_t              fontY  = y % LCD_BAND_LINES;
+  uint32_t              x, i, px;
+  uint8_t               bits;
+
+  // start from an all white line, 1 = white on the memory LCD
+  memset(line, 0xFF, LCD_BYTES_PER_LINE);
+
+  // text, centred the same way GLIB_drawStringOnLine() does it
+  if ((row < DISPLAY_NUMBER_OF_ROWS) && (fontY < LCD_FONT.fontHeight)) {
+      const char *text = display->rowText[row];
+      size_t      len  = strlen(text);
+
+      x = (SL_MEMLCD_DISPLAY_WIDTH - (len * LCD_FONT.fontWidth)) / 2;
+      for (i = 0; i < len; i++) {
+          if ((text[i] < ' ') || (text[i] > '~')) {
+              x += LCD_FONT.fontWidth;
+              continue;
+          }
+          bits = pixMap[(text[i] - ' ') + (fontY * LCD_FONT.fontRowOffset)];
+          for (px = 0; px < LCD_FONT.fontWidth; px++, x++) {
+              if (bits & 0x1) {
+                  line[x >> 3] &= ~(1 << (x & 0x7));
+              }
+              bits >>= 1;
+          }
+      }
+  }
+
+  // icons are drawn on top of the text
+  for (i = 0; i < DISPLAY_NUMBER_OF_ICONS; i++) {
+      const struct display_icon *icon = &display->icons[i];
+      uint32_t                   bit;
+
+      if ((icon->bitmap == NULL) || (y < icon->y) || (y >= (uint32_t) (icon->y + icon->height))) {
+          continue;
+      }
+
+      bit = (y - icon->y) * icon->width;
+      for (px = 0, x = icon->x; (px < icon->width) && (x < SL_MEMLCD_DISPLAY_WIDTH); px++, x++, bit++) {
+          if ((icon->bitmap[bit >> 3] >> (bit & 0x7)) & 0x1) {
+              line[x >> 3] |= 1 << (x & 0x7);
+          } else {
+              line[x >> 3] &= ~(1 << (x & 0x7));
+          }
+      }
+  }
+}
+
+
+// private function to regenerate every dirty band and push it to the LCD
+static void displayRefresh(struct display_data *display)
+{
+  sl_status_t   status;
+  uint32_t      startTick = sl_sleeptimer_get_tick_count();
+  uint32_t      band, line, y, lines;
+
+  if (display->memlcd == NULL) {
+      return;
+  }
+
+  // the display list keeps the dirty bands until the next refresh
+  if (displayRefreshDeferred(display)) {
+      return;
+  }
+
+  for (band = 0; band < LCD_NUMBER_OF_BANDS; band++) {
+      if ((display->dirtyBands & (1UL << band)) == 0) {
+          continue;
+      }
+
+      y     = band * LCD_BAND_LINES;
+      lines = SL_MEMLCD_DISPLAY_HEIGHT - y;
+      if (lines > LCD_BAND_LINES) {
+          lines = LCD_BAND_LINES;
+      }
+
+      for (line = 0; line < lines; line++) {
+          displayRenderLine(display, y + line, &display->bandBuffer[line * LCD_BYTES_PER_LINE]);
+      }
+
+      status = sl_memlcd_draw(display->memlcd, display->bandBuffer, y, lines);
+      if (status != SL_STATUS_OK) {
+          LOG_ERROR("sl_memlcd_draw() returned non-zero error code=0x%04x", (unsigned int) status);
+      }
+  }
+
+  display->dirtyBands = 0;
+
+  displayRefreshDone(display, startTick);
+}
+
+#endif
+
+
 
 // ****************************************************************
 // The following routines are the public functions
@@ -140,11 +345,9 @@ void displayPrintf(enum display_row row, const char *format, ...)
                           // of handling variable number of arguments passed to
                           // a function.
 
-   EMSTATUS               status;
    struct display_data    *display = displayGetData();
    size_t                 strLen;
    char                   strToDisplay[DISPLAY_ROW_LEN+1]; // +1 for null terminator
-   char                   strToErase[DISPLAY_ROW_LEN+1];   // +1 for null terminator
 
    // Range check the row number
    if (row >= DISPLAY_NUMBER_OF_ROWS) {
@@ -189,6 +392,16 @@ void displayPrintf(enum display_row row, const char *format, ...)
    } // else
 
 
+#if LCD_RENDERER_ROWSTREAM == 1
+   // Only record the text, the pixels are generated while pushing the band
+   strcpy(display->rowText[row], strToDisplay);
+   displayMarkDirty(display, row * LCD_BAND_LINES, LCD_BAND_LINES);
+   displayRefresh(display);
+#else
+   EMSTATUS               status;
+   char                   strToErase[DISPLAY_ROW_LEN+1];   // +1 for null terminator
+   uint32_t               startTick = sl_sleeptimer_get_tick_count();
+
    // We always erase the whole line first, then draw the new string. This way
    // we don't leave any pixels set from the previous characters.
    for (int i=0; i<DISPLAY_ROW_LEN; i++) {
@@ -222,12 +435,18 @@ void displayPrintf(enum display_row row, const char *format, ...)
    }
 
 
-   // Update the data the LCD is displaying
-   status = DMD_updateDisplay();
-   if (status != DMD_OK) {
-       LOG_ERROR("DMD_updateDisplay() returned non-zero error code=0x%04x", (unsigned int) status);
+   // Update the data the LCD is displaying, the framebuffer keeps its dirty
+   // rows if the refresh is held back
+   if (!displayRefreshDeferred(display)) {
+       status = DMD_updateDisplay();
+       if (status != DMD_OK) {
+           LOG_ERROR("DMD_updateDisplay() returned non-zero error code=0x%04x", (unsigned int) status);
+       }
    }
 
+   displayRefreshDone(display, startTick);
+#endif
+
 } // displayPrintf()
 
 
@@ -240,7 +459,9 @@ void displayPrintf(enum display_row row, const char *format, ...)
 void displayInit()
 {
 
+#if LCD_RENDERER_ROWSTREAM == 0
     EMSTATUS    status;
+#endif
     struct      display_data   *display = displayGetData();
 
 
@@ -262,6 +483,19 @@ void displayInit()
     si7021TurnOn(); // Calling the function to turn on the power to Si7021 and the LCD display
 
 
+#if LCD_RENDERER_ROWSTREAM == 1
+    // Only the memory LCD driver is needed, sl_memlcd_init() also clears the
+    // screen so the empty display list matches what is shown
+    sl_status_t memlcd_status = sl_memlcd_init();
+    if (memlcd_status != SL_STATUS_OK) {
+        LOG_ERROR("sl_memlcd_init() returned non-zero error code=0x%04x", (unsigned int) memlcd_status);
+    }
+    display->memlcd = sl_memlcd_get();
+
+    LOG_INFO("LCD display list renderer uses %u bytes of RAM, %u bytes saved vs framebuffer",
+             (unsigned int) sizeof(struct display_data),
+             (unsigned int) (LCD_FRAMEBUFFER_RAM - sizeof(struct display_data)));
+#else
     // Init the dot matrix display data structure
     display->dmdInitConfig = 0;
     //status = DMD_init(&display->dmdInitConfig);
@@ -299,8 +533,17 @@ void displayInit()
     if (status != DMD_OK) {
         LOG_ERROR("DMD_updateDisplay() returned non-zero error code=0x%04x", (unsigned int) status);
     }
+#endif
 
 
+#if LCD_EXTCOMIN_HW == 1
+    // The Sharp LCD inverts VCOM on every rising edge of EXTCOMIN. Let the
+    // CRYOTIMER generate a 1Hz pulse and route it straight to the pin through
+    // the PRS, this keeps the CPU asleep instead of waking it every second.
+    // The ULFRCO keeps it going in EM3, the LFXO does not.
+    CRYOTIMER_Enable(EM3);
+    gpioDisplayExtcominPrsEnable(true);
+#else
 	  // The BT stack implements timers that we can setup and then have the stack pass back
 	  // events when the timer expires.
 	  // This assignment has us using the Sharp LCD which needs to be serviced approx
@@ -322,8 +565,7 @@ void displayInit()
 	  if (timer_response != SL_STATUS_OK) {
 	      LOG_ERROR("sl_bt_system_set_soft_timer() returned non-zero error code=0x%04x", (unsigned int) timer_response);
      }
-
-
+#endif
 
 } // displayInit()
 
@@ -333,6 +575,7 @@ void displayInit()
 /**
  * Call this function from your event handler in response to sl_bt_evt_system_soft_timer_id
  * events to prevent charge buildup within the Liquid Crystal Cells.
+ * Only needed when LCD_EXTCOMIN_HW is 0, otherwise the pin is driven by the PRS.
  * See details in https://www.silabs.com/documents/public/application-notes/AN0048.pdf
  */
 void displayUpdate()
@@ -352,5 +595,145 @@ void displayUpdate()
 } // displayUpdate()
 
 
+/**
+ * Draws a monochrome bitmap in one of the icon slots, replacing whatever that
+ * slot was showing. The bitmap uses the GLIB_drawBitmap() format and must stay
+ * valid while it is shown, only the pointer is kept.
+ */
+void displayIcon(uint8_t slot, uint8_t x, uint8_t y, uint8_t width,
+                 uint8_t height, const uint8_t *bitmap)
+{
+  struct display_data *display = displayGetData();
+
+  if (slot >= DISPLAY_NUMBER_OF_ICONS) {
+      LOG_ERROR("icon slot %d is greater than max slot index %d", (int) slot, (int) DISPLAY_NUMBER_OF_ICONS-1);
+      return;
+  }
+
+  if ((bitmap == NULL) || ((x + width) > SL_MEMLCD_DISPLAY_WIDTH) || ((y + height) > SL_MEMLCD_DISPLAY_HEIGHT)) {
+      LOG_ERROR("icon %d does not fit on the display", (int) slot);
+      return;
+  }
+
+  // get rid of whatever the slot was showing first
+  displayIconClear(slot);
+
+  display->icons[slot].bitmap = bitmap;
+  display->icons[slot].x      = x;
+  display->icons[slot].y      = y;
+  display->icons[slot].width  = width;
+  display->icons[slot].height = height;
+
+#if LCD_RENDERER_ROWSTREAM == 1
+  displayMarkDirty(display, y, height);
+  displayRefresh(display);
+#else
+  EMSTATUS status;
+  uint32_t startTick = sl_sleeptimer_get_tick_count();
 
+  status = GLIB_drawBitmap(&display->glibContext, x, y, width, height, bitmap);
+  if (status != GLIB_OK) {
+      LOG_ERROR("GLIB_drawBitmap() returned non-zero error code=0x%04x", (unsigned int) status);
+  }
 
+  if (!displayRefreshDeferred(display)) {
+      status = DMD_updateDisplay();
+      if (status != DMD_OK) {
+          LOG_ERROR("DMD_updateDisplay() returned non-zero error code=0x%04x", (unsigned int) status);
+      }
+  }
+
+  displayRefreshDone(display, startTick);
+#endif
+
+} // displayIcon()
+
+
+/**
+ * Removes the icon shown in the given slot.
+ */
+void displayIconClear(uint8_t slot)
+{
+  struct display_data *display = displayGetData();
+  struct display_icon *icon;
+
+  if (slot >= DISPLAY_NUMBER_OF_ICONS) {
+      LOG_ERROR("icon slot %d is greater than max slot index %d", (int) slot, (int) DISPLAY_NUMBER_OF_ICONS-1);
+      return;
+  }
+
+  icon = &display->icons[slot];
+  if (icon->bitmap == NULL) {
+      return;
+  }
+  icon->bitmap = NULL;
+
+#if LCD_RENDERER_ROWSTREAM == 1
+  // the text underneath is still in the display list, re-generating the
+  // bands brings it back
+  displayMarkDirty(display, icon->y, icon->height);
+  displayRefresh(display);
+#else
+  EMSTATUS         status;
+  GLIB_Rectangle_t area = { icon->x, icon->y,
+                            icon->x + icon->width - 1, icon->y + icon->height - 1 };
+
+  display->glibContext.foregroundColor = White;
+  status = GLIB_drawRectFilled(&display->glibContext, &area);
+  display->glibContext.foregroundColor = Black;
+  if (status != GLIB_OK) {
+      LOG_ERROR("GLIB_drawRectFilled() returned non-zero error code=0x%04x", (unsigned int) status);
+  }
+
+  if (!displayRefreshDeferred(display)) {
+      status = DMD_updateDisplay();
+      if (status != DMD_OK) {
+          LOG_ERROR("DMD_updateDisplay() returned non-zero error code=0x%04x", (unsigned int) status);
+      }
+  }
+#endif
+
+} // displayIconClear()
+
+
+/**
+ * Sets the shortest time between two refreshes of the LCD. Changes made
+ * sooner are kept in the display list (or the framebuffer) and pushed by
+ * displayFlush(). 0 refreshes at once, as before.
+ */
+void displaySetRefreshPeriod(uint32_t period_ms)
+{
+  struct display_data *display = displayGetData();
+
+  display->refreshPeriodTicks = sl_sleeptimer_ms_to_tick(period_ms);
+  displayFlush();
+
+} // displaySetRefreshPeriod()
+
+
+/**
+ * Pushes the changes held back by the refresh period once it is over. Call
+ * it periodically, the LETIMER0 underflow does.
+ */
+void displayFlush()
+{
+  struct display_data *display = displayGetData();
+
+  if (!display->refreshPending) {
+      return;
+  }
+
+#if LCD_RENDERER_ROWSTREAM == 1
+  displayRefresh(display);
+#else
+  EMSTATUS status;
+
+  if (!displayRefreshDeferred(display)) {
+      status = DMD_updateDisplay();
+      if (status != DMD_OK) {
+          LOG_ERROR("DMD_updateDisplay() returned non-zero error code=0x%04x", (unsigned int) status);
+      }
+  }
+#endif
+
+} // displayFlush()
@@ -37,6 +37,7 @@
 #ifndef SRC_LCD_H_
 #define SRC_LCD_H_
 
+#include <stdint.h>
 
 
 /**
@@ -63,6 +64,28 @@ enum display_row {
 // The number of characters per row
 #define DISPLAY_ROW_LEN      20
 
+// EXTCOMIN source selection
+// 1 -> CRYOTIMER period pulse routed to the EXTCOMIN pin through PRS, no CPU
+//      involvement once displayInit() has run
+// 0 -> BT stack soft timer (SOFT_TIMER_0) calling displayUpdate() every second
+#define LCD_EXTCOMIN_HW      1
+
+// Renderer selection
+// 1 -> display list: displayPrintf()/displayIcon() only record what is on the
+//      screen, pixel rows are generated one text band at a time while they are
+//      pushed over SPI. The 2KB DMD framebuffer is never referenced and is
+//      dropped by the linker.
+// 0 -> GLIB drawing into the DMD framebuffer, then DMD_updateDisplay()
+#define LCD_RENDERER_ROWSTREAM   1
+
+// Set to 1 to LOG_INFO() the time taken by every display refresh, used to
+// compare the two renderers above. The lines and SPI bytes of each kind of
+// update are printed on the host by "make bench" in test/.
+#define LCD_REFRESH_BENCHMARK    0
+
+// Number of icon slots kept in the display list
+#define DISPLAY_NUMBER_OF_ICONS  4
+
 
 
 // function prototypes
@@ -71,6 +94,44 @@ void displayInit();
 void displayUpdate();
 void displayPrintf(enum display_row row, const char *format, ...);
 
+/**
+ * @brief   Draws a monochrome bitmap in one of the icon slots, replacing
+ *          whatever that slot was showing
+ * @param   slot    icon slot, 0 to DISPLAY_NUMBER_OF_ICONS-1
+ * @param   x       left pixel column
+ * @param   y       top pixel row
+ * @param   width   bitmap width in pixels
+ * @param   height  bitmap height in pixels
+ * @param   bitmap  pixels packed LSB first, row after row, 1 = white (same
+ *                  format as GLIB_drawBitmap()). Must stay valid while shown,
+ *                  the display list only keeps the pointer.
+ * @return  none
+ */
+void displayIcon(uint8_t slot, uint8_t x, uint8_t y, uint8_t width,
+                 uint8_t height, const uint8_t *bitmap);
+
+/**
+ * @brief   Removes the icon shown in the given slot
+ * @param   slot    icon slot, 0 to DISPLAY_NUMBER_OF_ICONS-1
+ * @return  none
+ */
+void displayIconClear(uint8_t slot);
+
+/**
+ * @brief   Sets the shortest time between two refreshes of the LCD, changes
+ *          made sooner are pushed by displayFlush()
+ * @param   period_ms   0 refreshes at once
+ * @return  none
+ */
+void displaySetRefreshPeriod(uint32_t period_ms);
+
+/**
+ * @brief   Pushes the changes held back by the refresh period once it is
+ *          over, call periodically
+ * @return  none
+ */
+void displayFlush();
+
 
 
 
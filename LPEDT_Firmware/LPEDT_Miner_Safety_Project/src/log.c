@@ -49,6 +49,39 @@ uint32_t loggerGetTimestamp()
 
 
 
+static uint32_t verbosityLevel = LOG_LEVEL_INFO;
+
+/**
+ * @return the verbosity in force, LOG_LEVEL_ERROR to LOG_LEVEL_INFO
+ */
+uint32_t loggerGetVerbosity()
+{
+
+     return verbosityLevel;
+
+} // loggerGetVerbosity
+
+
+
+/**
+ * Sets the verbosity, messages above it are dropped before they are
+ * formatted. Errors are always printed.
+ */
+void loggerSetVerbosity(uint32_t verbosity)
+{
+
+     if (verbosity < LOG_LEVEL_ERROR) {
+         verbosity = LOG_LEVEL_ERROR;
+     }
+     if (verbosity > LOG_LEVEL_INFO) {
+         verbosity = LOG_LEVEL_INFO;
+     }
+     verbosityLevel = verbosity;
+
+} // loggerSetVerbosity
+
+
+
 /**
  * Print a string for the Silicon Labs API error codes defined in sl_status.h
  * Depends on Components:
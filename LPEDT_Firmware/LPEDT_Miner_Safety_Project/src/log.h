@@ -31,19 +31,25 @@
 #include "sl_status.h" // for sl_status_print()
 
 
+// Verbosity set at run time, a message is printed when its level is at or
+// below it. The governor lowers it to save the VCOM traffic.
+#define LOG_LEVEL_ERROR  (1)
+#define LOG_LEVEL_WARN   (2)
+#define LOG_LEVEL_INFO   (3)
+
 #ifndef LOG_ERROR
 #define LOG_ERROR(message,...) \
-	LOG_DO(message,"Error", ##__VA_ARGS__)
+	LOG_DO(message,"Error",LOG_LEVEL_ERROR, ##__VA_ARGS__)
 #endif
 
 #ifndef LOG_WARN
 #define LOG_WARN(message,...) \
-	LOG_DO(message,"Warn ", ##__VA_ARGS__)
+	LOG_DO(message,"Warn ",LOG_LEVEL_WARN, ##__VA_ARGS__)
 #endif
 
 #ifndef LOG_INFO
 #define LOG_INFO(message,...) \
-	LOG_DO(message,"Info ", ##__VA_ARGS__)
+	LOG_DO(message,"Info ",LOG_LEVEL_INFO, ##__VA_ARGS__)
 #endif
 
 
@@ -51,17 +57,22 @@
 // File by file logging control
 #if INCLUDE_LOG_DEBUG
 
-#define LOG_DO(message,level, ...) \
-  app_log( "%5"PRIu32":%s:%s: " message "\n", loggerGetTimestamp(), level, __func__, ##__VA_ARGS__ )
+#define LOG_DO(message,level,verbosity, ...) \
+  do { \
+    if ((verbosity) <= loggerGetVerbosity()) \
+      app_log( "%5"PRIu32":%s:%s: " message "\n", loggerGetTimestamp(), level, __func__, ##__VA_ARGS__ ); \
+  } while (0)
 uint32_t loggerGetTimestamp (void);
 void     printSLErrorString (sl_status_t status);
+uint32_t loggerGetVerbosity (void);
+void     loggerSetVerbosity (uint32_t verbosity);
 
 #else
 
 /*
  * Remove all logging related code where logging is not enabled
  */
-//#define LOG_DO(message,level, ...)
+//#define LOG_DO(message,level,verbosity, ...)
 static inline void LOG_DO() {}
 
 #endif // #else
@@ -42,3 +42,24 @@ void LETIMER0_clk_Enable(uint32_t nrg_mode, uint32_t prescaler){
     CMU_ClockDivSet(cmuClock_LETIMER0,prescaler);
     CMU_ClockEnable(cmuClock_LETIMER0, true);
 }
+
+/**
+ * @brief Setups the required clocks for the CRYOTIMER module based on given
+ *        energy mode
+ * @param   nrg_mode   Energy mode in which the microcontroller is going to run
+ *                     Accepted values: 0, 1, 2, 3
+ * @return  the CRYOTIMER_CTRL OSCSEL value matching the enabled oscillator
+ */
+uint32_t CRYOTIMER_clk_Enable(uint32_t nrg_mode){
+  CMU_ClockEnable(cmuClock_CRYOTIMER, true);
+
+  if(nrg_mode != 3){
+    // Wait for LFXORDY, the CRYOTIMER must not be started on a dead clock
+    CMU_OscillatorEnable (cmuOsc_LFXO,true, true);
+    return CRYOTIMER_CTRL_OSCSEL_LFXO;
+  }
+  else{
+    CMU_OscillatorEnable (cmuOsc_ULFRCO,true, true);
+    return CRYOTIMER_CTRL_OSCSEL_ULFRCO;
+  }
+}
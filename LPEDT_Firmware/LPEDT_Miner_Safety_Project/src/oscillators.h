@@ -34,4 +34,13 @@
  */
 void LETIMER0_clk_Enable(uint32_t nrg_mode, uint32_t prescaler);
 
+/**
+ * @brief Setups the required clocks for the CRYOTIMER module based on given
+ *        energy mode
+ * @param   nrg_mode   Energy mode in which the microcontroller is going to run
+ *                     Accepted values: 0, 1, 2, 3
+ * @return  the CRYOTIMER_CTRL OSCSEL value matching the enabled oscillator
+ */
+uint32_t CRYOTIMER_clk_Enable(uint32_t nrg_mode);
+
 #endif /* SRC_OSCILLATORS_H_ */
@@ -0,0 +1,254 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    ringbuf.c
+ * @brief   Single-producer/single-consumer byte ring holding length-prefixed,
+ *          variable-length records
+ *
+ *          head and tail are free running indexes, the used byte count is
+ *          simply head - tail and the position in storage is index & mask.
+ *          A record is never split across the end of the ring, so that both
+ *          the producer (ringbuf_reserve()) and the consumer (ringbuf_peek())
+ *          can work on it in place. When it does not fit in the bytes left
+ *          at the end, those bytes are skipped with a pad marker.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include <string.h>
+
+#include "em_device.h"
+#include "ringbuf.h"
+
+// ---------------------------------------------------------------------
+// Private function.
+// Computes how many bytes must be skipped at the end of the ring before a
+// record of len payload bytes can be placed at head.
+// ---------------------------------------------------------------------
+static uint32_t ringbuf_pad_for(const ringbuf_t *rb, uint32_t len) {
+  uint32_t contiguous = rb->size - (rb->head & rb->mask);
+
+  if(contiguous >= (RINGBUF_HEADER_SIZE + len))
+    return 0;
+
+  return contiguous;
+}
+
+/**
+ * @brief   Initializes a ring on top of the given memory
+ * @param   rb       ring to initialize
+ * @param   storage  backing memory
+ * @param   size     size of storage in bytes, must be a power of 2
+ * @return  false if successful, true if size is not a power of 2
+ */
+bool ringbuf_init(ringbuf_t *rb, uint8_t *storage, uint32_t size) {
+  if((size < RINGBUF_HEADER_SIZE) || ((size & (size - 1)) != 0))
+    return true;
+
+  rb->storage = storage;
+  rb->size = size;
+  rb->mask = size - 1;
+  ringbuf_reset(rb);
+
+  return false;
+}
+
+/**
+ * @brief   Drops every record. Only safe while neither side is active.
+ * @param   rb   ring to reset
+ * @return  none
+ */
+void ringbuf_reset(ringbuf_t *rb) {
+  rb->head = 0;
+  rb->committed = 0;
+  rb->reserved = 0;
+  rb->pad = 0;
+  rb->tail = 0;
+  rb->released = 0;
+}
+
+/**
+ * @brief   Tells if a record of len bytes can be reserved right now, O(1)
+ * @param   rb   ring to query
+ * @param   len  payload length
+ * @return  true if ringbuf_reserve(rb, len) would succeed
+ */
+bool ringbuf_fits(const ringbuf_t *rb, uint32_t len) {
+  uint32_t need;
+
+  if((len > RINGBUF_MAX_RECORD) || ((RINGBUF_HEADER_SIZE + len) > rb->size))
+    return false;
+
+  need = ringbuf_pad_for(rb, len) + RINGBUF_HEADER_SIZE + len;
+
+  return (need <= ringbuf_free(rb));
+}
+
+/**
+ * @brief   Producer: reserves contiguous space for a record of len bytes
+ * @param   rb   ring to write to
+ * @param   len  payload length of the record
+ * @return  pointer to fill with the payload, NULL if it does not fit
+ */
+uint8_t *ringbuf_reserve(ringbuf_t *rb, uint32_t len) {
+  uint32_t pos;
+
+  if(!ringbuf_fits(rb, len))
+    return NULL;
+
+  rb->pad = ringbuf_pad_for(rb, len);
+  rb->reserved = len;
+
+  pos = (rb->head + rb->pad) & rb->mask;
+
+  return &rb->storage[pos + RINGBUF_HEADER_SIZE];
+}
+
+/**
+ * @brief   Producer: publishes the record opened by ringbuf_reserve()
+ * @param   rb   ring to write to
+ * @param   len  payload length actually written, at most the reserved length
+ * @return  none
+ */
+void ringbuf_commit(ringbuf_t *rb, uint32_t len) {
+  uint32_t pos = rb->head & rb->mask;
+
+  if(len > rb->reserved)
+    len = rb->reserved;
+
+  // Tell the consumer to wrap if we skipped the end of the ring. With less
+  // than a header left it wraps on its own.
+  if(rb->pad >= RINGBUF_HEADER_SIZE){
+    rb->storage[pos] = (uint8_t) RINGBUF_PAD_MARKER;
+    rb->storage[pos + 1] = (uint8_t) (RINGBUF_PAD_MARKER >> 8);
+  }
+
+  pos = (rb->head + rb->pad) & rb->mask;
+  rb->storage[pos] = (uint8_t) len;
+  rb->storage[pos + 1] = (uint8_t) (len >> 8);
+
+  // Count the record before it becomes visible so that depth never reads
+  // lower than what the consumer can see, then make sure the payload and
+  // header are in memory before head moves
+  rb->committed++;
+  __DMB();
+  rb->head += rb->pad + RINGBUF_HEADER_SIZE + len;
+
+  rb->reserved = 0;
+  rb->pad = 0;
+}
+
+/**
+ * @brief   Producer: copies a record into the ring
+ * @param   rb    ring to write to
+ * @param   data  payload
+ * @param   len   payload length
+ * @return  false if successful, true if the record does not fit
+ */
+bool ringbuf_write(ringbuf_t *rb, const void *data, uint32_t len) {
+  uint8_t *p = ringbuf_reserve(rb, len);
+
+  if(p == NULL)
+    return true;
+
+  memcpy(p, data, len);
+  ringbuf_commit(rb, len);
+
+  return false;
+}
+
+/**
+ * @brief   Consumer: returns the oldest record without removing it
+ * @param   rb   ring to read from
+ * @param   len  set to the payload length of the record
+ * @return  pointer to the payload, NULL if the ring is empty
+ */
+const uint8_t *ringbuf_peek(ringbuf_t *rb, uint32_t *len) {
+  uint32_t pos, contiguous, recordLen;
+
+  while(rb->tail != rb->head){
+    // head has been read, everything before it is valid
+    __DMB();
+
+    pos = rb->tail & rb->mask;
+    contiguous = rb->size - pos;
+
+    if(contiguous >= RINGBUF_HEADER_SIZE){
+      recordLen = rb->storage[pos] | (rb->storage[pos + 1] << 8);
+      if(recordLen != RINGBUF_PAD_MARKER){
+        *len = recordLen;
+        return &rb->storage[pos + RINGBUF_HEADER_SIZE];
+      }
+    }
+
+    // skip the unused end of the ring
+    rb->tail += contiguous;
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief   Consumer: removes the record returned by ringbuf_peek()
+ * @param   rb   ring to read from
+ * @return  none
+ */
+void ringbuf_release(ringbuf_t *rb) {
+  uint32_t len;
+
+  if(ringbuf_peek(rb, &len) == NULL)
+    return;
+
+  // we are done reading the payload before the producer may overwrite it
+  __DMB();
+  rb->tail += RINGBUF_HEADER_SIZE + len;
+  rb->released++;
+}
+
+/**
+ * @brief   Consumer: copies the oldest record out of the ring and removes it
+ * @param   rb      ring to read from
+ * @param   data    destination for the payload
+ * @param   maxLen  size of data
+ * @param   len     set to the payload length
+ * @return  false if successful, true if empty or the record is larger than
+ *          maxLen (the record is left in the ring)
+ */
+bool ringbuf_read(ringbuf_t *rb, void *data, uint32_t maxLen, uint32_t *len) {
+  const uint8_t *p = ringbuf_peek(rb, len);
+
+  if((p == NULL) || (*len > maxLen))
+    return true;
+
+  memcpy(data, p, *len);
+  ringbuf_release(rb);
+
+  return false;
+}
+
+/**
+ * @brief   Number of records currently held, O(1)
+ * @param   rb   ring to query
+ * @return  record count
+ */
+uint32_t ringbuf_depth(const ringbuf_t *rb) {
+  return rb->committed - rb->released;
+}
+
+/**
+ * @brief   Free bytes, O(1)
+ * @param   rb   ring to query
+ * @return  free bytes
+ */
+uint32_t ringbuf_free(const ringbuf_t *rb) {
+  return rb->size - (rb->head - rb->tail);
+}
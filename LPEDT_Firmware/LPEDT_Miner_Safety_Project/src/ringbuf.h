@@ -0,0 +1,146 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    ringbuf.h
+ * @brief   Header file for ringbuf.c. Single-producer/single-consumer byte
+ *          ring holding length-prefixed, variable-length records
+ *
+ *          The producer only ever writes head/committed and the consumer only
+ *          ever writes tail/released, so one side may run in an ISR and the
+ *          other in main context without critical sections.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#ifndef SRC_RINGBUF_H_
+#define SRC_RINGBUF_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Every record is stored as a 2 byte little endian length followed by the
+// payload. A length of RINGBUF_PAD_MARKER tells the consumer to skip to the
+// start of the ring.
+#define RINGBUF_HEADER_SIZE  (2)
+#define RINGBUF_PAD_MARKER   (0xFFFF)
+
+// Largest payload a single record can hold
+#define RINGBUF_MAX_RECORD   (RINGBUF_PAD_MARKER - 1)
+
+typedef struct {
+  uint8_t           *storage;    // backing memory, size bytes
+  uint32_t           size;       // power of 2
+  uint32_t           mask;       // size - 1
+
+  // producer side
+  volatile uint32_t  head;       // free running write index
+  volatile uint32_t  committed;  // number of records ever committed
+  uint32_t           reserved;   // payload bytes of the open reservation
+  uint32_t           pad;        // bytes skipped at the end for the open reservation
+
+  // consumer side
+  volatile uint32_t  tail;       // free running read index
+  volatile uint32_t  released;   // number of records ever released
+} ringbuf_t;
+
+/**
+ * @brief   Initializes a ring on top of the given memory
+ * @param   rb       ring to initialize
+ * @param   storage  backing memory
+ * @param   size     size of storage in bytes, must be a power of 2
+ * @return  false if successful, true if size is not a power of 2
+ */
+bool ringbuf_init(ringbuf_t *rb, uint8_t *storage, uint32_t size);
+
+/**
+ * @brief   Drops every record. Only safe while neither side is active.
+ * @param   rb   ring to reset
+ * @return  none
+ */
+void ringbuf_reset(ringbuf_t *rb);
+
+/**
+ * @brief   Producer: reserves contiguous space for a record of len bytes
+ * @param   rb   ring to write to
+ * @param   len  payload length of the record
+ * @return  pointer to fill with the payload, NULL if it does not fit
+ */
+uint8_t *ringbuf_reserve(ringbuf_t *rb, uint32_t len);
+
+/**
+ * @brief   Producer: publishes the record opened by ringbuf_reserve()
+ * @param   rb   ring to write to
+ * @param   len  payload length actually written, at most the reserved length
+ * @return  none
+ */
+void ringbuf_commit(ringbuf_t *rb, uint32_t len);
+
+/**
+ * @brief   Producer: copies a record into the ring
+ * @param   rb    ring to write to
+ * @param   data  payload
+ * @param   len   payload length
+ * @return  false if successful, true if the record does not fit
+ */
+bool ringbuf_write(ringbuf_t *rb, const void *data, uint32_t len);
+
+/**
+ * @brief   Consumer: returns the oldest record without removing it
+ * @param   rb   ring to read from
+ * @param   len  set to the payload length of the record
+ * @return  pointer to the payload, NULL if the ring is empty
+ */
+const uint8_t *ringbuf_peek(ringbuf_t *rb, uint32_t *len);
+
+/**
+ * @brief   Consumer: removes the record returned by ringbuf_peek()
+ * @param   rb   ring to read from
+ * @return  none
+ */
+void ringbuf_release(ringbuf_t *rb);
+
+/**
+ * @brief   Consumer: copies the oldest record out of the ring and removes it
+ * @param   rb      ring to read from
+ * @param   data    destination for the payload
+ * @param   maxLen  size of data
+ * @param   len     set to the payload length
+ * @return  false if successful, true if empty or the record is larger than
+ *          maxLen (the record is left in the ring)
+ */
+bool ringbuf_read(ringbuf_t *rb, void *data, uint32_t maxLen, uint32_t *len);
+
+/**
+ * @brief   Number of records currently held, O(1)
+ * @param   rb   ring to query
+ * @return  record count
+ */
+uint32_t ringbuf_depth(const ringbuf_t *rb);
+
+/**
+ * @brief   Free bytes, O(1). A record needs RINGBUF_HEADER_SIZE bytes on top of
+ *          its payload and may also need the bytes left at the end of the
+ *          ring, use ringbuf_fits() to know if a given record can be written.
+ * @param   rb   ring to query
+ * @return  free bytes
+ */
+uint32_t ringbuf_free(const ringbuf_t *rb);
+
+/**
+ * @brief   Tells if a record of len bytes can be reserved right now, O(1)
+ * @param   rb   ring to query
+ * @param   len  payload length
+ * @return  true if ringbuf_reserve(rb, len) would succeed
+ */
+bool ringbuf_fits(const ringbuf_t *rb, uint32_t len);
+
+#endif /* SRC_RINGBUF_H_ */
@@ -18,6 +18,7 @@
 
 #include <em_core.h>
 #include <sl_power_manager.h>
+#include <string.h>
 #include "src/scheduler.h"
 #include "src/gpio.h"
 #include "src/timers.h"
@@ -25,42 +26,36 @@
 #include "lcd.h"
 #include "ble.h"
 #include "ble_device_type.h"
+#include "telemetry.h"
+#include "beacon.h"
+#include "gateway.h"
+#include "journal.h"
+#include "ieee11073.h"
+#include "governor.h"
+#include "energy.h"
 
 // Include logging specifically for this .c file
 #define INCLUDE_LOG_DEBUG 1
 #include "src/log.h"
 
-#define LETIMERUF_BIT_POS 0
-#define LETIMERCOMP1_BIT_POS 1
-#define I2C_TRANSFER_COMPLETE_BIT_POS 2
-
 #define SI7021_POR_TIME_US 80000
 #define SI7021_14B_CONVERSION_TIME_US 10800
 
 #define I2CTransferDone  0    /* Transfer completed successfully. Taken from em_i2c library*/
 uint32_t SchedulerEvents = 0;
 
-#define NUM_STATES 5
+#define NUM_STATES 6
 
 // enum declarations used for temperature state machines
 typedef enum uint32_t {
   stateIdle,
   waitForSi7021POR,
+  waitForI2CResolutionWrite,
   waitForI2CWriteTransfer,
   waitForSi7021Conversion,
   waitForI2CReadTransfer
 } State_t;
 
-typedef enum uint16_t{
-  State_1,
-  State_2,
-  State_3,
-  State_4,
-  State_5,
-  State_6,
-  State_7
-} Discovery_States_t;
-
 uint8_t htm_temperature_buffer[5];
 uint32_t htm_temperature_flt;
 uint8_t flags = 0x00;
@@ -90,6 +85,11 @@ static const uint8_t button_char[] =  { 0x89, 0x62, 0x13, 0x2d, 0x2a, 0x65, // 6
                                         0x02, 0x00, 0x00, 0x00              // 00000002
                                       };
 
+// Generic Attribute service UUID defined by Bluetooth SIG
+static const uint8_t gatt_service[2] = { 0x01, 0x18 };
+// Database Hash characteristic UUID defined by Bluetooth SIG
+static const uint8_t database_hash_char[2] = { 0x2a, 0x2b };
+
 #endif
 
 
@@ -203,6 +203,40 @@ uint32_t getNextEvent(){
 }
 
 #if BUILD_INCLUDES_BLE_SERVER == 1
+// Si7021 resolution in its user register, the sensor stays powered with the
+// LCD so it is only written when the governor asks for another one
+static uint8_t si7021Bits = 14;
+
+/**
+ * @brief   Returns the user register value of a temperature resolution
+ * @param   bits    11 to 14
+ * @return  register value
+ */
+static uint8_t si7021_user_reg(uint8_t bits) {
+  switch(bits){
+    case 13: return SI7021_USER_REG_RESET | SI7021_USER_REG_T13;
+    case 12: return SI7021_USER_REG_RESET | SI7021_USER_REG_T12;
+    case 11: return SI7021_USER_REG_RESET | SI7021_USER_REG_T11;
+    case 14:
+    default: return SI7021_USER_REG_RESET | SI7021_USER_REG_T14;
+  }
+}
+
+/**
+ * @brief   Returns the temperature conversion time of a resolution
+ * @param   bits    11 to 14
+ * @return  time in microseconds
+ */
+static uint32_t si7021_conversion_us(uint8_t bits) {
+  switch(bits){
+    case 13: return SI7021_13B_CONVERSION_TIME_US;
+    case 12: return SI7021_12B_CONVERSION_TIME_US;
+    case 11: return SI7021_11B_CONVERSION_TIME_US;
+    case 14:
+    default: return SI7021_14B_CONVERSION_TIME_US;
+  }
+}
+
 /**
  * @brief   State machine to get the temperature from Si7021 chip over I2C using
  *          IRQs and send it via BT
@@ -213,7 +247,7 @@ uint32_t getNextEvent(){
 void temperature_state_machine_bt(sl_bt_msg_t *evt){
   State_t currentState;
   static State_t nextState = stateIdle;
-  uint32_t temperature_reading = 0;
+  int32_t temperature_reading = 0;
   uint16_t Si7021_data = 0;
   sl_status_t sc; // status code
 
@@ -222,19 +256,27 @@ void temperature_state_machine_bt(sl_bt_msg_t *evt){
 
   // Check the following conditioins and proceed if all are true:
   //  - we have recieved some external event from the bluetooth stack
-  //  - the bluetooth connection is open
-  //  - indications are turned on by the client
+  //  - the beacon broadcasts the temperature, or
+  //  - the bluetooth connection is open and HTM indications, bulk telemetry
+  //    or stream notifications are turned on by the client
   if((SL_BT_MSG_ID(evt->header) == sl_bt_evt_system_external_signal_id) &&
-     (bleDataPtr->connection_open == true) &&
-     (bleDataPtr->ok_to_send_htm_indications == true)){
+     ((BEACON_MODE_ENABLE == 1) ||
+      ((bleDataPtr->connection_open == true) &&
+       ((bleDataPtr->ok_to_send_htm_indications == true) ||
+        (bleDataPtr->ok_to_send_telemetry_notifications == true) ||
+        (bleDataPtr->ok_to_send_stream_notifications == true))))){
     switch (currentState) {
       case stateIdle:
               nextState = stateIdle; // default
               /*
-               * if event is LETIMERUF, then power on the Si7021, set delay for
-               * Si7021 POR and go to next state
+               * if event is LETIMERUF and the sampling period of the governor
+               * is over, then power on the Si7021, set delay for Si7021 POR
+               * and go to next state. The timed waits of a measurement stay
+               * on the LFXO.
                */
-                if ((evt->data.evt_system_external_signal.extsignals & (1<<LETIMERUF_BIT_POS))){
+                if ((evt->data.evt_system_external_signal.extsignals & (1<<LETIMERUF_BIT_POS)) &&
+                    (LETIMER0_Sample_Due() == true)){
+                    ENERGY_REQUIRE(ENERGY_NEED_LFXO_TIMER);
                     si7021TurnOn();
                     timerWaitUs_irq(SI7021_POR_TIME_US);
                     nextState = waitForSi7021POR;
@@ -246,8 +288,30 @@ void temperature_state_machine_bt(sl_bt_msg_t *evt){
                * if timer event is complete (denoted by the LETIMER_COMP1 event),
                * then start I2C write operation to request
                * temperature data from the Si7021 chip and go to next state.
+               * If the governor changed the resolution, write the user
+               * register first. I2C0 needs EM1 until the transfers are done.
                */
                 if ((evt->data.evt_system_external_signal.extsignals & (1<<LETIMERCOMP1_BIT_POS))){
+                    ENERGY_REQUIRE(ENERGY_NEED_I2C);
+                    if (governor_profile()->temperatureBits != si7021Bits) {
+                        I2C_Write_Reg_itr(SI7021_DEVICE_ADDR, SI7021_CMD_WRITE_USER_REG,
+                                          si7021_user_reg(governor_profile()->temperatureBits));
+                        nextState = waitForI2CResolutionWrite;
+                    } else {
+                        I2C_Write_Data_itr(SI7021_DEVICE_ADDR, SI7021_CMD_MEASURE_TEMP_NO_HOLD);
+                        nextState = waitForI2CWriteTransfer;
+                    }
+                }
+              break;
+      case waitForI2CResolutionWrite:
+              nextState = waitForI2CResolutionWrite; // default
+              /*
+               * if i2c transfer is done, the new resolution is in force,
+               * request temperature data and go to next state.
+               */
+                if ((evt->data.evt_system_external_signal.extsignals & (1<<I2C_TRANSFER_COMPLETE_BIT_POS))){
+                    NVIC_DisableIRQ(I2C0_IRQn);
+                    si7021Bits = governor_profile()->temperatureBits;
                     I2C_Write_Data_itr(SI7021_DEVICE_ADDR, SI7021_CMD_MEASURE_TEMP_NO_HOLD);
                     nextState = waitForI2CWriteTransfer;
                 }
@@ -260,7 +324,8 @@ void temperature_state_machine_bt(sl_bt_msg_t *evt){
                */
                 if ((evt->data.evt_system_external_signal.extsignals & (1<<I2C_TRANSFER_COMPLETE_BIT_POS))){
                     NVIC_DisableIRQ(I2C0_IRQn);
-                    timerWaitUs_irq(SI7021_14B_CONVERSION_TIME_US);
+                    ENERGY_RELEASE(ENERGY_NEED_I2C);
+                    timerWaitUs_irq(si7021_conversion_us(si7021Bits));
                     nextState = waitForSi7021Conversion;
                 }
               break;
@@ -272,6 +337,7 @@ void temperature_state_machine_bt(sl_bt_msg_t *evt){
               * from the Si7021 chip and go to next state.
               */
                 if ((evt->data.evt_system_external_signal.extsignals & (1<<LETIMERCOMP1_BIT_POS))){
+                    ENERGY_REQUIRE(ENERGY_NEED_I2C);
                     I2C_Read_Data_irq(SI7021_DEVICE_ADDR);
                     nextState = waitForI2CReadTransfer;
                 }
@@ -286,19 +352,30 @@ void temperature_state_machine_bt(sl_bt_msg_t *evt){
                   if ((evt->data.evt_system_external_signal.extsignals & (1<<I2C_TRANSFER_COMPLETE_BIT_POS))){
                     NVIC_DisableIRQ(I2C0_IRQn);
                     si7021TurnOff();
+                    ENERGY_RELEASE(ENERGY_NEED_I2C);
+                    ENERGY_RELEASE(ENERGY_NEED_LFXO_TIMER);
                     uint8_t *p = &htm_temperature_buffer[0];
                     Si7021_data = I2C_Get_Data();
 
                     // Converting the data received from the sensor into temperature in Celsius
-                    // using the formula given in the SI7021 sensor application note AN607
-                    temperature_reading = ((Si7021_data*175.72)/65536) - 46.85;
+                    // using the formula given in the SI7021 sensor application note AN607,
+                    // in 0.001 degC, 175720 / 65536 reduced to 21965 / 8192 to fit 32 bits
+                    int32_t temperature_milli = ((int32_t) Si7021_data * 21965) / 8192 - 46850;
+                    temperature_reading = temperature_milli / 1000;
+
+                    // Batched with every other sensor and broadcast, in 0.01 degC
+                    int16_t temperature_centi = (int16_t) (((int32_t) Si7021_data * 17572) / 65536 - 4685);
+                    // Journaled in flash when no client takes it
+                    if(telemetry_add_sample(TELEMETRY_SENSOR_TEMPERATURE, temperature_centi))
+                      journal_append(TELEMETRY_SENSOR_TEMPERATURE, temperature_centi);
+                    beacon_update_temperature(temperature_centi);
 
                     // To send via BT, do the following steps:
                     // - update GATT data base with sl_bt_gatt_server_write_attribute_value()
                     // - Convert the temp data into float, insert into the bit
                     //   stream and write into the GATT DB
                     UINT8_TO_BITSTREAM(p, flags);
-                    htm_temperature_flt = INT32_TO_FLOAT(temperature_reading*1000, -3);
+                    htm_temperature_flt = ieee11073_float_encode(temperature_milli, -3);
                     UINT32_TO_BITSTREAM(p, htm_temperature_flt);
 
                     sc = sl_bt_gatt_server_write_attribute_value(
@@ -307,13 +384,17 @@ void temperature_state_machine_bt(sl_bt_msg_t *evt){
                           5, // length
                           &htm_temperature_buffer[0] // in IEEE-11073 format
                          );
+                    if (sc != SL_STATUS_OK) {
+                        LOG_ERROR("sl_bt_gatt_server_write_attribute_value() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+                    }
 
                     //-----------------------------------------------------------------------
                     // call sl_bt_gatt_server_send_indication() ONLY if the following
                     // conditions are met :
                     //  - Connection is open
                     //  - Client has enabled indications for the HTM indications
-                    //  - There is no indication currently in-flight
+                    //  - There is no indication currently in-flight, this is
+                    //    handled by send_indication()
                     //
                     // If all above conditions are met, then update the temperature value on
                     // the LCD display on the row 'DISPLAY_ROW_TEMPVALUE'.
@@ -322,24 +403,11 @@ void temperature_state_machine_bt(sl_bt_msg_t *evt){
                     if  ((bleDataPtr->connection_open == true) &&
                          (bleDataPtr->ok_to_send_htm_indications == true)){
 
-                        if(!((bleDataPtr->indication_in_flight == false)||
-                            (get_queue_depth() > 0))){
-                            // Server Sending the Indication.
-                          sc = sl_bt_gatt_server_send_indication(
-                                bleDataPtr->connectionHandle,
-                                gattdb_temperature_measurement, // handle from gatt_db.h
-                                5,
-                                &htm_temperature_buffer[0] // in IEEE-11073 format
-                               );
-
-                          if (sc != SL_STATUS_OK) {
-                              LOG_ERROR("sl_bt_gatt_server_send_indication() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
-                          }
-                          bleDataPtr->indication_in_flight = true;
-
-                        } // if
-                        else{
-                            write_queue(gattdb_temperature_measurement, 5, &htm_temperature_buffer[0]);
+                        // Sent right away if the link is free, otherwise
+                        // queued behind any pending alarm
+                        if (send_indication(QUEUE_LANE_ROUTINE, gattdb_temperature_measurement,
+                                            5, &htm_temperature_buffer[0])) {
+                            LOG_ERROR("HTM indication dropped, routine lane full\r\n");
                         }
                           displayPrintf(DISPLAY_ROW_TEMPVALUE, "Temp=%d", temperature_reading);
                     }// if
@@ -365,37 +433,86 @@ void temperature_state_machine_bt(sl_bt_msg_t *evt){
 
 #if BUILD_INCLUDES_BLE_CLIENT == 1
 
+/**
+ * @brief   Starts a full discovery with the HTM service, nothing is taken
+ *          from the discovery cache
+ * @param   slot    helmet
+ * @return  none
+ */
+static void start_full_discovery(gateway_slot_t *slot){
+    sl_status_t sc; // status code
+
+    slot->cacheHit = false;
+    memset(&slot->cache, 0, sizeof(slot->cache));
+
+    sc = sl_bt_gatt_discover_primary_services_by_uuid(slot->connection,
+                                                      sizeof(thermo_service),
+                                                      (const uint8_t*)&thermo_service[0]);
+
+    if (sc != SL_STATUS_OK) {
+        LOG_ERROR("sl_bt_gatt_discover_primary_services_by_uuid() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+    }
+
+    slot->discoveryState = State_2;
+}
+
 void Discovery_State_Machine(sl_bt_msg_t *evt){
 
     Discovery_States_t currentState;
-    static Discovery_States_t nextState = State_1;
+    gateway_slot_t *slot;
+    uint8_t connection;
 
     sl_status_t sc; // status code
 
-    currentState = nextState;
-    ble_data_struct_t *bleDataPtr = get_ble_data_ptr();
+    // Every connected helmet runs its own discovery, the state and the
+    // handles found live in its gateway slot
+    switch (SL_BT_MSG_ID(evt->header)) {
+        case sl_bt_evt_connection_opened_id:
+            connection = evt->data.evt_connection_opened.connection;
+            break;
+        case sl_bt_evt_gatt_procedure_completed_id:
+            connection = evt->data.evt_gatt_procedure_completed.connection;
+            break;
+        case sl_bt_evt_connection_closed_id:
+            connection = evt->data.evt_connection_closed.connection;
+            break;
+        default:
+            return;
+    }
+
+    slot = gateway_get_slot(connection);
+    if (slot == NULL)
+        return;
+
+    currentState = slot->discoveryState;
     switch (currentState) {
         case State_1:
-                nextState = State_1; // default
+                slot->discoveryState = State_1; // default
                 /*
                  * if event is sl_bt_evt_connection_opened_id,
-                 *  - call API sl_bt_gatt_discover_primary_services_by_uuid()
+                 *  - if the helmet is in the discovery cache, read its
+                 *    Database Hash to validate the cached handles
+                 *  - otherwise call API sl_bt_gatt_discover_primary_services_by_uuid()
                  *    for HTM service
                  */
                   if (SL_BT_MSG_ID(evt->header) == sl_bt_evt_connection_opened_id) {
-                    sc = sl_bt_gatt_discover_primary_services_by_uuid(bleDataPtr->connectionHandle,
-                                                                      sizeof(thermo_service),
-                                                                      (const uint8_t*)&thermo_service[0]);
+                    slot->peerHashValid = false;
+                    if (discovery_cache_lookup(&slot->address, &slot->cache) == true) {
+                        sc = sl_bt_gatt_read_characteristic_value(slot->connection,
+                                                                  slot->cache.hashHandle);
 
-                    if (sc != SL_STATUS_OK) {
-                        LOG_ERROR("sl_bt_gatt_discover_primary_services_by_uuid() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+                        if (sc != SL_STATUS_OK) {
+                            LOG_ERROR("sl_bt_gatt_read_characteristic_value() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+                        }
+                        slot->discoveryState = State_8;
+                        break;
                     }
 
-                    nextState = State_2;
+                    start_full_discovery(slot);
                   }
                 break;
         case State_2:
-                nextState = State_2; // default
+                slot->discoveryState = State_2; // default
                 /*
                  * if event is sl_bt_evt_gatt_procedure_completed_id,
                  *  - Save the returned service handle for HTM
@@ -403,20 +520,20 @@ void Discovery_State_Machine(sl_bt_msg_t *evt){
                  *    for HTM characteristics
                  */
                   if (SL_BT_MSG_ID(evt->header) == sl_bt_evt_gatt_procedure_completed_id) {
-                      bleDataPtr->serviceHandleHTM = bleDataPtr->serviceHandle;
-                      sc = sl_bt_gatt_discover_characteristics_by_uuid(bleDataPtr->connectionHandle,
-                                                                       bleDataPtr->serviceHandleHTM,
+                      slot->serviceHandleHTM = slot->serviceHandle;
+                      sc = sl_bt_gatt_discover_characteristics_by_uuid(slot->connection,
+                                                                       slot->serviceHandleHTM,
                                                                         sizeof(thermo_char),
                                                                         (const uint8_t*) &thermo_char[0]);
 
                       if (sc != SL_STATUS_OK) {
                           LOG_ERROR("sl_bt_gatt_discover_characteristics_by_uuid() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
                       }
-                      nextState = State_3;
+                      slot->discoveryState = State_3;
                   }
                 break;
         case State_3:
-                nextState = State_3; // default
+                slot->discoveryState = State_3; // default
                  /*
                   * if event is sl_bt_evt_gatt_procedure_completed_id,
                   *  - Save the returned characteristic handle for HTM
@@ -425,19 +542,19 @@ void Discovery_State_Machine(sl_bt_msg_t *evt){
                   */
                    if (SL_BT_MSG_ID(evt->header) == sl_bt_evt_gatt_procedure_completed_id) {
 
-                       bleDataPtr->characteristicHandleHTM = bleDataPtr->characteristicHandle;
-                       sc = sl_bt_gatt_set_characteristic_notification(bleDataPtr->connectionHandle,
-                                                                        bleDataPtr->characteristicHandleHTM,
+                       slot->characteristicHandleHTM = slot->characteristicHandle;
+                       sc = sl_bt_gatt_set_characteristic_notification(slot->connection,
+                                                                        slot->characteristicHandleHTM,
                                                                         sl_bt_gatt_indication);
 
                        if (sc != SL_STATUS_OK) {
                            LOG_ERROR("sl_bt_gatt_set_characteristic_notification() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
                        }
-                       nextState = State_4;
+                       slot->discoveryState = State_4;
                    }
                 break;
         case State_4:
-                nextState = State_4; // default
+                slot->discoveryState = State_4; // default
                 /*
                  * if event is sl_bt_evt_gatt_procedure_completed_id,
                  *  - update the LCD row DISPLAY_ROW_CONNECTION
@@ -446,18 +563,18 @@ void Discovery_State_Machine(sl_bt_msg_t *evt){
                  */
                   if (SL_BT_MSG_ID(evt->header) == sl_bt_evt_gatt_procedure_completed_id) {
                       displayPrintf(DISPLAY_ROW_CONNECTION, "Handling Indications");
-                      sc = sl_bt_gatt_discover_primary_services_by_uuid(bleDataPtr->connectionHandle,
+                      sc = sl_bt_gatt_discover_primary_services_by_uuid(slot->connection,
                                                                         sizeof(button_service),
                                                                         (const uint8_t*)&button_service[0]);
 
                       if (sc != SL_STATUS_OK) {
                           LOG_ERROR("sl_bt_gatt_discover_primary_services_by_uuid() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
                       }
-                      nextState = State_5;
+                      slot->discoveryState = State_5;
                   }
                 break;
         case State_5:
-                nextState = State_5; // default
+                slot->discoveryState = State_5; // default
                 /*
                  * if event is sl_bt_evt_connection_opened_id,
                  *  - Save the returned service handle for Button service
@@ -465,9 +582,9 @@ void Discovery_State_Machine(sl_bt_msg_t *evt){
                  *    for Button characteristics
                  */
                   if (SL_BT_MSG_ID(evt->header) == sl_bt_evt_gatt_procedure_completed_id) {
-                    bleDataPtr->serviceHandleButton = bleDataPtr->serviceHandle;
-                    sc = sl_bt_gatt_discover_characteristics_by_uuid(bleDataPtr->connectionHandle,
-                                                                     bleDataPtr->serviceHandleButton,
+                    slot->serviceHandleButton = slot->serviceHandle;
+                    sc = sl_bt_gatt_discover_characteristics_by_uuid(slot->connection,
+                                                                     slot->serviceHandleButton,
                                                                      sizeof(button_char),
                                                                      (const uint8_t*) &button_char[0]);
 
@@ -475,11 +592,11 @@ void Discovery_State_Machine(sl_bt_msg_t *evt){
                         LOG_ERROR("sl_bt_gatt_discover_characteristics_by_uuid() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
                     }
 
-                    nextState = State_6;
+                    slot->discoveryState = State_6;
                   }
                 break;
         case State_6:
-                nextState = State_6; // default
+                slot->discoveryState = State_6; // default
                 /*
                  * if event is sl_bt_evt_gatt_procedure_completed_id,
                   *  - Save the returned characteristic handle for Button
@@ -490,28 +607,147 @@ void Discovery_State_Machine(sl_bt_msg_t *evt){
                   *    characteristics
                  */
                   if (SL_BT_MSG_ID(evt->header) == sl_bt_evt_gatt_procedure_completed_id) {
-                     bleDataPtr->characteristicHandleButton = bleDataPtr->characteristicHandle;
-                     sc = sl_bt_gatt_set_characteristic_notification(bleDataPtr->connectionHandle,
-                                                                      bleDataPtr->characteristicHandleButton,
+                     slot->characteristicHandleButton = slot->characteristicHandle;
+                     sc = sl_bt_gatt_set_characteristic_notification(slot->connection,
+                                                                      slot->characteristicHandleButton,
                                                                       sl_bt_gatt_indication);
 
                      if (sc != SL_STATUS_OK) {
                          LOG_ERROR("sl_bt_gatt_set_characteristic_notification() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
                      }
-                     bleDataPtr->isIndicationOnButton = true;
-                     nextState = State_7;
+                     slot->isIndicationOnButton = true;
+
+                     // A full discovery goes on to fill the discovery cache
+                     slot->discoveryState = (slot->cacheHit == true) ? State_7 : State_9;
                   }
                   break;
         case State_7:
-                nextState = State_7; // default
+                slot->discoveryState = State_7; // default
                 /*
                  * if the connection is closed, the start discovery from the beginning
                  */
 
                 if (SL_BT_MSG_ID(evt->header) == sl_bt_evt_connection_closed_id) {
-                    nextState = State_1;
+                    slot->discoveryState = State_1;
                 }
                 break;
+        case State_8:
+                slot->discoveryState = State_8; // default
+                /*
+                 * if event is sl_bt_evt_gatt_procedure_completed_id,
+                 *  - if the Database Hash read is the cached one, use the
+                 *    cached handles and enable HTM indication, State_6 then
+                 *    enables button indication
+                 *  - otherwise drop the cache entry and run a full discovery
+                 */
+                  if (SL_BT_MSG_ID(evt->header) == sl_bt_evt_gatt_procedure_completed_id) {
+                      if ((slot->peerHashValid == true) &&
+                          (memcmp(&slot->peerHash[0], &slot->cache.hash[0], DATABASE_HASH_LENGTH) == 0)) {
+                          slot->cacheHit = true;
+                          slot->characteristicHandleHTM = slot->cache.htmHandle;
+                          slot->characteristicHandle = slot->cache.buttonHandle;
+                          sc = sl_bt_gatt_set_characteristic_notification(slot->connection,
+                                                                          slot->characteristicHandleHTM,
+                                                                          sl_bt_gatt_indication);
+
+                          if (sc != SL_STATUS_OK) {
+                              LOG_ERROR("sl_bt_gatt_set_characteristic_notification() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+                          }
+                          displayPrintf(DISPLAY_ROW_CONNECTION, "Handling Indications");
+                          slot->discoveryState = State_6;
+                          break;
+                      }
+
+                      LOG_INFO("discovery: database of connection %u changed, rediscovering\r\n",
+                               (unsigned int) slot->connection);
+                      discovery_cache_forget(&slot->address);
+                      start_full_discovery(slot);
+                  }
+                break;
+        case State_9:
+                slot->discoveryState = State_9; // default
+                /*
+                 * if event is sl_bt_evt_gatt_procedure_completed_id,
+                 *  - call API sl_bt_gatt_discover_primary_services_by_uuid()
+                 *    for the Generic Attribute service
+                 */
+                  if (SL_BT_MSG_ID(evt->header) == sl_bt_evt_gatt_procedure_completed_id) {
+                      slot->serviceHandle = 0;
+                      sc = sl_bt_gatt_discover_primary_services_by_uuid(slot->connection,
+                                                                        sizeof(gatt_service),
+                                                                        (const uint8_t*)&gatt_service[0]);
+
+                      if (sc != SL_STATUS_OK) {
+                          LOG_ERROR("sl_bt_gatt_discover_primary_services_by_uuid() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+                      }
+                      slot->discoveryState = State_10;
+                  }
+                break;
+        case State_10:
+                slot->discoveryState = State_10; // default
+                /*
+                 * if event is sl_bt_evt_gatt_procedure_completed_id,
+                 *  - call API sl_bt_gatt_discover_characteristics_by_uuid()
+                 *    for the Database Hash characteristic
+                 */
+                  if (SL_BT_MSG_ID(evt->header) == sl_bt_evt_gatt_procedure_completed_id) {
+                      if (slot->serviceHandle == 0) {
+                          slot->discoveryState = State_7;
+                          break;
+                      }
+                      slot->characteristicHandle = 0;
+                      sc = sl_bt_gatt_discover_characteristics_by_uuid(slot->connection,
+                                                                       slot->serviceHandle,
+                                                                       sizeof(database_hash_char),
+                                                                       (const uint8_t*) &database_hash_char[0]);
+
+                      if (sc != SL_STATUS_OK) {
+                          LOG_ERROR("sl_bt_gatt_discover_characteristics_by_uuid() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+                      }
+                      slot->discoveryState = State_11;
+                  }
+                break;
+        case State_11:
+                slot->discoveryState = State_11; // default
+                /*
+                 * if event is sl_bt_evt_gatt_procedure_completed_id,
+                 *  - Save the Database Hash characteristic handle
+                 *  - call API sl_bt_gatt_read_characteristic_value() for it
+                 */
+                  if (SL_BT_MSG_ID(evt->header) == sl_bt_evt_gatt_procedure_completed_id) {
+                      if (slot->characteristicHandle == 0) {
+                          slot->discoveryState = State_7;
+                          break;
+                      }
+                      slot->cache.hashHandle = slot->characteristicHandle;
+                      slot->peerHashValid = false;
+                      sc = sl_bt_gatt_read_characteristic_value(slot->connection,
+                                                                slot->cache.hashHandle);
+
+                      if (sc != SL_STATUS_OK) {
+                          LOG_ERROR("sl_bt_gatt_read_characteristic_value() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+                      }
+                      slot->discoveryState = State_12;
+                  }
+                break;
+        case State_12:
+                slot->discoveryState = State_12; // default
+                /*
+                 * if event is sl_bt_evt_gatt_procedure_completed_id,
+                 *  - store the handles found and the Database Hash in the
+                 *    discovery cache
+                 */
+                  if (SL_BT_MSG_ID(evt->header) == sl_bt_evt_gatt_procedure_completed_id) {
+                      if (slot->peerHashValid == true) {
+                          slot->cache.address = slot->address;
+                          memcpy(&slot->cache.hash[0], &slot->peerHash[0], DATABASE_HASH_LENGTH);
+                          slot->cache.htmHandle = slot->characteristicHandleHTM;
+                          slot->cache.buttonHandle = slot->characteristicHandleButton;
+                          discovery_cache_store(&slot->cache);
+                      }
+                      slot->discoveryState = State_7;
+                  }
+                break;
 
     }
 }
@@ -24,6 +24,9 @@
 #define EVENT_I2C_TRANSFER_COMPLETE 2
 #define EVENT_NONE 3
 
+#define LETIMERUF_BIT_POS 0
+#define LETIMERCOMP1_BIT_POS 1
+#define I2C_TRANSFER_COMPLETE_BIT_POS 2
 #define PB0_BIT_POS 4
 #define PB1_BIT_POS 5
 
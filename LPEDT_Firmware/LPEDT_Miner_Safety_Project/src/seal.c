@@ -0,0 +1,276 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    seal.c
+ * @brief   AES-CCM seals over journal pages on the CRYPTO peripheral
+ *
+ *          The seal goes straight to the CCM transparent driver of the SDK.
+ *          It runs the whole CBC-MAC and the tag encryption inside CRYPTO,
+ *          words are fed by the CRYPTO sequencer, and the CPU only waits, so
+ *          a 2 KB page costs one short burst of EM0 instead of a software
+ *          AES per block. The records are authenticated only: investigators
+ *          need to read them without the key, they need to know that
+ *          nothing was changed.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include <string.h>
+
+#include "em_device.h"
+#include "psa/crypto.h"
+#include "sli_crypto_transparent_functions.h"
+#include "seal.h"
+#include "fwupdate.h"
+#include "ble_device_type.h"
+
+// Include logging for this file
+#define INCLUDE_LOG_DEBUG 1
+#include "log.h"
+
+#if BUILD_INCLUDES_BLE_SERVER == 1
+
+static bool    keyLoaded = false;
+static uint8_t key[SEAL_KEY_SIZE];
+
+/**
+ * @brief   Reads a little endian u32
+ * @param   p   first byte
+ * @return  value
+ */
+static uint32_t get_u32(const uint8_t *p) {
+  return ((uint32_t) p[0]) | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+#if SEAL_BENCHMARK == 1
+/**
+ * @brief   Starts the cycle counter on the first call
+ * @return  current cycle count
+ */
+static uint32_t seal_cycles(void) {
+  if((DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk) == 0){
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  }
+
+  return DWT->CYCCNT;
+}
+
+/**
+ * @brief   Encrypts one AES block through the ECB mode of the CRYPTO driver
+ * @param   attributes  AES-128 key attributes
+ * @param   in          16 bytes
+ * @param   out         written with 16 bytes
+ * @return  PSA status
+ */
+static psa_status_t seal_block(const psa_key_attributes_t *attributes, const uint8_t *in, uint8_t *out) {
+  size_t outLen;
+
+  return sli_crypto_transparent_cipher_encrypt(attributes, &key[0], SEAL_KEY_SIZE,
+                                               PSA_ALG_ECB_NO_PADDING, in, 16, out, 16, &outLen);
+}
+
+/**
+ * @brief   Computes the CCM tag of seal_compute() with the CCM mode on the
+ *          CPU and one CRYPTO call per AES block, the way a software CCM
+ *          over the accelerated AES of this device runs
+ * @param   nonce   SEAL_NONCE_SIZE bytes
+ * @param   data    authenticated bytes, fewer than 0xFF00
+ * @param   len     number of bytes
+ * @param   tag     written with SEAL_TAG_SIZE bytes
+ * @return  PSA status
+ */
+static psa_status_t seal_compute_blocks(const uint8_t *nonce, const uint8_t *data, uint32_t len, uint8_t *tag) {
+  psa_key_attributes_t attributes = psa_key_attributes_init();
+  psa_status_t         status;
+  uint8_t              block[16];
+  uint8_t              x[16];
+  uint8_t              s0[16];
+  uint32_t             i = 0;
+  uint32_t             j = 2;
+
+  psa_set_key_type(&attributes, PSA_KEY_TYPE_AES);
+  psa_set_key_bits(&attributes, SEAL_KEY_SIZE * 8);
+
+  // B0: additional data, tag of 16, 2 byte length of no payload
+  memset(&block[0], 0, sizeof(block));
+  block[0] = 0x40 | (((SEAL_TAG_SIZE - 2) / 2) << 3) | (15 - SEAL_NONCE_SIZE - 1);
+  memcpy(&block[1], nonce, SEAL_NONCE_SIZE);
+  status = seal_block(&attributes, &block[0], &x[0]);
+
+  // CBC-MAC over the 2 byte length and the data, zero padded
+  block[0] = (uint8_t) (len >> 8);
+  block[1] = (uint8_t) len;
+  while((status == PSA_SUCCESS) && (i < len)){
+    for(; (j < 16) && (i < len); j++)
+      block[j] = data[i++];
+    for(; j < 16; j++)
+      block[j] = 0;
+    for(j = 0; j < 16; j++)
+      block[j] ^= x[j];
+    status = seal_block(&attributes, &block[0], &x[0]);
+    j = 0;
+  }
+
+  // A0 encrypts the MAC into the tag
+  memset(&block[0], 0, sizeof(block));
+  block[0] = 15 - SEAL_NONCE_SIZE - 1;
+  memcpy(&block[1], nonce, SEAL_NONCE_SIZE);
+  if(status == PSA_SUCCESS)
+    status = seal_block(&attributes, &block[0], &s0[0]);
+
+  for(j = 0; j < SEAL_TAG_SIZE; j++)
+    tag[j] = x[j] ^ s0[j];
+
+  return status;
+}
+
+/**
+ * @brief   Seals the same page sized block of flash with the CCM driver of
+ *          the CRYPTO peripheral and with seal_compute_blocks(), and logs
+ *          the cycles of each
+ * @return  none
+ */
+static void seal_benchmark(void) {
+  const uint8_t *data = (const uint8_t *) FLASH_BASE;
+  uint32_t       len = FLASH_PAGE_SIZE - SEAL_SIZE;
+  uint8_t        nonce[SEAL_NONCE_SIZE];
+  uint8_t        hwTag[SEAL_TAG_SIZE];
+  uint8_t        swTag[SEAL_TAG_SIZE];
+  uint32_t       hwCycles;
+  uint32_t       swCycles;
+  uint32_t       start;
+  psa_status_t   status;
+
+  seal_nonce(&nonce[0], 0, 0, 0);
+
+  start = seal_cycles();
+  seal_compute(&nonce[0], data, len, &hwTag[0]);
+  hwCycles = seal_cycles() - start;
+
+  start = seal_cycles();
+  status = seal_compute_blocks(&nonce[0], data, len, &swTag[0]);
+  swCycles = seal_cycles() - start;
+
+  if(status != PSA_SUCCESS){
+      LOG_ERROR("sli_crypto_transparent_cipher_encrypt() returned != 0 status=0x%04x\r\n", (unsigned int) status);
+      return;
+  }
+
+  LOG_INFO("seal: %u bytes, CCM driver %u cycles, per block %u cycles, tags %s\r\n",
+           (unsigned int) len, (unsigned int) hwCycles, (unsigned int) swCycles,
+           (memcmp(&hwTag[0], &swTag[0], SEAL_TAG_SIZE) == 0) ? "match" : "DIFFER");
+}
+#endif
+
+/**
+ * @brief   Loads the key from the user data page
+ * @return  false if the key is present, true if pages stay unsealed
+ */
+bool seal_init(void) {
+  const uint8_t *rec = (const uint8_t *) SEAL_KEY_ADDR;
+  uint32_t       crc;
+
+  keyLoaded = false;
+  if(SEAL_ENABLE == 0)
+    return true;
+
+  crc = fwupdate_crc32_update(0xFFFFFFFF, rec, 4 + SEAL_KEY_SIZE) ^ 0xFFFFFFFF;
+  if((get_u32(&rec[0]) != SEAL_KEY_MAGIC) || (get_u32(&rec[4 + SEAL_KEY_SIZE]) != crc)){
+    LOG_INFO("seal: no key provisioned, journal pages are not sealed\r\n");
+    return true;
+  }
+
+  memcpy(&key[0], &rec[4], SEAL_KEY_SIZE);
+  keyLoaded = true;
+
+#if SEAL_BENCHMARK == 1
+  seal_benchmark();
+#endif
+
+  return false;
+
+} // seal_init()
+
+/**
+ * @brief   Returns whether seals can be computed
+ * @return  true if a key was loaded
+ */
+bool seal_ready(void) {
+
+  return keyLoaded;
+
+} // seal_ready()
+
+/**
+ * @brief   Builds the nonce of a page seal
+ * @param   nonce       written with SEAL_NONCE_SIZE bytes
+ * @param   seq         page sequence number
+ * @param   boot        boot number of the page
+ * @param   records     number of sealed records
+ * @return  none
+ */
+void seal_nonce(uint8_t *nonce, uint32_t seq, uint16_t boot, uint16_t records) {
+  uint32_t uniqueL = DEVINFO->UNIQUEL;
+
+  nonce[0] = (uint8_t) seq;
+  nonce[1] = (uint8_t) (seq >> 8);
+  nonce[2] = (uint8_t) (seq >> 16);
+  nonce[3] = (uint8_t) (seq >> 24);
+  nonce[4] = (uint8_t) boot;
+  nonce[5] = (uint8_t) (boot >> 8);
+  nonce[6] = (uint8_t) records;
+  nonce[7] = (uint8_t) (records >> 8);
+  nonce[8] = (uint8_t) uniqueL;
+  nonce[9] = (uint8_t) (uniqueL >> 8);
+  nonce[10] = (uint8_t) (uniqueL >> 16);
+  nonce[11] = (uint8_t) (uniqueL >> 24);
+  nonce[12] = (uint8_t) DEVINFO->UNIQUEH;
+
+} // seal_nonce()
+
+/**
+ * @brief   Computes the CCM tag over data on the CRYPTO peripheral
+ * @param   nonce   SEAL_NONCE_SIZE bytes
+ * @param   data    authenticated bytes
+ * @param   len     number of bytes
+ * @param   tag     written with SEAL_TAG_SIZE bytes
+ * @return  false if successful, true on error or without a key
+ */
+bool seal_compute(const uint8_t *nonce, const uint8_t *data, uint32_t len, uint8_t *tag) {
+  psa_key_attributes_t attributes = psa_key_attributes_init();
+  psa_status_t         status;
+  size_t               tagLen = 0;
+  uint8_t              none = 0;
+
+  if(keyLoaded == false)
+    return true;
+
+  psa_set_key_type(&attributes, PSA_KEY_TYPE_AES);
+  psa_set_key_bits(&attributes, SEAL_KEY_SIZE * 8);
+
+  // No payload, the page is the additional data, the output is the tag
+  status = sli_crypto_transparent_aead_encrypt(&attributes, &key[0], SEAL_KEY_SIZE,
+                                               PSA_ALG_CCM, nonce, SEAL_NONCE_SIZE,
+                                               data, len, &none, 0,
+                                               tag, SEAL_TAG_SIZE, &tagLen);
+  if((status != PSA_SUCCESS) || (tagLen != SEAL_TAG_SIZE)){
+      LOG_ERROR("sli_crypto_transparent_aead_encrypt() returned != 0 status=0x%04x\r\n", (unsigned int) status);
+      return true;
+  }
+
+  return false;
+
+} // seal_compute()
+
+#endif
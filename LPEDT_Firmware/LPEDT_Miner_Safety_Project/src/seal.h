@@ -0,0 +1,92 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    seal.h
+ * @brief   Header file for seal.c. AES-CCM seals over journal pages, computed
+ *          by the CRYPTO peripheral, so that a flash dump shows whether any
+ *          record was changed after the page was closed
+ *
+ *          Key record, provisioned per helmet in the user data page at
+ *          SEAL_KEY_ADDR, after the manufacturing tokens:
+ *            [0..3]   SEAL_KEY_MAGIC
+ *            [4..19]  AES-128 key
+ *            [20..23] CRC-32 of bytes 0..19
+ *          The page is then write locked through its lock word and the
+ *          device debug locked, so the key can be neither replaced nor read
+ *          back. The key list stays with whoever investigates incidents.
+ *
+ *          Seal of a page, SEAL_SIZE bytes at its end:
+ *            [0..15]  CCM tag, nonce from seal_nonce(), no payload, the page
+ *                     header and the sealed records as additional data
+ *            [16..19] number of sealed records
+ *            [20..23] SEAL_MAGIC, written last
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#ifndef SRC_SEAL_H_
+#define SRC_SEAL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// 1 -> closed journal pages are sealed when the helmet holds a key
+#define SEAL_ENABLE                  1
+
+// 1 -> seal_init() times the CCM driver against CCM over single AES blocks
+//      on one page
+#define SEAL_BENCHMARK               0
+
+#define SEAL_KEY_ADDR                (USERDATA_BASE + 0x600)
+#define SEAL_KEY_MAGIC               (0x4B4C5353UL)   // "SSLK"
+#define SEAL_KEY_SIZE                (16)
+
+#define SEAL_TAG_SIZE                (16)
+#define SEAL_NONCE_SIZE              (13)
+#define SEAL_SIZE                    (SEAL_TAG_SIZE + 8)
+#define SEAL_MAGIC                   (0x4C414553UL)   // "SEAL"
+
+/**
+ * @brief   Loads the key from the user data page
+ * @return  false if the key is present, true if pages stay unsealed
+ */
+bool seal_init(void);
+
+/**
+ * @brief   Returns whether seals can be computed
+ * @return  true if a key was loaded
+ */
+bool seal_ready(void);
+
+/**
+ * @brief   Builds the nonce of a page seal: the page sequence number, the
+ *          boot number, the record count and 5 bytes of the unique ID of
+ *          the chip, all little endian
+ * @param   nonce       written with SEAL_NONCE_SIZE bytes
+ * @param   seq         page sequence number
+ * @param   boot        boot number of the page
+ * @param   records     number of sealed records
+ * @return  none
+ */
+void seal_nonce(uint8_t *nonce, uint32_t seq, uint16_t boot, uint16_t records);
+
+/**
+ * @brief   Computes the CCM tag over data on the CRYPTO peripheral
+ * @param   nonce   SEAL_NONCE_SIZE bytes
+ * @param   data    authenticated bytes
+ * @param   len     number of bytes
+ * @param   tag     written with SEAL_TAG_SIZE bytes
+ * @return  false if successful, true on error or without a key
+ */
+bool seal_compute(const uint8_t *nonce, const uint8_t *data, uint32_t len, uint8_t *tag);
+
+#endif /* SRC_SEAL_H_ */
@@ -0,0 +1,272 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    stream.c
+ * @brief   Reliable streaming over notifications with a sliding window and
+ *          application level acknowledgements
+ *
+ *          Unlike indications, which allow a single PDU in flight, up to
+ *          'window' sequence numbered notifications are sent back to back.
+ *          Every packet is retained in slots[] until the client acknowledges
+ *          it with a cumulative ACK on Stream Control. A NAK, or no progress
+ *          for a whole retransmission tick, makes the stream go back to the
+ *          oldest unacknowledged packet (go-back-N).
+ *
+ *          Sequence numbers are uint8_t and all comparisons are done on the
+ *          mod 256 distance from baseSeq:
+ *            baseSeq  <= nextSeq <= sentSeq <= writeSeq
+ *            [baseSeq, sentSeq)   sent, not yet acknowledged
+ *            [nextSeq, writeSeq)  to be sent (again)
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include <string.h>
+
+#include "stream.h"
+#include "ble.h"
+#include "connparams.h"
+#include "alarm.h"
+
+// Include logging for this file
+#define INCLUDE_LOG_DEBUG 1
+#include "log.h"
+
+typedef struct {
+  uint16_t len;                       // bytes in data[], header included
+  uint8_t  data[MAX_BUFFER_LENGTH];   // sequence number followed by the payload
+} stream_slot_t;
+
+static stream_slot_t slots[STREAM_RETAIN_DEPTH];
+
+static uint8_t  baseSeq = 0;    // oldest unacknowledged
+static uint8_t  nextSeq = 0;    // next to send
+static uint8_t  sentSeq = 0;    // one past the highest sequence number sent
+static uint8_t  writeSeq = 0;   // next to be queued
+static uint8_t  window = STREAM_DEFAULT_WINDOW;
+
+static bool     ackSinceLastTick = false;
+static bool     retransmitTimerRunning = false;
+static uint32_t retransmissions = 0;
+
+// mod 256 distance from baseSeq
+#define SEQ_OFFSET(seq)  ((uint8_t) ((seq) - baseSeq))
+
+/**
+ * @brief   Starts or stops the SOFT_TIMER_2 retransmission timer
+ * @param   run   true to start the timer, false to stop it
+ * @return  none
+ */
+static void set_retransmit_timer(bool run) {
+  sl_status_t sc;
+
+  if(run == retransmitTimerRunning)
+    return;
+
+  // a timeout of 0 stops the soft timer
+  sc = sl_bt_system_set_soft_timer((run ? SOFT_TIMER_TICK_VALUE_500ms : 0), SOFT_TIMER_2, false);
+  if(sc != SL_STATUS_OK){
+      LOG_ERROR("sl_bt_system_set_soft_timer() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+      return;
+  }
+
+  retransmitTimerRunning = run;
+  ackSinceLastTick = false;
+}
+
+/**
+ * @brief   Returns whether the client is subscribed to Stream Data
+ * @return  true if payloads written now will be delivered
+ */
+bool stream_is_active(void) {
+  ble_data_struct_t *ble_data = get_ble_data_ptr();
+
+  return ((ble_data->connection_open == true) &&
+          (ble_data->ok_to_send_stream_notifications == true));
+
+} // stream_is_active()
+
+/**
+ * @brief   Returns how many more payloads stream_write() takes now
+ * @return  free retain slots
+ */
+uint32_t stream_free_slots(void) {
+
+  return STREAM_RETAIN_DEPTH - SEQ_OFFSET(writeSeq);
+
+} // stream_free_slots()
+
+/**
+ * @brief   Returns whether the client acknowledged every payload written
+ * @return  true if nothing waits for an acknowledgement
+ */
+bool stream_all_acked(void) {
+
+  return (baseSeq == writeSeq);
+
+} // stream_all_acked()
+
+/**
+ * @brief   Drops every retained packet and restarts the sequence numbers at 0
+ * @return  none
+ */
+void stream_reset(void) {
+
+  baseSeq = 0;
+  nextSeq = 0;
+  sentSeq = 0;
+  writeSeq = 0;
+  window = STREAM_DEFAULT_WINDOW;
+  set_retransmit_timer(false);
+  connparams_set_demand(CONN_DEMAND_BULK, false);
+
+} // stream_reset()
+
+/**
+ * @brief   Sends queued packets while the window and the stack allow. When
+ *          the stack runs out of buffers the rest is sent on the next ACK or
+ *          retransmission tick.
+ * @return  none
+ */
+void stream_pump(void) {
+  sl_status_t        sc;
+  ble_data_struct_t *ble_data = get_ble_data_ptr();
+  stream_slot_t     *slot;
+
+  // Nothing joins the link layer queue ahead of an alarm indication
+  while((stream_is_active() == true) &&
+        (alarm_link_reserved() == false) &&
+        (nextSeq != writeSeq) &&
+        (SEQ_OFFSET(nextSeq) < window)){
+
+    slot = &slots[nextSeq % STREAM_RETAIN_DEPTH];
+    sc = sl_bt_gatt_server_send_notification(
+          ble_data->connectionHandle,
+          gattdb_stream_data,
+          slot->len,
+          &slot->data[0]
+         );
+    if (sc != SL_STATUS_OK) {
+        if (sc != SL_STATUS_NO_MORE_RESOURCE) {
+            LOG_ERROR("sl_bt_gatt_server_send_notification() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+        }
+        break;
+    }
+
+    if(SEQ_OFFSET(nextSeq) < SEQ_OFFSET(sentSeq))
+      retransmissions++;
+
+    nextSeq++;
+    if(SEQ_OFFSET(nextSeq) > SEQ_OFFSET(sentSeq))
+      sentSeq = nextSeq;
+  }
+
+  // Only needed while something waits for an acknowledgement
+  set_retransmit_timer((stream_is_active() == true) && (baseSeq != writeSeq));
+
+  // A transfer in progress asks for the short connection interval
+  connparams_set_demand(CONN_DEMAND_BULK, (stream_is_active() == true) && (baseSeq != writeSeq));
+
+} // stream_pump()
+
+/**
+ * @brief   Queues a payload on the stream and sends it if the window allows
+ * @param   data    payload
+ * @param   len     payload length, 1 to the ATT payload size - STREAM_HEADER_SIZE
+ * @return  false if successful, true if all STREAM_RETAIN_DEPTH slots are
+ *          taken or len is invalid
+ */
+bool stream_write(const uint8_t *data, uint32_t len) {
+  stream_slot_t *slot;
+
+  if(stream_is_active() == false)
+    return true;
+
+  if((len < 1) || (len + STREAM_HEADER_SIZE > get_ble_data_ptr()->attPayloadSize))
+    return true;
+
+  if(SEQ_OFFSET(writeSeq) >= STREAM_RETAIN_DEPTH)
+    return true;
+
+  slot = &slots[writeSeq % STREAM_RETAIN_DEPTH];
+  slot->data[0] = writeSeq;
+  memcpy(&slot->data[STREAM_HEADER_SIZE], data, len);
+  slot->len = len + STREAM_HEADER_SIZE;
+  writeSeq++;
+
+  stream_pump();
+
+  return false;
+
+} // stream_write()
+
+/**
+ * @brief   Handles a write to the Stream Control characteristic
+ * @param   data    value written by the client
+ * @param   len     number of bytes written
+ * @return  none
+ */
+void stream_handle_control(const uint8_t *data, uint32_t len) {
+  uint8_t acked;
+
+  if(len < 2)
+    return;
+
+  switch(data[0]){
+    case STREAM_OP_ACK:
+    case STREAM_OP_NAK:
+      // Acknowledging something that was never sent is a client error
+      acked = SEQ_OFFSET(data[1]);
+      if(acked > SEQ_OFFSET(sentSeq))
+        break;
+
+      if(acked > 0)
+        ackSinceLastTick = true;
+
+      baseSeq = data[1];
+      if((SEQ_OFFSET(nextSeq) > SEQ_OFFSET(sentSeq)) || (data[0] == STREAM_OP_NAK))
+        nextSeq = baseSeq;
+      break;
+
+    case STREAM_OP_WINDOW:
+      window = data[1];
+      if(window < 1)
+        window = 1;
+      if(window > STREAM_RETAIN_DEPTH)
+        window = STREAM_RETAIN_DEPTH;
+      break;
+
+    default:
+      break;
+  }
+
+  stream_pump();
+
+} // stream_handle_control()
+
+/**
+ * @brief   Retransmission timer, resends the whole window if the client has
+ *          not acknowledged anything since the previous tick
+ * @return  none
+ */
+void stream_retransmit_tick(void) {
+
+  if((ackSinceLastTick == false) && (baseSeq != sentSeq)){
+    LOG_INFO("stream: no ACK, resending from %u (%u retransmitted so far)\r\n",
+             (unsigned int) baseSeq, (unsigned int) retransmissions);
+    nextSeq = baseSeq;
+  }
+
+  ackSinceLastTick = false;
+  stream_pump();
+
+} // stream_retransmit_tick()
@@ -0,0 +1,107 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    stream.h
+ * @brief   Header file for stream.c. Reliable streaming over notifications
+ *          with a sliding window and application level acknowledgements
+ *
+ *          Stream Data notification:
+ *            [0]      sequence number, mod 256
+ *            [1..]    payload
+ *
+ *          Stream Control writes from the client:
+ *            STREAM_OP_ACK    [next expected sequence number]
+ *                             everything before it was received
+ *            STREAM_OP_NAK    [next expected sequence number]
+ *                             same as ACK, and a later packet arrived, so
+ *                             resend everything from that sequence number
+ *            STREAM_OP_WINDOW [window]
+ *                             packets allowed in flight, 1 to
+ *                             STREAM_RETAIN_DEPTH
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#ifndef SRC_STREAM_H_
+#define SRC_STREAM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define STREAM_HEADER_SIZE      (1)
+
+// Packets kept until acknowledged, sent or not. Must divide 256.
+#define STREAM_RETAIN_DEPTH     (8)
+#define STREAM_DEFAULT_WINDOW   (4)
+
+// Control opcodes, first byte of a Stream Control write
+#define STREAM_OP_ACK           (0x01)
+#define STREAM_OP_NAK           (0x02)
+#define STREAM_OP_WINDOW        (0x03)
+
+/**
+ * @brief   Drops every retained packet and restarts the sequence numbers at
+ *          0, call on connection open and close and when the client
+ *          (un)subscribes
+ * @return  none
+ */
+void stream_reset(void);
+
+/**
+ * @brief   Queues a payload on the stream and sends it if the window allows
+ * @param   data    payload
+ * @param   len     payload length, 1 to the ATT payload size - STREAM_HEADER_SIZE
+ * @return  false if successful, true if all STREAM_RETAIN_DEPTH slots are
+ *          taken or len is invalid
+ */
+bool stream_write(const uint8_t *data, uint32_t len);
+
+/**
+ * @brief   Sends queued packets while the window and the stack allow
+ * @return  none
+ */
+void stream_pump(void);
+
+/**
+ * @brief   Handles a write to the Stream Control characteristic
+ * @param   data    value written by the client
+ * @param   len     number of bytes written
+ * @return  none
+ */
+void stream_handle_control(const uint8_t *data, uint32_t len);
+
+/**
+ * @brief   Retransmission timer, resends the whole window if the client has
+ *          not acknowledged anything since the previous tick
+ * @return  none
+ */
+void stream_retransmit_tick(void);
+
+/**
+ * @brief   Returns whether the client is subscribed to Stream Data
+ * @return  true if payloads written now will be delivered
+ */
+bool stream_is_active(void);
+
+/**
+ * @brief   Returns how many more payloads stream_write() takes now
+ * @return  free retain slots
+ */
+uint32_t stream_free_slots(void);
+
+/**
+ * @brief   Returns whether the client acknowledged every payload written
+ * @return  true if nothing waits for an acknowledgement
+ */
+bool stream_all_acked(void);
+
+#endif /* SRC_STREAM_H_ */
@@ -0,0 +1,306 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    telemetry.c
+ * @brief   Batches timestamped sensor samples into Bulk Telemetry
+ *          notifications
+ *
+ *          Samples of every sensor go into one batch that is as large as the
+ *          ATT payload of the connection, so that many samples share a single
+ *          packet and connection event instead of one indication each.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include <string.h>
+
+#include "sl_sleeptimer.h"
+#include "telemetry.h"
+#include "tscodec.h"
+#include "stream.h"
+#include "journal.h"
+#include "ble.h"
+#include "ble_device_type.h"
+
+// Include logging for this file
+#define INCLUDE_LOG_DEBUG 1
+#include "log.h"
+
+// open batch, the sequence number followed by a codec block
+static uint8_t  batch[MAX_BUFFER_LENGTH];
+static tscodec_block_t block;
+static uint32_t batchLength = 0;
+static uint32_t batchStartMs = 0;
+static uint32_t batchCapacity = 0;
+static uint8_t  batchSeq = 0;
+
+// throughput counters
+static telemetry_stats_t stats;
+static uint32_t windowStartMs = 0;
+static uint32_t windowBytes = 0;
+static uint32_t windowPackets = 0;
+
+/**
+ * @brief   Returns the time since boot in ms
+ * @return  ms since boot, wraps after ~49 days
+ */
+static uint32_t telemetry_now_ms(void) {
+  uint64_t ms = 0;
+
+  sl_sleeptimer_tick64_to_ms(sl_sleeptimer_get_tick_count64(), &ms);
+
+  return (uint32_t) ms;
+}
+
+/**
+ * @brief   Returns whether a client takes telemetry, over the reliable stream
+ *          or over plain Bulk Telemetry notifications
+ * @return  true if samples are collected
+ */
+static bool telemetry_enabled(void) {
+  ble_data_struct_t *ble_data = get_ble_data_ptr();
+
+  return ((stream_is_active() == true) ||
+          ((ble_data->connection_open == true) &&
+           (ble_data->ok_to_send_telemetry_notifications == true)));
+}
+
+/**
+ * @brief   Returns the largest batch that fits in one packet
+ * @return  batch size in bytes
+ */
+static uint32_t telemetry_capacity(void) {
+  uint32_t capacity = get_ble_data_ptr()->attPayloadSize;
+
+  // the stream puts its sequence number in front of the batch
+  if(stream_is_active() == true)
+    capacity -= STREAM_HEADER_SIZE;
+
+  return capacity;
+}
+
+/**
+ * @brief   Accounts for a sent notification and closes the stats window once
+ *          it is TELEMETRY_STATS_WINDOW_MS long
+ * @param   len   bytes in the notification
+ * @return  none
+ */
+static void telemetry_count_packet(uint32_t len) {
+  ble_data_struct_t *ble_data = get_ble_data_ptr();
+  uint32_t           now = telemetry_now_ms();
+  uint32_t           elapsed;
+  tscodec_stats_t    codec;
+
+  stats.packetsSent++;
+  stats.bytesSent += len;
+  windowPackets++;
+  windowBytes += len;
+
+  elapsed = now - windowStartMs;
+  if(elapsed < TELEMETRY_STATS_WINDOW_MS)
+    return;
+
+  stats.bytesPerSecond = (windowBytes * 1000) / elapsed;
+
+  // connection events in the window = elapsed / (interval * 1.25 ms)
+  stats.packetsPerEventX100 = (windowPackets * 100 * ble_data->connectionInterval * 5) /
+                              (elapsed * 4);
+
+  LOG_INFO("telemetry: %u B/s, %u.%02u packets/connection event\r\n",
+           (unsigned int) stats.bytesPerSecond,
+           (unsigned int) (stats.packetsPerEventX100 / 100),
+           (unsigned int) (stats.packetsPerEventX100 % 100));
+
+  tscodec_get_stats(&codec);
+  if(codec.samples != 0)
+    LOG_INFO("telemetry: codec %u.%02u:1, %u cycles/sample\r\n",
+             (unsigned int) (codec.rawBytes / codec.codedBytes),
+             (unsigned int) (((codec.rawBytes % codec.codedBytes) * 100) / codec.codedBytes),
+             (unsigned int) (codec.cycles / codec.samples)); // 0 unless TSCODEC_MEASURE_CYCLES
+
+  windowStartMs = now;
+  windowPackets = 0;
+  windowBytes = 0;
+}
+
+/**
+ * @brief   Opens a new batch as large as the connection allows
+ * @param   now     timestamp of the first sample
+ * @return  none
+ */
+static void telemetry_open_batch(uint32_t now) {
+
+  batchStartMs = now;
+  batchCapacity = telemetry_capacity();
+  batch[0] = batchSeq;
+  tscodec_begin(&block, &batch[1], batchCapacity - 1, now);
+  batchLength = TELEMETRY_HEADER_SIZE;
+}
+
+/**
+ * @brief   Hands the samples of the open batch to the journal, the client
+ *          did not take it
+ * @return  none
+ */
+static void telemetry_journal_batch(void) {
+#if BUILD_INCLUDES_BLE_SERVER == 1
+  tscodec_reader_t reader;
+  uint8_t          sensor;
+  uint32_t         ms;
+  int16_t          value;
+
+  tscodec_read_begin(&reader, &batch[1], batchLength - 1);
+  while(tscodec_read(&reader, &sensor, &ms, &value) == false)
+    journal_append_at((telemetry_sensor_t) sensor, ms, value);
+#endif
+}
+
+/**
+ * @brief   Journals the open batch and clears the counters
+ * @return  none
+ */
+void telemetry_reset(void) {
+
+  if(batchLength != 0)
+    telemetry_journal_batch();
+
+  batchLength = 0;
+  memset(&stats, 0, sizeof(stats));
+  windowStartMs = telemetry_now_ms();
+  windowBytes = 0;
+  windowPackets = 0;
+
+} // telemetry_reset()
+
+/**
+ * @brief   Sends the open batch, if it holds any samples. The reliable stream
+ *          is preferred when the client subscribed to it. The samples of a
+ *          batch that cannot be sent go to the journal.
+ * @return  none
+ */
+void telemetry_flush(void) {
+  sl_status_t        sc;
+  ble_data_struct_t *ble_data = get_ble_data_ptr();
+  bool               sent = false;
+
+  if(batchLength == 0)
+    return;
+
+  if(stream_is_active() == true){
+    if(stream_write(&batch[0], batchLength)){
+        LOG_ERROR("stream_write() failed, stream window stalled\r\n");
+    }
+    else{
+        telemetry_count_packet(batchLength);
+        sent = true;
+    }
+  }
+  else if((ble_data->connection_open == true) &&
+          (ble_data->ok_to_send_telemetry_notifications == true)){
+    sc = sl_bt_gatt_server_send_notification(
+          ble_data->connectionHandle,
+          gattdb_bulk_telemetry,
+          batchLength,
+          &batch[0]
+         );
+    if (sc != SL_STATUS_OK) {
+        LOG_ERROR("sl_bt_gatt_server_send_notification() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+    }
+    else{
+        telemetry_count_packet(batchLength);
+        sent = true;
+    }
+  }
+
+  if(sent == false){
+      stats.packetsDropped++;
+      telemetry_journal_batch();
+  }
+
+  batchSeq++;
+  batchLength = 0;
+
+} // telemetry_flush()
+
+/**
+ * @brief   Adds a sample to the open batch, sends the batch when it is full
+ *          or too old
+ * @param   sensor  source of the sample
+ * @param   value   sample value in the unit of the sensor
+ * @return  false if the sample was batched, true if the client is not
+ *          subscribed to Bulk Telemetry or Stream Data or the sample does
+ *          not fit a batch, the caller journals it then
+ */
+bool telemetry_add_sample(telemetry_sensor_t sensor, int16_t value) {
+  uint32_t           now = telemetry_now_ms();
+
+  if(telemetry_enabled() == false)
+    return true;
+
+  // Close the open batch if the packet size changed or the batch is too old
+  if((batchLength != 0) &&
+     ((batchCapacity != telemetry_capacity()) ||
+      (now - batchStartMs >= TELEMETRY_MAX_BATCH_AGE_MS))){
+    telemetry_flush();
+  }
+
+  if(batchLength == 0)
+    telemetry_open_batch(now);
+
+  // Samples take a varying number of bytes, send the batch once one does
+  // not fit and start the next batch with it
+  if(tscodec_add(&block, sensor, now, value)){
+    if(tscodec_count(&block) != 0){
+      telemetry_flush();
+      telemetry_open_batch(now);
+    }
+    // Not even an empty batch holds it, the caller journals it
+    if(tscodec_add(&block, sensor, now, value)){
+      LOG_ERROR("telemetry: sample of sensor %u does not fit a %u byte batch\r\n",
+                (unsigned int) sensor, (unsigned int) batchCapacity);
+      batchLength = 0;
+      return true;
+    }
+  }
+  batchLength = 1 + block.length;
+
+  // Send as soon as not even the smallest sample fits
+  if(batchLength >= batchCapacity)
+    telemetry_flush();
+
+  return false;
+
+} // telemetry_add_sample()
+
+/**
+ * @brief   1 s tick, sends the open batch once its first sample is
+ *          TELEMETRY_MAX_BATCH_AGE_MS old. With slow sampling the next
+ *          sample can be a minute away.
+ * @return  none
+ */
+void telemetry_tick(void) {
+
+  if((batchLength != 0) && (telemetry_now_ms() - batchStartMs >= TELEMETRY_MAX_BATCH_AGE_MS))
+    telemetry_flush();
+
+} // telemetry_tick()
+
+/**
+ * @brief   Returns the throughput counters
+ * @param   out     written with the current counters
+ * @return  none
+ */
+void telemetry_get_stats(telemetry_stats_t *out) {
+
+  *out = stats;
+
+} // telemetry_get_stats()
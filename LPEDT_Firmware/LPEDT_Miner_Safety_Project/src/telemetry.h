@@ -0,0 +1,97 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    telemetry.h
+ * @brief   Header file for telemetry.c. Batches timestamped sensor samples
+ *          into Bulk Telemetry notifications sized to the ATT payload of the
+ *          connection
+ *
+ *          Notification layout (little endian):
+ *            [0]      sequence number
+ *            [1..]    one block of samples, see tscodec.h
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#ifndef SRC_TELEMETRY_H_
+#define SRC_TELEMETRY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// sequence number and block header
+#define TELEMETRY_HEADER_SIZE       (6)
+
+// A batch is sent once it is full or its first sample is this old, must stay
+// below the 65535 ms an uncompressed sample timestamp can hold
+#define TELEMETRY_MAX_BATCH_AGE_MS  (30000)
+
+// Throughput counters are recomputed over windows of this length
+#define TELEMETRY_STATS_WINDOW_MS   (10000)
+
+typedef enum {
+  TELEMETRY_SENSOR_TEMPERATURE,  // 0.01 degC
+  TELEMETRY_SENSOR_BUTTON,       // 1 pressed, 0 released
+  TELEMETRY_SENSOR_ZONE,         // zone ID, -1 if unknown, see zone.h
+  TELEMETRY_SENSOR_BATTERY,      // mV, see battery.h
+  TELEMETRY_SENSOR_SOC,          // state of charge, %
+  TELEMETRY_NUMBER_OF_SENSORS
+} telemetry_sensor_t;
+
+typedef struct {
+  uint32_t bytesPerSecond;       // over the last complete window
+  uint32_t packetsPerEventX100;  // notifications per connection event * 100, last window
+  uint32_t packetsSent;          // since the connection opened
+  uint32_t bytesSent;            // since the connection opened
+  uint32_t packetsDropped;       // batches not sent, their samples were journaled
+} telemetry_stats_t;
+
+/**
+ * @brief   Journals the open batch and clears the counters, call on
+ *          connection open and close
+ * @return  none
+ */
+void telemetry_reset(void);
+
+/**
+ * @brief   Adds a sample to the open batch, sends the batch when it is full
+ *          or too old
+ * @param   sensor  source of the sample
+ * @param   value   sample value in the unit of the sensor
+ * @return  false if the sample was batched, true if the client is not
+ *          subscribed to Bulk Telemetry or Stream Data or the sample does
+ *          not fit a batch, the caller journals it then
+ */
+bool telemetry_add_sample(telemetry_sensor_t sensor, int16_t value);
+
+/**
+ * @brief   Sends the open batch, if it holds any samples. The samples of a
+ *          batch that cannot be sent go to the journal.
+ * @return  none
+ */
+void telemetry_flush(void);
+
+/**
+ * @brief   1 s tick, sends the open batch once its first sample is
+ *          TELEMETRY_MAX_BATCH_AGE_MS old
+ * @return  none
+ */
+void telemetry_tick(void);
+
+/**
+ * @brief   Returns the throughput counters
+ * @param   out     written with the current counters
+ * @return  none
+ */
+void telemetry_get_stats(telemetry_stats_t *out);
+
+#endif /* SRC_TELEMETRY_H_ */
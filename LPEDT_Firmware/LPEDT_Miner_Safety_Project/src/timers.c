@@ -28,23 +28,52 @@
 #define INCLUDE_LOG_DEBUG 1
 #include "src/log.h"
 
-#define LFXO_PRESCALER_VALUE (1)
+// COMP0 is 16 bits wide, LETIMER_PERIOD_MS at 32768Hz does not fit in it
+#define LFXO_PRESCALER_VALUE (4)
 #define ULFRCO_PRESCALER_VALUE (1)
 #define LFXO_CLK_FREQ (32768/LFXO_PRESCALER_VALUE)
 #define ULFRCO_CLK_FREQ (1000/ULFRCO_PRESCALER_VALUE)
 
-#define COMP0_LOAD_VAL_EM0 ((LETIMER_PERIOD_MS*LFXO_CLK_FREQ)/(1000))
-#define COMP0_LOAD_VAL_EM1 ((LETIMER_PERIOD_MS*LFXO_CLK_FREQ)/(1000))
-#define COMP0_LOAD_VAL_EM2 ((LETIMER_PERIOD_MS*LFXO_CLK_FREQ)/(1000))
-#define COMP0_LOAD_VAL_EM3 (((LETIMER_PERIOD_MS*ULFRCO_CLK_FREQ)/(1000)))
+// CNT reloads from COMP0 on the tick after it reached 0, a period is COMP0 + 1
+// ticks
+#define COMP0_LOAD_VAL(freq) (((LETIMER_PERIOD_MS*(freq))/(1000)) - 1)
+#define COMP1_LOAD_VAL(freq) ((LETIMER_ON_TIME_MS*(freq))/(1000))
 
-#define COMP1_LOAD_VAL_EM0 ((LETIMER_ON_TIME_MS*LFXO_CLK_FREQ)/(1000))
-#define COMP1_LOAD_VAL_EM1 ((LETIMER_ON_TIME_MS*LFXO_CLK_FREQ)/(1000))
-#define COMP1_LOAD_VAL_EM2 ((LETIMER_ON_TIME_MS*LFXO_CLK_FREQ)/(1000))
-#define COMP1_LOAD_VAL_EM3 (((LETIMER_ON_TIME_MS*ULFRCO_CLK_FREQ)/(1000)))
+// CRYOTIMER wakeup period is 2^PERIODSEL clock cycles, i.e. ~1s on either clock
+#define CRYOTIMER_PERIODSEL_LFXO   (15) // 32768 cycles @ 32768Hz = 1s
+#define CRYOTIMER_PERIODSEL_ULFRCO (10) // 1024 cycles @ 1000Hz = 1.024s
 
 uint32_t LETIMER0_Comp0_Load_Val = 0, LETIMER0_Comp1_Load_Val = 0;
 
+// Underflows between two sensor samples and underflows seen since the last one
+static uint32_t LETIMER0_Sample_Underflows = 1, LETIMER0_Underflows_Since_Sample = 0;
+
+// Clock LETIMER0 runs from at the moment, after the prescaler
+static uint32_t LETIMER0_Clock_Freq = LFXO_CLK_FREQ;
+
+/**
+ * @brief   Converts LETIMER0 ticks to milliseconds at the current clock
+ * @param   ticks   LETIMER0 ticks
+ * @return  ms, rounded down
+ */
+static uint32_t LETIMER0_Ticks_To_Ms(uint32_t ticks){
+  return (ticks * 1000) / LETIMER0_Clock_Freq;
+}
+
+/**
+ * @brief   Rescales a LETIMER0 count from the current clock to another one,
+ *          keeping the time from the count to the underflow: a count of n
+ *          underflows n + 1 ticks later
+ * @param   halfTicks   time to the underflow at the current clock, in half
+ *                      ticks
+ * @param   freq        the other clock, after the prescaler
+ * @return  count at the other clock, rounded to the nearest
+ */
+static uint32_t LETIMER0_Rescale(uint32_t halfTicks, uint32_t freq){
+  uint32_t ticks = ((halfTicks * freq) + LETIMER0_Clock_Freq) / (2 * LETIMER0_Clock_Freq);
+
+  return (ticks > 0) ? (ticks - 1) : 0;
+}
 
 /**
  * @brief   Sets the comp1 value in the LETIMER0 module
@@ -57,12 +86,101 @@ void LETIMER0_Set_Comp1(uint32_t load_value){
 }
 
 /**
- * @brief   Enables the LETIMER0 module based on the given energy mode
- * @param   nrg_mode   Energy mode in which the microcontroller is going to run
- *                     Accepted values: 0, 1, 2, 3
+ * @brief   Sets how often the sensors are sampled. LETIMER0 itself keeps its
+ *          LETIMER_PERIOD_MS period, timekeeping and the battery ADC trigger
+ *          depend on it, only every n-th underflow starts a sample.
+ * @param   period_ms  sampling period, rounded down to a multiple of
+ *                     LETIMER_PERIOD_MS, at least one period
  * @return  none
  */
-void LETIMER0_Enable(uint32_t nrg_mode){
+void LETIMER0_Set_Sample_Period(uint32_t period_ms){
+  LETIMER0_Sample_Underflows = period_ms / LETIMER_PERIOD_MS;
+  if(LETIMER0_Sample_Underflows == 0)
+    LETIMER0_Sample_Underflows = 1;
+}
+
+/**
+ * @brief   Counts an underflow of LETIMER0 towards the sampling period, call
+ *          once per underflow event
+ * @return  true if this underflow starts a sample
+ */
+bool LETIMER0_Sample_Due(void){
+  LETIMER0_Underflows_Since_Sample++;
+  if(LETIMER0_Underflows_Since_Sample < LETIMER0_Sample_Underflows)
+    return false;
+
+  LETIMER0_Underflows_Since_Sample = 0;
+  return true;
+}
+
+/**
+ * @brief   Returns how long until the next underflow that starts a sample
+ * @return  ms
+ */
+uint32_t LETIMER0_Ms_To_Next_Sample(void){
+  uint32_t underflows = 0;
+
+  if(LETIMER0_Underflows_Since_Sample + 1 < LETIMER0_Sample_Underflows)
+    underflows = LETIMER0_Sample_Underflows - LETIMER0_Underflows_Since_Sample - 1;
+
+  return (underflows * LETIMER_PERIOD_MS) + LETIMER0_Ticks_To_Ms(LETIMER_CounterGet(LETIMER0));
+}
+
+/**
+ * @brief   Returns how long until the next UF or COMP1 interrupt of LETIMER0
+ * @return  ms
+ */
+uint32_t LETIMER0_Ms_To_Next_Irq(void){
+  uint32_t ticks = LETIMER_CounterGet(LETIMER0);
+  uint32_t comp1 = LETIMER_CompareGet(LETIMER0, 1);
+
+  // The counter counts down, COMP1 comes first if it is below the counter
+  if(comp1 < ticks)
+    ticks -= comp1;
+
+  return LETIMER0_Ticks_To_Ms(ticks);
+}
+
+/**
+ * @brief   Moves LETIMER0 between the LFXO and the ULFRCO without losing its
+ *          phase: the counter and COMP1 are rescaled to the new clock, so the
+ *          next underflow and a pending timed wait stay where they were, to
+ *          one tick of the slower clock. The LFXO must be ready.
+ * @param   ulfrco  true for the ULFRCO, which keeps running in EM3
+ * @return  none
+ */
+void LETIMER0_Select_Clock(bool ulfrco){
+  uint32_t freq = ulfrco ? ULFRCO_CLK_FREQ : LFXO_CLK_FREQ;
+  uint32_t ticks, comp1;
+
+  if(freq == LETIMER0_Clock_Freq)
+    return;
+
+  LETIMER_Enable(LETIMER0, false);
+  // The counter is half way through its tick on average, the stopped timer
+  // starts the other clock on a whole one. COMP1 is a point of the period.
+  ticks = LETIMER0_Rescale((2 * LETIMER_CounterGet(LETIMER0)) + 1, freq);
+  comp1 = LETIMER0_Rescale((2 * LETIMER_CompareGet(LETIMER0, 1)) + 2, freq);
+
+  if(ulfrco)
+    LETIMER0_clk_Enable(EM3, ULFRCO_PRESCALER_VALUE);
+  else
+    LETIMER0_clk_Enable(EM2, LFXO_PRESCALER_VALUE);
+
+  LETIMER0_Clock_Freq = freq;
+  LETIMER0_Comp0_Load_Val = COMP0_LOAD_VAL(freq);
+  LETIMER_CompareSet(LETIMER0, 0, LETIMER0_Comp0_Load_Val);
+  LETIMER0_Set_Comp1(comp1);
+  LETIMER_CounterSet(LETIMER0, ticks);
+  LETIMER_Enable(LETIMER0, true);
+}
+
+/**
+ * @brief   Enables the LETIMER0 module on the LFXO, energy.c moves it to the
+ *          ULFRCO for the time spent in EM3
+ * @return  none
+ */
+void LETIMER0_Enable(void){
   uint32_t temp;
 
   LETIMER_Init_TypeDef letimerInitData = {
@@ -72,41 +190,21 @@ void LETIMER0_Enable(uint32_t nrg_mode){
     false, // bufTop; don't load COMP1 into COMP0 when REP0==0
     0, // out0Pol; 0 default output pin value
     0, // out1Pol; 0 default output pin value
-    letimerUFOANone, // ufoa0; no underflow output action
+    letimerUFOAPulse, // ufoa0; underflow pulse on PRS, triggers the battery ADC
     letimerUFOANone, // ufoa1; no underflow output action
     letimerRepeatFree, // repMode; free running mode i.e. load & go forever
     0 // COMP0(top) Value, I calculate this below
   };
 
-  // Choose the clock for LETIMER0 based on selected energy mode
-  if(nrg_mode == EM3){
-      LETIMER0_clk_Enable(nrg_mode,ULFRCO_PRESCALER_VALUE);
-  }
-  else{
-      LETIMER0_clk_Enable(nrg_mode,LFXO_PRESCALER_VALUE);
-  }
+  // LETIMER0 starts on the LFXO
+  LETIMER0_clk_Enable(EM2,LFXO_PRESCALER_VALUE);
+  LETIMER0_Clock_Freq = LFXO_CLK_FREQ;
 
   // init the timer
   LETIMER_Init (LETIMER0, &letimerInitData);
 
-  // Set the comp0 and comp1 values based on energy mode
-  switch(nrg_mode){
-        case EM0: LETIMER0_Comp0_Load_Val = COMP0_LOAD_VAL_EM0;
-                  LETIMER0_Comp1_Load_Val = COMP1_LOAD_VAL_EM0;
-                  break;
-        case EM1: LETIMER0_Comp0_Load_Val = COMP0_LOAD_VAL_EM1;
-                  LETIMER0_Comp1_Load_Val = COMP1_LOAD_VAL_EM1;
-                  break;
-        case EM2: LETIMER0_Comp0_Load_Val = COMP0_LOAD_VAL_EM2;
-                  LETIMER0_Comp1_Load_Val = COMP1_LOAD_VAL_EM2;
-                  break;
-        case EM3: LETIMER0_Comp0_Load_Val = COMP0_LOAD_VAL_EM3;
-                  LETIMER0_Comp1_Load_Val = COMP1_LOAD_VAL_EM3;
-                  break;
-        default:  LETIMER0_Comp0_Load_Val = COMP0_LOAD_VAL_EM0;
-                  LETIMER0_Comp1_Load_Val = COMP1_LOAD_VAL_EM0;
-                  break;
-      }
+  LETIMER0_Comp0_Load_Val = COMP0_LOAD_VAL(LFXO_CLK_FREQ);
+  LETIMER0_Comp1_Load_Val = COMP1_LOAD_VAL(LFXO_CLK_FREQ);
 
   LETIMER_CompareSet(LETIMER0, 0, LETIMER0_Comp0_Load_Val);
 //  LETIMER0_Set_Comp1(LETIMER0_Comp1_Load_Val);
@@ -123,6 +221,30 @@ void LETIMER0_Enable(uint32_t nrg_mode){
   LETIMER_Enable (LETIMER0, true);
 }
 
+/**
+ * @brief   Starts the CRYOTIMER with a ~1s period. Its PRS output is a one
+ *          clock wide pulse at every period, which is used as the LCD
+ *          EXTCOMIN signal. No interrupt is enabled, the CPU is never woken.
+ * @param   nrg_mode   Energy mode in which the microcontroller is going to run
+ *                     Accepted values: 0, 1, 2, 3
+ * @return  none
+ */
+void CRYOTIMER_Enable(uint32_t nrg_mode){
+  uint32_t oscsel = CRYOTIMER_clk_Enable(nrg_mode);
+
+  // Configuration can only be changed while the timer is disabled
+  CRYOTIMER->CTRL = 0;
+  CRYOTIMER->PERIODSEL = (nrg_mode == EM3) ? CRYOTIMER_PERIODSEL_ULFRCO
+                                           : CRYOTIMER_PERIODSEL_LFXO;
+  CRYOTIMER->IEN = 0;
+  CRYOTIMER->EM4WUEN = 0;
+
+  CRYOTIMER->CTRL = oscsel
+                  | CRYOTIMER_CTRL_PRESC_DIV1
+                  | CRYOTIMER_CTRL_DEBUGRUN
+                  | CRYOTIMER_CTRL_EN;
+}
+
 /**
  * @brief   Provides a blocking delay of atleast us_wait micro-seconds based on
  *          the LETIMER0 ticks
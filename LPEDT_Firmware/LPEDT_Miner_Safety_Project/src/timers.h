@@ -23,15 +23,63 @@
 #define LETIMER_PERIOD_MS (3000)
 #define LETIMER_ON_TIME_MS (175)
 
+#include <stdint.h>
+#include <stdbool.h>
+
 void LETIMER0_Set_Comp1(uint32_t load_value);
 
 /**
- * @brief   Enables the LETIMER0 module based on the given energy mode
+ * @brief   Sets how often the sensors are sampled. LETIMER0 itself keeps its
+ *          LETIMER_PERIOD_MS period, only every n-th underflow starts a sample.
+ * @param   period_ms  sampling period, rounded down to a multiple of
+ *                     LETIMER_PERIOD_MS, at least one period
+ * @return  none
+ */
+void LETIMER0_Set_Sample_Period(uint32_t period_ms);
+
+/**
+ * @brief   Counts an underflow of LETIMER0 towards the sampling period, call
+ *          once per underflow event
+ * @return  true if this underflow starts a sample
+ */
+bool LETIMER0_Sample_Due(void);
+
+/**
+ * @brief   Returns how long until the next underflow that starts a sample
+ * @return  ms
+ */
+uint32_t LETIMER0_Ms_To_Next_Sample(void);
+
+/**
+ * @brief   Returns how long until the next UF or COMP1 interrupt of LETIMER0
+ * @return  ms
+ */
+uint32_t LETIMER0_Ms_To_Next_Irq(void);
+
+/**
+ * @brief   Moves LETIMER0 between the LFXO and the ULFRCO without losing its
+ *          phase, to one tick of the slower clock. The LFXO must be ready.
+ * @param   ulfrco  true for the ULFRCO, which keeps running in EM3
+ * @return  none
+ */
+void LETIMER0_Select_Clock(bool ulfrco);
+
+/**
+ * @brief   Enables the LETIMER0 module on the LFXO, energy.c moves it to the
+ *          ULFRCO for the time spent in EM3
+ * @return  none
+ */
+void LETIMER0_Enable(void);
+
+/**
+ * @brief   Starts the CRYOTIMER with a ~1s period. Its PRS output is a one
+ *          clock wide pulse at every period, which is used as the LCD
+ *          EXTCOMIN signal.
  * @param   nrg_mode   Energy mode in which the microcontroller is going to run
  *                     Accepted values: 0, 1, 2, 3
  * @return  none
  */
-void LETIMER0_Enable(uint32_t nrg_mode);
+void CRYOTIMER_Enable(uint32_t nrg_mode);
 
 
 /**
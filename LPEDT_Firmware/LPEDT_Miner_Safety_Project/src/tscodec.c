@@ -0,0 +1,304 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    tscodec.c
+ * @brief   Block codec for timestamped sensor samples
+ *
+ *          Sensors are sampled on a fixed period and change slowly, so the
+ *          interval between two samples of a sensor rarely changes and the
+ *          value moves by a few counts at most. Coding the change of the
+ *          interval and the change of the value leaves mostly zeros, which
+ *          the tag flags absorb, and small numbers, which take one varint
+ *          byte. A steady sample costs 1 byte instead of 5.
+ *
+ *          The values are integers in a fixed unit (0.01 degC, 0/1), so the
+ *          value delta is exact, no float coding is needed. Each block
+ *          starts from a clean state and carries its own count and
+ *          timestamp, so a lost or skipped block does not affect the others.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include <string.h>
+
+#include "em_device.h"
+#include "tscodec.h"
+
+// Include logging for this file
+#define INCLUDE_LOG_DEBUG 1
+#include "log.h"
+
+static tscodec_stats_t stats;
+
+#if TSCODEC_MEASURE_CYCLES == 1
+/**
+ * @brief   Starts the cycle counter on the first call
+ * @return  current cycle count
+ */
+static uint32_t tscodec_cycles(void) {
+  if((DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk) == 0){
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  }
+
+  return DWT->CYCCNT;
+}
+#endif
+
+/**
+ * @brief   Writes a zigzag varint
+ * @param   p       where to write, up to 5 bytes
+ * @param   value   signed value
+ * @return  number of bytes written
+ */
+static uint32_t put_zigzag(uint8_t *p, int32_t value) {
+  uint32_t v = ((uint32_t) value << 1) ^ (uint32_t) (value >> 31);
+  uint32_t n = 0;
+
+  while(v >= 0x80){
+    p[n++] = (uint8_t) (v | 0x80);
+    v >>= 7;
+  }
+  p[n++] = (uint8_t) v;
+
+  return n;
+}
+
+/**
+ * @brief   Reads a zigzag varint
+ * @param   reader  reader state, moved past the varint
+ * @param   value   written with the signed value
+ * @return  false if read, true if the block ends inside the varint
+ */
+static bool get_zigzag(tscodec_reader_t *reader, int32_t *value) {
+  uint32_t v = 0;
+  uint32_t shift = 0;
+  uint8_t  b;
+
+  do {
+    if((reader->pos == reader->length) || (shift > 28))
+      return true;
+    b = reader->buf[reader->pos++];
+    v |= (uint32_t) (b & 0x7F) << shift;
+    shift += 7;
+  } while(b & 0x80);
+
+  *value = (int32_t) (v >> 1) ^ -(int32_t) (v & 1);
+  return false;
+}
+
+/**
+ * @brief   Starts a new block
+ * @param   block     block state
+ * @param   buf       block bytes, at least TSCODEC_HEADER_SIZE
+ * @param   capacity  size of buf
+ * @param   baseMs    timestamp of the first sample
+ * @return  none
+ */
+void tscodec_begin(tscodec_block_t *block, uint8_t *buf, uint32_t capacity, uint32_t baseMs) {
+  uint32_t i;
+
+  block->buf = buf;
+  block->capacity = capacity;
+  block->baseMs = baseMs;
+
+  buf[0] = 0;
+  buf[1] = (uint8_t) baseMs;
+  buf[2] = (uint8_t) (baseMs >> 8);
+  buf[3] = (uint8_t) (baseMs >> 16);
+  buf[4] = (uint8_t) (baseMs >> 24);
+  block->length = TSCODEC_HEADER_SIZE;
+
+  for(i = 0; i < TSCODEC_SENSOR_SLOTS; i++){
+    block->sensor[i].lastMs = baseMs;
+    block->sensor[i].lastIntervalMs = 0;
+    block->sensor[i].lastValue = 0;
+  }
+
+} // tscodec_begin()
+
+/**
+ * @brief   Appends a sample to the block
+ * @param   block   block state
+ * @param   sensor  sensor ID, 0 to TSCODEC_SENSOR_MASK
+ * @param   ms      timestamp, not before the previous sample of the sensor
+ * @param   value   sample value
+ * @return  false if the sample was added, true if it does not fit, the
+ *          block is unchanged then
+ */
+bool tscodec_add(tscodec_block_t *block, uint8_t sensor, uint32_t ms, int16_t value) {
+  tscodec_sensor_state_t *s = &block->sensor[(sensor & TSCODEC_SENSOR_MASK) % TSCODEC_SENSOR_SLOTS];
+  uint8_t  coded[TSCODEC_MAX_SAMPLE_SIZE];
+  uint32_t n;
+#if TSCODEC_MEASURE_CYCLES == 1
+  uint32_t start = tscodec_cycles();
+#endif
+
+  if(block->buf[0] == 0xFF)
+    return true;
+
+#if TSCODEC_COMPRESS == 1
+  int32_t interval = (int32_t) (ms - s->lastMs);
+  int32_t dod = interval - s->lastIntervalMs;
+  int32_t dv = (int32_t) value - (int32_t) s->lastValue;
+
+  coded[0] = sensor & TSCODEC_SENSOR_MASK;
+  n = 1;
+  if(dod == 0)
+    coded[0] |= TSCODEC_TAG_SAME_INTERVAL;
+  else
+    n += put_zigzag(&coded[n], dod);
+  if(dv == 0)
+    coded[0] |= TSCODEC_TAG_SAME_VALUE;
+  else
+    n += put_zigzag(&coded[n], dv);
+
+  if(block->length + n > block->capacity)
+    return true;
+
+  s->lastMs = ms;
+  s->lastIntervalMs = interval;
+  s->lastValue = value;
+#else
+  uint32_t delta = ms - block->baseMs;
+
+  // The offset is 16 bits wide
+  if((delta > 0xFFFF) || (block->length + TSCODEC_RAW_SAMPLE_SIZE > block->capacity))
+    return true;
+
+  (void) s;
+  (void) put_zigzag;
+  (void) get_zigzag;
+  coded[0] = sensor;
+  coded[1] = (uint8_t) delta;
+  coded[2] = (uint8_t) (delta >> 8);
+  coded[3] = (uint8_t) value;
+  coded[4] = (uint8_t) (((uint16_t) value) >> 8);
+  n = TSCODEC_RAW_SAMPLE_SIZE;
+#endif
+
+  memcpy(&block->buf[block->length], &coded[0], n);
+  block->length += n;
+  block->buf[0]++;
+
+  stats.samples++;
+  stats.rawBytes += TSCODEC_RAW_SAMPLE_SIZE;
+  stats.codedBytes += n;
+#if TSCODEC_MEASURE_CYCLES == 1
+  stats.cycles += tscodec_cycles() - start;
+#endif
+
+  return false;
+
+} // tscodec_add()
+
+/**
+ * @brief   Returns the number of samples in the block
+ * @param   block   block state
+ * @return  samples
+ */
+uint32_t tscodec_count(const tscodec_block_t *block) {
+
+  return block->buf[0];
+
+} // tscodec_count()
+
+/**
+ * @brief   Starts reading a block
+ * @param   reader  reader state
+ * @param   buf     block bytes
+ * @param   length  bytes in the block
+ * @return  none
+ */
+void tscodec_read_begin(tscodec_reader_t *reader, const uint8_t *buf, uint32_t length) {
+  uint32_t i;
+
+  reader->buf = buf;
+  reader->length = length;
+  reader->pos = TSCODEC_HEADER_SIZE;
+  reader->left = 0;
+  reader->baseMs = 0;
+  if(length < TSCODEC_HEADER_SIZE)
+    return;
+
+  reader->left = buf[0];
+  reader->baseMs = (uint32_t) buf[1] | ((uint32_t) buf[2] << 8) |
+                   ((uint32_t) buf[3] << 16) | ((uint32_t) buf[4] << 24);
+
+  for(i = 0; i < TSCODEC_SENSOR_SLOTS; i++){
+    reader->sensor[i].lastMs = reader->baseMs;
+    reader->sensor[i].lastIntervalMs = 0;
+    reader->sensor[i].lastValue = 0;
+  }
+
+} // tscodec_read_begin()
+
+/**
+ * @brief   Reads the next sample of the block
+ * @param   reader  reader state
+ * @param   sensor  written with the sensor ID
+ * @param   ms      written with the timestamp
+ * @param   value   written with the sample value
+ * @return  false if a sample was read, true at the end of the block or if
+ *          the block is cut short
+ */
+bool tscodec_read(tscodec_reader_t *reader, uint8_t *sensor, uint32_t *ms, int16_t *value) {
+
+  if((reader->left == 0) || (reader->pos == reader->length))
+    return true;
+
+#if TSCODEC_COMPRESS == 1
+  tscodec_sensor_state_t *s;
+  uint8_t  tag = reader->buf[reader->pos++];
+  int32_t  dod = 0;
+  int32_t  dv = 0;
+
+  if((((tag & TSCODEC_TAG_SAME_INTERVAL) == 0) && get_zigzag(reader, &dod)) ||
+     (((tag & TSCODEC_TAG_SAME_VALUE) == 0) && get_zigzag(reader, &dv)))
+    return true;
+
+  s = &reader->sensor[(tag & TSCODEC_SENSOR_MASK) % TSCODEC_SENSOR_SLOTS];
+  s->lastIntervalMs += dod;
+  s->lastMs += (uint32_t) s->lastIntervalMs;
+  s->lastValue = (int16_t) (s->lastValue + dv);
+
+  *sensor = tag & TSCODEC_SENSOR_MASK;
+  *ms = s->lastMs;
+  *value = s->lastValue;
+#else
+  if(reader->pos + TSCODEC_RAW_SAMPLE_SIZE > reader->length)
+    return true;
+
+  const uint8_t *p = &reader->buf[reader->pos];
+  reader->pos += TSCODEC_RAW_SAMPLE_SIZE;
+
+  *sensor = p[0];
+  *ms = reader->baseMs + ((uint32_t) p[1] | ((uint32_t) p[2] << 8));
+  *value = (int16_t) ((uint16_t) p[3] | ((uint16_t) p[4] << 8));
+#endif
+
+  reader->left--;
+  return false;
+
+} // tscodec_read()
+
+/**
+ * @brief   Returns the codec counters
+ * @param   out     written with the current counters
+ * @return  none
+ */
+void tscodec_get_stats(tscodec_stats_t *out) {
+
+  *out = stats;
+
+} // tscodec_get_stats()
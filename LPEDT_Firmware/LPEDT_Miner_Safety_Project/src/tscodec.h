@@ -0,0 +1,157 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    tscodec.h
+ * @brief   Header file for tscodec.c. Block codec for timestamped sensor
+ *          samples, shared by Bulk Telemetry and the journal sync
+ *
+ *          Block layout (little endian), every block decodes on its own:
+ *            [0]      number of samples
+ *            [1..4]   timestamp of the first sample, ms since boot
+ *            then per sample, TSCODEC_COMPRESS 1:
+ *            [0]      tag: bits 0..5 sensor
+ *                          bit 6 set: value same as the previous sample of
+ *                                     this sensor, no value field
+ *                          bit 7 set: same interval as the previous sample
+ *                                     of this sensor, no time field
+ *            [..]     time field: zigzag varint, interval to the previous
+ *                     sample of this sensor minus the interval before it
+ *            [..]     value field: zigzag varint, value minus the previous
+ *                     value of this sensor
+ *            or per sample, TSCODEC_COMPRESS 0:
+ *            [0]      sensor
+ *            [1..2]   ms since the first sample
+ *            [3..4]   value, int16 in the unit of the sensor
+ *
+ *          Varints hold 7 bits per byte, low bits first, bit 7 set when more
+ *          bytes follow. Zigzag maps 0, -1, 1, -2, ... to 0, 1, 2, 3, ...
+ *          The first sample of a sensor in a block is coded against the
+ *          block timestamp, an interval of 0 and a value of 0. Sensor state
+ *          is kept per (sensor % TSCODEC_SENSOR_SLOTS), one slot for every
+ *          telemetry_sensor_t.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#ifndef SRC_TSCODEC_H_
+#define SRC_TSCODEC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "telemetry.h"
+
+// 1 -> delta of delta timestamps and delta values, 1 byte for a steady
+//      sample, up to TSCODEC_MAX_SAMPLE_SIZE
+// 0 -> fixed TSCODEC_RAW_SAMPLE_SIZE byte samples
+#define TSCODEC_COMPRESS            1
+
+// 1 -> encode time is counted in CPU cycles, see tscodec_get_stats(). This
+//      starts the DWT cycle counter, set it for benchmark builds only
+#define TSCODEC_MEASURE_CYCLES      0
+
+#define TSCODEC_HEADER_SIZE         (5)
+#define TSCODEC_RAW_SAMPLE_SIZE     (5)
+#define TSCODEC_MAX_SAMPLE_SIZE     (1 + 5 + 3)
+
+#define TSCODEC_SENSOR_MASK         (0x3F)
+#define TSCODEC_SENSOR_SLOTS        (TELEMETRY_NUMBER_OF_SENSORS)
+
+#define TSCODEC_TAG_SAME_VALUE      (0x40)
+#define TSCODEC_TAG_SAME_INTERVAL   (0x80)
+
+typedef struct {
+  uint32_t lastMs;
+  int32_t  lastIntervalMs;
+  int16_t  lastValue;
+} tscodec_sensor_state_t;
+
+typedef struct {
+  uint8_t  *buf;
+  uint32_t  capacity;
+  uint32_t  length;
+  uint32_t  baseMs;
+  tscodec_sensor_state_t sensor[TSCODEC_SENSOR_SLOTS];
+} tscodec_block_t;
+
+typedef struct {
+  const uint8_t *buf;
+  uint32_t  length;
+  uint32_t  pos;
+  uint32_t  left;            // samples not read yet
+  uint32_t  baseMs;
+  tscodec_sensor_state_t sensor[TSCODEC_SENSOR_SLOTS];
+} tscodec_reader_t;
+
+typedef struct {
+  uint32_t samples;          // since boot
+  uint32_t rawBytes;         // the same samples at TSCODEC_RAW_SAMPLE_SIZE
+  uint32_t codedBytes;       // sample bytes written
+  uint32_t cycles;           // CPU cycles spent in tscodec_add(), 0 if not measured
+} tscodec_stats_t;
+
+/**
+ * @brief   Starts a new block
+ * @param   block     block state
+ * @param   buf       block bytes, at least TSCODEC_HEADER_SIZE
+ * @param   capacity  size of buf
+ * @param   baseMs    timestamp of the first sample
+ * @return  none
+ */
+void tscodec_begin(tscodec_block_t *block, uint8_t *buf, uint32_t capacity, uint32_t baseMs);
+
+/**
+ * @brief   Appends a sample to the block
+ * @param   block   block state
+ * @param   sensor  sensor ID, 0 to TSCODEC_SENSOR_MASK
+ * @param   ms      timestamp, not before the previous sample of the sensor
+ * @param   value   sample value
+ * @return  false if the sample was added, true if it does not fit, the
+ *          block is unchanged then
+ */
+bool tscodec_add(tscodec_block_t *block, uint8_t sensor, uint32_t ms, int16_t value);
+
+/**
+ * @brief   Returns the number of samples in the block
+ * @param   block   block state
+ * @return  samples
+ */
+uint32_t tscodec_count(const tscodec_block_t *block);
+
+/**
+ * @brief   Starts reading a block
+ * @param   reader  reader state
+ * @param   buf     block bytes
+ * @param   length  bytes in the block
+ * @return  none
+ */
+void tscodec_read_begin(tscodec_reader_t *reader, const uint8_t *buf, uint32_t length);
+
+/**
+ * @brief   Reads the next sample of the block
+ * @param   reader  reader state
+ * @param   sensor  written with the sensor ID
+ * @param   ms      written with the timestamp
+ * @param   value   written with the sample value
+ * @return  false if a sample was read, true at the end of the block or if
+ *          the block is cut short
+ */
+bool tscodec_read(tscodec_reader_t *reader, uint8_t *sensor, uint32_t *ms, int16_t *value);
+
+/**
+ * @brief   Returns the codec counters
+ * @param   out     written with the current counters
+ * @return  none
+ */
+void tscodec_get_stats(tscodec_stats_t *out);
+
+#endif /* SRC_TSCODEC_H_ */
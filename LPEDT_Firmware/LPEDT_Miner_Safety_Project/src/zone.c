@@ -0,0 +1,269 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    zone.c
+ * @brief   Zone localization from the RSSI of fixed anchor beacons
+ *
+ *          Each anchor keeps an EWMA of its path loss margin, RSSI minus the
+ *          measured power the anchor advertises, in 1/16 dB, so anchors with
+ *          different transmit power compare fairly. A scan report only
+ *          touches the entry of its own anchor and the entry of the current
+ *          zone: the zone moves once the reporting anchor has been
+ *          ZONE_HYSTERESIS_DB stronger on ZONE_SWITCH_REPORTS reports in a
+ *          row. Walking under the boundary between two anchors therefore
+ *          does not make the zone flicker. The full table is only walked
+ *          once a second by zone_tick().
+ *
+ *          test/test_zone replays recorded traces through this file to tune
+ *          the constants in zone.h.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include "sl_sleeptimer.h"
+#include "zone.h"
+#include "beacon.h"
+#include "telemetry.h"
+#include "journal.h"
+#include "ble_device_type.h"
+
+// Include logging for this file
+#define INCLUDE_LOG_DEBUG 1
+#include "log.h"
+
+#if BUILD_INCLUDES_BLE_SERVER == 1
+
+#define SCAN_PASSIVE                  (0)
+
+#define AD_TYPE_MANUFACTURER_SPECIFIC (0xFF)
+
+// Manufacturer specific AD structure of an anchor: length, type, company ID
+// and the 4 anchor bytes
+#define ANCHOR_AD_LENGTH       (7)
+
+#define FILTER_ONE             (16)    // 1 dB in the filter
+
+typedef struct {
+  bool     valid;
+  uint16_t zoneId;
+  int16_t  margin;        // EWMA of RSSI - measured power, 1/16 dB
+  uint8_t  reports;       // saturates at ZONE_MIN_REPORTS
+  uint32_t lastSeenMs;
+} zone_anchor_t;
+
+static zone_anchor_t anchors[ZONE_MAX_ANCHORS];
+
+static uint16_t currentZone = ZONE_UNKNOWN;
+static uint16_t challengerZone = ZONE_UNKNOWN;
+static uint8_t  challengerReports = 0;
+
+/**
+ * @brief   Returns the time since boot in ms
+ * @return  ms since boot
+ */
+static uint32_t zone_now_ms(void) {
+  uint64_t ms = 0;
+
+  sl_sleeptimer_tick64_to_ms(sl_sleeptimer_get_tick_count64(), &ms);
+
+  return (uint32_t) ms;
+}
+
+/**
+ * @brief   Finds the anchor AD structure in advertising data
+ * @param   data    advertising data
+ * @param   len     length of data
+ * @param   zoneId  written with the zone ID of the anchor
+ * @param   power   written with the measured power of the anchor
+ * @return  true if the data comes from an anchor
+ */
+static bool parse_anchor(const uint8_t *data, uint32_t len, uint16_t *zoneId, int8_t *power) {
+  uint32_t i = 0;
+  uint8_t  adLen;
+
+  while(i + 1 < len){
+    adLen = data[i];
+    if((adLen == 0) || (i + 1 + adLen > len))
+      break;
+
+    if((adLen == ANCHOR_AD_LENGTH) && (data[i+1] == AD_TYPE_MANUFACTURER_SPECIFIC) &&
+       ((data[i+2] | (data[i+3] << 8)) == BEACON_COMPANY_ID) && (data[i+4] == ZONE_ANCHOR_FORMAT)){
+      *zoneId = (uint16_t) (data[i+5] | (data[i+6] << 8));
+      *power = (int8_t) data[i+7];
+      return (*zoneId != ZONE_UNKNOWN);
+    }
+
+    i += adLen + 1;
+  }
+
+  return false;
+}
+
+/**
+ * @brief   Makes a zone current and reports it
+ * @param   zoneId  new zone, ZONE_UNKNOWN if none
+ * @return  none
+ */
+static void set_zone(uint16_t zoneId) {
+  if(zoneId == currentZone)
+    return;
+
+  LOG_INFO("zone: %u -> %u\r\n", (unsigned int) currentZone, (unsigned int) zoneId);
+  currentZone = zoneId;
+  challengerZone = ZONE_UNKNOWN;
+  challengerReports = 0;
+
+  if(telemetry_add_sample(TELEMETRY_SENSOR_ZONE, (int16_t) zoneId))
+    journal_append(TELEMETRY_SENSOR_ZONE, (int16_t) zoneId);
+}
+
+/**
+ * @brief   Clears the anchor table and starts the scanner, call once at boot
+ * @return  none
+ */
+void zone_init(void) {
+  sl_status_t sc;
+  uint32_t    i;
+
+  for(i = 0; i < ZONE_MAX_ANCHORS; i++)
+    anchors[i].valid = false;
+  currentZone = ZONE_UNKNOWN;
+  challengerZone = ZONE_UNKNOWN;
+  challengerReports = 0;
+
+  if(ZONE_ENABLE == 0)
+    return;
+
+  sc = sl_bt_scanner_set_mode(sl_bt_gap_1m_phy, SCAN_PASSIVE);
+  if(sc != SL_STATUS_OK){
+      LOG_ERROR("sl_bt_scanner_set_mode() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+  }
+
+  sc = sl_bt_scanner_set_timing(sl_bt_gap_1m_phy, ZONE_SCAN_INTERVAL, ZONE_SCAN_WINDOW);
+  if(sc != SL_STATUS_OK){
+      LOG_ERROR("sl_bt_scanner_set_timing() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+  }
+
+  sc = sl_bt_scanner_start(sl_bt_gap_1m_phy, sl_bt_scanner_discover_observation);
+  if(sc != SL_STATUS_OK){
+      LOG_ERROR("sl_bt_scanner_start() returned != 0 status=0x%04x\r\n", (unsigned int) sc);
+  }
+
+} // zone_init()
+
+/**
+ * @brief   Filters the RSSI of an anchor and moves the zone when another
+ *          anchor stays clearly stronger, O(1) per report
+ * @param   report  scan report from the stack
+ * @return  none
+ */
+void zone_scan_report(sl_bt_evt_scanner_scan_report_t *report) {
+  zone_anchor_t *anchor;
+  zone_anchor_t *current;
+  uint16_t       zoneId;
+  int8_t         power;
+  int16_t        sample;
+  uint32_t       now;
+
+  if(parse_anchor(&report->data.data[0], report->data.len, &zoneId, &power) == false)
+    return;
+
+  now = zone_now_ms();
+  sample = (int16_t) ((report->rssi - power) * FILTER_ONE);
+  anchor = &anchors[zoneId & (ZONE_MAX_ANCHORS - 1)];
+
+  if((anchor->valid == true) && (anchor->zoneId != zoneId)){
+    // Two anchors on one entry, the live and stronger one keeps it
+    if((now - anchor->lastSeenMs <= ZONE_ANCHOR_EXPIRY_MS) && (sample <= anchor->margin))
+      return;
+    if(anchor->zoneId == currentZone)
+      set_zone(ZONE_UNKNOWN);
+    anchor->valid = false;
+  }
+
+  if(anchor->valid == false){
+    anchor->valid = true;
+    anchor->zoneId = zoneId;
+    anchor->margin = sample;
+    anchor->reports = 0;
+  }
+  else {
+    anchor->margin += (sample - anchor->margin) / (1 << ZONE_EWMA_SHIFT);
+  }
+  anchor->lastSeenMs = now;
+  if(anchor->reports < ZONE_MIN_REPORTS)
+    anchor->reports++;
+
+  if((anchor->reports < ZONE_MIN_REPORTS) || (zoneId == currentZone))
+    return;
+
+  if(currentZone == ZONE_UNKNOWN){
+    set_zone(zoneId);
+    return;
+  }
+
+  current = &anchors[currentZone & (ZONE_MAX_ANCHORS - 1)];
+  if(anchor->margin <= current->margin + (ZONE_HYSTERESIS_DB * FILTER_ONE)){
+    if(challengerZone == zoneId)
+      challengerReports = 0;
+    return;
+  }
+
+  if(challengerZone != zoneId){
+    challengerZone = zoneId;
+    challengerReports = 0;
+  }
+  if(++challengerReports >= ZONE_SWITCH_REPORTS)
+    set_zone(zoneId);
+
+} // zone_scan_report()
+
+/**
+ * @brief   Drops anchors not heard for ZONE_ANCHOR_EXPIRY_MS and falls back
+ *          to the strongest one left when the zone anchor is gone, call
+ *          every second
+ * @return  none
+ */
+void zone_tick(void) {
+  zone_anchor_t *best = NULL;
+  zone_anchor_t *current;
+  uint32_t       now = zone_now_ms();
+  uint32_t       i;
+
+  for(i = 0; i < ZONE_MAX_ANCHORS; i++){
+    if(anchors[i].valid == false)
+      continue;
+    if(now - anchors[i].lastSeenMs > ZONE_ANCHOR_EXPIRY_MS){
+      anchors[i].valid = false;
+      continue;
+    }
+    if((anchors[i].reports >= ZONE_MIN_REPORTS) && ((best == NULL) || (anchors[i].margin > best->margin)))
+      best = &anchors[i];
+  }
+
+  current = &anchors[currentZone & (ZONE_MAX_ANCHORS - 1)];
+  if((currentZone != ZONE_UNKNOWN) && ((current->valid == false) || (current->zoneId != currentZone)))
+    set_zone((best == NULL) ? ZONE_UNKNOWN : best->zoneId);
+
+} // zone_tick()
+
+/**
+ * @brief   Returns the current zone
+ * @return  zone ID, ZONE_UNKNOWN if no anchor is heard
+ */
+uint16_t zone_current(void) {
+
+  return currentZone;
+
+} // zone_current()
+
+#endif
@@ -0,0 +1,96 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    zone.h
+ * @brief   Header file for zone.c. Zone localization from the RSSI of fixed
+ *          anchor beacons along the tunnels
+ *
+ *          Anchor advertising data, manufacturer specific, after the 2 byte
+ *          company ID BEACON_COMPANY_ID (little endian):
+ *            [0]      ZONE_ANCHOR_FORMAT
+ *            [1..2]   zone ID, uint16, 0 to 0xFFFE
+ *            [3]      measured power, int8, RSSI at 1 m in dBm
+ *
+ *          The anchor table is indexed by the low bits of the zone ID, so
+ *          anchors within radio range of each other must differ there.
+ *          Numbering the zones along a tunnel does that.
+ *
+ *          The current zone goes into telemetry as TELEMETRY_SENSOR_ZONE on
+ *          every change, ZONE_UNKNOWN (-1 as an int16) when no anchor is
+ *          heard.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#ifndef SRC_ZONE_H_
+#define SRC_ZONE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sl_bt_api.h"
+
+// 1 -> the helmet scans for anchors and reports its zone
+#define ZONE_ENABLE                  1
+
+#define ZONE_ANCHOR_FORMAT           (0x80)
+#define ZONE_UNKNOWN                 (0xFFFF)
+
+// Anchor table entries, a power of 2
+#define ZONE_MAX_ANCHORS             (16)
+
+// EWMA weight of a new report, 1 / 2^ZONE_EWMA_SHIFT
+#define ZONE_EWMA_SHIFT              (2)
+
+// Reports an anchor needs before it can become the zone
+#define ZONE_MIN_REPORTS             (3)
+
+// Another anchor must be this much stronger, in dB after the filter, on
+// ZONE_SWITCH_REPORTS of its reports in a row for the zone to change
+#define ZONE_HYSTERESIS_DB           (6)
+#define ZONE_SWITCH_REPORTS          (3)
+
+// An anchor not heard for this long leaves the table
+#define ZONE_ANCHOR_EXPIRY_MS        (10000)
+
+// Passive scan, anchors advertise every 100 ms to 200 ms
+#define ZONE_SCAN_INTERVAL           (1600)  // 1 s, (time in milliseconds / 0.625)
+#define ZONE_SCAN_WINDOW             (160)   // 100 ms, 10 %
+
+/**
+ * @brief   Clears the anchor table and starts the scanner, call once at boot
+ * @return  none
+ */
+void zone_init(void);
+
+/**
+ * @brief   Filters the RSSI of an anchor and moves the zone when another
+ *          anchor stays clearly stronger, O(1) per report
+ * @param   report  scan report from the stack
+ * @return  none
+ */
+void zone_scan_report(sl_bt_evt_scanner_scan_report_t *report);
+
+/**
+ * @brief   Drops anchors not heard for ZONE_ANCHOR_EXPIRY_MS and falls back
+ *          to the strongest one left when the zone anchor is gone, call
+ *          every second
+ * @return  none
+ */
+void zone_tick(void);
+
+/**
+ * @brief   Returns the current zone
+ * @return  zone ID, ZONE_UNKNOWN if no anchor is heard
+ */
+uint16_t zone_current(void);
+
+#endif /* SRC_ZONE_H_ */
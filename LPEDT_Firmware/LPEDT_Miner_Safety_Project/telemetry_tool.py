@@ -0,0 +1,671 @@
+#!/usr/bin/env python3
+"""Host side of the sample codec, of the journal seals, of the alarm
+latency histogram and of the energy governor, see src/tscodec.h,
+src/seal.h, src/alarm.h and src/governor.h.
+
+Decodes Bulk Telemetry and Stream Data payloads captured from a helmet,
+measures how well the codec packs a recording, checks the seals of a
+journal read out of a helmet, checks the alarm path of a helmet against
+its budget, and projects how long a charge lasts a shift under each
+energy profile. Anchor RSSI traces replay through zone.c itself, see
+test/test_zone.c.
+
+  telemetry_tool.py decode captured.txt -o recording.csv
+  telemetry_tool.py decode captured.txt --stream
+  telemetry_tool.py bench  recording.csv --mtu 250
+  telemetry_tool.py key    key.bin
+  telemetry_tool.py seals  journal.bin --key key.bin --uid 0x000B57FFFE0A1B2C
+  telemetry_tool.py latency alarm_latency.txt
+  telemetry_tool.py governor harvest.csv --soc 80 --hours 12
+
+decode reads one payload per line in hex, as a BLE host logs the
+notifications, and writes "ms,sensor,value" lines. --stream strips the
+Stream Data sequence number first. Journal samples keep JOURNAL_SENSOR_FLAG
+in their sensor ID; their ms count from the boot the batch came from.
+
+bench reads "ms,sensor,value" lines, packs them into batches the way
+telemetry.c does, checks that every batch decodes back to its samples, and
+prints the size against the fixed 5 byte samples. The encode cycles per
+sample on the helmet are in its log, see telemetry_count_packet(), in a build
+with TSCODEC_MEASURE_CYCLES 1.
+
+--raw selects the fixed sample layout of a build with TSCODEC_COMPRESS 0.
+
+key writes a new random key record for one helmet; keep a copy with its
+unique ID, then "commander flash --binary key.bin --address 0x0FE00600" and
+lock the user data page. seals reads a binary dump of the journal region
+(JOURNAL_PAGES pages from JOURNAL_BASE) and checks every sealed page
+against the key record and the unique ID of the helmet ("commander
+device info").
+
+latency reads the Alarm Latency characteristic in hex, as read after a
+drill, prints the histogram of every stage and fails if any stage went
+over its budget.
+
+governor reads "hour,harvest_ua" lines, the harvester current from that
+hour of the shift on, repeated every --hours. The helmet is simulated
+minute by minute from --soc, plus --load-ua for the parts the firmware
+does not duty cycle: once with each profile held, and once with a
+mirror of governor.c picking the profile the way the helmet would. The
+currents come from the per-event charges below, estimates to be replaced
+by Energy Profiler captures; alarms are not counted. It fails if the
+governed helmet does not last the shift. Change the GOVERNOR_ constants
+together with governor.h and battery.h.
+"""
+
+import argparse
+import os
+import struct
+import sys
+import time
+import zlib
+
+# src/tscodec.h
+HEADER_SIZE = 5
+RAW_SAMPLE_SIZE = 5
+SENSOR_MASK = 0x3F
+SENSOR_SLOTS = 5                # TELEMETRY_NUMBER_OF_SENSORS
+TAG_SAME_VALUE = 0x40
+TAG_SAME_INTERVAL = 0x80
+
+# src/telemetry.h, src/journal.h, src/stream.h
+TELEMETRY_SEQ_SIZE = 1
+MAX_BATCH_AGE_MS = 30000
+JOURNAL_SENSOR_FLAG = 0x20
+STREAM_HEADER_SIZE = 1
+
+ATT_HEADER_LENGTH = 3
+ATT_MAX_MTU = 250     # src/ble.h
+
+# src/journal.h, src/seal.h
+JOURNAL_PAGE_SIZE = 2048
+JOURNAL_PAGE_MAGIC = 0x4A4D
+JOURNAL_PAGE_HEADER_SIZE = 8
+JOURNAL_RECORD_SIZE = 8
+SEAL_KEY_MAGIC = 0x4B4C5353
+SEAL_KEY_SIZE = 16
+SEAL_TAG_SIZE = 16
+SEAL_SIZE = SEAL_TAG_SIZE + 8
+SEAL_MAGIC = 0x4C414553
+BLANK_WORD = 0xFFFFFFFF
+
+# src/alarm.h
+ALARM_LATENCY_FORMAT_VERSION = 1
+ALARM_LATENCY_HEADER_SIZE = 4
+ALARM_STAGES = [("buzzer", 1), ("dispatch", 5), ("beacon", 5),
+                ("indication", 5), ("confirmed", 1000)]
+
+# src/governor.h, src/battery.h
+GOVERNOR_SOC_FULL = 60
+GOVERNOR_SOC_ECO = 30
+GOVERNOR_SOC_SAVER = 15
+GOVERNOR_SOC_HYST = 3
+GOVERNOR_HARVEST_MV_PER_HOUR = 10
+# name, sample ms, adv and beacon interval x 0.625 ms, display ms, log level, Si7021 bits
+GOVERNOR_PROFILES = [("full", 3000, 400, 1600, 0, "info", 14),
+                     ("eco", 6000, 800, 3200, 3000, "warn", 13),
+                     ("saver", 15000, 1600, 4800, 10000, "warn", 12),
+                     ("critical", 60000, 3200, 8000, 30000, "error", 11)]
+BATTERY_OCV_MV = [3000, 3600, 3690, 3740, 3770, 3800, 3850, 3910, 3980, 4080, 4190]
+BATTERY_CAPACITY_MAH = 350
+BATTERY_EWMA_SHIFT = 2
+BATTERY_HALF_MS = 20 * 3000
+
+# Estimated charge per event, uC, and floor current, uA
+ENERGY_FLOOR_UA = 8.0          # EM2, LFXO, memory LCD, Si7021 standby, bq25570
+ENERGY_ADV_UC = 12.0           # connectable advertising event, 3 channels
+ENERGY_BEACON_UC = 14.0        # beacon event, longer payload
+ENERGY_SAMPLE_UC = 6.0         # wakeups and I2C of one temperature sample
+ENERGY_SI7021_UA = 90.0        # during a conversion
+ENERGY_CONVERSION_MS = {14: 10.8, 13: 6.2, 12: 3.8, 11: 2.4}
+ENERGY_LCD_UC = 30.0           # one LCD refresh over SPI
+ENERGY_LOG_UC = 8.0            # one 60 character line on VCOM
+LOG_LINES_PER_HOUR = {"info": 720, "warn": 30, "error": 5}
+LCD_UPDATES_PER_HOUR = 720
+
+
+class CodecError(Exception):
+    pass
+
+
+def _zigzag_varint(value):
+    v = ((value << 1) ^ (value >> 31)) & 0xFFFFFFFF
+    out = bytearray()
+    while v >= 0x80:
+        out.append((v & 0x7F) | 0x80)
+        v >>= 7
+    out.append(v)
+    return bytes(out)
+
+
+def _read_zigzag(data, i):
+    v = 0
+    shift = 0
+    while True:
+        if i >= len(data) or shift > 28:
+            raise CodecError("varint runs past the block")
+        b = data[i]
+        i += 1
+        v |= (b & 0x7F) << shift
+        shift += 7
+        if b & 0x80 == 0:
+            break
+    v &= 0xFFFFFFFF
+    value = (v >> 1) ^ -(v & 1)
+    return value, i
+
+
+def _int16(value):
+    return ((value + 0x8000) & 0xFFFF) - 0x8000
+
+
+def _int32(value):
+    """Wraps to int32 like the C arithmetic."""
+    return ((value + 0x80000000) & 0xFFFFFFFF) - 0x80000000
+
+
+class Block:
+    """Mirror of tscodec_begin() and tscodec_add()."""
+
+    def __init__(self, capacity, base_ms, raw=False):
+        self.capacity = capacity
+        self.base_ms = base_ms
+        self.raw = raw
+        self.count = 0
+        self.body = bytearray()
+        self.state = [[base_ms, 0, 0] for _ in range(SENSOR_SLOTS)]
+
+    def length(self):
+        return HEADER_SIZE + len(self.body)
+
+    def add(self, sensor, ms, value):
+        """Returns False if the sample was added, True if it does not fit."""
+        if self.count == 0xFF:
+            return True
+        if self.raw:
+            delta = (ms - self.base_ms) & 0xFFFFFFFF
+            if delta > 0xFFFF or self.length() + RAW_SAMPLE_SIZE > self.capacity:
+                return True
+            coded = struct.pack("<BHh", sensor, delta, value)
+        else:
+            s = self.state[(sensor & SENSOR_MASK) % SENSOR_SLOTS]
+            interval = _int32(ms - s[0])
+            dod = _int32(interval - s[1])
+            dv = value - s[2]
+            tag = sensor & SENSOR_MASK
+            coded = b""
+            if dod == 0:
+                tag |= TAG_SAME_INTERVAL
+            else:
+                coded += _zigzag_varint(dod)
+            if dv == 0:
+                tag |= TAG_SAME_VALUE
+            else:
+                coded += _zigzag_varint(dv)
+            coded = bytes([tag]) + coded
+            if self.length() + len(coded) > self.capacity:
+                return True
+            s[0], s[1], s[2] = ms & 0xFFFFFFFF, interval, value
+        self.body += coded
+        self.count += 1
+        return False
+
+    def to_bytes(self):
+        return struct.pack("<BI", self.count, self.base_ms & 0xFFFFFFFF) + bytes(self.body)
+
+
+def decode_block(data, raw=False):
+    """Returns [(ms, sensor, value)] of one block, see src/tscodec.h."""
+    if len(data) < HEADER_SIZE:
+        raise CodecError("block shorter than its header")
+    count, base_ms = struct.unpack_from("<BI", data, 0)
+    samples = []
+    state = [[base_ms, 0, 0] for _ in range(SENSOR_SLOTS)]
+    i = HEADER_SIZE
+    for _ in range(count):
+        if raw:
+            if i + RAW_SAMPLE_SIZE > len(data):
+                raise CodecError("sample runs past the block")
+            sensor, delta, value = struct.unpack_from("<BHh", data, i)
+            i += RAW_SAMPLE_SIZE
+            samples.append(((base_ms + delta) & 0xFFFFFFFF, sensor, value))
+            continue
+        if i >= len(data):
+            raise CodecError("sample runs past the block")
+        tag = data[i]
+        i += 1
+        sensor = tag & SENSOR_MASK
+        s = state[sensor % SENSOR_SLOTS]
+        interval = s[1]
+        if not tag & TAG_SAME_INTERVAL:
+            dod, i = _read_zigzag(data, i)
+            interval = _int32(interval + dod)
+        value = s[2]
+        if not tag & TAG_SAME_VALUE:
+            dv, i = _read_zigzag(data, i)
+            value = _int16(value + dv)
+        ms = (s[0] + interval) & 0xFFFFFFFF
+        s[0], s[1], s[2] = ms, interval, value
+        samples.append((ms, sensor, value))
+    if i != len(data):
+        raise CodecError("%d bytes after the last sample" % (len(data) - i))
+    return samples
+
+
+def decode_payload(payload, stream=False, raw=False):
+    """Returns (sequence number, samples) of a notification."""
+    if stream:
+        payload = payload[STREAM_HEADER_SIZE:]
+    if len(payload) < TELEMETRY_SEQ_SIZE + HEADER_SIZE:
+        raise CodecError("payload shorter than a batch header")
+    return payload[0], decode_block(payload[TELEMETRY_SEQ_SIZE:], raw)
+
+
+def pack(samples, mtu, stream=False, raw=False):
+    """Packs samples into batches like telemetry_add_sample(), returns the
+    payloads."""
+    capacity = mtu - ATT_HEADER_LENGTH - (STREAM_HEADER_SIZE if stream else 0)
+    payloads = []
+    block = None
+    seq = 0
+
+    def close():
+        nonlocal block, seq
+        payloads.append(bytes([seq]) + block.to_bytes())
+        seq = (seq + 1) & 0xFF
+        block = None
+
+    for ms, sensor, value in samples:
+        if block is not None and ms - block.base_ms >= MAX_BATCH_AGE_MS:
+            close()
+        if block is None:
+            block = Block(capacity - TELEMETRY_SEQ_SIZE, ms, raw)
+        if block.add(sensor, ms, value):
+            close()
+            block = Block(capacity - TELEMETRY_SEQ_SIZE, ms, raw)
+            if block.add(sensor, ms, value):
+                raise CodecError("a single sample does not fit in a batch")
+        if TELEMETRY_SEQ_SIZE + block.length() >= capacity:
+            close()
+    if block is not None:
+        close()
+    return payloads
+
+
+def read_recording(path):
+    samples = []
+    with open(path) as f:
+        for n, line in enumerate(f, 1):
+            line = line.strip()
+            if not line or line.startswith("#") or line[0].isalpha():
+                continue
+            try:
+                ms, sensor, value = (int(x, 0) for x in line.split(","))
+            except ValueError:
+                raise CodecError("%s:%d: expected ms,sensor,value" % (path, n))
+            if not 0 <= sensor <= SENSOR_MASK or not -0x8000 <= value <= 0x7FFF:
+                raise CodecError("%s:%d: sensor or value out of range" % (path, n))
+            samples.append((ms, sensor, value))
+    return samples
+
+
+def bench(samples, mtu, stream=False, raw=False):
+    start = time.perf_counter()
+    payloads = pack(samples, mtu, stream, raw)
+    seconds = time.perf_counter() - start
+
+    decoded = []
+    for payload in payloads:
+        decoded += decode_payload(payload, raw=raw)[1]
+    if [(ms & 0xFFFFFFFF, s, v) for ms, s, v in samples] != decoded:
+        raise CodecError("batches do not decode back to the recording")
+
+    fixed = pack(samples, mtu, stream, raw=True)
+    return {
+        "samples": len(samples),
+        "bytes": sum(len(p) for p in payloads),
+        "packets": len(payloads),
+        "fixed_bytes": sum(len(p) for p in fixed),
+        "fixed_packets": len(fixed),
+        "us_per_sample": 1e6 * seconds / max(len(samples), 1),
+    }
+
+
+def _aes_tables():
+    sbox = [0] * 256
+    p = q = 1
+    while True:
+        # multiply p by 3, divide q by 3 in GF(2^8)
+        p = p ^ ((p << 1) & 0xFF) ^ (0x1B if p & 0x80 else 0)
+        q ^= q << 1
+        q ^= q << 2
+        q ^= q << 4
+        q &= 0xFF
+        if q & 0x80:
+            q ^= 0x09
+        x = q ^ (q << 1 | q >> 7) ^ (q << 2 | q >> 6) ^ (q << 3 | q >> 5) ^ (q << 4 | q >> 4)
+        sbox[p] = (x ^ 0x63) & 0xFF
+        if p == 1:
+            break
+    sbox[0] = 0x63
+    return sbox
+
+
+_SBOX = _aes_tables()
+
+
+def _xtime(b):
+    return ((b << 1) ^ 0x1B) & 0xFF if b & 0x80 else b << 1
+
+
+def aes128_encrypt(key, block):
+    """One AES-128 block, enough for a CCM tag on the host."""
+    w = [list(key[i:i + 4]) for i in range(0, 16, 4)]
+    rcon = 1
+    for i in range(4, 44):
+        t = list(w[i - 1])
+        if i % 4 == 0:
+            t = [_SBOX[b] for b in t[1:] + t[:1]]
+            t[0] ^= rcon
+            rcon = _xtime(rcon)
+        w.append([a ^ b for a, b in zip(w[i - 4], t)])
+    s = [b ^ k for b, k in zip(block, sum(w[0:4], []))]
+    for rnd in range(1, 11):
+        s = [_SBOX[b] for b in s]
+        s = [s[(i + 4 * (i % 4)) % 16] for i in range(16)]
+        if rnd != 10:
+            m = []
+            for c in range(4):
+                a = s[4 * c:4 * c + 4]
+                t = a[0] ^ a[1] ^ a[2] ^ a[3]
+                m += [a[i] ^ t ^ _xtime(a[i] ^ a[(i + 1) % 4]) for i in range(4)]
+            s = m
+        s = [b ^ k for b, k in zip(s, sum(w[4 * rnd:4 * rnd + 4], []))]
+    return bytes(s)
+
+
+def ccm_tag(key, nonce, aad, payload=b"", tag_len=SEAL_TAG_SIZE):
+    """CCM (NIST SP 800-38C) tag of aad and payload."""
+    q = 15 - len(nonce)
+    flags = (0x40 if aad else 0) | (((tag_len - 2) // 2) << 3) | (q - 1)
+    x = aes128_encrypt(key, bytes([flags]) + nonce + len(payload).to_bytes(q, "big"))
+    data = b""
+    if aad:
+        data = len(aad).to_bytes(2, "big") + aad
+        data += bytes(-len(data) % 16)
+    data += payload + bytes(-len(payload) % 16)
+    for i in range(0, len(data), 16):
+        x = aes128_encrypt(key, bytes(a ^ b for a, b in zip(x, data[i:i + 16])))
+    s0 = aes128_encrypt(key, bytes([q - 1]) + nonce + bytes(q))
+    return bytes(a ^ b for a, b in zip(x, s0))[:tag_len]
+
+
+def seal_nonce(seq, boot, records, uid):
+    """Mirror of seal_nonce()."""
+    return struct.pack("<IHHI", seq, boot, records, uid & 0xFFFFFFFF) + bytes([(uid >> 32) & 0xFF])
+
+
+def make_key_record(key):
+    body = struct.pack("<I", SEAL_KEY_MAGIC) + key
+    return body + struct.pack("<I", zlib.crc32(body))
+
+
+def read_key_record(path):
+    with open(path, "rb") as f:
+        rec = f.read()
+    if len(rec) < 8 + SEAL_KEY_SIZE or struct.unpack_from("<I", rec, 0)[0] != SEAL_KEY_MAGIC \
+            or make_key_record(rec[4:4 + SEAL_KEY_SIZE]) != rec[:8 + SEAL_KEY_SIZE]:
+        raise CodecError("%s: not a key record" % path)
+    return rec[4:4 + SEAL_KEY_SIZE]
+
+
+def check_seals(journal, key, uid):
+    """Returns [(page index, seq, boot, records, state)] of every journal
+    page in the dump."""
+    pages = []
+    for phys in range(len(journal) // JOURNAL_PAGE_SIZE):
+        page = journal[phys * JOURNAL_PAGE_SIZE:(phys + 1) * JOURNAL_PAGE_SIZE]
+        seq, magic, boot = struct.unpack_from("<IHH", page, 0)
+        if magic != JOURNAL_PAGE_MAGIC or seq == BLANK_WORD:
+            continue
+        tag = page[-SEAL_SIZE:-SEAL_SIZE + SEAL_TAG_SIZE]
+        records, seal_magic = struct.unpack_from("<II", page, JOURNAL_PAGE_SIZE - 8)
+        if seal_magic != SEAL_MAGIC:
+            pages.append((phys, seq, boot, None, "not sealed"))
+            continue
+        end = JOURNAL_PAGE_HEADER_SIZE + records * JOURNAL_RECORD_SIZE
+        if end > JOURNAL_PAGE_SIZE - SEAL_SIZE:
+            pages.append((phys, seq, boot, records, "TAMPERED"))
+            continue
+        ok = ccm_tag(key, seal_nonce(seq, boot, records, uid), page[:end]) == tag
+        # nothing may follow the sealed records
+        ok = ok and page[end:JOURNAL_PAGE_SIZE - SEAL_SIZE] == b"\xff" * (JOURNAL_PAGE_SIZE - SEAL_SIZE - end)
+        pages.append((phys, seq, boot, records, "ok" if ok else "TAMPERED"))
+    return sorted(pages, key=lambda p: p[1])
+
+
+def decode_latency(value):
+    """Returns the alarms raised and one (name, budget ms, worst us, over
+    budget, buckets) tuple per stage."""
+    if len(value) < ALARM_LATENCY_HEADER_SIZE or value[0] != ALARM_LATENCY_FORMAT_VERSION:
+        raise CodecError("not an Alarm Latency value of format %d" % ALARM_LATENCY_FORMAT_VERSION)
+    stages, buckets, raised = value[1], value[2], value[3]
+    record = 6 + 2 * buckets
+    if stages != len(ALARM_STAGES) or len(value) != ALARM_LATENCY_HEADER_SIZE + stages * record:
+        raise CodecError("Alarm Latency value of %d bytes for %d stages" % (len(value), stages))
+    out = []
+    for i, (name, budget) in enumerate(ALARM_STAGES):
+        p = ALARM_LATENCY_HEADER_SIZE + i * record
+        worst, over = struct.unpack_from("<IH", value, p)
+        out.append((name, budget, worst, over, struct.unpack_from("<%dH" % buckets, value, p + 6)))
+    return raised, out
+
+
+def profile_current_ua(profile):
+    """Average current of a profile, alarms left out."""
+    _, sample_ms, adv, beacon, display_ms, log, bits = profile
+    lcd = LCD_UPDATES_PER_HOUR
+    if display_ms:
+        lcd = min(lcd, 3600000.0 / display_ms)
+    uc_per_hour = (ENERGY_ADV_UC * 3600000.0 / (adv * 0.625)
+                   + ENERGY_BEACON_UC * 3600000.0 / (beacon * 0.625)
+                   + (ENERGY_SAMPLE_UC + ENERGY_SI7021_UA * ENERGY_CONVERSION_MS[bits] / 1000.0)
+                   * 3600000.0 / sample_ms
+                   + ENERGY_LCD_UC * lcd
+                   + ENERGY_LOG_UC * LOG_LINES_PER_HOUR[log])
+    return ENERGY_FLOOR_UA + uc_per_hour / 3600.0
+
+
+def battery_mv(soc):
+    """Open circuit voltage of a state of charge, the table of battery.c."""
+    if soc <= 0:
+        return BATTERY_OCV_MV[0]
+    if soc >= 100:
+        return BATTERY_OCV_MV[-1]
+    seg = int(soc // 10)
+    lo, hi = BATTERY_OCV_MV[seg], BATTERY_OCV_MV[seg + 1]
+    return lo + (hi - lo) * (soc - seg * 10) / 10.0
+
+
+def governor_profile_of(soc):
+    if soc >= GOVERNOR_SOC_FULL:
+        return 0
+    if soc >= GOVERNOR_SOC_ECO:
+        return 1
+    if soc >= GOVERNOR_SOC_SAVER:
+        return 2
+    return 3
+
+
+def read_harvest(path):
+    steps = []
+    with open(path) as f:
+        for n, line in enumerate(f, 1):
+            line = line.split("#")[0].strip()
+            if not line or line[0].isalpha():
+                continue
+            try:
+                hour, ua = [float(x) for x in line.split(",")]
+            except ValueError:
+                raise CodecError("%s:%d: expected hour,harvest_ua" % (path, n))
+            steps.append((hour, ua))
+    if not steps:
+        raise CodecError("%s: no harvest steps" % path)
+    return sorted(steps)
+
+
+def simulate_shift(harvest, soc, hours, load_ua=0.0, fixed=None, max_days=60):
+    """Runs the helmet minute by minute until the battery is flat or
+    max_days are over. Returns the hours it lasted (None if it never went
+    flat), the state of charge at the end of the shift and the profile
+    changes as (hour, old, new, soc)."""
+    charge = BATTERY_CAPACITY_MAH * soc / 100.0
+    profile = 0 if fixed is None else fixed
+    changes = []
+    end_soc = None
+    half_min = BATTERY_HALF_MS // 60000
+    previous_mv = None
+    trend = 0.0
+    for minute in range(max_days * 24 * 60):
+        hour = minute / 60.0
+        if end_soc is None and hour >= hours:
+            end_soc = 100.0 * charge / BATTERY_CAPACITY_MAH
+        in_shift = hour % hours
+        harvest_ua = 0.0
+        for h, ua in harvest:
+            if h <= in_shift:
+                harvest_ua = ua
+        net_ua = profile_current_ua(GOVERNOR_PROFILES[profile]) + load_ua - harvest_ua
+        charge = min(BATTERY_CAPACITY_MAH, charge - net_ua / 1000.0 / 60.0)
+        if charge <= 0:
+            return hour + 1 / 60.0, (0.0 if end_soc is None else end_soc), changes
+
+        # Once per half buffer, like battery_process() and governor_update()
+        if fixed is not None or minute % half_min:
+            continue
+        soc_now = int(100.0 * charge / BATTERY_CAPACITY_MAH)
+        mv = battery_mv(100.0 * charge / BATTERY_CAPACITY_MAH)
+        if previous_mv is not None:
+            trend += ((mv - previous_mv) - trend) / (1 << BATTERY_EWMA_SHIFT)
+        previous_mv = mv
+        trend_per_hour = trend * 3600000.0 / BATTERY_HALF_MS
+        down = governor_profile_of(soc_now)
+        up = governor_profile_of(soc_now - GOVERNOR_SOC_HYST)
+        if trend_per_hour >= GOVERNOR_HARVEST_MV_PER_HOUR:
+            down = max(down - 1, 0)
+            up = max(up - 1, 0)
+        nxt = profile
+        if up < profile:
+            nxt = up
+        elif down > profile:
+            nxt = down
+        if nxt != profile:
+            changes.append((hour, profile, nxt, soc_now))
+            profile = nxt
+    return None, (100.0 * charge / BATTERY_CAPACITY_MAH if end_soc is None else end_soc), changes
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("command", choices=["decode", "bench", "key", "seals", "latency",
+                                            "governor"])
+    parser.add_argument("input", help="hex payloads for decode, ms,sensor,value lines for bench, "
+                                      "the key record for key, the journal dump for seals, "
+                                      "the Alarm Latency value in hex for latency, "
+                                      "hour,harvest_ua lines for governor")
+    parser.add_argument("--mtu", type=int, default=ATT_MAX_MTU)
+    parser.add_argument("--stream", action="store_true", help="Stream Data payloads")
+    parser.add_argument("--raw", action="store_true", help="TSCODEC_COMPRESS 0 build")
+    parser.add_argument("--key", help="key record of the helmet")
+    parser.add_argument("--uid", type=lambda v: int(v, 0), help="unique ID of the helmet")
+    parser.add_argument("--soc", type=float, default=100.0, help="state of charge at the start, %%")
+    parser.add_argument("--hours", type=float, default=12.0, help="shift length")
+    parser.add_argument("--load-ua", type=float, default=0.0,
+                        help="current the governor does not cover, e.g. the gas sensor heater")
+    parser.add_argument("-o", "--output")
+    args = parser.parse_args(argv)
+
+    try:
+        if args.command == "decode":
+            out = open(args.output, "w") if args.output else sys.stdout
+            out.write("ms,sensor,value\n")
+            with open(args.input) as f:
+                for n, line in enumerate(f, 1):
+                    line = line.split("#")[0].strip()
+                    if not line:
+                        continue
+                    try:
+                        _, samples = decode_payload(bytes.fromhex(line), args.stream, args.raw)
+                    except (ValueError, CodecError) as e:
+                        raise CodecError("%s:%d: %s" % (args.input, n, e))
+                    for ms, sensor, value in samples:
+                        out.write("%d,%d,%d\n" % (ms, sensor, value))
+            if args.output:
+                out.close()
+            return 0
+
+        if args.command == "key":
+            with open(args.input, "xb") as f:
+                f.write(make_key_record(os.urandom(SEAL_KEY_SIZE)))
+            return 0
+
+        if args.command == "seals":
+            if args.key is None or args.uid is None:
+                raise CodecError("seals needs --key and --uid")
+            key = read_key_record(args.key)
+            with open(args.input, "rb") as f:
+                pages = check_seals(f.read(), key, args.uid)
+            for phys, seq, boot, records, state in pages:
+                print("page %2d  seq %6d  boot %5d  records %4s  %s"
+                      % (phys, seq, boot, "-" if records is None else records, state))
+            return 1 if any(p[4] == "TAMPERED" for p in pages) else 0
+
+        if args.command == "latency":
+            with open(args.input) as f:
+                try:
+                    value = bytes.fromhex("".join(f.read().split()))
+                except ValueError as e:
+                    raise CodecError("%s: %s" % (args.input, e))
+            raised, stages = decode_latency(value)
+            print("%d alarms raised" % raised)
+            for name, budget, worst, over, buckets in stages:
+                # Bucket 0 is below 1 ms, bucket n below 2^n ms
+                hist = "  ".join("<%dms:%d" % (1 << b, n) for b, n in enumerate(buckets[:-1]) if n)
+                if buckets[-1]:
+                    hist += "  more:%d" % buckets[-1]
+                print("%-10s budget %4d ms  worst %8.3f ms  over %3d  %s"
+                      % (name, budget, worst / 1000.0, over, hist))
+            return 1 if any(s[3] for s in stages) else 0
+
+        if args.command == "governor":
+            harvest = read_harvest(args.input)
+            names = [p[0] for p in GOVERNOR_PROFILES]
+            for i, profile in enumerate(GOVERNOR_PROFILES):
+                lasted, end_soc, _ = simulate_shift(harvest, args.soc, args.hours, args.load_ua, fixed=i)
+                print("%-9s %7.1f uA  %s  SoC after the shift %5.1f %%"
+                      % (profile[0], profile_current_ua(profile) + args.load_ua,
+                         "lasts %6.1f h" % lasted if lasted is not None else "over 60 days  ",
+                         end_soc))
+            lasted, end_soc, changes = simulate_shift(harvest, args.soc, args.hours, args.load_ua)
+            for hour, old, new, soc in changes:
+                print("%6.1f h  %s -> %s at %d %%" % (hour, names[old], names[new], soc))
+            print("governed  %s  SoC after the shift %5.1f %%"
+                  % ("lasts %6.1f h" % lasted if lasted is not None else "over 60 days", end_soc))
+            return 1 if lasted is not None and lasted < args.hours else 0
+
+        r = bench(read_recording(args.input), args.mtu, args.stream, args.raw)
+    except (OSError, CodecError) as e:
+        print(e, file=sys.stderr)
+        return 1
+
+    print("%s: %d samples, %d bytes in %d packets, %.2f bytes/sample"
+          % (args.input, r["samples"], r["bytes"], r["packets"],
+             float(r["bytes"]) / max(r["samples"], 1)))
+    print("fixed 5 byte samples: %d bytes in %d packets, ratio %.2f:1"
+          % (r["fixed_bytes"], r["fixed_packets"], float(r["fixed_bytes"]) / max(r["bytes"], 1)))
+    print("host encode %.1f us/sample, decode checked" % r["us_per_sample"])
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+"""Source, target and delta of every case of test_delta.c.
+
+  delta_vectors.py build/delta
+
+Writes <case>.old, <case>.new and <case>.delta to the directory, the delta
+made by the encoder of fwupdate_tool.py. The images look like Thumb code:
+functions of 16 bit instructions from a small set, each followed by a
+literal pool of pointers into the image. Inserting a function moves every
+function after it and changes every pool that points past it, the same as
+a rebuild of the firmware does.
+"""
+
+import os
+import random
+import struct
+import sys
+
+sys.dont_write_bytecode = True
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+import fwupdate_tool  # noqa: E402
+
+IMAGE_FUNCTIONS = 600
+OPCODES = random.Random(1).sample(range(0x10000), 96)
+
+
+def make_functions(rng, count):
+    functions = []
+    for _ in range(count):
+        body = [rng.choice(OPCODES[:rng.randint(8, len(OPCODES))])
+                for _ in range(rng.randint(20, 200))]
+        calls = [rng.randrange(count) for _ in range(rng.randint(1, 6))]
+        functions.append((body, calls))
+    return functions
+
+
+def link(functions):
+    """Lays the functions out from 0 and fills in their literal pools."""
+    addresses = []
+    address = 0
+    for body, calls in functions:
+        addresses.append(address)
+        address += 2 * len(body) + 4 * len(calls)
+    image = bytearray()
+    for body, calls in functions:
+        image += struct.pack("<%dH" % len(body), *body)
+        image += struct.pack("<%dI" % len(calls),
+                             *[addresses[c % len(addresses)] | 1 for c in calls])
+    return bytes(image)
+
+
+def cases():
+    rng = random.Random(2026)
+    functions = make_functions(rng, IMAGE_FUNCTIONS)
+    old = link(functions)
+
+    # A bug fix: a few instructions changed in three functions
+    fixed = [(list(body), calls) for body, calls in functions]
+    for k in (40, 311, 502):
+        body = fixed[k][0]
+        for j in rng.sample(range(len(body)), 3):
+            body[j] = rng.choice(OPCODES)
+
+    # A feature: two new functions in the middle, everything after moves
+    feature = list(fixed)
+    feature[300:300] = make_functions(rng, 2)
+
+    yield "rebuild", old, old
+    yield "fix", old, link(fixed)
+    yield "feature", old, link(feature)
+    yield "unrelated", old, bytes(rng.getrandbits(8) for _ in range(8192))
+
+
+def main(argv):
+    out = argv[0]
+    os.makedirs(out, exist_ok=True)
+    for name, old, new in cases():
+        delta = fwupdate_tool.make_delta(old, new)
+        for ext, data in (("old", old), ("new", new), ("delta", delta)):
+            with open(os.path.join(out, "%s.%s" % (name, ext)), "wb") as f:
+                f.write(data)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
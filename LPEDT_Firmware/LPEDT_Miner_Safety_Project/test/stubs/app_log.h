@@ -0,0 +1,16 @@
+// Host stand-in for the Gecko SDK header of the same name, VCOM is stdout.
+// What was written is also kept for the tests to look at.
+#ifndef TEST_STUBS_APP_LOG_H_
+#define TEST_STUBS_APP_LOG_H_
+
+#include <stdio.h>
+
+#define app_log(...)  host_log(__VA_ARGS__)
+
+void host_log(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+// Everything written since the last host_log_clear(), starts over past 4 kB
+const char *host_log_text(void);
+void host_log_clear(void);
+
+#endif /* TEST_STUBS_APP_LOG_H_ */
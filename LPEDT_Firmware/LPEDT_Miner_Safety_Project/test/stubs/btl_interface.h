@@ -0,0 +1,31 @@
+// Host stand-in for the Gecko bootloader interface, the tests run without
+// a storage slot unless they define one
+#ifndef TEST_STUBS_BTL_INTERFACE_H_
+#define TEST_STUBS_BTL_INTERFACE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define BOOTLOADER_OK                  (0)
+#define BOOTLOADER_ERROR_STORAGE_BASE  (0x0400)
+
+typedef struct {
+  uint32_t numStorageSlots;
+} BootloaderStorageInformation_t;
+
+typedef struct {
+  uint32_t address;
+  uint32_t length;
+} BootloaderStorageSlot_t;
+
+typedef void (*BootloaderParserCallback_t)(uint32_t address, uint8_t *data, size_t length, void *context);
+
+int32_t bootloader_init(void);
+void    bootloader_getStorageInfo(BootloaderStorageInformation_t *info);
+int32_t bootloader_getStorageSlotInfo(uint32_t slotId, BootloaderStorageSlot_t *slot);
+int32_t bootloader_eraseWriteStorage(uint32_t slotId, uint32_t offset, uint8_t *buffer, size_t length);
+int32_t bootloader_verifyImage(uint32_t slotId, BootloaderParserCallback_t metadataCallback);
+int32_t bootloader_setImageToBootload(int32_t slotId);
+void    bootloader_rebootAndInstall(void);
+
+#endif /* TEST_STUBS_BTL_INTERFACE_H_ */
@@ -0,0 +1,24 @@
+// Host stand-in for the DMA driver header of the same name, the calls the
+// modules under test use. Each test defines the calls it reaches.
+#ifndef TEST_STUBS_DMADRV_H_
+#define TEST_STUBS_DMADRV_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "em_ldma.h"
+
+typedef uint32_t Ecode_t;
+
+#define ECODE_EMDRV_DMADRV_OK                   (0x00000000UL)
+#define ECODE_EMDRV_DMADRV_ALREADY_INITIALIZED  (0x04000003UL)
+
+typedef bool (*DMADRV_Callback_t)(unsigned int channel, unsigned int sequenceNo, void *userParam);
+
+Ecode_t DMADRV_Init(void);
+Ecode_t DMADRV_AllocateChannel(unsigned int *channelId, void *capabilities);
+Ecode_t DMADRV_LdmaStartTransfer(int channelId, LDMA_TransferCfg_t *transfer,
+                                 LDMA_Descriptor_t *descriptor,
+                                 DMADRV_Callback_t callback, void *cbUserParam);
+Ecode_t DMADRV_StopTransfer(unsigned int channelId);
+
+#endif /* TEST_STUBS_DMADRV_H_ */
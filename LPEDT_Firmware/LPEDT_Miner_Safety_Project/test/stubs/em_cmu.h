@@ -0,0 +1,38 @@
+// Host stand-in for the emlib header of the same name, the clocks the modules
+// under test use. Each test defines the calls it reaches.
+#ifndef TEST_STUBS_EM_CMU_H_
+#define TEST_STUBS_EM_CMU_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "em_device.h"
+
+typedef enum {
+  cmuClock_TIMER0,
+  cmuClock_TIMER1,
+  cmuClock_ADC0,
+  cmuClock_ADC0ASYNC,
+  cmuClock_PRS,
+  cmuClock_LETIMER0,
+} CMU_Clock_TypeDef;
+
+typedef enum {
+  cmuOsc_LFXO,
+  cmuOsc_ULFRCO,
+} CMU_Osc_TypeDef;
+
+typedef enum {
+  cmuSelect_AUXHFRCO,
+} CMU_Select_TypeDef;
+
+typedef enum {
+  cmuAUXHFRCOFreq_4M0Hz = 4000000,
+} CMU_AUXHFRCOFreq_TypeDef;
+
+void CMU_ClockEnable(CMU_Clock_TypeDef clock, bool enable);
+uint32_t CMU_ClockFreqGet(CMU_Clock_TypeDef clock);
+void CMU_ClockSelectSet(CMU_Clock_TypeDef clock, CMU_Select_TypeDef ref);
+void CMU_AUXHFRCOBandSet(CMU_AUXHFRCOFreq_TypeDef setFreq);
+void CMU_OscillatorEnable(CMU_Osc_TypeDef osc, bool enable, bool wait);
+
+#endif /* TEST_STUBS_EM_CMU_H_ */
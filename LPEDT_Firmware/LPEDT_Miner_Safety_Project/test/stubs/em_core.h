@@ -0,0 +1,10 @@
+// Host stand-in for the emlib header of the same name, the tests run on one
+// thread so a critical section has nothing to mask
+#ifndef TEST_STUBS_EM_CORE_H_
+#define TEST_STUBS_EM_CORE_H_
+
+#define CORE_DECLARE_IRQ_STATE
+#define CORE_ENTER_CRITICAL()
+#define CORE_EXIT_CRITICAL()
+
+#endif /* TEST_STUBS_EM_CORE_H_ */
@@ -0,0 +1,170 @@
+// Host stand-in for the device header of the EFR32BG13, the flash geometry,
+// the information pages, the peripherals and the CMSIS barrier the modules
+// under test use. A host process cannot map address 0, the flash starts where
+// a test can map it. A test that reads the user data page or DEVINFO maps
+// them. A peripheral is a plain struct the test that drives it defines.
+#ifndef TEST_STUBS_EM_DEVICE_H_
+#define TEST_STUBS_EM_DEVICE_H_
+
+#include <stdint.h>
+
+#define FLASH_BASE        (0x10000000UL)
+#define FLASH_SIZE        (0x00080000UL)
+#define FLASH_PAGE_SIZE   (2048)
+
+#define USERDATA_BASE     (0x0FE00000UL)
+#define DEVINFO_BASE      (0x0FE081B0UL)
+
+// Only the fields the modules read
+typedef struct {
+  uint32_t UNIQUEL;
+  uint32_t UNIQUEH;
+  uint32_t ADC0CAL0;
+} DEVINFO_TypeDef;
+
+#define DEVINFO           ((DEVINFO_TypeDef *) DEVINFO_BASE)
+
+#define _DEVINFO_ADC0CAL0_OFFSET2V5_MASK        0xF0000UL
+#define _DEVINFO_ADC0CAL0_OFFSET2V5_SHIFT       16
+#define _DEVINFO_ADC0CAL0_NEGSEOFFSET2V5_MASK   0xF00000UL
+#define _DEVINFO_ADC0CAL0_NEGSEOFFSET2V5_SHIFT  20
+#define _DEVINFO_ADC0CAL0_GAIN2V5_MASK          0x7F000000UL
+#define _DEVINFO_ADC0CAL0_GAIN2V5_SHIFT         24
+
+// Interrupts, the tests call the handlers themselves
+typedef enum {
+  ADC0_IRQn = 14,
+  LETIMER0_IRQn = 27,
+} IRQn_Type;
+
+#define NVIC_ClearPendingIRQ(irq)   ((void) (irq))
+#define NVIC_EnableIRQ(irq)         ((void) (irq))
+
+// TIMER, only the registers the modules use, in the order of the device
+typedef struct {
+  volatile uint32_t CTRL;
+  volatile uint32_t CCV;
+  volatile uint32_t CCVP;
+  volatile uint32_t CCVB;
+} TIMER_CC_TypeDef;
+
+typedef struct {
+  volatile uint32_t CTRL;
+  volatile uint32_t CMD;
+  volatile uint32_t TOP;
+  volatile uint32_t TOPB;
+  volatile uint32_t CNT;
+  volatile uint32_t ROUTEPEN;
+  volatile uint32_t ROUTELOC0;
+  TIMER_CC_TypeDef  CC[4];
+} TIMER_TypeDef;
+
+extern TIMER_TypeDef hostTimer0;
+extern TIMER_TypeDef hostTimer1;
+
+#define TIMER0            (&hostTimer0)
+#define TIMER1            (&hostTimer1)
+
+#define TIMER_CTRL_MODE_UP                (0x0UL << 0)
+#define TIMER_CTRL_DMACLRACT              (0x1UL << 7)
+#define TIMER_CTRL_CLKSEL_PRESCHFPERCLK   (0x0UL << 16)
+#define TIMER_CTRL_PRESC_DIV1             (0x0UL << 24)
+#define TIMER_CTRL_PRESC_DIV1024          (0xAUL << 24)
+#define TIMER_CMD_START                   (0x1UL << 0)
+#define TIMER_CMD_STOP                    (0x1UL << 1)
+#define TIMER_ROUTEPEN_CC0PEN             (0x1UL << 0)
+#define _TIMER_ROUTELOC0_CC0LOC_SHIFT     0
+#define _TIMER_ROUTELOC0_CC0LOC_LOC18     0x00000012UL
+#define TIMER_CC_CTRL_MODE_PWM            (0x3UL << 0)
+
+// CMU, the oscillator status
+typedef struct {
+  volatile uint32_t STATUS;
+} CMU_TypeDef;
+
+extern CMU_TypeDef hostCmu;
+
+#define CMU               (&hostCmu)
+
+#define CMU_STATUS_LFXORDY                  (0x1UL << 9)
+
+// LETIMER, only the registers the modules use
+typedef struct {
+  volatile uint32_t CNT;
+  volatile uint32_t COMP0;
+  volatile uint32_t COMP1;
+  volatile uint32_t IFC;
+  volatile uint32_t IEN;
+} LETIMER_TypeDef;
+
+extern LETIMER_TypeDef hostLetimer0;
+
+#define LETIMER0          (&hostLetimer0)
+
+#define LETIMER_IEN_COMP1                   (0x1UL << 1)
+#define LETIMER_IEN_UF                      (0x1UL << 2)
+
+// CRYOTIMER, only the registers the modules use
+typedef struct {
+  volatile uint32_t CTRL;
+  volatile uint32_t PERIODSEL;
+  volatile uint32_t IEN;
+  volatile uint32_t EM4WUEN;
+} CRYOTIMER_TypeDef;
+
+extern CRYOTIMER_TypeDef hostCryotimer;
+
+#define CRYOTIMER         (&hostCryotimer)
+
+#define CRYOTIMER_CTRL_EN                   (0x1UL << 0)
+#define CRYOTIMER_CTRL_DEBUGRUN             (0x1UL << 1)
+#define CRYOTIMER_CTRL_PRESC_DIV1           (0x0UL << 5)
+
+// ADC, only the registers the modules use
+typedef struct {
+  volatile uint32_t CTRL;
+  volatile uint32_t SINGLECTRL;
+  volatile uint32_t SINGLECTRLX;
+  volatile uint32_t CMPTHR;
+  volatile uint32_t CAL;
+  volatile uint32_t IFC;
+  volatile uint32_t IEN;
+  volatile uint32_t SINGLEDATA;
+  volatile uint32_t SINGLEFIFOCLEAR;
+} ADC_TypeDef;
+
+extern ADC_TypeDef hostAdc0;
+
+#define ADC0              (&hostAdc0)
+
+#define ADC_CTRL_WARMUPMODE_NORMAL          (0x0UL << 0)
+#define ADC_CTRL_SINGLEDMAWU                (0x1UL << 2)
+#define ADC_CTRL_ASYNCCLKEN_ASNEEDED        (0x0UL << 6)
+#define ADC_CTRL_ADCCLKMODE_ASYNC           (0x1UL << 7)
+#define _ADC_CTRL_TIMEBASE_SHIFT            16
+#define ADC_SINGLECTRL_RES_12BIT            (0x0UL << 3)
+#define ADC_SINGLECTRL_REF_2V5              (0x1UL << 5)
+#define ADC_SINGLECTRL_POSSEL_APORT3YCH3    (0x63UL << 8)
+#define ADC_SINGLECTRL_NEGSEL_VSS           (0xFFUL << 16)
+#define ADC_SINGLECTRL_AT_256CYCLES         (0x9UL << 24)
+#define ADC_SINGLECTRL_PRSEN                (0x1UL << 29)
+#define ADC_SINGLECTRL_CMPEN                (0x1UL << 31)
+#define ADC_SINGLECTRLX_FIFOOFACT_OVERWRITE (0x1UL << 14)
+#define ADC_SINGLECTRLX_PRSMODE_PULSED      (0x0UL << 16)
+#define _ADC_SINGLECTRLX_PRSSEL_SHIFT       17
+#define _ADC_CMPTHR_ADLT_SHIFT              0
+#define _ADC_CMPTHR_ADGT_SHIFT              16
+#define _ADC_CAL_SINGLEOFFSET_MASK          0xFUL
+#define _ADC_CAL_SINGLEOFFSET_SHIFT         0
+#define _ADC_CAL_SINGLEOFFSETINV_MASK       0xF0UL
+#define _ADC_CAL_SINGLEOFFSETINV_SHIFT      4
+#define _ADC_CAL_SINGLEGAIN_MASK            0x7F00UL
+#define _ADC_CAL_SINGLEGAIN_SHIFT           8
+#define ADC_SINGLEFIFOCLEAR_SINGLEFIFOCLEAR (0x1UL << 0)
+#define _ADC_IFC_MASK                       0x3F030F00UL
+#define ADC_IFC_SINGLECMP                   (0x1UL << 16)
+#define ADC_IEN_SINGLECMP                   (0x1UL << 16)
+
+#define __DMB()           __sync_synchronize()
+
+#endif /* TEST_STUBS_EM_DEVICE_H_ */
@@ -0,0 +1,29 @@
+// Host stand-in for the emlib header of the same name, the pin calls the
+// modules under test use. Each test defines the calls it reaches.
+#ifndef TEST_STUBS_EM_GPIO_H_
+#define TEST_STUBS_EM_GPIO_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+  gpioPortA = 0,
+  gpioPortB = 1,
+  gpioPortC = 2,
+  gpioPortD = 3,
+  gpioPortF = 5,
+} GPIO_Port_TypeDef;
+
+typedef enum {
+  gpioModeDisabled        = 0,
+  gpioModeInputPullFilter = 3,
+  gpioModePushPull        = 4,
+} GPIO_Mode_TypeDef;
+
+void GPIO_PinModeSet(GPIO_Port_TypeDef port, unsigned int pin, GPIO_Mode_TypeDef mode, unsigned int out);
+void GPIO_PinOutClear(GPIO_Port_TypeDef port, unsigned int pin);
+unsigned int GPIO_PinInGet(GPIO_Port_TypeDef port, unsigned int pin);
+void GPIO_ExtIntConfig(GPIO_Port_TypeDef port, unsigned int pin, unsigned int intNo,
+                       bool risingEdge, bool fallingEdge, bool enable);
+
+#endif /* TEST_STUBS_EM_GPIO_H_ */
@@ -0,0 +1,102 @@
+// Host stand-in for the emlib header of the same name: the descriptor layout
+// of the LDMA and the initializers the modules under test use. A descriptor
+// holds 32 bit addresses, a test that walks a chain links without PIE so
+// that its data sits below 4 GB.
+#ifndef TEST_STUBS_EM_LDMA_H_
+#define TEST_STUBS_EM_LDMA_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+  ldmaCtrlStructTypeXfer  = 0,
+  ldmaCtrlStructTypeSync  = 1,
+  ldmaCtrlStructTypeWrite = 2,
+} LDMA_CtrlStructType_t;
+
+typedef enum {
+  ldmaCtrlSizeByte = 0,
+  ldmaCtrlSizeHalf = 1,
+  ldmaCtrlSizeWord = 2,
+} LDMA_CtrlSize_t;
+
+typedef enum {
+  ldmaCtrlSrcIncOne  = 0,
+  ldmaCtrlSrcIncNone = 3,
+} LDMA_CtrlSrcInc_t;
+
+typedef enum {
+  ldmaCtrlDstIncOne  = 0,
+  ldmaCtrlDstIncNone = 3,
+} LDMA_CtrlDstInc_t;
+
+typedef enum {
+  ldmaLinkModeAbs = 0,
+  ldmaLinkModeRel = 1,
+} LDMA_LinkMode_t;
+
+typedef enum {
+  ldmaPeripheralSignal_NONE,
+  ldmaPeripheralSignal_TIMER0_UFOF,
+  ldmaPeripheralSignal_ADC0_SINGLE,
+} LDMA_PeripheralSignal_t;
+
+// The control word is the same in every descriptor type
+#define LDMA_DESCRIPTOR_CTRL_FIELDS \
+  uint32_t  structType : 2;   \
+  uint32_t  reserved0  : 1;   \
+  uint32_t  structReq  : 1;   \
+  uint32_t  xferCnt    : 11;  \
+  uint32_t  byteSwap   : 1;   \
+  uint32_t  blockSize  : 4;   \
+  uint32_t  doneIfs    : 1;   \
+  uint32_t  reqMode    : 1;   \
+  uint32_t  decLoopCnt : 1;   \
+  uint32_t  ignoreSrec : 1;   \
+  uint32_t  srcInc     : 2;   \
+  uint32_t  size       : 2;   \
+  uint32_t  dstInc     : 2;   \
+  uint32_t  srcAddrMode : 1;  \
+  uint32_t  dstAddrMode : 1;
+
+typedef union {
+  struct {
+    LDMA_DESCRIPTOR_CTRL_FIELDS
+    uint32_t  srcAddr;
+    uint32_t  dstAddr;
+    uint32_t  linkMode   : 1;
+    uint32_t  link       : 1;
+    int32_t   linkAddr   : 30;
+  } xfer;
+
+  struct {
+    LDMA_DESCRIPTOR_CTRL_FIELDS
+    uint32_t  immVal;
+    uint32_t  dstAddr;
+    uint32_t  linkMode   : 1;
+    uint32_t  link       : 1;
+    int32_t   linkAddr   : 30;
+  } wri;
+} LDMA_Descriptor_t;
+
+typedef struct {
+  LDMA_PeripheralSignal_t ldmaReqSel;
+} LDMA_TransferCfg_t;
+
+#define LDMA_TRANSFER_CFG_PERIPHERAL(signal)  { signal }
+
+#define LDMA_DESCRIPTOR_SINGLE_P2M_BYTE(src, dest, count) \
+  { .xfer = { .structType = ldmaCtrlStructTypeXfer, .xferCnt = (count) - 1, .doneIfs = 1,     \
+              .srcInc = ldmaCtrlSrcIncNone, .size = ldmaCtrlSizeByte, .dstInc = ldmaCtrlDstIncOne, \
+              .srcAddr = (uint32_t)(src), .dstAddr = (uint32_t)(dest) } }
+
+#define LDMA_DESCRIPTOR_SINGLE_M2P_BYTE(src, dest, count) \
+  { .xfer = { .structType = ldmaCtrlStructTypeXfer, .xferCnt = (count) - 1, .doneIfs = 1,     \
+              .srcInc = ldmaCtrlSrcIncOne, .size = ldmaCtrlSizeByte, .dstInc = ldmaCtrlDstIncNone, \
+              .srcAddr = (uint32_t)(src), .dstAddr = (uint32_t)(dest) } }
+
+#define LDMA_DESCRIPTOR_SINGLE_WRITE(value, address) \
+  { .wri = { .structType = ldmaCtrlStructTypeWrite, .structReq = 1, .doneIfs = 1, \
+             .immVal = (value), .dstAddr = (uint32_t)(address) } }
+
+#endif /* TEST_STUBS_EM_LDMA_H_ */
@@ -0,0 +1,52 @@
+// Host stand-in for the emlib header of the same name, the LETIMER calls the
+// modules under test use. Each test defines the calls it reaches.
+#ifndef TEST_STUBS_EM_LETIMER_H_
+#define TEST_STUBS_EM_LETIMER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "em_device.h"
+
+typedef enum {
+  letimerRepeatFree,
+  letimerRepeatOneshot,
+  letimerRepeatBuffered,
+  letimerRepeatDouble,
+} LETIMER_RepeatMode_TypeDef;
+
+typedef enum {
+  letimerUFOANone,
+  letimerUFOAToggle,
+  letimerUFOAPulse,
+  letimerUFOAPwm,
+} LETIMER_UFOA_TypeDef;
+
+typedef struct {
+  bool                       enable;
+  bool                       debugRun;
+  bool                       comp0Top;
+  bool                       bufTop;
+  uint8_t                    out0Pol;
+  uint8_t                    out1Pol;
+  LETIMER_UFOA_TypeDef       ufoa0;
+  LETIMER_UFOA_TypeDef       ufoa1;
+  LETIMER_RepeatMode_TypeDef repMode;
+  uint32_t                   topValue;
+} LETIMER_Init_TypeDef;
+
+uint32_t LETIMER_CompareGet(LETIMER_TypeDef *letimer, unsigned int comp);
+void LETIMER_CompareSet(LETIMER_TypeDef *letimer, unsigned int comp, uint32_t value);
+uint32_t LETIMER_CounterGet(LETIMER_TypeDef *letimer);
+void LETIMER_CounterSet(LETIMER_TypeDef *letimer, uint32_t value);
+void LETIMER_Enable(LETIMER_TypeDef *letimer, bool enable);
+void LETIMER_Init(LETIMER_TypeDef *letimer, const LETIMER_Init_TypeDef *init);
+
+static inline void LETIMER_IntClear(LETIMER_TypeDef *letimer, uint32_t flags) {
+  letimer->IFC = flags;
+}
+
+static inline void LETIMER_IntEnable(LETIMER_TypeDef *letimer, uint32_t flags) {
+  letimer->IEN |= flags;
+}
+
+#endif /* TEST_STUBS_EM_LETIMER_H_ */
@@ -0,0 +1,20 @@
+// Host stand-in for the emlib header of the same name, each test provides
+// the flash it simulates
+#ifndef TEST_STUBS_EM_MSC_H_
+#define TEST_STUBS_EM_MSC_H_
+
+#include <stdint.h>
+
+typedef enum {
+  mscReturnOk          = 0,
+  mscReturnInvalidAddr = -1,
+  mscReturnLocked      = -2,
+  mscReturnTimeOut     = -3,
+  mscReturnUnaligned   = -4,
+} MSC_Status_TypeDef;
+
+void               MSC_Init(void);
+MSC_Status_TypeDef MSC_ErasePage(uint32_t *startAddress);
+MSC_Status_TypeDef MSC_WriteWord(uint32_t *address, void const *data, uint32_t numBytes);
+
+#endif /* TEST_STUBS_EM_MSC_H_ */
@@ -0,0 +1,13 @@
+// Host stand-in for the emlib header of the same name, the channel routing
+// the modules under test use. Each test defines the calls it reaches.
+#ifndef TEST_STUBS_EM_PRS_H_
+#define TEST_STUBS_EM_PRS_H_
+
+#include <stdint.h>
+
+#define PRS_CH_CTRL_SOURCESEL_LETIMER0    (0x0EUL << 8)
+#define PRS_CH_CTRL_SIGSEL_LETIMER0CH0    (0x00UL << 0)
+
+void PRS_SourceAsyncSignalSet(unsigned int ch, uint32_t source, uint32_t signal);
+
+#endif /* TEST_STUBS_EM_PRS_H_ */
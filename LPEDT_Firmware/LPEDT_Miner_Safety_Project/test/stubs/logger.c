@@ -0,0 +1,50 @@
+// Host stand-in for the logger of log.c, every message up to the verbosity
+// is printed and kept for host_log_text()
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include "log.h"
+
+#define HOST_LOG_SIZE (4096)
+
+static uint32_t verbosity = LOG_LEVEL_INFO;
+static char     text[HOST_LOG_SIZE];
+static size_t   length = 0;
+
+uint32_t loggerGetTimestamp(void) {
+  return 0;
+}
+
+uint32_t loggerGetVerbosity(void) {
+  return verbosity;
+}
+
+void loggerSetVerbosity(uint32_t level) {
+  verbosity = level;
+}
+
+void host_log(const char *format, ...) {
+  char    line[512];
+  size_t  n;
+  va_list args;
+
+  va_start(args, format);
+  vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+  fputs(line, stdout);
+
+  n = strlen(line);
+  if(length + n >= HOST_LOG_SIZE)
+    length = 0;
+  memcpy(&text[length], line, n + 1);
+  length += n;
+}
+
+const char *host_log_text(void) {
+  return text;
+}
+
+void host_log_clear(void) {
+  length = 0;
+  text[0] = '\0';
+}
@@ -0,0 +1,39 @@
+// Host stand-in for the PSA crypto API header, the key attributes and
+// identifiers seal.c passes to the CRYPTO driver
+#ifndef TEST_STUBS_PSA_CRYPTO_H_
+#define TEST_STUBS_PSA_CRYPTO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef int32_t  psa_status_t;
+typedef uint32_t psa_algorithm_t;
+typedef uint16_t psa_key_type_t;
+
+#define PSA_SUCCESS                 ((psa_status_t) 0)
+#define PSA_ERROR_NOT_SUPPORTED     ((psa_status_t) -134)
+#define PSA_ERROR_INVALID_ARGUMENT  ((psa_status_t) -135)
+
+#define PSA_KEY_TYPE_AES            ((psa_key_type_t) 0x2400)
+#define PSA_ALG_CCM                 ((psa_algorithm_t) 0x05500100)
+#define PSA_ALG_ECB_NO_PADDING      ((psa_algorithm_t) 0x04404400)
+
+typedef struct {
+  psa_key_type_t type;
+  size_t         bits;
+} psa_key_attributes_t;
+
+static inline psa_key_attributes_t psa_key_attributes_init(void) {
+  psa_key_attributes_t attributes = { 0, 0 };
+  return attributes;
+}
+
+static inline void psa_set_key_type(psa_key_attributes_t *attributes, psa_key_type_t type) {
+  attributes->type = type;
+}
+
+static inline void psa_set_key_bits(psa_key_attributes_t *attributes, size_t bits) {
+  attributes->bits = bits;
+}
+
+#endif /* TEST_STUBS_PSA_CRYPTO_H_ */
@@ -0,0 +1,7 @@
+// Host stand-in for the Gecko SDK header of the same name
+#ifndef TEST_STUBS_SL_BLUETOOTH_H_
+#define TEST_STUBS_SL_BLUETOOTH_H_
+
+#include "sl_bt_api.h"
+
+#endif /* TEST_STUBS_SL_BLUETOOTH_H_ */
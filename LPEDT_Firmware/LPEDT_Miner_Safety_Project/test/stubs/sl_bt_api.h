@@ -0,0 +1,121 @@
+// Host stand-in for the Gecko SDK header of the same name, the types and
+// calls the modules under test use. Each test defines the calls it reaches.
+#ifndef TEST_STUBS_SL_BT_API_H_
+#define TEST_STUBS_SL_BT_API_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "sl_status.h"
+
+typedef struct {
+  uint8_t addr[6];
+} bd_addr;
+
+typedef struct {
+  uint8_t len;
+  uint8_t data[];
+} uint8array;
+
+typedef enum {
+  sl_bt_gap_1m_phy    = 0x1,
+} sl_bt_gap_phy_t;
+
+typedef enum {
+  sl_bt_gap_phy_1m    = 0x1,
+} sl_bt_gap_phy_type_t;
+
+typedef enum {
+  sl_bt_scanner_discover_limited     = 0x0,
+  sl_bt_scanner_discover_generic     = 0x1,
+  sl_bt_scanner_discover_observation = 0x2,
+} sl_bt_scanner_discover_mode_t;
+
+typedef enum {
+  sl_bt_connection_mode1_level1 = 0x0,
+  sl_bt_connection_mode1_level2 = 0x1,
+  sl_bt_connection_mode1_level3 = 0x2,
+  sl_bt_connection_mode1_level4 = 0x3,
+} sl_bt_connection_security_t;
+
+typedef enum {
+  sl_bt_advertiser_non_connectable = 0x0,
+} sl_bt_advertiser_connectable_mode_t;
+
+typedef enum {
+  sl_bt_advertiser_user_data = 0x4,
+} sl_bt_advertiser_discoverable_mode_t;
+
+#define SL_BT_INVALID_BONDING_HANDLE ((uint8_t)0xFF)
+
+typedef struct {
+  uint8_t    packet_type;
+  bd_addr    address;
+  uint8_t    address_type;
+  uint8_t    bonding;
+  uint8_t    primary_phy;
+  uint8_t    secondary_phy;
+  uint8_t    adv_sid;
+  int8_t     tx_power;
+  int8_t     rssi;
+  uint8_t    channel;
+  uint16_t   periodic_interval;
+  uint8array data;
+} sl_bt_evt_scanner_scan_report_t;
+
+typedef struct sl_bt_msg sl_bt_msg_t;
+
+sl_status_t sl_bt_external_signal(uint32_t signals);
+sl_status_t sl_bt_system_set_soft_timer(uint32_t time, uint8_t handle, uint8_t single_shot);
+sl_status_t sl_bt_nvm_save(uint16_t key, size_t value_len, const uint8_t* value);
+sl_status_t sl_bt_nvm_load(uint16_t key, size_t max_value_size, size_t *value_len, uint8_t *value);
+sl_status_t sl_bt_nvm_erase(uint16_t key);
+sl_status_t sl_bt_advertiser_create_set(uint8_t *handle);
+sl_status_t sl_bt_advertiser_set_timing(uint8_t handle,
+                                        uint32_t interval_min,
+                                        uint32_t interval_max,
+                                        uint16_t duration,
+                                        uint8_t maxevents);
+sl_status_t sl_bt_advertiser_set_data(uint8_t handle,
+                                      uint8_t packet_type,
+                                      size_t adv_data_len,
+                                      const uint8_t* adv_data);
+sl_status_t sl_bt_advertiser_start(uint8_t handle,
+                                   uint8_t discover,
+                                   uint8_t connect);
+sl_status_t sl_bt_advertiser_stop(uint8_t handle);
+sl_status_t sl_bt_scanner_set_mode(uint8_t phys, uint8_t scan_mode);
+sl_status_t sl_bt_scanner_set_timing(uint8_t phys, uint16_t scan_interval, uint16_t scan_window);
+sl_status_t sl_bt_scanner_start(uint8_t scanning_phy, uint8_t discover_mode);
+sl_status_t sl_bt_scanner_stop(void);
+sl_status_t sl_bt_connection_open(bd_addr address,
+                                  uint8_t address_type,
+                                  uint8_t initiating_phy,
+                                  uint8_t *connection);
+sl_status_t sl_bt_connection_close(uint8_t connection);
+sl_status_t sl_bt_connection_set_parameters(uint8_t connection,
+                                            uint16_t min_interval,
+                                            uint16_t max_interval,
+                                            uint16_t latency,
+                                            uint16_t timeout,
+                                            uint16_t min_ce_length,
+                                            uint16_t max_ce_length);
+sl_status_t sl_bt_sm_delete_bondings(void);
+sl_status_t sl_bt_sm_store_bonding_configuration(uint8_t max_bonding_count, uint8_t policy_flags);
+sl_status_t sl_bt_sm_set_bondable_mode(uint8_t bondable);
+sl_status_t sl_bt_sm_increase_security(uint8_t connection);
+sl_status_t sl_bt_gatt_server_send_notification(uint8_t connection,
+                                                uint16_t characteristic,
+                                                size_t value_len,
+                                                const uint8_t* value);
+sl_status_t sl_bt_gatt_server_send_user_write_response(uint8_t connection,
+                                                       uint16_t characteristic,
+                                                       uint8_t att_errorcode);
+sl_status_t sl_bt_gatt_server_send_user_read_response(uint8_t connection,
+                                                      uint16_t characteristic,
+                                                      uint8_t att_errorcode,
+                                                      size_t value_len,
+                                                      const uint8_t* value,
+                                                      uint16_t *sent_len);
+
+#endif /* TEST_STUBS_SL_BT_API_H_ */
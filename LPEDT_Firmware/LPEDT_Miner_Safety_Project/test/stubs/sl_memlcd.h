@@ -0,0 +1,28 @@
+// Host stand-in for the Gecko SDK header of the same name, the device and
+// the calls the modules under test use. Each test defines the calls it
+// reaches.
+#ifndef TEST_STUBS_SL_MEMLCD_H_
+#define TEST_STUBS_SL_MEMLCD_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sl_status.h"
+
+typedef struct sl_memlcd_t {
+  unsigned short width;
+  unsigned short height;
+  uint8_t bpp;
+  uint8_t color_mode;
+  int spi_freq;
+  uint8_t extcomin_freq;
+  uint8_t setup_us;
+  uint8_t hold_us;
+} sl_memlcd_t;
+
+sl_status_t sl_memlcd_draw(const struct sl_memlcd_t *device,
+                           const void *data,
+                           unsigned int row_start,
+                           unsigned int row_count);
+const sl_memlcd_t *sl_memlcd_get(void);
+
+#endif /* TEST_STUBS_SL_MEMLCD_H_ */
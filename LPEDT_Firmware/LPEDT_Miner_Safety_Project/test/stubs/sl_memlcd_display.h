@@ -0,0 +1,15 @@
+// Host stand-in for the Gecko SDK header of the same name, the Sharp
+// LS013B7DH03 of the board
+#ifndef TEST_STUBS_SL_MEMLCD_DISPLAY_H_
+#define TEST_STUBS_SL_MEMLCD_DISPLAY_H_
+
+#include "sl_status.h"
+
+#define SL_MEMLCD_DISPLAY_WIDTH           128
+#define SL_MEMLCD_DISPLAY_HEIGHT          128
+#define SL_MEMLCD_DISPLAY_BPP             1
+#define SL_MEMLCD_SCLK_FREQ               1100000
+
+sl_status_t sl_memlcd_init(void);
+
+#endif /* TEST_STUBS_SL_MEMLCD_DISPLAY_H_ */
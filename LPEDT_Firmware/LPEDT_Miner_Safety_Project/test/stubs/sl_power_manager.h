@@ -0,0 +1,38 @@
+// Host stand-in for the Gecko SDK header of the same name, the requirements
+// and transition events the modules under test use. Each test defines the
+// calls it reaches.
+#ifndef TEST_STUBS_SL_POWER_MANAGER_H_
+#define TEST_STUBS_SL_POWER_MANAGER_H_
+
+#include <stdint.h>
+
+#define SL_POWER_MANAGER_EVENT_TRANSITION_ENTERING_EM3     (1 << 6)
+#define SL_POWER_MANAGER_EVENT_TRANSITION_LEAVING_EM3      (1 << 7)
+
+typedef enum {
+  SL_POWER_MANAGER_EM0 = 0,
+  SL_POWER_MANAGER_EM1,
+  SL_POWER_MANAGER_EM2,
+  SL_POWER_MANAGER_EM3,
+} sl_power_manager_em_t;
+
+typedef uint32_t sl_power_manager_em_transition_event_t;
+
+typedef void (*sl_power_manager_em_transition_on_event_t)(sl_power_manager_em_t from,
+                                                          sl_power_manager_em_t to);
+
+typedef struct {
+  const sl_power_manager_em_transition_event_t    event_mask;
+  const sl_power_manager_em_transition_on_event_t on_event;
+} sl_power_manager_em_transition_event_info_t;
+
+typedef struct {
+  const sl_power_manager_em_transition_event_info_t *info;
+} sl_power_manager_em_transition_event_handle_t;
+
+void sl_power_manager_add_em_requirement(sl_power_manager_em_t em);
+void sl_power_manager_remove_em_requirement(sl_power_manager_em_t em);
+void sl_power_manager_subscribe_em_transition_event(sl_power_manager_em_transition_event_handle_t     *event_handle,
+                                                    const sl_power_manager_em_transition_event_info_t *event_info);
+
+#endif /* TEST_STUBS_SL_POWER_MANAGER_H_ */
@@ -0,0 +1,17 @@
+// Host stand-in for the Gecko SDK header of the same name, each test defines
+// the functions it needs on its own simulated clock
+#ifndef TEST_STUBS_SL_SLEEPTIMER_H_
+#define TEST_STUBS_SL_SLEEPTIMER_H_
+
+#include <stdint.h>
+#include "sl_status.h"
+
+uint32_t    sl_sleeptimer_get_tick_count(void);
+uint64_t    sl_sleeptimer_get_tick_count64(void);
+uint32_t    sl_sleeptimer_get_timer_frequency(void);
+uint32_t    sl_sleeptimer_ms_to_tick(uint16_t time_ms);
+uint32_t    sl_sleeptimer_tick_to_ms(uint32_t tick);
+sl_status_t sl_sleeptimer_get_remaining_time_of_first_timer(uint16_t option_flags, uint32_t *time);
+sl_status_t sl_sleeptimer_tick64_to_ms(uint64_t tick, uint64_t *ms);
+
+#endif /* TEST_STUBS_SL_SLEEPTIMER_H_ */
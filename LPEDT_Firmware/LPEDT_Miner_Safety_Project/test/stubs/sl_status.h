@@ -0,0 +1,14 @@
+// Host stand-in for the Gecko SDK header of the same name
+#ifndef TEST_STUBS_SL_STATUS_H_
+#define TEST_STUBS_SL_STATUS_H_
+
+#include <stdint.h>
+
+typedef uint32_t sl_status_t;
+
+#define SL_STATUS_OK              ((sl_status_t) 0x0000)
+#define SL_STATUS_FAIL            ((sl_status_t) 0x0001)
+#define SL_STATUS_NOT_FOUND       ((sl_status_t) 0x000E)
+#define SL_STATUS_NO_MORE_RESOURCE ((sl_status_t) 0x001A)
+
+#endif /* TEST_STUBS_SL_STATUS_H_ */
@@ -0,0 +1,7 @@
+// Host stand-in for the Gecko SDK header of the same name
+#ifndef TEST_STUBS_SLI_BT_GATTDB_DEF_H_
+#define TEST_STUBS_SLI_BT_GATTDB_DEF_H_
+
+typedef struct sli_bt_gattdb_s sli_bt_gattdb_t;
+
+#endif /* TEST_STUBS_SLI_BT_GATTDB_DEF_H_ */
@@ -0,0 +1,32 @@
+// Host stand-in for the transparent driver interface of the CRYPTO
+// peripheral, each test provides the driver calls it reaches
+#ifndef TEST_STUBS_SLI_CRYPTO_TRANSPARENT_FUNCTIONS_H_
+#define TEST_STUBS_SLI_CRYPTO_TRANSPARENT_FUNCTIONS_H_
+
+#include "psa/crypto.h"
+
+psa_status_t sli_crypto_transparent_cipher_encrypt(const psa_key_attributes_t *attributes,
+                                                   const uint8_t *key_buffer,
+                                                   size_t key_buffer_size,
+                                                   psa_algorithm_t alg,
+                                                   const uint8_t *input,
+                                                   size_t input_length,
+                                                   uint8_t *output,
+                                                   size_t output_size,
+                                                   size_t *output_length);
+
+psa_status_t sli_crypto_transparent_aead_encrypt(const psa_key_attributes_t *attributes,
+                                                 const uint8_t *key_buffer,
+                                                 size_t key_buffer_size,
+                                                 psa_algorithm_t alg,
+                                                 const uint8_t *nonce,
+                                                 size_t nonce_length,
+                                                 const uint8_t *additional_data,
+                                                 size_t additional_data_length,
+                                                 const uint8_t *plaintext,
+                                                 size_t plaintext_length,
+                                                 uint8_t *ciphertext,
+                                                 size_t ciphertext_size,
+                                                 size_t *ciphertext_length);
+
+#endif /* TEST_STUBS_SLI_CRYPTO_TRANSPARENT_FUNCTIONS_H_ */
@@ -0,0 +1,91 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    test.h
+ * @brief   Checks shared by the host tests. A failed check is printed and
+ *          counted, the test goes on and exits non-zero at the end.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#ifndef TEST_TEST_H_
+#define TEST_TEST_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+static int test_failures = 0;
+
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+      test_failures++; \
+    } \
+  } while (0)
+
+#define CHECK_EQ(a, b) \
+  do { \
+    long long va_ = (long long) (a); \
+    long long vb_ = (long long) (b); \
+    if (va_ != vb_) { \
+      printf("%s:%d: CHECK_EQ(%s, %s) failed, %lld != %lld\n", \
+             __FILE__, __LINE__, #a, #b, va_, vb_); \
+      test_failures++; \
+    } \
+  } while (0)
+
+// Runs one test function and names it when it failed
+#define RUN(test) \
+  do { \
+    int before_ = test_failures; \
+    test(); \
+    printf("%s %s\n", (test_failures == before_) ? "pass" : "FAIL", #test); \
+  } while (0)
+
+// Runs one test function in a child process, for modules whose static state
+// only a reboot clears
+#define RUN_FRESH(test) \
+  do { \
+    int status_ = 1; \
+    pid_t pid_; \
+    fflush(stdout); \
+    pid_ = fork(); \
+    if (pid_ == 0) { \
+      test(); \
+      fflush(stdout); \
+      _exit(test_failures != 0); \
+    } \
+    if ((pid_ < 0) || (waitpid(pid_, &status_, 0) != pid_) || \
+        !WIFEXITED(status_) || (WEXITSTATUS(status_) != 0)) \
+      test_failures++; \
+    printf("%s %s\n", (status_ == 0) ? "pass" : "FAIL", #test); \
+  } while (0)
+
+// Exit status of main()
+#define TEST_RESULT()  ((test_failures == 0) ? 0 : 1)
+
+/**
+ * @brief   Returns a monotonic time stamp for the benchmarks
+ * @return  ns
+ */
+static inline uint64_t test_now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t) ts.tv_sec * 1000000000u) + (uint64_t) ts.tv_nsec;
+}
+
+#endif /* TEST_TEST_H_ */
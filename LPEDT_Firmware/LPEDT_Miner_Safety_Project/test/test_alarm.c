@@ -0,0 +1,283 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    test_alarm.c
+ * @brief   Host test of alarm.c against the latency budget of alarm.h
+ *
+ *          alarm.c runs on a simulated sleeptimer. An SOS goes through every
+ *          stage with the worst case delays of the firmware and the Alarm
+ *          Latency characteristic it reports must show no stage over its
+ *          ALARM_BUDGET_*_MS. Lowering a budget below what the path needs,
+ *          or slowing the path, fails the test.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "alarm.h"
+#include "beacon.h"
+#include "buzzer.h"
+#include "connparams.h"
+#include "ble.h"
+#include "gatt_db.h"
+#include "sl_sleeptimer.h"
+
+#define TICK_HZ                (32768)
+
+// Idle connection interval, profiles[CONN_PROFILE_IDLE] of connparams.c. An
+// alarm indication goes out on the next connection event and the client
+// confirms it on the one after.
+#define IDLE_INTERVAL_MS       (400)
+
+static uint32_t           now = 0xFFFF0000;   // ticks, wraps during the tests
+static ble_data_struct_t  ble_data;
+static uint8_t            latency[ALARM_LATENCY_SIZE];
+static uint32_t           signals = 0;
+static bool               buzzerOn = false;
+static uint8_t            beaconAlarms = 0;
+static uint32_t           indications = 0;
+
+//------------------------------------------------------------------------------
+// Stand-ins for the rest of the firmware
+//------------------------------------------------------------------------------
+
+uint32_t sl_sleeptimer_get_tick_count(void) {
+  return now;
+}
+
+uint32_t sl_sleeptimer_get_timer_frequency(void) {
+  return TICK_HZ;
+}
+
+uint32_t sl_sleeptimer_ms_to_tick(uint16_t time_ms) {
+  return (uint32_t) (((uint64_t) time_ms * TICK_HZ + 999) / 1000);
+}
+
+sl_status_t sl_bt_external_signal(uint32_t bits) {
+  signals |= bits;
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_gatt_server_send_user_read_response(uint8_t connection,
+                                                      uint16_t characteristic,
+                                                      uint8_t att_errorcode,
+                                                      size_t value_len,
+                                                      const uint8_t* value,
+                                                      uint16_t *sent_len) {
+  (void) connection;
+  CHECK_EQ(characteristic, gattdb_alarm_latency);
+  CHECK_EQ(att_errorcode, 0);
+  CHECK_EQ(value_len, sizeof(latency));
+  memcpy(latency, value, sizeof(latency));
+  *sent_len = (uint16_t) value_len;
+  return SL_STATUS_OK;
+}
+
+ble_data_struct_t* get_ble_data_ptr() {
+  return &ble_data;
+}
+
+bool send_indication(queue_lane_t lane, uint16_t charHandle, uint32_t bufLength, uint8_t *buffer) {
+  (void) buffer;
+  CHECK_EQ(lane, QUEUE_LANE_ALARM);
+  CHECK_EQ(charHandle, gattdb_button_state);
+  CHECK_EQ(bufLength, 1);
+  indications++;
+  return false;
+}
+
+void buzzer_init(void) {
+  buzzerOn = false;
+}
+
+void buzzer_request(buzzer_pattern_t pattern, bool on) {
+  (void) pattern;
+  buzzerOn = on;
+}
+
+void beacon_set_alarm(beacon_alarm_t alarm, bool active) {
+  if(active)
+    beaconAlarms |= alarm;
+  else
+    beaconAlarms &= ~alarm;
+}
+
+void connparams_set_demand(conn_demand_t demand, bool active) {
+  (void) demand;
+  (void) active;
+}
+
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   Moves the simulated clock on
+ * @param   us      time to pass
+ * @return  none
+ */
+static void advance_us(uint32_t us) {
+  now += (uint32_t) (((uint64_t) us * TICK_HZ) / 1000000);
+}
+
+/**
+ * @brief   Reads the Alarm Latency characteristic of alarm.c
+ * @return  none
+ */
+static void read_latency(void) {
+  memset(latency, 0xFF, sizeof(latency));
+  alarm_read_latency(1, 0);
+}
+
+static uint32_t worst_us(alarm_stage_t stage) {
+  const uint8_t *p = &latency[ALARM_LATENCY_HEADER_SIZE + (stage * ALARM_STAGE_RECORD_SIZE)];
+  return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint32_t over_budget(alarm_stage_t stage) {
+  const uint8_t *p = &latency[ALARM_LATENCY_HEADER_SIZE + (stage * ALARM_STAGE_RECORD_SIZE)];
+  return (uint32_t) p[4] | ((uint32_t) p[5] << 8);
+}
+
+static uint32_t budget_ms(alarm_stage_t stage) {
+  switch(stage){
+    case ALARM_STAGE_BUZZER:     return ALARM_BUDGET_BUZZER_MS;
+    case ALARM_STAGE_DISPATCH:   return ALARM_BUDGET_DISPATCH_MS;
+    case ALARM_STAGE_BEACON:     return ALARM_BUDGET_BEACON_MS;
+    case ALARM_STAGE_INDICATION: return ALARM_BUDGET_INDICATION_MS;
+    case ALARM_STAGE_CONFIRMED:
+    default:                     return ALARM_BUDGET_CONFIRMED_MS;
+  }
+}
+
+/**
+ * @brief   Boots alarm.c on a bonded link with the button indications on
+ * @return  none
+ */
+static void setup(void) {
+  memset(&ble_data, 0, sizeof(ble_data));
+  ble_data.connection_open = true;
+  ble_data.ok_to_send_button_indications = true;
+  ble_data.bondingStatus = true;
+  signals = 0;
+  beaconAlarms = 0;
+  indications = 0;
+  alarm_init();
+}
+
+//------------------------------------------------------------------------------
+// Tests
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   An SOS on the worst case path of the firmware stays in budget
+ */
+static void test_sos_within_budget(void) {
+  alarm_stage_t stage;
+
+  setup();
+
+  // GPIO interrupt: the buzzer starts in the handler itself
+  alarm_from_isr(BEACON_ALARM_SOS, true);
+  CHECK(buzzerOn);
+  CHECK(signals & (1 << ALARM_BIT_POS));
+
+  // The BLE loop finishes the event in hand before it takes the signal
+  advance_us(2000);
+  alarm_dispatch();
+  CHECK_EQ(beaconAlarms, BEACON_ALARM_SOS);
+  CHECK_EQ(indications, 1);
+  CHECK(alarm_link_reserved());
+
+  // drain_indication_queue() hands it to the stack on the same pass
+  advance_us(500);
+  alarm_stamp(ALARM_STAGE_INDICATION);
+
+  // Out on the next idle connection event, confirmed on the one after
+  advance_us(2 * IDLE_INTERVAL_MS * 1000);
+  alarm_stamp(ALARM_STAGE_CONFIRMED);
+  CHECK(!alarm_link_reserved());
+
+  read_latency();
+  CHECK_EQ(latency[0], ALARM_LATENCY_FORMAT_VERSION);
+  CHECK_EQ(latency[1], ALARM_NUMBER_OF_STAGES);
+  CHECK_EQ(latency[2], ALARM_LATENCY_BUCKETS);
+  CHECK_EQ(latency[3], 1);
+  for(stage = 0; stage < ALARM_NUMBER_OF_STAGES; stage++){
+    if(worst_us(stage) > budget_ms(stage) * 1000)
+      printf("stage %u took %u us, budget %u ms\n",
+             (unsigned int) stage, (unsigned int) worst_us(stage), (unsigned int) budget_ms(stage));
+    CHECK_EQ(over_budget(stage), 0);
+  }
+}
+
+/**
+ * @brief   A stamp on the budget is in, one tick past it is counted over
+ */
+static void test_budget_edge(void) {
+  alarm_stage_t stage;
+  uint32_t      ticks;
+
+  for(stage = ALARM_STAGE_DISPATCH; stage < ALARM_NUMBER_OF_STAGES; stage++){
+    setup();
+    ticks = (budget_ms(stage) * TICK_HZ) / 1000;
+
+    alarm_from_isr(BEACON_ALARM_SOS, true);
+    now += ticks;
+    alarm_stamp(stage);
+
+    alarm_from_isr(BEACON_ALARM_SOS, false);
+    alarm_from_isr(BEACON_ALARM_SOS, true);
+    now += ticks + 1;
+    alarm_stamp(stage);
+
+    read_latency();
+    CHECK_EQ(latency[3], 2);
+    CHECK_EQ(over_budget(stage), 1);
+    CHECK(worst_us(stage) > budget_ms(stage) * 1000);
+    CHECK_EQ(over_budget(ALARM_STAGE_BUZZER), 0);
+  }
+}
+
+/**
+ * @brief   Only the first stamp of a stage counts
+ */
+static void test_first_stamp_counts(void) {
+  setup();
+
+  alarm_from_isr(BEACON_ALARM_SOS, true);
+  advance_us(1000);
+  alarm_stamp(ALARM_STAGE_DISPATCH);
+  advance_us((ALARM_BUDGET_DISPATCH_MS + 10) * 1000);
+  alarm_stamp(ALARM_STAGE_DISPATCH);
+
+  // A second source on top of an active one is a raise of its own
+  alarm_from_isr(BEACON_ALARM_GAS, true);
+  alarm_from_isr(BEACON_ALARM_GAS, false);
+  alarm_from_isr(BEACON_ALARM_SOS, false);
+
+  read_latency();
+  CHECK_EQ(latency[3], 2);
+  CHECK_EQ(over_budget(ALARM_STAGE_DISPATCH), 0);
+  CHECK(worst_us(ALARM_STAGE_DISPATCH) <= 1000);
+  CHECK(!buzzerOn);
+}
+
+int main(void) {
+  RUN(test_sos_within_budget);
+  RUN(test_budget_edge);
+  RUN(test_first_stamp_counts);
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,187 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    test_allowlist.c
+ * @brief   Host test and benchmark of allowlist.c
+ *
+ *          "test_allowlist bench" runs the scan report fast path on a mine
+ *          site mix, one enrolled helmet in every 100 reports, with the table
+ *          full, and prints the reports per second and the share the bloom
+ *          filter turned away on its own.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "allowlist.h"
+#include "ble_device_type.h"
+
+#define BENCH_REPORTS          (20000000)
+#define BENCH_MEMBER_EVERY     (100)
+
+static bd_addr helmets[ALLOWLIST_MAX_ENROLLED];
+
+/**
+ * @brief   Fills in a pseudo random address, the same sequence on every run
+ * @param   a       filled in
+ * @return  none
+ */
+static void random_address(bd_addr *a) {
+  static uint32_t x = 2463534242u;
+  uint32_t        i;
+
+  for(i = 0; i < sizeof(a->addr); i++){
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    a->addr[i] = (uint8_t) x;
+  }
+}
+
+/**
+ * @brief   Enrolls ALLOWLIST_MAX_ENROLLED helmets, short IDs from 1
+ * @return  none
+ */
+static void enroll_all(void) {
+  uint32_t i;
+
+  allowlist_clear();
+  for(i = 0; i < ALLOWLIST_MAX_ENROLLED; i++){
+    random_address(&helmets[i]);
+    CHECK(allowlist_add(&helmets[i], (uint16_t) (i + 1)) == false);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Tests
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   The boot table is enrolled
+ */
+static void test_boot_enrolment(void) {
+  const bd_addr server = SERVER_BT_ADDRESS;
+
+  allowlist_init();
+  CHECK(allowlist_count() >= 1);
+  CHECK_EQ(allowlist_short_id(&server), 1);
+  CHECK_EQ(allowlist_check(&server, 0), ALLOWLIST_ACCEPT);
+}
+
+/**
+ * @brief   Enrolment up to the load limit, every helmet found with its ID
+ */
+static void test_enrol_to_limit(void) {
+  bd_addr  extra;
+  uint32_t i;
+
+  enroll_all();
+  CHECK_EQ(allowlist_count(), ALLOWLIST_MAX_ENROLLED);
+  for(i = 0; i < ALLOWLIST_MAX_ENROLLED; i++)
+    CHECK_EQ(allowlist_short_id(&helmets[i]), i + 1);
+
+  random_address(&extra);
+  CHECK(allowlist_add(&extra, 999) == true);
+  CHECK_EQ(allowlist_short_id(&extra), 0);
+
+  // Enrolling again renumbers, it takes no room
+  CHECK(allowlist_add(&helmets[7], 500) == false);
+  CHECK_EQ(allowlist_short_id(&helmets[7]), 500);
+  CHECK_EQ(allowlist_count(), ALLOWLIST_MAX_ENROLLED);
+
+  CHECK(allowlist_add(&extra, 0) == true);
+}
+
+/**
+ * @brief   Members are accepted once per window, nobody else ever
+ */
+static void test_check(void) {
+  allowlist_stats_t stats;
+  bd_addr           stranger;
+  uint32_t          i;
+
+  enroll_all();
+
+  CHECK_EQ(allowlist_check(&helmets[3], 5000), ALLOWLIST_ACCEPT);
+  CHECK_EQ(allowlist_check(&helmets[3], 5000 + ALLOWLIST_DEDUP_WINDOW_MS - 1), ALLOWLIST_DUPLICATE);
+  CHECK_EQ(allowlist_check(&helmets[3], 5000 + ALLOWLIST_DEDUP_WINDOW_MS), ALLOWLIST_ACCEPT);
+
+  for(i = 0; i < 100000; i++){
+    random_address(&stranger);
+    if(allowlist_short_id(&stranger) == 0)
+      CHECK_EQ(allowlist_check(&stranger, i), ALLOWLIST_REJECT);
+  }
+
+  allowlist_take_stats(&stats);
+  CHECK_EQ(stats.accepts, 2);
+  CHECK_EQ(stats.duplicates, 1);
+  CHECK(stats.rejects <= 100000);
+  CHECK(stats.bloomRejects <= stats.rejects);
+  CHECK_EQ(stats.reports, stats.accepts + stats.duplicates + stats.rejects);
+
+  allowlist_take_stats(&stats);
+  CHECK_EQ(stats.reports, 0);
+}
+
+//------------------------------------------------------------------------------
+// Benchmark
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   Scan report fast path with the table full
+ * @return  none
+ */
+static void bench_check(void) {
+  allowlist_stats_t stats;
+  bd_addr           a;
+  uint64_t          start;
+  uint64_t          ns;
+  uint32_t          k;
+  uint32_t          accepted = 0;
+
+  enroll_all();
+  allowlist_take_stats(&stats);
+
+  start = test_now_ns();
+  for(k = 0; k < BENCH_REPORTS; k++){
+    if((k % BENCH_MEMBER_EVERY) == 0)
+      a = helmets[(k / BENCH_MEMBER_EVERY) % ALLOWLIST_MAX_ENROLLED];
+    else
+      random_address(&a);
+    accepted += (allowlist_check(&a, k / 1000) == ALLOWLIST_ACCEPT);
+  }
+  ns = test_now_ns() - start;
+
+  allowlist_take_stats(&stats);
+  CHECK_EQ(stats.accepts, accepted);
+  printf("allowlist_check: %.1f M reports/s, %.1f ns each\n",
+         (double) BENCH_REPORTS * 1000.0 / (double) ns, (double) ns / BENCH_REPORTS);
+  printf("  %u helmets enrolled, bloom filter rejected %.1f %% of non-members alone\n",
+         (unsigned int) allowlist_count(), 100.0 * stats.bloomRejects / stats.rejects);
+  printf("  %u accepted, %u duplicates, %u rejected\n",
+         (unsigned int) stats.accepts, (unsigned int) stats.duplicates, (unsigned int) stats.rejects);
+}
+
+int main(int argc, char *argv[]) {
+  if((argc > 1) && (strcmp(argv[1], "bench") == 0)){
+    bench_check();
+    return TEST_RESULT();
+  }
+
+  RUN(test_boot_enrolment);
+  RUN(test_enrol_to_limit);
+  RUN(test_check);
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,542 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    test_battery.c
+ * @brief   Host test of the state of charge model and the low battery alarm
+ *          in battery.c
+ *
+ *          Each conversion puts a result in ADC0, checks it against the
+ *          window comparator and moves it into the DMA ring like the LDMA
+ *          does. The tests run the BLE loop when the external signal is
+ *          raised. DEVINFO is mapped at its address for the calibration.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include <string.h>
+#include <sys/mman.h>
+
+#include "test.h"
+#include "em_device.h"
+#include "em_cmu.h"
+#include "em_gpio.h"
+#include "em_prs.h"
+#include "dmadrv.h"
+#include "sl_bt_api.h"
+#include "battery.h"
+#include "alarm.h"
+#include "beacon.h"
+#include "telemetry.h"
+#include "journal.h"
+
+#define DEVINFO_PAGE      (DEVINFO_BASE & ~0xFFFUL)
+#define MAX_REPORTS       (512)
+
+typedef struct {
+  telemetry_sensor_t sensor;
+  int16_t            value;
+} report_t;
+
+// Open circuit voltage of the LP552530 at 0 %, 10 %, ... 100 %
+static const uint16_t ocv[] = { 3000, 3600, 3690, 3740, 3770, 3800, 3850, 3910, 3980, 4080, 4190 };
+
+ADC_TypeDef hostAdc0;
+
+static LDMA_Descriptor_t *dmaNext = NULL;
+static DMADRV_Callback_t  dmaDone = NULL;
+static uint32_t           dmaUnits = 0;       // moved by the descriptor in progress
+static uint32_t           dmaInterrupts = 0;
+
+static uint32_t           signals = 0;
+static uint32_t           prsSource = 0;
+static unsigned int       vbatPin = 1;
+
+static uint32_t           alarmCalls = 0;
+static bool               alarmActive = false;
+static int32_t            beaconSoc = -1;
+
+static bool               refuse = false;     // nobody subscribed, samples go to the journal
+static report_t           reports[MAX_REPORTS];
+static uint32_t           reportCount = 0;
+static report_t           journaled[MAX_REPORTS];
+static uint32_t           journalCount = 0;
+
+//------------------------------------------------------------------------------
+// Stand-ins for the stack and the rest of the firmware
+//------------------------------------------------------------------------------
+
+void CMU_ClockEnable(CMU_Clock_TypeDef clock, bool enable) {
+  CHECK((clock == cmuClock_ADC0) || (clock == cmuClock_PRS));
+  CHECK(enable);
+}
+
+void CMU_ClockSelectSet(CMU_Clock_TypeDef clock, CMU_Select_TypeDef ref) {
+  CHECK_EQ(clock, cmuClock_ADC0ASYNC);
+  CHECK_EQ(ref, cmuSelect_AUXHFRCO);
+}
+
+void CMU_AUXHFRCOBandSet(CMU_AUXHFRCOFreq_TypeDef setFreq) {
+  CHECK_EQ(setFreq, cmuAUXHFRCOFreq_4M0Hz);
+}
+
+void GPIO_PinModeSet(GPIO_Port_TypeDef port, unsigned int pin, GPIO_Mode_TypeDef mode, unsigned int out) {
+  CHECK_EQ(port, BATTERY_OK_PORT);
+  CHECK_EQ(pin, BATTERY_OK_PIN);
+  CHECK_EQ(mode, gpioModeInputPullFilter);
+  (void) out;
+}
+
+void GPIO_ExtIntConfig(GPIO_Port_TypeDef port, unsigned int pin, unsigned int intNo,
+                       bool risingEdge, bool fallingEdge, bool enable) {
+  CHECK_EQ(port, BATTERY_OK_PORT);
+  CHECK_EQ(pin, BATTERY_OK_PIN);
+  CHECK_EQ(intNo, BATTERY_OK_PIN);
+  CHECK(risingEdge && fallingEdge && enable);
+}
+
+unsigned int GPIO_PinInGet(GPIO_Port_TypeDef port, unsigned int pin) {
+  CHECK_EQ(port, BATTERY_OK_PORT);
+  CHECK_EQ(pin, BATTERY_OK_PIN);
+  return vbatPin;
+}
+
+void PRS_SourceAsyncSignalSet(unsigned int ch, uint32_t source, uint32_t signal) {
+  CHECK_EQ(ch, BATTERY_PRS_CH);
+  prsSource = source | signal;
+}
+
+Ecode_t DMADRV_Init(void) {
+  return ECODE_EMDRV_DMADRV_ALREADY_INITIALIZED;
+}
+
+Ecode_t DMADRV_AllocateChannel(unsigned int *channelId, void *capabilities) {
+  (void) capabilities;
+  *channelId = 4;
+  return ECODE_EMDRV_DMADRV_OK;
+}
+
+Ecode_t DMADRV_LdmaStartTransfer(int channelId, LDMA_TransferCfg_t *transfer,
+                                 LDMA_Descriptor_t *descriptor,
+                                 DMADRV_Callback_t callback, void *cbUserParam) {
+  (void) cbUserParam;
+  CHECK_EQ(channelId, 4);
+  CHECK_EQ(transfer->ldmaReqSel, ldmaPeripheralSignal_ADC0_SINGLE);
+  dmaNext = descriptor;
+  dmaDone = callback;
+  dmaUnits = 0;
+  return ECODE_EMDRV_DMADRV_OK;
+}
+
+sl_status_t sl_bt_external_signal(uint32_t signal) {
+  signals |= signal;
+  return SL_STATUS_OK;
+}
+
+void alarm_from_isr(beacon_alarm_t alarm, bool active) {
+  CHECK_EQ(alarm, BEACON_ALARM_LOW_BATTERY);
+  alarmActive = active;
+  alarmCalls++;
+}
+
+void beacon_update_battery(uint8_t percent) {
+  beaconSoc = percent;
+}
+
+bool telemetry_add_sample(telemetry_sensor_t sensor, int16_t value) {
+  CHECK(reportCount < MAX_REPORTS);
+  if(reportCount < MAX_REPORTS){
+    reports[reportCount].sensor = sensor;
+    reports[reportCount].value = value;
+    reportCount++;
+  }
+  return refuse;
+}
+
+void journal_append(telemetry_sensor_t sensor, int16_t value) {
+  CHECK(journalCount < MAX_REPORTS);
+  if(journalCount < MAX_REPORTS){
+    journaled[journalCount].sensor = sensor;
+    journaled[journalCount].value = value;
+    journalCount++;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   Returns the ADC code of a battery voltage, through the divider
+ * @param   mv      battery voltage
+ * @return  12 bit code
+ */
+static uint32_t code_of(uint32_t mv) {
+  return ((mv * 4096) + 2500) / (BATTERY_DIVIDER * 2500);
+}
+
+/**
+ * @brief   Returns the state of charge of a voltage from the whole table
+ * @param   mv      battery voltage
+ * @return  0 to 100 %
+ */
+static uint32_t reference_soc(uint32_t mv) {
+  uint32_t i;
+
+  if(mv <= ocv[0])
+    return 0;
+  for(i = 0; i < 10; i++){
+    if(mv < ocv[i + 1])
+      return (i * 10) + (((mv - ocv[i]) * 10) / (ocv[i + 1] - ocv[i]));
+  }
+  return 100;
+}
+
+/**
+ * @brief   Returns the descriptor a link points at
+ * @param   linkAddr    link field
+ * @return  the descriptor
+ */
+static LDMA_Descriptor_t *linked(int32_t linkAddr) {
+  return (LDMA_Descriptor_t *) (uintptr_t) ((uint32_t) linkAddr << 2);
+}
+
+/**
+ * @brief   One conversion triggered by the LETIMER0: the window comparator,
+ *          then the LDMA moves the result
+ * @param   mv      battery voltage
+ * @return  none
+ */
+static void convert(uint32_t mv) {
+  LDMA_Descriptor_t *d = dmaNext;
+  uint32_t           unit;
+
+  ADC0->SINGLEDATA = code_of(mv);
+  if((ADC0->SINGLEDATA < (ADC0->CMPTHR & 0xFFF)) && (ADC0->IEN & ADC_IEN_SINGLECMP))
+    battery_low_from_isr();
+
+  CHECK_EQ(d->xfer.srcAddr, (uint32_t) &ADC0->SINGLEDATA);
+  CHECK_EQ(d->xfer.srcInc, ldmaCtrlSrcIncNone);
+  CHECK_EQ(d->xfer.dstInc, ldmaCtrlDstIncOne);
+  unit = 1u << d->xfer.size;
+  memcpy((uint8_t *) (uintptr_t) d->xfer.dstAddr + (dmaUnits * unit), (const void *) &ADC0->SINGLEDATA, unit);
+  if(dmaUnits++ < d->xfer.xferCnt)
+    return;
+
+  dmaUnits = 0;
+  CHECK(d->xfer.link);
+  CHECK_EQ(d->xfer.linkMode, ldmaLinkModeAbs);
+  dmaNext = linked(d->xfer.linkAddr);
+  if(d->xfer.doneIfs){
+    dmaInterrupts++;
+    CHECK(dmaDone(4, dmaInterrupts, NULL));
+  }
+}
+
+/**
+ * @brief   A half of the ring at one voltage, then the BLE loop if it was
+ *          signalled
+ * @param   mv      battery voltage
+ * @return  none
+ */
+static void half(uint32_t mv) {
+  uint32_t i;
+
+  for(i = 0; i < BATTERY_SAMPLES_PER_HALF; i++)
+    convert(mv);
+  if(signals & (1 << BATTERY_BIT_POS)){
+    signals = 0;
+    battery_process();
+  }
+}
+
+/**
+ * @brief   Enough halves at one voltage for the filter to settle on it
+ * @param   mv      battery voltage
+ * @return  none
+ */
+static void settle(uint32_t mv) {
+  uint32_t i;
+
+  for(i = 0; i < 40; i++)
+    half(mv);
+}
+
+/**
+ * @brief   Returns how many reports of a sensor went to telemetry
+ * @param   sensor  sensor
+ * @return  count
+ */
+static uint32_t reported(telemetry_sensor_t sensor) {
+  uint32_t count = 0;
+  uint32_t i;
+
+  for(i = 0; i < reportCount; i++)
+    count += (reports[i].sensor == sensor);
+  return count;
+}
+
+//------------------------------------------------------------------------------
+// Tests
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   Init loads the factory calibration, sets the comparator to
+ *          BATTERY_LOW_MV and starts a ring of two halves on the LETIMER0
+ */
+static void test_init(void) {
+  uint32_t i;
+
+  battery_from_isr();
+  CHECK_EQ(signals, 0);
+
+  DEVINFO->ADC0CAL0 = (0x55UL << 24) | (0x9UL << 20) | (0x3UL << 16) | 0xABCDUL;
+  ADC0->CAL = 0xFFFF0000UL;
+  battery_init();
+
+  CHECK_EQ(ADC0->CAL, 0xFFFF0000UL | (0x55UL << 8) | (0x9UL << 4) | 0x3UL);
+  CHECK_EQ(ADC0->CMPTHR & 0xFFFF, code_of(BATTERY_LOW_MV));
+  CHECK_EQ(ADC0->CMPTHR >> 16, 4095);
+  CHECK(ADC0->IEN & ADC_IEN_SINGLECMP);
+  CHECK(ADC0->CTRL & ADC_CTRL_SINGLEDMAWU);
+  CHECK((ADC0->SINGLECTRL & (ADC_SINGLECTRL_PRSEN | ADC_SINGLECTRL_CMPEN)) ==
+        (ADC_SINGLECTRL_PRSEN | ADC_SINGLECTRL_CMPEN));
+  CHECK_EQ(ADC0->SINGLECTRLX >> _ADC_SINGLECTRLX_PRSSEL_SHIFT, BATTERY_PRS_CH);
+  CHECK_EQ(prsSource, PRS_CH_CTRL_SOURCESEL_LETIMER0 | PRS_CH_CTRL_SIGSEL_LETIMER0CH0);
+
+  // Nothing measured yet
+  battery_process();
+  CHECK_EQ(battery_mv(), 0);
+  CHECK_EQ(reportCount, 0);
+
+  // The CPU only wakes once a half is full, and the ring goes round
+  for(i = 0; i < (4 * BATTERY_SAMPLES_PER_HALF) - 1; i++){
+    convert(3800);
+    CHECK_EQ(dmaInterrupts, (i + 1) / BATTERY_SAMPLES_PER_HALF);
+  }
+  convert(3800);
+  CHECK_EQ(dmaInterrupts, 4);
+  CHECK(linked(linked(dmaNext->xfer.linkAddr)->xfer.linkAddr) == dmaNext);
+  CHECK_EQ(signals, 1 << BATTERY_BIT_POS);
+}
+
+/**
+ * @brief   The state of charge follows the table at every voltage the filter
+ *          goes through, across segments and beyond either end
+ */
+static void test_soc_curve(void) {
+  uint32_t mv;
+  uint32_t i;
+
+  battery_init();
+
+  // The first half is taken as it is
+  half(3800);
+  CHECK((battery_mv() >= 3798) && (battery_mv() <= 3800));
+  CHECK_EQ(battery_soc(), reference_soc(battery_mv()));
+
+  settle(2900);
+  for(mv = 2900; mv <= 4300; mv += 5){
+    for(i = 0; i < 12; i++){
+      half(mv);
+      CHECK_EQ(battery_soc(), reference_soc(battery_mv()));
+    }
+    CHECK(((uint32_t) battery_mv() + 3 >= mv) && (battery_mv() <= mv + 3));
+  }
+  CHECK_EQ(battery_soc(), 100);
+
+  for(mv = 4300; mv >= 2900; mv -= 5){
+    for(i = 0; i < 12; i++){
+      half(mv);
+      CHECK_EQ(battery_soc(), reference_soc(battery_mv()));
+    }
+  }
+  CHECK_EQ(battery_soc(), 0);
+
+  // Jumps across several segments each half
+  for(i = 0; i < 20; i++){
+    half((i & 1) ? 3000 : 4250);
+    CHECK_EQ(battery_soc(), reference_soc(battery_mv()));
+  }
+  CHECK((battery_mv() > 3400) && (battery_mv() < 3850));
+}
+
+/**
+ * @brief   A value is reported once it moved by its step, the state of
+ *          charge goes to the beacon too, and to the journal when nobody
+ *          listens
+ */
+static void test_reports(void) {
+  int16_t  last = 0;
+  uint32_t batteryReports;
+  uint32_t i;
+
+  battery_init();
+  half(3800);
+  CHECK_EQ(reportCount, 2);
+  CHECK_EQ(reports[0].sensor, TELEMETRY_SENSOR_BATTERY);
+  CHECK((reports[0].value >= 3798) && (reports[0].value <= 3800));
+  CHECK_EQ(reports[1].sensor, TELEMETRY_SENSOR_SOC);
+  CHECK_EQ(reports[1].value, battery_soc());
+  CHECK_EQ(beaconSoc, battery_soc());
+
+  // A steady battery reports nothing
+  settle(3800);
+  CHECK_EQ(reportCount, 2);
+
+  // 12 mV is not a battery report, the state of charge moved by 2 %
+  settle(3812);
+  CHECK_EQ(reported(TELEMETRY_SENSOR_BATTERY), 1);
+  CHECK_EQ(reports[reportCount - 1].sensor, TELEMETRY_SENSOR_SOC);
+  CHECK_EQ(reports[reportCount - 1].value, battery_soc());
+  CHECK_EQ(beaconSoc, battery_soc());
+
+  // Each battery report is a step away from the one before
+  settle(3900);
+  batteryReports = reported(TELEMETRY_SENSOR_BATTERY);
+  CHECK(batteryReports >= 3);
+  for(i = 0; i < reportCount; i++){
+    if(reports[i].sensor != TELEMETRY_SENSOR_BATTERY)
+      continue;
+    if(last != 0)
+      CHECK(reports[i].value - last >= BATTERY_REPORT_STEP_MV);
+    last = reports[i].value;
+  }
+  CHECK(battery_mv() - last < BATTERY_REPORT_STEP_MV);
+
+  // Nobody subscribed, the same reports go to the journal
+  refuse = true;
+  i = reportCount;
+  settle(3700);
+  CHECK(journalCount > 2);
+  CHECK_EQ(journalCount, reportCount - i);
+  CHECK(memcmp(journaled, &reports[i], journalCount * sizeof(report_t)) == 0);
+  CHECK_EQ(journaled[journalCount - 1].sensor, TELEMETRY_SENSOR_SOC);
+  CHECK_EQ(journaled[journalCount - 1].value, battery_soc());
+}
+
+/**
+ * @brief   The comparator raises the alarm at the first conversion below
+ *          BATTERY_LOW_MV, it clears above the hysteresis, VBAT_OK low
+ *          raises it too
+ */
+static void test_low_battery(void) {
+  uint32_t i;
+
+  vbatPin = 1;
+  battery_init();
+  settle(3700);
+  CHECK_EQ(alarmCalls, 0);
+
+  // Raised in the interrupt, before the half is full
+  convert(3450);
+  CHECK_EQ(alarmCalls, 1);
+  CHECK(alarmActive);
+  CHECK((ADC0->IEN & ADC_IEN_SINGLECMP) == 0);
+
+  settle(3450);
+  settle(3550);
+  CHECK_EQ(alarmCalls, 1);
+
+  settle(3650);
+  CHECK_EQ(alarmCalls, 2);
+  CHECK(alarmActive == false);
+  CHECK(ADC0->IEN & ADC_IEN_SINGLECMP);
+  CHECK(ADC0->IFC & ADC_IFC_SINGLECMP);
+
+  // The filtered voltage drifts below with the comparator off
+  ADC0->IEN = 0;
+  for(i = 0; (i < 40) && (alarmCalls == 2); i++)
+    half(3490);
+  CHECK_EQ(alarmCalls, 3);
+  CHECK(battery_mv() < BATTERY_LOW_MV);
+  settle(3700);
+  CHECK_EQ(alarmCalls, 4);
+
+  // The harvester is about to cut the load off
+  vbatPin = 0;
+  half(3700);
+  CHECK(battery_vbat_ok() == false);
+  CHECK_EQ(alarmCalls, 5);
+  CHECK(alarmActive);
+  settle(3700);
+  CHECK_EQ(alarmCalls, 5);
+  vbatPin = 1;
+  half(3700);
+  CHECK(battery_vbat_ok());
+  CHECK_EQ(alarmCalls, 6);
+  CHECK(alarmActive == false);
+
+  // One conversion dips under a load, the half it is in clears the alarm
+  convert(3450);
+  CHECK(alarmActive);
+  half(3700);
+  CHECK_EQ(alarmCalls, 8);
+  CHECK(alarmActive == false);
+  CHECK(ADC0->IEN & ADC_IEN_SINGLECMP);
+}
+
+/**
+ * @brief   The trend follows the slope of the voltage in mV per hour, one
+ *          half is LETIMER_PERIOD_MS * BATTERY_SAMPLES_PER_HALF
+ */
+static void test_trend(void) {
+  uint32_t mv = 3800;
+  uint32_t i;
+
+  battery_init();
+  // Steady again, within what the filter resolves
+  settle(mv);
+  CHECK(battery_trend_mv_per_hour() > -15);
+  CHECK(battery_trend_mv_per_hour() < 15);
+
+  // Charging 2 mV a minute
+  for(i = 0; i < 60; i++){
+    mv += 2;
+    half(mv);
+  }
+  CHECK(battery_trend_mv_per_hour() > 100);
+  CHECK(battery_trend_mv_per_hour() < 140);
+
+  // Steady again, within what the filter resolves
+  settle(mv);
+  CHECK(battery_trend_mv_per_hour() > -15);
+  CHECK(battery_trend_mv_per_hour() < 15);
+
+  // Draining 1 mV a minute
+  for(i = 0; i < 60; i++){
+    mv -= 1;
+    half(mv);
+  }
+  CHECK(battery_trend_mv_per_hour() < -45);
+  CHECK(battery_trend_mv_per_hour() > -75);
+}
+
+int main(void) {
+  void *devinfo;
+
+  // DEVINFO at its address in the EFR32, with a factory calibration
+  devinfo = mmap((void *) DEVINFO_PAGE, 0x1000, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+  if(devinfo != (void *) DEVINFO_PAGE){
+    printf("cannot map DEVINFO at 0x%08lx\n", (unsigned long) DEVINFO_PAGE);
+    return 1;
+  }
+
+
+  RUN_FRESH(test_init);
+  RUN_FRESH(test_soc_curve);
+  RUN_FRESH(test_reports);
+  RUN_FRESH(test_low_battery);
+  RUN_FRESH(test_trend);
+
+  return TEST_RESULT();
+}
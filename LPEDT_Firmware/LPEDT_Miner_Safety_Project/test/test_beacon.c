@@ -0,0 +1,365 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    test_beacon.c
+ * @brief   Host test of the advertising payload and interval of beacon.c
+ *
+ *          The advertiser keeps the last packet it was given, the tests read
+ *          it back the way a scanner does: AD structure by AD structure, the
+ *          summary behind the company ID.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "beacon.h"
+#include "ble.h"
+
+// Legacy advertising PDU
+#define ADV_DATA_MAX      (31)
+
+#define HANDLE            (3)
+
+typedef struct {
+  uint8_t  flags;
+  uint16_t company;
+  uint8_t  version;
+  uint8_t  seq;
+  uint8_t  alarms;
+  int16_t  centiDegC;
+  uint16_t gas;
+  uint8_t  battery;
+} summary_t;
+
+static sl_status_t createStatus = SL_STATUS_OK;
+static sl_status_t startStatus = SL_STATUS_OK;
+static bool        advertising = false;
+static uint32_t    starts = 0;
+static uint32_t    published = 0;
+static uint32_t    interval = 0;
+static uint8_t     packet[ADV_DATA_MAX];
+static size_t      packetLength = 0;
+
+//------------------------------------------------------------------------------
+// Stand-ins for the stack and the rest of the firmware
+//------------------------------------------------------------------------------
+
+sl_status_t sl_bt_advertiser_create_set(uint8_t *handle) {
+  *handle = HANDLE;
+  return createStatus;
+}
+
+sl_status_t sl_bt_advertiser_set_timing(uint8_t handle,
+                                        uint32_t interval_min,
+                                        uint32_t interval_max,
+                                        uint16_t duration,
+                                        uint8_t maxevents) {
+  CHECK_EQ(handle, HANDLE);
+  CHECK(advertising == false);
+  CHECK_EQ(interval_min, interval_max);
+  CHECK_EQ(duration, 0);
+  CHECK_EQ(maxevents, 0);
+  interval = interval_min;
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_advertiser_set_data(uint8_t handle,
+                                      uint8_t packet_type,
+                                      size_t adv_data_len,
+                                      const uint8_t* adv_data) {
+  CHECK_EQ(handle, HANDLE);
+  CHECK_EQ(packet_type, 0);
+  CHECK(adv_data_len <= ADV_DATA_MAX);
+  if(adv_data_len > ADV_DATA_MAX)
+    return SL_STATUS_FAIL;
+
+  memcpy(packet, adv_data, adv_data_len);
+  packetLength = adv_data_len;
+  published++;
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_advertiser_start(uint8_t handle,
+                                   uint8_t discover,
+                                   uint8_t connect) {
+  CHECK_EQ(handle, HANDLE);
+  CHECK(advertising == false);
+  CHECK_EQ(discover, sl_bt_advertiser_user_data);
+  CHECK_EQ(connect, sl_bt_advertiser_non_connectable);
+  starts++;
+  advertising = (startStatus == SL_STATUS_OK);
+  return startStatus;
+}
+
+sl_status_t sl_bt_advertiser_stop(uint8_t handle) {
+  CHECK_EQ(handle, HANDLE);
+  CHECK(advertising);
+  advertising = false;
+  return SL_STATUS_OK;
+}
+
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   Reads the advertised packet back like a scanner
+ * @param   s   summary read
+ * @return  true if the packet is well formed and carries a summary
+ */
+static bool scan(summary_t *s) {
+  const uint8_t *m = NULL;
+  size_t         i = 0;
+  bool           flags = false;
+
+  memset(s, 0, sizeof(*s));
+
+  // The AD structures cover the packet exactly
+  while(i < packetLength){
+    if((packet[i] == 0) || (i + 1 + packet[i] > packetLength))
+      return false;
+    if((packet[i + 1] == 0x01) && (packet[i] == 2)){
+      s->flags = packet[i + 2];
+      flags = true;
+    }
+    if((packet[i + 1] == 0xFF) && (packet[i] == 11))
+      m = &packet[i + 2];
+    i += 1 + packet[i];
+  }
+  if((flags == false) || (m == NULL))
+    return false;
+
+  s->company   = (uint16_t) (m[0] | (m[1] << 8));
+  s->version   = m[2];
+  s->seq       = m[3];
+  s->alarms    = m[4];
+  s->centiDegC = (int16_t) (m[5] | (m[6] << 8));
+  s->gas       = (uint16_t) (m[7] | (m[8] << 8));
+  s->battery   = m[9];
+  return true;
+}
+
+/**
+ * @brief   Checks the packet was published once since the last call, with
+ *          the next sequence number
+ * @param   s       summary read
+ * @param   before  summary read before the update
+ * @return  none
+ */
+static void check_published(summary_t *s, const summary_t *before) {
+  CHECK_EQ(published, 1);
+  published = 0;
+  CHECK(scan(s));
+  CHECK_EQ(s->seq, (uint8_t) (before->seq + 1));
+}
+
+/**
+ * @brief   Boots the beacon, broadcasting as the boot left it
+ * @return  none
+ */
+static void boot(void) {
+  beacon_init();
+  published = 0;
+  starts = 0;
+}
+
+//------------------------------------------------------------------------------
+// Tests
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   The boot packet is a legacy PDU with the flags and the summary,
+ *          every reading not available yet
+ */
+static void test_layout(void) {
+  summary_t s;
+
+  beacon_init();
+  CHECK(advertising);
+  CHECK_EQ(starts, 1);
+  CHECK_EQ(published, 1);
+  CHECK_EQ(interval, BEACON_INTERVAL_NORMAL);
+
+  CHECK(scan(&s));
+  CHECK_EQ(packetLength, 15);
+  CHECK_EQ(s.flags, 0x06);
+  CHECK_EQ(s.company, BEACON_COMPANY_ID);
+  CHECK_EQ(s.version, BEACON_FORMAT_VERSION);
+  CHECK_EQ(s.seq, 0);
+  CHECK_EQ(s.alarms, 0);
+  CHECK_EQ(s.gas, BEACON_VALUE_NOT_AVAILABLE);
+  CHECK_EQ(s.battery, 0xFF);
+}
+
+/**
+ * @brief   Every update patches its own field only and publishes the packet
+ *          with the next sequence number, which wraps
+ */
+static void test_fields(void) {
+  summary_t before;
+  summary_t s;
+  uint32_t  i;
+
+  boot();
+  CHECK(scan(&before));
+
+  beacon_update_temperature(-1234);
+  check_published(&s, &before);
+  CHECK_EQ(s.centiDegC, -1234);
+  CHECK_EQ(s.gas, before.gas);
+  CHECK_EQ(s.battery, before.battery);
+  CHECK_EQ(s.alarms, before.alarms);
+
+  before = s;
+  beacon_update_gas(0x1234);
+  check_published(&s, &before);
+  CHECK_EQ(s.gas, 0x1234);
+  CHECK_EQ(s.centiDegC, -1234);
+  CHECK_EQ(s.battery, before.battery);
+
+  before = s;
+  beacon_update_battery(87);
+  check_published(&s, &before);
+  CHECK_EQ(s.battery, 87);
+  CHECK_EQ(s.gas, 0x1234);
+  CHECK_EQ(s.centiDegC, -1234);
+
+  before = s;
+  beacon_update_temperature(INT16_MAX);
+  check_published(&s, &before);
+  CHECK_EQ(s.centiDegC, INT16_MAX);
+  CHECK_EQ(s.company, BEACON_COMPANY_ID);
+  CHECK_EQ(s.version, BEACON_FORMAT_VERSION);
+  CHECK_EQ(s.flags, 0x06);
+
+  for(i = 0; i < 300; i++){
+    before = s;
+    beacon_update_battery((uint8_t) (i % 101));
+    check_published(&s, &before);
+  }
+
+  // Patching never restarts the advertiser
+  CHECK_EQ(starts, 0);
+  CHECK(advertising);
+}
+
+/**
+ * @brief   The alarm flags follow the sources, the interval drops to
+ *          BEACON_INTERVAL_ALARM while any is set
+ */
+static void test_alarms(void) {
+  summary_t before;
+  summary_t s;
+
+  boot();
+  CHECK(scan(&before));
+
+  beacon_set_alarm(BEACON_ALARM_GAS, true);
+  CHECK(scan(&s));
+  CHECK_EQ(s.alarms, BEACON_ALARM_GAS);
+  CHECK_EQ(s.seq, (uint8_t) (before.seq + 1));
+  CHECK_EQ(starts, 1);
+  CHECK(advertising);
+  CHECK_EQ(interval, BEACON_INTERVAL_ALARM);
+
+  // A second source publishes, the interval is already right
+  before = s;
+  published = 0;
+  beacon_set_alarm(BEACON_ALARM_SOS, true);
+  check_published(&s, &before);
+  CHECK_EQ(s.alarms, BEACON_ALARM_GAS | BEACON_ALARM_SOS);
+  CHECK_EQ(starts, 1);
+
+  // No change, nothing sent
+  beacon_set_alarm(BEACON_ALARM_SOS, true);
+  beacon_set_alarm(BEACON_ALARM_FALL, false);
+  CHECK_EQ(published, 0);
+
+  before = s;
+  beacon_set_alarm(BEACON_ALARM_GAS, false);
+  check_published(&s, &before);
+  CHECK_EQ(s.alarms, BEACON_ALARM_SOS);
+  CHECK_EQ(interval, BEACON_INTERVAL_ALARM);
+
+  beacon_set_alarm(BEACON_ALARM_SOS, false);
+  CHECK(scan(&s));
+  CHECK_EQ(s.alarms, 0);
+  CHECK_EQ(starts, 2);
+  CHECK(advertising);
+  CHECK_EQ(interval, BEACON_INTERVAL_NORMAL);
+}
+
+/**
+ * @brief   The governor sets the interval outside alarms, an alarm keeps
+ *          its own and gives the new one back when it clears
+ */
+static void test_interval(void) {
+  boot();
+  beacon_set_interval(BEACON_INTERVAL_NORMAL);
+  CHECK_EQ(starts, 0);
+
+  beacon_set_interval(4 * BEACON_INTERVAL_NORMAL);
+  CHECK_EQ(starts, 1);
+  CHECK(advertising);
+  CHECK_EQ(interval, 4 * BEACON_INTERVAL_NORMAL);
+  CHECK_EQ(published, 1);
+
+  beacon_set_alarm(BEACON_ALARM_FALL, true);
+  CHECK_EQ(interval, BEACON_INTERVAL_ALARM);
+  beacon_set_interval(2 * BEACON_INTERVAL_NORMAL);
+  CHECK_EQ(starts, 2);
+  CHECK_EQ(interval, BEACON_INTERVAL_ALARM);
+
+  beacon_set_alarm(BEACON_ALARM_FALL, false);
+  CHECK_EQ(starts, 3);
+  CHECK_EQ(interval, 2 * BEACON_INTERVAL_NORMAL);
+}
+
+/**
+ * @brief   Without an advertising set nothing is sent, an advertiser that
+ *          failed to start is not patched nor stopped
+ */
+static void test_not_running(void) {
+  createStatus = SL_STATUS_NO_MORE_RESOURCE;
+  beacon_init();
+  CHECK_EQ(starts, 0);
+  beacon_update_gas(10);
+  beacon_set_alarm(BEACON_ALARM_SOS, true);
+  beacon_set_interval(3200);
+  CHECK_EQ(published, 0);
+  CHECK_EQ(starts, 0);
+
+  createStatus = SL_STATUS_OK;
+  startStatus = SL_STATUS_FAIL;
+  beacon_init();
+  CHECK_EQ(starts, 1);
+  CHECK(advertising == false);
+  published = 0;
+  beacon_update_battery(50);
+  beacon_set_alarm(BEACON_ALARM_SOS, false);
+  beacon_set_interval(1600);
+  CHECK_EQ(published, 0);
+  CHECK_EQ(starts, 1);
+}
+
+int main(void) {
+
+  RUN_FRESH(test_layout);
+  RUN_FRESH(test_fields);
+  RUN_FRESH(test_alarms);
+  RUN_FRESH(test_interval);
+  RUN_FRESH(test_not_running);
+
+  return TEST_RESULT();
+}
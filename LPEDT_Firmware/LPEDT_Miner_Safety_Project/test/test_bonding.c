@@ -0,0 +1,215 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    test_bonding.c
+ * @brief   Host test of bond persistence in bonding.c
+ *
+ *          The stack keeps its bonding table across reboots like NVM3 does,
+ *          hands out the bonding handle of a known peer when it connects and
+ *          records the calls bonding.c makes. The tests deliver the security
+ *          events themselves.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "sl_sleeptimer.h"
+#include "sl_bt_api.h"
+#include "bonding.h"
+
+#define PEERS             (BONDING_MAX_LINKS + 2)
+
+static uint64_t   nowMs = 1000;
+
+// The bonding table of the stack, kept in NVM3
+static bool       bonded[PEERS];
+static bool       bondingsDeleted = false;
+static uint32_t   configuredMax = 0;
+static uint32_t   configuredPolicy = 0xFF;
+static bool       bondable = false;
+
+static uint32_t   securityRequests = 0;
+static uint8_t    lastSecurityRequest = 0xFF;
+
+//------------------------------------------------------------------------------
+// Stand-ins for the stack and the rest of the firmware
+//------------------------------------------------------------------------------
+
+uint64_t sl_sleeptimer_get_tick_count64(void) {
+  return nowMs;
+}
+
+sl_status_t sl_sleeptimer_tick64_to_ms(uint64_t tick, uint64_t *ms) {
+  *ms = tick;
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_sm_delete_bondings(void) {
+  memset(bonded, 0, sizeof(bonded));
+  bondingsDeleted = true;
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_sm_store_bonding_configuration(uint8_t max_bonding_count, uint8_t policy_flags) {
+  configuredMax = max_bonding_count;
+  configuredPolicy = policy_flags;
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_sm_set_bondable_mode(uint8_t bondable_mode) {
+  bondable = (bondable_mode == 1);
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_sm_increase_security(uint8_t connection) {
+  securityRequests++;
+  lastSecurityRequest = connection;
+  return SL_STATUS_OK;
+}
+
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   Boots the device, the stack's bonding table stays
+ * @return  none
+ */
+static void boot(void) {
+  bondingsDeleted = false;
+  configuredMax = 0;
+  configuredPolicy = 0xFF;
+  bondable = false;
+  securityRequests = 0;
+  bonding_init();
+}
+
+/**
+ * @brief   A peer connects, with its bonding handle if the stack knows it
+ * @param   peer        index, also its connection handle
+ * @return  none
+ */
+static void connect(uint8_t peer) {
+  bonding_opened(peer, bonded[peer] ? peer : SL_BT_INVALID_BONDING_HANDLE);
+}
+
+/**
+ * @brief   A peer pairs, the stack stores the bond
+ * @param   peer        index, also its connection handle
+ * @return  what bonding_security_changed() returns
+ */
+static bool pair(uint8_t peer) {
+  bool resumed;
+
+  nowMs += 3000;        // passkey confirmed on both sides
+  resumed = bonding_security_changed(peer, sl_bt_connection_mode1_level3);
+  bonded[peer] = true;
+  bonding_bonded(peer, peer);
+  return resumed;
+}
+
+//------------------------------------------------------------------------------
+// Tests
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   Boot configures a table the stack accepts and keeps the bonds
+ *          made before the reboot
+ */
+static void test_boot(void) {
+  memset(bonded, 0, sizeof(bonded));
+  bonded[2] = true;
+
+  boot();
+  CHECK((configuredMax >= 1) && (configuredMax <= 32));
+  CHECK_EQ(configuredMax, BONDING_MAX_COUNT);
+  CHECK_EQ(configuredPolicy, BONDING_POLICY);
+  CHECK(configuredPolicy <= 2);
+  CHECK(bondable);
+  CHECK(bondingsDeleted == (BONDING_CLEAR_ON_BOOT == 1));
+  CHECK(bonded[2] == (BONDING_CLEAR_ON_BOOT == 0));
+}
+
+/**
+ * @brief   A new peer pairs and is not taken as bonded on that link; after
+ *          a reboot it is, with encryption asked for as the link opens
+ */
+static void test_pair_then_resume(void) {
+  memset(bonded, 0, sizeof(bonded));
+  boot();
+
+  connect(1);
+  CHECK_EQ(securityRequests, 0);
+  CHECK(bonding_security_changed(1, sl_bt_connection_mode1_level1) == false);
+  CHECK(pair(1) == false);
+  bonding_closed(1);
+
+  boot();
+  connect(1);
+  CHECK_EQ(securityRequests, 1);
+  CHECK_EQ(lastSecurityRequest, 1);
+
+  // Open, then encrypted with the stored keys
+  CHECK(bonding_security_changed(1, sl_bt_connection_mode1_level1) == false);
+  nowMs += 50;
+  CHECK(bonding_security_changed(1, sl_bt_connection_mode1_level3));
+
+  // The link stays bonded when the parameters change again
+  CHECK(bonding_security_changed(1, sl_bt_connection_mode1_level3));
+  bonding_closed(1);
+
+  // Closed, the next connection on the same handle starts over
+  bonded[1] = false;
+  connect(1);
+  CHECK(bonding_security_changed(1, sl_bt_connection_mode1_level2) == false);
+  bonding_closed(1);
+}
+
+/**
+ * @brief   Links beyond BONDING_MAX_LINKS are not taken as bonded but are
+ *          still encrypted, and a closed link makes room
+ */
+static void test_links(void) {
+  uint8_t peer;
+
+  memset(bonded, 0, sizeof(bonded));
+  for(peer = 0; peer < PEERS; peer++)
+    bonded[peer] = true;
+  boot();
+
+  for(peer = 0; peer < PEERS; peer++)
+    connect(peer);
+  CHECK_EQ(securityRequests, PEERS);
+
+  for(peer = 0; peer < PEERS; peer++)
+    CHECK(bonding_security_changed(peer, sl_bt_connection_mode1_level3) == (peer < BONDING_MAX_LINKS));
+
+  // A connection that was never opened is not tracked
+  CHECK(bonding_security_changed(0x40, sl_bt_connection_mode1_level3) == false);
+
+  bonding_closed(0);
+  bonding_closed(PEERS - 1);
+  connect(PEERS - 1);
+  CHECK(bonding_security_changed(PEERS - 1, sl_bt_connection_mode1_level3));
+  CHECK(bonding_security_changed(0, sl_bt_connection_mode1_level3) == false);
+}
+
+int main(void) {
+
+  RUN(test_boot);
+  RUN(test_pair_then_resume);
+  RUN(test_links);
+
+  return TEST_RESULT();
+}
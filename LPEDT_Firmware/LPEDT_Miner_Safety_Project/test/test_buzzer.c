@@ -0,0 +1,402 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    test_buzzer.c
+ * @brief   Host test of the patterns and their priority in buzzer.c
+ *
+ *          TIMER0, TIMER1 and the LDMA channel are simulated: every TIMER0
+ *          overflow loads the buffered step length, serves the DMA request
+ *          by walking the descriptor chain up to the next transfer that
+ *          waits for a request, and lets TIMER1 take its buffered tone. The
+ *          tests read the tone and length of every step off the registers.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "em_device.h"
+#include "em_cmu.h"
+#include "em_gpio.h"
+#include "dmadrv.h"
+#include "buzzer.h"
+#include "energy.h"
+
+#define HFPERCLK_HZ       (38400000)
+
+typedef struct {
+  uint16_t hz;
+  uint16_t ms;
+} step_t;
+
+// What each pattern sounds like
+static const step_t lowBattery[] = { { 4000, 60 }, { 0, 80 }, { 4000, 60 } };
+static const step_t fall[] = { { 3500, 400 }, { 0, 400 } };
+static const step_t sos[] = { { 4000, 200 }, { 0, 100 }, { 4000, 200 }, { 0, 100 }, { 4000, 200 }, { 0, 600 } };
+static const step_t gas[] = { { 4000, 150 }, { 3000, 150 } };
+
+TIMER_TypeDef hostTimer0;
+TIMER_TypeDef hostTimer1;
+
+static LDMA_Descriptor_t *dmaNext = NULL;
+static DMADRV_Callback_t  dmaDone = NULL;
+static uint32_t           dmaStarts = 0;
+static uint32_t           dmaInterrupts = 0;
+
+static int32_t            holds = 0;
+static bool               pinConfigured = false;
+
+//------------------------------------------------------------------------------
+// Stand-ins for the stack and the rest of the firmware
+//------------------------------------------------------------------------------
+
+void CMU_ClockEnable(CMU_Clock_TypeDef clock, bool enable) {
+  (void) clock;
+  CHECK(enable);
+}
+
+uint32_t CMU_ClockFreqGet(CMU_Clock_TypeDef clock) {
+  (void) clock;
+  return HFPERCLK_HZ;
+}
+
+void GPIO_PinModeSet(GPIO_Port_TypeDef port, unsigned int pin, GPIO_Mode_TypeDef mode, unsigned int out) {
+  CHECK_EQ(port, BUZZER_PORT);
+  CHECK_EQ(pin, BUZZER_PIN);
+  CHECK_EQ(mode, gpioModePushPull);
+  CHECK_EQ(out, 0);
+  pinConfigured = true;
+}
+
+void GPIO_PinOutClear(GPIO_Port_TypeDef port, unsigned int pin) {
+  CHECK_EQ(port, BUZZER_PORT);
+  CHECK_EQ(pin, BUZZER_PIN);
+}
+
+Ecode_t DMADRV_Init(void) {
+  return ECODE_EMDRV_DMADRV_ALREADY_INITIALIZED;
+}
+
+Ecode_t DMADRV_AllocateChannel(unsigned int *channelId, void *capabilities) {
+  (void) capabilities;
+  *channelId = 3;
+  return ECODE_EMDRV_DMADRV_OK;
+}
+
+Ecode_t DMADRV_LdmaStartTransfer(int channelId, LDMA_TransferCfg_t *transfer,
+                                 LDMA_Descriptor_t *descriptor,
+                                 DMADRV_Callback_t callback, void *cbUserParam) {
+  (void) cbUserParam;
+  CHECK_EQ(channelId, 3);
+  CHECK_EQ(transfer->ldmaReqSel, ldmaPeripheralSignal_TIMER0_UFOF);
+  dmaNext = descriptor;
+  dmaDone = callback;
+  dmaStarts++;
+  return ECODE_EMDRV_DMADRV_OK;
+}
+
+Ecode_t DMADRV_StopTransfer(unsigned int channelId) {
+  CHECK_EQ(channelId, 3);
+  dmaNext = NULL;
+  return ECODE_EMDRV_DMADRV_OK;
+}
+
+void energy_require(energy_need_t need, const char *func, uint16_t line) {
+  (void) func;
+  (void) line;
+  CHECK_EQ(need, ENERGY_NEED_BUZZER);
+  holds++;
+}
+
+void energy_release(energy_need_t need, const char *func, uint16_t line) {
+  (void) func;
+  (void) line;
+  CHECK_EQ(need, ENERGY_NEED_BUZZER);
+  holds--;
+  CHECK(holds >= 0);
+}
+
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   Returns the descriptor a link points at
+ * @param   linkAddr    link field
+ * @return  the descriptor
+ */
+static LDMA_Descriptor_t *linked(int32_t linkAddr) {
+  return (LDMA_Descriptor_t *) (uintptr_t) ((uint32_t) linkAddr << 2);
+}
+
+/**
+ * @brief   Carries out one descriptor
+ * @param   d       descriptor
+ * @return  none
+ */
+static void execute(const LDMA_Descriptor_t *d) {
+  const uint8_t *src;
+  uint8_t       *dst;
+  uint32_t       unit;
+  uint32_t       i;
+
+  if(d->wri.structType == ldmaCtrlStructTypeWrite){
+    *(volatile uint32_t *) (uintptr_t) d->wri.dstAddr = d->wri.immVal;
+    return;
+  }
+
+  CHECK_EQ(d->xfer.structType, ldmaCtrlStructTypeXfer);
+  CHECK_EQ(d->xfer.dstInc, ldmaCtrlDstIncNone);
+  unit = 1u << d->xfer.size;
+  src = (const uint8_t *) (uintptr_t) d->xfer.srcAddr;
+  dst = (uint8_t *) (uintptr_t) d->xfer.dstAddr;
+  for(i = 0; i <= d->xfer.xferCnt; i++){
+    memcpy(dst, src, unit);
+    if(d->xfer.srcInc == ldmaCtrlSrcIncOne)
+      src += unit;
+  }
+}
+
+/**
+ * @brief   Serves one DMA request: the waiting transfer and every descriptor
+ *          that follows it without a request
+ * @return  none
+ */
+static void dma_request(void) {
+  LDMA_Descriptor_t *d = dmaNext;
+
+  while(d != NULL){
+    execute(d);
+
+    if(d->xfer.link == 0){
+      dmaNext = NULL;
+      if(d->xfer.doneIfs){
+        dmaInterrupts++;
+        dmaDone(3, dmaInterrupts, NULL);
+      }
+      return;
+    }
+
+    CHECK(d->xfer.doneIfs == 0);
+    CHECK_EQ(d->xfer.linkMode, ldmaLinkModeAbs);
+    d = linked(d->xfer.linkAddr);
+    if(d->xfer.structReq == 0){
+      dmaNext = d;
+      return;
+    }
+  }
+}
+
+/**
+ * @brief   The end of a step: TIMER0 overflows
+ * @return  none
+ */
+static void overflow(void) {
+  TIMER0->TOP = TIMER0->TOPB;
+  dma_request();
+  TIMER1->TOP = TIMER1->TOPB;
+  TIMER1->CC[0].CCV = TIMER1->CC[0].CCVB;
+}
+
+/**
+ * @brief   Returns whether the buzzer sounds a pattern
+ * @return  true if the timers run and TIMER1 owns the pin
+ */
+static bool sounding(void) {
+  bool running = (TIMER0->CMD == TIMER_CMD_START);
+
+  CHECK_EQ(TIMER1->CMD, TIMER0->CMD);
+  CHECK_EQ(TIMER1->ROUTEPEN, running ? TIMER_ROUTEPEN_CC0PEN : 0);
+  CHECK_EQ(holds, running ? 1 : 0);
+  return running;
+}
+
+/**
+ * @brief   Reads the step that plays off the registers
+ * @param   s       filled in
+ * @return  none
+ */
+static void current_step(step_t *s) {
+  uint32_t top = TIMER1->TOP;
+  uint32_t stepHz = HFPERCLK_HZ / 1024;
+
+  if(TIMER1->CC[0].CCV == 0){
+    s->hz = 0;
+  }
+  else {
+    CHECK_EQ(TIMER1->CC[0].CCV, (top + 1) / 2);
+    s->hz = (uint16_t) ((HFPERCLK_HZ + (top + 1) / 2) / (top + 1));
+  }
+  s->ms = (uint16_t) ((((TIMER0->TOP + 1) * 1000) + stepHz / 2) / stepHz);
+}
+
+/**
+ * @brief   Plays steps and checks them against a pattern
+ * @param   expected    pattern
+ * @param   count       steps of the pattern
+ * @param   first       step expected to play now
+ * @param   steps       steps to play
+ * @return  none
+ */
+static void expect_steps(const step_t *expected, uint32_t count, uint32_t first, uint32_t steps) {
+  step_t   s;
+  uint32_t i;
+  uint32_t k;
+
+  for(i = 0; i < steps; i++){
+    k = (first + i) % count;
+    CHECK(sounding());
+    current_step(&s);
+    CHECK((s.hz + 5 >= expected[k].hz) && (s.hz <= expected[k].hz + 5));
+    CHECK_EQ(s.ms, expected[k].ms);
+    overflow();
+  }
+}
+
+/**
+ * @brief   Boots the buzzer
+ * @return  none
+ */
+static void boot(void) {
+  memset(&hostTimer0, 0, sizeof(hostTimer0));
+  memset(&hostTimer1, 0, sizeof(hostTimer1));
+  dmaNext = NULL;
+  dmaStarts = 0;
+  dmaInterrupts = 0;
+  holds = 0;
+  pinConfigured = false;
+  buzzer_init();
+  CHECK(pinConfigured);
+}
+
+//------------------------------------------------------------------------------
+// Tests
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   Nothing plays before boot or for a pattern that does not exist
+ */
+static void test_not_ready(void) {
+  buzzer_request(BUZZER_PATTERN_GAS, true);
+  CHECK_EQ(dmaStarts, 0);
+
+  boot();
+  CHECK(sounding() == false);
+  buzzer_request(BUZZER_NUMBER_OF_PATTERNS, true);
+  CHECK_EQ(dmaStarts, 0);
+  CHECK(sounding() == false);
+}
+
+/**
+ * @brief   Each repeating pattern plays its steps round and round without
+ *          waking the CPU, and stops when released
+ */
+static void test_repeating(void) {
+  static const struct {
+    buzzer_pattern_t pattern;
+    const step_t    *steps;
+    uint32_t         count;
+  } cases[] = {
+    { BUZZER_PATTERN_FALL, fall, sizeof(fall) / sizeof(fall[0]) },
+    { BUZZER_PATTERN_SOS,  sos,  sizeof(sos) / sizeof(sos[0]) },
+    { BUZZER_PATTERN_GAS,  gas,  sizeof(gas) / sizeof(gas[0]) },
+  };
+  uint32_t i;
+
+  boot();
+  for(i = 0; i < sizeof(cases) / sizeof(cases[0]); i++){
+    buzzer_request(cases[i].pattern, true);
+    expect_steps(cases[i].steps, cases[i].count, 0, 3 * cases[i].count + 1);
+    CHECK_EQ(dmaInterrupts, 0);
+
+    buzzer_request(cases[i].pattern, false);
+    CHECK(sounding() == false);
+    CHECK(dmaNext == NULL);
+  }
+}
+
+/**
+ * @brief   The low battery chirp plays once, ends silent with the only
+ *          interrupt, and starts over when requested again while it plays
+ */
+static void test_one_shot(void) {
+  boot();
+  buzzer_request(BUZZER_PATTERN_LOW_BATTERY, true);
+  expect_steps(lowBattery, 3, 0, 3);
+  CHECK_EQ(dmaInterrupts, 1);
+  CHECK(sounding() == false);
+  CHECK_EQ(TIMER1->CC[0].CCV, 0);
+
+  // Requested again, it plays again
+  buzzer_request(BUZZER_PATTERN_LOW_BATTERY, true);
+  expect_steps(lowBattery, 3, 0, 2);
+  buzzer_request(BUZZER_PATTERN_LOW_BATTERY, true);
+  expect_steps(lowBattery, 3, 0, 3);
+  CHECK_EQ(dmaInterrupts, 2);
+  CHECK(sounding() == false);
+}
+
+/**
+ * @brief   The highest priority pattern requested plays, a lower one never
+ *          cuts it short, and releasing it falls back to the next one still
+ *          requested, the chirp last
+ */
+static void test_priority(void) {
+  uint32_t starts;
+
+  boot();
+  buzzer_request(BUZZER_PATTERN_LOW_BATTERY, true);
+  expect_steps(lowBattery, 3, 0, 1);
+
+  buzzer_request(BUZZER_PATTERN_GAS, true);
+  expect_steps(gas, 2, 0, 3);
+
+  // Lower ones wait, the gas alarm is not restarted
+  starts = dmaStarts;
+  buzzer_request(BUZZER_PATTERN_FALL, true);
+  buzzer_request(BUZZER_PATTERN_SOS, true);
+  buzzer_request(BUZZER_PATTERN_LOW_BATTERY, true);
+  buzzer_request(BUZZER_PATTERN_FALL, false);
+  buzzer_request(BUZZER_PATTERN_GAS, true);
+  CHECK_EQ(dmaStarts, starts);
+  expect_steps(gas, 2, 1, 3);
+
+  buzzer_request(BUZZER_PATTERN_FALL, true);
+  buzzer_request(BUZZER_PATTERN_GAS, false);
+  expect_steps(sos, 6, 0, 7);
+  buzzer_request(BUZZER_PATTERN_SOS, false);
+  expect_steps(fall, 2, 0, 3);
+  buzzer_request(BUZZER_PATTERN_FALL, false);
+
+  // The chirp is still owed and plays once
+  expect_steps(lowBattery, 3, 0, 3);
+  CHECK(sounding() == false);
+  CHECK_EQ(dmaInterrupts, 1);
+
+  // Released before it played, it never plays
+  buzzer_request(BUZZER_PATTERN_GAS, true);
+  buzzer_request(BUZZER_PATTERN_LOW_BATTERY, true);
+  buzzer_request(BUZZER_PATTERN_LOW_BATTERY, false);
+  buzzer_request(BUZZER_PATTERN_GAS, false);
+  CHECK(sounding() == false);
+}
+
+int main(void) {
+
+  RUN(test_not_ready);
+  RUN(test_repeating);
+  RUN(test_one_shot);
+  RUN(test_priority);
+
+  return TEST_RESULT();
+}
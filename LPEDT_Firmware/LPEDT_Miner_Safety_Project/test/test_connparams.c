@@ -0,0 +1,245 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    test_connparams.c
+ * @brief   Host test of the connection profiles and the SOFT_TIMER_3
+ *          hold-off in connparams.c
+ *
+ *          The stack records every parameter request and the state of the
+ *          hold-off timer. The tests fire the timer themselves, like the
+ *          soft timer event in ble.c.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "sl_sleeptimer.h"
+#include "sl_bt_api.h"
+#include "connparams.h"
+#include "ble.h"
+
+typedef struct {
+  uint16_t interval;
+  uint16_t latency;
+  uint16_t timeout;
+} request_t;
+
+static ble_data_struct_t  ble_data;
+static uint64_t           nowMs = 1000;
+
+static request_t          lastRequest;
+static uint32_t           requests = 0;
+static bool               refuse = false;       // the stack refuses the request
+
+static bool               holdoffRunning = false;
+static uint32_t           holdoffTicks = 0;
+
+//------------------------------------------------------------------------------
+// Stand-ins for the stack and the rest of the firmware
+//------------------------------------------------------------------------------
+
+ble_data_struct_t* get_ble_data_ptr() {
+  return &ble_data;
+}
+
+uint64_t sl_sleeptimer_get_tick_count64(void) {
+  return nowMs;
+}
+
+sl_status_t sl_sleeptimer_tick64_to_ms(uint64_t tick, uint64_t *ms) {
+  *ms = tick;
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_connection_set_parameters(uint8_t connection,
+                                            uint16_t min_interval,
+                                            uint16_t max_interval,
+                                            uint16_t latency,
+                                            uint16_t timeout,
+                                            uint16_t min_ce_length,
+                                            uint16_t max_ce_length) {
+  CHECK_EQ(connection, ble_data.connectionHandle);
+  CHECK_EQ(min_interval, max_interval);
+  CHECK_EQ(min_ce_length, 0);
+  CHECK_EQ(max_ce_length, 0);
+  if(refuse)
+    return SL_STATUS_FAIL;
+
+  lastRequest.interval = min_interval;
+  lastRequest.latency = latency;
+  lastRequest.timeout = timeout;
+  requests++;
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_system_set_soft_timer(uint32_t time, uint8_t handle, uint8_t single_shot) {
+  CHECK_EQ(handle, SOFT_TIMER_3);
+  CHECK_EQ(single_shot, true);
+  holdoffRunning = (time != 0);
+  if(time != 0)
+    holdoffTicks = time;
+  return SL_STATUS_OK;
+}
+
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   A connection opens
+ * @return  none
+ */
+static void connect(void) {
+  memset(&ble_data, 0, sizeof(ble_data));
+  ble_data.connectionHandle = 2;
+  ble_data.connection_open = true;
+  requests = 0;
+  refuse = false;
+  connparams_reset();
+}
+
+/**
+ * @brief   The hold-off timer fires, if it runs
+ * @return  none
+ */
+static void fire_holdoff(void) {
+  if(holdoffRunning){
+    holdoffRunning = false;
+    connparams_holdoff_expired();
+  }
+}
+
+/**
+ * @brief   Checks that a request keeps the supervision timeout of the Core
+ *          specification: more than (1 + latency) * interval * 2
+ * @param   r   request
+ * @return  none
+ */
+static void check_valid(const request_t *r) {
+  CHECK((r->interval >= 6) && (r->interval <= 3200));
+  CHECK(r->latency <= 499);
+  CHECK((r->timeout >= 10) && (r->timeout <= 3200));
+  CHECK((uint32_t) r->timeout * 10 * 100 > (1 + (uint32_t) r->latency) * r->interval * 125 * 2);
+}
+
+//------------------------------------------------------------------------------
+// Tests
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   A new link keeps what the client chose for the hold-off, then
+ *          asks for the idle profile
+ */
+static void test_holdoff_to_idle(void) {
+  connect();
+  CHECK_EQ(requests, 0);
+  CHECK(holdoffRunning);
+  CHECK_EQ(holdoffTicks, (CONNPARAMS_IDLE_HOLDOFF_MS * SOFT_TIMER_TICK_VALUE_1SEC) / 1000);
+
+  fire_holdoff();
+  CHECK_EQ(requests, 1);
+  CHECK(lastRequest.interval > 200);
+  CHECK(lastRequest.latency > 0);
+  check_valid(&lastRequest);
+
+  // Idle stays idle, nothing more is asked for
+  CHECK(holdoffRunning == false);
+  connparams_set_demand(CONN_DEMAND_OTA, false);
+  CHECK_EQ(requests, 1);
+}
+
+/**
+ * @brief   Any demand asks for the active profile at once and stops the
+ *          hold-off, the last one to clear starts it again
+ */
+static void test_demands(void) {
+  request_t idle;
+
+  connect();
+  fire_holdoff();
+  idle = lastRequest;
+
+  connparams_set_demand(CONN_DEMAND_ALARM, true);
+  CHECK_EQ(requests, 2);
+  CHECK(lastRequest.interval <= 16);
+  CHECK_EQ(lastRequest.latency, 0);
+  check_valid(&lastRequest);
+  CHECK(holdoffRunning == false);
+
+  // Further demands change nothing, the link is already active
+  connparams_set_demand(CONN_DEMAND_ALARM, true);
+  connparams_set_demand(CONN_DEMAND_BULK, true);
+  connparams_set_demand(CONN_DEMAND_ALARM, false);
+  CHECK_EQ(requests, 2);
+  CHECK(holdoffRunning == false);
+
+  // The last demand clears, the hold-off starts, one comes back in time
+  connparams_set_demand(CONN_DEMAND_BULK, false);
+  CHECK(holdoffRunning);
+  connparams_set_demand(CONN_DEMAND_OTA, true);
+  CHECK(holdoffRunning == false);
+  CHECK_EQ(requests, 2);
+
+  // An expiry already queued when the demand came back is ignored
+  connparams_holdoff_expired();
+  CHECK_EQ(requests, 2);
+
+  connparams_set_demand(CONN_DEMAND_OTA, false);
+  fire_holdoff();
+  CHECK_EQ(requests, 3);
+  CHECK(memcmp(&lastRequest, &idle, sizeof(idle)) == 0);
+}
+
+/**
+ * @brief   A refused request is made again on the next demand change, and
+ *          nothing is requested without a connection
+ */
+static void test_refused_and_closed(void) {
+  connect();
+  fire_holdoff();
+
+  refuse = true;
+  connparams_set_demand(CONN_DEMAND_ALARM, true);
+  CHECK_EQ(requests, 1);
+  refuse = false;
+  connparams_set_demand(CONN_DEMAND_BULK, true);
+  CHECK_EQ(requests, 2);
+  CHECK_EQ(lastRequest.latency, 0);
+
+  // The connection closed under a demand
+  ble_data.connection_open = false;
+  connparams_reset();
+  connparams_set_demand(CONN_DEMAND_ALARM, true);
+  connparams_set_demand(CONN_DEMAND_ALARM, false);
+  fire_holdoff();
+  CHECK_EQ(requests, 2);
+
+  // The next connection starts from the hold-off again
+  connect();
+  CHECK(holdoffRunning);
+  CHECK_EQ(requests, 0);
+  connparams_accepted(24, 0, 100);
+  nowMs += CONNPARAMS_IDLE_HOLDOFF_MS;
+  fire_holdoff();
+  CHECK_EQ(requests, 1);
+}
+
+int main(void) {
+
+  RUN(test_holdoff_to_idle);
+  RUN(test_demands);
+  RUN(test_refused_and_closed);
+
+  return TEST_RESULT();
+}
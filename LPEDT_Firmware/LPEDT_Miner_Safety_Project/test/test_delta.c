@@ -0,0 +1,504 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    test_delta.c
+ * @brief   Host test of delta.c against the encoder of fwupdate_tool.py
+ *
+ *          delta_vectors.py writes a source image, a target image and the
+ *          delta the encoder builds between them for every case. The source
+ *          is mapped at DELTA_SOURCE_BASE, delta.c rebuilds the target into
+ *          a storage slot in RAM and the slot must match the target byte for
+ *          byte, whatever size the delta arrives in. One case goes the whole
+ *          way through fwupdate.c, with packets lost on the way.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include "test.h"
+#include "em_device.h"
+#include "btl_interface.h"
+#include "delta.h"
+#include "fwupdate.h"
+#include "connparams.h"
+#include "ble.h"
+#include "gatt_db.h"
+#include "sl_sleeptimer.h"
+#include "sl_bt_api.h"
+
+#define SLOT_LENGTH            (0x3A000)
+#define IMAGE_MAX              (FLASH_SIZE)
+
+// Firmware Update Data payload at the largest MTU
+#define PACKET_PAYLOAD         (MAX_BUFFER_LENGTH - FWUPDATE_DATA_HEADER_SIZE)
+
+typedef struct {
+  uint8_t  *data;
+  uint32_t  len;
+} blob_t;
+
+static uint8_t  *flash;
+static uint8_t   slot[SLOT_LENGTH];
+static uint32_t  slotWritten;
+static uint8_t   writeResponse;
+static uint8_t   readResponse;
+static uint8_t   status[7];
+static ble_data_struct_t bleData = { .bondingStatus = true };
+static bool      installed;
+static bool      rebooted;
+
+static const char *const cases[] = { "rebuild", "fix", "feature", "unrelated" };
+
+//------------------------------------------------------------------------------
+// Stand-ins for the bootloader and the stack
+//------------------------------------------------------------------------------
+
+int32_t bootloader_init(void) {
+  return BOOTLOADER_OK;
+}
+
+void bootloader_getStorageInfo(BootloaderStorageInformation_t *info) {
+  info->numStorageSlots = 1;
+}
+
+int32_t bootloader_getStorageSlotInfo(uint32_t slotId, BootloaderStorageSlot_t *info) {
+  CHECK_EQ(slotId, FWUPDATE_SLOT);
+  info->address = 0x44000;
+  info->length = SLOT_LENGTH;
+  return BOOTLOADER_OK;
+}
+
+int32_t bootloader_eraseWriteStorage(uint32_t slotId, uint32_t offset, uint8_t *buffer, size_t length) {
+  CHECK_EQ(slotId, FWUPDATE_SLOT);
+  // Whole words, in order from the start of the slot
+  CHECK_EQ(offset, slotWritten);
+  CHECK_EQ(length & 3, 0);
+  if(offset + length > SLOT_LENGTH)
+    return BOOTLOADER_ERROR_STORAGE_BASE;
+  memcpy(&slot[offset], buffer, length);
+  slotWritten = offset + (uint32_t) length;
+  return BOOTLOADER_OK;
+}
+
+int32_t bootloader_verifyImage(uint32_t slotId, BootloaderParserCallback_t metadataCallback) {
+  (void) metadataCallback;
+  CHECK_EQ(slotId, FWUPDATE_SLOT);
+  return BOOTLOADER_OK;
+}
+
+int32_t bootloader_setImageToBootload(int32_t slotId) {
+  CHECK_EQ(slotId, FWUPDATE_SLOT);
+  installed = true;
+  return BOOTLOADER_OK;
+}
+
+void bootloader_rebootAndInstall(void) {
+  rebooted = true;
+}
+
+sl_status_t sl_bt_gatt_server_send_user_write_response(uint8_t connection,
+                                                       uint16_t characteristic,
+                                                       uint8_t att_errorcode) {
+  (void) connection;
+  CHECK_EQ(characteristic, gattdb_fw_update_control);
+  writeResponse = att_errorcode;
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_gatt_server_send_user_read_response(uint8_t connection,
+                                                      uint16_t characteristic,
+                                                      uint8_t att_errorcode,
+                                                      size_t value_len,
+                                                      const uint8_t* value,
+                                                      uint16_t *sent_len) {
+  (void) connection;
+  CHECK_EQ(characteristic, gattdb_fw_update_control);
+  readResponse = att_errorcode;
+  if(att_errorcode != 0){
+    CHECK_EQ(value_len, 0);
+    *sent_len = 0;
+    return SL_STATUS_OK;
+  }
+  CHECK_EQ(value_len, sizeof(status));
+  memcpy(status, value, sizeof(status));
+  *sent_len = (uint16_t) value_len;
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_connection_close(uint8_t connection) {
+  (void) connection;
+  return SL_STATUS_OK;
+}
+
+uint64_t sl_sleeptimer_get_tick_count64(void) {
+  return 0;
+}
+
+sl_status_t sl_sleeptimer_tick64_to_ms(uint64_t tick, uint64_t *ms) {
+  *ms = tick;
+  return SL_STATUS_OK;
+}
+
+ble_data_struct_t* get_ble_data_ptr() {
+  return &bleData;
+}
+
+void connparams_set_demand(conn_demand_t demand, bool active) {
+  (void) demand;
+  (void) active;
+}
+
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+
+static void put_u32(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t) v;
+  p[1] = (uint8_t) (v >> 8);
+  p[2] = (uint8_t) (v >> 16);
+  p[3] = (uint8_t) (v >> 24);
+}
+
+static uint32_t crc32(const uint8_t *data, uint32_t len) {
+  return fwupdate_crc32_update(0xFFFFFFFF, data, len) ^ 0xFFFFFFFF;
+}
+
+/**
+ * @brief   Reads a file of delta_vectors.py
+ * @param   name    case
+ * @param   ext     old, new or delta
+ * @return  contents, freed by the caller
+ */
+static blob_t load(const char *name, const char *ext) {
+  char    path[256];
+  blob_t  b = { NULL, 0 };
+  FILE   *f;
+
+  snprintf(path, sizeof(path), "%s/%s.%s", DELTA_VECTORS, name, ext);
+  f = fopen(path, "rb");
+  if(f == NULL){
+    printf("cannot open %s\n", path);
+    exit(1);
+  }
+  b.data = malloc(IMAGE_MAX + DELTA_HEADER_SIZE);
+  b.len = (uint32_t) fread(b.data, 1, IMAGE_MAX + DELTA_HEADER_SIZE, f);
+  fclose(f);
+  return b;
+}
+
+/**
+ * @brief   Puts a source image in the simulated flash and empties the slot
+ * @param   source  running firmware
+ * @return  none
+ */
+static void flash_source(const blob_t *source) {
+  memset(flash, 0xFF, FLASH_SIZE);
+  memcpy(flash, source->data, source->len);
+  memset(slot, 0xFF, sizeof(slot));
+  slotWritten = 0;
+}
+
+/**
+ * @brief   Feeds a delta to delta.c in pieces of a given size
+ * @param   delta   delta bytes
+ * @param   len     number of bytes
+ * @param   piece   bytes per delta_feed(), 0 -> random sizes up to a packet
+ * @return  first error, else what delta_finish() returns
+ */
+static uint8_t apply(const uint8_t *delta, uint32_t len, uint32_t piece) {
+  uint32_t i = 0;
+  uint32_t n;
+  uint8_t  err;
+
+  slotWritten = 0;
+  delta_begin(SLOT_LENGTH);
+  while(i < len){
+    n = (piece != 0) ? piece : (1 + ((uint32_t) rand() % PACKET_PAYLOAD));
+    if(n > len - i)
+      n = len - i;
+    err = delta_feed(&delta[i], n);
+    if(err != 0)
+      return err;
+    i += n;
+  }
+  return delta_finish();
+}
+
+/**
+ * @brief   Writes a LEB128 varint
+ * @param   p       filled in
+ * @param   v       value
+ * @return  number of bytes written
+ */
+static uint32_t put_varint(uint8_t *p, uint32_t v) {
+  uint32_t n = 0;
+
+  while(v > 0x7F){
+    p[n++] = (uint8_t) (0x80 | (v & 0x7F));
+    v >>= 7;
+  }
+  p[n++] = (uint8_t) v;
+  return n;
+}
+
+/**
+ * @brief   Builds a delta header by hand
+ * @param   p       DELTA_HEADER_SIZE bytes
+ * @return  none
+ */
+static void make_header(uint8_t *p, uint32_t sourceSize, uint32_t targetSize, uint32_t targetCrc) {
+  put_u32(&p[0], DELTA_MAGIC);
+  put_u32(&p[4], sourceSize);
+  put_u32(&p[8], crc32(flash, sourceSize));
+  put_u32(&p[12], targetSize);
+  put_u32(&p[16], targetCrc);
+}
+
+//------------------------------------------------------------------------------
+// Tests
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   Every encoder output rebuilds its target, in pieces of any size
+ */
+static void test_rebuild(void) {
+  static const uint32_t pieces[] = { 1, 3, 64, PACKET_PAYLOAD, 0, IMAGE_MAX };
+  blob_t   source;
+  blob_t   target;
+  blob_t   delta;
+  uint32_t c;
+  uint32_t p;
+
+  for(c = 0; c < sizeof(cases) / sizeof(cases[0]); c++){
+    source = load(cases[c], "old");
+    target = load(cases[c], "new");
+    delta = load(cases[c], "delta");
+
+    for(p = 0; p < sizeof(pieces) / sizeof(pieces[0]); p++){
+      flash_source(&source);
+      CHECK_EQ(apply(delta.data, delta.len, pieces[p]), 0);
+      CHECK_EQ(slotWritten, (target.len + 3) & ~3U);
+      CHECK(memcmp(slot, target.data, target.len) == 0);
+    }
+
+    printf("  %-9s delta %6u bytes, %5.1f %% of the %u byte image\n", cases[c],
+           (unsigned int) delta.len, 100.0 * delta.len / target.len, (unsigned int) target.len);
+
+    free(source.data);
+    free(target.data);
+    free(delta.data);
+  }
+}
+
+/**
+ * @brief   Over a link that is not bonded, control reads and writes are
+ *          refused and data writes never reach the slot
+ */
+static void test_not_bonded(void) {
+  uint8_t  control[9];
+  uint8_t  packet[FWUPDATE_DATA_HEADER_SIZE + 16];
+
+  memset(slot, 0xFF, sizeof(slot));
+  slotWritten = 0;
+  memset(packet, 0xA5, sizeof(packet));
+  put_u32(packet, 0);
+
+  control[0] = FWUPDATE_OP_BEGIN;
+  put_u32(&control[1], 16);
+  put_u32(&control[5], crc32(&packet[FWUPDATE_DATA_HEADER_SIZE], 16));
+
+  bleData.bondingStatus = false;
+  fwupdate_handle_control(1, control, sizeof(control));
+  CHECK_EQ(writeResponse, FWUPDATE_ERR_AUTHENTICATION);
+  fwupdate_read_status(1);
+  CHECK_EQ(readResponse, FWUPDATE_ERR_AUTHENTICATION);
+
+  // Not even a transfer a bonded client started takes data from another link
+  bleData.bondingStatus = true;
+  fwupdate_handle_control(1, control, sizeof(control));
+  CHECK_EQ(writeResponse, 0);
+  bleData.bondingStatus = false;
+  fwupdate_handle_data(packet, sizeof(packet));
+  CHECK_EQ(slotWritten, 0);
+
+  bleData.bondingStatus = true;
+  fwupdate_read_status(1);
+  CHECK_EQ(readResponse, 0);
+  CHECK_EQ(status[0], FWUPDATE_RECEIVING);
+  CHECK_EQ(status[1], 0);
+
+  control[0] = FWUPDATE_OP_ABORT;
+  fwupdate_handle_control(1, control, 1);
+  CHECK_EQ(writeResponse, 0);
+}
+
+/**
+ * @brief   A delta through fwupdate.c, every 17th packet lost and resent
+ *          from the offset the control characteristic reports
+ */
+static void test_transfer(void) {
+  uint8_t  control[9];
+  uint8_t  packet[FWUPDATE_DATA_HEADER_SIZE + PACKET_PAYLOAD];
+  blob_t   source = load("feature", "old");
+  blob_t   target = load("feature", "new");
+  blob_t   delta = load("feature", "delta");
+  uint32_t offset = 0;
+  uint32_t n;
+  uint32_t sent = 0;
+
+  flash_source(&source);
+  installed = false;
+  rebooted = false;
+
+  control[0] = FWUPDATE_OP_BEGIN_DELTA;
+  put_u32(&control[1], delta.len);
+  put_u32(&control[5], crc32(delta.data, delta.len));
+  fwupdate_handle_control(1, control, sizeof(control));
+  CHECK_EQ(writeResponse, 0);
+
+  while(offset < delta.len){
+    n = delta.len - offset;
+    if(n > PACKET_PAYLOAD)
+      n = PACKET_PAYLOAD;
+    put_u32(packet, offset);
+    memcpy(&packet[FWUPDATE_DATA_HEADER_SIZE], &delta.data[offset], n);
+    if((++sent % 17) != 0)
+      fwupdate_handle_data(packet, FWUPDATE_DATA_HEADER_SIZE + n);
+    offset += n;
+
+    // The client reads where the device is after every burst of 8
+    if(((sent % 8) == 0) || (offset == delta.len)){
+      fwupdate_read_status(1);
+      CHECK_EQ(status[0], FWUPDATE_RECEIVING);
+      offset = (uint32_t) status[1] | ((uint32_t) status[2] << 8) |
+               ((uint32_t) status[3] << 16) | ((uint32_t) status[4] << 24);
+    }
+  }
+
+  control[0] = FWUPDATE_OP_COMMIT;
+  fwupdate_handle_control(1, control, 1);
+  CHECK_EQ(writeResponse, 0);
+  CHECK(installed);
+  CHECK(memcmp(slot, target.data, target.len) == 0);
+
+  fwupdate_closed();
+  CHECK(rebooted);
+
+  free(source.data);
+  free(target.data);
+  free(delta.data);
+}
+
+/**
+ * @brief   A delta for another firmware is refused on its header, before
+ *          anything is written to the slot
+ */
+static void test_wrong_base(void) {
+  blob_t source = load("fix", "old");
+  blob_t delta = load("fix", "delta");
+
+  flash_source(&source);
+  flash[source.len / 2] ^= 0x01;
+  CHECK_EQ(apply(delta.data, delta.len, PACKET_PAYLOAD), FWUPDATE_ERR_BASE);
+  CHECK_EQ(slotWritten, 0);
+
+  // Source size past the flash
+  flash_source(&source);
+  put_u32(&delta.data[4], FLASH_SIZE + 4);
+  CHECK_EQ(apply(delta.data, delta.len, PACKET_PAYLOAD), FWUPDATE_ERR_BASE);
+
+  free(source.data);
+  free(delta.data);
+}
+
+/**
+ * @brief   Malformed, truncated and corrupted deltas are refused
+ */
+static void test_bad_delta(void) {
+  static const uint8_t literal[] = { 'M', 'S', 'D', '1' };
+  uint8_t  d[256];
+  blob_t   source = load("fix", "old");
+  blob_t   delta = load("fix", "delta");
+  uint32_t n;
+
+  flash_source(&source);
+  CHECK(delta.len < sizeof(d));
+
+  // Truncated anywhere, including inside the header
+  CHECK_EQ(apply(delta.data, DELTA_HEADER_SIZE - 1, PACKET_PAYLOAD), FWUPDATE_ERR_INCOMPLETE);
+  CHECK_EQ(apply(delta.data, delta.len - 1, PACKET_PAYLOAD), FWUPDATE_ERR_INCOMPLETE);
+
+  // Bytes past the end of the target
+  memcpy(d, delta.data, delta.len);
+  d[delta.len] = 0x00;
+  CHECK_EQ(apply(d, delta.len + 1, PACKET_PAYLOAD), FWUPDATE_ERR_PATCH);
+
+  // Bad magic
+  memcpy(d, delta.data, delta.len);
+  d[0] ^= 0xFF;
+  CHECK_EQ(apply(d, delta.len, PACKET_PAYLOAD), FWUPDATE_ERR_PATCH);
+
+  // Target larger than the slot
+  make_header(d, source.len, SLOT_LENGTH + 1, 0);
+  CHECK_EQ(apply(d, DELTA_HEADER_SIZE, PACKET_PAYLOAD), FWUPDATE_ERR_SIZE);
+
+  // A literal run that does not match the target CRC
+  make_header(d, source.len, sizeof(literal), crc32(literal, sizeof(literal)));
+  d[DELTA_HEADER_SIZE] = sizeof(literal) - 1;
+  memcpy(&d[DELTA_HEADER_SIZE + 1], literal, sizeof(literal));
+  n = DELTA_HEADER_SIZE + 1 + sizeof(literal);
+  CHECK_EQ(apply(d, n, 1), 0);
+  CHECK(memcmp(slot, literal, sizeof(literal)) == 0);
+  d[n - 1] ^= 0x20;
+  CHECK_EQ(apply(d, n, 1), FWUPDATE_ERR_CRC);
+
+  // Unknown opcode
+  d[DELTA_HEADER_SIZE] = DELTA_OP_COPY + 1;
+  CHECK_EQ(apply(d, n, 1), FWUPDATE_ERR_PATCH);
+
+  // A copy that reads past the end of the source
+  make_header(d, source.len, 8, 0);
+  n = DELTA_HEADER_SIZE;
+  d[n++] = DELTA_OP_COPY;
+  n += put_varint(&d[n], 8);
+  n += put_varint(&d[n], (source.len - 4) << 1);
+  CHECK_EQ(apply(d, n, PACKET_PAYLOAD), FWUPDATE_ERR_PATCH);
+
+  // A varint longer than 32 bits
+  memset(&d[DELTA_HEADER_SIZE + 1], 0xFF, 8);
+  CHECK_EQ(apply(d, DELTA_HEADER_SIZE + 9, PACKET_PAYLOAD), FWUPDATE_ERR_PATCH);
+
+  free(source.data);
+  free(delta.data);
+}
+
+int main(void) {
+  // The running firmware sits at DELTA_SOURCE_BASE, where delta.c reads it
+  flash = mmap((void *) DELTA_SOURCE_BASE, FLASH_SIZE, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+  if(flash != (uint8_t *) DELTA_SOURCE_BASE){
+    printf("cannot map the flash at 0x%08lx\n", (unsigned long) DELTA_SOURCE_BASE);
+    return 1;
+  }
+  srand(1);
+
+  RUN(test_rebuild);
+  RUN(test_not_bonded);
+  RUN(test_transfer);
+  RUN(test_wrong_base);
+  RUN(test_bad_delta);
+
+  return TEST_RESULT();
+}
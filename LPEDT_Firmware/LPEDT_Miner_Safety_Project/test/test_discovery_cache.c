@@ -0,0 +1,262 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    test_discovery_cache.c
+ * @brief   Host test of the NVM3 handle cache in discovery_cache.c
+ *
+ *          The stack keeps the user NVM keys in RAM and counts the writes,
+ *          each of which costs flash wear on the gateway.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "discovery_cache.h"
+
+// The stack allows 0x4000 to 0x407F for user data, 56 bytes per key
+#define NVM_USER_KEYS     (0x80)
+#define NVM_KEY_MAX       (56)
+
+typedef struct {
+  bool    valid;
+  size_t  len;
+  uint8_t value[NVM_KEY_MAX];
+} nvm_key_t;
+
+static nvm_key_t  nvm[NVM_USER_KEYS];
+static uint32_t   nvmWrites = 0;
+static uint32_t   nvmErases = 0;
+
+//------------------------------------------------------------------------------
+// Stand-ins for the stack and the rest of the firmware
+//------------------------------------------------------------------------------
+
+sl_status_t sl_bt_nvm_save(uint16_t key, size_t value_len, const uint8_t* value) {
+  CHECK((key >= 0x4000) && (key < 0x4000 + NVM_USER_KEYS));
+  CHECK(value_len <= NVM_KEY_MAX);
+  if((key < 0x4000) || (key >= 0x4000 + NVM_USER_KEYS) || (value_len > NVM_KEY_MAX))
+    return SL_STATUS_FAIL;
+
+  nvm[key - 0x4000].valid = true;
+  nvm[key - 0x4000].len = value_len;
+  memcpy(nvm[key - 0x4000].value, value, value_len);
+  nvmWrites++;
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_nvm_load(uint16_t key, size_t max_value_size, size_t *value_len, uint8_t *value) {
+  CHECK((key >= 0x4000) && (key < 0x4000 + NVM_USER_KEYS));
+  if((key < 0x4000) || (key >= 0x4000 + NVM_USER_KEYS) || (nvm[key - 0x4000].valid == false))
+    return SL_STATUS_NOT_FOUND;
+  if(nvm[key - 0x4000].len > max_value_size)
+    return SL_STATUS_FAIL;
+
+  memcpy(value, nvm[key - 0x4000].value, nvm[key - 0x4000].len);
+  *value_len = nvm[key - 0x4000].len;
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_nvm_erase(uint16_t key) {
+  CHECK((key >= 0x4000) && (key < 0x4000 + NVM_USER_KEYS));
+  if((key < 0x4000) || (key >= 0x4000 + NVM_USER_KEYS) || (nvm[key - 0x4000].valid == false))
+    return SL_STATUS_NOT_FOUND;
+
+  nvm[key - 0x4000].valid = false;
+  nvmErases++;
+  return SL_STATUS_OK;
+}
+
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   Fills in the cache entry of a helmet
+ * @param   helmet    index, also its address
+ * @param   version   Database Hash of its firmware
+ * @param   entry     filled in
+ * @return  none
+ */
+static void helmet_entry(uint32_t helmet, uint8_t version, discovery_cache_entry_t *entry) {
+  memset(entry, 0, sizeof(*entry));
+  entry->address.addr[0] = (uint8_t) helmet;
+  entry->address.addr[5] = 0x84;
+  memset(entry->hash, version, sizeof(entry->hash));
+  entry->hashHandle = 0x0012;
+  entry->htmHandle = 0x0020 + version;
+  entry->buttonHandle = 0x0030 + version;
+}
+
+/**
+ * @brief   Returns whether a helmet is cached with the handles of a version
+ * @param   helmet    index
+ * @param   version   Database Hash expected
+ * @return  true if it is
+ */
+static bool cached_as(uint32_t helmet, uint8_t version) {
+  discovery_cache_entry_t expected;
+  discovery_cache_entry_t entry;
+
+  helmet_entry(helmet, version, &expected);
+  memset(&entry, 0xA5, sizeof(entry));
+  if(discovery_cache_lookup(&expected.address, &entry) == false)
+    return false;
+  return memcmp(&entry, &expected, sizeof(entry)) == 0;
+}
+
+/**
+ * @brief   Erases the user NVM keys
+ * @return  none
+ */
+static void wipe(void) {
+  memset(nvm, 0, sizeof(nvm));
+  nvmWrites = 0;
+  nvmErases = 0;
+}
+
+//------------------------------------------------------------------------------
+// Tests
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   An entry fits a user key and comes back as it was stored, an
+ *          unchanged entry is not written again, a changed one replaces it
+ */
+static void test_store_lookup(void) {
+  discovery_cache_entry_t entry;
+
+  CHECK(sizeof(discovery_cache_entry_t) <= NVM_KEY_MAX);
+  CHECK(DISCOVERY_CACHE_KEY_BASE + DISCOVERY_CACHE_ENTRIES <= 0x4000 + NVM_USER_KEYS);
+
+  wipe();
+  helmet_entry(1, 1, &entry);
+  CHECK(discovery_cache_lookup(&entry.address, &entry) == false);
+
+  discovery_cache_store(&entry);
+  CHECK_EQ(nvmWrites, 1);
+  CHECK(cached_as(1, 1));
+  CHECK(cached_as(2, 1) == false);
+
+  // Reconnection with the same database, no flash write
+  discovery_cache_store(&entry);
+  CHECK_EQ(nvmWrites, 1);
+
+  // The helmet was updated, its new handles take the same key
+  helmet_entry(1, 2, &entry);
+  discovery_cache_store(&entry);
+  CHECK_EQ(nvmWrites, 2);
+  CHECK(cached_as(1, 2));
+  CHECK(cached_as(1, 1) == false);
+  CHECK(nvm[1].valid == false);
+}
+
+/**
+ * @brief   A full cache reuses its entries in turn, the other helmets stay
+ *          cached
+ */
+static void test_full_cache(void) {
+  discovery_cache_entry_t entry;
+  uint32_t                i;
+
+  wipe();
+  for(i = 0; i < DISCOVERY_CACHE_ENTRIES; i++){
+    helmet_entry(i, 1, &entry);
+    discovery_cache_store(&entry);
+  }
+  for(i = 0; i < DISCOVERY_CACHE_ENTRIES; i++)
+    CHECK(cached_as(i, 1));
+
+  // Two more helmets take two entries
+  helmet_entry(DISCOVERY_CACHE_ENTRIES, 1, &entry);
+  discovery_cache_store(&entry);
+  helmet_entry(DISCOVERY_CACHE_ENTRIES + 1, 1, &entry);
+  discovery_cache_store(&entry);
+  CHECK_EQ(nvmWrites, DISCOVERY_CACHE_ENTRIES + 2);
+
+  CHECK(cached_as(DISCOVERY_CACHE_ENTRIES, 1));
+  CHECK(cached_as(DISCOVERY_CACHE_ENTRIES + 1, 1));
+  // The first two went, every other one is still there
+  for(i = 0; i < DISCOVERY_CACHE_ENTRIES; i++)
+    CHECK(cached_as(i, 1) == (i >= 2));
+
+  // The next after them goes next
+  helmet_entry(DISCOVERY_CACHE_ENTRIES + 2, 1, &entry);
+  discovery_cache_store(&entry);
+  CHECK(cached_as(2, 1) == false);
+  CHECK(cached_as(DISCOVERY_CACHE_ENTRIES, 1));
+
+  // Nothing beyond the cache keys was touched
+  for(i = DISCOVERY_CACHE_ENTRIES; i < NVM_USER_KEYS; i++)
+    CHECK(nvm[i].valid == false);
+}
+
+/**
+ * @brief   A forgotten helmet is erased and its key is taken first by the
+ *          next new helmet, before any other entry is reused
+ */
+static void test_forget(void) {
+  discovery_cache_entry_t entry;
+  uint32_t                i;
+
+  wipe();
+  for(i = 0; i < DISCOVERY_CACHE_ENTRIES; i++){
+    helmet_entry(i, 1, &entry);
+    discovery_cache_store(&entry);
+  }
+
+  helmet_entry(3, 1, &entry);
+  discovery_cache_forget(&entry.address);
+  CHECK_EQ(nvmErases, 1);
+  CHECK(cached_as(3, 1) == false);
+
+  // Forgetting an unknown helmet erases nothing
+  discovery_cache_forget(&entry.address);
+  CHECK_EQ(nvmErases, 1);
+
+  helmet_entry(40, 1, &entry);
+  discovery_cache_store(&entry);
+  CHECK(nvm[3].valid);
+  CHECK(cached_as(40, 1));
+  for(i = 0; i < DISCOVERY_CACHE_ENTRIES; i++)
+    CHECK(cached_as(i, 1) == (i != 3));
+}
+
+/**
+ * @brief   A key of another size, left by an older layout, reads as empty
+ *          and is overwritten
+ */
+static void test_old_layout(void) {
+  discovery_cache_entry_t entry;
+  uint8_t                 old[sizeof(discovery_cache_entry_t) - 2];
+
+  wipe();
+  helmet_entry(5, 1, &entry);
+  memcpy(old, &entry, sizeof(old));
+  CHECK(sl_bt_nvm_save(DISCOVERY_CACHE_KEY_BASE, sizeof(old), old) == SL_STATUS_OK);
+
+  CHECK(cached_as(5, 1) == false);
+  discovery_cache_store(&entry);
+  CHECK_EQ(nvm[0].len, sizeof(discovery_cache_entry_t));
+  CHECK(cached_as(5, 1));
+}
+
+int main(void) {
+
+  RUN(test_store_lookup);
+  RUN(test_full_cache);
+  RUN(test_forget);
+  RUN(test_old_layout);
+
+  return TEST_RESULT();
+}
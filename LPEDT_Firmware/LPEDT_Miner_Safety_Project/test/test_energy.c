@@ -0,0 +1,464 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    test_energy.c
+ * @brief   Host test of the EM2 / EM3 choice of every wait and of the hold
+ *          tracking in energy.c
+ *
+ *          The power manager counts the requirements it is given and keeps
+ *          the transition callback, the tests raise the transitions
+ *          themselves. LETIMER0 is reduced to the times to its next
+ *          interrupt and sample and to the clock it runs from. The holds are
+ *          seen through what energy.c writes to VCOM.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "em_device.h"
+#include "em_cmu.h"
+#include "sl_power_manager.h"
+#include "sl_sleeptimer.h"
+#include "energy.h"
+#include "timers.h"
+#include "app_log.h"
+
+// Sleeptimer ticks of 125 ms, a whole number of ms
+#define TICKS_125_MS      (4096)
+
+CMU_TypeDef hostCmu;
+
+static uint32_t requirements[SL_POWER_MANAGER_EM3 + 1];
+static const sl_power_manager_em_transition_event_info_t *transition = NULL;
+
+static bool     timerPending = false;
+static uint32_t msToIrq = 100000;
+static uint32_t msToSample = 100000;
+static bool     letimerUlfrco = false;
+static uint32_t clockSwitches = 0;
+static uint32_t lfxoStarts = 0;
+static uint32_t tickCount = 0;
+
+//------------------------------------------------------------------------------
+// Stand-ins for the stack and the rest of the firmware
+//------------------------------------------------------------------------------
+
+void sl_power_manager_add_em_requirement(sl_power_manager_em_t em) {
+  requirements[em]++;
+}
+
+void sl_power_manager_remove_em_requirement(sl_power_manager_em_t em) {
+  CHECK(requirements[em] > 0);
+  requirements[em]--;
+}
+
+void sl_power_manager_subscribe_em_transition_event(sl_power_manager_em_transition_event_handle_t     *event_handle,
+                                                    const sl_power_manager_em_transition_event_info_t *event_info) {
+  CHECK(event_handle != NULL);
+  transition = event_info;
+}
+
+sl_status_t sl_sleeptimer_get_remaining_time_of_first_timer(uint16_t option_flags, uint32_t *time) {
+  (void) option_flags;
+  *time = 0;
+  return timerPending ? SL_STATUS_OK : SL_STATUS_NOT_FOUND;
+}
+
+uint32_t sl_sleeptimer_get_tick_count(void) {
+  return tickCount;
+}
+
+uint32_t sl_sleeptimer_tick_to_ms(uint32_t tick) {
+  return (uint32_t) (((uint64_t) tick * 1000) / 32768);
+}
+
+uint32_t LETIMER0_Ms_To_Next_Irq(void) {
+  return msToIrq;
+}
+
+uint32_t LETIMER0_Ms_To_Next_Sample(void) {
+  return msToSample;
+}
+
+void LETIMER0_Select_Clock(bool ulfrco) {
+  if(ulfrco != letimerUlfrco)
+    clockSwitches++;
+  letimerUlfrco = ulfrco;
+}
+
+void CMU_OscillatorEnable(CMU_Osc_TypeDef osc, bool enable, bool wait) {
+  CHECK_EQ(osc, cmuOsc_LFXO);
+  CHECK(enable);
+  // The start-up of the LFXO is far too long to wait for with the
+  // interrupts disabled
+  CHECK(wait == false);
+  lfxoStarts++;
+  CMU->STATUS &= ~CMU_STATUS_LFXORDY;
+}
+
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   Boots with nothing pending and the next sample far away
+ * @return  none
+ */
+static void boot(void) {
+  uint32_t i;
+
+  for(i = 0; i <= SL_POWER_MANAGER_EM3; i++)
+    requirements[i] = 0;
+  transition = NULL;
+  timerPending = false;
+  msToIrq = ENERGY_EM3_MIN_IDLE_MS;
+  msToSample = ENERGY_EM3_MIN_IDLE_MS;
+  letimerUlfrco = false;
+  clockSwitches = 0;
+  lfxoStarts = 0;
+  tickCount = 0;
+  CMU->STATUS = CMU_STATUS_LFXORDY;
+  energy_init();
+  host_log_clear();
+}
+
+/**
+ * @brief   Counts a text in what was written to VCOM since the last clear
+ * @param   text    text to look for
+ * @return  number of times it was written
+ */
+static uint32_t logged(const char *text) {
+  const char *at = host_log_text();
+  uint32_t    n = 0;
+
+  while((at = strstr(at, text)) != NULL){
+    n++;
+    at += strlen(text);
+  }
+  return n;
+}
+
+/**
+ * @brief   Prepares a wait
+ * @return  true if the wait may go to EM3
+ */
+static bool wait_em3(void) {
+  CHECK(energy_prepare_sleep());
+  CHECK(requirements[SL_POWER_MANAGER_EM2] <= 1);
+  return (requirements[SL_POWER_MANAGER_EM2] == 0);
+}
+
+/**
+ * @brief   Raises a transition the way the power manager does, if it was
+ *          subscribed to
+ * @param   from    energy mode left
+ * @param   to      energy mode entered
+ * @return  none
+ */
+static void pm_transition(sl_power_manager_em_t from, sl_power_manager_em_t to) {
+  uint32_t event = 0;
+
+  if(to == SL_POWER_MANAGER_EM3)
+    event = SL_POWER_MANAGER_EVENT_TRANSITION_ENTERING_EM3;
+  else if(from == SL_POWER_MANAGER_EM3)
+    event = SL_POWER_MANAGER_EVENT_TRANSITION_LEAVING_EM3;
+
+  if((event & transition->event_mask) != 0)
+    transition->on_event(from, to);
+}
+
+//------------------------------------------------------------------------------
+// Tests
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   Boot holds EM2 and listens to both EM3 transitions
+ */
+static void test_init(void) {
+  boot();
+  CHECK_EQ(requirements[SL_POWER_MANAGER_EM2], 1);
+  CHECK(transition != NULL);
+  CHECK(transition->event_mask & SL_POWER_MANAGER_EVENT_TRANSITION_ENTERING_EM3);
+  CHECK(transition->event_mask & SL_POWER_MANAGER_EVENT_TRANSITION_LEAVING_EM3);
+
+  // Preparing the same wait twice changes nothing
+  CHECK(wait_em3());
+  CHECK(wait_em3());
+  CHECK_EQ(clockSwitches, 0);
+}
+
+/**
+ * @brief   EM3 only when the next sample pays for the clock switches, no
+ *          sleeptimer timer is pending and no LETIMER0 interrupt is close
+ */
+static void test_em3_pays_off(void) {
+  boot();
+  CHECK(wait_em3());
+
+  msToSample = ENERGY_EM3_MIN_IDLE_MS - 1;
+  CHECK(wait_em3() == false);
+  msToSample = ENERGY_EM3_MIN_IDLE_MS;
+  CHECK(wait_em3());
+
+  timerPending = true;
+  CHECK(wait_em3() == false);
+  timerPending = false;
+  CHECK(wait_em3());
+
+  // A timed wait or an underflow about to fire
+  msToIrq = ENERGY_EM3_GUARD_MS - 1;
+  CHECK(wait_em3() == false);
+  msToIrq = ENERGY_EM3_GUARD_MS;
+  CHECK(wait_em3());
+
+  // Deciding never touches the clock, only the transition does
+  CHECK_EQ(clockSwitches, 0);
+  CHECK_EQ(lfxoStarts, 0);
+}
+
+/**
+ * @brief   LETIMER0 moves to the ULFRCO on entering EM3, EM3 then needs no
+ *          idle gap, and it moves back once the restarted LFXO is ready
+ */
+static void test_round_trip(void) {
+  boot();
+  CHECK(wait_em3());
+  pm_transition(SL_POWER_MANAGER_EM0, SL_POWER_MANAGER_EM3);
+  CHECK(letimerUlfrco);
+  CHECK_EQ(clockSwitches, 1);
+
+  // Woken by the underflow, the switch is paid for
+  pm_transition(SL_POWER_MANAGER_EM3, SL_POWER_MANAGER_EM0);
+  CHECK_EQ(lfxoStarts, 1);
+  pm_transition(SL_POWER_MANAGER_EM0, SL_POWER_MANAGER_EM3);
+
+  msToIrq = 0;
+  msToSample = LETIMER_PERIOD_MS;
+  CHECK(wait_em3());
+  CHECK(letimerUlfrco);
+
+  // Held in EM2 while the LFXO starts, on the ULFRCO until it is ready
+  pm_transition(SL_POWER_MANAGER_EM3, SL_POWER_MANAGER_EM0);
+  CHECK_EQ(lfxoStarts, 2);
+  CHECK(wait_em3() == false);
+  CHECK(letimerUlfrco);
+  CHECK(wait_em3() == false);
+  CHECK(letimerUlfrco);
+
+  CMU->STATUS |= CMU_STATUS_LFXORDY;
+  CHECK(wait_em3() == false);
+  CHECK(letimerUlfrco == false);
+  CHECK_EQ(clockSwitches, 2);
+
+  // On the LFXO again the idle gap counts
+  msToIrq = ENERGY_EM3_MIN_IDLE_MS;
+  CHECK(wait_em3() == false);
+  msToSample = ENERGY_EM3_MIN_IDLE_MS;
+  CHECK(wait_em3());
+
+  // Leaving EM2 restarts nothing
+  pm_transition(SL_POWER_MANAGER_EM2, SL_POWER_MANAGER_EM0);
+  CHECK_EQ(lfxoStarts, 2);
+}
+
+/**
+ * @brief   A sleeptimer timer started on the ULFRCO holds EM2 at once, the
+ *          RTCC behind it needs the LFXO
+ */
+static void test_timer_on_ulfrco(void) {
+  boot();
+  CHECK(wait_em3());
+  pm_transition(SL_POWER_MANAGER_EM0, SL_POWER_MANAGER_EM3);
+  pm_transition(SL_POWER_MANAGER_EM3, SL_POWER_MANAGER_EM0);
+  CMU->STATUS |= CMU_STATUS_LFXORDY;
+
+  timerPending = true;
+  CHECK(wait_em3() == false);
+  CHECK(letimerUlfrco == false);
+  CHECK_EQ(clockSwitches, 2);
+}
+
+/**
+ * @brief   A need is one requirement however many hold it, a release closes
+ *          the oldest hold of its need whichever site it comes from
+ */
+static void test_hold_pairing(void) {
+  boot();
+  energy_require(ENERGY_NEED_BUZZER, "buzzer", 3);
+  tickCount += TICKS_125_MS;
+  energy_require(ENERGY_NEED_I2C, "first", 1);
+  tickCount += TICKS_125_MS;
+  energy_require(ENERGY_NEED_I2C, "second", 2);
+  CHECK_EQ(requirements[SL_POWER_MANAGER_EM1], 2);
+
+  tickCount += 2 * TICKS_125_MS;
+  energy_release(ENERGY_NEED_I2C, "release", 4);
+  CHECK_EQ(requirements[SL_POWER_MANAGER_EM1], 2);
+  energy_dump();
+  CHECK_EQ(logged("need 0 EM1, 1 held, 2 holds, 0 untracked, 375 ms blocked"), 1);
+  CHECK_EQ(logged("longest 375 ms from first:1, last release at release:4"), 1);
+  CHECK_EQ(logged("holder second:2 of need 0 for 250 ms"), 1);
+  CHECK_EQ(logged("holder first:1"), 0);
+
+  host_log_clear();
+  tickCount += TICKS_125_MS;
+  energy_release(ENERGY_NEED_I2C, "release", 5);
+  energy_release(ENERGY_NEED_BUZZER, "release", 6);
+  CHECK_EQ(requirements[SL_POWER_MANAGER_EM1], 0);
+  energy_dump();
+  CHECK_EQ(logged("need 0 EM1, 0 held, 2 holds, 0 untracked, 750 ms blocked"), 1);
+  CHECK_EQ(logged("longest 375 ms from first:1, last release at release:5"), 1);
+  CHECK_EQ(logged("need 1 EM1, 0 held, 1 holds, 0 untracked, 625 ms blocked"), 1);
+  CHECK_EQ(logged("holder"), 0);
+
+  // One release too many is reported and takes nothing away
+  host_log_clear();
+  energy_release(ENERGY_NEED_I2C, "extra", 7);
+  CHECK_EQ(logged("need 0 released while not held at extra:7"), 1);
+  CHECK_EQ(requirements[SL_POWER_MANAGER_EM1], 0);
+
+  // The LFXO timed waits hold EM2 on top of the wait
+  energy_require(ENERGY_NEED_LFXO_TIMER, "wait", 8);
+  CHECK_EQ(requirements[SL_POWER_MANAGER_EM2], 2);
+  energy_release(ENERGY_NEED_LFXO_TIMER, "wait", 9);
+  CHECK_EQ(requirements[SL_POWER_MANAGER_EM2], 1);
+}
+
+/**
+ * @brief   A hold is reported once it went past the bound of its need, once
+ *          only and with all the holders, a need without a bound never is
+ */
+static void test_over_bound(void) {
+  boot();
+  energy_require(ENERGY_NEED_I2C, "i2c", 1);
+  energy_require(ENERGY_NEED_BUZZER, "buzzer", 2);
+  energy_require(ENERGY_NEED_LFXO_TIMER, "wait", 3);
+
+  // The bound itself is still fine
+  tickCount = (ENERGY_HOLD_LIMIT_I2C_MS / 125) * TICKS_125_MS;
+  energy_check_holds();
+  CHECK_EQ(logged("energy:"), 0);
+
+  tickCount += 33;
+  energy_check_holds();
+  CHECK_EQ(logged("held by"), 1);
+  CHECK_EQ(logged("need 0 held by i2c:1 for 1001 ms, bound 1000 ms"), 1);
+  CHECK_EQ(logged("holder buzzer:2 of need 1"), 1);
+  CHECK_EQ(logged("holder wait:3 of need 2"), 1);
+
+  host_log_clear();
+  tickCount += 10 * TICKS_125_MS;
+  energy_check_holds();
+  CHECK_EQ(logged("energy:"), 0);
+
+  tickCount = (ENERGY_HOLD_LIMIT_LFXO_MS / 125) * TICKS_125_MS + 33;
+  energy_check_holds();
+  CHECK_EQ(logged("held by"), 1);
+  CHECK_EQ(logged("need 2 held by wait:3 for 5001 ms, bound 5000 ms"), 1);
+
+  // An alarm plays for as long as it takes
+  host_log_clear();
+  tickCount += 3600 * 8 * TICKS_125_MS;
+  energy_check_holds();
+  CHECK_EQ(logged("energy:"), 0);
+
+  // The slot of a reported hold reports its next one again
+  energy_release(ENERGY_NEED_I2C, "i2c", 4);
+  energy_require(ENERGY_NEED_I2C, "again", 5);
+  tickCount += 9 * TICKS_125_MS;
+  energy_check_holds();
+  CHECK_EQ(logged("held by"), 1);
+  CHECK_EQ(logged("need 0 held by again:5 for 1125 ms"), 1);
+}
+
+/**
+ * @brief   Holds past ENERGY_MAX_HOLDS are counted, still pair with their
+ *          releases and are not reported
+ */
+static void test_untracked(void) {
+  uint32_t i;
+
+  boot();
+  for(i = 0; i < ENERGY_MAX_HOLDS + 2; i++){
+    energy_require(ENERGY_NEED_I2C, "i2c", (uint16_t) i);
+    tickCount += TICKS_125_MS;
+  }
+  CHECK_EQ(requirements[SL_POWER_MANAGER_EM1], 1);
+
+  tickCount += 8 * TICKS_125_MS;
+  energy_check_holds();
+  CHECK_EQ(logged("held by"), ENERGY_MAX_HOLDS);
+  CHECK_EQ(logged("need 0 EM1, 10 held, 10 holds, 2 untracked"), 1);
+  CHECK_EQ(logged("holder i2c:"), ENERGY_MAX_HOLDS);
+  CHECK_EQ(logged("holder i2c:8 "), 0);
+
+  // Every release pairs, the untracked ones with nothing
+  host_log_clear();
+  for(i = 0; i < ENERGY_MAX_HOLDS + 2; i++){
+    CHECK_EQ(requirements[SL_POWER_MANAGER_EM1], 1);
+    energy_release(ENERGY_NEED_I2C, "i2c", 100);
+  }
+  CHECK_EQ(requirements[SL_POWER_MANAGER_EM1], 0);
+  CHECK_EQ(logged("not held"), 0);
+  energy_dump();
+  CHECK_EQ(logged("need 0 EM1, 0 held, 10 holds, 2 untracked, 14500 ms blocked"), 1);
+
+  // The slots are free again
+  host_log_clear();
+  energy_require(ENERGY_NEED_I2C, "i2c", 200);
+  energy_dump();
+  CHECK_EQ(logged("2 untracked"), 1);
+  CHECK_EQ(logged("holder i2c:200 "), 1);
+  energy_release(ENERGY_NEED_I2C, "i2c", 201);
+}
+
+/**
+ * @brief   The oldest hold and the time held stay right across a wrap of
+ *          the tick count
+ */
+static void test_tick_wrap(void) {
+  boot();
+  tickCount = 0 - TICKS_125_MS;
+  energy_require(ENERGY_NEED_I2C, "before", 1);
+  tickCount += 2 * TICKS_125_MS;
+  energy_require(ENERGY_NEED_I2C, "after", 2);
+
+  tickCount += TICKS_125_MS;
+  energy_release(ENERGY_NEED_I2C, "release", 3);
+  energy_dump();
+  CHECK_EQ(logged("longest 375 ms from before:1"), 1);
+  CHECK_EQ(logged("holder after:2 of need 0 for 125 ms"), 1);
+
+  host_log_clear();
+  tickCount += 7 * TICKS_125_MS;
+  energy_check_holds();
+  CHECK_EQ(logged("held by"), 0);
+  tickCount += 33;
+  energy_check_holds();
+  CHECK_EQ(logged("need 0 held by after:2 for 1001 ms"), 1);
+}
+
+int main(void) {
+
+  RUN(test_init);
+  RUN(test_em3_pays_off);
+  RUN(test_round_trip);
+  RUN(test_timer_on_ulfrco);
+  RUN(test_hold_pairing);
+  RUN(test_over_bound);
+  RUN(test_untracked);
+  RUN(test_tick_wrap);
+
+  return TEST_RESULT();
+}
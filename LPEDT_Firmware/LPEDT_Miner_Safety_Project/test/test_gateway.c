@@ -0,0 +1,549 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    test_gateway.c
+ * @brief   Host test of the slot scheduler in gateway.c: the scan report
+ *          filter, one connection attempt at a time, the connect timeout,
+ *          slot rotation and the scan duty cycle
+ *
+ *          The stack records connection attempts and closes, the tests
+ *          deliver the opened and closed events themselves. Nothing is
+ *          enrolled, helmets are recognised by the Health Thermometer
+ *          service they advertise.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "sl_sleeptimer.h"
+#include "sl_bt_api.h"
+#include "gateway.h"
+#include "allowlist.h"
+#include "ble.h"
+
+#define HELMETS           (7)
+#define AD_MAX            (31)
+
+// Flags, and the Battery and Health Thermometer services
+static const uint8_t adHtm[] = { 0x02, 0x01, 0x06, 0x05, 0x02, 0x0F, 0x18, 0x09, 0x18 };
+static const uint8_t adOther[] = { 0x02, 0x01, 0x06, 0x03, 0x03, 0x0F, 0x18 };
+
+typedef struct {
+  bool     active;
+  uint8_t  connection;
+  bd_addr  address;
+} attempt_t;
+
+static uint64_t   nowMs = 1000;
+
+static attempt_t  attempt;
+static uint8_t    nextConnection = 1;
+static uint32_t   opens = 0;
+static uint32_t   closes = 0;
+static uint8_t    lastClosed = 0;
+
+static uint16_t   scanInterval = 0;
+static uint32_t   scanRestarts = 0;
+
+static uint8_t    reportBuf[sizeof(sl_bt_evt_scanner_scan_report_t) + AD_MAX] __attribute__((aligned(4)));
+
+//------------------------------------------------------------------------------
+// Stand-ins for the stack and the rest of the firmware
+//------------------------------------------------------------------------------
+
+uint64_t sl_sleeptimer_get_tick_count64(void) {
+  return nowMs;
+}
+
+sl_status_t sl_sleeptimer_tick64_to_ms(uint64_t tick, uint64_t *ms) {
+  *ms = tick;
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_system_set_soft_timer(uint32_t time, uint8_t handle, uint8_t single_shot) {
+  CHECK_EQ(time, SOFT_TIMER_TICK_VALUE_1SEC);
+  CHECK_EQ(handle, GATEWAY_SOFT_TIMER);
+  CHECK_EQ(single_shot, false);
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_connection_open(bd_addr address,
+                                  uint8_t address_type,
+                                  uint8_t initiating_phy,
+                                  uint8_t *connection) {
+  (void) address_type;
+  CHECK_EQ(initiating_phy, sl_bt_gap_phy_1m);
+  // The gateway opens one connection at a time
+  CHECK(attempt.active == false);
+
+  attempt.active = true;
+  attempt.connection = nextConnection++;
+  attempt.address = address;
+  *connection = attempt.connection;
+  opens++;
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_connection_close(uint8_t connection) {
+  lastClosed = connection;
+  closes++;
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_scanner_stop(void) {
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_scanner_set_timing(uint8_t phys, uint16_t scan_interval, uint16_t scan_window) {
+  CHECK_EQ(phys, sl_bt_gap_1m_phy);
+  CHECK(scan_window <= scan_interval);
+  scanInterval = scan_interval;
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_scanner_start(uint8_t scanning_phy, uint8_t discover_mode) {
+  CHECK_EQ(scanning_phy, sl_bt_gap_1m_phy);
+  CHECK_EQ(discover_mode, sl_bt_scanner_discover_generic);
+  scanRestarts++;
+  return SL_STATUS_OK;
+}
+
+void allowlist_init(void) {
+}
+
+uint32_t allowlist_count(void) {
+  return 0;
+}
+
+allowlist_result_t allowlist_check(const bd_addr *address, uint32_t nowMs) {
+  (void) address;
+  (void) nowMs;
+  CHECK(false);
+  return ALLOWLIST_REJECT;
+}
+
+uint16_t allowlist_short_id(const bd_addr *address) {
+  (void) address;
+  return 0;
+}
+
+void allowlist_take_stats(allowlist_stats_t *out) {
+  memset(out, 0, sizeof(*out));
+}
+
+void discovery_cache_record_latency(bool cached, uint32_t ms) {
+  (void) cached;
+  (void) ms;
+}
+
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   Returns the address of a helmet
+ * @param   helmet  index
+ * @return  its address
+ */
+static bd_addr helmet_address(uint32_t helmet) {
+  bd_addr a = {{ (uint8_t) (helmet + 1), 0x61, 0x17, 0x57, 0x0b, 0x00 }};
+
+  return a;
+}
+
+/**
+ * @brief   Returns the helmet of an address
+ * @param   a       address
+ * @return  its index
+ */
+static uint32_t helmet_of(const bd_addr *a) {
+  return a->addr[0] - 1u;
+}
+
+/**
+ * @brief   Returns whether an address is that of a helmet
+ * @param   a       address
+ * @param   helmet  index
+ * @return  true if it is
+ */
+static bool is_helmet(const bd_addr *a, uint32_t helmet) {
+  bd_addr b = helmet_address(helmet);
+
+  return memcmp(a, &b, sizeof(bd_addr)) == 0;
+}
+
+/**
+ * @brief   Delivers a scan report
+ * @param   helmet      index
+ * @param   packetType  0 -> connectable
+ * @param   data        advertising data
+ * @param   len         length of data
+ * @return  none
+ */
+static void report(uint32_t helmet, uint8_t packetType, const uint8_t *data, uint8_t len) {
+  sl_bt_evt_scanner_scan_report_t *r = (sl_bt_evt_scanner_scan_report_t *) reportBuf;
+
+  memset(reportBuf, 0, sizeof(reportBuf));
+  r->packet_type = packetType;
+  r->address = helmet_address(helmet);
+  r->data.len = len;
+  memcpy(&r->data.data[0], data, len);
+  gateway_scan_report(r);
+}
+
+/**
+ * @brief   A helmet advertises the Health Thermometer service
+ * @param   helmet  index
+ * @return  none
+ */
+static void advertise(uint32_t helmet) {
+  report(helmet, 0, adHtm, sizeof(adHtm));
+}
+
+/**
+ * @brief   The connection being opened completes
+ * @return  the helmet connected, HELMETS if none was being opened
+ */
+static uint32_t complete_open(void) {
+  if(attempt.active == false)
+    return HELMETS;
+
+  attempt.active = false;
+  CHECK(gateway_slot_opened(attempt.connection, &attempt.address) != NULL);
+  return helmet_of(&attempt.address);
+}
+
+/**
+ * @brief   Boots the gateway
+ * @return  none
+ */
+static void boot(void) {
+  memset(&attempt, 0, sizeof(attempt));
+  nextConnection = 1;
+  opens = 0;
+  closes = 0;
+  scanInterval = 0;
+  scanRestarts = 0;
+  gateway_init();
+}
+
+/**
+ * @brief   Lets time pass one scheduler tick at a time
+ * @param   seconds   ticks
+ * @return  none
+ */
+static void tick(uint32_t seconds) {
+  while(seconds-- > 0){
+    nowMs += 1000;
+    gateway_tick();
+  }
+}
+
+/**
+ * @brief   Connects helmets 0 to GATEWAY_MAX_SLOTS - 1, one second apart
+ * @return  none
+ */
+static void fill_slots(void) {
+  uint32_t i;
+
+  for(i = 0; i < GATEWAY_MAX_SLOTS; i++){
+    advertise(i);
+    CHECK_EQ(complete_open(), i);
+    tick(1);
+  }
+  CHECK_EQ(gateway_open_slots(), GATEWAY_MAX_SLOTS);
+}
+
+//------------------------------------------------------------------------------
+// Tests
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   Only connectable reports listing the Health Thermometer service
+ *          are taken up
+ */
+static void test_scan_filter(void) {
+  uint8_t truncated[sizeof(adHtm)];
+
+  boot();
+  report(0, 0, adOther, sizeof(adOther));
+  report(0, 2, adHtm, sizeof(adHtm));
+  memcpy(truncated, adHtm, sizeof(adHtm));
+  truncated[3] = 0x09;      // the list runs past the end of the data
+  report(0, 0, truncated, sizeof(truncated));
+  CHECK_EQ(opens, 0);
+
+  advertise(0);
+  CHECK_EQ(opens, 1);
+  CHECK(is_helmet(&attempt.address, 0));
+}
+
+/**
+ * @brief   One attempt at a time, the next starts when the last completes,
+ *          and the buttons act on the newest helmet
+ */
+static void test_one_attempt(void) {
+  boot();
+  advertise(0);
+  advertise(1);
+  advertise(0);
+  CHECK_EQ(opens, 1);
+
+  CHECK_EQ(complete_open(), 0);
+  CHECK_EQ(gateway_open_slots(), 1);
+
+  // The next attempt waits for the next report
+  CHECK_EQ(opens, 1);
+  nowMs += 100;
+  advertise(1);
+  CHECK_EQ(opens, 2);
+  CHECK_EQ(complete_open(), 1);
+  CHECK(is_helmet(&gateway_get_focus()->address, 1));
+
+  // A connected helmet is not connected again
+  advertise(0);
+  advertise(1);
+  CHECK_EQ(opens, 2);
+
+  gateway_slot_closed(gateway_get_focus()->connection);
+  CHECK_EQ(gateway_open_slots(), 1);
+  CHECK(is_helmet(&gateway_get_focus()->address, 0));
+  CHECK(gateway_get_slot(2) == NULL);
+}
+
+/**
+ * @brief   An attempt that does not complete is cancelled after
+ *          GATEWAY_CONNECT_TIMEOUT_MS, once, and the helmet is tried again
+ *          when the stack reports it closed
+ */
+static void test_connect_timeout(void) {
+  uint8_t first;
+
+  boot();
+  advertise(0);
+  first = attempt.connection;
+
+  tick(GATEWAY_CONNECT_TIMEOUT_MS / 1000);
+  CHECK_EQ(closes, 0);
+  tick(1);
+  CHECK_EQ(closes, 1);
+  CHECK_EQ(lastClosed, first);
+
+  // Reports do not start a second attempt, ticks do not close twice
+  advertise(1);
+  tick(GATEWAY_CONNECT_TIMEOUT_MS / 1000);
+  CHECK_EQ(opens, 1);
+  CHECK_EQ(closes, 1);
+
+  // The closed event frees the attempt, the next one starts at once
+  attempt.active = false;
+  gateway_slot_closed(first);
+  CHECK_EQ(opens, 2);
+  CHECK(attempt.connection != first);
+  CHECK_EQ(gateway_open_slots(), 0);
+}
+
+/**
+ * @brief   With every slot taken, the slot held longest is released after
+ *          GATEWAY_SLOT_DWELL_MS to the helmet that waited, one at a time
+ */
+static void test_rotation(void) {
+  uint32_t i;
+
+  boot();
+  fill_slots();
+
+  // Nobody waits, nobody is rotated out
+  tick(2 * GATEWAY_SLOT_DWELL_MS / 1000);
+  CHECK_EQ(closes, 0);
+
+  // Helmet 4 waits, the dwell of helmet 0 is long over
+  advertise(GATEWAY_MAX_SLOTS);
+  CHECK_EQ(opens, GATEWAY_MAX_SLOTS);
+  tick(1);
+  CHECK_EQ(closes, 1);
+  CHECK_EQ(lastClosed, 1);
+
+  // Nothing more closes until the stack reports it
+  for(i = 0; i < 5; i++){
+    advertise(GATEWAY_MAX_SLOTS);
+    tick(1);
+  }
+  CHECK_EQ(closes, 1);
+
+  gateway_slot_closed(1);
+  CHECK_EQ(complete_open(), GATEWAY_MAX_SLOTS);
+
+  // Helmet 0 now waits and gets the slot of helmet 1, the next oldest
+  advertise(0);
+  tick(1);
+  CHECK_EQ(closes, 2);
+  CHECK_EQ(lastClosed, 2);
+  gateway_slot_closed(2);
+  CHECK_EQ(complete_open(), 0);
+
+  // Helmet 4 keeps its new slot for the dwell, helmets 2 and 3 go first
+  for(i = 0; i < GATEWAY_SLOT_DWELL_MS / 1000; i++){
+    advertise(1);
+    tick(1);
+    if(closes > 2){
+      CHECK(gateway_get_slot(lastClosed) != NULL);
+      CHECK(is_helmet(&gateway_get_slot(lastClosed)->address, GATEWAY_MAX_SLOTS) == false);
+      gateway_slot_closed(lastClosed);
+      complete_open();
+      closes = 2;
+    }
+  }
+}
+
+/**
+ * @brief   A helmet not heard for GATEWAY_CANDIDATE_EXPIRY_MS does not take
+ *          a slot from a connected one
+ */
+static void test_expired_candidate(void) {
+  boot();
+  fill_slots();
+  advertise(GATEWAY_MAX_SLOTS);
+
+  tick(GATEWAY_CANDIDATE_EXPIRY_MS / 1000 + 1);
+  tick(GATEWAY_SLOT_DWELL_MS / 1000);
+  CHECK_EQ(closes, 0);
+
+  // Back in range
+  advertise(GATEWAY_MAX_SLOTS);
+  tick(1);
+  CHECK_EQ(closes, 1);
+}
+
+/**
+ * @brief   More helmets than slots share them in turn, each keeps its slot
+ *          for the dwell and none waits more than one round
+ */
+static void test_fair_share(void) {
+  uint32_t connectedAtMs[HELMETS];
+  uint32_t waitingSinceMs[HELMETS];
+  uint32_t served[HELMETS] = { 0 };
+  bool     connected[HELMETS] = { false };
+  uint32_t maxWaitMs = 0;
+  uint32_t rounds;
+  uint32_t i;
+  uint32_t h;
+
+  boot();
+  for(i = 0; i < HELMETS; i++)
+    waitingSinceMs[i] = (uint32_t) nowMs;
+
+  for(i = 0; i < 1800; i++){
+    // Helmets without a connection advertise
+    for(h = 0; h < HELMETS; h++){
+      if(connected[h] == false)
+        advertise(h);
+    }
+
+    h = complete_open();
+    if(h < HELMETS){
+      connected[h] = true;
+      connectedAtMs[h] = (uint32_t) nowMs;
+      served[h]++;
+      if((uint32_t) nowMs - waitingSinceMs[h] > maxWaitMs)
+        maxWaitMs = (uint32_t) nowMs - waitingSinceMs[h];
+    }
+
+    tick(1);
+
+    // The stack closes what the gateway rotated out
+    if(closes > 0){
+      h = helmet_of(&gateway_get_slot(lastClosed)->address);
+      CHECK(connected[h]);
+      CHECK((uint32_t) nowMs - connectedAtMs[h] >= GATEWAY_SLOT_DWELL_MS);
+      connected[h] = false;
+      waitingSinceMs[h] = (uint32_t) nowMs;
+      gateway_slot_closed(lastClosed);
+      closes = 0;
+    }
+  }
+
+  // A rotation every dwell, the helmets waiting are served in turn
+  rounds = (1800 * 1000) / GATEWAY_SLOT_DWELL_MS;
+  for(h = 0; h < HELMETS; h++)
+    CHECK(served[h] >= rounds / HELMETS);
+  CHECK(maxWaitMs <= (HELMETS - GATEWAY_MAX_SLOTS + 1) * (GATEWAY_SLOT_DWELL_MS + 2000));
+}
+
+/**
+ * @brief   The scan duty cycle drops when the slots are full and again when
+ *          no new helmet turns up, and comes back up when one does
+ */
+static void test_scan_duty(void) {
+  uint16_t arrival;
+  uint16_t busy;
+  uint16_t quiet;
+  uint32_t firstMs;
+  uint32_t againMs;
+
+  boot();
+  fill_slots();
+  busy = scanInterval;
+  CHECK(busy > 0);
+  CHECK_EQ(scanRestarts, 1);
+
+  tick(GATEWAY_QUIET_AFTER_MS / 1000);
+  quiet = scanInterval;
+  CHECK(quiet > busy);
+  CHECK_EQ(scanRestarts, 2);
+
+  // A helmet passes by, rotation asks for a slot but the stack has not
+  // closed it yet
+  firstMs = (uint32_t) nowMs;
+  advertise(GATEWAY_MAX_SLOTS);
+  tick(1);
+  CHECK_EQ(scanInterval, busy);
+  CHECK_EQ(closes, 1);
+
+  // It comes back after it was forgotten, which counts as an arrival
+  tick(GATEWAY_CANDIDATE_EXPIRY_MS / 1000 + 1);
+  againMs = (uint32_t) nowMs;
+  advertise(GATEWAY_MAX_SLOTS);
+  while(nowMs <= firstMs + GATEWAY_QUIET_AFTER_MS + 1000)
+    tick(1);
+  CHECK_EQ(scanInterval, busy);
+  while(nowMs <= againMs + GATEWAY_QUIET_AFTER_MS + 1000)
+    tick(1);
+  CHECK_EQ(scanInterval, quiet);
+  CHECK_EQ(scanRestarts, 4);
+
+  // A slot frees up
+  gateway_slot_closed(lastClosed);
+  tick(1);
+  arrival = scanInterval;
+  CHECK(arrival < busy);
+  CHECK_EQ(scanRestarts, 5);
+
+  // The profile is only set when it changes
+  tick(5);
+  CHECK_EQ(scanRestarts, 5);
+}
+
+int main(void) {
+
+  RUN(test_scan_filter);
+  RUN(test_one_attempt);
+  RUN(test_connect_timeout);
+  RUN(test_rotation);
+  RUN(test_expired_candidate);
+  RUN(test_fair_share);
+  RUN(test_scan_duty);
+
+  return TEST_RESULT();
+}
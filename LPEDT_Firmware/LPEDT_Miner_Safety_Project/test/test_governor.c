@@ -0,0 +1,267 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    test_governor.c
+ * @brief   Host test of the profile choice in governor.c
+ *
+ *          The battery is a set of values the tests change between two
+ *          calls of governor_update(), the modules a profile covers record
+ *          what was pushed into them.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include "test.h"
+#include "governor.h"
+#include "battery.h"
+#include "timers.h"
+#include "ble.h"
+#include "lcd.h"
+
+// The verbosity the governor sets
+#define INCLUDE_LOG_DEBUG 1
+#include "log.h"
+
+static uint16_t  batteryMv = 3800;
+static uint8_t   batterySoc = 50;
+static int32_t   trend = 0;
+static bool      vbatOk = true;
+
+static uint32_t  applied = 0;
+static uint32_t  samplePeriodMs = 0;
+static uint16_t  advInterval = 0;
+static uint16_t  beaconInterval = 0;
+static uint32_t  displayPeriodMs = 0xFFFFFFFF;
+
+//------------------------------------------------------------------------------
+// Stand-ins for the stack and the rest of the firmware
+//------------------------------------------------------------------------------
+
+uint16_t battery_mv(void) {
+  return batteryMv;
+}
+
+uint8_t battery_soc(void) {
+  return batterySoc;
+}
+
+int32_t battery_trend_mv_per_hour(void) {
+  return trend;
+}
+
+bool battery_vbat_ok(void) {
+  return vbatOk;
+}
+
+void LETIMER0_Set_Sample_Period(uint32_t period_ms) {
+  samplePeriodMs = period_ms;
+  applied++;
+}
+
+void ble_set_advertising_intervals(uint16_t adv, uint16_t beacon) {
+  advInterval = adv;
+  beaconInterval = beacon;
+}
+
+void displaySetRefreshPeriod(uint32_t period_ms) {
+  displayPeriodMs = period_ms;
+}
+
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   Sets the state of charge and runs the governor
+ * @param   soc     state of charge, %
+ * @return  profile in force after it
+ */
+static governor_profile_id_t at(uint8_t soc) {
+  batterySoc = soc;
+  governor_update();
+  return governor_profile_id();
+}
+
+/**
+ * @brief   Returns the profile the thresholds alone give a state of charge
+ * @param   soc     state of charge, %
+ * @return  profile ID
+ */
+static governor_profile_id_t threshold_profile(uint32_t soc) {
+  if(soc >= GOVERNOR_SOC_FULL)
+    return GOVERNOR_PROFILE_FULL;
+  if(soc >= GOVERNOR_SOC_ECO)
+    return GOVERNOR_PROFILE_ECO;
+  if(soc >= GOVERNOR_SOC_SAVER)
+    return GOVERNOR_PROFILE_SAVER;
+  return GOVERNOR_PROFILE_CRITICAL;
+}
+
+/**
+ * @brief   Checks that the modules run the profile in force
+ * @return  none
+ */
+static void check_pushed(void) {
+  const governor_profile_t *p = governor_profile();
+
+  CHECK_EQ(samplePeriodMs, p->samplePeriodMs);
+  CHECK_EQ(advInterval, p->advInterval);
+  CHECK_EQ(beaconInterval, p->beaconInterval);
+  CHECK_EQ(displayPeriodMs, p->displayPeriodMs);
+  CHECK_EQ(loggerGetVerbosity(), p->logLevel);
+}
+
+/**
+ * @brief   Boots on the full profile with a battery in the middle of ECO
+ * @return  none
+ */
+static void boot(void) {
+  batteryMv = 3800;
+  batterySoc = 50;
+  trend = 0;
+  vbatOk = true;
+  governor_init();
+  applied = 0;
+}
+
+//------------------------------------------------------------------------------
+// Tests
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   Each profile saves more than the one before it and is pushed as
+ *          a whole, nothing changes before the first measurement
+ */
+static void test_profiles(void) {
+  static const uint8_t      soc[] = { 80, 45, 20, 80 };
+  const governor_profile_t *p;
+  const governor_profile_t *richer = NULL;
+  uint32_t                  id;
+
+  boot();
+  CHECK_EQ(governor_profile_id(), GOVERNOR_PROFILE_FULL);
+  check_pushed();
+  CHECK_EQ(displayPeriodMs, 0);
+
+  batteryMv = 0;
+  batterySoc = 0;
+  governor_update();
+  CHECK_EQ(governor_profile_id(), GOVERNOR_PROFILE_FULL);
+  CHECK_EQ(applied, 0);
+
+  batteryMv = 3800;
+  for(id = GOVERNOR_PROFILE_FULL; id < GOVERNOR_NUMBER_OF_PROFILES; id++){
+    vbatOk = (id != GOVERNOR_PROFILE_CRITICAL);
+    at(soc[id]);
+    CHECK_EQ(governor_profile_id(), id);
+    check_pushed();
+
+    p = governor_profile();
+    CHECK_EQ(p->samplePeriodMs % LETIMER_PERIOD_MS, 0);
+    CHECK((p->temperatureBits >= 11) && (p->temperatureBits <= 14));
+    if(richer != NULL){
+      CHECK(p->samplePeriodMs > richer->samplePeriodMs);
+      CHECK(p->advInterval > richer->advInterval);
+      CHECK(p->beaconInterval > richer->beaconInterval);
+      CHECK(p->displayPeriodMs > richer->displayPeriodMs);
+      CHECK(p->logLevel <= richer->logLevel);
+      CHECK(p->temperatureBits < richer->temperatureBits);
+    }
+    richer = p;
+  }
+}
+
+/**
+ * @brief   Savings are taken at the threshold, a richer profile only
+ *          GOVERNOR_SOC_HYST above it
+ */
+static void test_hysteresis(void) {
+  int32_t  soc;
+  uint32_t i;
+
+  boot();
+  for(soc = 100; soc >= 0; soc--)
+    CHECK_EQ(at((uint8_t) soc), threshold_profile((uint32_t) soc));
+  CHECK_EQ(applied, 3);
+
+  for(soc = 0; soc <= 100; soc++){
+    if(soc < GOVERNOR_SOC_SAVER + GOVERNOR_SOC_HYST)
+      CHECK_EQ(at((uint8_t) soc), GOVERNOR_PROFILE_CRITICAL);
+    else if(soc < GOVERNOR_SOC_ECO + GOVERNOR_SOC_HYST)
+      CHECK_EQ(at((uint8_t) soc), GOVERNOR_PROFILE_SAVER);
+    else if(soc < GOVERNOR_SOC_FULL + GOVERNOR_SOC_HYST)
+      CHECK_EQ(at((uint8_t) soc), GOVERNOR_PROFILE_ECO);
+    else
+      CHECK_EQ(at((uint8_t) soc), GOVERNOR_PROFILE_FULL);
+  }
+  CHECK_EQ(applied, 6);
+
+  // A state of charge wandering around a threshold changes it once
+  for(i = 0; i < 20; i++)
+    at((uint8_t) (GOVERNOR_SOC_FULL - 1 + (i % (GOVERNOR_SOC_HYST + 1))));
+  CHECK_EQ(governor_profile_id(), GOVERNOR_PROFILE_ECO);
+  CHECK_EQ(applied, 7);
+  check_pushed();
+}
+
+/**
+ * @brief   A charging battery gets one profile richer than its state of
+ *          charge, never beyond full, and loses it when the harvest stops
+ */
+static void test_harvest(void) {
+  boot();
+  CHECK_EQ(at(45), GOVERNOR_PROFILE_ECO);
+
+  trend = GOVERNOR_HARVEST_MV_PER_HOUR - 1;
+  CHECK_EQ(at(45), GOVERNOR_PROFILE_ECO);
+  trend = GOVERNOR_HARVEST_MV_PER_HOUR;
+  CHECK_EQ(at(45), GOVERNOR_PROFILE_FULL);
+  CHECK_EQ(at(90), GOVERNOR_PROFILE_FULL);
+  CHECK_EQ(at(10), GOVERNOR_PROFILE_SAVER);
+
+  // The hysteresis still holds while harvesting
+  CHECK_EQ(at(GOVERNOR_SOC_SAVER + GOVERNOR_SOC_HYST - 1), GOVERNOR_PROFILE_SAVER);
+  CHECK_EQ(at(GOVERNOR_SOC_SAVER + GOVERNOR_SOC_HYST), GOVERNOR_PROFILE_ECO);
+
+  trend = -40;
+  CHECK_EQ(at(GOVERNOR_SOC_SAVER + GOVERNOR_SOC_HYST), GOVERNOR_PROFILE_SAVER);
+  check_pushed();
+}
+
+/**
+ * @brief   A low VBAT_OK forces the critical profile at any state of charge,
+ *          the profile comes back at once when it goes high
+ */
+static void test_vbat_ok(void) {
+  boot();
+  CHECK_EQ(at(90), GOVERNOR_PROFILE_FULL);
+
+  vbatOk = false;
+  trend = GOVERNOR_HARVEST_MV_PER_HOUR;
+  CHECK_EQ(at(90), GOVERNOR_PROFILE_CRITICAL);
+  check_pushed();
+  CHECK_EQ(at(95), GOVERNOR_PROFILE_CRITICAL);
+
+  vbatOk = true;
+  CHECK_EQ(at(95), GOVERNOR_PROFILE_FULL);
+  check_pushed();
+}
+
+int main(void) {
+
+  RUN(test_profiles);
+  RUN(test_hysteresis);
+  RUN(test_harvest);
+  RUN(test_vbat_ok);
+
+  return TEST_RESULT();
+}
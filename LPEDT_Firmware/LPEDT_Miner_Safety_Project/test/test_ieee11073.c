@@ -0,0 +1,349 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    test_ieee11073.c
+ * @brief   Host round trip tests and cycle benchmark of ieee11073.c
+ *
+ *          Every one of the 65536 SFLOAT values is decoded at every exponent
+ *          of the type and checked against exact integer arithmetic, and
+ *          every finite one encodes back to itself. FLOAT is too wide for
+ *          that, a fixed pseudo random sample of 2^22 values gets the same
+ *          checks and random mantissas check the rounding of the encoder.
+ *
+ *          "test_ieee11073 bench" times the codec against the double
+ *          precision code it replaced, FLOAT_TO_INT32() of ble.c and the
+ *          INT32_TO_FLOAT() of the HTM measurement.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "test.h"
+#include "ieee11073.h"
+
+#define FLOAT_SAMPLES          (1u << 22)
+#define ENCODE_SAMPLES         (1u << 20)
+#define BENCH_CALLS            (10000000)
+
+static uint32_t rng = 88172645u;
+
+/**
+ * @brief   Returns the next pseudo random number, the same sequence every run
+ * @return  32 random bits
+ */
+static uint32_t next_random(void) {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+/**
+ * @brief   Exact mantissa * 10^shift, digits below the unit dropped toward 0
+ * @param   mantissa  value
+ * @param   shift     decimal shift
+ * @param   value     written with the result, the int32_t limit on overflow
+ * @return  IEEE11073_OK or IEEE11073_OVERFLOW
+ */
+static ieee11073_status_t reference_scale(int32_t mantissa, int32_t shift, int32_t *value) {
+  __int128 v = mantissa;
+
+  for(; (shift > 0) && (v != 0); shift--){
+    v *= 10;
+    if((v > INT32_MAX) || (v < INT32_MIN)){
+      *value = (mantissa < 0) ? INT32_MIN : INT32_MAX;
+      return IEEE11073_OVERFLOW;
+    }
+  }
+  for(; (shift < 0) && (v != 0); shift++)
+    v /= 10;
+
+  *value = (int32_t) v;
+  return IEEE11073_OK;
+}
+
+/**
+ * @brief   Checks one raw value of either type against the reference
+ * @param   raw           bits of the type
+ * @param   mantissaBits  12 for SFLOAT, 24 for FLOAT
+ * @param   exponent      exponent of the result unit
+ * @return  true if it matched
+ */
+static bool check_decode(uint32_t raw, uint32_t mantissaBits, int32_t exponent) {
+  uint32_t           mask = (1UL << mantissaBits) - 1;
+  uint32_t           field = raw & mask;
+  uint32_t           top = 1UL << (mantissaBits - 1);
+  int32_t            expected;
+  int32_t            value;
+  int32_t            rawMantissa;
+  int32_t            rawExponent;
+  ieee11073_status_t status;
+  ieee11073_status_t expectedStatus;
+
+  if(mantissaBits == 12)
+    status = ieee11073_sfloat_decode((uint16_t) raw, (int8_t) exponent, &value);
+  else
+    status = ieee11073_float_decode(raw, (int8_t) exponent, &value);
+
+  // The specials sit at the edges of the field, whatever the exponent
+  if(field == top - 1)
+    return (status == IEEE11073_NAN) && (value == 0);
+  if(field == top)
+    return (status == IEEE11073_NRES) && (value == 0);
+  if(field == top + 1)
+    return (status == IEEE11073_RESERVED) && (value == 0);
+  if(field == top - 2)
+    return (status == IEEE11073_POS_INF) && (value == INT32_MAX);
+  if(field == top + 2)
+    return (status == IEEE11073_NEG_INF) && (value == INT32_MIN);
+
+  rawMantissa = (int32_t) ((field ^ top) - top);
+  rawExponent = (int8_t) (raw >> mantissaBits);
+  if(mantissaBits == 12)
+    rawExponent = (int32_t) (((raw >> 12) & 0xF) ^ 0x8) - 0x8;
+
+  expectedStatus = reference_scale(rawMantissa, rawExponent - exponent, &expected);
+  if((status != expectedStatus) || (value != expected)){
+    printf("raw 0x%08x at 10^%d: status %d value %d, expected %d %d\n",
+           (unsigned int) raw, (int) exponent, (int) status, (int) value,
+           (int) expectedStatus, (int) expected);
+    return false;
+  }
+
+  // Every finite value encodes back to its own bits
+  if(mantissaBits == 12)
+    return ieee11073_sfloat_encode(rawMantissa, (int8_t) rawExponent) == raw;
+  return ieee11073_float_encode(rawMantissa, (int8_t) rawExponent) == raw;
+}
+
+//------------------------------------------------------------------------------
+// Tests
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   All SFLOAT values at all exponents of the type
+ */
+static void test_sfloat_exhaustive(void) {
+  uint32_t raw;
+  int32_t  exponent;
+  uint32_t bad = 0;
+
+  for(raw = 0; raw <= 0xFFFF; raw++){
+    for(exponent = IEEE11073_SFLOAT_EXPONENT_MIN; exponent <= IEEE11073_SFLOAT_EXPONENT_MAX; exponent++){
+      if(!check_decode(raw, 12, exponent) && (++bad < 10))
+        printf("sfloat 0x%04x at 10^%d\n", (unsigned int) raw, (int) exponent);
+    }
+  }
+  CHECK_EQ(bad, 0);
+}
+
+/**
+ * @brief   A sample of FLOAT values, whole units and the HTM milli-degrees
+ */
+static void test_float_sampled(void) {
+  uint32_t i;
+  uint32_t raw;
+  uint32_t bad = 0;
+
+  for(i = 0; i < FLOAT_SAMPLES; i++){
+    raw = next_random();
+    if(!check_decode(raw, 24, 0) && (++bad < 10))
+      printf("float 0x%08x at 10^0\n", (unsigned int) raw);
+    if(!check_decode(raw, 24, -3) && (++bad < 10))
+      printf("float 0x%08x at 10^-3\n", (unsigned int) raw);
+  }
+  CHECK_EQ(bad, 0);
+}
+
+/**
+ * @brief   Rounds to the fewest digits dropped, half away from zero
+ */
+static void test_encode_rounding(void) {
+  uint32_t i;
+  int32_t  mantissa;
+  int32_t  exponent;
+  int64_t  magnitude;
+  int64_t  fieldMagnitude;
+  int32_t  value;
+  int32_t  k;
+  int32_t  fieldMantissa;
+  uint32_t raw;
+  int64_t  unit;
+  uint32_t bad = 0;
+
+  for(i = 0; i < ENCODE_SAMPLES; i++){
+    mantissa = (int32_t) next_random();
+    exponent = (int32_t) (next_random() % 201) - 100;
+    magnitude = llabs((int64_t) mantissa);
+
+    raw = ieee11073_float_encode(mantissa, (int8_t) exponent);
+    fieldMantissa = (int32_t) ((raw & 0x00FFFFFFUL) ^ 0x00800000UL) - 0x00800000L;
+    k = (int8_t) (raw >> 24) - exponent;
+    unit = (int64_t) pow(10, k);
+    fieldMagnitude = llabs((int64_t) fieldMantissa);
+
+    // In the field, on the nearest multiple of the unit, with no digit
+    // dropped that could have stayed
+    if((fieldMagnitude > IEEE11073_FLOAT_MANTISSA_MAX) ||
+       ((fieldMantissa < 0) != (mantissa < 0) && (fieldMantissa != 0)) ||
+       (llabs(fieldMagnitude * unit - magnitude) * 2 > unit) ||
+       (llabs(fieldMagnitude * unit - magnitude) * 2 == unit && fieldMagnitude * unit < magnitude) ||
+       ((k > 0) && ((2 * magnitude + unit / 10) / (2 * (unit / 10)) <= IEEE11073_FLOAT_MANTISSA_MAX))){
+      if(++bad < 10)
+        printf("encode %d x 10^%d -> 0x%08x\n", (int) mantissa, (int) exponent, (unsigned int) raw);
+    }
+  }
+  CHECK_EQ(bad, 0);
+
+  // Values from the HTM measurement and its limits
+  CHECK_EQ(ieee11073_float_encode(36500, -3), 0xFD008E94UL);
+  CHECK(ieee11073_float_decode(ieee11073_float_encode(36500, -3), 0, &value) == IEEE11073_OK);
+  CHECK_EQ(value, 36);
+  CHECK_EQ(ieee11073_float_encode(-40250, -3), 0xFDFF62C6UL);
+  CHECK_EQ(ieee11073_sfloat_encode(20455, 0), 0x2000 | 205);
+  CHECK_EQ(ieee11073_sfloat_encode(2045, 8), IEEE11073_SFLOAT_POS_INF);
+  CHECK_EQ(ieee11073_sfloat_encode(-2045, 8), IEEE11073_SFLOAT_NEG_INF);
+  CHECK_EQ(ieee11073_sfloat_encode(100, 7), 0x7000 | 100);
+  CHECK_EQ(ieee11073_sfloat_encode(100, 8), 0x7000 | 1000);
+  CHECK_EQ(ieee11073_sfloat_encode(1, -20), 0x8000);
+  CHECK_EQ(ieee11073_float_encode(INT32_MIN, 0), 0x03DF3B64UL);
+}
+
+//------------------------------------------------------------------------------
+// Benchmark
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   FLOAT_TO_INT32() of ble.c before ieee11073.c, on the HTM payload
+ * @param   buffer_ptr  flags byte, then the FLOAT
+ * @return  whole units
+ */
+static int32_t legacy_float_to_int32(const uint8_t *buffer_ptr) {
+  uint8_t signByte = 0;
+  int32_t mantissa;
+  int8_t  exponent = (int8_t) buffer_ptr[4];
+
+  if(buffer_ptr[3] & 0x80)
+    signByte = 0xFF;
+  mantissa = (int32_t) (buffer_ptr[1] << 0) |
+                       (buffer_ptr[2] << 8) |
+                       (buffer_ptr[3] << 16) |
+                       (signByte << 24);
+
+  return (int32_t) (pow(10, exponent) * mantissa);
+}
+
+// INT32_TO_FLOAT() of ble.h before ieee11073.c
+#define LEGACY_INT32_TO_FLOAT(m, e)  ( (int32_t) (((uint32_t) m) & 0x00FFFFFFU) | (((uint32_t) e) << 24) )
+
+/**
+ * @brief   Returns a cycle count where the host has one, 0 otherwise
+ * @return  cycles
+ */
+static inline uint64_t cycles_now(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  return __builtin_ia32_rdtsc();
+#else
+  return 0;
+#endif
+}
+
+/**
+ * @brief   Prints the time of one call of a loop of BENCH_CALLS
+ * @param   name    what was timed
+ * @param   ns      loop time
+ * @param   cycles  loop cycles, 0 if unknown
+ * @return  none
+ */
+static void report(const char *name, uint64_t ns, uint64_t cycles) {
+  printf("  %-28s %6.2f ns", name, (double) ns / BENCH_CALLS);
+  if(cycles != 0)
+    printf("  %6.1f cycles", (double) cycles / BENCH_CALLS);
+  printf("\n");
+}
+
+/**
+ * @brief   Decode and encode of HTM temperatures, both codecs
+ * @return  none
+ */
+static void bench_codec(void) {
+  static uint8_t    payloads[256][5];
+  volatile int32_t  sink = 0;
+  volatile double   reading;
+  int32_t           value;
+  uint64_t          t;
+  uint64_t          c;
+  uint32_t          i;
+  uint32_t          raw;
+
+  // Plausible helmet temperatures, -40 C to 85 C in milli-degrees
+  for(i = 0; i < 256; i++){
+    raw = ieee11073_float_encode((int32_t) (next_random() % 125000) - 40000, -3);
+    payloads[i][0] = 0;
+    payloads[i][1] = (uint8_t) raw;
+    payloads[i][2] = (uint8_t) (raw >> 8);
+    payloads[i][3] = (uint8_t) (raw >> 16);
+    payloads[i][4] = (uint8_t) (raw >> 24);
+    CHECK(ieee11073_float_decode(raw, 0, &value) == IEEE11073_OK);
+    CHECK_EQ(value, legacy_float_to_int32(payloads[i]));
+  }
+
+  printf("HTM temperature, per call:\n");
+
+  t = test_now_ns(); c = cycles_now();
+  for(i = 0; i < BENCH_CALLS; i++)
+    sink += legacy_float_to_int32(payloads[i & 255]);
+  c = cycles_now() - c; t = test_now_ns() - t;
+  report("decode, pow() in double", t, c);
+
+  t = test_now_ns(); c = cycles_now();
+  for(i = 0; i < BENCH_CALLS; i++){
+    const uint8_t *p = payloads[i & 255];
+    ieee11073_float_decode((uint32_t) p[1] | ((uint32_t) p[2] << 8) |
+                           ((uint32_t) p[3] << 16) | ((uint32_t) p[4] << 24), 0, &value);
+    sink += value;
+  }
+  c = cycles_now() - c; t = test_now_ns() - t;
+  report("decode, ieee11073", t, c);
+
+  reading = 36.512;
+  t = test_now_ns(); c = cycles_now();
+  for(i = 0; i < BENCH_CALLS; i++)
+    sink += LEGACY_INT32_TO_FLOAT(reading * 1000, -3);
+  c = cycles_now() - c; t = test_now_ns() - t;
+  report("encode, double to INT32", t, c);
+
+  t = test_now_ns(); c = cycles_now();
+  for(i = 0; i < BENCH_CALLS; i++)
+    sink += (int32_t) ieee11073_float_encode((int32_t) (36512 + (i & 255)), -3);
+  c = cycles_now() - c; t = test_now_ns() - t;
+  report("encode, ieee11073", t, c);
+
+  (void) sink;
+}
+
+int main(int argc, char *argv[]) {
+  if((argc > 1) && (strcmp(argv[1], "bench") == 0)){
+    bench_codec();
+    return TEST_RESULT();
+  }
+
+  RUN(test_sfloat_exhaustive);
+  RUN(test_float_sampled);
+  RUN(test_encode_rounding);
+
+  return TEST_RESULT();
+}
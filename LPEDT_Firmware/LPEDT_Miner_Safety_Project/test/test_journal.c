@@ -0,0 +1,953 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    test_journal.c
+ * @brief   Host test of journal.c on a simulated flash
+ *
+ *          The journal region is mapped at JOURNAL_BASE, so journal.c runs
+ *          unchanged. The simulated flash behaves like the EFR32 MSC: an
+ *          erase sets a page to ones and a write can only clear bits. A power
+ *          cut is simulated by letting only a given number of words through,
+ *          followed by a reboot, journal_init(). The stream is a stand-in
+ *          that decodes every batch and acknowledges on request. seal.c
+ *          runs too, on a user data page and DEVINFO mapped at their
+ *          addresses and a software AES-CCM in place of the CRYPTO driver.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include <string.h>
+#include <sys/mman.h>
+
+#include "test.h"
+#include "em_device.h"
+#include "em_msc.h"
+#include "btl_interface.h"
+#include "sl_sleeptimer.h"
+#include "sl_bt_api.h"
+#include "journal.h"
+#include "tscodec.h"
+#include "seal.h"
+#include "stream.h"
+#include "ble.h"
+#include "fwupdate.h"
+#include "psa/crypto.h"
+#include "sli_crypto_transparent_functions.h"
+
+#define REGION_SIZE            (JOURNAL_PAGES * FLASH_PAGE_SIZE)
+#define PAGE_HEADER_SIZE       (8)
+#define RECORDS_PER_PAGE       ((FLASH_PAGE_SIZE - PAGE_HEADER_SIZE - SEAL_SIZE) / JOURNAL_RECORD_SIZE)
+#define MAX_RECEIVED           (JOURNAL_PAGES * RECORDS_PER_PAGE * 2)
+
+// User data page and DEVINFO, one mapping
+#define INFO_SIZE              (0x9000)
+
+typedef struct {
+  uint8_t  sensor;
+  uint32_t ms;
+  int16_t  value;
+} sample_t;
+
+static uint8_t           *flash;
+static int32_t            writeBudget = -1;   // words the flash takes before the power cut, -1 no limit
+static uint64_t           nowMs = 1000;
+static ble_data_struct_t  ble_data;
+
+static uint32_t           savedCursor;
+static bool               cursorSaved = false;
+
+static bool               streamActive = false;
+static uint32_t           inFlight = 0;
+static uint32_t           streamWindow = 8;
+static sample_t           received[MAX_RECEIVED];
+static uint32_t           receivedCount = 0;
+static int32_t            lastBoot = -1;
+
+static uint8_t            *info;
+static const uint8_t      sealKey[SEAL_KEY_SIZE] = {
+  0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C
+};
+static uint8_t            sbox[256];
+
+//------------------------------------------------------------------------------
+// Simulated flash and the rest of the firmware
+//------------------------------------------------------------------------------
+
+void MSC_Init(void) {
+}
+
+MSC_Status_TypeDef MSC_ErasePage(uint32_t *startAddress) {
+  uint8_t *p = (uint8_t *) startAddress;
+
+  CHECK((p >= flash) && (p + FLASH_PAGE_SIZE <= flash + REGION_SIZE));
+  CHECK((((uintptr_t) p) % FLASH_PAGE_SIZE) == 0);
+  if(writeBudget == 0)
+    return mscReturnTimeOut;
+
+  memset(p, 0xFF, FLASH_PAGE_SIZE);
+  return mscReturnOk;
+}
+
+MSC_Status_TypeDef MSC_WriteWord(uint32_t *address, void const *data, uint32_t numBytes) {
+  const uint32_t *words = data;
+  uint32_t        i;
+
+  CHECK(((uint8_t *) address >= flash) && ((uint8_t *) address + numBytes <= flash + REGION_SIZE));
+  CHECK((numBytes % 4) == 0);
+
+  for(i = 0; i < numBytes / 4; i++){
+    if(writeBudget == 0)
+      return mscReturnTimeOut;
+    if(writeBudget > 0)
+      writeBudget--;
+
+    // A flash write only clears bits
+    address[i] &= words[i];
+  }
+
+  return mscReturnOk;
+}
+
+int32_t bootloader_init(void) {
+  return BOOTLOADER_OK;
+}
+
+int32_t bootloader_getStorageSlotInfo(uint32_t slotId, BootloaderStorageSlot_t *slot) {
+  (void) slotId;
+  slot->address = JOURNAL_BASE + REGION_SIZE;
+  slot->length = 0x3C000;
+  return BOOTLOADER_OK;
+}
+
+uint64_t sl_sleeptimer_get_tick_count64(void) {
+  return nowMs;
+}
+
+sl_status_t sl_sleeptimer_tick64_to_ms(uint64_t tick, uint64_t *ms) {
+  *ms = tick;
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_nvm_save(uint16_t key, size_t value_len, const uint8_t* value) {
+  CHECK_EQ(key, JOURNAL_CURSOR_KEY);
+  CHECK_EQ(value_len, sizeof(savedCursor));
+  memcpy(&savedCursor, value, sizeof(savedCursor));
+  cursorSaved = true;
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_nvm_load(uint16_t key, size_t max_value_size, size_t *value_len, uint8_t *value) {
+  CHECK_EQ(key, JOURNAL_CURSOR_KEY);
+  if((cursorSaved == false) || (max_value_size < sizeof(savedCursor)))
+    return SL_STATUS_NOT_FOUND;
+  memcpy(value, &savedCursor, sizeof(savedCursor));
+  *value_len = sizeof(savedCursor);
+  return SL_STATUS_OK;
+}
+
+ble_data_struct_t* get_ble_data_ptr() {
+  return &ble_data;
+}
+
+uint32_t fwupdate_crc32_update(uint32_t crc, const uint8_t *data, uint32_t len) {
+  uint32_t i;
+  uint32_t bit;
+
+  for(i = 0; i < len; i++){
+    crc ^= data[i];
+    for(bit = 0; bit < 8; bit++)
+      crc = (crc >> 1) ^ (0xEDB88320UL & -(crc & 1));
+  }
+  return crc;
+}
+
+/**
+ * @brief   Multiplies by x in GF(2^8)
+ */
+static uint8_t xtime(uint8_t b) {
+  return (uint8_t) ((b << 1) ^ ((b & 0x80) ? 0x1B : 0));
+}
+
+/**
+ * @brief   Builds the AES S-box, the multiplicative inverse followed by
+ *          the affine transform
+ * @return  none
+ */
+static void aes_init(void) {
+  uint8_t p = 1;
+  uint8_t q = 1;
+  uint8_t x;
+
+  do {
+    // p runs through every non-zero element, q through their inverses
+    p = p ^ (uint8_t) (p << 1) ^ ((p & 0x80) ? 0x1B : 0);
+    q ^= q << 1;
+    q ^= q << 2;
+    q ^= q << 4;
+    q ^= (q & 0x80) ? 0x09 : 0;
+    x = q ^ (uint8_t) ((q << 1) | (q >> 7)) ^ (uint8_t) ((q << 2) | (q >> 6)) ^
+        (uint8_t) ((q << 3) | (q >> 5)) ^ (uint8_t) ((q << 4) | (q >> 4));
+    sbox[p] = x ^ 0x63;
+  } while(p != 1);
+  sbox[0] = 0x63;
+}
+
+/**
+ * @brief   FIPS-197 AES-128 encryption of one block
+ * @param   key     16 bytes
+ * @param   in      16 bytes
+ * @param   out     written with 16 bytes
+ * @return  none
+ */
+static void aes128_encrypt(const uint8_t *key, const uint8_t *in, uint8_t *out) {
+  uint8_t  w[176];
+  uint8_t  s[16];
+  uint8_t  t[16];
+  uint8_t  rcon = 1;
+  uint32_t i;
+  uint32_t c;
+  uint32_t round;
+
+  memcpy(w, key, 16);
+  for(i = 16; i < sizeof(w); i += 4){
+    memcpy(t, &w[i - 4], 4);
+    if((i % 16) == 0){
+      c = t[0];
+      t[0] = sbox[t[1]] ^ rcon;
+      t[1] = sbox[t[2]];
+      t[2] = sbox[t[3]];
+      t[3] = sbox[c];
+      rcon = xtime(rcon);
+    }
+    for(c = 0; c < 4; c++)
+      w[i + c] = w[i + c - 16] ^ t[c];
+  }
+
+  for(i = 0; i < 16; i++)
+    s[i] = in[i] ^ w[i];
+
+  for(round = 1; round <= 10; round++){
+    // SubBytes and ShiftRows, column major state
+    for(i = 0; i < 16; i++)
+      t[i] = sbox[s[(i + 4 * (i % 4)) % 16]];
+
+    // MixColumns, all but the last round
+    for(c = 0; (round != 10) && (c < 16); c += 4){
+      uint8_t a = t[c] ^ t[c + 1] ^ t[c + 2] ^ t[c + 3];
+      uint8_t t0 = t[c];
+
+      t[c]     ^= a ^ xtime(t[c] ^ t[c + 1]);
+      t[c + 1] ^= a ^ xtime(t[c + 1] ^ t[c + 2]);
+      t[c + 2] ^= a ^ xtime(t[c + 2] ^ t[c + 3]);
+      t[c + 3] ^= a ^ xtime(t[c + 3] ^ t0);
+    }
+
+    for(i = 0; i < 16; i++)
+      s[i] = t[i] ^ w[16 * round + i];
+  }
+
+  memcpy(out, s, 16);
+}
+
+/**
+ * @brief   NIST SP 800-38C CCM over additional data and a payload
+ * @param   key     16 bytes
+ * @param   nonce   7 to 13 bytes
+ * @param   aad     additional data, fewer than 0xFF00 bytes
+ * @param   out     written with the encrypted payload, then the tag
+ * @return  none
+ */
+static void ccm(const uint8_t *key, const uint8_t *nonce, uint32_t nonceLen,
+                const uint8_t *aad, uint32_t aadLen, const uint8_t *payload, uint32_t payloadLen,
+                uint8_t *out, uint32_t tagLen) {
+  uint8_t  b[16];
+  uint8_t  x[16];
+  uint8_t  ctr[16];
+  uint8_t  ks[16];
+  uint32_t q = 15 - nonceLen;
+  uint32_t i;
+  uint32_t j;
+
+  memset(b, 0, sizeof(b));
+  b[0] = (uint8_t) (((aadLen != 0) ? 0x40 : 0) | (((tagLen - 2) / 2) << 3) | (q - 1));
+  memcpy(&b[1], nonce, nonceLen);
+  for(i = 0; (i < q) && (i < 4); i++)
+    b[15 - i] = (uint8_t) (payloadLen >> (8 * i));
+  aes128_encrypt(key, b, x);
+
+  // Additional data behind its 2 byte length, then the payload, each zero
+  // padded to a block
+  if(aadLen != 0){
+    memset(b, 0, sizeof(b));
+    b[0] = (uint8_t) (aadLen >> 8);
+    b[1] = (uint8_t) aadLen;
+    j = 2;
+    for(i = 0; i < aadLen; i++){
+      b[j++] = aad[i];
+      if((j == 16) || (i == aadLen - 1)){
+        for(j = 0; j < 16; j++)
+          x[j] ^= b[j];
+        aes128_encrypt(key, x, x);
+        memset(b, 0, sizeof(b));
+        j = 0;
+      }
+    }
+  }
+  for(i = 0; i < payloadLen; i += 16){
+    for(j = 0; (j < 16) && (i + j < payloadLen); j++)
+      x[j] ^= payload[i + j];
+    aes128_encrypt(key, x, x);
+  }
+
+  // Counter blocks, A0 for the tag, A1 on for the payload
+  memset(ctr, 0, sizeof(ctr));
+  ctr[0] = (uint8_t) (q - 1);
+  memcpy(&ctr[1], nonce, nonceLen);
+  for(i = 0; i < payloadLen; i += 16){
+    ctr[15] = (uint8_t) (1 + i / 16);
+    aes128_encrypt(key, ctr, ks);
+    for(j = 0; (j < 16) && (i + j < payloadLen); j++)
+      out[i + j] = payload[i + j] ^ ks[j];
+  }
+  ctr[15] = 0;
+  aes128_encrypt(key, ctr, ks);
+  for(j = 0; j < tagLen; j++)
+    out[payloadLen + j] = x[j] ^ ks[j];
+}
+
+psa_status_t sli_crypto_transparent_cipher_encrypt(const psa_key_attributes_t *attributes,
+                                                   const uint8_t *key_buffer,
+                                                   size_t key_buffer_size,
+                                                   psa_algorithm_t alg,
+                                                   const uint8_t *input,
+                                                   size_t input_length,
+                                                   uint8_t *output,
+                                                   size_t output_size,
+                                                   size_t *output_length) {
+  CHECK_EQ(attributes->type, PSA_KEY_TYPE_AES);
+  CHECK_EQ(key_buffer_size, 16);
+  CHECK_EQ(alg, PSA_ALG_ECB_NO_PADDING);
+  CHECK((input_length == 16) && (output_size >= 16));
+  aes128_encrypt(key_buffer, input, output);
+  *output_length = 16;
+  return PSA_SUCCESS;
+}
+
+psa_status_t sli_crypto_transparent_aead_encrypt(const psa_key_attributes_t *attributes,
+                                                 const uint8_t *key_buffer,
+                                                 size_t key_buffer_size,
+                                                 psa_algorithm_t alg,
+                                                 const uint8_t *nonce,
+                                                 size_t nonce_length,
+                                                 const uint8_t *additional_data,
+                                                 size_t additional_data_length,
+                                                 const uint8_t *plaintext,
+                                                 size_t plaintext_length,
+                                                 uint8_t *ciphertext,
+                                                 size_t ciphertext_size,
+                                                 size_t *ciphertext_length) {
+  CHECK_EQ(attributes->type, PSA_KEY_TYPE_AES);
+  CHECK_EQ(attributes->bits, 128);
+  CHECK_EQ(key_buffer_size, 16);
+  CHECK_EQ(alg, PSA_ALG_CCM);
+  if(ciphertext_size < plaintext_length + SEAL_TAG_SIZE)
+    return PSA_ERROR_INVALID_ARGUMENT;
+  ccm(key_buffer, nonce, (uint32_t) nonce_length, additional_data, (uint32_t) additional_data_length,
+      plaintext, (uint32_t) plaintext_length, ciphertext, SEAL_TAG_SIZE);
+  *ciphertext_length = plaintext_length + SEAL_TAG_SIZE;
+  return PSA_SUCCESS;
+}
+
+bool stream_is_active(void) {
+  return streamActive;
+}
+
+uint32_t stream_free_slots(void) {
+  return streamWindow - inFlight;
+}
+
+bool stream_all_acked(void) {
+  return inFlight == 0;
+}
+
+/**
+ * @brief   Decodes a varint zigzag field of a tscodec block
+ * @param   p       read position, moved past the field
+ * @return  value
+ */
+static int32_t get_zigzag(const uint8_t **p) {
+  uint32_t v = 0;
+  uint32_t shift = 0;
+  uint8_t  b;
+
+  do {
+    b = *(*p)++;
+    v |= (uint32_t) (b & 0x7F) << shift;
+    shift += 7;
+  } while(b & 0x80);
+
+  return (int32_t) (v >> 1) ^ -(int32_t) (v & 1);
+}
+
+/**
+ * @brief   Takes a journal batch off the stream, decoded as in tscodec.h
+ */
+bool stream_write(const uint8_t *data, uint32_t len) {
+  tscodec_sensor_state_t state[TSCODEC_SENSOR_SLOTS];
+  const uint8_t *p = &data[1 + TSCODEC_HEADER_SIZE];
+  uint32_t       n = data[1];
+  uint32_t       base;
+  uint32_t       i;
+  uint8_t        tag;
+  tscodec_sensor_state_t *s;
+
+  if(inFlight == streamWindow)
+    return true;
+  inFlight++;
+
+  CHECK(len <= (uint32_t) (ble_data.attPayloadSize - STREAM_HEADER_SIZE));
+  lastBoot = data[0];
+  base = (uint32_t) data[2] | ((uint32_t) data[3] << 8) | ((uint32_t) data[4] << 16) | ((uint32_t) data[5] << 24);
+  for(i = 0; i < TSCODEC_SENSOR_SLOTS; i++){
+    state[i].lastMs = base;
+    state[i].lastIntervalMs = 0;
+    state[i].lastValue = 0;
+  }
+
+  for(i = 0; i < n; i++){
+    tag = *p++;
+    s = &state[(tag & TSCODEC_SENSOR_MASK) % TSCODEC_SENSOR_SLOTS];
+    if((tag & TSCODEC_TAG_SAME_INTERVAL) == 0)
+      s->lastIntervalMs += get_zigzag(&p);
+    s->lastMs += (uint32_t) s->lastIntervalMs;
+    if((tag & TSCODEC_TAG_SAME_VALUE) == 0)
+      s->lastValue = (int16_t) (s->lastValue + get_zigzag(&p));
+
+    CHECK((tag & JOURNAL_SENSOR_FLAG) != 0);
+    if(receivedCount < MAX_RECEIVED){
+      received[receivedCount].sensor = tag & TSCODEC_SENSOR_MASK & ~JOURNAL_SENSOR_FLAG;
+      received[receivedCount].ms = s->lastMs;
+      received[receivedCount].value = s->lastValue;
+      receivedCount++;
+    }
+  }
+  CHECK_EQ(p - data, len);
+
+  return false;
+}
+
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   Fresh erased flash, no cursor in NVM, then a boot
+ * @return  none
+ */
+static void setup(void) {
+  memset(flash, 0xFF, REGION_SIZE);
+  cursorSaved = false;
+  writeBudget = -1;
+  streamActive = false;
+  inFlight = 0;
+  memset(info, 0xFF, FLASH_PAGE_SIZE);
+  ble_data.attPayloadSize = 244;
+  journal_init();
+}
+
+/**
+ * @brief   Power cycle, nothing that was in RAM survives
+ * @return  none
+ */
+static void reboot(void) {
+  writeBudget = -1;
+  streamActive = false;
+  inFlight = 0;
+  journal_init();
+}
+
+/**
+ * @brief   Journals samples of one sensor, one every 2 s, value from first
+ * @param   first   value of the first sample
+ * @param   count   samples
+ * @return  none
+ */
+static void append(int32_t first, uint32_t count) {
+  uint32_t i;
+
+  for(i = 0; i < count; i++){
+    nowMs += 2000;
+    journal_append(TELEMETRY_SENSOR_TEMPERATURE, (int16_t) (first + (int32_t) i));
+  }
+}
+
+/**
+ * @brief   A client subscribes and acknowledges every batch until the
+ *          journal is empty
+ * @return  samples received
+ */
+static uint32_t sync_all(void) {
+  receivedCount = 0;
+  streamActive = true;
+  inFlight = 0;
+
+  journal_pump();
+  while(inFlight != 0){
+    inFlight = 0;
+    journal_pump();
+  }
+
+  streamActive = false;
+  return receivedCount;
+}
+
+/**
+ * @brief   Checks that the received samples count up by one from first
+ * @param   first   value of the first sample
+ * @param   count   samples expected
+ * @return  none
+ */
+static void check_received(int32_t first, uint32_t count) {
+  uint32_t i;
+  uint32_t bad = 0;
+
+  CHECK_EQ(receivedCount, count);
+  for(i = 0; (i < receivedCount) && (i < count); i++){
+    if((received[i].value != (int16_t) (first + (int32_t) i)) ||
+       (received[i].sensor != TELEMETRY_SENSOR_TEMPERATURE) ||
+       ((i > 0) && (received[i].ms != received[i - 1].ms + 2000)))
+      bad++;
+  }
+  CHECK_EQ(bad, 0);
+}
+
+/**
+ * @brief   Returns the first word of a page of the simulated flash
+ * @param   phys    page index in the region
+ * @return  page
+ */
+static uint32_t *page(uint32_t phys) {
+  return (uint32_t *) (flash + (phys * FLASH_PAGE_SIZE));
+}
+
+/**
+ * @brief   Writes the key record to the user data page, read at the next
+ *          journal_init()
+ * @param   valid   false -> the CRC does not match
+ * @return  none
+ */
+static void provision_key(bool valid) {
+  uint8_t  *rec = (uint8_t *) SEAL_KEY_ADDR;
+  uint32_t  magic = SEAL_KEY_MAGIC;
+  uint32_t  crc;
+
+  memcpy(&rec[0], &magic, 4);
+  memcpy(&rec[4], sealKey, SEAL_KEY_SIZE);
+  crc = fwupdate_crc32_update(0xFFFFFFFF, rec, 4 + SEAL_KEY_SIZE) ^ 0xFFFFFFFF;
+  crc ^= (valid ? 0 : 1);
+  memcpy(&rec[4 + SEAL_KEY_SIZE], &crc, 4);
+}
+
+/**
+ * @brief   Checks a page seal the way an investigator does, from the layout
+ *          in seal.h and the key list alone
+ * @param   phys    page index in the region
+ * @return  true if the page is sealed and nothing in it was changed
+ */
+static bool seal_valid(uint32_t phys) {
+  const uint8_t *p = (const uint8_t *) page(phys);
+  const uint8_t *seal = &p[FLASH_PAGE_SIZE - SEAL_SIZE];
+  uint8_t        nonce[SEAL_NONCE_SIZE];
+  uint8_t        tag[SEAL_TAG_SIZE];
+  uint32_t       seq;
+  uint32_t       records;
+  uint32_t       magic;
+  uint32_t       end;
+  uint32_t       i;
+  uint16_t       boot;
+
+  memcpy(&records, &seal[SEAL_TAG_SIZE], 4);
+  memcpy(&magic, &seal[SEAL_TAG_SIZE + 4], 4);
+  if((magic != SEAL_MAGIC) || (records > RECORDS_PER_PAGE))
+    return false;
+
+  // Nonce: sequence, boot, record count, then 5 bytes of the unique ID
+  memcpy(&seq, &p[0], 4);
+  memcpy(&boot, &p[6], 2);
+  memcpy(&nonce[0], &seq, 4);
+  memcpy(&nonce[4], &boot, 2);
+  nonce[6] = (uint8_t) records;
+  nonce[7] = (uint8_t) (records >> 8);
+  memcpy(&nonce[8], (const void *) &DEVINFO->UNIQUEL, 4);
+  nonce[12] = (uint8_t) DEVINFO->UNIQUEH;
+
+  // The page header and the sealed records, nothing written after them
+  end = PAGE_HEADER_SIZE + (records * JOURNAL_RECORD_SIZE);
+  for(i = end; i < FLASH_PAGE_SIZE - SEAL_SIZE; i++){
+    if(p[i] != 0xFF)
+      return false;
+  }
+
+  ccm(sealKey, nonce, SEAL_NONCE_SIZE, p, end, NULL, 0, tag, SEAL_TAG_SIZE);
+  return memcmp(tag, seal, SEAL_TAG_SIZE) == 0;
+}
+
+//------------------------------------------------------------------------------
+// Tests
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   Samples journaled offline arrive once, in order
+ */
+static void test_store_and_forward(void) {
+  journal_stats_t stats;
+
+  setup();
+  append(0, 1000);
+  journal_flush();
+  journal_get_stats(&stats);
+  CHECK_EQ(stats.unsent, 1000);
+
+  sync_all();
+  check_received(0, 1000);
+  journal_get_stats(&stats);
+  CHECK_EQ(stats.unsent, 0);
+  CHECK_EQ(stats.lost, 0);
+}
+
+/**
+ * @brief   The acknowledged cursor survives a reboot, the rest is resent
+ */
+static void test_ack_restore(void) {
+  journal_stats_t stats;
+  uint32_t        firstPass;
+
+  setup();
+  append(0, 600);
+  journal_flush();
+
+  // One batch out, acknowledged, a second batch out, then power is lost
+  streamWindow = 1;
+  receivedCount = 0;
+  streamActive = true;
+  journal_pump();
+  firstPass = receivedCount;
+  inFlight = 0;
+  journal_pump();
+  CHECK(cursorSaved);
+  CHECK(receivedCount > firstPass);
+  CHECK(firstPass < 600);
+
+  reboot();
+  journal_get_stats(&stats);
+  CHECK_EQ(stats.unsent, 600 - firstPass);
+
+  sync_all();
+  check_received((int32_t) firstPass, 600 - firstPass);
+  CHECK(lastBoot == 1);
+
+  // A link lost mid-sync resends from the cursor, not from where it was
+  append(1000, 50);
+  journal_flush();
+  receivedCount = 0;
+  streamActive = true;
+  journal_pump();
+  CHECK_EQ(receivedCount, 50);
+  journal_rewind();
+  inFlight = 0;
+  sync_all();
+  check_received(1000, 50);
+
+  // A cursor that does not fit the flash is not trusted
+  savedCursor = 0xFFFFFFF0u;
+  reboot();
+  journal_get_stats(&stats);
+  CHECK_EQ(stats.unsent, stats.positions);
+}
+
+/**
+ * @brief   More than the region holds, the oldest pages are overwritten
+ */
+static void test_page_wrap(void) {
+  journal_stats_t stats;
+  uint32_t        capacity = JOURNAL_PAGES * RECORDS_PER_PAGE;
+  uint32_t        total = capacity + (3 * RECORDS_PER_PAGE) + 17;
+  uint32_t        phys;
+  uint32_t        sealed = 0;
+
+  setup();
+  provision_key(true);
+  reboot();
+  append(0, total);
+  journal_flush();
+
+  journal_get_stats(&stats);
+  CHECK(stats.positions <= capacity);
+  CHECK(stats.positions > capacity - RECORDS_PER_PAGE);
+  CHECK_EQ(stats.lost, total - stats.positions);
+
+  // The closed pages are sealed, the open head is not
+  for(phys = 0; phys < JOURNAL_PAGES; phys++)
+    sealed += seal_valid(phys);
+  CHECK_EQ(sealed, JOURNAL_PAGES - 1);
+
+  // The newest records arrive, across a reboot that finds the ring
+  reboot();
+  sync_all();
+  check_received((int32_t) (total - stats.positions), stats.positions);
+  CHECK_EQ(received[receivedCount - 1].value, (int16_t) (total - 1));
+}
+
+/**
+ * @brief   The AES-CCM stand-in of the CRYPTO driver against the FIPS-197
+ *          and SP 800-38C example vectors
+ */
+static void test_ccm_vectors(void) {
+  static const uint8_t aesKey[16] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F
+  };
+  static const uint8_t aesIn[16] = {
+    0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF
+  };
+  static const uint8_t aesOut[16] = {
+    0x69, 0xC4, 0xE0, 0xD8, 0x6A, 0x7B, 0x04, 0x30, 0xD8, 0xCD, 0xB7, 0x80, 0x70, 0xB4, 0xC5, 0x5A
+  };
+  static const uint8_t ccmKey[16] = {
+    0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x4B, 0x4C, 0x4D, 0x4E, 0x4F
+  };
+  static const uint8_t nonce[12] = {
+    0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x1B
+  };
+  static const uint8_t aad[20] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09,
+    0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x10, 0x11, 0x12, 0x13
+  };
+  static const uint8_t payload[24] = {
+    0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2A, 0x2B,
+    0x2C, 0x2D, 0x2E, 0x2F, 0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37
+  };
+  // Example 1: 7 byte nonce, 8 bytes of data, 4 byte payload, 4 byte tag
+  static const uint8_t example1[8] = { 0x71, 0x62, 0x01, 0x5B, 0x4D, 0xAC, 0x25, 0x5D };
+  // Example 3: 12 byte nonce, 20 bytes of data, 24 byte payload, 8 byte tag
+  static const uint8_t example3[32] = {
+    0xE3, 0xB2, 0x01, 0xA9, 0xF5, 0xB7, 0x1A, 0x7A, 0x9B, 0x1C, 0xEA, 0xEC, 0xCD, 0x97, 0xE7, 0x0B,
+    0x61, 0x76, 0xAA, 0xD9, 0xA4, 0x42, 0x8A, 0xA5, 0x48, 0x43, 0x92, 0xFB, 0xC1, 0xB0, 0x99, 0x51
+  };
+  uint8_t out[32];
+
+  aes128_encrypt(aesKey, aesIn, out);
+  CHECK(memcmp(out, aesOut, sizeof(aesOut)) == 0);
+
+  ccm(ccmKey, nonce, 7, aad, 8, payload, 4, out, 4);
+  CHECK(memcmp(out, example1, sizeof(example1)) == 0);
+
+  ccm(ccmKey, nonce, 12, aad, 20, payload, 24, out, 8);
+  CHECK(memcmp(out, example3, sizeof(example3)) == 0);
+}
+
+/**
+ * @brief   A closed page carries the tag, the record count and the magic
+ *          in its last SEAL_SIZE bytes, over its header and records; a
+ *          change to any record shows, and without a valid key record
+ *          pages stay unsealed
+ */
+static void test_seal_layout(void) {
+  uint8_t  *p;
+  uint32_t  records;
+  uint32_t  first;
+  uint32_t  phys;
+  uint32_t  sealed = 0;
+
+  // No key
+  setup();
+  append(0, RECORDS_PER_PAGE + 5);
+  journal_flush();
+  CHECK(seal_ready() == false);
+  for(phys = 0; phys < JOURNAL_PAGES; phys++)
+    CHECK_EQ(page(phys)[(FLASH_PAGE_SIZE / 4) - 1], 0xFFFFFFFF);
+
+  // A key record that fails its CRC
+  setup();
+  provision_key(false);
+  reboot();
+  CHECK(seal_ready() == false);
+  append(0, RECORDS_PER_PAGE + 5);
+  journal_flush();
+  for(phys = 0; phys < JOURNAL_PAGES; phys++)
+    CHECK_EQ(page(phys)[(FLASH_PAGE_SIZE / 4) - 1], 0xFFFFFFFF);
+
+  // Provisioned: only the full, closed page is sealed
+  setup();
+  provision_key(true);
+  reboot();
+  CHECK(seal_ready());
+  append(0, RECORDS_PER_PAGE + 5);
+  journal_flush();
+  first = JOURNAL_PAGES;
+  for(phys = 0; phys < JOURNAL_PAGES; phys++){
+    if(seal_valid(phys)){
+      first = phys;
+      sealed++;
+    }
+  }
+  CHECK_EQ(sealed, 1);
+  if(first == JOURNAL_PAGES)
+    return;
+  p = (uint8_t *) page(first);
+  memcpy(&records, &p[FLASH_PAGE_SIZE - 8], 4);
+  CHECK_EQ(records, RECORDS_PER_PAGE);
+
+  // One bit of one record, the record count, or the nonce of another chip
+  p[PAGE_HEADER_SIZE + (7 * JOURNAL_RECORD_SIZE) + 2] ^= 0x01;
+  CHECK(seal_valid(first) == false);
+  p[PAGE_HEADER_SIZE + (7 * JOURNAL_RECORD_SIZE) + 2] ^= 0x01;
+  p[FLASH_PAGE_SIZE - 8] ^= 0x01;
+  CHECK(seal_valid(first) == false);
+  p[FLASH_PAGE_SIZE - 8] ^= 0x01;
+  DEVINFO->UNIQUEH ^= 0x01;
+  CHECK(seal_valid(first) == false);
+  DEVINFO->UNIQUEH ^= 0x01;
+  CHECK(seal_valid(first));
+
+  // The next boot closes the head with 5 records, sealed short of full
+  phys = (first + 1) % JOURNAL_PAGES;
+  CHECK(seal_valid(phys) == false);
+  reboot();
+  append(0, 3);
+  journal_flush();
+  CHECK(seal_valid(phys));
+  p = (uint8_t *) page(phys);
+  memcpy(&records, &p[FLASH_PAGE_SIZE - 8], 4);
+  CHECK_EQ(records, 5);
+}
+
+/**
+ * @brief   A page whose sequence number never made it is skipped
+ */
+static void test_torn_page_header(void) {
+  journal_stats_t stats;
+
+  setup();
+  append(0, 100);
+  journal_flush();
+
+  // After a reboot the next flush opens a new page: the erase and the
+  // magic word go through, the power is lost before the sequence number
+  reboot();
+  append(500, JOURNAL_RAM_RECORDS - 1);
+  writeBudget = 1;
+  append(600, 1);
+  CHECK_EQ(writeBudget, 0);
+
+  reboot();
+  journal_get_stats(&stats);
+  CHECK_EQ(stats.unsent, 100);
+  sync_all();
+  check_received(0, 100);
+
+  // The torn page is reused, this boot writes to it
+  append(700, 20);
+  journal_flush();
+  sync_all();
+  check_received(700, 20);
+}
+
+/**
+ * @brief   Records left in RAM reach flash on the 1 s tick alone, no more
+ *          appends needed, and survive a reboot
+ */
+static void test_tick_flush(void) {
+  journal_stats_t stats;
+  uint64_t        firstMs;
+  uint32_t        early = 0;
+
+  setup();
+  append(0, JOURNAL_RAM_RECORDS - 1);
+  firstMs = nowMs - (2000 * (JOURNAL_RAM_RECORDS - 2));
+
+  // Nothing goes to flash before the oldest record is JOURNAL_MAX_RAM_AGE_MS old
+  while(nowMs + 1000 < firstMs + JOURNAL_MAX_RAM_AGE_MS){
+    nowMs += 1000;
+    journal_tick();
+    journal_get_stats(&stats);
+    early += stats.unsent;
+  }
+  CHECK_EQ(early, 0);
+
+  // The tick at the bound flushes everything
+  nowMs += 1000;
+  journal_tick();
+  journal_get_stats(&stats);
+  CHECK_EQ(stats.unsent, JOURNAL_RAM_RECORDS - 1);
+
+  reboot();
+  sync_all();
+  check_received(0, JOURNAL_RAM_RECORDS - 1);
+}
+
+/**
+ * @brief   Records that fail their CRC are skipped, the rest is delivered
+ */
+static void test_crc_reject(void) {
+  uint32_t *rec;
+
+  setup();
+  append(0, 40);
+  journal_flush();
+
+  // A bit of a value cleared, and a record torn after its first word
+  rec = page(0) + (PAGE_HEADER_SIZE / 4) + (5 * JOURNAL_RECORD_SIZE / 4);
+  rec[0] &= ~(1UL << 16);
+  rec = page(0) + (PAGE_HEADER_SIZE / 4) + (30 * JOURNAL_RECORD_SIZE / 4);
+  rec[1] = 0xFFFFFFFFUL;
+
+  sync_all();
+  CHECK_EQ(receivedCount, 38);
+  CHECK_EQ(received[4].value, 4);
+  CHECK_EQ(received[5].value, 6);
+  CHECK_EQ(received[28].value, 29);
+  CHECK_EQ(received[29].value, 31);
+  CHECK_EQ(received[37].value, 39);
+}
+
+int main(void) {
+  // The journal region sits where journal.c expects it in the EFR32 flash
+  flash = mmap((void *) JOURNAL_BASE, REGION_SIZE, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+  if(flash != (uint8_t *) JOURNAL_BASE){
+    printf("cannot map the journal region at 0x%08lx\n", (unsigned long) JOURNAL_BASE);
+    return 1;
+  }
+
+  // The user data page with no key record, DEVINFO with a unique ID
+  info = mmap((void *) USERDATA_BASE, INFO_SIZE, PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+  if(info != (uint8_t *) USERDATA_BASE){
+    printf("cannot map the information pages at 0x%08lx\n", (unsigned long) USERDATA_BASE);
+    return 1;
+  }
+  memset(info, 0xFF, FLASH_PAGE_SIZE);
+  DEVINFO->UNIQUEL = 0x89ABCDEF;
+  DEVINFO->UNIQUEH = 0x01234567;
+  aes_init();
+
+  RUN(test_ccm_vectors);
+  RUN_FRESH(test_store_and_forward);
+  RUN_FRESH(test_ack_restore);
+  RUN_FRESH(test_page_wrap);
+  RUN_FRESH(test_seal_layout);
+  RUN_FRESH(test_torn_page_header);
+  RUN_FRESH(test_crc_reject);
+  RUN_FRESH(test_tick_flush);
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,548 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    test_lcd.c
+ * @brief   Host test and benchmark of the row-stream renderer of lcd.c
+ *
+ *          The memory LCD is a 128 x 128 screen sl_memlcd_draw() writes its
+ *          lines into. The tests keep their own copy of the display list and
+ *          compare the screen with it pixel by pixel, drawn from the GLIB
+ *          6x8 font of the SDK: a band that was not re-sent shows up as stale
+ *          pixels. The benchmark counts the lines and SPI bytes each kind of
+ *          update sends to the LCD.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "glib.h"
+#include "sl_memlcd.h"
+#include "sl_memlcd_display.h"
+#include "sl_sleeptimer.h"
+#include "app_log.h"
+#include "lcd.h"
+
+#define WIDTH             (SL_MEMLCD_DISPLAY_WIDTH)
+#define HEIGHT            (SL_MEMLCD_DISPLAY_HEIGHT)
+#define BYTES_PER_LINE    (WIDTH / 8)
+#define BAND_LINES        (10)     // fontHeight + lineSpacing of the 6x8 font
+
+// sl_memlcd_draw(): command and first address, then every line with the
+// address of the next one
+#define SPI_BYTES(lines)  (2 + ((lines) * (BYTES_PER_LINE + 2)))
+
+static const sl_memlcd_t memlcd = { WIDTH, HEIGHT, 1, 0, SL_MEMLCD_SCLK_FREQ, 60, 6, 2 };
+
+static uint8_t  screen[HEIGHT][BYTES_PER_LINE];
+static uint32_t draws = 0;
+static uint32_t linesSent = 0;
+static uint32_t tickCount = 0;
+
+// What the test put on the display
+static char     rowText[DISPLAY_NUMBER_OF_ROWS][DISPLAY_ROW_LEN + 1];
+static struct {
+  const uint8_t *bitmap;
+  uint8_t        x, y, width, height;
+} icons[DISPLAY_NUMBER_OF_ICONS];
+
+// 16 x 12 icon, a frame around a black square
+static uint8_t  iconBitmap[(16 * 12) / 8];
+
+//------------------------------------------------------------------------------
+// Stand-ins for the stack and the rest of the firmware
+//------------------------------------------------------------------------------
+
+void si7021TurnOn(void) {
+}
+
+void gpioSetDisplayExtcomin(bool state) {
+  (void) state;
+}
+
+void gpioDisplayExtcominPrsEnable(bool enable) {
+  CHECK(enable);
+}
+
+void CRYOTIMER_Enable(uint32_t nrg_mode) {
+  (void) nrg_mode;
+}
+
+sl_status_t sl_memlcd_init(void) {
+  memset(screen, 0xFF, sizeof(screen));
+  return SL_STATUS_OK;
+}
+
+const sl_memlcd_t *sl_memlcd_get(void) {
+  return &memlcd;
+}
+
+sl_status_t sl_memlcd_draw(const struct sl_memlcd_t *device,
+                           const void *data,
+                           unsigned int row_start,
+                           unsigned int row_count) {
+  CHECK(device == &memlcd);
+  CHECK(row_count > 0);
+  CHECK(row_start + row_count <= HEIGHT);
+  if(row_start + row_count > HEIGHT)
+    return SL_STATUS_FAIL;
+
+  memcpy(screen[row_start], data, row_count * BYTES_PER_LINE);
+  draws++;
+  linesSent += row_count;
+  return SL_STATUS_OK;
+}
+
+uint32_t sl_sleeptimer_get_tick_count(void) {
+  return tickCount;
+}
+
+uint32_t sl_sleeptimer_get_timer_frequency(void) {
+  return 32768;
+}
+
+uint32_t sl_sleeptimer_ms_to_tick(uint16_t time_ms) {
+  return ((uint32_t) time_ms * 32768) / 1000;
+}
+
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   Returns a pixel of the screen
+ * @param   x   column
+ * @param   y   line
+ * @return  true for black
+ */
+static bool black(uint32_t x, uint32_t y) {
+  return ((screen[y][x >> 3] >> (x & 0x7)) & 0x1) == 0;
+}
+
+/**
+ * @brief   Returns what a pixel should show, text centred on its row like
+ *          GLIB_drawStringOnLine() does it and the icons on top
+ * @param   x   column
+ * @param   y   line
+ * @return  true for black
+ */
+static bool expected(uint32_t x, uint32_t y) {
+  const uint8_t *pixMap = (const uint8_t *) GLIB_FontNarrow6x8.pFontPixMap;
+  uint32_t       row = y / BAND_LINES;
+  uint32_t       left;
+  uint32_t       len;
+  uint32_t       bit;
+  char           c;
+  int32_t        i;
+
+  for(i = DISPLAY_NUMBER_OF_ICONS - 1; i >= 0; i--){
+    if((icons[i].bitmap != NULL) &&
+       (x >= icons[i].x) && (x < (uint32_t) (icons[i].x + icons[i].width)) &&
+       (y >= icons[i].y) && (y < (uint32_t) (icons[i].y + icons[i].height))){
+      bit = ((y - icons[i].y) * icons[i].width) + (x - icons[i].x);
+      return ((icons[i].bitmap[bit >> 3] >> (bit & 0x7)) & 0x1) == 0;
+    }
+  }
+
+  if((row >= DISPLAY_NUMBER_OF_ROWS) || ((y % BAND_LINES) >= GLIB_FontNarrow6x8.fontHeight))
+    return false;
+
+  len = strlen(rowText[row]);
+  left = (WIDTH - (len * 6)) / 2;
+  if((x < left) || (x >= left + (len * 6)))
+    return false;
+
+  c = rowText[row][(x - left) / 6];
+  if((c < ' ') || (c > '~'))
+    return false;
+  return ((pixMap[(c - ' ') + ((y % BAND_LINES) * GLIB_FontNarrow6x8.fontRowOffset)] >> ((x - left) % 6)) & 0x1) != 0;
+}
+
+/**
+ * @brief   Returns the number of pixels that differ from the display list
+ * @return  pixels
+ */
+static uint32_t stale(void) {
+  uint32_t n = 0;
+  uint32_t x, y;
+
+  for(y = 0; y < HEIGHT; y++){
+    for(x = 0; x < WIDTH; x++){
+      if(black(x, y) != expected(x, y))
+        n++;
+    }
+  }
+  return n;
+}
+
+/**
+ * @brief   Prints a row on the display and in the copy of the test
+ * @param   row     display row
+ * @param   text    text, printed as is
+ * @return  none
+ */
+static void print(enum display_row row, const char *text) {
+  displayPrintf(row, "%s", text);
+  snprintf(rowText[row], sizeof(rowText[row]), "%s", (text[0] == '\0') ? " " : text);
+}
+
+/**
+ * @brief   Shows the icon in a slot, on the display and in the copy of the
+ *          test
+ * @param   slot    icon slot
+ * @param   x       column
+ * @param   y       line
+ * @return  none
+ */
+static void icon(uint8_t slot, uint8_t x, uint8_t y) {
+  displayIcon(slot, x, y, 16, 12, iconBitmap);
+  icons[slot].bitmap = iconBitmap;
+  icons[slot].x = x;
+  icons[slot].y = y;
+  icons[slot].width = 16;
+  icons[slot].height = 12;
+}
+
+/**
+ * @brief   Removes the icon of a slot, on the display and in the copy of the
+ *          test
+ * @param   slot    icon slot
+ * @return  none
+ */
+static void icon_clear(uint8_t slot) {
+  displayIconClear(slot);
+  icons[slot].bitmap = NULL;
+}
+
+/**
+ * @brief   Counts the draws and lines of what follows
+ * @return  none
+ */
+static void count_from_here(void) {
+  draws = 0;
+  linesSent = 0;
+}
+
+/**
+ * @brief   Boots the display, empty and refreshed at once
+ * @return  none
+ */
+static void boot(void) {
+  uint32_t i, x, y;
+
+  for(i = 0; i < sizeof(iconBitmap); i++)
+    iconBitmap[i] = 0xFF;
+  for(i = 0; i < 16 * 12; i++){
+    x = i % 16;
+    y = i / 16;
+    if((x == 0) || (x == 15) || (y == 0) || (y == 11) || ((x >= 4) && (x < 12) && (y >= 3) && (y < 9)))
+      iconBitmap[i >> 3] &= ~(1 << (i & 0x7));
+  }
+
+  memset(rowText, 0, sizeof(rowText));
+  memset(icons, 0, sizeof(icons));
+  tickCount = 0;
+  displayInit();
+  host_log_clear();
+  count_from_here();
+}
+
+//------------------------------------------------------------------------------
+// Tests
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   A row is one band, sent with one draw and right to the pixel
+ */
+static void test_row_band(void) {
+  uint32_t row;
+
+  boot();
+  CHECK_EQ(stale(), 0);
+
+  print(DISPLAY_ROW_CONNECTION, "Advertising");
+  CHECK_EQ(draws, 1);
+  CHECK_EQ(linesSent, BAND_LINES);
+  CHECK_EQ(stale(), 0);
+
+  // The longest row, odd and even lengths are centred alike
+  print(DISPLAY_ROW_BTADDR, "00:0B:57:A1:B2:C3");
+  print(DISPLAY_ROW_NAME, "Server");
+  print(DISPLAY_ROW_TEMPVALUE, "12345678901234567890");
+  print(DISPLAY_ROW_8, "~ !");
+  CHECK_EQ(draws, 5);
+  CHECK_EQ(stale(), 0);
+
+  // Replaced by a shorter text and erased, nothing of the old one stays
+  print(DISPLAY_ROW_TEMPVALUE, "1");
+  print(DISPLAY_ROW_BTADDR, "");
+  CHECK_EQ(stale(), 0);
+
+  // The last band is cut at the bottom of the screen
+  count_from_here();
+  print(DISPLAY_ROW_ASSIGNMENT, "A9");
+  CHECK_EQ(draws, 1);
+  CHECK_EQ(linesSent, HEIGHT - ((DISPLAY_NUMBER_OF_ROWS - 1) * BAND_LINES));
+  CHECK_EQ(stale(), 0);
+
+  // Every row at once
+  count_from_here();
+  for(row = 0; row < DISPLAY_NUMBER_OF_ROWS; row++)
+    print((enum display_row) row, "Helmets 3/4");
+  CHECK_EQ(linesSent, HEIGHT);
+  CHECK_EQ(stale(), 0);
+}
+
+/**
+ * @brief   Out of range and over long rows, control characters
+ */
+static void test_row_errors(void) {
+  boot();
+  displayPrintf(DISPLAY_NUMBER_OF_ROWS, "lost");
+  CHECK_EQ(draws, 0);
+  CHECK(strstr(host_log_text(), "row parameter 13 is greater than max row index 12") != NULL);
+
+  host_log_clear();
+  print(DISPLAY_ROW_ACTION, "This text is far too long for a row");
+  CHECK(strstr(host_log_text(), "truncated to (20) characters") != NULL);
+  CHECK(strstr(host_log_text(), "This text is far too") != NULL);
+  CHECK_EQ(strlen(rowText[DISPLAY_ROW_ACTION]), DISPLAY_ROW_LEN);
+  CHECK_EQ(stale(), 0);
+
+  // A tab keeps its cell and draws nothing
+  print(DISPLAY_ROW_9, "a\tb");
+  CHECK_EQ(stale(), 0);
+}
+
+/**
+ * @brief   An icon sends the bands it covers, only those, and clearing it
+ *          brings the text underneath back
+ */
+static void test_icon_bands(void) {
+  boot();
+  print(DISPLAY_ROW_CONNECTION, "Connected");
+  print(DISPLAY_ROW_PASSKEY, "Passkey 123456");
+  print(DISPLAY_ROW_ACTION, "Confirm with PB0");
+
+  // Lines 40 to 51, bands 4 and 5
+  count_from_here();
+  icon(0, 56, 40);
+  CHECK_EQ(draws, 2);
+  CHECK_EQ(linesSent, 2 * BAND_LINES);
+  CHECK_EQ(stale(), 0);
+
+  // Lines 38 to 49 stay out of band 5, moved to lines 48 to 59 the icon
+  // sends its old bands and then its new ones
+  count_from_here();
+  icon(1, 0, 38);
+  CHECK_EQ(draws, 2);
+  count_from_here();
+  icon(1, 0, 48);
+  CHECK_EQ(draws, 4);
+  CHECK_EQ(stale(), 0);
+
+  // The last line of the screen
+  count_from_here();
+  icon(2, WIDTH - 16, HEIGHT - 12);
+  CHECK_EQ(draws, 2);
+  CHECK_EQ(stale(), 0);
+
+  // Overlapping icons, the text comes back as they go
+  icon(3, 60, 44);
+  CHECK_EQ(stale(), 0);
+  icon_clear(0);
+  CHECK_EQ(stale(), 0);
+  count_from_here();
+  icon_clear(3);
+  CHECK_EQ(draws, 2);
+  icon_clear(3);
+  CHECK_EQ(draws, 2);
+  icon_clear(1);
+  icon_clear(2);
+  CHECK_EQ(stale(), 0);
+
+  // Off the screen or without a bitmap, nothing is drawn
+  count_from_here();
+  host_log_clear();
+  displayIcon(0, WIDTH - 15, 0, 16, 12, iconBitmap);
+  displayIcon(0, 0, HEIGHT - 11, 16, 12, iconBitmap);
+  displayIcon(0, 0, 0, 16, 12, NULL);
+  displayIcon(DISPLAY_NUMBER_OF_ICONS, 0, 0, 16, 12, iconBitmap);
+  CHECK_EQ(draws, 0);
+  CHECK(strstr(host_log_text(), "icon 0 does not fit on the display") != NULL);
+  CHECK(strstr(host_log_text(), "icon slot 4 is greater than max slot index 3") != NULL);
+}
+
+/**
+ * @brief   Within the refresh period changes wait in the display list,
+ *          displayFlush() sends each changed band once when it is over
+ */
+static void test_refresh_period(void) {
+  uint32_t i;
+
+  boot();
+  print(DISPLAY_ROW_CONNECTION, "Advertising");
+  CHECK_EQ(draws, 1);
+  displaySetRefreshPeriod(1000);
+  CHECK_EQ(draws, 1);
+
+  count_from_here();
+  tickCount += 100;
+  for(i = 0; i < 10; i++)
+    print(DISPLAY_ROW_TEMPVALUE, (i & 1) ? "21 C" : "22 C");
+  print(DISPLAY_ROW_CONNECTION, "Connected");
+  icon(0, 0, 0);
+  CHECK_EQ(draws, 0);
+  displayFlush();
+  CHECK_EQ(draws, 0);
+
+  tickCount = sl_sleeptimer_ms_to_tick(1000);
+  displayFlush();
+  CHECK_EQ(draws, 4);
+  CHECK_EQ(stale(), 0);
+
+  // Nothing left to send, and a flush with nothing to send does not start
+  // a period
+  displayFlush();
+  CHECK_EQ(draws, 4);
+  tickCount += sl_sleeptimer_ms_to_tick(1000);
+  displayFlush();
+  print(DISPLAY_ROW_TEMPVALUE, "20 C");
+  CHECK_EQ(draws, 5);
+
+  // Back to at once, the held back changes go at once too
+  tickCount += 10;
+  print(DISPLAY_ROW_9, "Button Pressed");
+  CHECK_EQ(draws, 5);
+  displaySetRefreshPeriod(0);
+  CHECK_EQ(draws, 6);
+  CHECK_EQ(stale(), 0);
+  print(DISPLAY_ROW_9, "Button Released");
+  CHECK_EQ(draws, 7);
+}
+
+/**
+ * @brief   Any sequence of rows and icons ends with the screen showing the
+ *          display list
+ */
+static void test_random(void) {
+  static const char *texts[] = { "", "x", "Helmets 1/4", "Gas 0.4%", "12345678901234567890", "T=23" };
+  uint32_t i;
+
+  boot();
+  srand(7);
+  for(i = 0; i < 2000; i++){
+    switch(rand() % 4){
+      case 0:
+      case 1:
+        print((enum display_row) (rand() % DISPLAY_NUMBER_OF_ROWS), texts[rand() % 6]);
+        break;
+      case 2:
+        icon((uint8_t) (rand() % DISPLAY_NUMBER_OF_ICONS), (uint8_t) (rand() % (WIDTH - 15)),
+             (uint8_t) (rand() % (HEIGHT - 11)));
+        break;
+      default:
+        icon_clear((uint8_t) (rand() % DISPLAY_NUMBER_OF_ICONS));
+        break;
+    }
+    if((i % 50) == 0)
+      CHECK_EQ(stale(), 0);
+  }
+  CHECK_EQ(stale(), 0);
+}
+
+//------------------------------------------------------------------------------
+// Benchmark
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   Prints what an update sends and how long it takes to generate
+ * @param   name    update
+ * @param   repeat  times it was run
+ * @param   ns      time of all of them
+ * @return  none
+ */
+static void bench_report(const char *name, uint32_t repeat, uint64_t ns) {
+  uint32_t lines = linesSent / repeat;
+  uint32_t bytes = ((draws / repeat) * SPI_BYTES(0)) + (lines * (BYTES_PER_LINE + 2));
+
+  printf("%-20s %2u draws %3u lines %5u SPI bytes %6.0f us on SPI, %6.0f ns generated\n",
+         name, (unsigned int) (draws / repeat), (unsigned int) lines, (unsigned int) bytes,
+         (bytes * 8 * 1e6) / SL_MEMLCD_SCLK_FREQ, (double) ns / repeat);
+}
+
+/**
+ * @brief   Lines and SPI time of the updates the firmware makes, against a
+ *          whole frame
+ * @return  none
+ */
+static void bench_updates(void) {
+  const uint32_t repeat = 10000;
+  uint64_t       start;
+  uint32_t       row;
+  uint32_t       n;
+  uint32_t       i;
+
+  boot();
+  printf("%-20s %2u draws %3u lines %5u SPI bytes %6.0f us on SPI\n", "whole frame", 1, HEIGHT,
+         (unsigned int) SPI_BYTES(HEIGHT), (SPI_BYTES(HEIGHT) * 8 * 1e6) / SL_MEMLCD_SCLK_FREQ);
+
+  count_from_here();
+  start = test_now_ns();
+  for(i = 0; i < repeat; i++)
+    displayPrintf(DISPLAY_ROW_TEMPVALUE, "Temp=%d", (int) (i % 40));
+  bench_report("one row", repeat, test_now_ns() - start);
+
+  count_from_here();
+  start = test_now_ns();
+  for(i = 0; i < repeat; i++){
+    displayIcon(0, 56, 40, 16, 12, iconBitmap);
+    displayIconClear(0);
+  }
+  bench_report("icon on and off", repeat, test_now_ns() - start);
+
+  count_from_here();
+  start = test_now_ns();
+  for(i = 0; i < repeat; i++){
+    for(row = 0; row < DISPLAY_NUMBER_OF_ROWS; row++)
+      displayPrintf((enum display_row) row, "Row %u", (unsigned int) row);
+  }
+  bench_report("every row", repeat, test_now_ns() - start);
+
+  // Ten changes of one row within a refresh period of the SAVER profile
+  displaySetRefreshPeriod(5000);
+  count_from_here();
+  start = test_now_ns();
+  for(i = 0; i < repeat; i++){
+    tickCount += sl_sleeptimer_ms_to_tick(5000);
+    for(n = 0; n < 10; n++)
+      displayPrintf(DISPLAY_ROW_TEMPVALUE, "Temp=%d", (int) n);
+  }
+  bench_report("10 rows in 5 s", repeat, test_now_ns() - start);
+}
+
+int main(int argc, char *argv[]) {
+  if((argc > 1) && (strcmp(argv[1], "bench") == 0)){
+    bench_updates();
+    return TEST_RESULT();
+  }
+
+  RUN(test_row_band);
+  RUN(test_row_errors);
+  RUN(test_icon_bands);
+  RUN(test_refresh_period);
+  RUN(test_random);
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,442 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    test_ringbuf.c
+ * @brief   Host test and benchmark of ringbuf.c
+ *
+ *          The indication queue lanes of ble.c use every byte of their ring,
+ *          USE_ALL_ENTRIES in ble.h: full is head - tail == size, empty is
+ *          head == tail, both with free running indexes that wrap at 2^32.
+ *
+ *          "test_ringbuf bench" writes and reads indication sized records,
+ *          from one thread and from a producer and a consumer thread, and
+ *          prints the records and bytes per second.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "test.h"
+#include "ringbuf.h"
+#include "ble.h"
+
+#define RING_SIZE              (64)
+#define MODEL_OPS              (2000000)
+#define THREAD_RECORDS         (2000000)
+#define BENCH_RECORDS          (20000000)
+
+typedef struct {
+  ringbuf_t *rb;
+  uint32_t   records;
+  uint32_t   maxLen;
+  uint32_t   errors;
+} spsc_t;
+
+static uint8_t storage[QUEUE_LANE_SIZE];
+
+/**
+ * @brief   Fills a payload with bytes that depend on its sequence number
+ * @return  none
+ */
+static void fill(uint8_t *p, uint32_t len, uint32_t seq) {
+  uint32_t i;
+
+  for(i = 0; i < len; i++)
+    p[i] = (uint8_t) (seq * 7 + i);
+}
+
+/**
+ * @brief   Checks a payload made by fill()
+ * @return  true if it matches
+ */
+static bool matches(const uint8_t *p, uint32_t len, uint32_t seq) {
+  uint32_t i;
+
+  for(i = 0; i < len; i++)
+    if(p[i] != (uint8_t) (seq * 7 + i))
+      return false;
+  return true;
+}
+
+/**
+ * @brief   Payload length of a record, varies with its sequence number
+ * @return  length, 0 to maxLen
+ */
+static uint32_t length_of(uint32_t seq, uint32_t maxLen) {
+  return (seq * 2654435761u) % (maxLen + 1);
+}
+
+/**
+ * @brief   Starts a ring with its free running indexes just short of 2^32
+ * @param   rb      ring
+ * @param   size    bytes of storage used
+ * @param   offset  bytes of the ring the indexes start into
+ * @return  none
+ */
+static void init_near_wrap(ringbuf_t *rb, uint32_t size, uint32_t offset) {
+  CHECK(ringbuf_init(rb, storage, size) == false);
+  rb->head = 0u - (4 * size) + offset;
+  rb->tail = rb->head;
+}
+
+//------------------------------------------------------------------------------
+// Tests
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   Only power of 2 sizes that hold a header are accepted
+ */
+static void test_init(void) {
+  ringbuf_t rb;
+
+  CHECK(ringbuf_init(&rb, storage, 0) == true);
+  CHECK(ringbuf_init(&rb, storage, 1) == true);
+  CHECK(ringbuf_init(&rb, storage, 48) == true);
+  CHECK(ringbuf_init(&rb, storage, RING_SIZE) == false);
+  CHECK_EQ(ringbuf_depth(&rb), 0);
+  CHECK_EQ(ringbuf_free(&rb), RING_SIZE);
+  CHECK(ringbuf_fits(&rb, RING_SIZE - RINGBUF_HEADER_SIZE));
+  CHECK(!ringbuf_fits(&rb, RING_SIZE - RINGBUF_HEADER_SIZE + 1));
+}
+
+/**
+ * @brief   Every byte of the ring is used: a full ring is not taken for an
+ *          empty one, at any position and across the index wrap
+ */
+static void test_full_and_empty(void) {
+  ringbuf_t rb;
+  uint8_t   record[RING_SIZE];
+  uint32_t  len;
+  uint32_t  offset;
+  uint32_t  i;
+
+  CHECK_EQ(USE_ALL_ENTRIES, 1);
+
+  for(offset = 0; offset < 8 * RING_SIZE; offset += 16){
+    init_near_wrap(&rb, RING_SIZE, offset);
+
+    // Empty
+    CHECK(ringbuf_peek(&rb, &len) == NULL);
+    CHECK(ringbuf_read(&rb, record, sizeof(record), &len) == true);
+    ringbuf_release(&rb);
+    CHECK_EQ(ringbuf_depth(&rb), 0);
+    CHECK_EQ(ringbuf_free(&rb), RING_SIZE);
+
+    // Four 16 byte records fill it to the last byte
+    for(i = 0; i < 4; i++){
+      fill(record, 14, i);
+      CHECK(ringbuf_write(&rb, record, 14) == false);
+    }
+    CHECK_EQ(ringbuf_free(&rb), 0);
+    CHECK_EQ(ringbuf_depth(&rb), 4);
+    CHECK(!ringbuf_fits(&rb, 0));
+    CHECK(ringbuf_reserve(&rb, 0) == NULL);
+    CHECK(ringbuf_write(&rb, record, 0) == true);
+    CHECK_EQ(ringbuf_depth(&rb), 4);
+
+    // Full
+    for(i = 0; i < 4; i++){
+      CHECK(ringbuf_read(&rb, record, sizeof(record), &len) == false);
+      CHECK_EQ(len, 14);
+      CHECK(matches(record, len, i));
+      CHECK_EQ(ringbuf_free(&rb), 16 * (i + 1));
+    }
+
+    CHECK(ringbuf_peek(&rb, &len) == NULL);
+    CHECK_EQ(ringbuf_depth(&rb), 0);
+    CHECK_EQ(ringbuf_free(&rb), RING_SIZE);
+  }
+
+  // One record of the whole ring
+  init_near_wrap(&rb, RING_SIZE, 0);
+  fill(record, RING_SIZE - RINGBUF_HEADER_SIZE, 9);
+  CHECK(ringbuf_write(&rb, record, RING_SIZE - RINGBUF_HEADER_SIZE) == false);
+  CHECK_EQ(ringbuf_free(&rb), 0);
+  CHECK(ringbuf_read(&rb, record, sizeof(record), &len) == false);
+  CHECK_EQ(len, RING_SIZE - RINGBUF_HEADER_SIZE);
+  CHECK(matches(record, len, 9));
+}
+
+/**
+ * @brief   A record that would straddle the end of the ring starts over at
+ *          the beginning, after a pad marker or after a single spare byte
+ */
+static void test_straddle(void) {
+  ringbuf_t      rb;
+  uint8_t        record[RING_SIZE];
+  const uint8_t *p;
+  uint32_t       len;
+  uint32_t       endLeft;
+
+  for(endLeft = 0; endLeft < 12; endLeft++){
+    init_near_wrap(&rb, RING_SIZE, 0);
+
+    // 20 bytes free at the start of the ring, endLeft at the end
+    fill(record, 18, 0);
+    CHECK(ringbuf_write(&rb, record, 18) == false);
+    fill(record, RING_SIZE - 20 - endLeft - RINGBUF_HEADER_SIZE, 1);
+    CHECK(ringbuf_write(&rb, record, RING_SIZE - 20 - endLeft - RINGBUF_HEADER_SIZE) == false);
+    CHECK(ringbuf_read(&rb, record, sizeof(record), &len) == false);
+    CHECK_EQ(ringbuf_free(&rb), 20 + endLeft);
+
+    // Goes at the end if it fits there, else at the start and the bytes
+    // left at the end are skipped: with a pad marker from 2 bytes on, on
+    // their own below that
+    fill(record, 6, 2);
+    CHECK(ringbuf_write(&rb, record, 6) == false);
+    if(RINGBUF_HEADER_SIZE + 6 <= endLeft){
+      CHECK_EQ(ringbuf_free(&rb), 20 + endLeft - 8);
+    }
+    else {
+      CHECK_EQ(ringbuf_free(&rb), 20 - 8);
+      CHECK_EQ(rb.head & rb.mask, 8);
+    }
+
+    CHECK(ringbuf_read(&rb, record, sizeof(record), &len) == false);
+    CHECK(matches(record, len, 1));
+    p = ringbuf_peek(&rb, &len);
+    CHECK(p != NULL);
+    CHECK_EQ(len, 6);
+    CHECK(matches(p, len, 2));
+    ringbuf_release(&rb);
+    CHECK_EQ(ringbuf_depth(&rb), 0);
+    CHECK_EQ(ringbuf_free(&rb), RING_SIZE);
+  }
+
+  // Enough free bytes in total but not in one piece
+  init_near_wrap(&rb, RING_SIZE, 0);
+  CHECK(ringbuf_write(&rb, record, 30) == false);
+  CHECK(ringbuf_write(&rb, record, 22) == false);
+  CHECK(ringbuf_read(&rb, record, sizeof(record), &len) == false);
+  CHECK_EQ(ringbuf_free(&rb), 32 + 8);
+  CHECK(ringbuf_fits(&rb, 30));
+  CHECK(!ringbuf_fits(&rb, 31));
+  CHECK(ringbuf_reserve(&rb, 31) == NULL);
+}
+
+/**
+ * @brief   A reservation may be committed shorter, a record larger than the
+ *          reader's buffer stays in the ring
+ */
+static void test_reserve_commit(void) {
+  ringbuf_t rb;
+  uint8_t   record[RING_SIZE];
+  uint8_t  *p;
+  uint32_t  len;
+
+  init_near_wrap(&rb, RING_SIZE, 0);
+  p = ringbuf_reserve(&rb, 40);
+  CHECK(p != NULL);
+  CHECK_EQ(ringbuf_depth(&rb), 0);
+  CHECK(ringbuf_peek(&rb, &len) == NULL);
+  fill(p, 10, 3);
+  ringbuf_commit(&rb, 10);
+  CHECK_EQ(ringbuf_depth(&rb), 1);
+  CHECK_EQ(ringbuf_free(&rb), RING_SIZE - 12);
+
+  CHECK(ringbuf_read(&rb, record, 9, &len) == true);
+  CHECK_EQ(ringbuf_depth(&rb), 1);
+  CHECK(ringbuf_read(&rb, record, 10, &len) == false);
+  CHECK_EQ(len, 10);
+  CHECK(matches(record, len, 3));
+}
+
+/**
+ * @brief   Random writes and reads of records from 0 to 40 bytes against a
+ *          model FIFO, with the indexes wrapping on the way
+ */
+static void test_random_model(void) {
+  ringbuf_t      rb;
+  const uint8_t *p;
+  uint8_t       *w;
+  uint32_t       written = 0;
+  uint32_t       read = 0;
+  uint32_t       bytes = 0;     // header and payload bytes in the model
+  uint32_t       len;
+  uint32_t       k;
+
+  srand(29);
+  init_near_wrap(&rb, RING_SIZE * 2, 5);
+  for(k = 0; k < MODEL_OPS; k++){
+    if(rand() & 1){
+      len = length_of(written, 40);
+      w = ringbuf_reserve(&rb, len);
+      if(w != NULL){
+        fill(w, len, written);
+        ringbuf_commit(&rb, len);
+        bytes += RINGBUF_HEADER_SIZE + len;
+        written++;
+      }
+    }
+    else {
+      p = ringbuf_peek(&rb, &len);
+      CHECK_EQ(p == NULL, read == written);
+      if(p != NULL){
+        CHECK_EQ(len, length_of(read, 40));
+        CHECK(matches(p, len, read));
+        ringbuf_release(&rb);
+        bytes -= RINGBUF_HEADER_SIZE + len;
+        read++;
+      }
+    }
+    CHECK_EQ(ringbuf_depth(&rb), written - read);
+    // Pad bytes at the end are counted as used until the reader skips them
+    CHECK(ringbuf_free(&rb) <= RING_SIZE * 2 - bytes);
+    if(test_failures != 0)
+      return;
+  }
+  CHECK(written > MODEL_OPS / 4);
+}
+
+/**
+ * @brief   Producer side of the two thread test and benchmark
+ */
+static void *producer(void *arg) {
+  spsc_t   *s = arg;
+  uint8_t  *w;
+  uint32_t  len;
+  uint32_t  seq;
+
+  for(seq = 0; seq < s->records; seq++){
+    len = length_of(seq, s->maxLen);
+    // Full, let the consumer run when both share a core
+    while((w = ringbuf_reserve(s->rb, len)) == NULL)
+      sched_yield();
+    fill(w, len, seq);
+    ringbuf_commit(s->rb, len);
+  }
+  return NULL;
+}
+
+/**
+ * @brief   Consumer side, checks every record
+ */
+static void *consumer(void *arg) {
+  spsc_t        *s = arg;
+  const uint8_t *p;
+  uint32_t       len;
+  uint32_t       seq;
+
+  for(seq = 0; seq < s->records; seq++){
+    while((p = ringbuf_peek(s->rb, &len)) == NULL)
+      sched_yield();
+    if((len != length_of(seq, s->maxLen)) || !matches(p, len, seq))
+      s->errors++;
+    ringbuf_release(s->rb);
+  }
+  return NULL;
+}
+
+/**
+ * @brief   Runs a producer and a consumer thread on one ring
+ * @return  none
+ */
+static void run_spsc(spsc_t *s) {
+  pthread_t prod;
+  pthread_t cons;
+
+  CHECK(pthread_create(&cons, NULL, consumer, s) == 0);
+  CHECK(pthread_create(&prod, NULL, producer, s) == 0);
+  pthread_join(prod, NULL);
+  pthread_join(cons, NULL);
+}
+
+/**
+ * @brief   A producer and a consumer on two threads, as an ISR and the main
+ *          loop on the EFR32, no record lost or torn
+ */
+static void test_two_threads(void) {
+  ringbuf_t rb;
+  spsc_t    s = { &rb, THREAD_RECORDS, 60, 0 };
+
+  init_near_wrap(&rb, 256, 0);
+  run_spsc(&s);
+  CHECK_EQ(s.errors, 0);
+  CHECK_EQ(ringbuf_depth(&rb), 0);
+  CHECK_EQ(ringbuf_free(&rb), 256);
+}
+
+//------------------------------------------------------------------------------
+// Benchmark
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   Write and read of indication sized records on one queue lane
+ * @return  none
+ */
+static void bench_ringbuf(void) {
+  static const uint32_t sizes[] = { MIN_BUFFER_LENGTH, 20, 64, MAX_BUFFER_LENGTH };
+  ringbuf_t rb;
+  uint8_t   record[MAX_BUFFER_LENGTH + 2];
+  uint64_t  start;
+  uint64_t  ns;
+  uint32_t  len;
+  uint32_t  i;
+  uint32_t  k;
+  uint64_t  sum;
+  uint32_t  errors;
+  spsc_t    s;
+
+  for(i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++){
+    ringbuf_init(&rb, storage, QUEUE_LANE_SIZE);
+    memset(record, (int) i, sizeof(record));
+    sum = 0;
+    errors = 0;
+
+    // Handle and payload, the way ble.c queues an indication
+    start = test_now_ns();
+    for(k = 0; k < BENCH_RECORDS / 2; k++){
+      errors += ringbuf_write(&rb, record, sizes[i] + 2);
+      errors += ringbuf_read(&rb, record, sizeof(record), &len);
+      sum += len;
+    }
+    ns = test_now_ns() - start;
+
+    CHECK_EQ(errors, 0);
+    CHECK_EQ(sum, (uint64_t) (BENCH_RECORDS / 2) * (sizes[i] + 2));
+    printf("ringbuf %3u byte payload: %6.1f M records/s, %6.0f MB/s, %.1f ns per write + read\n",
+           (unsigned int) sizes[i], (double) (BENCH_RECORDS / 2) * 1000.0 / (double) ns,
+           (double) sum * 1000.0 / (double) ns, (double) ns / (BENCH_RECORDS / 2));
+  }
+
+  ringbuf_init(&rb, storage, QUEUE_LANE_SIZE);
+  s.rb = &rb;
+  s.records = BENCH_RECORDS / 2;
+  s.maxLen = MAX_BUFFER_LENGTH;
+  s.errors = 0;
+  start = test_now_ns();
+  run_spsc(&s);
+  ns = test_now_ns() - start;
+  CHECK_EQ(s.errors, 0);
+  printf("ringbuf two threads, 0 to %u byte payloads: %.1f M records/s\n",
+         (unsigned int) MAX_BUFFER_LENGTH, (double) s.records * 1000.0 / (double) ns);
+}
+
+int main(int argc, char *argv[]) {
+  if((argc > 1) && (strcmp(argv[1], "bench") == 0)){
+    bench_ringbuf();
+    return TEST_RESULT();
+  }
+
+  RUN(test_init);
+  RUN(test_full_and_empty);
+  RUN(test_straddle);
+  RUN(test_reserve_commit);
+  RUN(test_random_model);
+  RUN(test_two_threads);
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,414 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    test_stream.c
+ * @brief   Host test of the go-back-N stream in stream.c
+ *
+ *          Notifications go to a link that loses the packets a test picks.
+ *          The client stand-in takes packets in sequence order only and
+ *          answers every burst with an ACK, or a NAK once it saw a later
+ *          packet, the way stream.h asks of a client. Each payload carries
+ *          a running count, so a test sees whether every payload arrived
+ *          once and in order.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "test.h"
+#include "sl_bt_api.h"
+#include "stream.h"
+#include "connparams.h"
+#include "alarm.h"
+#include "ble.h"
+#include "gatt_db.h"
+
+#define LINK_DEPTH             (64)
+#define PAYLOAD_SIZE           (4)
+
+typedef struct {
+  uint8_t  seq;
+  uint32_t count;
+} packet_t;
+
+static ble_data_struct_t  ble_data;
+
+static packet_t           onLink[LINK_DEPTH];   // notifications not yet read by the client
+static uint32_t           linkCount = 0;
+static uint32_t           notifications = 0;    // sent, lost ones included
+static uint32_t           lossPercent = 0;      // random loss on the link
+static bool               loseNext = false;     // the next packet is lost
+static bool               refuse = false;       // the stack is out of buffers
+static bool               reserved = false;     // an alarm holds the link
+
+static bool               timerRunning = false;
+static uint32_t           timerStarts = 0;
+static bool               bulkDemand = false;
+
+static uint8_t            expectedSeq = 0;      // next sequence number of the client
+static uint32_t           deliveredCount = 0;   // payloads taken in order
+static uint32_t           writtenCount = 0;     // payloads given to stream_write()
+
+//------------------------------------------------------------------------------
+// Stand-ins for the stack and the rest of the firmware
+//------------------------------------------------------------------------------
+
+ble_data_struct_t* get_ble_data_ptr() {
+  return &ble_data;
+}
+
+sl_status_t sl_bt_gatt_server_send_notification(uint8_t connection,
+                                                uint16_t characteristic,
+                                                size_t value_len,
+                                                const uint8_t* value) {
+  CHECK_EQ(connection, ble_data.connectionHandle);
+  CHECK_EQ(characteristic, gattdb_stream_data);
+  CHECK((value_len > STREAM_HEADER_SIZE) && (value_len <= ble_data.attPayloadSize));
+  CHECK(reserved == false);
+  if(refuse)
+    return SL_STATUS_NO_MORE_RESOURCE;
+
+  notifications++;
+  if(loseNext || ((uint32_t) (rand() % 100) < lossPercent)){
+    loseNext = false;
+    return SL_STATUS_OK;
+  }
+
+  CHECK(linkCount < LINK_DEPTH);
+  if(linkCount < LINK_DEPTH){
+    onLink[linkCount].seq = value[0];
+    memcpy(&onLink[linkCount].count, &value[STREAM_HEADER_SIZE], PAYLOAD_SIZE);
+    linkCount++;
+  }
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_system_set_soft_timer(uint32_t time, uint8_t handle, uint8_t single_shot) {
+  CHECK_EQ(handle, SOFT_TIMER_2);
+  CHECK_EQ(single_shot, false);
+  CHECK((time == 0) || (time == SOFT_TIMER_TICK_VALUE_500ms));
+  timerRunning = (time != 0);
+  timerStarts += timerRunning;
+  return SL_STATUS_OK;
+}
+
+void connparams_set_demand(conn_demand_t demand, bool active) {
+  CHECK_EQ(demand, CONN_DEMAND_BULK);
+  bulkDemand = active;
+}
+
+bool alarm_link_reserved(void) {
+  return reserved;
+}
+
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   A client subscribes on a fresh connection
+ * @return  none
+ */
+static void connect(void) {
+  memset(&ble_data, 0, sizeof(ble_data));
+  ble_data.connectionHandle = 1;
+  ble_data.connection_open = true;
+  ble_data.ok_to_send_stream_notifications = true;
+  ble_data.attPayloadSize = ATT_DEFAULT_MTU - ATT_HEADER_LENGTH;
+  linkCount = 0;
+  notifications = 0;
+  lossPercent = 0;
+  loseNext = false;
+  refuse = false;
+  reserved = false;
+  timerStarts = 0;
+  expectedSeq = 0;
+  deliveredCount = 0;
+  writtenCount = 0;
+  stream_reset();
+}
+
+/**
+ * @brief   Writes the next payload of the running count
+ * @return  what stream_write() returns
+ */
+static bool write_next(void) {
+  uint8_t payload[PAYLOAD_SIZE];
+
+  memcpy(payload, &writtenCount, PAYLOAD_SIZE);
+  if(stream_write(payload, PAYLOAD_SIZE))
+    return true;
+  writtenCount++;
+  return false;
+}
+
+/**
+ * @brief   Sends a Stream Control write
+ * @param   op      STREAM_OP_*
+ * @param   value   its argument
+ * @return  none
+ */
+static void control(uint8_t op, uint8_t value) {
+  uint8_t data[2] = { op, value };
+
+  stream_handle_control(data, sizeof(data));
+}
+
+/**
+ * @brief   The client reads what the link holds and answers once
+ * @param   answer  false -> the client stays silent
+ * @return  packets on the link
+ */
+static uint32_t client_receive(bool answer) {
+  uint32_t n = linkCount;
+  uint32_t i;
+  bool     gap = false;
+
+  for(i = 0; i < n; i++){
+    if(onLink[i].seq == expectedSeq){
+      CHECK_EQ(onLink[i].count, deliveredCount);
+      deliveredCount++;
+      expectedSeq++;
+    }
+    else {
+      // A later packet, or one resent after the client already had it
+      gap = gap || ((uint8_t) (onLink[i].seq - expectedSeq) < 128);
+    }
+  }
+  linkCount = 0;
+
+  if(answer && (n > 0))
+    control(gap ? STREAM_OP_NAK : STREAM_OP_ACK, expectedSeq);
+
+  return n;
+}
+
+//------------------------------------------------------------------------------
+// Tests
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   No more than the window in flight, no more than
+ *          STREAM_RETAIN_DEPTH retained, and WINDOW clamped to both bounds
+ */
+static void test_window(void) {
+  uint32_t i;
+
+  connect();
+  for(i = 0; i < STREAM_RETAIN_DEPTH; i++)
+    CHECK(write_next() == false);
+  CHECK(write_next());
+  CHECK_EQ(stream_free_slots(), 0);
+  CHECK_EQ(notifications, STREAM_DEFAULT_WINDOW);
+  CHECK(timerRunning);
+  CHECK(bulkDemand);
+
+  // An ACK of two opens the window by two
+  client_receive(false);
+  control(STREAM_OP_ACK, 2);
+  CHECK_EQ(notifications, STREAM_DEFAULT_WINDOW + 2);
+  CHECK_EQ(stream_free_slots(), 2);
+
+  // The largest window sends the rest
+  control(STREAM_OP_WINDOW, 255);
+  CHECK_EQ(notifications, STREAM_RETAIN_DEPTH);
+  CHECK_EQ(client_receive(true), STREAM_RETAIN_DEPTH - STREAM_DEFAULT_WINDOW);
+
+  // The ACK of everything brings back all slots
+  CHECK_EQ(deliveredCount, STREAM_RETAIN_DEPTH);
+  CHECK(stream_all_acked());
+  CHECK_EQ(stream_free_slots(), STREAM_RETAIN_DEPTH);
+  CHECK(timerRunning == false);
+  CHECK(bulkDemand == false);
+
+  // A window of 0 is one packet at a time
+  control(STREAM_OP_WINDOW, 0);
+  notifications = 0;
+  CHECK(write_next() == false);
+  CHECK(write_next() == false);
+  CHECK_EQ(notifications, 1);
+  client_receive(true);
+  CHECK_EQ(notifications, 2);
+  client_receive(true);
+  CHECK(stream_all_acked());
+}
+
+/**
+ * @brief   A lost packet and a NAK resend everything from the lost one
+ */
+static void test_nak(void) {
+  uint32_t i;
+
+  connect();
+  write_next();
+  loseNext = true;
+  for(i = 1; i < STREAM_DEFAULT_WINDOW; i++)
+    write_next();
+  CHECK_EQ(notifications, STREAM_DEFAULT_WINDOW);
+
+  // The client got 0, 2 and 3, and asks from 1
+  CHECK_EQ(client_receive(true), STREAM_DEFAULT_WINDOW - 1);
+  CHECK_EQ(deliveredCount, 1);
+  CHECK_EQ(notifications, (2 * STREAM_DEFAULT_WINDOW) - 1);
+  CHECK_EQ(client_receive(true), STREAM_DEFAULT_WINDOW - 1);
+  CHECK_EQ(deliveredCount, STREAM_DEFAULT_WINDOW);
+  CHECK(stream_all_acked());
+
+  // An ACK past what was sent is ignored, one inside the window is not
+  write_next();
+  write_next();
+  client_receive(false);
+  control(STREAM_OP_ACK, (uint8_t) (STREAM_DEFAULT_WINDOW + 3));
+  CHECK(stream_all_acked() == false);
+  control(STREAM_OP_ACK, (uint8_t) (STREAM_DEFAULT_WINDOW + 2));
+  CHECK(stream_all_acked());
+
+  // Short or unknown control writes change nothing
+  write_next();
+  stream_handle_control((const uint8_t []) { STREAM_OP_ACK }, 1);
+  control(0x7F, 0);
+  CHECK(stream_all_acked() == false);
+}
+
+/**
+ * @brief   A tick without an ACK since the last one resends the window,
+ *          a tick after an ACK does not
+ */
+static void test_retransmit_tick(void) {
+  uint32_t i;
+
+  connect();
+  lossPercent = 100;
+  for(i = 0; i < STREAM_RETAIN_DEPTH; i++)
+    write_next();
+  CHECK_EQ(notifications, STREAM_DEFAULT_WINDOW);
+  CHECK_EQ(timerStarts, 1);
+
+  // Everything lost: the whole window goes again on every tick
+  stream_retransmit_tick();
+  CHECK_EQ(notifications, 2 * STREAM_DEFAULT_WINDOW);
+  stream_retransmit_tick();
+  CHECK_EQ(notifications, 3 * STREAM_DEFAULT_WINDOW);
+  CHECK_EQ(client_receive(true), 0);
+
+  // The link recovers, the next tick resends and the client catches up
+  lossPercent = 0;
+  stream_retransmit_tick();
+  CHECK_EQ(client_receive(true), STREAM_DEFAULT_WINDOW);
+  CHECK_EQ(deliveredCount, STREAM_DEFAULT_WINDOW);
+
+  // Those ACKs count as progress, the next tick resends nothing
+  notifications = 0;
+  stream_retransmit_tick();
+  CHECK_EQ(notifications, 0);
+  stream_retransmit_tick();
+  CHECK_EQ(notifications, STREAM_DEFAULT_WINDOW);
+  client_receive(true);
+  CHECK_EQ(deliveredCount, STREAM_RETAIN_DEPTH);
+  CHECK(stream_all_acked());
+  CHECK(timerRunning == false);
+
+  // A tick with nothing outstanding is a no-op
+  notifications = 0;
+  stream_retransmit_tick();
+  CHECK_EQ(notifications, 0);
+}
+
+/**
+ * @brief   Nothing is sent while the stack is out of buffers, an alarm
+ *          holds the link or the client is not subscribed
+ */
+static void test_held_back(void) {
+  uint8_t big[MAX_BUFFER_LENGTH];
+
+  connect();
+  refuse = true;
+  write_next();
+  write_next();
+  CHECK_EQ(notifications, 0);
+  CHECK(timerRunning);
+
+  refuse = false;
+  reserved = true;
+  stream_retransmit_tick();
+  CHECK_EQ(notifications, 0);
+
+  reserved = false;
+  stream_pump();
+  CHECK_EQ(notifications, 2);
+  client_receive(true);
+  CHECK_EQ(deliveredCount, 2);
+
+  // Payloads that do not fit, and a client that is not subscribed
+  memset(big, 0, sizeof(big));
+  CHECK(stream_write(big, 0));
+  CHECK(stream_write(big, ble_data.attPayloadSize));
+  CHECK(stream_write(big, ble_data.attPayloadSize - STREAM_HEADER_SIZE) == false);
+  ble_data.ok_to_send_stream_notifications = false;
+  CHECK(stream_write(big, 1));
+  CHECK(stream_is_active() == false);
+}
+
+/**
+ * @brief   Thousands of payloads through a lossy link, with window changes,
+ *          so the sequence numbers wrap around 256 many times; every
+ *          payload arrives once and in order
+ */
+static void test_sequence_wrap(void) {
+  uint32_t total = 3000;
+  uint32_t rounds = 0;
+
+  connect();
+  srand(7);
+  lossPercent = 15;
+
+  while((deliveredCount < total) && (rounds < 100000)){
+    while((writtenCount < total) && (stream_free_slots() > 0))
+      write_next();
+
+    // A silent client now and then, so the tick has to recover it
+    if(client_receive((rand() % 8) != 0) == 0)
+      stream_retransmit_tick();
+
+    if((rand() % 50) == 0)
+      control(STREAM_OP_WINDOW, (uint8_t) (1 + (rand() % STREAM_RETAIN_DEPTH)));
+    rounds++;
+  }
+
+  CHECK_EQ(deliveredCount, total);
+  CHECK(notifications > total);
+  CHECK_EQ(expectedSeq, (uint8_t) total);
+
+  // Lost ACKs leave the stream waiting, the tick brings it back
+  stream_retransmit_tick();
+  lossPercent = 0;
+  while((stream_all_acked() == false) && (rounds++ < 100000)){
+    client_receive(true);
+    stream_retransmit_tick();
+  }
+  CHECK(stream_all_acked());
+  CHECK(timerRunning == false);
+  CHECK(bulkDemand == false);
+}
+
+int main(void) {
+
+  RUN(test_window);
+  RUN(test_nak);
+  RUN(test_retransmit_tick);
+  RUN(test_held_back);
+  RUN(test_sequence_wrap);
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,469 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    test_telemetry.c
+ * @brief   Host test of telemetry.c and the tscodec.c it batches with
+ *
+ *          Every sample handed to telemetry_add_sample() must come out once,
+ *          either in a Bulk Telemetry notification or stream write, decoded
+ *          here with tscodec_read(), or in the journal, with the timestamp
+ *          and value it went in with. The stack and the stream refuse
+ *          packets on request.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "sl_sleeptimer.h"
+#include "sl_bt_api.h"
+#include "telemetry.h"
+#include "tscodec.h"
+#include "journal.h"
+#include "stream.h"
+#include "ble.h"
+
+#define MAX_SAMPLES            (20000)
+#define BENCH_SAMPLES          (2000000)
+
+// Link layer bytes around an ATT PDU on the 1M PHY: preamble, access
+// address, header, CRC, and the L2CAP header
+#define LL_OVERHEAD            (1 + 4 + 2 + 3)
+#define L2CAP_HEADER           (4)
+
+typedef struct {
+  uint8_t  sensor;
+  uint32_t ms;
+  int16_t  value;
+} sample_t;
+
+static uint64_t           nowMs = 5000;
+static ble_data_struct_t  ble_data;
+
+static bool               streamActive = false;
+static bool               refuse = false;      // the next packets are refused
+
+static sample_t           added[MAX_SAMPLES];
+static uint32_t           addedCount = 0;
+static uint32_t           addedTotal = 0;
+static sample_t           delivered[MAX_SAMPLES];
+static uint32_t           deliveredCount = 0;
+static uint32_t           packets = 0;          // sent or refused
+static int32_t            firstSeq = -1;        // sequence number of the first packet
+static uint64_t           payloadBytes = 0;
+static sample_t           journaled[MAX_SAMPLES];
+static uint32_t           journaledCount = 0;
+
+//------------------------------------------------------------------------------
+// The rest of the firmware
+//------------------------------------------------------------------------------
+
+uint64_t sl_sleeptimer_get_tick_count64(void) {
+  return nowMs;
+}
+
+sl_status_t sl_sleeptimer_tick64_to_ms(uint64_t tick, uint64_t *ms) {
+  *ms = tick;
+  return SL_STATUS_OK;
+}
+
+ble_data_struct_t* get_ble_data_ptr() {
+  return &ble_data;
+}
+
+void journal_append_at(telemetry_sensor_t sensor, uint32_t ms, int16_t value) {
+  if(journaledCount < MAX_SAMPLES){
+    journaled[journaledCount].sensor = (uint8_t) sensor;
+    journaled[journaledCount].ms = ms;
+    journaled[journaledCount].value = value;
+    journaledCount++;
+  }
+}
+
+/**
+ * @brief   Checks that batches are numbered one after the other, sent or not
+ * @param   data    batch
+ * @return  none
+ */
+static void count_packet(const uint8_t *data) {
+  if(firstSeq < 0)
+    firstSeq = data[0];
+  CHECK_EQ(data[0], (uint8_t) (firstSeq + packets));
+  packets++;
+}
+
+/**
+ * @brief   Decodes a sent batch, sequence number and block
+ * @param   data    batch
+ * @param   len     bytes in the batch
+ * @return  none
+ */
+static void receive(const uint8_t *data, uint32_t len) {
+  tscodec_reader_t reader;
+  sample_t         s;
+  uint32_t         n = 0;
+
+  CHECK(len <= (uint32_t) ble_data.attPayloadSize - (streamActive ? STREAM_HEADER_SIZE : 0));
+  count_packet(data);
+  payloadBytes += len;
+
+  tscodec_read_begin(&reader, &data[1], len - 1);
+  while(tscodec_read(&reader, &s.sensor, &s.ms, &s.value) == false){
+    if(deliveredCount < MAX_SAMPLES)
+      delivered[deliveredCount++] = s;
+    n++;
+  }
+  CHECK_EQ(n, data[1]);
+  CHECK_EQ(reader.pos, len - 1);
+}
+
+bool stream_is_active(void) {
+  return streamActive;
+}
+
+bool stream_write(const uint8_t *data, uint32_t len) {
+  CHECK(streamActive);
+  if(refuse){
+    count_packet(data);
+    return true;
+  }
+  receive(data, len);
+  return false;
+}
+
+sl_status_t sl_bt_gatt_server_send_notification(uint8_t connection,
+                                                uint16_t characteristic,
+                                                size_t value_len,
+                                                const uint8_t* value) {
+  CHECK_EQ(connection, ble_data.connectionHandle);
+  CHECK_EQ(characteristic, gattdb_bulk_telemetry);
+  if(refuse){
+    count_packet(value);
+    return SL_STATUS_NO_MORE_RESOURCE;
+  }
+  receive(value, (uint32_t) value_len);
+  return SL_STATUS_OK;
+}
+
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   A client subscribed to Bulk Telemetry at the given MTU
+ * @param   mtu     negotiated ATT_MTU
+ * @return  none
+ */
+static void connect(uint32_t mtu) {
+  memset(&ble_data, 0, sizeof(ble_data));
+  ble_data.connection_open = true;
+  ble_data.connectionHandle = 3;
+  ble_data.connectionInterval = 24;
+  ble_data.attPayloadSize = (uint16_t) (mtu - ATT_HEADER_LENGTH);
+  ble_data.ok_to_send_telemetry_notifications = true;
+  streamActive = false;
+  refuse = false;
+  addedCount = 0;
+  deliveredCount = 0;
+  journaledCount = 0;
+  packets = 0;
+  firstSeq = -1;
+  payloadBytes = 0;
+  telemetry_reset();
+}
+
+/**
+ * @brief   Adds a sample and remembers it, the caller journals it when
+ *          telemetry does not take it, as the firmware does
+ * @param   sensor  source of the sample
+ * @param   value   sample value
+ * @return  none
+ */
+static void add(telemetry_sensor_t sensor, int16_t value) {
+  addedTotal++;
+  if(addedCount < MAX_SAMPLES){
+    added[addedCount].sensor = (uint8_t) sensor;
+    added[addedCount].ms = (uint32_t) nowMs;
+    added[addedCount].value = value;
+    addedCount++;
+  }
+  if(telemetry_add_sample(sensor, value))
+    journal_append_at(sensor, (uint32_t) nowMs, value);
+}
+
+/**
+ * @brief   Temperature every period with a slow drift, the button now and
+ *          then, the zone and the battery every 60 periods
+ * @param   periods   how long
+ * @param   periodMs  sampling period, 1000 in the firmware
+ * @return  none
+ */
+static void run_sensors(uint32_t periods, uint32_t periodMs) {
+  static int32_t temperature = 2150;
+  uint32_t       i;
+
+  for(i = 0; i < periods; i++){
+    nowMs += periodMs;
+    temperature += ((i * 7) % 5) - 2;
+    add(TELEMETRY_SENSOR_TEMPERATURE, (int16_t) temperature);
+    if((i % 97) == 13)
+      add(TELEMETRY_SENSOR_BUTTON, (int16_t) ((i / 97) & 1));
+    if((i % 60) == 0){
+      add(TELEMETRY_SENSOR_ZONE, (int16_t) (40 + (i / 600)));
+      add(TELEMETRY_SENSOR_BATTERY, (int16_t) (3900 - (i / 120)));
+    }
+  }
+}
+
+/**
+ * @brief   Returns whether two samples are the same
+ * @return  true if equal
+ */
+static bool same(const sample_t *a, const sample_t *b) {
+  return (a->sensor == b->sensor) && (a->ms == b->ms) && (a->value == b->value);
+}
+
+/**
+ * @brief   Checks that every added sample came out once, delivered or
+ *          journaled, each in the order it was added
+ * @return  none
+ */
+static void check_all_accounted(void) {
+  uint32_t i;
+  uint32_t d = 0;
+  uint32_t j = 0;
+  uint32_t bad = 0;
+
+  for(i = 0; i < addedCount; i++){
+    if((d < deliveredCount) && same(&added[i], &delivered[d]))
+      d++;
+    else if((j < journaledCount) && same(&added[i], &journaled[j]))
+      j++;
+    else
+      bad++;
+  }
+  CHECK_EQ(bad, 0);
+  CHECK_EQ(d, deliveredCount);
+  CHECK_EQ(j, journaledCount);
+}
+
+//------------------------------------------------------------------------------
+// Tests
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   Everything is delivered in full batches, nothing journaled
+ */
+static void test_delivered(void) {
+  telemetry_stats_t stats;
+
+  connect(247);
+  run_sensors(3600, 1000);
+  telemetry_flush();
+
+  check_all_accounted();
+  CHECK_EQ(deliveredCount, addedCount);
+  CHECK_EQ(journaledCount, 0);
+  telemetry_get_stats(&stats);
+  CHECK_EQ(stats.packetsSent, packets);
+  CHECK_EQ(stats.packetsDropped, 0);
+}
+
+/**
+ * @brief   Batches the stack refuses go to the journal
+ */
+static void test_refused_notification(void) {
+  telemetry_stats_t stats;
+  uint32_t          i;
+
+  connect(247);
+  for(i = 0; i < 20; i++){
+    refuse = ((i % 3) == 1);
+    run_sensors(100, 1000);
+  }
+  refuse = false;
+  telemetry_flush();
+
+  check_all_accounted();
+  CHECK(journaledCount > 0);
+  CHECK(deliveredCount > 0);
+  telemetry_get_stats(&stats);
+  CHECK(stats.packetsDropped > 0);
+  CHECK_EQ(stats.packetsSent + stats.packetsDropped, packets);
+}
+
+/**
+ * @brief   Batches a stalled stream refuses go to the journal
+ */
+static void test_refused_stream(void) {
+  uint32_t i;
+
+  connect(247);
+  ble_data.ok_to_send_telemetry_notifications = false;
+  streamActive = true;
+  telemetry_reset();
+  for(i = 0; i < 20; i++){
+    refuse = ((i % 4) == 2);
+    run_sensors(100, 1000);
+  }
+  refuse = false;
+  telemetry_flush();
+
+  check_all_accounted();
+  CHECK(journaledCount > 0);
+  CHECK(deliveredCount > 0);
+}
+
+/**
+ * @brief   A batch left open when the client unsubscribes or the link
+ *          closes goes to the journal, as do samples after that
+ */
+static void test_unsubscribe_and_close(void) {
+  connect(247);
+  run_sensors(10, 1000);
+  ble_data.ok_to_send_telemetry_notifications = false;
+  telemetry_flush();
+  CHECK_EQ(journaledCount, addedCount);
+  run_sensors(10, 1000);
+  CHECK_EQ(journaledCount, addedCount);
+
+  ble_data.ok_to_send_telemetry_notifications = true;
+  run_sensors(10, 1000);
+  ble_data.connection_open = false;
+  ble_data.ok_to_send_telemetry_notifications = false;
+  telemetry_reset();
+  run_sensors(10, 1000);
+
+  check_all_accounted();
+  CHECK_EQ(deliveredCount, 0);
+  CHECK_EQ(journaledCount, addedCount);
+}
+
+/**
+ * @brief   With a sample every 60 s, as under the CRITICAL profile, the
+ *          1 s tick sends each batch at TELEMETRY_MAX_BATCH_AGE_MS
+ */
+static void test_age_tick(void) {
+  uint32_t second;
+  uint32_t i;
+  uint32_t late = 0;
+
+  connect(247);
+  for(i = 0; i < 10; i++){
+    add(TELEMETRY_SENSOR_TEMPERATURE, (int16_t) (2000 + i));
+    for(second = 1; second < 60; second++){
+      nowMs += 1000;
+      telemetry_tick();
+      if(second < TELEMETRY_MAX_BATCH_AGE_MS / 1000)
+        late += (deliveredCount != i);
+      else
+        late += (deliveredCount != i + 1);
+    }
+    nowMs += 1000;
+  }
+
+  CHECK_EQ(late, 0);
+  CHECK_EQ(packets, 10);
+  check_all_accounted();
+}
+
+/**
+ * @brief   A sample that does not fit even an empty batch is handed back,
+ *          no empty batch is sent, the samples after it still go out
+ */
+static void test_sample_too_large(void) {
+  telemetry_stats_t stats;
+
+  // Room for the header and 2 bytes of samples
+  connect(ATT_HEADER_LENGTH + TELEMETRY_HEADER_SIZE + 2);
+  nowMs += 1000;
+  add(TELEMETRY_SENSOR_TEMPERATURE, 1);
+  CHECK_EQ(packets, 1);
+  nowMs += 1000;
+  add(TELEMETRY_SENSOR_TEMPERATURE, 2500);
+  CHECK_EQ(journaledCount, 1);
+  nowMs += 1000;
+  add(TELEMETRY_SENSOR_BUTTON, 0);
+  telemetry_flush();
+
+  check_all_accounted();
+  CHECK_EQ(deliveredCount, 2);
+  telemetry_get_stats(&stats);
+  CHECK_EQ(stats.packetsSent, 2);
+  CHECK_EQ(stats.packetsDropped, 0);
+}
+
+//------------------------------------------------------------------------------
+// Benchmark
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   Packets and air bytes per sample of the sensor mix of the firmware
+ *          at two MTUs, against one Health Thermometer indication per sample,
+ *          and the CPU time of telemetry_add_sample() on the host. At the
+ *          1 s period of the firmware the batch age closes the batches, at
+ *          10 ms the packet size does.
+ * @return  none
+ */
+static void bench_throughput(void) {
+  static const uint32_t mtus[] = { ATT_DEFAULT_MTU, 247, ATT_DEFAULT_MTU, 247 };
+  static const uint32_t periods[] = { 1000, 1000, 10, 10 };
+  // 5 byte HTM value, and the confirmation the client sends back
+  const double htmBytes = (LL_OVERHEAD + L2CAP_HEADER + ATT_HEADER_LENGTH + 5) +
+                          (LL_OVERHEAD + L2CAP_HEADER + 1);
+  uint64_t start;
+  uint64_t ns;
+  uint32_t k;
+  double   perSample;
+  double   airBytes;
+
+  printf("one HTM indication per sample: 1 sample/packet, %.1f air bytes/sample, "
+         "1 connection event/sample at best\n", htmBytes);
+
+  for(k = 0; k < sizeof(mtus) / sizeof(mtus[0]); k++){
+    connect(mtus[k]);
+    addedTotal = 0;
+
+    start = test_now_ns();
+    run_sensors(BENCH_SAMPLES, periods[k]);
+    telemetry_flush();
+    ns = test_now_ns() - start;
+
+    perSample = (double) addedTotal / (double) packets;
+    airBytes = ((double) payloadBytes +
+                ((double) packets * (LL_OVERHEAD + L2CAP_HEADER + ATT_HEADER_LENGTH))) /
+               (double) addedTotal;
+    printf("bulk telemetry, ATT_MTU %3u, %4u ms period: %5.1f samples/packet, %5.2f air bytes/sample, "
+           "%.3f packets/sample, %.1f ns/sample on the host\n",
+           (unsigned int) mtus[k], (unsigned int) periods[k], perSample, airBytes, 1.0 / perSample,
+           (double) ns / (double) addedTotal);
+    CHECK_EQ(deliveredCount, MAX_SAMPLES);
+    CHECK_EQ(journaledCount, 0);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  if((argc > 1) && (strcmp(argv[1], "bench") == 0)){
+    bench_throughput();
+    return TEST_RESULT();
+  }
+
+  RUN_FRESH(test_delivered);
+  RUN_FRESH(test_refused_notification);
+  RUN_FRESH(test_refused_stream);
+  RUN_FRESH(test_unsubscribe_and_close);
+  RUN_FRESH(test_age_tick);
+  RUN_FRESH(test_sample_too_large);
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,350 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    test_timers.c
+ * @brief   Host test of the LETIMER0 clock switch and the sampling period in
+ *          timers.c
+ *
+ *          LETIMER0 is simulated tick by tick on a time base both of its
+ *          clocks divide: the counter counts down, reloads from COMP0 on the
+ *          tick after it reached 0 and matches COMP1 on the way. A stopped
+ *          timer loses the tick in progress, like the LF clock domain sync
+ *          does on the device.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "em_device.h"
+#include "em_cmu.h"
+#include "em_letimer.h"
+#include "oscillators.h"
+#include "timers.h"
+
+// 1024000 units per second, a whole number per tick of either clock
+#define UNITS_PER_MS      (1024)
+#define LFXO_UNITS        (125)      // 32768 Hz / 4
+#define ULFRCO_UNITS      (1024)     // 1000 Hz
+
+#define PERIOD_UNITS      ((uint64_t) LETIMER_PERIOD_MS * UNITS_PER_MS)
+
+LETIMER_TypeDef   hostLetimer0;
+CRYOTIMER_TypeDef hostCryotimer;
+
+static bool       running = false;
+static uint32_t   tickUnits = LFXO_UNITS;
+static uint32_t   phase = 0;              // units into the tick in progress
+static uint64_t   nowUnits = 0;
+static uint32_t   clockSwitches = 0;
+
+static uint32_t   underflows = 0;
+static uint64_t   firstUnderflow = 0;
+static uint64_t   lastUnderflow = 0;
+static uint64_t   lastComp1 = 0;
+static uint32_t   samples = 0;
+static uint64_t   lastSample = 0;
+
+//------------------------------------------------------------------------------
+// Stand-ins for the stack and the rest of the firmware
+//------------------------------------------------------------------------------
+
+void LETIMER0_clk_Enable(uint32_t nrg_mode, uint32_t prescaler) {
+  CHECK(running == false);
+  CHECK(((nrg_mode == EM2) && (prescaler == 4)) || ((nrg_mode == EM3) && (prescaler == 1)));
+  tickUnits = (nrg_mode == EM3) ? (ULFRCO_UNITS * prescaler) : ((LFXO_UNITS * prescaler) / 4);
+  clockSwitches++;
+}
+
+uint32_t CRYOTIMER_clk_Enable(uint32_t nrg_mode) {
+  (void) nrg_mode;
+  return 0;
+}
+
+uint32_t CMU_ClockFreqGet(CMU_Clock_TypeDef clock) {
+  CHECK_EQ(clock, cmuClock_LETIMER0);
+  return (1000 * UNITS_PER_MS) / tickUnits;
+}
+
+void LETIMER_Init(LETIMER_TypeDef *letimer, const LETIMER_Init_TypeDef *init) {
+  CHECK(letimer == LETIMER0);
+  CHECK(init->comp0Top);
+  CHECK_EQ(init->repMode, letimerRepeatFree);
+  CHECK_EQ(init->ufoa0, letimerUFOAPulse);
+  running = init->enable;
+  phase = 0;
+}
+
+void LETIMER_Enable(LETIMER_TypeDef *letimer, bool enable) {
+  CHECK(letimer == LETIMER0);
+  running = enable;
+  phase = 0;
+}
+
+uint32_t LETIMER_CompareGet(LETIMER_TypeDef *letimer, unsigned int comp) {
+  return (comp == 0) ? letimer->COMP0 : letimer->COMP1;
+}
+
+void LETIMER_CompareSet(LETIMER_TypeDef *letimer, unsigned int comp, uint32_t value) {
+  CHECK(value <= 0xFFFF);
+  if(comp == 0)
+    letimer->COMP0 = value;
+  else
+    letimer->COMP1 = value;
+}
+
+uint32_t LETIMER_CounterGet(LETIMER_TypeDef *letimer) {
+  return letimer->CNT;
+}
+
+void LETIMER_CounterSet(LETIMER_TypeDef *letimer, uint32_t value) {
+  CHECK(value <= 0xFFFF);
+  letimer->CNT = value;
+}
+
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   One tick of LETIMER0, the BLE loop counts an underflow at once
+ * @return  none
+ */
+static void tick(void) {
+  if(LETIMER0->CNT == 0){
+    LETIMER0->CNT = LETIMER0->COMP0;
+    if(underflows++ == 0)
+      firstUnderflow = nowUnits;
+    lastUnderflow = nowUnits;
+    if(LETIMER0_Sample_Due()){
+      samples++;
+      lastSample = nowUnits;
+    }
+    return;
+  }
+
+  LETIMER0->CNT--;
+  if(LETIMER0->CNT == LETIMER0->COMP1)
+    lastComp1 = nowUnits;
+}
+
+/**
+ * @brief   Lets time pass
+ * @param   units   1 / 1024000 s
+ * @return  none
+ */
+static void run(uint64_t units) {
+  uint64_t end = nowUnits + units;
+
+  while(running && (nowUnits + (tickUnits - phase) <= end)){
+    nowUnits += tickUnits - phase;
+    phase = 0;
+    tick();
+  }
+  if(running)
+    phase += (uint32_t) (end - nowUnits);
+  nowUnits = end;
+}
+
+/**
+ * @brief   Returns the time until the next underflow
+ * @return  units
+ */
+static uint64_t to_underflow(void) {
+  return ((uint64_t) (LETIMER0->CNT + 1) * tickUnits) - phase;
+}
+
+/**
+ * @brief   Returns the time until COMP1 matches
+ * @return  units, 0 if it does not before the next underflow
+ */
+static uint64_t to_comp1(void) {
+  if(LETIMER0->CNT <= LETIMER0->COMP1)
+    return 0;
+  return ((uint64_t) (LETIMER0->CNT - LETIMER0->COMP1) * tickUnits) - phase;
+}
+
+/**
+ * @brief   Returns the distance between two times
+ * @param   a   units
+ * @param   b   units
+ * @return  units
+ */
+static uint64_t distance(uint64_t a, uint64_t b) {
+  return (a > b) ? (a - b) : (b - a);
+}
+
+/**
+ * @brief   Boots LETIMER0 on the LFXO and runs it to its first underflow
+ * @return  none
+ */
+static void boot(void) {
+  memset(&hostLetimer0, 0, sizeof(hostLetimer0));
+  running = false;
+  nowUnits = 0;
+  underflows = 0;
+  samples = 0;
+  LETIMER0_Set_Sample_Period(LETIMER_PERIOD_MS);
+  LETIMER0_Enable();
+  CHECK(running);
+  CHECK(LETIMER0->IEN & LETIMER_IEN_UF);
+  run(tickUnits);
+  CHECK_EQ(underflows, 1);
+  clockSwitches = 0;
+}
+
+//------------------------------------------------------------------------------
+// Tests
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   A period is LETIMER_PERIOD_MS on either clock
+ */
+static void test_period(void) {
+  boot();
+  run(10 * PERIOD_UNITS);
+  CHECK_EQ(underflows, 11);
+  CHECK_EQ(lastUnderflow - firstUnderflow, 10 * PERIOD_UNITS);
+
+  LETIMER0_Select_Clock(true);
+  CHECK_EQ(clockSwitches, 1);
+  run(to_underflow());
+  firstUnderflow = lastUnderflow;
+  underflows = 1;
+  run(10 * PERIOD_UNITS);
+  CHECK_EQ(underflows, 11);
+  CHECK_EQ(lastUnderflow - firstUnderflow, 10 * PERIOD_UNITS);
+
+  // Selecting the clock in use changes nothing
+  LETIMER0_Select_Clock(true);
+  CHECK_EQ(clockSwitches, 1);
+  CHECK(running);
+}
+
+/**
+ * @brief   At any point of the period, the next underflow stays where it was
+ *          to half a tick of either clock, a pending timed wait to a tick of
+ *          the slower one
+ */
+static void test_switch_phase(void) {
+  const uint64_t bound = (ULFRCO_UNITS + LFXO_UNITS) / 2;
+  uint64_t       underflowAt;
+  uint64_t       comp1At;
+  uint64_t       step;
+  bool           ulfrco = false;
+
+  boot();
+  for(step = 0; step < 400; step++){
+    // A timed wait 150 ms out, then somewhere into the period
+    timerWaitUs_irq(150000);
+    run((step * 7919 * UNITS_PER_MS / 1000) % 140000);
+
+    underflowAt = nowUnits + to_underflow();
+    comp1At = nowUnits + to_comp1();
+    ulfrco = !ulfrco;
+    LETIMER0_Select_Clock(ulfrco);
+
+    CHECK(distance(nowUnits + to_underflow(), underflowAt) <= bound);
+    if(comp1At != nowUnits)
+      CHECK(distance(nowUnits + to_comp1(), comp1At) <= ULFRCO_UNITS + (LFXO_UNITS / 2));
+
+    run(to_underflow() + PERIOD_UNITS / 3);
+  }
+  CHECK_EQ(clockSwitches, 400);
+
+  // A counter about to underflow still underflows
+  LETIMER0_Select_Clock(false);
+  run(to_underflow() - 1);
+  underflowAt = underflows;
+  LETIMER0_Select_Clock(true);
+  run(2 * ULFRCO_UNITS);
+  CHECK_EQ(underflows, underflowAt + 1);
+}
+
+/**
+ * @brief   An hour of EM3 round trips at random points keeps the underflows
+ *          on the LETIMER_PERIOD_MS grid, within the tolerance of the LFXO
+ */
+static void test_timekeeping(void) {
+  uint32_t seed = 12345;
+  uint32_t periods = 3600000 / LETIMER_PERIOD_MS;
+  uint32_t i;
+
+  boot();
+  for(i = 0; i < periods; i++){
+    seed = (seed * 1103515245) + 12345;
+    run((seed >> 8) % PERIOD_UNITS);
+    LETIMER0_Select_Clock(true);
+    seed = (seed * 1103515245) + 12345;
+    run((seed >> 8) % PERIOD_UNITS);
+    LETIMER0_Select_Clock(false);
+  }
+  run(to_underflow());
+  CHECK_EQ(clockSwitches, 2 * periods);
+
+  // 20 ppm of an hour
+  CHECK(distance(lastUnderflow - firstUnderflow, (uint64_t) (underflows - 1) * PERIOD_UNITS) <=
+        (uint64_t) 72 * UNITS_PER_MS);
+}
+
+/**
+ * @brief   Only every n-th underflow starts a sample, and the time to the
+ *          next one is right on either clock
+ */
+static void test_sample_period(void) {
+  uint64_t predicted;
+  uint32_t count;
+  uint32_t i;
+
+  boot();
+  LETIMER0_Set_Sample_Period(2 * LETIMER_PERIOD_MS - 1);
+  run(10 * PERIOD_UNITS);
+  CHECK_EQ(samples, 11);
+
+  LETIMER0_Set_Sample_Period(5 * LETIMER_PERIOD_MS);
+  run(to_underflow());
+  samples = 0;
+  run(20 * PERIOD_UNITS);
+  CHECK_EQ(samples, 4);
+
+  // Predicted at any point, on either clock, the sample comes within the
+  // millisecond the prediction is rounded down to and one tick
+  for(i = 0; i < 30; i++){
+    run((i * 997 * UNITS_PER_MS) % PERIOD_UNITS);
+    LETIMER0_Select_Clock((i & 1) != 0);
+    CHECK(LETIMER0_Ms_To_Next_Irq() <= LETIMER0_Ms_To_Next_Sample());
+    predicted = nowUnits + ((uint64_t) LETIMER0_Ms_To_Next_Sample() * UNITS_PER_MS);
+
+    count = samples;
+    while(samples == count)
+      run(to_underflow());
+    CHECK(lastSample >= predicted);
+    CHECK(lastSample - predicted <= UNITS_PER_MS + tickUnits);
+  }
+
+  // A pending timed wait is the next interrupt
+  LETIMER0_Select_Clock(false);
+  timerWaitUs_irq(20000);
+  CHECK(LETIMER0_Ms_To_Next_Irq() <= 20);
+  CHECK(LETIMER0_Ms_To_Next_Irq() >= 19);
+}
+
+int main(void) {
+
+  RUN(test_period);
+  RUN(test_switch_phase);
+  RUN(test_timekeeping);
+  RUN(test_sample_period);
+
+  return TEST_RESULT();
+}
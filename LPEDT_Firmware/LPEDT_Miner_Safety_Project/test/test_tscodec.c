@@ -0,0 +1,377 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    test_tscodec.c
+ * @brief   Host test of the block codec in tscodec.c
+ *
+ *          Samples are cut into blocks the way telemetry.c fills a batch,
+ *          each block read back with tscodec_read() and compared with what
+ *          went in. The benchmark reports the bytes per sample of typical
+ *          helmet traces against the fixed TSCODEC_RAW_SAMPLE_SIZE layout.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "test.h"
+#include "tscodec.h"
+#include "ble.h"
+
+#define MAX_SAMPLES            (200000)
+#define MAX_BLOCK              (256)
+
+// Block of a Bulk Telemetry notification, behind its sequence byte
+#define SMALL_BLOCK            (ATT_DEFAULT_MTU - ATT_HEADER_LENGTH - 1)
+#define LARGE_BLOCK            (MAX_BUFFER_LENGTH - 1)
+#define GUARD                  (0xA5)
+
+typedef struct {
+  uint8_t  sensor;
+  uint32_t ms;
+  int16_t  value;
+} sample_t;
+
+typedef enum {
+  TRACE_TEMPERATURE,    // 1 s, slow drift, timer jitter
+  TRACE_SHIFT,          // temperature, battery and SoC, zone and button events
+  TRACE_NOISY,          // 10 ms, noisy values, worst case of a sampled sensor
+  TRACE_EXTREMES,       // full range values and intervals
+  NUMBER_OF_TRACES
+} trace_t;
+
+static const char *const traceNames[] = { "temperature 1 s", "shift mix", "noisy 10 ms", "extremes" };
+
+static sample_t  samples[MAX_SAMPLES];
+static sample_t  decoded[MAX_SAMPLES];
+
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   Builds a trace, timestamps never go back within a sensor
+ * @param   trace   kind of trace
+ * @param   count   samples
+ * @return  none
+ */
+static void make_trace(trace_t trace, uint32_t count) {
+  uint32_t lastMs[TELEMETRY_NUMBER_OF_SENSORS];
+  int32_t  temperature = 2350;
+  int32_t  battery = 4150;
+  int32_t  zone = 3;
+  uint32_t ms = 123456;
+  uint32_t i;
+  uint32_t k;
+
+  memset(lastMs, 0, sizeof(lastMs));
+  for(i = 0; i < count; i++){
+    sample_t *s = &samples[i];
+
+    switch(trace){
+      case TRACE_TEMPERATURE:
+        ms += 1000 + (((rand() % 4) == 0) ? (uint32_t) (rand() % 3) - 1 : 0);
+        if((rand() % 5) == 0)
+          temperature += (rand() % 3) - 1;
+        s->sensor = TELEMETRY_SENSOR_TEMPERATURE;
+        s->value = (int16_t) temperature;
+        break;
+
+      case TRACE_SHIFT:
+        // One sample a second, battery and SoC every minute, a zone
+        // change every few minutes and a button press now and then
+        k = i % 62;
+        if(k == 60){
+          if((rand() % 8) == 0)
+            battery--;
+          s->sensor = TELEMETRY_SENSOR_BATTERY;
+          s->value = (int16_t) battery;
+        }
+        else if(k == 61){
+          s->sensor = TELEMETRY_SENSOR_SOC;
+          s->value = (int16_t) ((battery - 3300) / 9);
+        }
+        else if((rand() % 200) == 0){
+          zone += (rand() % 3) - 1;
+          s->sensor = TELEMETRY_SENSOR_ZONE;
+          s->value = (int16_t) zone;
+        }
+        else if((rand() % 900) == 0){
+          s->sensor = TELEMETRY_SENSOR_BUTTON;
+          s->value = (int16_t) (rand() % 2);
+        }
+        else {
+          ms += 1000;
+          if((rand() % 5) == 0)
+            temperature += (rand() % 3) - 1;
+          s->sensor = TELEMETRY_SENSOR_TEMPERATURE;
+          s->value = (int16_t) temperature;
+        }
+        break;
+
+      case TRACE_NOISY:
+        ms += 10;
+        s->sensor = TELEMETRY_SENSOR_TEMPERATURE;
+        s->value = (int16_t) (temperature + (rand() % 101) - 50);
+        break;
+
+      case TRACE_EXTREMES:
+      default:
+        // Random sensors and values, intervals from 0 to beyond a day
+        s->sensor = (uint8_t) (rand() % TELEMETRY_NUMBER_OF_SENSORS);
+        s->value = (int16_t) ((rand() % 4 == 0) ? ((rand() % 2) ? 32767 : -32768) : (rand() % 65536) - 32768);
+        switch(rand() % 4){
+          case 0:   ms += 0; break;
+          case 1:   ms += (uint32_t) rand() % 100; break;
+          case 2:   ms += (uint32_t) rand() % 100000; break;
+          default:  ms += (uint32_t) rand() % 100000000; break;
+        }
+        break;
+    }
+
+    // Timestamps of a sensor never go back
+    if(ms < lastMs[s->sensor])
+      ms = lastMs[s->sensor];
+    s->ms = ms;
+    lastMs[s->sensor] = ms;
+  }
+}
+
+/**
+ * @brief   Codes samples into blocks of a capacity, reads every block back
+ * @param   count       samples
+ * @param   capacity    bytes per block
+ * @param   blocks      written with the number of blocks
+ * @return  bytes of all blocks
+ */
+static uint32_t round_trip(uint32_t count, uint32_t capacity, uint32_t *blocks) {
+  tscodec_block_t  block;
+  tscodec_reader_t reader;
+  uint8_t          buf[MAX_BLOCK + 8];
+  uint32_t         bytes = 0;
+  uint32_t         out = 0;
+  uint32_t         i = 0;
+  uint32_t         n;
+
+  *blocks = 0;
+  while(i < count){
+    memset(buf, GUARD, sizeof(buf));
+    tscodec_begin(&block, buf, capacity, samples[i].ms);
+    while((i < count) && (tscodec_add(&block, samples[i].sensor, samples[i].ms, samples[i].value) == false))
+      i++;
+    CHECK(tscodec_count(&block) > 0);
+    CHECK(block.length <= capacity);
+    CHECK_EQ(buf[capacity], GUARD);
+    bytes += block.length;
+    (*blocks)++;
+
+    n = 0;
+    tscodec_read_begin(&reader, buf, block.length);
+    while((out < MAX_SAMPLES) &&
+          (tscodec_read(&reader, &decoded[out].sensor, &decoded[out].ms, &decoded[out].value) == false)){
+      out++;
+      n++;
+    }
+    CHECK_EQ(n, tscodec_count(&block));
+    CHECK_EQ(reader.pos, block.length);
+    if(tscodec_count(&block) == 0)
+      break;
+  }
+
+  CHECK_EQ(out, count);
+  for(i = 0; i < count; i++){
+    if((decoded[i].sensor != samples[i].sensor) || (decoded[i].ms != samples[i].ms) ||
+       (decoded[i].value != samples[i].value)){
+      CHECK_EQ(i, count);
+      break;
+    }
+  }
+
+  return bytes;
+}
+
+/**
+ * @brief   Bytes the same samples take in TSCODEC_RAW_SAMPLE_SIZE blocks
+ * @param   count       samples
+ * @param   capacity    bytes per block
+ * @return  bytes of all blocks
+ */
+static uint32_t raw_bytes(uint32_t count, uint32_t capacity) {
+  uint32_t perBlock = (capacity - TSCODEC_HEADER_SIZE) / TSCODEC_RAW_SAMPLE_SIZE;
+  uint32_t blocks = (count + perBlock - 1) / perBlock;
+
+  return (blocks * TSCODEC_HEADER_SIZE) + (count * TSCODEC_RAW_SAMPLE_SIZE);
+}
+
+//------------------------------------------------------------------------------
+// Tests
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   The bytes of a short block, laid out by hand from tscodec.h
+ */
+static void test_layout(void) {
+  static const uint8_t expected[] = {
+    3, 0xE8, 0x03, 0x00, 0x00,
+    0x81, 0x28,           // same interval (0), value +20
+    0x41, 0xD0, 0x0F,     // interval +1000, same value
+    0x81, 0x02,           // same interval, value +1
+  };
+  tscodec_block_t block;
+  uint8_t         buf[32];
+
+  tscodec_begin(&block, buf, sizeof(buf), 1000);
+  CHECK(tscodec_add(&block, 1, 1000, 20) == false);
+  CHECK(tscodec_add(&block, 1, 2000, 20) == false);
+  CHECK(tscodec_add(&block, 1, 3000, 21) == false);
+  CHECK_EQ(block.length, sizeof(expected));
+  CHECK(memcmp(buf, expected, sizeof(expected)) == 0);
+}
+
+/**
+ * @brief   Every trace comes back sample for sample, in blocks from the
+ *          smallest that holds a sample to the largest ATT payload
+ */
+static void test_round_trip(void) {
+  static const uint32_t capacities[] = {
+    TSCODEC_HEADER_SIZE + TSCODEC_MAX_SAMPLE_SIZE, SMALL_BLOCK, 100, LARGE_BLOCK
+  };
+  uint32_t blocks;
+  uint32_t t;
+  uint32_t c;
+
+  srand(11);
+  for(t = 0; t < NUMBER_OF_TRACES; t++){
+    make_trace((trace_t) t, 20000);
+    for(c = 0; c < sizeof(capacities) / sizeof(capacities[0]); c++)
+      round_trip(20000, capacities[c], &blocks);
+  }
+}
+
+/**
+ * @brief   A full block refuses the sample and stays as it was, a block
+ *          takes no more than 255 samples
+ */
+static void test_full_block(void) {
+  tscodec_block_t block;
+  uint8_t         buf[MAX_BLOCK + 8];
+  uint8_t         copy[MAX_BLOCK + 8];
+  uint32_t        length;
+  uint32_t        i;
+
+  // One byte samples until the block is exactly full
+  tscodec_begin(&block, buf, 12, 0);
+  for(i = 0; i < 7; i++)
+    CHECK(tscodec_add(&block, 0, 0, 0) == false);
+  CHECK_EQ(block.length, 12);
+  memcpy(copy, buf, sizeof(buf));
+  length = block.length;
+  CHECK(tscodec_add(&block, 0, 0, 0));
+  CHECK(tscodec_add(&block, 0, 5000, -32768));
+  CHECK_EQ(block.length, length);
+  CHECK(memcmp(copy, buf, length) == 0);
+
+  // The count is one byte
+  tscodec_begin(&block, buf, sizeof(buf), 0);
+  for(i = 0; i < 255; i++)
+    CHECK(tscodec_add(&block, 0, 0, 0) == false);
+  CHECK(tscodec_add(&block, 0, 0, 0));
+  CHECK_EQ(tscodec_count(&block), 255);
+}
+
+/**
+ * @brief   A block cut short or with a varint that does not end is refused
+ *          without reading past its length
+ */
+static void test_cut_short(void) {
+  tscodec_block_t  block;
+  tscodec_reader_t reader;
+  uint8_t          buf[MAX_BLOCK];
+  uint8_t          sensor;
+  uint32_t         ms;
+  int16_t          value;
+  uint32_t         length;
+  uint32_t         cut;
+  uint32_t         n;
+
+  srand(5);
+  make_trace(TRACE_EXTREMES, 40);
+  tscodec_begin(&block, buf, sizeof(buf), samples[0].ms);
+  for(n = 0; n < 40; n++)
+    tscodec_add(&block, samples[n].sensor, samples[n].ms, samples[n].value);
+  length = block.length;
+
+  for(cut = 0; cut < length; cut++){
+    n = 0;
+    tscodec_read_begin(&reader, buf, cut);
+    while(tscodec_read(&reader, &sensor, &ms, &value) == false)
+      n++;
+    CHECK(n < tscodec_count(&block));
+    CHECK((cut < TSCODEC_HEADER_SIZE) || (reader.pos <= cut));
+  }
+
+  // Continuation bits to the end of the block
+  memset(&buf[TSCODEC_HEADER_SIZE + 1], 0xFF, 16);
+  buf[TSCODEC_HEADER_SIZE] = 0;
+  tscodec_read_begin(&reader, buf, TSCODEC_HEADER_SIZE + 17);
+  CHECK(tscodec_read(&reader, &sensor, &ms, &value));
+  CHECK(reader.pos <= TSCODEC_HEADER_SIZE + 17);
+
+  // No header
+  tscodec_read_begin(&reader, buf, TSCODEC_HEADER_SIZE - 1);
+  CHECK(tscodec_read(&reader, &sensor, &ms, &value));
+}
+
+/**
+ * @brief   Bytes per sample of each trace against the raw layout, at the
+ *          smallest and largest notification payload, and the speed
+ */
+static void bench_ratio(void) {
+  static const uint32_t capacities[] = { SMALL_BLOCK, LARGE_BLOCK };
+  uint32_t count = MAX_SAMPLES;
+  uint32_t blocks;
+  uint32_t bytes;
+  uint32_t raw;
+  uint64_t start;
+  uint64_t ns;
+  uint32_t t;
+  uint32_t c;
+
+  srand(3);
+  for(t = 0; t < NUMBER_OF_TRACES; t++){
+    make_trace((trace_t) t, count);
+    for(c = 0; c < sizeof(capacities) / sizeof(capacities[0]); c++){
+      start = test_now_ns();
+      bytes = round_trip(count, capacities[c], &blocks);
+      ns = test_now_ns() - start;
+      raw = raw_bytes(count, capacities[c]);
+      printf("%-16s %3u byte blocks: %5.2f B/sample, raw %5.2f, %4.1f x, %5.1f samples/block, %4.0f ns/sample coded + read\n",
+             traceNames[t], (unsigned int) capacities[c], (double) bytes / count, (double) raw / count,
+             (double) raw / bytes, (double) count / blocks, (double) ns / count);
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  if((argc > 1) && (strcmp(argv[1], "bench") == 0)){
+    bench_ratio();
+    return TEST_RESULT();
+  }
+
+  RUN(test_layout);
+  RUN(test_round_trip);
+  RUN(test_full_block);
+  RUN(test_cut_short);
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,496 @@
+/*******************************************************************************
+ * Copyright (C) 2026 by the Miner Safety Gear contributors
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. The Miner Safety Gear contributors and the University of Colorado
+ * are not liable for any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    test_zone.c
+ * @brief   Host test, trace replay and benchmark of zone.c
+ *
+ *          A trace has "ms,zone,rssi,power" lines, one per anchor scan report
+ *          as a scanner at the helmet position hears it, optionally followed
+ *          by the zone the helmet was really in. Every line becomes a scan
+ *          report with the anchor advertising data of zone.h and goes
+ *          through zone_scan_report(), with zone_tick() every second as in
+ *          the BLE loop.
+ *
+ *          "test_zone walk.csv" replays a trace recorded on site and prints
+ *          the zone changes and how often the zone was right; use it when
+ *          tuning the ZONE_ constants. Without arguments the tests replay
+ *          zone_walk.csv. "test_zone bench" prints the scan reports per
+ *          second with the anchor table full.
+ *
+ * @author  Miner Safety Gear contributors
+ * @date    Oct 17, 2026
+ */
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "test.h"
+#include "zone.h"
+#include "beacon.h"
+#include "telemetry.h"
+#include "journal.h"
+#include "sl_sleeptimer.h"
+#include "sl_bt_api.h"
+
+#define MAX_CHANGES            (64)
+#define BENCH_REPORTS          (20000000)
+
+// Flags AD structure, then the anchor AD structure
+#define ADV_LENGTH             (3 + 8)
+
+typedef struct {
+  uint32_t ms;
+  uint16_t zoneId;
+} zone_change_t;
+
+typedef struct {
+  sl_bt_evt_scanner_scan_report_t report;
+  uint8_t                         data[ADV_LENGTH];
+} scan_report_t;
+
+static uint64_t       now = 0;            // ms, one tick per ms
+static bool           scanning = false;
+static bool           subscribed = true;
+static zone_change_t  changes[MAX_CHANGES];
+static uint32_t       numChanges = 0;
+static uint32_t       journaled = 0;
+
+//------------------------------------------------------------------------------
+// Stand-ins for the rest of the firmware
+//------------------------------------------------------------------------------
+
+uint64_t sl_sleeptimer_get_tick_count64(void) {
+  return now;
+}
+
+sl_status_t sl_sleeptimer_tick64_to_ms(uint64_t tick, uint64_t *ms) {
+  *ms = tick;
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_scanner_set_mode(uint8_t phys, uint8_t scan_mode) {
+  CHECK_EQ(phys, sl_bt_gap_1m_phy);
+  CHECK_EQ(scan_mode, 0);
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_scanner_set_timing(uint8_t phys, uint16_t scan_interval, uint16_t scan_window) {
+  CHECK_EQ(phys, sl_bt_gap_1m_phy);
+  CHECK_EQ(scan_interval, ZONE_SCAN_INTERVAL);
+  CHECK_EQ(scan_window, ZONE_SCAN_WINDOW);
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_scanner_start(uint8_t scanning_phy, uint8_t discover_mode) {
+  CHECK_EQ(scanning_phy, sl_bt_gap_1m_phy);
+  CHECK_EQ(discover_mode, sl_bt_scanner_discover_observation);
+  scanning = true;
+  return SL_STATUS_OK;
+}
+
+bool telemetry_add_sample(telemetry_sensor_t sensor, int16_t value) {
+  CHECK_EQ(sensor, TELEMETRY_SENSOR_ZONE);
+  CHECK_EQ((uint16_t) value, zone_current());
+  if(numChanges < MAX_CHANGES){
+    changes[numChanges].ms = (uint32_t) now;
+    changes[numChanges].zoneId = (uint16_t) value;
+  }
+  numChanges++;
+  return !subscribed;
+}
+
+void journal_append(telemetry_sensor_t sensor, int16_t value) {
+  CHECK_EQ(sensor, TELEMETRY_SENSOR_ZONE);
+  CHECK_EQ((uint16_t) value, zone_current());
+  journaled++;
+}
+
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   Boots zone.c
+ * @return  none
+ */
+static void setup(void) {
+  now = 0;
+  scanning = false;
+  subscribed = true;
+  numChanges = 0;
+  journaled = 0;
+  zone_init();
+  CHECK(scanning);
+}
+
+/**
+ * @brief   Builds the scan report an anchor advertising makes
+ * @param   r       filled in
+ * @param   zoneId  zone of the anchor
+ * @param   rssi    RSSI of the report, dBm
+ * @param   power   measured power the anchor advertises, dBm
+ * @return  none
+ */
+static void make_report(scan_report_t *r, uint16_t zoneId, int8_t rssi, int8_t power) {
+  uint8_t *d = r->report.data.data;
+
+  memset(r, 0, sizeof(*r));
+  r->report.packet_type = 0x03;
+  r->report.rssi = rssi;
+  r->report.data.len = ADV_LENGTH;
+  d[0] = 2;
+  d[1] = 0x01;
+  d[2] = 0x06;
+  d[3] = 7;
+  d[4] = 0xFF;
+  d[5] = (uint8_t) BEACON_COMPANY_ID;
+  d[6] = (uint8_t) (BEACON_COMPANY_ID >> 8);
+  d[7] = ZONE_ANCHOR_FORMAT;
+  d[8] = (uint8_t) zoneId;
+  d[9] = (uint8_t) (zoneId >> 8);
+  d[10] = (uint8_t) power;
+}
+
+/**
+ * @brief   Hands an anchor report to zone.c
+ * @return  none
+ */
+static void report(uint16_t zoneId, int8_t rssi, int8_t power) {
+  scan_report_t r;
+
+  make_report(&r, zoneId, rssi, power);
+  zone_scan_report(&r.report);
+}
+
+/**
+ * @brief   Moves the clock on, with zone_tick() on every full second
+ * @param   ms      time to pass
+ * @return  none
+ */
+static void advance_ms(uint32_t ms) {
+  uint64_t end = now + ms;
+
+  while((now / 1000) < (end / 1000)){
+    now = ((now / 1000) + 1) * 1000;
+    zone_tick();
+  }
+  now = end;
+}
+
+/**
+ * @brief   Replays a trace through zone.c from boot
+ * @param   path      trace file
+ * @param   verbose   true to print the zone changes
+ * @param   labelled  written with the reports that came with a real zone
+ * @param   agreed    written with those where zone.c had it right
+ * @return  false if the trace cannot be read
+ */
+static bool replay(const char *path, bool verbose, uint32_t *labelled, uint32_t *agreed) {
+  char     line[128];
+  char    *p;
+  FILE    *f;
+  long     v[5];
+  uint32_t n = 0;
+  int      fields;
+  uint32_t i;
+
+  f = fopen(path, "r");
+  if(f == NULL){
+    printf("cannot open %s\n", path);
+    return false;
+  }
+
+  setup();
+  *labelled = 0;
+  *agreed = 0;
+  while(fgets(line, sizeof(line), f) != NULL){
+    n++;
+    p = strchr(line, '#');
+    if(p != NULL)
+      *p = '\0';
+    p = line + strspn(line, " \t");
+    if((*p == '\0') || (*p == '\n') || (*p == '\r') || ((*p >= 'a') && (*p <= 'z')))
+      continue;
+
+    fields = sscanf(p, "%li,%li,%li,%li,%li", &v[0], &v[1], &v[2], &v[3], &v[4]);
+    if((fields < 4) || (v[0] < (long) now) || (v[1] < 0) || (v[1] >= ZONE_UNKNOWN)){
+      printf("%s:%u: expected ms,zone,rssi,power[,real zone] in time order\n", path, (unsigned int) n);
+      fclose(f);
+      return false;
+    }
+
+    advance_ms((uint32_t) (v[0] - (long) now));
+    report((uint16_t) v[1], (int8_t) v[2], (int8_t) v[3]);
+    if(fields == 5){
+      (*labelled)++;
+      *agreed += (zone_current() == (uint16_t) v[4]);
+    }
+  }
+  fclose(f);
+
+  if(verbose){
+    for(i = 0; (i < numChanges) && (i < MAX_CHANGES); i++){
+      if(changes[i].zoneId == ZONE_UNKNOWN)
+        printf("%9u ms  zone unknown\n", (unsigned int) changes[i].ms);
+      else
+        printf("%9u ms  zone %u\n", (unsigned int) changes[i].ms, (unsigned int) changes[i].zoneId);
+    }
+    printf("%u zone changes", (unsigned int) numChanges);
+    if(*labelled != 0)
+      printf(", right zone on %.1f %% of %u labelled reports",
+             100.0 * *agreed / *labelled, (unsigned int) *labelled);
+    printf("\n");
+  }
+
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Tests
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   The walk of zone_walk.csv: every zone in order, no flicker on the
+ *          boundary the helmet stops on, unknown in the drift out of range
+ */
+static void test_walk(void) {
+  static const uint16_t expected[] = { 101, 102, 103, 104, 105, 106, 105, 104, ZONE_UNKNOWN, 103 };
+  uint32_t labelled;
+  uint32_t agreed;
+  uint32_t i;
+
+  CHECK(replay(ZONE_TRACE, false, &labelled, &agreed));
+  CHECK_EQ(numChanges, sizeof(expected) / sizeof(expected[0]));
+  for(i = 0; (i < numChanges) && (i < sizeof(expected) / sizeof(expected[0])); i++)
+    CHECK_EQ(changes[i].zoneId, expected[i]);
+
+  // The hysteresis costs a few meters past every boundary
+  CHECK(labelled > 300);
+  CHECK(agreed * 2 > labelled);
+  printf("  right zone on %.1f %% of %u labelled reports\n", 100.0 * agreed / labelled, (unsigned int) labelled);
+}
+
+/**
+ * @brief   Boots zone.c with zone 1 current at a margin of 0 dB
+ * @return  none
+ */
+static void setup_in_zone_1(void) {
+  uint32_t i;
+
+  setup();
+  for(i = 1; i < ZONE_MIN_REPORTS; i++)
+    report(1, -60, -60);
+  CHECK_EQ(zone_current(), ZONE_UNKNOWN);
+  report(1, -60, -60);
+  CHECK_EQ(zone_current(), 1);
+}
+
+/**
+ * @brief   The zone moves after ZONE_SWITCH_REPORTS clearly stronger reports
+ *          in a row, never on reports within ZONE_HYSTERESIS_DB
+ */
+static void test_hysteresis(void) {
+  uint32_t i;
+
+  // Exactly ZONE_HYSTERESIS_DB stronger is not enough
+  setup_in_zone_1();
+  for(i = 0; i < 20; i++)
+    report(2, -60 + ZONE_HYSTERESIS_DB, -60);
+  CHECK_EQ(zone_current(), 1);
+
+  // An anchor counts once it has ZONE_MIN_REPORTS
+  setup_in_zone_1();
+  for(i = 0; i < ZONE_MIN_REPORTS + ZONE_SWITCH_REPORTS - 2; i++)
+    report(2, -40, -60);
+  CHECK_EQ(zone_current(), 1);
+  report(2, -40, -60);
+  CHECK_EQ(zone_current(), 2);
+
+  CHECK_EQ(numChanges, 2);
+  CHECK_EQ(journaled, 0);
+}
+
+/**
+ * @brief   A report of another strong anchor breaks the run of a challenger
+ */
+static void test_switch_in_a_row(void) {
+  uint32_t i;
+
+  setup_in_zone_1();
+  for(i = 1; i < ZONE_MIN_REPORTS; i++)
+    report(3, -40, -60);
+  for(i = 0; i < ZONE_MIN_REPORTS + ZONE_SWITCH_REPORTS - 2; i++)
+    report(2, -40, -60);
+
+  report(3, -40, -60);
+  for(i = 0; i < ZONE_SWITCH_REPORTS - 1; i++)
+    report(2, -40, -60);
+  CHECK_EQ(zone_current(), 1);
+  report(2, -40, -60);
+  CHECK_EQ(zone_current(), 2);
+}
+
+/**
+ * @brief   Anchors compare by RSSI minus their measured power
+ */
+static void test_measured_power(void) {
+  uint32_t i;
+
+  // 7 dB weaker than zone 1, but from an anchor 15 dB weaker at 1 m
+  setup_in_zone_1();
+  for(i = 0; i < ZONE_MIN_REPORTS + ZONE_SWITCH_REPORTS - 1; i++)
+    report(2, -67, -75);
+  CHECK_EQ(zone_current(), 2);
+
+  // 20 dB stronger, from an anchor 20 dB stronger at 1 m
+  setup_in_zone_1();
+  for(i = 0; i < 20; i++)
+    report(2, -40, -40);
+  CHECK_EQ(zone_current(), 1);
+}
+
+/**
+ * @brief   Silent anchors leave the table, the zone falls back to the
+ *          strongest one left and then to unknown
+ */
+static void test_expiry(void) {
+  uint32_t i;
+
+  setup();
+  subscribed = false;
+
+  for(i = 0; i < ZONE_MIN_REPORTS; i++){
+    report(5, -60, -60);
+    report(6, -64, -60);
+    advance_ms(500);
+  }
+  CHECK_EQ(zone_current(), 5);
+
+  // Zone 6 goes on being heard, zone 5 stops
+  for(i = 0; i < (ZONE_ANCHOR_EXPIRY_MS / 1000) + 1; i++){
+    report(6, -64, -60);
+    advance_ms(1000);
+  }
+  CHECK_EQ(zone_current(), 6);
+
+  advance_ms(ZONE_ANCHOR_EXPIRY_MS + 1000);
+  CHECK_EQ(zone_current(), ZONE_UNKNOWN);
+
+  CHECK_EQ(numChanges, 3);
+  CHECK_EQ(changes[2].zoneId, ZONE_UNKNOWN);
+  CHECK_EQ(journaled, 3);
+}
+
+/**
+ * @brief   Two anchors on one table entry: the live and stronger one keeps it
+ */
+static void test_shared_entry(void) {
+  const uint16_t other = 7 + ZONE_MAX_ANCHORS;
+  uint32_t       i;
+
+  setup();
+  for(i = 0; i < ZONE_MIN_REPORTS; i++)
+    report(7, -60, -60);
+  CHECK_EQ(zone_current(), 7);
+
+  // Weaker, turned away while 7 is heard
+  for(i = 0; i < 10; i++)
+    report(other, -80, -60);
+  CHECK_EQ(zone_current(), 7);
+
+  // Stronger, takes the entry and 7 stops being the zone
+  report(other, -50, -60);
+  CHECK_EQ(zone_current(), ZONE_UNKNOWN);
+  for(i = 1; i < ZONE_MIN_REPORTS; i++)
+    report(other, -50, -60);
+  CHECK_EQ(zone_current(), other);
+}
+
+/**
+ * @brief   Advertising data that is not an anchor changes nothing
+ */
+static void test_not_anchor(void) {
+  scan_report_t r;
+  uint8_t      *d = r.report.data.data;
+  uint32_t      i;
+  uint32_t      k;
+
+  setup();
+  for(k = 0; k < 5; k++){
+    for(i = 0; i < 2 * ZONE_MIN_REPORTS; i++){
+      make_report(&r, 9, -50, -60);
+      switch(k){
+        case 0:  d[5] ^= 0x01;            break;  // company ID
+        case 1:  d[7] = 0x81;             break;  // format
+        case 2:  d[3] = 8;                break;  // AD runs past the data
+        case 3:  r.report.data.len = 10;  break;  // truncated
+        default: d[8] = d[9] = 0xFF;      break;  // ZONE_UNKNOWN
+      }
+      zone_scan_report(&r.report);
+    }
+    CHECK_EQ(zone_current(), ZONE_UNKNOWN);
+  }
+  CHECK_EQ(numChanges, 0);
+}
+
+//------------------------------------------------------------------------------
+// Benchmark
+//------------------------------------------------------------------------------
+
+/**
+ * @brief   Scan reports with every anchor table entry in use
+ * @return  none
+ */
+static void bench_reports(void) {
+  static scan_report_t r[ZONE_MAX_ANCHORS * 8];
+  uint64_t             start;
+  uint64_t             ns;
+  uint32_t             k;
+
+  setup();
+  for(k = 0; k < sizeof(r) / sizeof(r[0]); k++)
+    make_report(&r[k], (uint16_t) (100 + (k % ZONE_MAX_ANCHORS)), (int8_t) (-50 - (int) (k % 40)), -59);
+
+  start = test_now_ns();
+  for(k = 0; k < BENCH_REPORTS; k++){
+    zone_scan_report(&r[k % (sizeof(r) / sizeof(r[0]))].report);
+    if((k & 0xFFF) == 0)
+      advance_ms(100);
+  }
+  ns = test_now_ns() - start;
+
+  printf("zone_scan_report: %.1f M reports/s, %.1f ns each, %u anchors, %u zone changes\n",
+         (double) BENCH_REPORTS * 1000.0 / (double) ns, (double) ns / BENCH_REPORTS,
+         (unsigned int) ZONE_MAX_ANCHORS, (unsigned int) numChanges);
+}
+
+int main(int argc, char *argv[]) {
+  uint32_t labelled;
+  uint32_t agreed;
+
+  if((argc > 1) && (strcmp(argv[1], "bench") == 0)){
+    bench_reports();
+    return TEST_RESULT();
+  }
+
+  if(argc > 1)
+    return replay(argv[1], true, &labelled, &agreed) ? TEST_RESULT() : 1;
+
+  RUN(test_walk);
+  RUN(test_hysteresis);
+  RUN(test_switch_in_a_row);
+  RUN(test_measured_power);
+  RUN(test_expiry);
+  RUN(test_shared_entry);
+  RUN(test_not_anchor);
+
+  return TEST_RESULT();
+}